@@ -0,0 +1,109 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+#include "mamba/core/link.hpp"
+#include "mamba/core/transaction_context.hpp"
+#include "mamba/core/util.hpp"
+
+#include "package_data.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    void bench_link_package(benchmark::State& state, bench::PackageShape shape, bool copy)
+    {
+        const auto& package = bench::package_data(shape);
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            {
+                auto prefix = TemporaryDirectory();
+                fs::create_directories(prefix.path() / "conda-meta");
+                TransactionContext context(prefix.path(), { "", "" }, {});
+                context.always_copy = copy;
+                // Measure copying files, which cloning could skip on some file systems
+                context.allow_reflinks = false;
+                context.relocation_cache = false;
+                state.ResumeTiming();
+
+                LinkPackage(package.info(), package.pkgs_dir(), &context).execute();
+
+                // Do not measure removing the prefix
+                state.PauseTiming();
+            }
+            state.ResumeTiming();
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(shape.n_files));
+    }
+
+    BENCHMARK_CAPTURE(bench_link_package, hardlink_small_files, bench::many_small_files, false)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(bench_link_package, hardlink_large_files, bench::few_large_files, false)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(bench_link_package, copy_small_files, bench::many_small_files, true)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(bench_link_package, copy_large_files, bench::few_large_files, true)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(bench_link_package, prefix_replacement, bench::prefix_files, false)
+        ->Unit(benchmark::kMillisecond);
+
+    /** The files of a ``noarch: python`` package, mostly modules of its site-packages. */
+    auto noarch_python_files(std::size_t n_files) -> std::vector<std::string>
+    {
+        auto out = std::vector<std::string>();
+        out.reserve(n_files);
+        for (std::size_t i = 0; i < n_files; ++i)
+        {
+            if (i % 100 == 0)
+            {
+                out.push_back(fmt::format("python-scripts/tool-{}", i));
+            }
+            else
+            {
+                out.push_back(fmt::format("site-packages/pkg/module_{}/file_{}.py", i / 100, i));
+            }
+        }
+        return out;
+    }
+
+    void bench_noarch_target_path(benchmark::State& state)
+    {
+        const auto files = noarch_python_files(10'000);
+        const auto site_packages = get_python_site_packages_short_path("3.11");
+        for (auto _ : state)
+        {
+            for (const auto& file : files)
+            {
+                benchmark::DoNotOptimize(get_python_noarch_target_path(file, site_packages));
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(files.size()));
+    }
+
+    void bench_noarch_python_paths(benchmark::State& state)
+    {
+        const auto files = noarch_python_files(10'000);
+        const auto paths = NoarchPythonPaths(get_python_site_packages_short_path("3.11"), "3.11");
+        for (auto _ : state)
+        {
+            for (const auto& file : files)
+            {
+                benchmark::DoNotOptimize(paths.target_path(file));
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(files.size()));
+    }
+
+    BENCHMARK(bench_noarch_target_path)->Unit(benchmark::kMicrosecond);
+    BENCHMARK(bench_noarch_python_paths)->Unit(benchmark::kMicrosecond);
+}
@@ -0,0 +1,50 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/match_spec.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    const auto match_specs = std::vector<std::string>{
+        "python",
+        "numpy >=1.24",
+        "xtensor>=0.24,<0.25",
+        "openssl 3.1.* *_0",
+        "conda-forge::libsolv",
+        "pytorch[build=*cuda*]",
+        "conda-forge/linux-64::zlib==1.2.13=hd590300_5",
+        "libgcc-ng[version='>=12', build_number=2]",
+    };
+
+    void bench_match_spec_parse(benchmark::State& state)
+    {
+        auto channel_context = ChannelContext();
+        // Warm up the channel cache, which is shared by all specs of a solve
+        for (const auto& str : match_specs)
+        {
+            MatchSpec(str, channel_context);
+        }
+
+        for (auto _ : state)
+        {
+            for (const auto& str : match_specs)
+            {
+                benchmark::DoNotOptimize(MatchSpec(str, channel_context));
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(match_specs.size()));
+    }
+
+    BENCHMARK(bench_match_spec_parse);
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "mamba/core/package_handling.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/validate.hpp"
+
+#include "package_data.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto total_size(const bench::PackageShape& shape) -> int64_t
+    {
+        return static_cast<int64_t>(shape.n_files * shape.file_size);
+    }
+
+    void bench_extract(benchmark::State& state, std::string extension, bench::PackageShape shape)
+    {
+        const auto archive = bench::package_data(shape).archive(extension);
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            {
+                auto dest = TemporaryDirectory();
+                state.ResumeTiming();
+
+                extract(archive, dest.path() / "pkg");
+
+                // Do not measure removing the files
+                state.PauseTiming();
+            }
+            state.ResumeTiming();
+        }
+        state.SetBytesProcessed(state.iterations() * total_size(shape));
+    }
+
+    BENCHMARK_CAPTURE(bench_extract, tar_bz2_small_files, ".tar.bz2", bench::many_small_files)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(bench_extract, tar_bz2_large_files, ".tar.bz2", bench::few_large_files)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(bench_extract, conda_small_files, ".conda", bench::many_small_files)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(bench_extract, conda_large_files, ".conda", bench::few_large_files)
+        ->Unit(benchmark::kMillisecond);
+
+    void bench_sha256sum(benchmark::State& state)
+    {
+        const auto archive = bench::package_data(bench::few_large_files).archive(".conda");
+        const auto size = static_cast<int64_t>(fs::file_size(archive));
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(validation::sha256sum(archive));
+        }
+        state.SetBytesProcessed(state.iterations() * size);
+    }
+
+    BENCHMARK(bench_sha256sum)->Unit(benchmark::kMillisecond);
+}
@@ -0,0 +1,31 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <benchmark/benchmark.h>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/pool.hpp"
+
+#include "channel_data.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    void bench_pool_create_whatprovides(benchmark::State& state)
+    {
+        auto channel_context = ChannelContext();
+        auto pool = MPool(channel_context);
+        bench::add_repo(pool, bench::default_channel());
+
+        for (auto _ : state)
+        {
+            pool.create_whatprovides();
+        }
+    }
+
+    BENCHMARK(bench_pool_create_whatprovides)->Unit(benchmark::kMillisecond);
+}
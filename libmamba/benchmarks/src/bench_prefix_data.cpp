@@ -0,0 +1,52 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <benchmark/benchmark.h>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/prefix_data.hpp"
+#include "mamba/core/util.hpp"
+
+#include "package_data.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    // Written by PrefixData when loading, to skip parsing unchanged records
+    constexpr auto index_filename = "mamba-index.msgpack";
+
+    void bench_prefix_data_load(benchmark::State& state, bool indexed)
+    {
+        const auto n_records = static_cast<std::size_t>(state.range(0));
+        auto prefix = TemporaryDirectory();
+        bench::make_conda_meta(prefix.path(), n_records);
+        auto channel_context = ChannelContext();
+        // Write the index
+        PrefixData::create(prefix.path(), channel_context).value();
+
+        for (auto _ : state)
+        {
+            if (!indexed)
+            {
+                state.PauseTiming();
+                fs::remove(prefix.path() / "conda-meta" / index_filename);
+                state.ResumeTiming();
+            }
+            benchmark::DoNotOptimize(PrefixData::create(prefix.path(), channel_context).value());
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    BENCHMARK_CAPTURE(bench_prefix_data_load, parsed, false)
+        ->Arg(100)
+        ->Arg(1000)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(bench_prefix_data_load, indexed, true)
+        ->Arg(100)
+        ->Arg(1000)
+        ->Unit(benchmark::kMillisecond);
+}
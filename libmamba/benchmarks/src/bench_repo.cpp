@@ -0,0 +1,85 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <benchmark/benchmark.h>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/repo.hpp"
+
+#include "channel_data.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    const auto metadata = RepoMetadata{ /* .url= */ "https://conda.anaconda.org/bench/linux-64" };
+
+    void bench_repodata_records_read(benchmark::State& state)
+    {
+        const auto& channel = bench::default_channel();
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(RepoDataRecords::read(channel.repodata_file(), false));
+        }
+    }
+
+    BENCHMARK(bench_repodata_records_read)->Unit(benchmark::kMillisecond);
+
+    void bench_repo_from_records(benchmark::State& state)
+    {
+        const auto& channel = bench::default_channel();
+        auto channel_context = ChannelContext();
+        const auto records = RepoDataRecords::read(channel.repodata_file(), false);
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            auto pool = MPool(channel_context);
+            auto copy = records;
+            // Do not measure writing the solv cache
+            copy.filename.clear();
+            state.ResumeTiming();
+
+            MRepo(pool, "bench", std::move(copy), metadata);
+        }
+    }
+
+    BENCHMARK(bench_repo_from_records)->Unit(benchmark::kMillisecond);
+
+    void bench_repo_from_json(benchmark::State& state)
+    {
+        const auto& channel = bench::default_channel();
+        auto channel_context = ChannelContext();
+        for (auto _ : state)
+        {
+            auto pool = MPool(channel_context);
+            MRepo(pool, "bench", channel.repodata_file(), metadata);
+        }
+    }
+
+    BENCHMARK(bench_repo_from_json)->Unit(benchmark::kMillisecond);
+
+    void bench_repo_from_solv(benchmark::State& state)
+    {
+        const auto& channel = bench::default_channel();
+        auto channel_context = ChannelContext();
+        auto solv_file = channel.repodata_file();
+        solv_file.replace_extension("solv");
+        {
+            // Loading the json file writes the solv cache next to it
+            auto pool = MPool(channel_context);
+            MRepo(pool, "bench", channel.repodata_file(), metadata);
+        }
+
+        for (auto _ : state)
+        {
+            auto pool = MPool(channel_context);
+            MRepo(pool, "bench", solv_file, metadata);
+        }
+    }
+
+    BENCHMARK(bench_repo_from_solv)->Unit(benchmark::kMillisecond);
+}
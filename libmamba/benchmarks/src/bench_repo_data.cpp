@@ -0,0 +1,62 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <benchmark/benchmark.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/specs/repo_data.hpp"
+#include "mamba/specs/repo_data_table.hpp"
+
+#include "channel_data.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    void bench_repo_data_from_json(benchmark::State& state)
+    {
+        const auto repodata = bench::make_repodata();
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(repodata.get<specs::RepoData>());
+        }
+    }
+
+    BENCHMARK(bench_repo_data_from_json)->Unit(benchmark::kMillisecond);
+
+    void bench_repo_data_table_from_json(benchmark::State& state)
+    {
+        const auto repodata = bench::make_repodata();
+        std::size_t bytes = 0;
+        for (auto _ : state)
+        {
+            const auto table = specs::RepoDataTable::from_json(repodata);
+            bytes = table.memory_usage();
+        }
+        state.counters["bytes"] = static_cast<double>(bytes);
+    }
+
+    BENCHMARK(bench_repo_data_table_from_json)->Unit(benchmark::kMillisecond);
+
+    void bench_repo_data_table_depends(benchmark::State& state)
+    {
+        const auto table = specs::RepoDataTable::from_json(bench::make_repodata());
+        for (auto _ : state)
+        {
+            std::size_t n_chars = 0;
+            for (const auto& pkg : table.packages())
+            {
+                for (const auto dep : pkg.depends())
+                {
+                    n_chars += dep.size();
+                }
+            }
+            benchmark::DoNotOptimize(n_chars);
+        }
+    }
+
+    BENCHMARK(bench_repo_data_table_depends)->Unit(benchmark::kMicrosecond);
+}
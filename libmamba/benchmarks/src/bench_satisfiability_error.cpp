@@ -0,0 +1,70 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <stdexcept>
+#include <utility>
+
+#include <benchmark/benchmark.h>
+#include <solv/solver.h>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/satisfiability_error.hpp"
+#include "mamba/core/solver.hpp"
+
+#include "channel_data.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto make_unsolved(ChannelContext& channel_context, std::size_t job_idx) -> MSolver
+    {
+        auto pool = MPool(channel_context);
+        bench::add_repo(pool, bench::default_channel());
+        auto solver = MSolver(
+            std::move(pool),
+            std::vector{ std::pair{ SOLVER_FLAG_ALLOW_DOWNGRADE, 1 } }
+        );
+        solver.add_jobs(bench::default_channel().unsolvable_jobs().at(job_idx), SOLVER_INSTALL);
+        if (solver.try_solve())
+        {
+            throw std::logic_error("Benchmark problem should not be solvable");
+        }
+        return solver;
+    }
+
+    void bench_problems_graph(benchmark::State& state)
+    {
+        auto channel_context = ChannelContext();
+        const auto job_idx = static_cast<std::size_t>(state.range(0));
+        const auto solver = make_unsolved(channel_context, job_idx);
+
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(solver.problems_graph());
+        }
+    }
+
+    BENCHMARK(bench_problems_graph)->DenseRange(0, 1)->Unit(benchmark::kMillisecond);
+
+    void bench_problems_graph_compress(benchmark::State& state)
+    {
+        auto channel_context = ChannelContext();
+        const auto job_idx = static_cast<std::size_t>(state.range(0));
+        const auto solver = make_unsolved(channel_context, job_idx);
+        const auto pbs = solver.problems_graph();
+
+        for (auto _ : state)
+        {
+            const auto simplified = simplify_conflicts(pbs);
+            benchmark::DoNotOptimize(CompressedProblemsGraph::from_problems_graph(simplified));
+        }
+        state.counters["nodes"] = static_cast<double>(pbs.graph().number_of_nodes());
+    }
+
+    BENCHMARK(bench_problems_graph_compress)->DenseRange(0, 1)->Unit(benchmark::kMillisecond);
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <utility>
+
+#include <benchmark/benchmark.h>
+#include <solv/solver.h>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/solver.hpp"
+
+#include "channel_data.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto make_solver(ChannelContext& channel_context, const std::vector<std::string>& jobs)
+        -> MSolver
+    {
+        auto pool = MPool(channel_context);
+        bench::add_repo(pool, bench::default_channel());
+        auto solver = MSolver(
+            std::move(pool),
+            std::vector{ std::pair{ SOLVER_FLAG_ALLOW_DOWNGRADE, 1 } }
+        );
+        solver.add_jobs(jobs, SOLVER_INSTALL);
+        return solver;
+    }
+
+    void bench_solver_add_jobs(benchmark::State& state)
+    {
+        auto channel_context = ChannelContext();
+        auto pool = MPool(channel_context);
+        bench::add_repo(pool, bench::default_channel());
+        const auto jobs = bench::default_channel().solvable_jobs().at(1);
+
+        for (auto _ : state)
+        {
+            auto solver = MSolver(pool);
+            solver.add_jobs(jobs, SOLVER_INSTALL);
+        }
+    }
+
+    BENCHMARK(bench_solver_add_jobs)->Unit(benchmark::kMillisecond);
+
+    void bench_solver_solve(benchmark::State& state)
+    {
+        auto channel_context = ChannelContext();
+        const auto jobs = bench::default_channel().solvable_jobs().at(
+            static_cast<std::size_t>(state.range(0))
+        );
+        auto solver = make_solver(channel_context, jobs);
+
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(solver.try_solve());
+        }
+    }
+
+    BENCHMARK(bench_solver_solve)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+    void bench_solver_solve_unsolvable(benchmark::State& state)
+    {
+        auto channel_context = ChannelContext();
+        const auto jobs = bench::default_channel().unsolvable_jobs().at(
+            static_cast<std::size_t>(state.range(0))
+        );
+        auto solver = make_solver(channel_context, jobs);
+
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(solver.try_solve());
+        }
+    }
+
+    BENCHMARK(bench_solver_solve_unsolvable)->DenseRange(0, 1)->Unit(benchmark::kMillisecond);
+}
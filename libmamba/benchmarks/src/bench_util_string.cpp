@@ -0,0 +1,110 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "mamba/core/util_string.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    /** Strings as split when parsing specs, entry points, and track features. */
+    const auto inputs = std::vector<std::string>{
+        "conda-forge/linux-64::xtensor==0.24.7",
+        "wheel = wheel.cli:main",
+        "blas_mkl,cuda_11 openmp",
+        "https://conda.anaconda.org/conda-forge/noarch/repodata.json",
+    };
+
+    void bench_split_vector(benchmark::State& state)
+    {
+        for (auto _ : state)
+        {
+            for (const auto& str : inputs)
+            {
+                benchmark::DoNotOptimize(split(str, ":", 1));
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(inputs.size()));
+    }
+
+    BENCHMARK(bench_split_vector);
+
+    void bench_split_once(benchmark::State& state)
+    {
+        for (auto _ : state)
+        {
+            for (const auto& str : inputs)
+            {
+                benchmark::DoNotOptimize(split_once(str, ':'));
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(inputs.size()));
+    }
+
+    BENCHMARK(bench_split_once);
+
+    void bench_split_all_vector(benchmark::State& state)
+    {
+        for (auto _ : state)
+        {
+            for (const auto& str : inputs)
+            {
+                for (const auto& part : split(str, "/"))
+                {
+                    benchmark::DoNotOptimize(part.size());
+                }
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(inputs.size()));
+    }
+
+    BENCHMARK(bench_split_all_vector);
+
+    void bench_split_for_each(benchmark::State& state)
+    {
+        for (auto _ : state)
+        {
+            for (const auto& str : inputs)
+            {
+                split_for_each(
+                    str,
+                    "/",
+                    [](std::string_view part) { benchmark::DoNotOptimize(part.size()); }
+                );
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(inputs.size()));
+    }
+
+    BENCHMARK(bench_split_for_each);
+
+    /** A text file with many occurrences of a long prefix replaced by a shorter one. */
+    void bench_replace_all(benchmark::State& state)
+    {
+        const auto prefix = std::string(255, 'p');
+        auto text = std::string();
+        for (int i = 0; i < 1000; ++i)
+        {
+            text += "#!" + prefix + "/bin/python\nimport " + prefix + "/lib\n";
+        }
+
+        for (auto _ : state)
+        {
+            auto data = text;
+            replace_all(data, prefix, "/opt/env");
+            benchmark::DoNotOptimize(data.data());
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(text.size()));
+    }
+
+    BENCHMARK(bench_replace_all);
+}
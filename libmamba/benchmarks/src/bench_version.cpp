@@ -0,0 +1,113 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+#include "mamba/specs/version.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    /** Versions as found in conda-forge, from the simplest to the less common forms. */
+    const auto versions = std::vector<std::string>{
+        "1.0",   "3.11.4",      "2023.10.1", "1.24.0rc1", "0.4.0.post1",
+        "1!2.0", "1.2.3+abc.4", "9.3.0.dev", "2.0a0",     "1.1.1w",
+    };
+
+    void bench_version_parse(benchmark::State& state)
+    {
+        for (auto _ : state)
+        {
+            for (const auto& str : versions)
+            {
+                benchmark::DoNotOptimize(specs::Version::parse(str));
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(versions.size()));
+    }
+
+    BENCHMARK(bench_version_parse);
+
+    void bench_version_compare(benchmark::State& state)
+    {
+        auto parsed = std::vector<specs::Version>();
+        for (const auto& str : versions)
+        {
+            parsed.push_back(specs::Version::parse(str));
+        }
+
+        for (auto _ : state)
+        {
+            for (const auto& lhs : parsed)
+            {
+                for (const auto& rhs : parsed)
+                {
+                    benchmark::DoNotOptimize(lhs < rhs);
+                }
+            }
+        }
+        state.SetItemsProcessed(
+            state.iterations() * static_cast<int64_t>(parsed.size() * parsed.size())
+        );
+    }
+
+    BENCHMARK(bench_version_compare);
+
+    /**
+     * Many versions in the forms of ``versions``, with random numbers.
+     *
+     * Versions are mostly numeric, with pre-releases, post-releases and development versions,
+     * as in the records of conda-forge.
+     */
+    auto random_versions(std::size_t n_versions) -> std::vector<specs::Version>
+    {
+        const auto forms = std::vector<std::string>{
+            "{}.{}",        "{}.{}.{}",    "{}.{}.{}",      "{}.{}.{}",     "{}.{}.{}rc{}",
+            "{}.{}.post{}", "{}!{}.{}",    "{}.{}.{}+g{}",  "{}.{}.{}.dev{}", "{}.{}a{}",
+            "{}.{}.{}_{}",  "{}.{}.{}b{}", "{}.{}.{}.{}.{}",
+        };
+        auto rng = std::mt19937_64(0x6d616d6261);
+        auto out = std::vector<specs::Version>();
+        out.reserve(n_versions);
+        for (std::size_t i = 0; i < n_versions; ++i)
+        {
+            const auto& form = forms[rng() % forms.size()];
+            const auto str = fmt::format(
+                fmt::runtime(form),
+                rng() % 30,
+                rng() % 30,
+                rng() % 30,
+                rng() % 30,
+                rng() % 30
+            );
+            out.push_back(specs::Version::parse(str));
+        }
+        return out;
+    }
+
+    void bench_version_sort(benchmark::State& state)
+    {
+        const auto parsed = random_versions(20'000);
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            auto sorted = parsed;
+            state.ResumeTiming();
+            std::sort(sorted.begin(), sorted.end());
+            benchmark::DoNotOptimize(sorted.data());
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(parsed.size()));
+    }
+
+    BENCHMARK(bench_version_sort)->Unit(benchmark::kMillisecond);
+}
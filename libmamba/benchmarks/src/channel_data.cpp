@@ -0,0 +1,190 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <cstdint>
+#include <random>
+
+#include <fmt/format.h>
+
+#include "mamba/core/pool.hpp"
+
+#include "channel_data.hpp"
+
+namespace mamba::bench
+{
+    namespace
+    {
+        // Packages have major versions starting at 1, with this many minor versions each
+        constexpr std::size_t n_minors = 4;
+
+        auto major_of(std::size_t version_idx) -> std::size_t
+        {
+            return version_idx / n_minors + 1;
+        }
+
+        auto version_str(std::size_t version_idx) -> std::string
+        {
+            return fmt::format("{}.{}.0", major_of(version_idx), version_idx % n_minors);
+        }
+
+        auto hex_str(std::mt19937_64& rng, std::size_t n_chars) -> std::string
+        {
+            auto out = std::string();
+            while (out.size() < n_chars)
+            {
+                out += fmt::format("{:016x}", rng());
+            }
+            out.resize(n_chars);
+            return out;
+        }
+
+        auto make_record(
+            std::mt19937_64& rng,
+            std::string name,
+            std::string version,
+            std::size_t build_number,
+            nlohmann::json depends,
+            nlohmann::json constrains
+        ) -> nlohmann::json
+        {
+            return {
+                { "build", fmt::format("h{}_{}", hex_str(rng, 7), build_number) },
+                { "build_number", build_number },
+                { "constrains", std::move(constrains) },
+                { "depends", std::move(depends) },
+                { "license", "BSD-3-Clause" },
+                { "md5", hex_str(rng, 32) },
+                { "name", std::move(name) },
+                { "sha256", hex_str(rng, 64) },
+                { "size", rng() % 10'000'000 },
+                { "subdir", "linux-64" },
+                { "timestamp", 1'600'000'000'000 + rng() % 100'000'000'000 },
+                { "version", std::move(version) },
+            };
+        }
+    }
+
+    auto make_repodata(const ChannelShape& shape) -> nlohmann::json
+    {
+        // The output of std::mt19937_64 is fully specified, unlike standard distributions
+        auto rng = std::mt19937_64(0x6d616d6261);
+        auto packages = nlohmann::json::object();
+        const auto add = [&](nlohmann::json record)
+        {
+            auto filename = fmt::format(
+                "{}-{}-{}.conda",
+                record["name"].get<std::string>(),
+                record["version"].get<std::string>(),
+                record["build"].get<std::string>()
+            );
+            packages[std::move(filename)] = std::move(record);
+        };
+
+        const std::size_t n_majors = major_of(shape.n_versions - 1);
+        for (std::size_t major = 1; major <= n_majors; ++major)
+        {
+            const auto empty = nlohmann::json::array();
+            add(make_record(rng, "base", fmt::format("{}.0.0", major), 0, empty, empty));
+        }
+
+        for (std::size_t i = 0; i < shape.n_names; ++i)
+        {
+            for (std::size_t v = 0; v < shape.n_versions; ++v)
+            {
+                const auto major = major_of(v);
+                auto depends = nlohmann::json::array();
+                depends.push_back(fmt::format("base >={}.0,<{}.0a0", major, major + 1));
+                for (std::size_t d = 0; (i > 0) && (d < shape.n_depends); ++d)
+                {
+                    // A lower version of a package with a lower index, with the same major
+                    const auto dep = rng() % i;
+                    const auto dep_version = (major - 1) * n_minors + rng() % (v % n_minors + 1);
+                    depends.push_back(fmt::format(
+                        "pkg-{} >={},<{}.0a0",
+                        dep,
+                        version_str(dep_version),
+                        major + 1
+                    ));
+                }
+                for (std::size_t b = 0; b < shape.n_builds; ++b)
+                {
+                    add(make_record(
+                        rng,
+                        fmt::format("pkg-{}", i),
+                        version_str(v),
+                        b,
+                        depends,
+                        { fmt::format("base-abi {}.*", major) }
+                    ));
+                }
+            }
+        }
+
+        return {
+            { "info", { { "subdir", "linux-64" } } },
+            { "packages", nlohmann::json::object() },
+            { "packages.conda", std::move(packages) },
+            { "repodata_version", 1 },
+        };
+    }
+
+    ChannelData::ChannelData(const ChannelShape& shape)
+        : m_shape(shape)
+        , m_repodata_file(m_dir.path() / "linux-64" / "repodata.json")
+    {
+        fs::create_directories(m_repodata_file.parent_path());
+        auto out = open_ofstream(m_repodata_file);
+        out << make_repodata(m_shape);
+    }
+
+    auto ChannelData::shape() const -> const ChannelShape&
+    {
+        return m_shape;
+    }
+
+    auto ChannelData::repodata_file() const -> const fs::u8path&
+    {
+        return m_repodata_file;
+    }
+
+    auto ChannelData::solvable_jobs() const -> std::vector<std::vector<std::string>>
+    {
+        const auto n = m_shape.n_names;
+        return {
+            { fmt::format("pkg-{}", n - 1) },
+            {
+                fmt::format("pkg-{}", n - 1),
+                fmt::format("pkg-{}", n / 2),
+                fmt::format("pkg-{}", n / 4),
+            },
+            { fmt::format("pkg-{} <2", n - 1) },
+        };
+    }
+
+    auto ChannelData::unsolvable_jobs() const -> std::vector<std::vector<std::string>>
+    {
+        const auto n = m_shape.n_names;
+        return {
+            { fmt::format("pkg-{} <2", n - 1), "base >=2" },
+            { fmt::format("pkg-{} <2", n - 1), fmt::format("pkg-{} >=2,<3", n - 2) },
+        };
+    }
+
+    auto default_channel() -> const ChannelData&
+    {
+        static const auto channel = ChannelData();
+        return channel;
+    }
+
+    auto add_repo(MPool& pool, const ChannelData& channel) -> MRepo
+    {
+        auto records = RepoDataRecords::read(channel.repodata_file(), false);
+        records.filename.clear();
+        auto repo = MRepo(pool, "bench", std::move(records), RepoMetadata{ /* .url= */ "bench" });
+        pool.create_whatprovides();
+        return repo;
+    }
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_BENCHMARKS_CHANNEL_DATA_HPP
+#define MAMBA_BENCHMARKS_CHANNEL_DATA_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    class MPool;
+}
+
+namespace mamba::bench
+{
+    /** The size of a generated channel. */
+    struct ChannelShape
+    {
+        std::size_t n_names = 2000;
+        std::size_t n_versions = 12;
+        std::size_t n_builds = 2;
+        std::size_t n_depends = 4;
+    };
+
+    /**
+     * A deterministic ``repodata.json`` with records similar to those of conda-forge.
+     *
+     * Package ``pkg-<i>`` depends on ``base`` (playing the role of ``python``) with the same
+     * major version as itself, and on packages with a lower index.
+     * Hence packages of different major versions cannot be installed together.
+     * The same shape always gives the same records, on all platforms.
+     */
+    auto make_repodata(const ChannelShape& shape = {}) -> nlohmann::json;
+
+    /** A generated channel written in a temporary directory. */
+    class ChannelData
+    {
+    public:
+
+        explicit ChannelData(const ChannelShape& shape = {});
+
+        [[nodiscard]] auto shape() const -> const ChannelShape&;
+        [[nodiscard]] auto repodata_file() const -> const fs::u8path&;
+
+        /** Jobs that can be solved, such as installing a single package with all its deps. */
+        [[nodiscard]] auto solvable_jobs() const -> std::vector<std::vector<std::string>>;
+        /** Jobs that cannot be solved, because of packages with different major versions. */
+        [[nodiscard]] auto unsolvable_jobs() const -> std::vector<std::vector<std::string>>;
+
+    private:
+
+        ChannelShape m_shape;
+        TemporaryDirectory m_dir = {};
+        fs::u8path m_repodata_file;
+    };
+
+    /** The channel shared by the benchmarks, generated on first use. */
+    auto default_channel() -> const ChannelData&;
+
+    /** Add the records of the channel to the pool, without reading or writing a solv cache. */
+    auto add_repo(MPool& pool, const ChannelData& channel) -> MRepo;
+}
+
+#endif
@@ -0,0 +1,181 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/package_handling.hpp"
+#include "mamba/core/validate.hpp"
+
+#include "package_data.hpp"
+
+namespace mamba::bench
+{
+    namespace
+    {
+        // The placeholder of conda-build
+        constexpr std::string_view placeholder = "/opt/anaconda1anaconda2anaconda3";
+
+        auto hex_str(std::mt19937_64& rng, std::size_t n_chars) -> std::string
+        {
+            auto out = std::string();
+            out.reserve(n_chars + 16);
+            while (out.size() < n_chars)
+            {
+                out += fmt::format("{:016x}", rng());
+            }
+            out.resize(n_chars);
+            return out;
+        }
+
+        /** Lines of random text, with the prefix placeholder on every other line. */
+        auto prefix_str(std::mt19937_64& rng, std::size_t n_chars) -> std::string
+        {
+            auto out = std::string();
+            out.reserve(n_chars + 128);
+            while (out.size() < n_chars)
+            {
+                out += fmt::format("{}/lib/{}\n", placeholder, hex_str(rng, 16));
+                out += hex_str(rng, 63);
+                out += '\n';
+            }
+            out.resize(n_chars);
+            return out;
+        }
+    }
+
+    PackageData::PackageData(const PackageShape& shape)
+        : m_info(
+            fmt::format("bench-{}x{}", shape.n_files, shape.file_size),
+            "1.0",
+            shape.prefix_placeholder ? "prefix_0" : "0",
+            0
+        )
+    {
+        m_info.subdir = "linux-64";
+        m_info.fn = m_info.str() + ".conda";
+
+        auto rng = std::mt19937_64(0x6d616d6261);
+        const auto dir = extracted_dir();
+        fs::create_directories(dir / "info");
+        fs::create_directories(dir / "lib");
+
+        auto paths = nlohmann::json::array();
+        for (std::size_t i = 0; i < shape.n_files; ++i)
+        {
+            const auto rel_path = fmt::format("lib/file-{}.txt", i);
+            const auto path = dir / rel_path;
+            open_ofstream(path) << (shape.prefix_placeholder ? prefix_str(rng, shape.file_size)
+                                                             : hex_str(rng, shape.file_size));
+
+            auto entry = nlohmann::json{
+                { "_path", rel_path },
+                { "path_type", "hardlink" },
+                { "sha256", validation::sha256sum(path) },
+                { "size_in_bytes", shape.file_size },
+            };
+            if (shape.prefix_placeholder)
+            {
+                entry["file_mode"] = "text";
+                entry["prefix_placeholder"] = std::string(placeholder);
+            }
+            paths.push_back(std::move(entry));
+        }
+
+        const auto record = m_info.json_record();
+        open_ofstream(dir / "info" / "index.json") << record;
+        open_ofstream(dir / "info" / "repodata_record.json") << record;
+        open_ofstream(dir / "info" / "paths.json")
+            << nlohmann::json{ { "paths", std::move(paths) }, { "paths_version", 1 } };
+
+        // The default levels of ``micromamba package compress``
+        create_package(dir, archive(".tar.bz2"), 9, 1);
+        create_package(dir, archive(".conda"), 15, 1);
+    }
+
+    auto PackageData::info() const -> const PackageInfo&
+    {
+        return m_info;
+    }
+
+    auto PackageData::pkgs_dir() const -> const fs::u8path&
+    {
+        return m_dir.path();
+    }
+
+    auto PackageData::extracted_dir() const -> fs::u8path
+    {
+        return pkgs_dir() / m_info.str();
+    }
+
+    auto PackageData::archive(const std::string& extension) const -> fs::u8path
+    {
+        return pkgs_dir() / (m_info.str() + extension);
+    }
+
+    auto package_data(const PackageShape& shape) -> const PackageData&
+    {
+        using key_type = std::tuple<std::size_t, std::size_t, bool>;
+        static auto packages = std::map<key_type, std::unique_ptr<PackageData>>();
+        auto& package = packages[{ shape.n_files, shape.file_size, shape.prefix_placeholder }];
+        if (package == nullptr)
+        {
+            package = std::make_unique<PackageData>(shape);
+        }
+        return *package;
+    }
+
+    void make_conda_meta(const fs::u8path& prefix, std::size_t n_records)
+    {
+        constexpr std::size_t n_files = 50;
+
+        auto rng = std::mt19937_64(0x6d616d6261);
+        const auto conda_meta = prefix / "conda-meta";
+        fs::create_directories(conda_meta);
+        for (std::size_t i = 0; i < n_records; ++i)
+        {
+            const auto build = fmt::format("h{}_0", hex_str(rng, 7));
+            auto pkg = PackageInfo(fmt::format("pkg-{}", i), "1.0", build, 0);
+            pkg.subdir = "linux-64";
+            pkg.fn = pkg.str() + ".conda";
+            pkg.url = "https://conda.anaconda.org/bench/linux-64/" + pkg.fn;
+            pkg.channel = "https://conda.anaconda.org/bench";
+            pkg.md5 = hex_str(rng, 32);
+            pkg.sha256 = hex_str(rng, 64);
+            for (std::size_t d = 0; (i > 0) && (d < 4); ++d)
+            {
+                pkg.depends.push_back(fmt::format("pkg-{} >=1.0", rng() % i));
+            }
+
+            auto record = pkg.json_record();
+            auto files = nlohmann::json::array();
+            auto paths = nlohmann::json::array();
+            for (std::size_t f = 0; f < n_files; ++f)
+            {
+                auto path = fmt::format("lib/{}/file-{}.txt", pkg.name, f);
+                paths.push_back({
+                    { "_path", path },
+                    { "path_type", "hardlink" },
+                    { "sha256", hex_str(rng, 64) },
+                    { "sha256_in_prefix", hex_str(rng, 64) },
+                    { "size_in_bytes", rng() % 100'000 },
+                });
+                files.push_back(std::move(path));
+            }
+            record["files"] = std::move(files);
+            record["paths_data"] = { { "paths", std::move(paths) }, { "paths_version", 1 } };
+            record["requested_spec"] = "";
+            open_ofstream(conda_meta / (pkg.str() + ".json")) << record;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_BENCHMARKS_PACKAGE_DATA_HPP
+#define MAMBA_BENCHMARKS_PACKAGE_DATA_HPP
+
+#include <cstddef>
+
+#include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/package_info.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba::bench
+{
+    /** The files of a generated package. */
+    struct PackageShape
+    {
+        std::size_t n_files = 1000;
+        std::size_t file_size = 1024;
+        /** Whether the files are text files holding the prefix placeholder. */
+        bool prefix_placeholder = false;
+    };
+
+    /** A package of many small files, as headers or python modules. */
+    constexpr auto many_small_files = PackageShape{ 4000, 256, false };
+    /** A package of a few large files, as shared libraries. */
+    constexpr auto few_large_files = PackageShape{ 8, std::size_t(4) << 20, false };
+    /** A package of files in which the prefix must be replaced when linking. */
+    constexpr auto prefix_files = PackageShape{ 500, 4096, true };
+
+    /**
+     * A deterministic package, extracted in a package cache and archived in both formats.
+     *
+     * Files are made of random hexadecimal digits, so that they compress about as well as
+     * binaries.
+     */
+    class PackageData
+    {
+    public:
+
+        explicit PackageData(const PackageShape& shape);
+
+        [[nodiscard]] auto info() const -> const PackageInfo&;
+        /** The package cache holding the extracted package and its archives. */
+        [[nodiscard]] auto pkgs_dir() const -> const fs::u8path&;
+        [[nodiscard]] auto extracted_dir() const -> fs::u8path;
+        /** The archive of the package, for the ``.tar.bz2`` or ``.conda`` extension. */
+        [[nodiscard]] auto archive(const std::string& extension) const -> fs::u8path;
+
+    private:
+
+        PackageInfo m_info;
+        TemporaryDirectory m_dir = {};
+    };
+
+    /** The package of a shape shared by the benchmarks, generated on first use. */
+    auto package_data(const PackageShape& shape) -> const PackageData&;
+
+    /**
+     * Write the ``conda-meta`` records of @p n_records installed packages in @p prefix.
+     *
+     * Records hold the files of the package, as the records written when linking.
+     */
+    void make_conda_meta(const fs::u8path& prefix, std::size_t n_records);
+}
+
+#endif
@@ -5,12 +5,21 @@ from concurrent.futures import ProcessPoolExecutor
 
 
 def main():
-    max_workers = int(os.environ.get("MAMBA_EXTRACT_THREADS", "0"))
+    max_workers = int(os.environ.get("MAMBA_COMPILE_PYC_THREADS", "0"))
     if max_workers <= 0:
         max_workers = None
 
-    results = []
     with sys.stdin:
+        if max_workers == 1:
+            # Parallelism comes from running several instances of this script
+            success = True
+            for line in sys.stdin:
+                name = line.strip()
+                if name:
+                    success = compile_file(name, quiet=1) and success
+            return success
+
+        results = []
         with ProcessPoolExecutor(max_workers=max_workers) as executor:
             while True:
                 name = sys.stdin.readline().strip()
@@ -1,10 +1,70 @@
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "mamba/core/error_handling.hpp"
 
 namespace mamba
 {
     class MPool;
+    class MSubdirData;
     class MultiPackageCache;
 
-    expected_t<void, mamba_aggregated_error>
-    load_channels(MPool& pool, MultiPackageCache& package_caches, int is_retry);
+    /**
+     * Refresh in the background the expired repodata caches used by ``load_channels``.
+     *
+     * With ``repodata_stale_while_revalidate``, expired caches are loaded right away and
+     * revalidated with conditional requests while the caller goes on, such as solving.
+     * The caller is to start over with the refreshed caches if @ref wait reports a change.
+     */
+    class RepodataRevalidation
+    {
+    public:
+
+        RepodataRevalidation();
+        ~RepodataRevalidation();
+
+        RepodataRevalidation(const RepodataRevalidation&) = delete;
+        RepodataRevalidation& operator=(const RepodataRevalidation&) = delete;
+        RepodataRevalidation(RepodataRevalidation&&) = delete;
+        RepodataRevalidation& operator=(RepodataRevalidation&&) = delete;
+
+        /** Start downloading the revalidation targets of the stale @p subdirs. */
+        void start(std::vector<MSubdirData> subdirs);
+
+        /**
+         * Wait for the revalidation, and return whether some repodata changed.
+         *
+         * Caches that could not be refreshed, for instance offline, are not reported.
+         */
+        bool wait();
+
+    private:
+
+        std::vector<MSubdirData> m_subdirs;
+        std::thread m_thread;
+        bool m_changed = false;
+    };
+
+    /**
+     * Load the repodata of the configured channels in the pool.
+     *
+     * When ``repodata_use_shards`` is set, subdirs publishing sharded repodata only load the
+     * records of @p package_names and of their dependencies.
+     * Other subdirs, or all of them if @p package_names is empty, load their full repodata.
+     * When ``repodata_subset_cache`` is set, only the records reachable from @p package_names
+     * are loaded, from a cache shared by the runs requesting the same names.
+     * Only the subdirs of @p platforms are loaded if not empty, instead of the ones of the
+     * configured platform and noarch.
+     * Stale caches are refreshed in the background by @p revalidation if given, otherwise
+     * before being loaded.
+     */
+    expected_t<void, mamba_aggregated_error> load_channels(
+        MPool& pool,
+        MultiPackageCache& package_caches,
+        int is_retry,
+        const std::vector<std::string>& package_names = {},
+        const std::vector<std::string>& platforms = {},
+        RepodataRevalidation* revalidation = nullptr
+    );
 }
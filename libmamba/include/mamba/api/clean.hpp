@@ -17,6 +17,8 @@ namespace mamba
     const int MAMBA_CLEAN_LOCKS = 1 << 4;
     const int MAMBA_CLEAN_TRASH = 1 << 5;
     const int MAMBA_CLEAN_FORCE_PKGS_DIRS = 1 << 6;
+    // Remove the least recently used unused packages to fit in ``pkgs_dirs_max_size``
+    const int MAMBA_CLEAN_LRU = 1 << 7;
 
     class Configuration;
     void clean(Configuration& config, int options);
@@ -407,6 +407,15 @@ namespace mamba
 
         void load();
 
+        /**
+         * Load only the given configurables, the ones they need and the ones controlling the
+         * output and the logging.
+         *
+         * This is a fast path for commands using few parameters, such as the activation run
+         * by the shell on each prompt. The other configurables keep their previous values.
+         */
+        void load(std::vector<std::string> names);
+
         bool is_loading();
 
         void clear_rc_values();
@@ -441,7 +450,9 @@ namespace mamba
 
         void reset_compute_counters();
 
-        void compute_loading_sequence();
+        void compute_loading_sequence(const std::vector<std::string>& names);
+
+        void load_configurables(const std::vector<std::string>& names);
 
         void clear_rc_sources();
 
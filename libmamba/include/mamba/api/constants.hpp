@@ -21,6 +21,8 @@ namespace mamba
     const int MAMBA_REMOVE_FORCE = MAMBA_FORCE;
     const int MAMBA_REMOVE_PRUNE = 1 << 1;
     const int MAMBA_REMOVE_ALL = 1 << 2;
+    /** The prefix is deleted after its packages are removed, as by ``env remove``. */
+    const int MAMBA_REMOVE_ENV = 1 << 3;
 }
 
 #endif
@@ -8,18 +8,41 @@
 #define MAMBA_API_CREATE_HPP
 
 #include <string>
+#include <vector>
 
 #include "mamba/core/mamba_fs.hpp"
 
 namespace mamba
 {
+    class ChannelContext;
     class Configuration;
 
     void create(Configuration& config);
 
+    /** An environment to create with ``create_environments``. */
+    struct EnvironmentSpecs
+    {
+        fs::u8path prefix;
+        std::vector<std::string> specs;
+    };
+
+    /**
+     * Create several environments in one process, such as the environments of an image.
+     *
+     * The repodata of the configured channels is loaded once, and the environments are solved
+     * concurrently on forks of the pool.
+     * The packages of all the environments are then downloaded and extracted together, each
+     * shared package once, before the environments are linked one after the other.
+     */
+    void
+    create_environments(ChannelContext& channel_context, const std::vector<EnvironmentSpecs>& envs);
+
     namespace detail
     {
         void store_platform_config(const fs::u8path& prefix, const std::string& platform);
+
+        /** The prefix of the environment to clone, given by name or by path. */
+        auto clone_source_prefix(const std::string& clone) -> fs::u8path;
     }
 }
 
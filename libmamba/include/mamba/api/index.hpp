@@ -0,0 +1,59 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_API_INDEX_HPP
+#define MAMBA_API_INDEX_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mamba/core/mamba_fs.hpp"
+
+namespace mamba
+{
+    class ChannelContext;
+
+    struct IndexStats
+    {
+        /** The packages in the written repodata. */
+        std::size_t n_packages = 0;
+        /** The packages that were read, rather than reused from the previous repodata. */
+        std::size_t n_indexed = 0;
+        /** The packages that could not be read, which are left out of the repodata. */
+        std::vector<std::string> errors = {};
+    };
+
+    /**
+     * Write the ``repodata.json``, ``repodata.json.zst``, ``repodata_index.bin`` and
+     * ``repodata.solv`` files of the packages of a subdir.
+     *
+     * Only the ``info/index.json`` of the packages is read, from @p n_threads threads (as many
+     * as cores if zero).
+     * Records of the previous ``repodata.json`` are reused for packages that did not change
+     * since it was written.
+     */
+    IndexStats index_subdir(
+        ChannelContext& channel_context,
+        const fs::u8path& subdir_dir,
+        std::size_t n_threads = 0,
+        int zstd_level = 16
+    );
+
+    /**
+     * Index all the subdirs of a local channel with packages, and its ``noarch`` subdir.
+     *
+     * @return The statistics of each subdir, by subdir name.
+     */
+    std::map<std::string, IndexStats> index_channel(
+        ChannelContext& channel_context,
+        const fs::u8path& channel_dir,
+        std::size_t n_threads = 0,
+        int zstd_level = 16
+    );
+}
+
+#endif
@@ -21,11 +21,18 @@ namespace mamba
 
     void info(Configuration& config);
 
+    /**
+     * Probe the factors of the environment that slow down installs, such as package caches on
+     * another file system than the prefix, and the network latency to the channels.
+     */
+    void perf_info(Configuration& config);
+
     std::string version();
 
     namespace detail
     {
         void print_info(ChannelContext& channel_context, const Configuration& config);
+        void print_perf_info(ChannelContext& channel_context);
     }
 }
 
@@ -26,6 +26,7 @@ namespace mamba
 {
     class ChannelContext;
     class Configuration;
+    class PrefixData;
 
     void install(Configuration& config);
 
@@ -56,6 +57,15 @@ namespace mamba
 
         void create_empty_target(const fs::u8path& prefix);
 
+        /** Record timings if they are reported in the json output or in a trace file. */
+        void init_tracing();
+
+        /** Report the timings recorded so far in the json output and in the trace file. */
+        void report_tracing();
+
+        /** Rewrite the trace file with the timings recorded since, such as the transaction. */
+        void write_trace_file();
+
         void file_specs_hook(Configuration& config, std::vector<std::string>& file_specs);
 
         void channels_hook(Configuration& config, std::vector<std::string>& channels);
@@ -85,6 +95,17 @@ namespace mamba
         std::tuple<std::vector<PackageInfo>, std::vector<MatchSpec>>
         parse_urls_to_package_info(const std::vector<std::string>& urls, ChannelContext& channel_context);
 
+        /**
+         * Whether all the specs are satisfied by installed packages and were already requested.
+         *
+         * Installing them would then change neither the prefix nor its history, which is
+         * checked against the installed packages only, without loading channels nor solving.
+         * Specs that need the repodata to be matched, such as channel specs, are never
+         * considered installed.
+         */
+        bool
+        specs_already_installed(PrefixData& prefix_data, const std::vector<std::string>& specs);
+
         inline void to_json(nlohmann::json&, const other_pkg_mgr_spec&)
         {
         }
@@ -8,6 +8,7 @@
 #define MAMBA_API_LIST_HPP
 
 #include <string>
+#include <vector>
 
 namespace mamba
 {
@@ -16,6 +17,9 @@ namespace mamba
 
     void list(Configuration& config, const std::string& regex);
 
+    /** Print the installed packages owning the @p paths of the prefix, from its file index. */
+    void list_file_owners(Configuration& config, const std::vector<std::string>& paths);
+
     namespace detail
     {
         void list_packages(std::string regex, ChannelContext& channel_context);
@@ -11,10 +11,12 @@
 #include <vector>
 
 #include "mamba/api/constants.hpp"
+#include "mamba/core/mamba_fs.hpp"
 
 namespace mamba
 {
     class ChannelContext;
+    class PrefixData;
 
     void remove(Configuration& config, int flags = MAMBA_REMOVE_PRUNE);
 
@@ -26,6 +28,20 @@ namespace mamba
             bool prune,
             bool force
         );
+
+        /**
+         * Whether removing the packages of a prefix only deletes their files.
+         *
+         * It is not the case when packages have pre-unlink scripts or menu shortcuts to remove.
+         */
+        bool only_deletes_files(const PrefixData& prefix_data);
+
+        /**
+         * Delete the content of a prefix, without unlinking its packages one by one.
+         *
+         * Files are deleted concurrently, then the emptied directories from the deepest.
+         */
+        void delete_prefix_content(const fs::u8path& prefix);
     }
 }
 
@@ -0,0 +1,42 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_API_SOLVE_PLATFORMS_HPP
+#define MAMBA_API_SOLVE_PLATFORMS_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mamba/core/error_handling.hpp"
+#include "mamba/core/package_info.hpp"
+#include "mamba/core/solution.hpp"
+
+namespace mamba
+{
+    class ChannelContext;
+    class MultiPackageCache;
+
+    /**
+     * Solve @p specs for several platforms, such as to generate a multi-platform lockfile.
+     *
+     * The noarch repodata of the configured channels is loaded once and shared by all the
+     * platforms, then the platforms are solved concurrently.
+     * The virtual packages of a platform are taken from @p virtual_packages, keyed by
+     * platform, and none are used for platforms missing from it.
+     *
+     * @return The solution of each platform, or the reason it could not be solved.
+     */
+    auto solve_for_platforms(
+        ChannelContext& channel_context,
+        MultiPackageCache& package_caches,
+        const std::vector<std::string>& specs,
+        const std::vector<std::string>& platforms,
+        const std::map<std::string, std::vector<PackageInfo>>& virtual_packages = {}
+    ) -> std::map<std::string, expected_t<Solution>>;
+}
+
+#endif
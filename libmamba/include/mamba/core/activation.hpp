@@ -8,6 +8,7 @@
 #define MAMBA_CORE_ACTIVATION_HPP
 
 #include <map>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -82,6 +83,13 @@ namespace mamba
         EnvironmentTransform build_activate(const fs::u8path& prefix);
 
         std::string activate(const fs::u8path& prefix, bool stack);
+        /**
+         * The environment variables after activating @p prefix, computed without a shell.
+         *
+         * Empty if the activation has scripts to source, which need one.
+         */
+        std::optional<std::map<std::string, std::string>>
+        activated_environment(const fs::u8path& prefix);
         std::string reactivate();
         std::string deactivate();
 
@@ -93,12 +101,24 @@ namespace mamba
 
     protected:
 
+        /** What the activation of a prefix reads from it, for the current shell. */
+        struct PrefixActivation
+        {
+            std::vector<std::pair<std::string, std::string>> env_vars;
+            std::vector<fs::u8path> activate_scripts;
+            std::vector<fs::u8path> deactivate_scripts;
+        };
+
         Activator();
 
+        /** Read once per prefix, from the activation cache when the prefix is unchanged. */
+        const PrefixActivation& prefix_activation(const fs::u8path& prefix);
+
         bool m_stack = false;
         ActivationType m_action;
 
         std::map<std::string, std::string> m_env;
+        std::map<std::string, PrefixActivation> m_prefix_activations;
     };
 
     class PosixActivator : public Activator
@@ -7,14 +7,21 @@
 #ifndef MAMBA_CORE_CHANNEL_HPP
 #define MAMBA_CORE_CHANNEL_HPP
 
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "mamba/core/match_spec.hpp"
 #include "mamba/core/package_cache.hpp"
 #include "mamba/core/validate.hpp"
+#include "mamba/util/bounded_cache.hpp"
 
 namespace mamba
 {
@@ -65,26 +72,26 @@ namespace mamba
         std::optional<std::string> m_auth;
         std::optional<std::string> m_token;
         std::optional<std::string> m_package_filename;
+        // Of the location and name, to quickly tell channels apart
+        std::size_t m_hash = 0;
 
         // This is used to make sure that there is a unique repo for every channel
         mutable std::unique_ptr<validation::RepoChecker> p_repo_checker;
 
         friend class ChannelContext;
+        friend bool operator==(const Channel& lhs, const Channel& rhs);
     };
 
     bool operator==(const Channel& lhs, const Channel& rhs);
     bool operator!=(const Channel& lhs, const Channel& rhs);
 
-
-    using ChannelCache = std::map<std::string, Channel>;
-
     class ChannelContext
     {
     public:
 
         using channel_list = std::vector<std::string>;
-        using channel_map = std::map<std::string, Channel>;
-        using multichannel_map = std::map<std::string, std::vector<std::string>>;
+        using channel_map = std::map<std::string, Channel, std::less<>>;
+        using multichannel_map = std::map<std::string, std::vector<std::string>, std::less<>>;
 
         ChannelContext();
         ~ChannelContext();
@@ -94,7 +101,8 @@ namespace mamba
         ChannelContext(ChannelContext&&) = delete;
         ChannelContext& operator=(ChannelContext&&) = delete;
 
-        const Channel& make_channel(const std::string& value);
+        /** Can be called from several threads, such as by concurrent solves. */
+        const Channel& make_channel(std::string_view value);
         std::vector<const Channel*> get_channels(const std::vector<std::string>& channel_names);
 
         const Channel& get_channel_alias() const;
@@ -102,7 +110,23 @@ namespace mamba
 
     private:
 
-        ChannelCache m_channel_cache;
+        /** Parsing a spec caches it in the context. */
+        friend class MatchSpec;
+
+        struct CachedChannel
+        {
+            std::string value;
+            Channel channel;
+        };
+
+        // Keyed by views of the stored values, to be looked up without allocating
+        using channel_cache = std::unordered_map<std::string_view, std::unique_ptr<CachedChannel>>;
+
+        channel_cache m_channel_cache;
+        // Recursive since making a channel may need another one
+        std::recursive_mutex m_channel_cache_mutex;
+        // The specs parsed with this context, by string
+        util::BoundedCache<MatchSpec> m_match_spec_cache{ 4096 };
         Channel m_channel_alias;
         channel_map m_custom_channels;
         multichannel_map m_custom_multichannels;
@@ -119,6 +143,8 @@ namespace mamba
             const std::string& channel_canonical_name
         );
 
+        Channel make_uncached_channel(const std::string& value);
+        std::optional<Channel> from_package_url(std::string_view url);
         Channel from_url(const std::string& url);
         Channel from_name(const std::string& name);
         Channel from_value(const std::string& value);
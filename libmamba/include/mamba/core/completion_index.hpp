@@ -0,0 +1,62 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_COMPLETION_INDEX_HPP
+#define MAMBA_CORE_COMPLETION_INDEX_HPP
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "mamba/core/mamba_fs.hpp"
+
+namespace mamba
+{
+    class MPool;
+
+    /**
+     * The names completed by the shell completion.
+     *
+     * Completion runs on every Tab press, where loading the configuration dominates the time.
+     * It is instead answered from this small file, written by the commands that already
+     * loaded the configuration and the channels.
+     */
+    class CompletionIndex
+    {
+    public:
+
+        /** In the user cache directory, since it is read before the configuration is known. */
+        static auto default_path() -> fs::u8path;
+
+        /** The index stored in @p path, if it exists and is valid. */
+        static auto read(const fs::u8path& path) -> std::optional<CompletionIndex>;
+
+        /** The directories holding named environments. */
+        [[nodiscard]] auto envs_dirs() const -> const std::vector<fs::u8path>&;
+        /** The names of the environments, from the cached listing of the directories. */
+        [[nodiscard]] auto env_names() const -> std::vector<std::string>;
+        /** The sorted names of the packages of the channels loaded so far. */
+        [[nodiscard]] auto package_names() const -> const std::vector<std::string>&;
+
+        /** Return whether the directories changed. */
+        auto set_envs_dirs(std::vector<fs::u8path> dirs) -> bool;
+        /** Add the names of the packages of a pool, returning whether any was new. */
+        auto add_package_names(const MPool& pool) -> bool;
+
+        /** Store the index, failures are only logged as completion falls back to a scan. */
+        void write(const fs::u8path& path) const;
+
+    private:
+
+        std::vector<fs::u8path> m_envs_dirs = {};
+        std::vector<std::string> m_package_names = {};
+    };
+
+    /** Update the stored index with the environment directories of the context and a pool. */
+    void update_completion_index(const MPool* pool = nullptr);
+}
+
+#endif
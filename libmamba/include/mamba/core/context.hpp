@@ -8,6 +8,7 @@
 #define MAMBA_CORE_CONTEXT_HPP
 
 #include <map>
+#include <mutex>
 #include <optional>
 #include <regex>
 #include <string>
@@ -134,6 +135,11 @@ namespace mamba
             int retry_timeout{ 2 };  // seconds
             int retry_backoff{ 3 };  // retry_timeout * retry_backoff
             int max_retries{ 3 };    // max number of retries
+            bool use_http2{ false };
+            int max_host_connections{ 0 };  // 0 for no per host limit
+            int download_chunks{ 1 };       // range requests per large download
+            std::size_t download_chunk_threshold{ 100 * 1024 * 1024 };  // bytes
+            bool download_direct_write{ false };
         };
 
         struct OutputParams
@@ -146,11 +152,17 @@ namespace mamba
 
             std::string log_pattern{ "%^%-9!l%-8n%$ %v" };
             std::size_t log_backtrace{ 0 };
+            bool log_async{ false };
+
+            fs::u8path trace_file{};
+            std::string progress_events{};  // "stderr" or a file path, empty when disabled
         };
 
         struct GraphicsParams
         {
             bool no_progress_bars{ false };
+            // Maximum number of times per second the progress bars are drawn
+            std::size_t progress_bar_max_refresh_rate{ 10 };
             Palette palette;
         };
 
@@ -158,6 +170,7 @@ namespace mamba
         {
             bool no_rc{ false };
             bool no_env{ false };
+            bool rc_cache{ true };
         };
 
         struct CommandParams
@@ -171,7 +184,12 @@ namespace mamba
         struct ThreadsParams
         {
             std::size_t download_threads{ 5 };
+            std::size_t max_download_threads{ 0 };  // adaptive download concurrency if larger
             int extract_threads{ 0 };
+            int link_threads{ 0 };
+            int compile_pyc_threads{ 0 };
+            int script_threads{ 1 };
+            int repodata_parse_threads{ 0 };
         };
 
         struct PrefixParams
@@ -189,6 +207,10 @@ namespace mamba
         // TODO check writable and add other potential dirs
         std::vector<fs::u8path> envs_dirs;
         std::vector<fs::u8path> pkgs_dirs;
+        // Maximum size in bytes of the packages of each writable cache, 0 for no limit
+        std::size_t pkgs_dirs_max_size = 0;
+        // Memory in bytes that loading and extracting may use concurrently, 0 for no limit
+        std::size_t memory_budget = 0;
         std::optional<std::string> env_lockfile;
 
         bool use_index_cache = false;
@@ -199,6 +221,15 @@ namespace mamba
         bool auto_activate_base = false;
 
         bool extract_sparse = false;
+        bool extract_streaming = false;
+        bool extract_dedup = false;
+        bool link_while_downloading = false;
+        bool prefetch_while_solving = false;
+        bool pip_while_linking = false;
+        // Nothing is kept in the package caches, for environments built in container images
+        bool container_build = false;
+        // Glob patterns of the package files to neither extract nor link
+        std::vector<std::string> exclude_files;
 
         bool dev = false;  // TODO this is always used as default=false and isn't set anywhere => to
                            // be removed if this is the case...
@@ -209,10 +240,19 @@ namespace mamba
         bool allow_softlinks = false;
         bool always_copy = false;
         bool always_softlink = false;
+        bool allow_reflinks = true;
+        bool relocation_cache = false;
 
         // solver options
         bool allow_uninstall = true;
         bool allow_downgrade = false;
+        bool solver_cache = false;
+        bool solver_minimal_change = false;
+        bool solver_portfolio = false;
+        bool prune_pool = false;
+        // budget of the conflict explanation, 0 for no limit
+        std::size_t explain_problems_timeout = 30;  // seconds
+        std::size_t explain_problems_max_nodes = 20000;
 
         // add start menu shortcuts on Windows (not implemented on Linux / macOS)
         bool shortcuts = true;
@@ -220,6 +260,10 @@ namespace mamba
         VerificationLevel safety_checks = VerificationLevel::kWarn;
         bool extra_safety_checks = false;
         bool verify_artifacts = false;
+        bool verify_package_cache = false;
+        // Local channels whose tarballs are trusted without computing their checksums
+        std::vector<fs::u8path> trusted_local_channels;
+        bool verify_index_cache = false;
 
         // debug helpers
         bool keep_temp_files = false;
@@ -227,6 +271,10 @@ namespace mamba
 
         bool change_ps1 = true;
         std::string env_prompt = "({default_env}) ";
+        bool activation_cache = true;
+        bool run_without_shell = true;
+        bool static_shell_hook = false;
+        bool virtual_packages_cache = true;
         bool ascii_only = false;
         // micromamba only
         bool shell_completion = true;
@@ -256,6 +304,9 @@ namespace mamba
         std::vector<std::string> channels;
         std::map<std::string, std::string> custom_channels;
         std::map<std::string, std::vector<std::string>> custom_multichannels;
+        std::map<std::string, std::vector<std::string>> channel_mirrors;
+        // Servers of package caches, such as ``micromamba server``, tried before the channels
+        std::vector<std::string> package_cache_peers;
 
         std::vector<std::string> default_channels = {
 #ifdef _WIN32
@@ -269,7 +320,20 @@ namespace mamba
         };
 
         std::string channel_alias = "https://conda.anaconda.org";
+        /**
+         * All the authentication information, loaded on first use.
+         *
+         * Not to be used while files are downloaded, as downloads may reload it from other
+         * threads. Use ``find_authentication_info`` there.
+         */
         std::map<std::string, AuthenticationInfo>& authentication_info();
+        /** A copy of the authentication information of @p key, if any, safe from any thread. */
+        std::optional<AuthenticationInfo> find_authentication_info(const std::string& key);
+        /**
+         * Read the authentication information again if the authentication file changed since it
+         * was read, as when ``micromamba login`` stored a refreshed token. Return whether it did.
+         */
+        bool reload_authentication_info();
         std::vector<fs::u8path> token_locations{ "~/.continuum/anaconda-client/tokens" };
 
         bool override_channels_enabled = true;
@@ -277,6 +341,22 @@ namespace mamba
         std::vector<std::string> pinned_packages = {};
 
         bool use_only_tar_bz2 = false;
+        // Stream repodata.json records into libsolv instead of using libsolv parser
+        bool experimental_repodata_parsing = false;
+        // Write the solv cache from a background task, not blocking the current command
+        bool background_solv_write = false;
+        // Update expired repodata caches with the JSON patches of repodata.jlap
+        bool repodata_use_jlap = false;
+        bool repodata_use_shards = false;
+        bool repodata_use_index = false;
+        bool repodata_subset_cache = false;
+        bool repodata_stale_while_revalidate = false;
+        bool repodata_shared_cache = false;
+        // Records left out of the indexes, by match spec, date, license and track feature
+        std::vector<std::string> repodata_exclude = {};
+        std::string repodata_as_of = "";
+        std::vector<std::string> repodata_exclude_licenses = {};
+        std::vector<std::string> repodata_exclude_track_features = {};
 
         std::vector<std::string> repodata_has_zst = { "https://conda.anaconda.org/conda-forge" };
 
@@ -299,6 +379,8 @@ namespace mamba
 
         void set_verbosity(int lvl);
         void set_log_level(log_level level);
+        // Switch to loggers writing on a background thread, for the rest of the process
+        void enable_async_logging();
 
     protected:
 
@@ -314,6 +396,8 @@ namespace mamba
         void load_authentication_info();
         std::map<std::string, AuthenticationInfo> m_authentication_info;
         bool m_authentication_infos_loaded = false;
+        fs::file_time_type m_authentication_file_time = {};
+        std::mutex m_authentication_info_mutex;
 
         std::shared_ptr<Logger> logger;
 
@@ -12,6 +12,7 @@
 #include <string>
 #include <typeindex>
 #include <unordered_map>
+#include <vector>
 
 #include <tl/expected.hpp>
 
@@ -108,11 +109,32 @@ namespace mamba
         std::vector<Package> m_packages;
     };
 
+    /// Selection of the packages of an environment lockfile, an empty field selecting all values.
+    struct EnvLockFileFilter
+    {
+        std::string platform;
+        std::vector<std::string> categories;
+    };
+
     /// Read an environment lock YAML file and returns it's structured content or an error if
     /// failed.
     tl::expected<EnvironmentLockFile, mamba_error>
     read_environment_lockfile(ChannelContext& channel_context, const fs::u8path& lockfile_location);
 
+    /// Read an environment lock YAML file, only keeping the packages selected by @p filter.
+    /// The selected packages are cached in @p cache_dir in a compact binary form keyed by the
+    /// content of the file, so that unchanged lockfiles are not parsed again.
+    /// An empty @p cache_dir disables the cache.
+    tl::expected<EnvironmentLockFile, mamba_error> read_environment_lockfile(
+        ChannelContext& channel_context,
+        const fs::u8path& lockfile_location,
+        const EnvLockFileFilter& filter,
+        const fs::u8path& cache_dir = {}
+    );
+
+    /// The default directory of the cache of parsed environment lockfiles.
+    fs::u8path env_lockfile_cache_dir();
+
 
     /// Returns `true` if the filename matches names of files which should be interpreted as conda
     /// environment lockfile. NOTE: this does not check if the file exists.
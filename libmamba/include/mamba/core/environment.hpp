@@ -54,6 +54,8 @@ namespace mamba
         std::map<std::string, std::string> copy();
         std::string platform();
         fs::u8path home_directory();
+        /** The directory for the user's non-essential cached data, shared by all prefixes. */
+        fs::u8path user_cache_dir();
 
         fs::u8path expand_user(const fs::u8path& path);
         fs::u8path shrink_user(const fs::u8path& path);
@@ -26,6 +26,9 @@ namespace mamba
         void unregister_env(const fs::u8path& location);
         std::set<fs::u8path> list_all_known_prefixes();
 
+        /** The environments directly in ``envs_dir``, probed concurrently. */
+        std::set<fs::u8path> list_envs_dir_prefixes(const fs::u8path& envs_dir);
+
     private:
 
         std::set<std::string>
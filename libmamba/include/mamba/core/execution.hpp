@@ -27,9 +27,9 @@ namespace mamba
     // itself the lifetime of the threads, or it can just use `MainExecutor::instance()`
     // to obtain a global static instance. In this last case, `MainExecutor::instance().close()`
     // have to be called before the end of `main()` to avoid undefined behaviors.
-    // WARNING: this is a temporary solution designed to evolve, the current implementation
-    // uses threads directly, a future implementation will use a thread-pool or other similar
-    // mechanisms.
+    // Each task runs on its own thread, so that tasks may block as long as needed,
+    // such as progress bars or tasks waiting for a download. Short tasks are better run
+    // on the thread pool of the library, which this executor waits for when closed.
     class MainExecutor
     {
     public:
@@ -122,6 +122,8 @@ namespace mamba
                 t.join();
             }
             threads.clear();
+
+            wait_thread_pool();
         }
 
         using on_close_handler = std::function<void()>;
@@ -150,6 +152,7 @@ namespace mamba
         std::recursive_mutex handlers_mutex;  // TODO: replace by synchronized_value once available
 
         void invoke_close_handlers();
+        void wait_thread_pool();
     };
 
 
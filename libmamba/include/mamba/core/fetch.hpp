@@ -7,6 +7,10 @@
 #ifndef MAMBA_CORE_FETCH_HPP
 #define MAMBA_CORE_FETCH_HPP
 
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -23,10 +27,13 @@ extern "C"
 #include "progress_bar.hpp"
 #include "validate.hpp"
 
+#define DOWNLOAD_PARTIAL_EXTENSION ".partial"
+
 namespace mamba
 {
     struct ZstdStream;
     struct Bzip2Stream;
+    class DownloadFile;
 
     class CURLHandle;
     class CURLMultiHandle;
@@ -74,10 +81,51 @@ namespace mamba
         void set_progress_bar(ProgressProxy progress_proxy);
         void set_expected_size(std::size_t size);
         void set_head_only(bool yes);
+        void set_range_start(std::size_t start);
+        /**
+         * Download ``url`` instead if the server does not have the file (403 or 404).
+         *
+         * The fallback is requested right away by the same transfer round, without counting
+         * as a retry, so that a file that may not exist costs no extra round trip.
+         * With @p on_any_error, it is also requested on connection errors and any error
+         * status, for servers that may be unavailable, such as package cache peers.
+         */
+        void set_fallback_url(const std::string& url, bool on_any_error = false);
+        /**
+         * Resume interrupted downloads from the data already written.
+         *
+         * The data is written to the filename with the ``.partial`` extension, renamed once
+         * the download is complete.
+         * Retries, and downloads finding such a partial file, request the rest of the data with
+         * a ``Range`` validated by the ``ETag`` or ``Last-Modified`` of the partial data.
+         * The whole file is downloaded again if the server does not support ranges or the
+         * file changed.
+         */
+        void set_resumable(bool yes);
+
+        /**
+         * Split the download in ``count`` concurrent range requests.
+         *
+         * The chunks are written at their offset in the file, preallocated to the expected size,
+         * and the download is finalized with ``finalize_chunks`` once they are all downloaded.
+         * Nothing is split if the download is not large enough, is decompressed while
+         * downloaded, resumed, or not over HTTP.
+         */
+        const std::vector<std::unique_ptr<DownloadTarget>>& split(std::size_t count);
+        const std::vector<std::unique_ptr<DownloadTarget>>& get_chunks() const;
+        /** Hash the assembled file and finalize the download, with the status of a full one. */
+        bool finalize_chunks();
+        /** Drop the chunks, to download the whole file in a single transfer instead. */
+        void merge_chunks();
 
         const std::string& get_name() const;
         const std::string& get_url() const;
 
+        /** The URLs of the file on the channel mirrors, the URL of the target first. */
+        const std::vector<std::string>& get_mirror_urls() const;
+        /** Download from another of the mirror URLs. */
+        void set_mirror(std::size_t index);
+
         const std::string& get_etag() const;
         const std::string& get_mod() const;
         const std::string& get_cache_control() const;
@@ -85,6 +133,8 @@ namespace mamba
         std::size_t get_expected_size() const;
         int get_http_status() const;
         std::size_t get_downloaded_size() const;
+        /** Bytes received so far by the current transfer. */
+        std::size_t get_transferred_size() const;
 
         std::size_t get_speed();
 
@@ -97,6 +147,27 @@ namespace mamba
             m_finalize_callback = std::bind(cb, data, std::placeholders::_1);
         }
 
+        inline void set_finalize_callback(std::function<bool(const DownloadTarget&)> cb)
+        {
+            m_finalize_callback = std::move(cb);
+        }
+
+        /**
+         * Observe the data written to the file, from the thread running the transfer.
+         *
+         * Only the first attempt is observed: the callback is dropped on retry, and when the
+         * download is resumed.
+         */
+        inline void set_data_callback(std::function<void(const char*, std::size_t)> cb)
+        {
+            m_data_callback = std::move(cb);
+        }
+
+        /** Hash the data written to the file while it is downloaded. */
+        void set_hash(validation::HashStream hash);
+        /** Hexadecimal digest of the downloaded file, if it was hashed while downloading. */
+        const std::optional<std::string>& get_hex_digest() const;
+
         void set_ignore_failure(bool yes)
         {
             m_ignore_failure = yes;
@@ -122,9 +193,6 @@ namespace mamba
         bool can_retry();
         bool retry();
 
-        std::chrono::steady_clock::time_point progress_throttle_time() const;
-        void set_progress_throttle_time(const std::chrono::steady_clock::time_point& time);
-
         const CURLHandle& get_curl_handle() const;
 
     private:
@@ -133,6 +201,9 @@ namespace mamba
         std::unique_ptr<Bzip2Stream> m_bzip2_stream;
         std::unique_ptr<CURLHandle> m_curl_handle;
         std::function<bool(const DownloadTarget&)> m_finalize_callback;
+        std::function<void(const char*, std::size_t)> m_data_callback;
+        std::optional<validation::HashStream> m_hash;
+        std::optional<std::string> m_hex_digest;
 
         std::string m_name, m_filename, m_url;
 
@@ -141,6 +212,19 @@ namespace mamba
         char* m_effective_url;
 
         std::string m_etag, m_mod, m_cache_control;
+        std::vector<std::string> m_conditional_headers;
+
+        std::string m_fallback_url;
+        bool m_fallback_on_any_error = false;
+
+        // The authorization header sent to the host, retried once if a new token is found
+        std::string m_authorization;
+        bool m_authorization_refreshed = false;
+
+        // mirrors
+        std::vector<std::string> m_mirror_urls;
+        std::size_t m_mirror;
+        std::size_t m_failed_mirrors;
 
         // validation
         std::size_t m_expected_size;
@@ -153,15 +237,71 @@ namespace mamba
         bool m_has_progress_bar;
         bool m_ignore_failure;
 
+        // resume
+        bool m_resumable;
+        std::size_t m_resume_offset;
+        std::optional<std::size_t> m_range_start;
+
+        // chunks
+        std::vector<std::unique_ptr<DownloadTarget>> m_chunks;
+        DownloadTarget* p_parent;
+        std::size_t m_chunk_start;
+        std::size_t m_chunk_size;
+        bool m_range_refused;
+
         ProgressProxy m_progress_bar;
 
-        std::ofstream m_file;
+        std::unique_ptr<DownloadFile> m_file;
 
         std::function<void(ProgressBarRepr&)> download_repr();
 
-        std::chrono::steady_clock::time_point m_progress_throttle_time;
+        std::string partial_filename() const;
+        void prepare_resume();
+        bool write_data(const char* data, std::size_t size);
+        bool open_file();
+        void complete_file();
+        bool finish(std::size_t avg_speed);
+        bool needs_fallback();
+        bool needs_new_authorization();
+        void reset_curl_target();
     };
 
+    /**
+     * Adapt the number of concurrent transfers to the measured throughput.
+     *
+     * The limit grows while the aggregate throughput does, and is halved when transfers stall
+     * or the server asks to slow down.
+     */
+    class DownloadConcurrency
+    {
+    public:
+
+        DownloadConcurrency(std::size_t initial, std::size_t max);
+
+        std::size_t limit() const;
+
+        /** Report the aggregate throughput, in bytes per second, over a period at the limit. */
+        void update(std::size_t throughput);
+        /** Halve the limit, at most once per period. */
+        void back_off();
+
+    private:
+
+        std::size_t m_limit;
+        std::size_t m_max;
+        std::size_t m_throughput = 0;
+        bool m_backed_off = false;
+    };
+
+    /**
+     * Order targets to minimize the total download time on ``slots`` concurrent transfers.
+     *
+     * The largest payloads are started first so that none of them is left running alone at
+     * the end. The remaining ones alternate between the larger and the smaller payloads, so
+     * that quick transfers keep freed slots busy while the large ones share the bandwidth.
+     */
+    void schedule_downloads(std::vector<DownloadTarget*>& targets, std::size_t slots);
+
     class MultiDownloadTarget
     {
     public:
@@ -172,18 +312,60 @@ namespace mamba
         void add(DownloadTarget* target);
         bool download(int options);
 
+        /** Call @p cb with the numbers of finished and total targets as targets finish. */
+        void set_progress_callback(std::function<void(std::size_t, std::size_t)> cb);
+
+        /** The maximum number of concurrent transfers, as last adapted. */
+        std::size_t concurrency() const;
+        /** Time taken by the last download, in seconds. */
+        double elapsed_time() const;
+        /** Total time projected from the throughput after the first second, if any. */
+        std::optional<double> estimated_time() const;
+        /** Bytes transferred by failed attempts, that were downloaded again on retry. */
+        std::size_t retried_bytes() const;
+
     private:
 
-        bool check_msgs(bool failfast);
+        std::size_t check_msgs(bool failfast);
+        std::size_t check_chunk(DownloadTarget& target, DownloadTarget& chunk, bool failfast);
+        std::size_t start_transfer(DownloadTarget& target);
+        void select_mirror(DownloadTarget& target);
+        void record_mirror_speed(DownloadTarget& target, bool failed);
+        void schedule_retry(DownloadTarget& target);
+        std::size_t start_transfers(std::size_t running);
+        void sample_throughput();
+        void target_finished();
 
         std::vector<DownloadTarget*> m_targets;
         std::vector<DownloadTarget*> m_retry_targets;
+        std::map<const DownloadTarget*, std::size_t> m_finished_chunks;
+
+        struct MirrorStats
+        {
+            std::optional<double> speed;
+            std::size_t assigned = 0;
+        };
+        std::map<std::string, MirrorStats> m_mirror_stats;
         std::unique_ptr<CURLMultiHandle> p_curl_handle;
+
+        bool m_adaptive;
+        DownloadConcurrency m_concurrency;
+        std::size_t m_started = 0;
+        std::size_t m_sampled_size = 0;
+        std::chrono::steady_clock::time_point m_sample_time;
+        std::chrono::steady_clock::time_point m_start_time;
+        double m_elapsed_time = 0;
+        std::optional<double> m_estimated_time;
+        std::size_t m_retried_bytes = 0;
+        std::function<void(std::size_t, std::size_t)> m_progress_callback;
+        std::size_t m_finished_targets = 0;
     };
 
     const int MAMBA_DOWNLOAD_FAILFAST = 1 << 0;
     const int MAMBA_DOWNLOAD_SORT = 1 << 1;
     const int MAMBA_NO_CLEAR_PROGRESS_BARS = 1 << 2;
+    // Do not print progress, such as for downloads in the background
+    const int MAMBA_NO_PROGRESS_BARS = 1 << 3;
 }  // namespace mamba
 
 #endif  // MAMBA_FETCH_HPP
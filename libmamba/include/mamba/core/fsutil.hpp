@@ -7,6 +7,7 @@
 #ifndef MAMBA_CORE_FS_UTIL
 #define MAMBA_CORE_FS_UTIL
 
+#include <string>
 #include <system_error>
 
 namespace fs
@@ -44,6 +45,30 @@ namespace mamba
          */
         void rename_or_move(const fs::u8path& from, const fs::u8path& to, std::error_code& ec);
 
+        /**
+         * Create ``to`` as a copy-on-write clone of the file ``from``, with the same permissions.
+         *
+         * On failure, ``to`` is not created and the error code is set, to
+         * ``std::errc::operation_not_supported`` on systems without file cloning.
+         */
+        void clone_file(const fs::u8path& from, const fs::u8path& to, std::error_code& ec);
+
+        /** The file system holding a path. */
+        struct FilesystemInfo
+        {
+            /** Name of the file system type, such as ``ext4``, or its identifier if unknown. */
+            std::string type;
+            /** Whether the files are on a remote machine, such as with NFS or SMB. */
+            bool network = false;
+        };
+
+        /**
+         * The file system holding the existing path @p path.
+         *
+         * Sets the error code on failure, and to ``std::errc::operation_not_supported`` on
+         * systems where it is not detected.
+         */
+        FilesystemInfo filesystem_info(const fs::u8path& path, std::error_code& ec);
     }
 }
 #endif
@@ -48,6 +48,12 @@ namespace mamba
 
         std::vector<ParseResult> parse();
         bool parse_comment_line(const std::string& line, UserRequest& req);
+        /**
+         * The requests recorded in the history file.
+         *
+         * Parsed requests are kept in a binary index next to the history file, so that only
+         * the entries added since it was last read are parsed.
+         */
         std::vector<UserRequest> get_user_requests();
         std::unordered_map<std::string, MatchSpec> get_requested_specs_map();
         void add_entry(const History::UserRequest& entry);
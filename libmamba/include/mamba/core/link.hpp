@@ -7,6 +7,7 @@
 #ifndef MAMBA_CORE_LINK
 #define MAMBA_CORE_LINK
 
+#include <optional>
 #include <stack>
 #include <string>
 #include <tuple>
@@ -42,37 +43,126 @@ namespace mamba
         std::string command, module, func;
     };
 
+    python_entry_point_parsed parse_entry_point(const std::string& ep_def);
+
+    /**
+     * The files of an extracted package and the paths they are linked to in a prefix.
+     *
+     * It is computed once per package of a transaction, and used both to order the
+     * transaction by the files the packages share and to link the package.
+     */
+    struct LinkPlan
+    {
+        /** The extracted package. */
+        fs::u8path source;
+        /** The files to link, in the order of ``paths.json``. */
+        std::vector<PathData> files;
+        /** The paths of ``files`` relative to the prefix, for ``noarch: python`` packages too. */
+        std::vector<std::string> targets;
+        /** The files left out by ``exclude_files``, or already when the package was extracted. */
+        std::vector<std::string> excluded_files;
+        bool noarch_python = false;
+    };
+
+    /**
+     * The link plan of the package extracted in @p pkg_dir into the prefix of @p context.
+     *
+     * The files of ``noarch: python`` packages are mapped to the site-packages and bin
+     * directories when @p noarch_python is set.
+     */
+    LinkPlan make_link_plan(
+        const fs::u8path& pkg_dir,
+        const TransactionContext& context,
+        bool noarch_python
+    );
+
+    /** Remove the directories that are empty, then their parents up to the prefix. */
+    void remove_empty_directories(std::vector<fs::u8path> directories, const fs::u8path& prefix);
+
+    /**
+     * Install the packages of the prefix @p source in the new prefix @p target.
+     *
+     * The files of the packages are hard-linked, or cloned when they were copied, from the
+     * source prefix without solving, downloading, nor running the package scripts. Only the
+     * files relocated when linking, whose checksum changed, are rewritten with the new prefix,
+     * from the package cache for binary files relocated to a longer prefix.
+     * The records, history and pinned specs of the source prefix are copied.
+     *
+     * @throw std::length_error if a binary file must be relocated to a longer prefix, but its
+     * package is not in the cache anymore.
+     */
+    void clone_prefix(const fs::u8path& source, const fs::u8path& target);
+
     class UnlinkPackage
     {
     public:
 
+        /**
+         * Unlink the paths of the record of the package.
+         *
+         * The files are removed concurrently, then the emptied directories once, from the
+         * deepest.
+         */
         UnlinkPackage(const PackageInfo& pkg_info, const fs::u8path& cache_path, TransactionContext* context);
 
+        /**
+         * Unlink the given paths instead of the ones read from the record of the package.
+         *
+         * The emptied directories are not removed but listed by ``unlinked_directories``, so
+         * that other packages can be linked concurrently in the same directories.
+         */
+        UnlinkPackage(
+            const PackageInfo& pkg_info,
+            const fs::u8path& cache_path,
+            TransactionContext* context,
+            std::vector<std::string> paths
+        );
+
         bool execute();
         bool undo();
 
+        const std::vector<fs::u8path>& unlinked_directories() const;
+
     private:
 
-        bool unlink_path(const nlohmann::json& path_data);
+        bool unlink_path(const std::string& subtarget);
 
         PackageInfo m_pkg_info;
         fs::u8path m_cache_path;
         std::string m_specifier;
         TransactionContext* m_context;
+        std::optional<std::vector<std::string>> m_paths;
+        std::vector<fs::u8path> m_unlinked_directories;
     };
 
     class LinkPackage
     {
     public:
 
-        LinkPackage(const PackageInfo& pkg_info, const fs::u8path& cache_path, TransactionContext* context);
+        /**
+         * Link the package extracted in @p cache_path.
+         *
+         * Its ``info/repodata_record.json`` is read from the cache, unless already loaded in
+         * @p repodata_record, and its files are read unless already planned in @p plan.
+         */
+        LinkPackage(
+            const PackageInfo& pkg_info,
+            const fs::u8path& cache_path,
+            TransactionContext* context,
+            nlohmann::json repodata_record = nullptr,
+            std::optional<LinkPlan> plan = std::nullopt
+        );
 
         bool execute();
         bool undo();
 
     private:
 
-        std::tuple<std::string, std::string> link_path(const PathData& path_data, bool noarch_python);
+        /** Relinking an unlinked package while rolling back, after an interruption. */
+        friend class UnlinkPackage;
+
+        std::tuple<std::string, std::string>
+        link_path(const PathData& path_data, const std::string& target);
         std::vector<fs::u8path> compile_pyc_files(const std::vector<fs::u8path>& py_files);
         auto
         create_python_entry_point(const fs::u8path& path, const python_entry_point_parsed& entry_point);
@@ -86,7 +176,10 @@ namespace mamba
         fs::u8path m_cache_path;
         fs::u8path m_source;
         std::vector<std::string> m_clobber_warnings;
+        nlohmann::json m_repodata_record;
+        std::optional<LinkPlan> m_plan;
         TransactionContext* m_context;
+        bool m_interruptible = true;
     };
 
 }  // namespace mamba
@@ -0,0 +1,86 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_MEMORY_BUDGET_HPP
+#define MAMBA_CORE_MEMORY_BUDGET_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+
+namespace mamba
+{
+    /**
+     * Memory that the concurrent operations of the process may use, set by ``memory_budget``.
+     *
+     * Operations reserve an estimate of the memory they need before starting.
+     * Blocking reservations wait while the memory reserved by the others is needed, but are
+     * granted when nothing else is reserved, so that an operation larger than the whole budget
+     * still runs, alone.
+     * A limit of 0 means no limit.
+     */
+    class MemoryBudget
+    {
+    public:
+
+        /** Memory reserved until destroyed or released. */
+        class Reservation
+        {
+        public:
+
+            Reservation() = default;
+            ~Reservation();
+
+            Reservation(const Reservation&) = delete;
+            Reservation& operator=(const Reservation&) = delete;
+            Reservation(Reservation&& other) noexcept;
+            Reservation& operator=(Reservation&& other) noexcept;
+
+            auto size() const -> std::size_t;
+            void release();
+
+        private:
+
+            friend class MemoryBudget;
+
+            Reservation(MemoryBudget* budget, std::size_t size);
+
+            MemoryBudget* p_budget = nullptr;
+            std::size_t m_size = 0;
+        };
+
+        /** The budget of the process. */
+        static MemoryBudget& instance();
+
+        explicit MemoryBudget(std::size_t limit = 0);
+
+        MemoryBudget(const MemoryBudget&) = delete;
+        MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+        auto limit() const -> std::size_t;
+        void set_limit(std::size_t limit);
+        auto reserved() const -> std::size_t;
+
+        /** Wait until @p size bytes fit in the budget, or nothing else is reserved. */
+        auto reserve(std::size_t size) -> Reservation;
+
+        /** Reserve @p size bytes only if they fit in the budget right away. */
+        auto try_reserve(std::size_t size) -> std::optional<Reservation>;
+
+    private:
+
+        mutable std::mutex m_mutex = {};
+        std::condition_variable m_cv = {};
+        std::size_t m_limit;
+        std::size_t m_reserved = 0;
+
+        auto fits(std::size_t size) const -> bool;
+        void release(std::size_t size);
+    };
+}
+
+#endif
@@ -0,0 +1,119 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_METRICS_HPP
+#define MAMBA_CORE_METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mamba
+{
+    /** A value that only increases, such as a number of downloaded bytes. */
+    class MetricCounter
+    {
+    public:
+
+        void add(double value = 1);
+        [[nodiscard]] auto value() const -> double;
+
+    private:
+
+        std::atomic<double> m_value = 0;
+    };
+
+    /** Observations, such as durations, counted in buckets of increasing upper bounds. */
+    class MetricHistogram
+    {
+    public:
+
+        using clock = std::chrono::steady_clock;
+
+        struct Snapshot
+        {
+            std::vector<double> bounds;
+            /** Number of observations less than or equal to each bound. */
+            std::vector<std::size_t> cumulative_counts;
+            std::size_t count = 0;
+            double sum = 0;
+        };
+
+        explicit MetricHistogram(std::vector<double> bounds);
+
+        void observe(double value);
+        /** Observe the seconds elapsed since @p start. */
+        void observe_since(clock::time_point start);
+
+        [[nodiscard]] auto snapshot() const -> Snapshot;
+
+    private:
+
+        mutable std::mutex m_mutex = {};
+        std::vector<double> m_bounds;
+        std::vector<std::size_t> m_counts;
+        std::size_t m_count = 0;
+        double m_sum = 0;
+    };
+
+    /**
+     * Counters and histograms of a process, such as the solves and downloads of a server.
+     *
+     * Metrics are created on first use and live as long as the process, so that call sites
+     * can keep a reference to them in a function-local static.
+     * They are always recorded, being cheap compared to what they measure, and exposed in the
+     * Prometheus text format.
+     */
+    class Metrics
+    {
+    public:
+
+        static auto instance() -> Metrics&;
+
+        /** Bounds in seconds, from a few milliseconds to several minutes. */
+        [[nodiscard]] static auto default_seconds_bounds() -> std::vector<double>;
+
+        /**
+         * The counter named @p name, created with @p help on first use.
+         *
+         * @throw std::invalid_argument if @p name is a histogram.
+         */
+        auto counter(const std::string& name, std::string help) -> MetricCounter&;
+
+        /**
+         * The histogram named @p name, created with @p help and @p bounds on first use.
+         *
+         * @throw std::invalid_argument if @p name is a counter.
+         */
+        auto histogram(
+            const std::string& name,
+            std::string help,
+            std::vector<double> bounds = default_seconds_bounds()
+        ) -> MetricHistogram&;
+
+        /** All the metrics, sorted by name, in the Prometheus text exposition format. */
+        [[nodiscard]] auto to_prometheus() const -> std::string;
+
+    private:
+
+        struct Entry
+        {
+            std::string help;
+            std::unique_ptr<MetricCounter> counter = nullptr;
+            std::unique_ptr<MetricHistogram> histogram = nullptr;
+        };
+
+        mutable std::mutex m_mutex = {};
+        std::map<std::string, Entry> m_entries = {};
+    };
+}
+
+#endif
@@ -76,6 +76,30 @@ namespace mamba
             std::vector<std::vector<FormattedString>> m_table;
         };
 
+        /**
+         * A table printed one row at a time, for outputs too large to hold all their rows.
+         *
+         * The width of the columns must be known before printing, so the rows are first given
+         * to ``fit``, then formatted again to be printed.
+         * The output is the same as a left aligned ``Table`` without group headers.
+         */
+        class StreamedTable
+        {
+        public:
+
+            StreamedTable(const std::vector<FormattedString>& header);
+
+            void fit(const std::vector<FormattedString>& row);
+
+            void print_header(std::ostream& out) const;
+            void print_row(std::ostream& out, const std::vector<FormattedString>& row) const;
+
+        private:
+
+            std::vector<FormattedString> m_header;
+            std::vector<std::size_t> m_cell_sizes;
+        };
+
         std::ostringstream table_like(const std::vector<std::string>& data, std::size_t max_width);
     }  // namespace printers
 
@@ -122,6 +146,9 @@ namespace mamba
         void json_down(const std::string& key);
         void json_up();
 
+        /** Write ``event`` as a JSON line to the ``progress_events`` sink, if any. */
+        void progress_event(const nlohmann::json& event);
+
         static void print_buffer(std::ostream& ostream);
 
         void cancel_json_print();
@@ -141,6 +168,45 @@ namespace mamba
         friend class ProgressProxy;
     };
 
+    /**
+     * Write a JSON array one element at a time, as dumping the whole array with an indent of 4.
+     *
+     * Elements are serialized to a buffer of fixed capacity, written to the stream whenever
+     * full, so that neither the array nor its text are held in memory for large outputs.
+     */
+    class JsonArrayWriter
+    {
+    public:
+
+        /**
+         * @param level The nesting level of the array in the document, for its indentation.
+         */
+        explicit JsonArrayWriter(
+            std::ostream& out,
+            std::size_t level = 0,
+            std::size_t buffer_size = std::size_t(1) << 16
+        );
+        /** Write what is buffered, without closing the array. */
+        ~JsonArrayWriter();
+
+        JsonArrayWriter(const JsonArrayWriter&) = delete;
+        JsonArrayWriter& operator=(const JsonArrayWriter&) = delete;
+
+        void append(const nlohmann::json& element);
+        /** Close the array and write it to the stream. */
+        void finish();
+
+    private:
+
+        std::ostream& m_out;
+        std::string m_buffer;
+        std::size_t m_level;
+        std::size_t m_buffer_size;
+        bool m_empty = true;
+
+        void flush(std::size_t min_size);
+    };
+
     class MessageLogger
     {
     public:
@@ -150,6 +216,9 @@ namespace mamba
 
         std::stringstream& stream();
 
+        /** Whether a message of ``level`` would be logged, or kept in the backtrace. */
+        static bool enabled(log_level level);
+
         static void activate_buffer();
         static void deactivate_buffer();
         static void print_buffer(std::ostream& ostream);
@@ -164,6 +233,14 @@ namespace mamba
         static void emit(const std::string& msg, const log_level& level);
     };
 
+    // Gives a disabled log and an emitted one the same type in the LOG macro
+    struct MessageLoggerVoidify
+    {
+        void operator&(std::ostream&)
+        {
+        }
+    };
+
 }  // namespace mamba
 
 #undef LOG
@@ -174,7 +251,12 @@ namespace mamba
 #undef LOG_ERROR
 #undef LOG_CRITICAL
 
-#define LOG(severity) mamba::MessageLogger(__FILE__, __LINE__, severity).stream()
+// The streamed arguments are neither evaluated nor formatted when the level is disabled
+#define LOG(severity)                                                                              \
+    !mamba::MessageLogger::enabled(severity)                                                       \
+        ? (void) 0                                                                                 \
+        : mamba::MessageLoggerVoidify()                                                            \
+              & mamba::MessageLogger(__FILE__, __LINE__, severity).stream()
 #define LOG_TRACE LOG(mamba::log_level::trace)
 #define LOG_DEBUG LOG(mamba::log_level::debug)
 #define LOG_INFO LOG(mamba::log_level::info)
@@ -8,17 +8,22 @@
 #define MAMBA_CORE_PACKAGE_CACHE
 
 #include <map>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "fsutil.hpp"
 #include "mamba_fs.hpp"
 #include "package_info.hpp"
+#include "util.hpp"
 
 #define PACKAGE_CACHE_MAGIC_FILE "urls.txt"
 
 namespace mamba
 {
+    class PackageCacheLedger;
+
     enum class Writable
     {
         UNKNOWN,
@@ -40,17 +45,38 @@ namespace mamba
         fs::u8path path() const;
         void clear_query_cache(const PackageInfo& s);
 
+        /**
+         * Whether the tarball of a package is in the cache, with the expected size and checksum.
+         *
+         * Checksums are recorded in a ledger in the cache, and are not computed again for the
+         * tarballs that did not change since, unless ``verify_package_cache`` is set.
+         */
         bool has_valid_tarball(const PackageInfo& s);
         bool has_valid_extracted_dir(const PackageInfo& s);
 
+        /**
+         * Directory of the pyc files compiled from the sources of a ``noarch: python`` package.
+         *
+         * It is inside the extracted directory, so it is removed along with it, and holds the
+         * pyc files at their path in the prefix, for a Python version such as "3.11".
+         */
+        static fs::u8path
+        get_pyc_cache_dir(const fs::u8path& extracted_dir, const std::string& short_python_version);
+
     private:
 
         void check_writable();
+        bool check_tarball(const PackageInfo& s) const;
+        bool check_extracted_dir(const PackageInfo& s) const;
+        auto tarball_checksum(const std::string& filename, bool sha256) const -> std::string;
 
         std::map<std::string, bool> m_valid_tarballs;
         std::map<std::string, bool> m_valid_extracted_dir;
         Writable m_writable = Writable::UNKNOWN;
         fs::u8path m_path;
+        std::shared_ptr<PackageCacheLedger> m_ledger;
+
+        friend class MultiPackageCache;
     };
 
     class MultiPackageCache
@@ -70,12 +96,34 @@ namespace mamba
 
         void clear_query_cache(const PackageInfo& s);
 
+        /**
+         * Validate the caches of many packages concurrently, from @p n_threads threads.
+         *
+         * The results are reused by ``get_extracted_dir_path`` and ``get_tarball_path``, so
+         * that checking all the packages of a transaction hides the latency of the file system,
+         * such as with network file systems.
+         * As when fetching packages, tarballs are only checked for the packages without a valid
+         * extracted directory.
+         */
+        void validate(const std::vector<PackageInfo>& pkgs, std::size_t n_threads);
+
     private:
 
         std::vector<PackageCacheData> m_caches;
         std::map<std::string, fs::u8path> m_cached_tarballs;
         std::map<std::string, fs::u8path> m_cached_extracted_dirs;
     };
+
+    /**
+     * Lock the entry of a package in a cache, such as its extracted directory.
+     *
+     * Writers replacing the extracted directory lock it exclusively, while readers validating
+     * it share the lock, so that packages never wait for other packages.
+     * The lock-files are in the ``.locks`` directory of the cache.
+     * Empty if the cache is not writable, or if file locking is disabled.
+     */
+    auto lock_package_entry(const fs::u8path& pkgs_dir, const std::string& filename, LockMode mode)
+        -> std::optional<LockFile>;
 }  // namespace mamba
 
 #endif
@@ -8,22 +8,34 @@
 #ifndef MAMBA_CORE_PACKAGE_DOWNLOAD_HPP
 #define MAMBA_CORE_PACKAGE_DOWNLOAD_HPP
 
+#include <atomic>
+#include <functional>
 #include <future>
 #include <memory>
 #include <set>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
 
+#include <nlohmann/json.hpp>
+
 #include "fetch.hpp"
 #include "mamba_fs.hpp"
+#include "memory_budget.hpp"
 #include "package_cache.hpp"
+#include "package_handling.hpp"
 #include "progress_bar.hpp"
 #include "thread_utils.hpp"
+#include "util.hpp"
 
 namespace mamba
 {
     class ChannelContext;
+    class MatchSpec;
+    class MPool;
+    class PrefixData;
+    struct Solution;
 
     class PackageDownloadExtractTarget
     {
@@ -39,7 +51,17 @@ namespace mamba
             EXTRACT_ERROR
         };
 
+        using finished_callback_type = std::function<void(PackageDownloadExtractTarget&)>;
+
         PackageDownloadExtractTarget(const PackageInfo& pkg_info, ChannelContext& channel_context);
+        ~PackageDownloadExtractTarget();
+
+        /**
+         * Called once the package is extracted, or failed to, from the thread that handled it.
+         *
+         * Set before calling ``target``, which can already find the package extracted.
+         */
+        void set_finished_callback(finished_callback_type callback);
 
         void write_repodata_record(const fs::u8path& base_path);
         void add_url();
@@ -50,6 +72,14 @@ namespace mamba
         bool extract_from_cache();
         bool validate_extract();
         const std::string& name() const;
+        const PackageInfo& package_info() const;
+        /** The directory of the extracted package, in the cache. */
+        fs::u8path extract_path() const;
+        /**
+         * Move out the ``info/repodata_record.json`` written when extracting the package, so
+         * that it is linked without reading it back. Null if the package was already extracted.
+         */
+        nlohmann::json take_repodata_record();
         std::size_t expected_size() const;
         VALIDATION_RESULT validation_result() const;
         void clear_cache() const;
@@ -60,8 +90,10 @@ namespace mamba
 
     private:
 
-        bool m_finished;
+        std::atomic<bool> m_finished = false;
+        finished_callback_type m_finished_callback;
         PackageInfo m_package_info;
+        nlohmann::json m_repodata_record;
 
         std::string m_sha256, m_md5;
         std::size_t m_expected_size;
@@ -69,16 +101,40 @@ namespace mamba
         bool m_has_progress_bars = false;
         ProgressProxy m_download_bar, m_extract_bar;
         std::unique_ptr<DownloadTarget> m_target;
+        // The download from a package cache peer, once replaced by one from the channel
+        std::unique_ptr<DownloadTarget> m_peer_target;
 
         std::string m_url, m_name, m_filename;
         fs::u8path m_tarball_path, m_cache_path;
+        // Where the package is extracted before being published in the cache
+        fs::u8path m_staging_path;
+        // Whether the tarball is read in place from a local channel instead of downloaded
+        bool m_local_tarball = false;
 
         std::future<bool> m_extract_future;
 
+        // Extraction while downloading
+        std::unique_ptr<CondaStreamExtractor> m_stream_extractor;
+        MemoryBudget::Reservation m_stream_memory;
+        std::size_t m_streamed_size = 0;
+        std::promise<bool> m_stream_extracted;
+
         VALIDATION_RESULT m_validation_result = VALIDATION_RESULT::UNDEFINED;
 
         std::function<void(ProgressBarRepr&)> extract_repr();
         std::function<void(ProgressProxy&)> extract_progress_callback();
+
+        fs::u8path make_staging_path() const;
+        void publish_extracted();
+        void stream_data(const char* data, std::size_t size);
+        void stream_extract();
+        bool is_fully_streamed() const;
+        void abort_stream_extract();
+        /** Whether the tarball was downloaded from a package cache peer. */
+        bool downloaded_from_peer() const;
+        /** Download the tarball from the channel again, after a peer sent an invalid one. */
+        bool download_from_channel();
+        void set_finished();
     };
 
     class DownloadExtractSemaphore
@@ -94,6 +150,64 @@ namespace mamba
 
         friend class PackageDownloadExtractTarget;
     };
+
+    /**
+     * Download in the background the packages likely to be installed, while solving.
+     *
+     * With ``prefetch_while_solving``, the latest builds of the requested packages, allowed
+     * by the pins, are downloaded next to the first writable package cache.
+     * Once solved, @ref finish moves the ones that the solution installs and that are valid
+     * to the cache, where the transaction finds them, and discards the others.
+     */
+    class PackagePrefetch
+    {
+    public:
+
+        PackagePrefetch();
+        ~PackagePrefetch();
+
+        PackagePrefetch(const PackagePrefetch&) = delete;
+        PackagePrefetch& operator=(const PackagePrefetch&) = delete;
+        PackagePrefetch(PackagePrefetch&&) = delete;
+        PackagePrefetch& operator=(PackagePrefetch&&) = delete;
+
+        /**
+         * Start downloading the packages of @p specs missing from @p caches.
+         *
+         * The candidates are selected from @p pool right away, so that the pool can be
+         * used by the solver while downloading. Packages installed in @p prefix are skipped.
+         */
+        void start(
+            MPool& pool,
+            MultiPackageCache& caches,
+            const PrefixData& prefix,
+            const std::vector<std::string>& specs,
+            const std::vector<MatchSpec>& pins
+        );
+
+        /**
+         * Wait for the downloads, and keep the packages installed by @p solution.
+         *
+         * Returns the number of packages moved to the cache.
+         */
+        std::size_t finish(const Solution& solution);
+
+    private:
+
+        struct Prefetched
+        {
+            PackageInfo package;
+            std::unique_ptr<TemporaryFile> file;
+            std::unique_ptr<DownloadTarget> target;
+        };
+
+        MultiPackageCache* m_caches = nullptr;
+        fs::u8path m_cache_path;
+        std::vector<Prefetched> m_prefetched;
+        std::thread m_thread;
+
+        void wait();
+    };
 }  // namespace mamba
 
 #endif
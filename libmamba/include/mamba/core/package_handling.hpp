@@ -7,8 +7,13 @@
 #ifndef MAMBA_CORE_PACKAGE_HANDLING_HPP
 #define MAMBA_CORE_PACKAGE_HANDLING_HPP
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
 #include <system_error>
+#include <utility>
 #include <vector>
 
 #include "mamba_fs.hpp"
@@ -45,14 +50,108 @@ namespace mamba
         const std::vector<std::string>& parts = { "info", "pkg" }
     );
     void extract(const fs::u8path& file, const fs::u8path& destination);
+    /**
+     * Extract the package @p file without its files matching one of the glob @p exclude
+     * patterns, as checked by ``is_excluded_path``.
+     *
+     * The files left out are listed in the extracted directory, see ``read_excluded_paths``.
+     */
+    void extract(
+        const fs::u8path& file,
+        const fs::u8path& destination,
+        const std::vector<std::string>& exclude
+    );
     fs::u8path extract(const fs::u8path& file);
+
+    /**
+     * Extract the packages @p files next to them, from @p n_threads threads.
+     *
+     * ``on_extract`` is called with the index of each package before it is extracted, never
+     * concurrently.
+     * The first failure stops the extraction and is rethrown.
+     *
+     * @return The extracted directories, in the order of @p files.
+     */
+    std::vector<fs::u8path> extract_all(
+        const std::vector<fs::u8path>& files,
+        std::size_t n_threads,
+        const std::function<void(std::size_t)>& on_extract = {}
+    );
+
+    /**
+     * Extract a ``.conda`` package from its bytes while they are being received.
+     *
+     * Bytes are given to ``write`` while ``extract`` runs on another thread, which fails if
+     * ``abort`` is called or if more than ``max_buffered`` bytes are waiting to be extracted.
+     */
+    class CondaStreamExtractor
+    {
+    public:
+
+        explicit CondaStreamExtractor(std::size_t max_buffered = 64 << 20);
+
+        /** Return false if the bytes are not used anymore. */
+        bool write(const char* data, std::size_t size);
+        /** Signal that all the bytes were written. */
+        void close();
+        void abort();
+
+        /** Extract the package, without its files matching one of the @p exclude patterns. */
+        void extract(const fs::u8path& dest_dir, const std::vector<std::string>& exclude = {});
+
+    private:
+
+        bool next_chunk();
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::deque<std::string> m_chunks;
+        std::string m_reading;
+        std::size_t m_buffered = 0;
+        std::size_t m_max_buffered;
+        bool m_closed = false;
+        bool m_aborted = false;
+        bool m_done = false;
+    };
+
     void extract_subproc(const fs::u8path& file, const fs::u8path& dest);
+
+    /**
+     * Convert a package between the ``.tar.bz2`` and ``.conda`` formats.
+     *
+     * Entries are streamed from the source archive to the target one without being extracted
+     * to disk.
+     * A ``compression_level`` of -1 uses the default of the target format (15 for ``.conda``,
+     * 9 for ``.tar.bz2``), and zstd uses all the cores if ``compression_threads`` is 0.
+     */
     bool transmute(
         const fs::u8path& pkg_file,
         const fs::u8path& target,
         int compression_level,
         int compression_threads
     );
+
+    /**
+     * Transmute the ``(pkg_file, target)`` pairs of ``packages``, ``n_jobs`` at a time.
+     *
+     * Packages are transmuted even if others fail, and the error of each failed package is
+     * returned. Zero ``n_jobs`` uses as many jobs as cores, and zero ``compression_threads``
+     * shares the cores between the jobs.
+     */
+    std::vector<std::string> transmute_packages(
+        const std::vector<std::pair<fs::u8path, fs::u8path>>& packages,
+        int compression_level,
+        int compression_threads,
+        std::size_t n_jobs
+    );
+    /**
+     * Read the ``info/index.json`` file of a ``.tar.bz2`` or ``.conda`` package.
+     *
+     * Only the ``info`` part of a ``.conda`` package is decompressed, and a ``.tar.bz2``
+     * package is only read up to the file.
+     */
+    std::string read_package_index_json(const fs::u8path& pkg_file);
+
     bool validate(const fs::u8path& pkg_folder);
 }  // namespace mamba
 
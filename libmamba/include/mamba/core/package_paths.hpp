@@ -10,6 +10,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "util.hpp"
@@ -65,6 +66,18 @@ namespace mamba
     std::map<std::string, PrefixFileParse> read_has_prefix(const fs::u8path& path);
     std::set<std::string> read_no_link(const fs::u8path& info_dir);
     std::vector<PathData> read_paths(const fs::u8path& directory);
+
+    /**
+     * Whether the file @p path of a package, as in its ``paths.json``, matches one of the
+     * glob @p patterns of the ``exclude_files`` configuration.
+     *
+     * The metadata in ``info`` is never excluded.
+     */
+    bool is_excluded_path(const std::vector<std::string>& patterns, std::string_view path);
+
+    /** The files left out when the package was extracted to @p directory. */
+    std::set<std::string> read_excluded_paths(const fs::u8path& directory);
+    void write_excluded_paths(const fs::u8path& directory, const std::vector<std::string>& paths);
 }  // namespace mamba
 
 #endif
@@ -17,6 +17,18 @@ namespace mamba
 {
     std::string python_pin(PrefixData& prefix_data, const std::vector<std::string>& specs);
 
+    /**
+     * The same pin from the summaries of the installed records, sorted by name.
+     *
+     * The summaries are read from the prefix index by ``PrefixData::load_summaries``, without
+     * loading the full records.
+     */
+    std::string python_pin(
+        const std::vector<PrefixData::RecordSummary>& summaries,
+        const std::vector<std::string>& specs,
+        ChannelContext& channel_context
+    );
+
     std::vector<std::string> file_pins(const fs::u8path& file);
 }
 
@@ -7,8 +7,13 @@
 #ifndef MAMBA_CORE_POOL_HPP
 #define MAMBA_CORE_POOL_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <solv/pooltypes.h>
 
@@ -24,6 +29,49 @@ namespace mamba
         class ObjPool;
     }
 
+    /**
+     * A non owning view of the most used fields of a solvable.
+     *
+     * The strings are the ones interned in the pool, so no allocation is made to read them.
+     * They are valid until new strings are added to the pool (e.g. when loading a repo), and
+     * the view must be converted to a ``PackageInfo`` with ``MPool::id2pkginfo`` to be kept.
+     */
+    struct PackageView
+    {
+        Id id = 0;
+        std::string_view name = {};
+        std::string_view version = {};
+        std::string_view build_string = {};
+        std::size_t build_number = 0;
+        std::string_view channel = {};
+        std::string_view subdir = {};
+        std::string_view fn = {};
+        std::string_view url = {};
+        std::string_view noarch = {};
+
+        /** The name, version and build string, as used in a conda spec. */
+        auto spec() const -> std::string;
+    };
+
+    /**
+     * The most used fields of many solvables, as columns of ids of the pool strings.
+     *
+     * Strings are shared among solvables, so that they can be converted once for all the
+     * solvables with ``MPool::dep2str``, and compared as ids.
+     * The ids are valid as long as the pool.
+     */
+    struct SolvableColumns
+    {
+        std::vector<Id> ids = {};
+        std::vector<Id> names = {};
+        std::vector<Id> versions = {};
+        std::vector<Id> build_strings = {};
+        std::vector<std::int64_t> build_numbers = {};
+        /** The dependencies of solvable ``i`` are ``depends[depends_offsets[i]:[i + 1]]``. */
+        std::vector<std::int64_t> depends_offsets = {};
+        std::vector<Id> depends = {};
+    };
+
     /**
      * Pool of solvable involved in resolving en environment.
      *
@@ -36,17 +84,80 @@ namespace mamba
     {
     public:
 
+        /** The repos of the pool at some point, to remove the ones added since. */
+        struct Snapshot
+        {
+            std::vector<::Id> repo_ids = {};
+            ::Id installed_repo_id = 0;
+        };
+
         MPool(ChannelContext& channel_context);
         ~MPool();
 
         void set_debuglevel();
         void create_whatprovides();
 
+        /**
+         * Only consider the solvables that can be part of a solve of the given package names.
+         *
+         * These are the solvables with the given names or the name of an installed package,
+         * and transitively the ones named in their dependencies.
+         * Other solvables are ignored by the whatprovides index and the solver, which makes
+         * both cheaper for small solves against large channels.
+         * The whatprovides index must be created again for the change to take effect.
+         */
+        void prune(const std::vector<std::string>& names);
+
+        /** Record the current repos, such as the channels loaded once for many solves. */
+        Snapshot snapshot() const;
+        /**
+         * Remove the repos added since @p snapshot and set its installed repo back.
+         *
+         * The pool can then be used for another solve, such as with another installed repo,
+         * without loading the channels again.
+         * Pruning is reset and the whatprovides index is created again.
+         * The ``MRepo`` of the removed repos must not be used anymore.
+         */
+        void restore(const Snapshot& snapshot);
+        /**
+         * A copy of the pool not sharing any state with it.
+         *
+         * A pool cannot be used from several threads at once, but each fork can be used by
+         * another thread.
+         * Repos are copied in the libsolv binary format, which is much faster than loading
+         * them again, and the whatprovides index of the fork is created.
+         * Pruning is not copied.
+         */
+        MPool fork();
+
         std::vector<Id> select_solvables(Id id, bool sorted = false) const;
         Id matchspec2id(const MatchSpec& ms);
+        /**
+         * The dependency id of a conda match spec string, as parsed by libsolv.
+         *
+         * Parsed strings are remembered, since many packages share the same dependencies,
+         * such as ``python >=3.8``.
+         * Zero if the string cannot be parsed.
+         */
+        Id conda_dependency_id(const std::string& spec);
 
         std::optional<PackageInfo> id2pkginfo(Id solv_id) const;
+        std::optional<PackageView> id2pkgview(Id solv_id) const;
         std::optional<std::string> dep2str(Id dep_id) const;
+        /** The columns of the solvables @p solv_ids, skipping the invalid ones. */
+        SolvableColumns solvable_columns(const std::vector<Id>& solv_ids) const;
+        /** The columns of all the solvables of the pool. */
+        SolvableColumns solvable_columns() const;
+        /**
+         * The ids of the package names matching a glob pattern, such as ``py*`` or ``*numpy*``.
+         *
+         * ``*`` matches any sequence of characters and ``?`` any character.
+         * The names are looked up in a sorted table of the names of the solvables, built on
+         * first use and shared by the copies of the pool, so that only the names starting
+         * with the part of the pattern before its first ``*`` are matched.
+         * The ids are in name order, and may include names without installable solvables.
+         */
+        std::vector<Id> match_names(std::string_view pattern) const;
 
         // TODO: (TMP) This is not meant to exist but is needed for a transition period
         operator ::Pool*();
@@ -9,6 +9,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "error_handling.hpp"
 #include "history.hpp"
@@ -18,18 +19,53 @@ namespace mamba
 {
     class ChannelContext;
 
+    /**
+     * The packages installed in a prefix, from the records of its ``conda-meta`` directory.
+     *
+     * Only the fields of ``PackageInfo`` are loaded. The files of a package are read from its
+     * record only when they are needed, such as to unlink the package.
+     */
     class PrefixData
     {
     public:
 
         using package_map = std::map<std::string, PackageInfo>;
 
+        /** The fields of an installed record needed to list it. */
+        struct RecordSummary
+        {
+            std::string name;
+            std::string version;
+            std::string build_string;
+            std::size_t build_number = 0;
+            std::string channel;
+            std::string url;
+            std::string subdir;
+        };
+
         static expected_t<PrefixData>
         create(const fs::u8path& prefix_path, ChannelContext& channel_context);
 
+        /**
+         * The installed records of a prefix sorted by name, without building ``PackageInfo``.
+         *
+         * Records are read from the same index as when loading a ``PrefixData``.
+         */
+        static std::vector<RecordSummary> load_summaries(const fs::u8path& prefix_path);
+
         void add_packages(const std::vector<PackageInfo>& packages);
         const package_map& records() const;
+        /**
+         * A digest of the state of the records, which changes whenever they do.
+         *
+         * It is computed from the attributes of the record files and from the added packages,
+         * and is empty if the records cannot be identified, such as when loaded from other
+         * files.
+         */
+        const std::string& records_stamp() const;
         void load_single_record(const fs::u8path& path);
+        /** Load the records of many files concurrently, added as with ``load_single_record``. */
+        void load_records(const std::vector<fs::u8path>& paths);
 
         History& history();
         const fs::u8path& path() const;
@@ -47,6 +83,7 @@ namespace mamba
 
         History m_history;
         package_map m_package_records;
+        std::string m_records_stamp;
         fs::u8path m_prefix_path;
 
         ChannelContext& m_channel_context;
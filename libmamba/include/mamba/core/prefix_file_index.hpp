@@ -0,0 +1,93 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_PREFIX_FILE_INDEX_HPP
+#define MAMBA_CORE_PREFIX_FILE_INDEX_HPP
+
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "mamba_fs.hpp"
+
+namespace mamba
+{
+    /**
+     * The files of a prefix, by path, with the package that installed them.
+     *
+     * The index is persisted in the ``conda-meta`` directory of the prefix, along with the size
+     * and modification time of each package record it was built from, as the index of the
+     * records of ``PrefixData``.
+     * When loaded, only the records that changed since, for instance by another tool, are read
+     * again, so that the owner of a file is found without reading all the records.
+     * An index can be updated from multiple threads.
+     */
+    class PrefixFileIndex
+    {
+    public:
+
+        struct FileEntry
+        {
+            /** The installing package, as the name of its record such as ``xtl-0.7.5-h0_0``. */
+            std::string package = {};
+            /** The checksum of the file in the prefix, if known. */
+            std::string sha256 = {};
+        };
+
+        /** Load the index of @p prefix, refreshed from the package records that changed. */
+        explicit PrefixFileIndex(fs::u8path prefix);
+
+        PrefixFileIndex(const PrefixFileIndex&) = delete;
+        PrefixFileIndex& operator=(const PrefixFileIndex&) = delete;
+
+        /** The package installing the file @p path, relative to the prefix. */
+        auto find(const std::string& path) const -> std::optional<FileEntry>;
+
+        /** The files of the package @p package in the order of its record, if installed. */
+        auto files(const std::string& package) const -> std::optional<std::vector<std::string>>;
+
+        /** Index the files of @p package, from the ``paths_data`` of its record. */
+        void add(const std::string& package, const nlohmann::json& paths_data);
+
+        /** Remove the files of @p package from the index. */
+        void remove(const std::string& package);
+
+        /**
+         * Persist the index, if it changed since loaded.
+         *
+         * Failures are only logged, as the index is rebuilt from the records when outdated.
+         */
+        void write();
+
+    private:
+
+        struct Record
+        {
+            /** The attributes of the record file, null until it is written. */
+            nlohmann::json stamp = {};
+            std::vector<std::pair<std::string, std::string>> paths = {};
+        };
+
+        fs::u8path m_prefix;
+        std::map<std::string, Record> m_records = {};
+        std::unordered_map<std::string, FileEntry> m_owners = {};
+        bool m_changed = false;
+        mutable std::mutex m_mutex = {};
+
+        auto index_file() const -> fs::u8path;
+        void load();
+        void insert(const std::string& package, Record record);
+        void erase(const std::string& package);
+    };
+}
+
+#endif
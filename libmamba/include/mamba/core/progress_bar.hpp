@@ -53,6 +53,7 @@ namespace mamba
         ProgressProxy& set_full();
         ProgressProxy& activate_spinner();
         ProgressProxy& deactivate_spinner();
+        ProgressProxy& post_progress(std::size_t current, std::size_t total, std::size_t speed);
 
         std::size_t current() const;
         std::size_t in_progress() const;
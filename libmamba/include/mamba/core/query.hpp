@@ -8,7 +8,9 @@
 #define MAMBA_CORE_QUERY_HPP
 
 #include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <solv/pool.h>
@@ -50,7 +52,14 @@ namespace mamba
 
     private:
 
+        /** The solvables of the pool requiring each package name. */
+        using reverse_dependencies = std::unordered_map<Id, std::vector<Id>>;
+
         std::reference_wrapper<MPool> m_pool;
+        /** Built on the first recursive ``whoneeds``, and shared by the copies. */
+        mutable std::shared_ptr<const reverse_dependencies> m_reverse_deps = nullptr;
+
+        auto get_reverse_dependencies() const -> const reverse_dependencies&;
     };
 
     enum class QueryType
@@ -95,6 +104,13 @@ namespace mamba
         std::ostream& table(std::ostream&, const std::vector<std::string>& fmt) const;
         std::ostream& tree(std::ostream&) const;
         nlohmann::json json(ChannelContext& channel_context) const;
+        /**
+         * Write the same output as dumping ``json`` with an indent of 4.
+         *
+         * Packages are converted to json one at a time, so that large results are not held
+         * in a json document.
+         */
+        std::ostream& write_json(std::ostream& out, ChannelContext& channel_context) const;
 
         std::ostream& pretty(std::ostream&) const;
 
@@ -108,6 +124,8 @@ namespace mamba
 
         void reset_pkg_view_list();
         std::string get_package_repr(const PackageInfo& pkg) const;
+        nlohmann::json json_query(ChannelContext& channel_context) const;
+        nlohmann::json json_graph_roots() const;
 
         QueryType m_type;
         std::string m_query;
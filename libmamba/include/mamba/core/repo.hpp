@@ -7,15 +7,20 @@
 #ifndef MAMBA_CORE_REPO_HPP
 #define MAMBA_CORE_REPO_HPP
 
+#include <optional>
 #include <string>
 #include <string_view>
 #include <tuple>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include <nlohmann/json_fwd.hpp>
 #include <solv/pooltypes.h>
 
+#include "mamba/core/mamba_fs.hpp"
+#include "mamba/specs/repo_data.hpp"
+
 #include "pool.hpp"
 
 extern "C"
@@ -52,6 +57,65 @@ namespace mamba
     void to_json(nlohmann::json& j, const RepoMetadata& m);
     void from_json(const nlohmann::json& j, RepoMetadata& p);
 
+    /**
+     * The package records of a ``repodata.json`` file.
+     *
+     * Reading the file does not involve any pool, and can therefore be done concurrently for
+     * multiple files, whereas adding the records to a pool through ``MRepo`` is not thread safe.
+     */
+    struct RepoDataRecords
+    {
+        struct Record
+        {
+            std::string filename = {};
+            /** The raw version string, since ``specs::Version::parse`` is not injective. */
+            std::string version = {};
+            specs::RepoDataPackage package = {};
+        };
+
+        /**
+         * Read the records of a ``repodata.json`` file.
+         *
+         * Like libsolv, ``.conda`` artifacts are preferred over their ``.tar.bz2`` counterpart.
+         * Invalid records are skipped.
+         */
+        static auto read(const fs::u8path& filename, bool only_tar_bz2) -> RepoDataRecords;
+
+        /** Read every valid record, including the ``.tar.bz2`` counterparts of ``.conda``. */
+        static auto read_all(const fs::u8path& filename) -> RepoDataRecords;
+
+        fs::u8path filename = {};
+        std::vector<Record> records = {};
+    };
+
+    /**
+     * The package records that changed between two versions of a ``repodata.json`` file.
+     *
+     * Records are identified by their artifact stem (the filename without extension) so that
+     * changes to the ``.conda`` artifact of a package also refresh its ``.tar.bz2`` counterpart.
+     */
+    struct RepoDataRecordsUpdate
+    {
+        /**
+         * Compute the changed records from a JSON Patch (RFC 6902).
+         *
+         * @param repodata The ``repodata.json`` content, with the @p patch already applied.
+         * @return Nothing if the patch alters more than individual package records, such as
+         *         replacing a whole ``packages`` section.
+         */
+        static auto from_patch(
+            const fs::u8path& filename,
+            const nlohmann::json& repodata,
+            const nlohmann::json& patch,
+            bool only_tar_bz2
+        ) -> std::optional<RepoDataRecordsUpdate>;
+
+        /** The stems of the packages added, modified, or removed. */
+        std::vector<std::string> stems = {};
+        /** The new preferred record of each stem, stems without one were removed. */
+        RepoDataRecords records = {};
+    };
+
     /**
      * A wrapper class of libsolv Repo.
      * Represents a channel subdirectory and
@@ -63,8 +127,41 @@ namespace mamba
     public:
 
         MRepo(MPool& pool, const std::string& name, const fs::u8path& filename, const RepoMetadata& meta);
+        /**
+         * The installed repo of a prefix.
+         *
+         * The repo is cached in a solv file of the ``conda-meta`` directory, identified by the
+         * ``PrefixData::records_stamp`` of the records.
+         */
         MRepo(MPool& pool, const PrefixData& prefix_data);
+        /** With the metadata written by ``write_solv``. */
+        MRepo(MPool& pool, const PrefixData& prefix_data, const RepoMetadata& meta);
         MRepo(MPool& pool, const std::string& name, const std::vector<PackageInfo>& uris);
+        MRepo(MPool& pool, const std::string& name, RepoDataRecords&& records, const RepoMetadata& meta);
+        /**
+         * Load the solv cache of the previous version of the records and apply the update.
+         *
+         * The full ``repodata.json`` is read instead if the solv cache is not valid.
+         */
+        MRepo(
+            MPool& pool,
+            const std::string& name,
+            RepoDataRecordsUpdate&& update,
+            const RepoMetadata& meta
+        );
+
+        /**
+         * Read a solv file written by ``write_solv``, without falling back to a repodata file.
+         *
+         * @return Nothing, and no repo added to the pool, if the file cannot be read or was
+         *         written with other metadata than @p meta.
+         */
+        static auto read_solv_file(
+            MPool& pool,
+            const std::string& name,
+            const fs::u8path& filename,
+            const RepoMetadata& meta
+        ) -> std::optional<MRepo>;
 
         MRepo(const MRepo&) = delete;
         MRepo(MRepo&&) = default;
@@ -74,6 +171,11 @@ namespace mamba
         void set_installed();
         void set_priority(int priority, int subpriority);
 
+        /** Remove the packages whose name is not in @p names, returning how many were removed. */
+        auto keep_names(const std::unordered_set<std::string>& names) -> std::size_t;
+        /** Write the packages and the metadata of the repo to the solv file @p path. */
+        void write_solv(fs::u8path path);
+
         Id id() const;
         Repo* repo() const;
 
@@ -92,16 +194,24 @@ namespace mamba
 
     private:
 
+        MRepo(MPool& pool, const std::string& name, const RepoMetadata& meta);
+
         auto name() const -> std::string_view;
 
         void add_pip_as_python_dependency();
         void clear(bool reuse_ids = true);
         void load_file(const fs::u8path& filename);
         void read_json(const fs::u8path& filename);
+        void read_json_stream(const fs::u8path& filename);
+        /** Read a ``repodata_index.bin``, see ``RepoDataIndex``. */
+        void read_index(const fs::u8path& filename);
         bool read_solv(const fs::u8path& filename);
-        void write_solv(fs::u8path path);
-        void add_package_info(const PackageInfo& pkg_info);
-        void set_solvables_url(const std::string& repo_url);
+        void add_package_infos(const std::vector<const PackageInfo*>& infos);
+        /** Add the records of a prefix, as the packages of the installed repo. */
+        void add_prefix_records(const PrefixData& prefix_data);
+        void add_repodata_records(const RepoDataRecords& records);
+        void update_repodata_records(const RepoDataRecordsUpdate& update);
+        void exclude_records();
 
         MPool m_pool;
 
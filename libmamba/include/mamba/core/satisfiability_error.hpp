@@ -31,6 +31,7 @@ namespace mamba
 
     class MSolver;
     class MPool;
+    class CompressedProblemsGraph;
 
     template <typename T>
     class conflict_map : private std::unordered_map<T, util::flat_set<T>>
@@ -105,6 +106,10 @@ namespace mamba
         graph_t m_graph;
         conflicts_t m_conflicts;
         node_id m_root_node;
+
+        // To move the nodes and edges out of a graph that is not needed anymore
+        friend ProblemsGraph simplify_conflicts(ProblemsGraph&& pbs);
+        friend class CompressedProblemsGraph;
     };
 
     /**
@@ -112,6 +117,11 @@ namespace mamba
      */
     ProblemsGraph simplify_conflicts(const ProblemsGraph& pbs);
 
+    /**
+     * Simplify conflicts in place, without copying the nodes and edges of the graph.
+     */
+    ProblemsGraph simplify_conflicts(ProblemsGraph&& pbs);
+
     class CompressedProblemsGraph
     {
     public:
@@ -223,6 +233,11 @@ namespace mamba
         from_problems_graph(const ProblemsGraph& pbs, const merge_criteria_t& merge_criteria = {})
             -> CompressedProblemsGraph;
 
+        /** Move the nodes and edges of @p pbs into the merged ones rather than copying them. */
+        static auto
+        from_problems_graph(ProblemsGraph&& pbs, const merge_criteria_t& merge_criteria = {})
+            -> CompressedProblemsGraph;
+
         CompressedProblemsGraph(graph_t graph, conflicts_t conflicts, node_id root_node);
 
         const graph_t& graph() const noexcept;
@@ -8,6 +8,7 @@
 #define MAMBA_CORE_SHELL_INIT
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "mamba_fs.hpp"
@@ -41,6 +42,20 @@ namespace mamba
     std::string
     rcfile_content(const fs::u8path& env_prefix, const std::string& shell, const fs::u8path& mamba_exe);
 
+    /**
+     * Replace the blocks of @p content from a line starting with @p begin_marker to a line
+     * starting with @p end_marker, including their line endings and the preceding newline.
+     */
+    std::string replace_init_blocks(
+        std::string_view content,
+        std::string_view begin_marker,
+        std::string_view end_marker,
+        std::string_view replacement
+    );
+
+    /** The hook sourced by the static initialization, when it does not call micromamba. */
+    fs::u8path static_hook_path(const fs::u8path& root_prefix);
+
     std::string
     xonsh_content(const fs::u8path& env_prefix, const std::string& shell, const fs::u8path& mamba_exe);
 
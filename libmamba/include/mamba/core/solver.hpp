@@ -7,10 +7,12 @@
 #ifndef MAMBA_CORE_SOLVER_HPP
 #define MAMBA_CORE_SOLVER_HPP
 
+#include <functional>
 #include <iosfwd>
 #include <memory>
 #include <optional>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -68,6 +70,13 @@ namespace mamba
             bool keep_specs = true;
             /** Force reinstallation of jobs. */
             bool force_reinstall = false;
+            /**
+             * Keep the installed packages that the install jobs cannot require.
+             *
+             * These packages are locked, which makes small changes to large environments much
+             * faster to solve, and the solve is run again without the locks if it fails.
+             */
+            bool minimal_change = false;
         };
 
         MSolver(MPool pool, std::vector<std::pair<int, int>> flags = {});
@@ -94,6 +103,14 @@ namespace mamba
         void must_solve();
         [[nodiscard]] bool is_solved() const;
 
+        /**
+         * The decisions of the solve, when they were loaded from the solver cache.
+         *
+         * The libsolv solver has not been run in this case, and the transaction has to be
+         * created from these decisions.
+         */
+        [[nodiscard]] auto cached_decision() const -> const solv::ObjQueue*;
+
         [[nodiscard]] std::string problems_to_str() const;
         [[nodiscard]] std::vector<std::string> all_problems() const;
         [[nodiscard]] std::vector<MSolverProblem> all_problems_structured() const;
@@ -128,11 +145,94 @@ namespace mamba
         // Temporary Pimpl all libsolv to keep it private
         std::unique_ptr<solv::ObjSolver> m_solver;
         std::unique_ptr<solv::ObjQueue> m_jobs;
+        std::unique_ptr<solv::ObjQueue> m_cached_decision;
         Flags m_flags = {};
         bool m_is_solved;
 
         void add_reinstall_job(MatchSpec& ms, int job_flag);
+        /** Add the locks of ``Flags::minimal_change`` to @p jobs, return the number added. */
+        auto add_minimal_change_jobs(solv::ObjQueue& jobs) const -> std::size_t;
+        /** Add the dummy installed solvable of a pin, returning its name. */
+        auto add_pin_solvable(const std::string& pin) -> std::string;
         void apply_libsolv_flags();
+        /** Create a new libsolv solver with the flags, discarding any previous solve. */
+        void reset_solver();
+        /**
+         * Run libsolv on the jobs, without the solver cache nor any output.
+         *
+         * @p n_locked is set to the number of locks of ``Flags::minimal_change``.
+         */
+        auto solve_jobs(std::size_t& n_locked) -> bool;
+
+        friend class SolverPortfolio;
+    };
+
+    /**
+     * Solvers racing with different libsolv heuristics on the same request.
+     *
+     * Some requests are much slower to solve with some decision heuristics than others.
+     * Each strategy is a list of libsolv flags for a solver set up by the same function.
+     * Every solver runs on its own fork of the pool, concurrently, trading idle cores for the
+     * latency of the slow solves.
+     * The answer of the first strategy, the configured one, is kept whenever it is done by the
+     * time a solution is first noticed. Otherwise the preferred solution found is kept.
+     *
+     * libsolv cannot be interrupted, so the other solvers keep running on their own pools,
+     * such as while the packages are downloaded, and the portfolio waits for them when
+     * destroyed.
+     * The solver cache is not used.
+     */
+    class SolverPortfolio
+    {
+    public:
+
+        using flag_list = std::vector<std::pair<int, int>>;
+        using setup_func = std::function<void(MSolver&)>;
+
+        /**
+         * The strategies to race by default for the libsolv @p flags.
+         *
+         * These are the flags themselves, then with the focus on the best versions and on the
+         * installed packages. Only the order of the decisions changes, so that every solution
+         * found honors the flags, such as the channel priority or downgrades.
+         */
+        static auto default_strategies(const flag_list& flags) -> std::vector<flag_list>;
+
+        /**
+         * Create the solvers of the @p strategies, in order of preference.
+         *
+         * @p setup adds the jobs and pins of the request to each solver, and is called once
+         * per strategy from this thread.
+         * It must create the whatprovides index of the pool of the solver after adding pins.
+         */
+        SolverPortfolio(
+            MPool pool,
+            const std::vector<flag_list>& strategies,
+            const setup_func& setup
+        );
+
+        SolverPortfolio(const SolverPortfolio&) = delete;
+        SolverPortfolio& operator=(const SolverPortfolio&) = delete;
+        SolverPortfolio(SolverPortfolio&&) = delete;
+        SolverPortfolio& operator=(SolverPortfolio&&) = delete;
+
+        /** Wait for the solvers still running. */
+        ~SolverPortfolio();
+
+        /** Start the solvers, and wait for the one to keep and whether it found a solution. */
+        [[nodiscard]] bool try_solve();
+        /** The solver kept, or the one of the first strategy before solving. */
+        [[nodiscard]] auto solver() -> MSolver&;
+        /** The index of the strategy of the solver kept, or zero before solving. */
+        [[nodiscard]] auto strategy() const -> std::size_t;
+
+    private:
+
+        struct Race;
+
+        std::unique_ptr<Race> m_race;
+        /** Joined on destruction, so that no solver outlives the pools and the logs. */
+        std::vector<std::thread> m_threads;
     };
 }  // namespace mamba
 
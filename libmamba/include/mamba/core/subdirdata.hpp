@@ -8,6 +8,7 @@
 #define MAMBA_CORE_SUBDIRDATA_HPP
 
 #include <memory>
+#include <optional>
 #include <regex>
 #include <string>
 
@@ -54,6 +55,28 @@ namespace mamba
         std::optional<checked_at> has_zst;
         std::optional<checked_at> has_bz2;
         std::optional<checked_at> has_jlap;
+        std::optional<checked_at> has_index;
+
+        // JLAP state: hash of the cached repodata.json content as published (hexadecimal),
+        // and where to resume reading repodata.jlap (rolling hash and offset of its tail).
+        std::string repodata_hash;
+        std::string jlap_iv;
+        std::size_t jlap_pos = 0;
+
+        // The cached repodata whose package signatures were last verified, and the version of
+        // the trusted root they were verified with.
+        struct verified_index
+        {
+            std::string etag;
+            std::string repodata_hash;
+            std::size_t file_size = 0;
+            std::size_t root_version = 0;
+        };
+        std::optional<verified_index> verified;
+
+        /** Whether the signatures of the same repodata were verified with the same root. */
+        bool is_index_verified(std::size_t root_version) const;
+        void set_index_verified(std::size_t root_version);
 
         void store_file_metadata(const fs::u8path& path);
         bool check_valid_metadata(const fs::u8path& path);
@@ -100,15 +123,40 @@ namespace mamba
         void clear_cache();
 
         expected_t<std::string> cache_path() const;
+        /** Whether the repo is to be created by updating the previous solv cache. */
+        bool has_records_update() const;
         const std::string& name() const;
 
         std::vector<std::unique_ptr<DownloadTarget>>& check_targets();
         DownloadTarget* target();
 
+        /**
+         * Whether an expired cache is in use, as with ``repodata_stale_while_revalidate``.
+         *
+         * Such a cache is refreshed by downloading the @ref revalidation_target, which is a
+         * conditional request answered with 304 if the repodata did not change.
+         * The cache stays stale, and in use, if it could not be refreshed.
+         */
+        bool is_stale() const;
+        /** Create the refresh download of a stale cache, null if the cache is not stale. */
+        DownloadTarget* revalidation_target(bool with_progress_bar = false);
+
         bool finalize_check(const DownloadTarget& target);
         bool finalize_transfer(const DownloadTarget& target);
         void finalize_checks();
         expected_t<MRepo> create_repo(MPool& pool);
+        expected_t<MRepo> create_repo(MPool& pool, RepoDataRecords&& records);
+        /** The url, etag and last modified time of the loaded repodata. */
+        RepoMetadata repo_metadata() const;
+
+        /**
+         * Verify the signatures of the packages of the cached index.
+         *
+         * The result is recorded in the state file, and the verification is skipped when the
+         * index did not change since, unless ``verify_index_cache`` is set.
+         * Throw a ``validation::trust_error`` if the index is not trusted.
+         */
+        void verify_index(MultiPackageCache& caches);
 
     private:
 
@@ -121,11 +169,40 @@ namespace mamba
             const std::string& repodata_fn = "repodata.json"
         );
 
-        bool load(MultiPackageCache& caches, ChannelContext& channel_context);
+        bool load(
+            MultiPackageCache& caches,
+            ChannelContext& channel_context,
+            bool coordinate_fetch = true
+        );
         void check_repodata_existence();
-        void create_target();
+        void create_target(bool with_progress_bar = true);
+        /**
+         * Whether the availability of the zst repodata is unknown or expired.
+         *
+         * The zst repodata is then requested, falling back to the json within the same
+         * download if the server does not have it.
+         */
+        bool probes_zst() const;
+        /** Whether the repodata index can replace the json, see ``RepoDataIndex``. */
+        bool uses_index() const;
+        /** Whether the availability of the repodata index is unknown or expired. */
+        bool probes_index() const;
+        /**
+         * The cached repodata in a package cache, either the json or the index.
+         *
+         * Only one of them is kept at a time, the json otherwise.
+         */
+        fs::u8path repodata_cache_file(const fs::u8path& pkgs_dir) const;
         std::size_t get_cache_control_max_age(const std::string& val);
         void refresh_last_write_time(const fs::u8path& json_file, const fs::u8path& solv_file);
+        /**
+         * Lock the fetch of the repodata, for ``repodata_shared_cache``.
+         *
+         * Return false if another process refreshed the cache while this one was waiting.
+         */
+        bool acquire_fetch_lock();
+        void create_jlap_check_target();
+        bool load_jlap();
 
         std::unique_ptr<DownloadTarget> m_target = nullptr;
         std::vector<std::unique_ptr<DownloadTarget>> m_check_targets;
@@ -135,20 +212,28 @@ namespace mamba
 
         fs::u8path m_valid_cache_path;
         fs::u8path m_expired_cache_path;
+        // The repodata of a local channel, read in place instead of from the cache
+        fs::u8path m_local_repodata;
         fs::u8path m_writable_pkgs_dir;
 
         ProgressProxy m_progress_bar;
-        ProgressProxy m_progress_bar_check;
 
         bool m_loaded;
+        // Expired cache in use until revalidated
+        bool m_stale = false;
         bool m_download_complete;
         std::string m_repodata_url;
         std::string m_name;
         std::string m_json_fn;
         std::string m_solv_fn;
+        std::string m_index_fn;
         bool m_is_noarch;
         subdir_metadata m_metadata;
         std::unique_ptr<TemporaryFile> m_temp_file;
+        std::unique_ptr<TemporaryFile> m_jlap_temp_file;
+        std::optional<RepoDataRecordsUpdate> m_records_update;
+        // Held while fetching the repodata for other processes sharing the cache
+        std::optional<LockFile> m_fetch_lock;
         const Channel* p_channel = nullptr;
     };
 
@@ -7,8 +7,10 @@
 #ifndef MAMBA_CORE_THREAD_UTILS_HPP
 #define MAMBA_CORE_THREAD_UTILS_HPP
 
+#include <chrono>
 #include <condition_variable>
 #include <csignal>
+#include <cstddef>
 #include <exception>
 #include <functional>
 #include <mutex>
@@ -34,6 +36,16 @@ namespace mamba
     bool is_sig_interrupted() noexcept;
     void set_sig_interrupted() noexcept;
 
+    /**
+     * Interrupt the process as a signal would once @p deadline is reached.
+     *
+     * The deadline is checked at the interruption points of the long operations,
+     * such as downloading, extracting or linking packages.
+     */
+    void set_interruption_deadline(std::chrono::steady_clock::time_point deadline) noexcept;
+
+    /** Remove the deadline, and the interruption it caused if reached. */
+    void clear_interruption_deadline() noexcept;
 
     void interruption_point();
 
@@ -56,6 +68,14 @@ namespace mamba
     void decrease_thread_count();
     int get_thread_count();
 
+    /**
+     * The number of worker threads for a ``*_threads`` option, such as ``extract_threads``.
+     *
+     * Zero means as many threads as cores, and a negative value that many less than cores.
+     * There is at least one thread.
+     */
+    std::size_t clamp_worker_threads(int configured);
+
     // Waits until all other threads have finished
     // Must be called by the cleaning thread to ensure
     // it won't free ressources that could be required
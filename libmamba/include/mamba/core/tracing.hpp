@@ -0,0 +1,137 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_TRACING_HPP
+#define MAMBA_CORE_TRACING_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/mamba_fs.hpp"
+
+namespace mamba
+{
+    /** A timed region of the execution, with the counters it reported. */
+    struct TraceSpan
+    {
+        using duration_type = std::chrono::microseconds;
+
+        std::string name;
+        /** Start time, relative to the creation of the @ref Tracer. */
+        duration_type start;
+        duration_type duration;
+        std::size_t thread;
+        std::vector<std::pair<std::string, std::size_t>> counters;
+    };
+
+    /** The aggregate of the spans of a phase, such as all the package downloads. */
+    struct TracePhase
+    {
+        std::size_t count = 0;
+        /** Time during which at least one span of the phase was running. */
+        TraceSpan::duration_type wall_time = {};
+        /** Sum of the ``bytes`` counters of the spans. */
+        std::size_t bytes = 0;
+    };
+
+    /**
+     * Collect the time spent in the main steps of an operation.
+     *
+     * Spans are only recorded when the tracer is enabled, otherwise a @ref Tracer::Scope is
+     * a no-op, so that instrumentation can stay in hot paths.
+     * Recorded spans can be reported as json or written to a Chrome trace file, to be
+     * visualized with ``chrome://tracing`` or https://ui.perfetto.dev.
+     */
+    class Tracer
+    {
+    public:
+
+        using clock = std::chrono::steady_clock;
+
+        /** Record a span from its creation to its destruction. */
+        class Scope
+        {
+        public:
+
+            Scope(const Scope&) = delete;
+            Scope(Scope&&) = delete;
+            auto operator=(const Scope&) -> Scope& = delete;
+            auto operator=(Scope&&) -> Scope& = delete;
+            ~Scope();
+
+            /** Attach a count, such as a number of solvables, to the span. */
+            void add_counter(std::string name, std::size_t value);
+
+        private:
+
+            Tracer* p_tracer;
+            std::string m_name;
+            clock::time_point m_start;
+            std::vector<std::pair<std::string, std::size_t>> m_counters = {};
+
+            Scope(Tracer* tracer, std::string name);
+
+            friend class Tracer;
+        };
+
+        static auto instance() -> Tracer&;
+
+        Tracer();
+
+        void set_enabled(bool enabled);
+        [[nodiscard]] auto enabled() const -> bool;
+
+        /** Start a span, recorded when the returned scope is destroyed. */
+        [[nodiscard]] auto scope(std::string name) -> Scope;
+
+        /** Record a span not bound to a scope, such as an asynchronous transfer. */
+        void add_span(
+            std::string name,
+            clock::time_point start,
+            clock::time_point end,
+            std::vector<std::pair<std::string, std::size_t>> counters = {}
+        );
+
+        /**
+         * Aggregate the spans whose name starts with @p prefix.
+         *
+         * If @p within is not empty, only the spans running during the last span with that
+         * name are considered, for instance the package downloads of a transaction.
+         */
+        [[nodiscard]] auto phase(std::string_view prefix, std::string_view within = {}) const
+            -> TracePhase;
+
+        /** All spans recorded so far, ordered by end time. */
+        [[nodiscard]] auto spans() const -> std::vector<TraceSpan>;
+        void clear();
+
+        /** A list of spans, with their durations in milliseconds and their counters. */
+        [[nodiscard]] auto to_json() const -> nlohmann::json;
+
+        /** The spans in the Chrome trace event format. */
+        [[nodiscard]] auto to_chrome_trace() const -> nlohmann::json;
+        void write_chrome_trace(const fs::u8path& path) const;
+
+    private:
+
+        mutable std::mutex m_mutex = {};
+        std::vector<TraceSpan> m_spans = {};
+        clock::time_point m_origin;
+        std::atomic<bool> m_enabled = false;
+
+        void record(TraceSpan span);
+    };
+}
+
+#endif
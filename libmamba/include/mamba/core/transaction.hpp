@@ -7,8 +7,12 @@
 #ifndef MAMBA_CORE_TRANSACTION_HPP
 #define MAMBA_CORE_TRANSACTION_HPP
 
+#include <functional>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include "mamba/api/install.hpp"
@@ -39,8 +43,18 @@ namespace mamba
         );
         MTransaction(MPool& pool, MSolver& solver, MultiPackageCache& caches);
 
-        // Only use if the packages have been solved previously already.
-        MTransaction(MPool& pool, const std::vector<PackageInfo>& packages, MultiPackageCache& caches);
+        /**
+         * Install packages solved previously already, such as the ones of a lockfile.
+         *
+         * The packages are compared to the ones installed in the prefix without the solver, so
+         * that only the packages that changed are unlinked and linked.
+         */
+        MTransaction(
+            MPool& pool,
+            const PrefixData& prefix,
+            const std::vector<PackageInfo>& packages,
+            MultiPackageCache& caches
+        );
 
         MTransaction(const MTransaction&) = delete;
         MTransaction(MTransaction&&) = delete;
@@ -60,6 +74,17 @@ namespace mamba
         void print();
         bool execute(PrefixData& prefix);
 
+        using linked_callback_type = std::function<void(const PackageInfo&)>;
+
+        /**
+         * Also call @p on_linked with each package as soon as it is linked in the prefix, from
+         * the thread that linked it.
+         */
+        bool execute(PrefixData& prefix, const linked_callback_type& on_linked);
+
+        /** The actions of the transaction, such as the packages to install. */
+        const Solution& solution() const;
+
         [[deprecated]] std::pair<std::string, std::string> py_find_python_version() const;
 
     private:
@@ -73,6 +98,52 @@ namespace mamba
         History::UserRequest m_history_entry = History::UserRequest::prefilled();
 
         std::vector<MatchSpec> m_requested_specs;
+
+        /** Where the packages of an action are found in the caches. */
+        struct CachedAction
+        {
+            /** The package to install is extracted. */
+            bool extracted = false;
+            /** The package to install is extracted or its tarball is cached. */
+            bool install_cached = false;
+            /** The package to remove is extracted or its tarball is cached. */
+            bool remove_cached = false;
+        };
+
+        /** Queried once for printing, prompting and fetching, until the packages are fetched. */
+        std::optional<std::vector<CachedAction>> m_cached_actions;
+
+        /** The caches of each action of the solution. */
+        auto cached_actions() -> const std::vector<CachedAction>&;
+
+        /** The records of the packages extracted by ``fetch_extract_packages``, by package. */
+        std::unordered_map<std::string, nlohmann::json> m_extracted_records;
+        std::mutex m_extracted_records_mutex;
+
+        /** The record of a package extracted by the transaction, null if it was cached. */
+        auto take_extracted_record(const PackageInfo& pkg) -> nlohmann::json;
+
+        using extracted_callback_type = std::function<void(const PackageInfo&, const fs::u8path&)>;
+
+        /**
+         * Also call @p on_extracted with each package and its extracted directory, as soon as
+         * it is usable, from the thread that extracted it.
+         */
+        bool fetch_extract_packages(const extracted_callback_type& on_extracted);
+
+        /** A package added to a cache by ``fetch_extract_packages``. */
+        struct FetchedPackage
+        {
+            fs::u8path extracted_dir;
+            std::string filename;
+            /** The tarball was downloaded to the cache, rather than found there. */
+            bool downloaded = false;
+        };
+
+        /** Kept for ``container_build``, to remove the packages from the caches once linked. */
+        std::vector<FetchedPackage> m_fetched_packages;
+
+        void remove_fetched_packages();
     };
 
     MTransaction create_explicit_transaction_from_urls(
@@ -84,6 +155,7 @@ namespace mamba
 
     MTransaction create_explicit_transaction_from_lockfile(
         MPool& pool,
+        const PrefixData& prefix,
         const fs::u8path& env_lockfile_path,
         const std::vector<std::string>& categories,
         MultiPackageCache& package_caches,
@@ -7,13 +7,22 @@
 #ifndef MAMBA_CORE_TRANSACTION_CONTEXT
 #define MAMBA_CORE_TRANSACTION_CONTEXT
 
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include <reproc++/reproc.hpp>
 
 #include "context.hpp"
 #include "mamba_fs.hpp"
 #include "match_spec.hpp"
+#include "prefix_file_index.hpp"
 #include "util.hpp"
 
 namespace mamba
@@ -28,6 +37,36 @@ namespace mamba
         const fs::u8path& target_site_packages_short_path
     );
 
+    /**
+     * The paths of the files of ``noarch: python`` packages in a prefix.
+     *
+     * They are mapped for every file of the packages, so the target directories are joined
+     * once and the paths of the files are made by slicing strings.
+     */
+    class NoarchPythonPaths
+    {
+    public:
+
+        NoarchPythonPaths() = default;
+        NoarchPythonPaths(
+            const fs::u8path& target_site_packages_short_path,
+            const std::string& short_python_version = ""
+        );
+
+        /** The path of the file @p source_short_path of the package, as in the prefix. */
+        std::string target_path(std::string_view source_short_path) const;
+        /** The path of the compiled file of the python file @p py_path of the prefix. */
+        std::string pyc_path(std::string_view py_path) const;
+
+    private:
+
+        std::string m_site_packages_dir;
+        std::string m_bin_dir;
+        std::string m_pycache_dir;
+        std::string m_pyc_suffix;
+        bool m_python2 = false;
+    };
+
     class TransactionContext
     {
     public:
@@ -48,12 +87,76 @@ namespace mamba
         );
         ~TransactionContext();
         bool try_pyc_compilation(const std::vector<fs::u8path>& py_files);
+        /**
+         * Store the compiled pyc file @p pyc of the prefix as @p cached_pyc once compiled.
+         *
+         * Files are stored when waiting for the compilation.
+         */
+        void cache_compiled_pyc(const fs::u8path& pyc, const fs::u8path& cached_pyc);
         void wait_for_pyc_compilation();
 
+        /** Create the menu shortcuts described by @p json_file once all packages are linked. */
+        void defer_menu_creation(const fs::u8path& json_file);
+        /** Start creating the deferred menu shortcuts concurrently, in the background. */
+        void start_menu_creation();
+        void wait_for_menu_creation();
+
+        /**
+         * Call @p run, running a package script, with at most ``script_threads`` at once.
+         *
+         * An @p exclusive script runs alone, as do the scripts writing the messages file shared
+         * by all the scripts of the prefix.
+         */
+        void run_package_script(const std::function<void()>& run, bool exclusive = false);
+        /** Store the @p messages written by the scripts of the package @p pkg_name. */
+        void add_script_messages(const std::string& pkg_name, std::string messages);
+        /** The messages written by the package scripts, by package name. */
+        std::map<std::string, std::string> script_messages() const;
+
+        /**
+         * Clone the file @p src of the package cache @p pkgs_dir to @p dst, if allowed.
+         *
+         * Whether the package cache can be cloned into the prefix is detected on the first
+         * attempt, and not tried again if not.
+         * @return false if the file should be copied instead.
+         */
+        bool try_clone(const fs::u8path& pkgs_dir, const fs::u8path& src, const fs::u8path& dst);
+        /** Whether files could be cloned, for the package caches from which it was tried. */
+        std::map<std::string, bool> clone_support() const;
+
+        /**
+         * Stage the conda-meta records written and removed from now on until committed.
+         *
+         * Records are written to temporary files of the conda-meta directory, and moved in
+         * place all at once by ``commit_records``, so that the prefix metadata only reflects
+         * complete transactions.
+         */
+        void start_records_batch();
+        /** Write the record @p content as the file @p filename of the conda-meta directory. */
+        void write_record(const std::string& filename, const std::string& content);
+        /** Remove the file @p filename of the conda-meta directory. */
+        void remove_record(const std::string& filename);
+        /** The file holding the current content of the record @p filename, staged or not. */
+        fs::u8path record_path(const std::string& filename) const;
+        /**
+         * Apply the staged records, followed by a single sync of the conda-meta directory.
+         *
+         * @return false if some records could not be applied.
+         */
+        bool commit_records();
+
+        /**
+         * The index of the files of the prefix, loaded on first use.
+         *
+         * Linking and unlinking packages update it, and it is written with the records.
+         */
+        PrefixFileIndex& file_index();
+
         bool has_python;
         fs::u8path target_prefix;
         fs::u8path relocate_prefix;
         fs::u8path site_packages_path;
+        NoarchPythonPaths noarch_python_paths;
         fs::u8path python_path;
         std::string python_version;
         std::string old_python_version;
@@ -61,7 +164,12 @@ namespace mamba
         bool allow_softlinks = false;
         bool always_copy = false;
         bool always_softlink = false;
+        bool allow_reflinks = true;
+        bool relocation_cache = false;
+        std::vector<std::string> exclude_files;
         bool compile_pyc = true;
+        // Linked packages are removed from the package cache, which is not written to
+        bool container_build = false;
         // this needs to be done when python version changes
         bool relink_noarch = false;
         std::vector<MatchSpec> requested_specs;
@@ -70,9 +178,36 @@ namespace mamba
 
         bool start_pyc_compilation_process();
 
-        std::unique_ptr<reproc::process> m_pyc_process = nullptr;
-        std::unique_ptr<TemporaryFile> m_pyc_script_file = nullptr;
+        // Files are sharded across the processes, started as the number of files grows
+        std::vector<std::unique_ptr<reproc::process>> m_pyc_processes;
+        std::vector<std::unique_ptr<TemporaryFile>> m_pyc_script_files;
         std::unique_ptr<TemporaryFile> m_pyc_compileall = nullptr;
+        std::size_t m_pyc_files_count = 0;
+        std::vector<std::pair<fs::u8path, fs::u8path>> m_pyc_to_cache;
+        std::mutex m_pyc_to_cache_mutex;
+
+        std::vector<fs::u8path> m_deferred_menus;
+        std::mutex m_deferred_menus_mutex;
+        std::thread m_menu_thread;
+
+        std::size_t m_running_scripts = 0;
+        std::size_t m_waiting_exclusive_scripts = 0;
+        std::condition_variable m_scripts_cv;
+        std::map<std::string, std::string> m_script_messages;
+        mutable std::mutex m_scripts_mutex;
+
+        std::map<std::string, bool> m_clone_support;
+        mutable std::mutex m_clone_mutex;
+
+        // Staged records by file name, none for the removed ones
+        std::map<std::string, std::optional<fs::u8path>> m_staged_records;
+        bool m_batch_records = false;
+        mutable std::mutex m_records_mutex;
+
+        std::unique_ptr<PrefixFileIndex> m_file_index;
+        std::mutex m_file_index_mutex;
+
+        void write_file_index();
     };
 }  // namespace mamba
 
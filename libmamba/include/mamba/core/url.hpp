@@ -16,6 +16,7 @@ extern "C"
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // typedef enum {
@@ -60,6 +61,24 @@ namespace mamba
 
     bool has_scheme(const std::string& url);
 
+    /** The parts of a url of the common ``scheme://host/path`` form, as views into the url. */
+    struct SimpleURLParts
+    {
+        std::string_view scheme;
+        std::string_view host;
+        std::string_view path;
+    };
+
+    /**
+     * Split a url of the common ``scheme://host/path`` form without parsing it with curl.
+     *
+     * The parts are the ones that ``URLHandler`` would give.
+     * Nothing is returned for the other urls, which must be parsed with ``URLHandler``, such as
+     * urls with credentials, a port, a query, relative path segments, file urls, or characters
+     * that curl could normalize.
+     */
+    std::optional<SimpleURLParts> split_simple_url(std::string_view url);
+
     void split_anaconda_token(const std::string& url, std::string& cleaned_url, std::string& token);
 
     void split_scheme_auth_token(
@@ -74,6 +93,8 @@ namespace mamba
 
     bool is_path(const std::string& input);
     std::string path_to_url(const std::string& path);
+    /** Return the path of a local ``file://`` url, or an empty string for other urls. */
+    std::string local_path_from_url(const std::string& url);
 
     template <class S, class... Args>
     std::string join_url(const S& s, const Args&... args);
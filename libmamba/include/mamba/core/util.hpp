@@ -66,6 +66,8 @@ namespace mamba
     std::string
     read_contents(const fs::u8path& path, std::ios::openmode mode = std::ios::in | std::ios::binary);
     std::vector<std::string> read_lines(const fs::u8path& path);
+    /** Write @p contents to @p path in a single call, without an intermediate buffer. */
+    void write_contents(const fs::u8path& path, std::string_view contents);
 
     inline void make_executable(const fs::u8path& p)
     {
@@ -121,6 +123,16 @@ namespace mamba
 
     class LockFileOwner;
 
+    // How a `LockFile` excludes other processes:
+    // - `exclusive` from any other lock, such as to write the path;
+    // - `shared` only from exclusive locks, such as to read the path while no one writes it.
+    // Shared locks are exclusive on Windows.
+    enum class LockMode
+    {
+        exclusive,
+        shared
+    };
+
     // @return `true` if constructing a `LockFile` will result in locking behavior, `false` if
     // using `LockFile will not lock the file and behave like a no-op.
     //
@@ -200,8 +212,14 @@ namespace mamba
         // re-assigned:
         // - `this->is_locked() == false` and `if(*this) ...` will go in the `false` branch.
         // - accessors will throw, except `is_locked()`, `count_lock_owners()`, and `error()`
-        LockFile(const fs::u8path& path);
-        LockFile(const fs::u8path& path, const std::chrono::seconds& timeout);
+        // Locking exclusively a path that this process locks in `shared` mode upgrades the
+        // shared lock, which then remains exclusive until released.
+        LockFile(const fs::u8path& path, LockMode mode = LockMode::exclusive);
+        LockFile(
+            const fs::u8path& path,
+            const std::chrono::seconds& timeout,
+            LockMode mode = LockMode::exclusive
+        );
 
         ~LockFile();
 
@@ -235,6 +253,9 @@ namespace mamba
         // Returns the path of the lock-file being locked, throws if `is_locked() == false`.
         fs::u8path lockfile_path() const;
 
+        // Returns how the path is locked, throws if `is_locked() == false`.
+        LockMode mode() const;
+
         // Returns the count of LockFile instances which are currently locking
         // the same path/file from the same process.
         // Returns 0 if `is_locked() == false`.
@@ -7,6 +7,7 @@
 #ifndef MAMBA_CORE_UTIL_OS_HPP
 #define MAMBA_CORE_UTIL_OS_HPP
 
+#include <cstddef>
 #include <iosfwd>
 #include <string>
 
@@ -66,6 +67,9 @@ namespace mamba
     void codesign(const fs::u8path& path, bool verbose = false);
 
     std::string fix_win_path(const std::string& path);
+
+    /** The peak resident memory of the process in bytes, 0 if unknown. */
+    std::size_t peak_resident_memory();
 }
 
 #endif
@@ -13,9 +13,12 @@
 #include <cstring>
 #include <iomanip>
 #include <iterator>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -79,6 +82,15 @@ namespace mamba
 
     bool contains(std::string_view str, std::string_view sub_str);
 
+    /**
+     * Check if the path matches the glob pattern.
+     *
+     * ``?`` matches any character but ``/``, ``*`` any sequence of characters without ``/``,
+     * and ``**`` any sequence of characters. A ``**`` followed by ``/`` also matches no
+     * directory at all, as in Git ignore files.
+     */
+    bool glob_match(std::string_view pattern, std::string_view path);
+
     /**
      * Check if any of the strings starts with the prefix.
      */
@@ -171,6 +183,41 @@ namespace mamba
     std::vector<std::wstring>
     rsplit(std::wstring_view input, std::wstring_view sep, std::size_t max_split = SIZE_MAX);
 
+    /**
+     * Split the string at the first occurrence of the separator.
+     *
+     * The parts are views into @p str, the second one is empty if the separator is not found.
+     */
+    std::tuple<std::string_view, std::optional<std::string_view>>
+    split_once(std::string_view str, char sep);
+    std::tuple<std::string_view, std::optional<std::string_view>>
+    split_once(std::string_view str, std::string_view sep);
+
+    /**
+     * Split the string at the last occurrence of the separator.
+     *
+     * The parts are views into @p str, the first one is empty if the separator is not found.
+     */
+    std::tuple<std::optional<std::string_view>, std::string_view>
+    rsplit_once(std::string_view str, char sep);
+    std::tuple<std::optional<std::string_view>, std::string_view>
+    rsplit_once(std::string_view str, std::string_view sep);
+
+    /**
+     * Execute the function @p func on each part of the string split by the separator.
+     *
+     * The parts are the same as the ones of ``split`` but are given as views into @p input,
+     * without allocating them.
+     */
+    template <typename UnaryFunc>
+    void split_for_each(std::string_view input, std::string_view sep, UnaryFunc func);
+
+    /**
+     * Replace all non overlapping occurrences of @p search, from left to right.
+     *
+     * The string is modified in place when the replacement is not longer than the searched
+     * string, and otherwise reallocated at most once.
+     */
     void replace_all(std::string& data, std::string_view search, std::string_view replace);
     void replace_all(std::wstring& data, std::wstring_view search, std::wstring_view replace);
 
@@ -443,6 +490,27 @@ namespace mamba
         return detail::strip_if_parts_impl(input, std::move(should_strip));
     }
 
+    /***************************************
+     *  Implementation of split functions  *
+     ***************************************/
+
+    template <typename UnaryFunc>
+    void split_for_each(std::string_view input, std::string_view sep, UnaryFunc func)
+    {
+        if (sep.empty())
+        {
+            throw std::invalid_argument("Separator must have size greater than 0");
+        }
+        std::size_t start = 0;
+        for (auto pos = input.find(sep); pos != std::string_view::npos;
+             pos = input.find(sep, start))
+        {
+            func(input.substr(start, pos - start));
+            start = pos + sep.size();
+        }
+        func(input.substr(start));
+    }
+
     /**************************************
      *  Implementation of join functions  *
      **************************************/
@@ -18,10 +18,42 @@
 #include "mamba/core/timeref.hpp"
 #include "mamba/core/util.hpp"
 
+struct evp_md_st;
+struct evp_md_ctx_st;
+
 namespace mamba::validation
 {
     using nlohmann::json;
 
+    /**
+     * Incremental hash of data received in several chunks.
+     */
+    class HashStream
+    {
+    public:
+
+        static HashStream sha256();
+        static HashStream md5();
+
+        HashStream(HashStream&& other) noexcept;
+        HashStream& operator=(HashStream&& other) noexcept;
+        ~HashStream();
+
+        void update(const char* data, std::size_t size);
+        /** Return the hexadecimal digest, after which the stream must be reset to be updated. */
+        std::string hex_digest();
+        /** Start again from empty data. */
+        void reset();
+
+    private:
+
+        HashStream(const evp_md_st* type, std::size_t digest_size);
+
+        const evp_md_st* m_type;
+        evp_md_ctx_st* m_ctx;
+        std::size_t m_digest_size;
+    };
+
     std::string sha256sum(const fs::u8path& path);
     std::string md5sum(const fs::u8path& path);
     bool sha256(const fs::u8path& path, const std::string& validation);
@@ -487,6 +519,16 @@ namespace mamba::validation
     };
 
 
+    /**
+     * The signed metadata of a package, with its signatures
+     * as the serialized json found in the repodata.
+     */
+    struct SignedPackage
+    {
+        json signed_data;
+        std::string signatures;
+    };
+
     /**
      * Interface that performs validity checks
      * on a repository packages index.
@@ -500,6 +542,13 @@ namespace mamba::validation
         virtual void verify_index(const fs::u8path& p) const = 0;
         virtual void verify_package(const json& signed_data, const json& signatures) const = 0;
 
+        /**
+         * Verify many packages from @p n_threads threads.
+         * Throw a ``package_error`` if any of them is not trusted.
+         */
+        virtual void
+        verify_packages(const std::vector<SignedPackage>& packages, std::size_t n_threads) const;
+
     protected:
 
         RepoIndexChecker() = default;
@@ -531,12 +580,14 @@ namespace mamba::validation
         void verify_index(const json& j) const;
         void verify_index(const fs::u8path& p) const;
         void verify_package(const json& signed_data, const json& signatures) const;
+        void
+        verify_packages(const std::vector<SignedPackage>& packages, std::size_t n_threads) const;
 
         void generate_index_checker();
 
         const fs::u8path& cache_path();
 
-        std::size_t root_version();
+        std::size_t root_version() const;
 
     private:
 
@@ -784,6 +835,8 @@ namespace mamba::validation
             void verify_index(const fs::u8path& p) const override;
             void verify_index(const json& j) const override;
             void verify_package(const json& signed_data, const json& signatures) const override;
+            void verify_packages(const std::vector<SignedPackage>& packages, std::size_t n_threads)
+                const override;
 
             friend void to_json(json& j, const PkgMgrRole& r);
             friend void from_json(const json& j, PkgMgrRole& r);
@@ -797,6 +850,11 @@ namespace mamba::validation
             RoleFullKeys self_keys() const override;
             std::set<RoleSignature> pkg_signatures(const json& j) const;
             void check_pkg_signatures(const json& signed_data, const json& signatures) const;
+            void check_pkg_signatures(
+                const json& signed_data,
+                const json& signatures,
+                const RoleFullKeys& keys
+            ) const;
 
             void set_defined_roles(std::map<std::string, RolePubKeys> keys);
 
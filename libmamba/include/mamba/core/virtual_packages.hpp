@@ -18,7 +18,9 @@ namespace mamba
 
     namespace detail
     {
+        /** The CUDA version, from the driver library, or nvidia-smi as a fallback. */
         std::string cuda_version();
+        std::string cuda_smi_version();
         std::string get_arch();
 
         PackageInfo make_virtual_package(
@@ -0,0 +1,294 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_SPECS_REPO_DATA_TABLE_HPP
+#define MAMBA_SPECS_REPO_DATA_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <nlohmann/json_fwd.hpp>
+
+#include "mamba/specs/repo_data.hpp"
+#include "mamba/specs/version.hpp"
+
+namespace mamba::specs
+{
+    namespace detail
+    {
+        /**
+         * An iterator over a range of values accessed by index.
+         *
+         * Values are returned by copy, such as views, so that this is only an input iterator.
+         */
+        template <typename Range>
+        class IndexIterator
+        {
+        public:
+
+            using iterator_category = std::input_iterator_tag;
+            using value_type = typename Range::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = value_type;
+
+            IndexIterator() = default;
+
+            IndexIterator(const Range* range, std::size_t index)
+                : m_range(range)
+                , m_index(index)
+            {
+            }
+
+            auto operator*() const -> reference
+            {
+                return (*m_range)[m_index];
+            }
+
+            auto operator++() -> IndexIterator&
+            {
+                ++m_index;
+                return *this;
+            }
+
+            auto operator++(int) -> IndexIterator
+            {
+                auto out = *this;
+                ++m_index;
+                return out;
+            }
+
+            friend auto operator==(const IndexIterator& a, const IndexIterator& b) -> bool
+            {
+                return a.m_index == b.m_index;
+            }
+
+            friend auto operator!=(const IndexIterator& a, const IndexIterator& b) -> bool
+            {
+                return a.m_index != b.m_index;
+            }
+
+        private:
+
+            const Range* m_range = nullptr;
+            std::size_t m_index = 0;
+        };
+    }
+
+    /**
+     * The repository data of a ``repodata.json`` stored by columns.
+     *
+     * In ``RepoData``, every package is a struct of many strings and vectors, although most
+     * values, such as names, dependencies, or licenses, are shared by many packages.
+     * Here, every field is a column, with strings stored once in a pool and referred to by
+     * their integer id, and lists, such as ``depends``, stored as ranges of a single array of
+     * ids.
+     * The memory used is several times smaller than that of ``RepoData``.
+     *
+     * Packages are read through lightweight views, with the same fields as ``RepoDataPackage``,
+     * and to which they can be converted.
+     * Views refer to the table, which must outlive them.
+     */
+    class RepoDataTable
+    {
+    public:
+
+        using size_type = std::size_t;
+        using string_id = std::uint32_t;
+
+        class PackageView;
+
+        /** The strings of a list field of a package, such as its dependencies. */
+        class StringRange
+        {
+        public:
+
+            using value_type = std::string_view;
+            using const_iterator = detail::IndexIterator<StringRange>;
+
+            [[nodiscard]] auto size() const -> size_type;
+            [[nodiscard]] auto empty() const -> bool;
+            [[nodiscard]] auto operator[](size_type pos) const -> std::string_view;
+
+            [[nodiscard]] auto begin() const -> const_iterator;
+            [[nodiscard]] auto end() const -> const_iterator;
+
+            [[nodiscard]] auto to_vector() const -> std::vector<std::string>;
+
+        private:
+
+            const RepoDataTable* m_table;
+            const string_id* m_first;
+            const string_id* m_last;
+
+            StringRange(const RepoDataTable* table, const string_id* first, const string_id* last);
+
+            friend class RepoDataTable;
+        };
+
+        /** A view on a package of the table, with the fields of ``RepoDataPackage``. */
+        class PackageView
+        {
+        public:
+
+            /** The filename of the package, such as ``libmamba-1.3.0-hcea66bb_1.conda``. */
+            [[nodiscard]] auto filename() const -> std::string_view;
+
+            [[nodiscard]] auto name() const -> std::string_view;
+            /** The version, parsed on every call. */
+            [[nodiscard]] auto version() const -> Version;
+            /** The version as written in the repodata. */
+            [[nodiscard]] auto version_str() const -> std::string_view;
+            [[nodiscard]] auto build_string() const -> std::string_view;
+            [[nodiscard]] auto build_number() const -> std::size_t;
+            [[nodiscard]] auto subdir() const -> std::string_view;
+            [[nodiscard]] auto md5() const -> std::optional<std::string_view>;
+            [[nodiscard]] auto sha256() const -> std::optional<std::string_view>;
+            [[nodiscard]] auto legacy_bz2_md5() const -> std::optional<std::string_view>;
+            [[nodiscard]] auto legacy_bz2_size() const -> std::optional<std::size_t>;
+            [[nodiscard]] auto size() const -> std::optional<std::size_t>;
+            [[nodiscard]] auto arch() const -> std::optional<std::string_view>;
+            [[nodiscard]] auto platform() const -> std::optional<std::string_view>;
+            [[nodiscard]] auto depends() const -> StringRange;
+            [[nodiscard]] auto constrains() const -> StringRange;
+            [[nodiscard]] auto track_features() const -> StringRange;
+            [[nodiscard]] auto features() const -> std::optional<std::string_view>;
+            [[nodiscard]] auto noarch() const -> std::optional<NoArchType>;
+            [[nodiscard]] auto license() const -> std::optional<std::string_view>;
+            [[nodiscard]] auto license_family() const -> std::optional<std::string_view>;
+            [[nodiscard]] auto timestamp() const -> std::optional<std::size_t>;
+
+            /** Copy the fields of the package out of the table. */
+            [[nodiscard]] auto to_package() const -> RepoDataPackage;
+
+        private:
+
+            const RepoDataTable* m_table;
+            size_type m_row;
+
+            PackageView(const RepoDataTable* table, size_type row);
+
+            friend class RepoDataTable;
+        };
+
+        /** The packages of one of the sections of the repodata, sorted by filename. */
+        class PackageRange
+        {
+        public:
+
+            using value_type = PackageView;
+            using const_iterator = detail::IndexIterator<PackageRange>;
+
+            [[nodiscard]] auto size() const -> size_type;
+            [[nodiscard]] auto empty() const -> bool;
+            [[nodiscard]] auto operator[](size_type pos) const -> PackageView;
+
+            [[nodiscard]] auto begin() const -> const_iterator;
+            [[nodiscard]] auto end() const -> const_iterator;
+
+            /** The package with the given filename, if any. */
+            [[nodiscard]] auto find(std::string_view filename) const
+                -> std::optional<PackageView>;
+
+        private:
+
+            const RepoDataTable* m_table;
+            size_type m_first;
+            size_type m_last;
+
+            PackageRange(const RepoDataTable* table, size_type first, size_type last);
+
+            friend class RepoDataTable;
+        };
+
+        /**
+         * Build the table from the json of a ``repodata.json``.
+         *
+         * Fields are read as in ``from_json(const nlohmann::json&, RepoData&)``, and raise the
+         * same errors.
+         * The ``.conda`` packages are also read from the ``packages.conda`` key used in the
+         * ``repodata.json`` of channels.
+         */
+        [[nodiscard]] static auto from_json(const nlohmann::json& j) -> RepoDataTable;
+
+        [[nodiscard]] auto version() const -> const std::optional<std::size_t>&;
+        [[nodiscard]] auto info() const -> const std::optional<ChannelInfo>&;
+        [[nodiscard]] auto removed() const -> const std::vector<std::string>&;
+
+        /** The ``.tar.bz2`` packages, under the ``packages`` key. */
+        [[nodiscard]] auto packages() const -> PackageRange;
+        /** The ``.conda`` packages, under the ``conda_packages`` key. */
+        [[nodiscard]] auto conda_packages() const -> PackageRange;
+
+        /** Copy the table into the struct representation. */
+        [[nodiscard]] auto to_repo_data() const -> RepoData;
+
+        /** The number of bytes allocated by the table. */
+        [[nodiscard]] auto memory_usage() const -> std::size_t;
+
+    private:
+
+        class Builder;
+
+        /** Unique strings, stored contiguously. The id zero is a missing value. */
+        struct StringPool
+        {
+            std::string chars = {};
+            std::vector<std::uint32_t> offsets = { 0, 0 };
+        };
+
+        /** Lists of strings, those of package ``i`` in ``[offsets[i], offsets[i + 1])``. */
+        struct ListColumn
+        {
+            std::vector<string_id> items = {};
+            std::vector<std::uint32_t> offsets = { 0 };
+        };
+
+        StringPool m_strings = {};
+
+        std::vector<string_id> m_filename = {};
+        std::vector<string_id> m_name = {};
+        std::vector<string_id> m_version_str = {};
+        std::vector<string_id> m_build_string = {};
+        // Missing numbers are the maximum value
+        std::vector<std::uint64_t> m_build_number = {};
+        std::vector<string_id> m_subdir = {};
+        std::vector<string_id> m_md5 = {};
+        std::vector<string_id> m_sha256 = {};
+        std::vector<string_id> m_legacy_bz2_md5 = {};
+        std::vector<std::uint64_t> m_legacy_bz2_size = {};
+        std::vector<std::uint64_t> m_size = {};
+        std::vector<string_id> m_arch = {};
+        std::vector<string_id> m_platform = {};
+        ListColumn m_depends = {};
+        ListColumn m_constrains = {};
+        ListColumn m_track_features = {};
+        std::vector<string_id> m_features = {};
+        /** The ``NoArchType`` plus one, zero when missing. */
+        std::vector<std::uint8_t> m_noarch = {};
+        std::vector<string_id> m_license = {};
+        std::vector<string_id> m_license_family = {};
+        std::vector<std::uint64_t> m_timestamp = {};
+
+        /** Packages in ``[0, m_n_packages)`` are ``.tar.bz2``, the following ``.conda``. */
+        size_type m_n_packages = 0;
+
+        std::optional<std::size_t> m_version = {};
+        std::optional<ChannelInfo> m_info = {};
+        std::vector<std::string> m_removed = {};
+
+        [[nodiscard]] auto string(string_id id) const -> std::string_view;
+        [[nodiscard]] auto optional_string(string_id id) const -> std::optional<std::string_view>;
+        [[nodiscard]] auto list(const ListColumn& col, size_type row) const -> StringRange;
+        [[nodiscard]] auto n_rows() const -> size_type;
+    };
+}
+#endif
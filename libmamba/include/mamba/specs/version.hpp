@@ -7,6 +7,7 @@
 #ifndef MAMBA_SPECS_VERSION_HPP
 #define MAMBA_SPECS_VERSION_HPP
 
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -38,6 +39,13 @@ namespace mamba::specs
         auto numeral() const noexcept -> std::size_t;
         auto literal() const& noexcept -> const std::string&;
         auto literal() && noexcept -> std::string;
+        /**
+         * The rank of the literal among the special ones, zero for any other literal.
+         *
+         * Computed when the atom is built, so that comparing literals is mostly comparing
+         * ranks.
+         */
+        auto literal_rank() const noexcept -> int;
 
         auto str() const -> std::string;
 
@@ -53,6 +61,7 @@ namespace mamba::specs
         // Stored in decreasing size order for performance
         std::string m_literal = "";
         std::size_t m_numeral = 0;
+        std::int8_t m_literal_rank = 1;
     };
 
     extern template VersionPartAtom::VersionPartAtom(std::size_t, std::string&&);
@@ -142,10 +151,27 @@ namespace mamba::specs
 
     private:
 
+        /**
+         * Purely numeric versions with few small parts, such as 1.2.3, are also encoded as
+         * a single integer, so that comparing them does not need to walk the parts.
+         */
+        using packed_type = std::uint64_t;
+
+        static constexpr std::size_t packed_parts = 4;
+        static constexpr std::size_t packed_part_bits = 16;
+        static constexpr packed_type not_packed = ~packed_type(0);
+
+        static auto
+        pack(std::size_t epoch, const CommonVersion& version, const CommonVersion& local)
+            -> packed_type;
+
         // Stored in decreasing size order for performance
         CommonVersion m_version = {};
         CommonVersion m_local = {};
         std::size_t m_epoch = 0;
+        packed_type m_packed = 0;
+
+        [[nodiscard]] auto both_packed(const Version& other) const noexcept -> bool;
     };
 }
 
@@ -0,0 +1,118 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_UTIL_BOUNDED_CACHE_HPP
+#define MAMBA_UTIL_BOUNDED_CACHE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace mamba::util
+{
+    /**
+     * A thread-safe cache of values by string, such as the objects parsed from them.
+     *
+     * The cache holds at most about ``capacity`` values. Keys are spread over shards locked
+     * independently, each keeping its values in two generations: when the current generation
+     * is full, it becomes the previous one, and the values of the previous one are dropped.
+     * Values found in the previous generation move back to the current one, so that the values
+     * in use are kept, without the bookkeeping of a least recently used list.
+     *
+     * Values are copied out of the cache, which is only worth it when copying a value is much
+     * cheaper than making it.
+     */
+    template <typename Value>
+    class BoundedCache
+    {
+    public:
+
+        using value_type = Value;
+
+        explicit BoundedCache(std::size_t capacity)
+            : m_shard_capacity(std::max<std::size_t>(capacity / (2 * n_shards), 1))
+        {
+        }
+
+        BoundedCache(const BoundedCache&) = delete;
+        BoundedCache& operator=(const BoundedCache&) = delete;
+        BoundedCache(BoundedCache&&) = delete;
+        BoundedCache& operator=(BoundedCache&&) = delete;
+
+        /**
+         * The value of @p key, made with ``make(key)`` if it is not in the cache.
+         *
+         * Values are made without holding a lock, and are not cached if ``make`` throws.
+         */
+        template <typename Make>
+        auto get_or_make(std::string_view key, Make&& make) -> value_type
+        {
+            auto str_key = std::string(key);
+            auto& shard = m_shards[std::hash<std::string>()(str_key) % n_shards];
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                if (const auto it = shard.current.find(str_key); it != shard.current.end())
+                {
+                    return it->second;
+                }
+                if (auto it = shard.previous.find(str_key); it != shard.previous.end())
+                {
+                    auto node = shard.previous.extract(it);
+                    auto value = node.mapped();
+                    insert(shard, std::move(node.key()), std::move(node.mapped()));
+                    return value;
+                }
+            }
+
+            auto value = std::invoke(std::forward<Make>(make), key);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            insert(shard, std::move(str_key), value);
+            return value;
+        }
+
+        void clear()
+        {
+            for (auto& shard : m_shards)
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.current.clear();
+                shard.previous.clear();
+            }
+        }
+
+    private:
+
+        static constexpr std::size_t n_shards = 16;
+
+        using map_type = std::unordered_map<std::string, value_type>;
+
+        struct Shard
+        {
+            map_type current;
+            map_type previous;
+            std::mutex mutex;
+        };
+
+        std::array<Shard, n_shards> m_shards;
+        std::size_t m_shard_capacity;
+
+        void insert(Shard& shard, std::string&& key, value_type value)
+        {
+            if (shard.current.size() >= m_shard_capacity)
+            {
+                shard.previous = std::exchange(shard.current, map_type());
+            }
+            shard.current.insert_or_assign(std::move(key), std::move(value));
+        }
+    };
+}
+#endif
@@ -9,6 +9,7 @@
 #define MAMBA_UTILFLAT_SET_HPP
 
 #include <algorithm>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -22,6 +23,10 @@ namespace mamba::util
      * In imprecise terms, two objects ``a`` and ``b`` are considered equivalent if neither
      * compares less than the other: ``!comp(a, b) && !comp(b, a)``
      *
+     * Like ``std::set``, if the comparator is transparent (e.g. ``std::less<>``), lookups can
+     * be made with any type comparable with the keys, such as ``std::string_view`` in a set of
+     * ``std::string``, without constructing a key.
+     *
      * @todo C++23 This is implemented in <flat_set>
      */
     template <typename Key, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>>
@@ -70,6 +75,11 @@ namespace mamba::util
         flat_set& operator=(flat_set&&) = default;
 
         bool contains(const value_type&) const;
+        template <typename Other, typename C = Compare, typename = typename C::is_transparent>
+        bool contains(const Other&) const;
+        const_iterator find(const value_type&) const;
+        template <typename Other, typename C = Compare, typename = typename C::is_transparent>
+        const_iterator find(const Other&) const;
         const value_type& front() const noexcept;
         const value_type& back() const noexcept;
         const value_type& operator[](size_type pos) const;
@@ -86,21 +96,39 @@ namespace mamba::util
          */
         std::pair<const_iterator, bool> insert(value_type&& value);
         std::pair<const_iterator, bool> insert(const value_type& value);
+        /**
+         * Insert a range of elements in the set.
+         *
+         * Only the new elements are sorted, before being merged with the existing ones.
+         * Elements already in the set are kept over equivalent new ones.
+         */
         template <typename InputIterator>
         void insert(InputIterator first, InputIterator last);
 
         const_iterator erase(const_iterator pos);
         const_iterator erase(const_iterator first, const_iterator last);
         size_type erase(const value_type& value);
+        template <
+            typename Other,
+            typename C = Compare,
+            typename = typename C::is_transparent,
+            typename = std::enable_if_t<!std::is_convertible_v<const Other&, const_iterator>>>
+        size_type erase(const Other& value);
 
     private:
 
         key_compare m_compare;
 
-        bool key_eq(const value_type& a, const value_type& b) const;
+        template <typename T, typename U>
+        bool key_eq(const T& a, const U& b) const;
+        template <typename Other>
+        const_iterator find_impl(const Other& value) const;
+        template <typename Other>
+        size_type erase_impl(const Other& value);
         template <typename U>
         std::pair<const_iterator, bool> insert_impl(U&& value);
         void sort_and_remove_duplicates();
+        void remove_duplicates();
 
         template <typename K, typename C, typename A>
         friend bool operator==(const flat_set<K, C, A>& lhs, const flat_set<K, C, A>& rhs);
@@ -182,7 +210,27 @@ namespace mamba::util
     template <typename K, typename C, typename A>
     auto flat_set<K, C, A>::contains(const value_type& value) const -> bool
     {
-        return std::binary_search(begin(), end(), value);
+        return find_impl(value) != end();
+    }
+
+    template <typename K, typename C, typename A>
+    template <typename Other, typename, typename>
+    auto flat_set<K, C, A>::contains(const Other& value) const -> bool
+    {
+        return find_impl(value) != end();
+    }
+
+    template <typename K, typename C, typename A>
+    auto flat_set<K, C, A>::find(const value_type& value) const -> const_iterator
+    {
+        return find_impl(value);
+    }
+
+    template <typename K, typename C, typename A>
+    template <typename Other, typename, typename>
+    auto flat_set<K, C, A>::find(const Other& value) const -> const_iterator
+    {
+        return find_impl(value);
     }
 
     template <typename K, typename C, typename A>
@@ -246,15 +294,34 @@ namespace mamba::util
     }
 
     template <typename K, typename C, typename A>
-    bool flat_set<K, C, A>::key_eq(const value_type& a, const value_type& b) const
+    template <typename T, typename U>
+    bool flat_set<K, C, A>::key_eq(const T& a, const U& b) const
     {
         return !m_compare(a, b) && !m_compare(b, a);
     }
 
+    template <typename K, typename C, typename A>
+    template <typename Other>
+    auto flat_set<K, C, A>::find_impl(const Other& value) const -> const_iterator
+    {
+        const auto it = std::lower_bound(begin(), end(), value, m_compare);
+        if ((it != end()) && key_eq(*it, value))
+        {
+            return it;
+        }
+        return end();
+    }
+
     template <typename K, typename C, typename A>
     void flat_set<K, C, A>::sort_and_remove_duplicates()
     {
         std::sort(Base::begin(), Base::end(), m_compare);
+        remove_duplicates();
+    }
+
+    template <typename K, typename C, typename A>
+    void flat_set<K, C, A>::remove_duplicates()
+    {
         auto is_eq = [this](const value_type& a, const value_type& b) { return key_eq(a, b); };
         Base::erase(std::unique(Base::begin(), Base::end(), is_eq), Base::end());
     }
@@ -263,8 +330,13 @@ namespace mamba::util
     template <typename InputIterator>
     void flat_set<K, C, A>::insert(InputIterator first, InputIterator last)
     {
+        const auto old_size = static_cast<typename Base::difference_type>(size());
         Base::insert(Base::end(), first, last);
-        sort_and_remove_duplicates();
+        const auto new_begin = Base::begin() + old_size;
+        std::sort(new_begin, Base::end(), m_compare);
+        // Stable, so that unique keeps the existing element over an equivalent new one
+        std::inplace_merge(Base::begin(), new_begin, Base::end(), m_compare);
+        remove_duplicates();
     }
 
     template <typename K, typename C, typename A>
@@ -297,8 +369,22 @@ namespace mamba::util
     template <typename K, typename C, typename A>
     auto flat_set<K, C, A>::erase(const value_type& value) -> size_type
     {
-        auto it = std::lower_bound(begin(), end(), value, m_compare);
-        if ((it == end()) || (!(key_eq(*it, value))))
+        return erase_impl(value);
+    }
+
+    template <typename K, typename C, typename A>
+    template <typename Other, typename, typename, typename>
+    auto flat_set<K, C, A>::erase(const Other& value) -> size_type
+    {
+        return erase_impl(value);
+    }
+
+    template <typename K, typename C, typename A>
+    template <typename Other>
+    auto flat_set<K, C, A>::erase_impl(const Other& value) -> size_type
+    {
+        const auto it = find_impl(value);
+        if (it == end())
         {
             return 0;
         }
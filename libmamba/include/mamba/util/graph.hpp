@@ -12,6 +12,8 @@
 #include <functional>
 #include <iterator>
 #include <map>
+#include <stdexcept>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -234,6 +236,113 @@ namespace mamba::util
     {
     };
 
+    /**
+     * An immutable directed graph in compressed sparse row form.
+     *
+     * Nodes are stored contiguously and the successors (and predecessors) of all nodes are
+     * stored in a single array, which makes traversals of large graphs cache friendly.
+     * It is built from a @ref DiGraph once it is complete, and can be used with the same
+     * algorithms, such as @ref dfs_raw or @ref topological_sort_for_each_node_id.
+     *
+     * Node ids are the ones of the source graph if no node was removed from it, otherwise
+     * they are renumbered by increasing id of the source graph.
+     */
+    template <typename Node, typename Edge = void>
+    class CompressedDiGraph
+    {
+    public:
+
+        using node_t = Node;
+        using edge_t = Edge;
+        using node_id = std::size_t;
+        using node_list = std::vector<node_t>;
+
+        /** The ids of the successors or predecessors of a node, in increasing order. */
+        class node_id_list
+        {
+        public:
+
+            using value_type = node_id;
+            using const_iterator = const node_id*;
+            using iterator = const_iterator;
+
+            node_id_list(const node_id* first, const node_id* last);
+
+            auto begin() const -> const_iterator;
+            auto end() const -> const_iterator;
+            auto size() const -> std::size_t;
+            auto empty() const -> bool;
+            auto contains(node_id id) const -> bool;
+
+        private:
+
+            const node_id* p_first;
+            const node_id* p_last;
+        };
+
+        /** The adjacency of all the nodes, with the offsets of each one in a single array. */
+        class adjacency_list
+        {
+        public:
+
+            auto size() const -> std::size_t;
+            auto operator[](node_id id) const -> node_id_list;
+
+        private:
+
+            /** Start of each node in ``m_ids``, with one more for the end of the last one. */
+            std::vector<std::size_t> m_offsets = { 0 };
+            std::vector<node_id> m_ids = {};
+
+            friend class CompressedDiGraph;
+        };
+
+        CompressedDiGraph() = default;
+
+        explicit CompressedDiGraph(const DiGraph<Node, Edge>& graph);
+
+        bool empty() const;
+        std::size_t number_of_nodes() const noexcept;
+        std::size_t number_of_edges() const noexcept;
+        std::size_t in_degree(node_id id) const noexcept;
+        std::size_t out_degree(node_id id) const noexcept;
+        const node_list& nodes() const;
+        const node_t& node(node_id id) const;
+        node_id_list successors(node_id id) const;
+        const adjacency_list& successors() const;
+        node_id_list predecessors(node_id id) const;
+        const adjacency_list& predecessors() const;
+        bool has_node(node_id id) const;
+        bool has_edge(node_id from, node_id to) const;
+
+        template <typename E = Edge>
+        auto edge(node_id from, node_id to) const -> const E&;
+
+        template <typename UnaryFunc>
+        UnaryFunc for_each_node_id(UnaryFunc func) const;
+        template <typename BinaryFunc>
+        BinaryFunc for_each_edge_id(BinaryFunc func) const;
+        template <typename UnaryFunc>
+        UnaryFunc for_each_leaf_id(UnaryFunc func) const;
+        template <typename UnaryFunc>
+        UnaryFunc for_each_root_id(UnaryFunc func) const;
+
+    private:
+
+        using edge_list = std::vector<std::conditional_t<std::is_void_v<Edge>, char, Edge>>;
+
+        node_list m_nodes = {};
+        adjacency_list m_successors = {};
+        adjacency_list m_predecessors = {};
+        /** The data of the edges, in the same order as the ids of ``m_successors``. */
+        edge_list m_edges = {};
+
+        static auto compress(
+            const typename DiGraph<Node, Edge>::adjacency_list& adjacency,
+            const std::vector<node_id>& ids
+        ) -> adjacency_list;
+    };
+
     /********************************
      *  DiGraphBase Implementation  *
      ********************************/
@@ -725,6 +834,251 @@ namespace mamba::util
         dfs_postorder_nodes_for_each_id(graph, func, /* reverse= */ true);
     }
 
+    /**************************************
+     *  CompressedDiGraph Implementation  *
+     **************************************/
+
+    template <typename N, typename E>
+    CompressedDiGraph<N, E>::node_id_list::node_id_list(const node_id* first, const node_id* last)
+        : p_first(first)
+        , p_last(last)
+    {
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::node_id_list::begin() const -> const_iterator
+    {
+        return p_first;
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::node_id_list::end() const -> const_iterator
+    {
+        return p_last;
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::node_id_list::size() const -> std::size_t
+    {
+        return static_cast<std::size_t>(p_last - p_first);
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::node_id_list::empty() const -> bool
+    {
+        return p_first == p_last;
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::node_id_list::contains(node_id id) const -> bool
+    {
+        return std::binary_search(p_first, p_last, id);
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::adjacency_list::size() const -> std::size_t
+    {
+        return m_offsets.size() - 1;
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::adjacency_list::operator[](node_id id) const -> node_id_list
+    {
+        return { m_ids.data() + m_offsets[id], m_ids.data() + m_offsets[id + 1] };
+    }
+
+    template <typename N, typename E>
+    CompressedDiGraph<N, E>::CompressedDiGraph(const DiGraph<N, E>& graph)
+    {
+        // Renumber the nodes without the slots left by removed ones, keeping their order
+        const auto n_ids = graph.successors().size();
+        auto ids = std::vector<node_id>(n_ids, n_ids);
+        m_nodes.reserve(graph.number_of_nodes());
+        for (const auto& [id, node] : graph.nodes())
+        {
+            ids[id] = m_nodes.size();
+            m_nodes.push_back(node);
+        }
+        m_successors = compress(graph.successors(), ids);
+        m_predecessors = compress(graph.predecessors(), ids);
+
+        if constexpr (!std::is_void_v<E>)
+        {
+            m_edges.reserve(number_of_edges());
+            // Edges are ordered by source then target, as the compressed successors
+            for (const auto& [_, data] : graph.edges())
+            {
+                m_edges.push_back(data);
+            }
+        }
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::compress(
+        const typename DiGraph<N, E>::adjacency_list& adjacency,
+        const std::vector<node_id>& ids
+    ) -> adjacency_list
+    {
+        auto out = adjacency_list();
+        for (node_id old_id = 0; old_id < ids.size(); ++old_id)
+        {
+            // Removed nodes have no id and no edges left
+            if (ids[old_id] != ids.size())
+            {
+                for (const node_id to : adjacency[old_id])
+                {
+                    out.m_ids.push_back(ids[to]);
+                }
+                out.m_offsets.push_back(out.m_ids.size());
+            }
+        }
+        return out;
+    }
+
+    template <typename N, typename E>
+    bool CompressedDiGraph<N, E>::empty() const
+    {
+        return m_nodes.empty();
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::number_of_nodes() const noexcept -> std::size_t
+    {
+        return m_nodes.size();
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::number_of_edges() const noexcept -> std::size_t
+    {
+        return m_successors.m_ids.size();
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::in_degree(node_id id) const noexcept -> std::size_t
+    {
+        return m_predecessors[id].size();
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::out_degree(node_id id) const noexcept -> std::size_t
+    {
+        return m_successors[id].size();
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::nodes() const -> const node_list&
+    {
+        return m_nodes;
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::node(node_id id) const -> const node_t&
+    {
+        return m_nodes.at(id);
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::successors(node_id id) const -> node_id_list
+    {
+        return m_successors[id];
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::successors() const -> const adjacency_list&
+    {
+        return m_successors;
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::predecessors(node_id id) const -> node_id_list
+    {
+        return m_predecessors[id];
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::predecessors() const -> const adjacency_list&
+    {
+        return m_predecessors;
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::has_node(node_id id) const -> bool
+    {
+        return id < number_of_nodes();
+    }
+
+    template <typename N, typename E>
+    auto CompressedDiGraph<N, E>::has_edge(node_id from, node_id to) const -> bool
+    {
+        return has_node(from) && successors(from).contains(to);
+    }
+
+    template <typename N, typename E>
+    template <typename E2>
+    auto CompressedDiGraph<N, E>::edge(node_id from, node_id to) const -> const E2&
+    {
+        const auto succs = successors(from);
+        const auto it = std::lower_bound(succs.begin(), succs.end(), to);
+        if ((it == succs.end()) || (*it != to))
+        {
+            throw std::out_of_range("no such edge");
+        }
+        return m_edges[static_cast<std::size_t>(it - m_successors.m_ids.data())];
+    }
+
+    template <typename N, typename E>
+    template <typename UnaryFunc>
+    UnaryFunc CompressedDiGraph<N, E>::for_each_node_id(UnaryFunc func) const
+    {
+        for (node_id i = 0; i < number_of_nodes(); ++i)
+        {
+            func(i);
+        }
+        return func;
+    }
+
+    template <typename N, typename E>
+    template <typename BinaryFunc>
+    BinaryFunc CompressedDiGraph<N, E>::for_each_edge_id(BinaryFunc func) const
+    {
+        for (node_id i = 0; i < number_of_nodes(); ++i)
+        {
+            for (node_id j : successors(i))
+            {
+                func(i, j);
+            }
+        }
+        return func;
+    }
+
+    template <typename N, typename E>
+    template <typename UnaryFunc>
+    UnaryFunc CompressedDiGraph<N, E>::for_each_leaf_id(UnaryFunc func) const
+    {
+        for (node_id i = 0; i < number_of_nodes(); ++i)
+        {
+            if (out_degree(i) == 0)
+            {
+                func(i);
+            }
+        }
+        return func;
+    }
+
+    template <typename N, typename E>
+    template <typename UnaryFunc>
+    UnaryFunc CompressedDiGraph<N, E>::for_each_root_id(UnaryFunc func) const
+    {
+        for (node_id i = 0; i < number_of_nodes(); ++i)
+        {
+            if (in_degree(i) == 0)
+            {
+                func(i);
+            }
+        }
+        return func;
+    }
+
     /*********************************
      *  DiGraph Edge Implementation  *
      *********************************/
@@ -4,15 +4,37 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
 #include "mamba/api/channel_loader.hpp"
 #include "mamba/core/channel.hpp"
+#include "mamba/core/completion_index.hpp"
+#include "mamba/core/fetch.hpp"
+#include "mamba/core/memory_budget.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/prefix_data.hpp"
 #include "mamba/core/repo.hpp"
 #include "mamba/core/subdirdata.hpp"
 #include "mamba/core/thread_utils.hpp"
+#include "mamba/core/tracing.hpp"
+#include "mamba/core/url.hpp"
+#include "mamba/core/util.hpp"
 #include "mamba/core/util_string.hpp"
 
+#include "../core/repodata_shards.hpp"
+#include "../core/repodata_subset.hpp"
+
 namespace mamba
 {
     namespace
@@ -30,6 +52,28 @@ namespace mamba
                 throw std::runtime_error("Specified pkgs_dir does not exist\n");
             }
             PrefixData& prefix_data = sprefix_data.value();
+
+            // Extracting or removing a package changes the modification time of the directory,
+            // so the solv file is written in a subdirectory, created before reading the time
+            const auto& ctx = Context::instance();
+            const auto solv_file = pkgs_dir / "cache" / "pkgs_dir.solv";
+            auto ec = std::error_code();
+            fs::create_directories(solv_file.parent_path(), ec);
+            const auto mtime = fs::last_write_time(pkgs_dir).time_since_epoch().count();
+            const auto meta = RepoMetadata{
+                /* .url= */ path_to_url(pkgs_dir.string()),
+                /* .etag= */ "",
+                /* .mod= */ std::to_string(mtime),
+                /* .pip_added= */ ctx.add_pip_as_python_dependency,
+            };
+            if (auto repo = MRepo::read_solv_file(pool, "installed", solv_file, meta))
+            {
+                LOG_INFO << "Loaded the packages of " << pkgs_dir << " from " << solv_file;
+                repo->set_installed();
+                return std::move(repo).value();
+            }
+
+            auto repodata_record_jsons = std::vector<fs::u8path>();
             for (const auto& entry : fs::directory_iterator(pkgs_dir))
             {
                 fs::u8path repodata_record_json = entry.path() / "info" / "repodata_record.json";
@@ -37,22 +81,365 @@ namespace mamba
                 {
                     continue;
                 }
-                prefix_data.load_single_record(repodata_record_json);
+                repodata_record_jsons.push_back(std::move(repodata_record_json));
+            }
+            prefix_data.load_records(repodata_record_jsons);
+            auto repo = MRepo(pool, prefix_data, meta);
+            try
+            {
+                repo.write_solv(solv_file);
+            }
+            catch (const std::exception& e)
+            {
+                // Such as read-only package caches
+                LOG_INFO << "Could not write " << solv_file << ": " << e.what();
+            }
+            return repo;
+        }
+
+        using maybe_records = std::optional<expected_t<RepoDataRecords>>;
+
+        /**
+         * Read repodata.json files on worker threads as soon as they are available.
+         *
+         * Reading the records does not involve the pool, hence can run while other subdirs
+         * are still downloading, while adding them to the pool is left to the caller, who
+         * waits for each subdir in order so that the pool insertion stays deterministic.
+         * Subdirs that were never submitted (not loaded, using or updating a solv cache) are left
+         * empty and should be loaded in the regular way.
+         * So are the subdirs whose records do not fit in the ``MemoryBudget``, as the regular way
+         * adds them to the pool while parsing instead of holding them all.
+         */
+        class RepoDataRecordsReader
+        {
+        public:
+
+            RepoDataRecordsReader(std::size_t n_subdirs, std::size_t n_threads)
+                : m_results(n_subdirs)
+                , m_memory(n_subdirs)
+                , m_status(n_subdirs, Status::none)
+            {
+                m_workers.reserve(n_threads);
+                for (std::size_t t = 0; t < n_threads; ++t)
+                {
+                    m_workers.emplace_back([this]() { work(); });
+                }
+            }
+
+            ~RepoDataRecordsReader()
+            {
+                {
+                    auto lock = std::unique_lock(m_mutex);
+                    m_closed = true;
+                }
+                m_cv.notify_all();
+                for (auto& w : m_workers)
+                {
+                    w.join();
+                }
+            }
+
+            RepoDataRecordsReader(const RepoDataRecordsReader&) = delete;
+            RepoDataRecordsReader& operator=(const RepoDataRecordsReader&) = delete;
+            RepoDataRecordsReader(RepoDataRecordsReader&&) = delete;
+            RepoDataRecordsReader& operator=(RepoDataRecordsReader&&) = delete;
+
+            /** Schedule the reading of the subdir json cache, if it is to be read. */
+            void submit(std::size_t idx, const MSubdirData& subdir)
+            {
+                // Stale caches are read once refreshed, in the regular way otherwise
+                if (!subdir.loaded() || subdir.has_records_update() || subdir.is_stale())
+                {
+                    return;
+                }
+                auto cache = subdir.cache_path();
+                if (!cache || !ends_with(*cache, ".json"))
+                {
+                    return;
+                }
+                {
+                    auto lock = std::unique_lock(m_mutex);
+                    if (m_status[idx] != Status::none)
+                    {
+                        return;
+                    }
+                    auto memory = MemoryBudget::instance().try_reserve(records_memory(*cache));
+                    if (!memory.has_value())
+                    {
+                        LOG_DEBUG << "Not enough memory to read '" << *cache << "' in parallel";
+                        return;
+                    }
+                    m_memory[idx] = std::move(memory).value();
+                    m_status[idx] = Status::pending;
+                    m_jobs.emplace_back(idx, std::move(cache).value());
+                }
+                m_cv.notify_all();
+            }
+
+            /** Wait for the records of a subdir, empty if it was never submitted. */
+            auto wait(std::size_t idx) -> maybe_records
+            {
+                auto lock = std::unique_lock(m_mutex);
+                m_cv.wait(lock, [&]() { return m_status[idx] != Status::pending; });
+                // The records are added to the pool by the caller right away
+                m_memory[idx].release();
+                return std::exchange(m_results[idx], std::nullopt);
+            }
+
+        private:
+
+            enum class Status
+            {
+                none,
+                pending,
+                done
+            };
+
+            /** The memory estimated to hold the records of a repodata.json file. */
+            static auto records_memory(const fs::u8path& file) -> std::size_t
+            {
+                std::error_code ec;
+                const auto size = fs::file_size(file, ec);
+                // The parsed strings and their containers take about twice the JSON text
+                return ec ? 0 : 2 * static_cast<std::size_t>(size);
+            }
+
+            void work()
+            {
+                const bool only_tar_bz2 = Context::instance().use_only_tar_bz2;
+                auto lock = std::unique_lock(m_mutex);
+                while (true)
+                {
+                    m_cv.wait(lock, [&]() { return m_closed || !m_jobs.empty(); });
+                    if (m_jobs.empty())
+                    {
+                        return;
+                    }
+                    auto [idx, file] = std::move(m_jobs.front());
+                    m_jobs.pop_front();
+                    lock.unlock();
+
+                    auto result = maybe_records();
+                    try
+                    {
+                        result = RepoDataRecords::read(file, only_tar_bz2);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        result = make_unexpected(e.what(), mamba_error_code::repodata_not_loaded);
+                    }
+
+                    lock.lock();
+                    m_results[idx] = std::move(result);
+                    m_status[idx] = Status::done;
+                    m_cv.notify_all();
+                }
+            }
+
+            std::mutex m_mutex;
+            std::condition_variable m_cv;
+            std::deque<std::pair<std::size_t, fs::u8path>> m_jobs;
+            std::vector<maybe_records> m_results;
+            std::vector<MemoryBudget::Reservation> m_memory;
+            std::vector<Status> m_status;
+            std::vector<std::thread> m_workers;
+            bool m_closed = false;
+        };
+
+        auto make_repodata_records_reader(std::size_t n_subdirs)
+            -> std::unique_ptr<RepoDataRecordsReader>
+        {
+            const auto& ctx = Context::instance();
+            if (!ctx.experimental_repodata_parsing || n_subdirs == 0)
+            {
+                return nullptr;
+            }
+            MemoryBudget::instance().set_limit(ctx.memory_budget);
+
+            const auto n_threads = std::min(
+                clamp_worker_threads(ctx.threads_params.repodata_parse_threads),
+                std::max<std::size_t>(n_subdirs, 1)
+            );
+            LOG_INFO << "Reading repodata files with " << n_threads << " threads";
+            return std::make_unique<RepoDataRecordsReader>(n_subdirs, n_threads);
+        }
+
+        using maybe_shard_records = std::optional<RepoDataRecords>;
+
+        /**
+         * Fetch the records of the subdirs that publish sharded repodata.
+         *
+         * Subdirs without a shards index, or whose shards cannot be fetched, are left empty
+         * and load their full repodata instead.
+         */
+        auto fetch_shard_records(
+            const std::vector<MSubdirData>& subdirs,
+            const std::vector<std::string>& subdir_urls,
+            MultiPackageCache& package_caches,
+            const std::vector<std::string>& package_names
+        ) -> std::vector<maybe_shard_records>
+        {
+            auto out = std::vector<maybe_shard_records>(subdirs.size());
+            const auto cache_dir = package_caches.first_writable_path();
+            if (cache_dir.empty())
+            {
+                return out;
+            }
+            const auto shards_dir = cache_dir / "cache" / "shards";
+
+            auto index_files = std::vector<std::unique_ptr<TemporaryFile>>();
+            auto index_targets = std::vector<std::unique_ptr<DownloadTarget>>();
+            MultiDownloadTarget multi_dl;
+            try
+            {
+                fs::create_directories(shards_dir);
+                for (std::size_t i = 0; i < subdirs.size(); ++i)
+                {
+                    index_files.push_back(
+                        std::make_unique<TemporaryFile>("mambaf", ".json", shards_dir)
+                    );
+                    index_targets.push_back(std::make_unique<DownloadTarget>(
+                        subdirs[i].name() + " (shards)",
+                        join_url(subdir_urls[i], std::string(RepoDataShards::index_filename)),
+                        index_files.back()->path().string()
+                    ));
+                    index_targets.back()->set_ignore_failure(true);
+                    // Reported once the shards are fetched
+                    index_targets.back()->set_finalize_callback(
+                        [](const DownloadTarget&) { return true; }
+                    );
+                    multi_dl.add(index_targets.back().get());
+                }
+                multi_dl.download(MAMBA_NO_CLEAR_PROGRESS_BARS);
+            }
+            catch (const std::exception& e)
+            {
+                LOG_WARNING << "Could not fetch repodata shards indices: " << e.what();
+                return out;
+            }
+
+            for (std::size_t i = 0; i < subdirs.size(); ++i)
+            {
+                const auto& target = *index_targets[i];
+                // Note HTTP status == 0 for files
+                const int status = target.get_http_status();
+                if ((target.get_result() != 0) || ((status != 0) && (status != 200)))
+                {
+                    LOG_INFO << "No repodata shards for " << subdirs[i].name();
+                    continue;
+                }
+                auto records = expected_t<RepoDataRecords>();
+                if (auto shards = RepoDataShards::read(index_files[i]->path(), subdir_urls[i]))
+                {
+                    const auto& ctx = Context::instance();
+                    records = shards->fetch_records(
+                        package_names,
+                        shards_dir,
+                        ctx.use_only_tar_bz2,
+                        ctx.add_pip_as_python_dependency
+                    );
+                }
+                else
+                {
+                    records = forward_error(shards);
+                }
+                if (!records)
+                {
+                    LOG_WARNING << "Could not use repodata shards for " << subdirs[i].name()
+                                << ", loading the full repodata: " << records.error().what();
+                    continue;
+                }
+                Console::stream() << fmt::format(
+                    "{:<50} {:>20}",
+                    subdirs[i].name(),
+                    fmt::format("{} records", records->records.size())
+                );
+                out[i] = std::move(records).value();
+            }
+            return out;
+        }
+    }
+
+    RepodataRevalidation::RepodataRevalidation() = default;
+
+    RepodataRevalidation::~RepodataRevalidation()
+    {
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    void RepodataRevalidation::start(std::vector<MSubdirData> subdirs)
+    {
+        wait();
+        m_subdirs = std::move(subdirs);
+        m_changed = false;
+        if (m_subdirs.empty())
+        {
+            return;
+        }
+        LOG_INFO << "Revalidating " << m_subdirs.size() << " stale repodata caches";
+        m_thread = std::thread(
+            [this]()
+            {
+                auto multi_dl = MultiDownloadTarget();
+                for (auto& subdir : m_subdirs)
+                {
+                    multi_dl.add(subdir.revalidation_target());
+                }
+                try
+                {
+                    multi_dl.download(MAMBA_NO_PROGRESS_BARS);
+                }
+                catch (const std::exception& e)
+                {
+                    LOG_WARNING << "Could not revalidate repodata: " << e.what();
+                }
+                for (auto& subdir : m_subdirs)
+                {
+                    if (subdir.is_stale())
+                    {
+                        LOG_WARNING << "Could not revalidate the repodata of " << subdir.name()
+                                    << ", using the expired cache";
+                    }
+                    else if (subdir.target()->get_http_status() != 304)
+                    {
+                        LOG_INFO << "Repodata of " << subdir.name() << " changed";
+                        m_changed = true;
+                    }
+                }
             }
-            return MRepo(pool, prefix_data);
+        );
+    }
+
+    bool RepodataRevalidation::wait()
+    {
+        if (m_thread.joinable())
+        {
+            m_thread.join();
         }
+        return m_changed;
     }
 
-    expected_t<void, mamba_aggregated_error>
-    load_channels(MPool& pool, MultiPackageCache& package_caches, int is_retry)
+    expected_t<void, mamba_aggregated_error> load_channels(
+        MPool& pool,
+        MultiPackageCache& package_caches,
+        int is_retry,
+        const std::vector<std::string>& package_names,
+        const std::vector<std::string>& platforms,
+        RepodataRevalidation* revalidation
+    )
     {
         int RETRY_SUBDIR_FETCH = 1 << 0;
 
+        auto trace = Tracer::instance().scope("load_channels");
         auto& ctx = Context::instance();
 
         std::vector<std::string> channel_urls = ctx.channels;
 
         std::vector<MSubdirData> subdirs;
+        std::vector<std::string> subdir_urls;
         MultiDownloadTarget multi_dl;
 
         std::vector<std::pair<int, int>> priorities;
@@ -65,7 +452,19 @@ namespace mamba
 
         for (auto channel : pool.channel_context().get_channels(channel_urls))
         {
-            for (auto& [platform, url] : channel->platform_urls(true))
+            auto platform_urls = std::vector<std::pair<std::string, std::string>>();
+            if (platforms.empty())
+            {
+                platform_urls = channel->platform_urls(true);
+            }
+            else
+            {
+                for (const auto& platform : platforms)
+                {
+                    platform_urls.emplace_back(platform, channel->platform_url(platform, true));
+                }
+            }
+            for (auto& [platform, url] : platform_urls)
             {
                 auto sdires = MSubdirData::create(
                     pool.channel_context(),
@@ -82,6 +481,7 @@ namespace mamba
                 }
                 auto sdir = std::move(sdires).value();
                 subdirs.push_back(std::move(sdir));
+                subdir_urls.push_back(url);
                 if (ctx.channel_priority == ChannelPriority::kDisabled)
                 {
                     priorities.push_back(std::make_pair(0, 0));
@@ -99,15 +499,34 @@ namespace mamba
             }
         }
 
-        for (auto& subdir : subdirs)
+        auto shard_records = std::vector<maybe_shard_records>(subdirs.size());
+        if (ctx.repodata_use_shards && !package_names.empty() && !ctx.offline)
+        {
+            auto shards_trace = Tracer::instance().scope("fetch_shards");
+            shard_records = fetch_shard_records(
+                subdirs,
+                subdir_urls,
+                package_caches,
+                package_names
+            );
+        }
+
         {
-            for (auto& check_target : subdir.check_targets())
+            auto check_trace = Tracer::instance().scope("check_subdirs");
+            for (std::size_t i = 0; i < subdirs.size(); ++i)
             {
-                multi_dl.add(check_target.get());
+                if (shard_records[i].has_value())
+                {
+                    continue;
+                }
+                for (auto& check_target : subdirs[i].check_targets())
+                {
+                    multi_dl.add(check_target.get());
+                }
             }
-        }
 
-        multi_dl.download(MAMBA_NO_CLEAR_PROGRESS_BARS);
+            multi_dl.download(MAMBA_NO_CLEAR_PROGRESS_BARS);
+        }
         if (is_sig_interrupted())
         {
             error_list.push_back(mamba_error("Interrupted by user", mamba_error_code::user_interrupted)
@@ -115,19 +534,58 @@ namespace mamba
             return tl::unexpected(mamba_aggregated_error(std::move(error_list)));
         }
 
-        for (auto& subdir : subdirs)
+        // Subsets are computed from the full repodata of all the subdirs
+        const bool use_subsets = ctx.repodata_subset_cache && !package_names.empty()
+                                 && !(ctx.experimental && ctx.verify_artifacts)
+                                 && std::none_of(
+                                     shard_records.cbegin(),
+                                     shard_records.cend(),
+                                     [](const auto& records) { return records.has_value(); }
+                                 );
+        auto records_reader = use_subsets ? nullptr : make_repodata_records_reader(subdirs.size());
+        for (std::size_t i = 0; i < subdirs.size(); ++i)
         {
+            auto& subdir = subdirs[i];
+            if (shard_records[i].has_value())
+            {
+                continue;
+            }
             if (!subdir.check_targets().empty())
             {
-                // recreate final download target in case HEAD requests succeeded
+                // create the final download target once the jlap check is done
                 subdir.finalize_checks();
             }
+            if (revalidation == nullptr)
+            {
+                // Refreshed now, as when not using stale caches
+                subdir.revalidation_target(/* with_progress_bar= */ true);
+            }
+            if (records_reader)
+            {
+                // Subdirs using a valid cache can be read while the others download
+                records_reader->submit(i, subdir);
+                if (auto* target = subdir.target())
+                {
+                    target->set_finalize_callback(
+                        [&subdir, &reader = *records_reader, i](const DownloadTarget& t)
+                        {
+                            const bool ok = subdir.finalize_transfer(t);
+                            if (ok)
+                            {
+                                reader.submit(i, subdir);
+                            }
+                            return ok;
+                        }
+                    );
+                }
+            }
             multi_dl.add(subdir.target());
         }
 
         // TODO load local channels even when offline if (!ctx.offline)
         if (!ctx.offline)
         {
+            auto download_trace = Tracer::instance().scope("download_repodata");
             try
             {
                 multi_dl.download(MAMBA_DOWNLOAD_FAILFAST);
@@ -146,11 +604,61 @@ namespace mamba
                 create_repo_from_pkgs_dir(pool, c);
             }
         }
+
+        auto subsets = std::optional<RepoDataSubsets>();
+        auto subset_repos = std::optional<std::vector<MRepo>>();
+        auto full_repos = std::vector<MRepo>();
+        if (use_subsets
+            && std::all_of(subdirs.cbegin(), subdirs.cend(), [](const auto& s) { return s.loaded(); }))
+        {
+            auto subset_trace = Tracer::instance().scope("load_repodata_subsets");
+            auto subset_subdirs = std::vector<std::pair<std::string, RepoMetadata>>();
+            subset_subdirs.reserve(subdirs.size());
+            for (const auto& subdir : subdirs)
+            {
+                subset_subdirs.emplace_back(subdir.name(), subdir.repo_metadata());
+            }
+            subsets.emplace(
+                package_caches.first_writable_path() / "cache" / "subsets",
+                package_names,
+                std::move(subset_subdirs)
+            );
+            subset_repos = subsets->load(pool);
+        }
+
         std::string prev_channel;
         bool loading_failed = false;
         for (std::size_t i = 0; i < subdirs.size(); ++i)
         {
+            if (is_sig_interrupted())
+            {
+                error_list.push_back(
+                    mamba_error("Interrupted by user", mamba_error_code::user_interrupted)
+                );
+                return tl::unexpected(mamba_aggregated_error(std::move(error_list)));
+            }
             auto& subdir = subdirs[i];
+            auto repo_trace = Tracer::instance().scope("load_repo " + subdir.name());
+            if (shard_records[i].has_value())
+            {
+                // The records depend on the requested names, they are not identified by the
+                // etag of the full repodata
+                auto repo = MRepo(
+                    pool,
+                    subdir.name(),
+                    std::move(shard_records[i]).value(),
+                    RepoMetadata{ subdir_urls[i], {}, {}, ctx.add_pip_as_python_dependency }
+                );
+                auto& prio = priorities[i];
+                repo.set_priority(prio.first, prio.second);
+                continue;
+            }
+            if (subset_repos.has_value())
+            {
+                auto& prio = priorities[i];
+                (*subset_repos)[i].set_priority(prio.first, prio.second);
+                continue;
+            }
             if (!subdir.loaded())
             {
                 if (!ctx.offline && ends_with(subdir.name(), "/noarch"))
@@ -163,11 +671,39 @@ namespace mamba
                 continue;
             }
 
-            auto repo = subdir.create_repo(pool);
+            if (ctx.experimental && ctx.verify_artifacts)
+            {
+                try
+                {
+                    subdir.verify_index(package_caches);
+                }
+                catch (const std::exception& e)
+                {
+                    error_list.push_back(mamba_error(
+                        fmt::format(
+                            "Could not verify the signatures of {}: {}",
+                            subdir.name(),
+                            e.what()
+                        ),
+                        mamba_error_code::repodata_not_loaded
+                    ));
+                    continue;
+                }
+            }
+
+            auto records = records_reader ? records_reader->wait(i) : maybe_records();
+            auto repo = !records.has_value() ? subdir.create_repo(pool)
+                        : records->has_value()
+                            ? subdir.create_repo(pool, std::move(records).value().value())
+                            : expected_t<MRepo>(forward_error(records.value()));
             if (repo)
             {
                 auto& prio = priorities[i];
                 repo.value().set_priority(prio.first, prio.second);
+                if (subsets.has_value())
+                {
+                    full_repos.push_back(std::move(repo).value());
+                }
             }
             else
             {
@@ -188,18 +724,52 @@ namespace mamba
             }
         }
 
+        if (!loading_failed)
+        {
+            // Before the full repos are pruned to the subsets
+            update_completion_index(&pool);
+        }
+
         if (loading_failed)
         {
             if (!ctx.offline && !(is_retry & RETRY_SUBDIR_FETCH))
             {
                 LOG_WARNING << "Encountered malformed repodata.json cache. Redownloading.";
-                return load_channels(pool, package_caches, is_retry | RETRY_SUBDIR_FETCH);
+                return load_channels(
+                    pool,
+                    package_caches,
+                    is_retry | RETRY_SUBDIR_FETCH,
+                    package_names,
+                    platforms,
+                    revalidation
+                );
             }
             error_list.push_back(mamba_error(
                 "Could not load repodata. Cache corrupted?",
                 mamba_error_code::repodata_not_loaded
             ));
         }
+        else if (subsets.has_value() && !subset_repos.has_value() && error_list.empty())
+        {
+            // The full repos are pruned as well, which the solve does not notice
+            auto subset_trace = Tracer::instance().scope("store_repodata_subsets");
+            subsets->store(pool, full_repos);
+        }
+        trace.add_counter("subdirs", subdirs.size());
+
+        if (revalidation != nullptr)
+        {
+            auto stale = std::vector<MSubdirData>();
+            for (std::size_t i = 0; i < subdirs.size(); ++i)
+            {
+                if (!shard_records[i].has_value() && subdirs[i].is_stale())
+                {
+                    stale.push_back(std::move(subdirs[i]));
+                }
+            }
+            revalidation->start(std::move(stale));
+        }
+
         using return_type = expected_t<void, mamba_aggregated_error>;
         return error_list.empty() ? return_type()
                                   : return_type(make_unexpected(std::move(error_list)));
@@ -9,12 +9,18 @@
 #include "mamba/api/clean.hpp"
 #include "mamba/api/configuration.hpp"
 #include "mamba/core/context.hpp"
+#include "mamba/core/environments_manager.hpp"
+#include "mamba/core/fetch.hpp"
 #include "mamba/core/mamba_fs.hpp"
 #include "mamba/core/package_cache.hpp"
 #include "mamba/core/util.hpp"
 #include "mamba/core/util_string.hpp"
 
+#include "../core/package_cache_eviction.hpp"
+#include "../core/package_cache_usage.hpp"
+#include "../core/package_store.hpp"
 #include "../core/progress_bar_impl.hpp"
+#include "../core/relocation_cache.hpp"
 
 namespace mamba
 {
@@ -32,9 +38,10 @@ namespace mamba
         bool clean_locks = options & MAMBA_CLEAN_LOCKS;
         bool clean_trash = options & MAMBA_CLEAN_TRASH;
         bool clean_force_pkgs_dirs = options & MAMBA_CLEAN_FORCE_PKGS_DIRS;
+        bool clean_lru = options & MAMBA_CLEAN_LRU;
 
         if (!(clean_all || clean_index || clean_pkgs || clean_tarballs || clean_locks || clean_trash
-              || clean_force_pkgs_dirs))
+              || clean_force_pkgs_dirs || clean_lru))
         {
             Console::stream() << "Nothing to do." << std::endl;
             return;
@@ -121,16 +128,11 @@ namespace mamba
             envs.push_back(ctx.prefix_params.root_prefix);
         }
 
-        if (fs::exists(ctx.prefix_params.root_prefix / "envs"))
+        for (auto& p :
+             EnvironmentsManager().list_envs_dir_prefixes(ctx.prefix_params.root_prefix / "envs"))
         {
-            for (auto& p : fs::directory_iterator(ctx.prefix_params.root_prefix / "envs"))
-            {
-                if (p.is_directory() && fs::exists(p.path() / "conda-meta"))
-                {
-                    LOG_DEBUG << "Found environment: " << p.path();
-                    envs.push_back(p);
-                }
-            }
+            LOG_DEBUG << "Found environment: " << p;
+            envs.push_back(p);
         }
 
         if (clean_trash)
@@ -139,19 +141,9 @@ namespace mamba
             clean_trash_files(ctx.prefix_params.root_prefix, true);
         }
 
-        // globally, collect installed packages
-        std::set<std::string> installed_pkgs;
-        for (auto& env : envs)
-        {
-            for (auto& pkg : fs::directory_iterator(env / "conda-meta"))
-            {
-                if (ends_with(pkg.path().string(), ".json"))
-                {
-                    std::string pkg_name = pkg.path().filename().string();
-                    installed_pkgs.insert(pkg_name.substr(0, pkg_name.size() - 5));
-                }
-            }
-        }
+        // globally, collect installed packages, only listing environments changed since the
+        // last transaction
+        const auto installed_pkgs = PackageCacheUsage(caches.first_writable_path()).usage(envs);
 
         auto get_file_size = [](const auto& s) -> std::string
         {
@@ -178,7 +170,9 @@ namespace mamba
                     std::string fname = p.path().filename().string();
                     if (!p.is_directory()
                         && (ends_with(p.path().string(), ".tar.bz2")
-                            || ends_with(p.path().string(), ".conda")))
+                            || ends_with(p.path().string(), ".conda")
+                            || ends_with(p.path().string(), DOWNLOAD_PARTIAL_EXTENSION)
+                            || ends_with(p.path().string(), DOWNLOAD_PARTIAL_EXTENSION ".json")))
                     {
                         res.push_back(p.path());
                         rows.push_back({ p.path().filename().string(), get_file_size(p.file_size()) });
@@ -221,6 +215,18 @@ namespace mamba
             }
         }
 
+        // Files shared by extracted packages are removed with the last package using them
+        auto prune_stores = [&]()
+        {
+            for (auto* pkg_cache : caches.writable_caches())
+            {
+                PackageStore(pkg_cache->path()).prune();
+                // Not indexed by package, relocated again when needed
+                std::error_code ec;
+                fs::remove_all(pkg_cache->path() / RELOCATION_CACHE_DIR, ec);
+            }
+        };
+
         auto get_folder_size = [](auto& p)
         {
             std::size_t size = 0;
@@ -300,6 +306,68 @@ namespace mamba
                         {
                             fs::remove_all(tbr);
                         }
+                        prune_stores();
+                    }
+                }
+            }
+        }
+
+        auto collect_lru_packages = [&]()
+        {
+            std::vector<fs::u8path> res;
+            std::size_t total_size = 0;
+            std::vector<printers::FormattedString> header = { "Package", "Size" };
+            mamba::printers::Table t(header);
+            t.set_alignment({ printers::alignment::left, printers::alignment::right });
+            t.set_padding({ 2, 4 });
+
+            for (auto* pkg_cache : caches.writable_caches())
+            {
+                std::vector<std::vector<printers::FormattedString>> rows;
+                for (auto& pkg : select_evicted_packages(
+                         list_cached_packages(pkg_cache->path()),
+                         ctx.pkgs_dirs_max_size,
+                         installed_pkgs
+                     ))
+                {
+                    res.insert(res.end(), pkg.paths.cbegin(), pkg.paths.cend());
+                    rows.push_back({ pkg.name, get_file_size(pkg.size) });
+                    total_size += pkg.size;
+                }
+                t.add_rows(pkg_cache->path().string(), rows);
+            }
+            if (total_size)
+            {
+                t.add_rows({}, { { "Total size: ", get_file_size(total_size) } });
+                t.print(std::cout);
+            }
+            return res;
+        };
+
+        if (clean_lru)
+        {
+            if (ctx.pkgs_dirs_max_size == 0)
+            {
+                LOG_WARNING << "No maximum size set for the package caches (pkgs_dirs_max_size)";
+            }
+            else
+            {
+                auto to_be_removed = collect_lru_packages();
+                if (!ctx.dry_run)
+                {
+                    Console::instance().print("Cleaning least recently used packages..");
+
+                    if (to_be_removed.size() == 0)
+                    {
+                        LOG_INFO << "Package caches are within their maximum size";
+                    }
+                    else if (Console::prompt("\nRemove least recently used packages", 'y'))
+                    {
+                        for (auto& tbr : to_be_removed)
+                        {
+                            fs::remove_all(tbr);
+                        }
+                        prune_stores();
                     }
                 }
             }
@@ -18,9 +18,12 @@
 #include "mamba/api/install.hpp"
 #include "mamba/core/environment.hpp"
 #include "mamba/core/fsutil.hpp"
+#include "mamba/core/memory_budget.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/package_download.hpp"
 
+#include "../core/rc_cache.hpp"
+
 namespace mamba
 {
     /************************
@@ -869,6 +872,14 @@ namespace mamba
             }
         }
 
+        void trusted_local_channels_hook(std::vector<fs::u8path>& dirs)
+        {
+            for (auto& d : dirs)
+            {
+                d = fs::weakly_canonical(env::expand_user(d)).string();
+            }
+        }
+
         void download_threads_hook(std::size_t& value)
         {
             if (!value)
@@ -884,6 +895,11 @@ namespace mamba
         {
             DownloadExtractSemaphore::set_max(Context::instance().threads_params.extract_threads);
         }
+
+        void memory_budget_hook()
+        {
+            MemoryBudget::instance().set_limit(Context::instance().memory_budget);
+        }
     }
 
     fs::u8path get_conda_root_prefix()
@@ -1132,6 +1148,32 @@ namespace mamba
                    .set_post_merge_hook(detail::pkgs_dirs_hook)
                    .description("Possible locations of packages caches"));
 
+        insert(Configurable("pkgs_dirs_max_size", &ctx.pkgs_dirs_max_size)
+                   .group("Basic")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Maximum size in bytes of the packages of each package cache")
+                   .long_description(unindent(R"(
+                        When set, 'clean' removes the least recently used packages, tarballs
+                        and extracted directories, that are not installed in any known
+                        environment, until the packages of each writable package cache use less
+                        than this number of bytes. Default is 0 (no limit).)")));
+
+        insert(Configurable("memory_budget", &ctx.memory_budget)
+                   .group("Basic")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .set_post_context_hook(detail::memory_budget_hook)
+                   .description("Maximum memory in bytes used by concurrent loading and extraction")
+                   .long_description(unindent(R"(
+                        When set, packages are extracted concurrently only while the memory
+                        they are estimated to need fits in this number of bytes, and the
+                        repodata files that do not fit are read one at a time instead of in
+                        parallel. Streaming extraction while downloading is skipped for the
+                        packages that do not fit. This is not a hard limit of the memory of
+                        the process, whose peak is reported in the json output. Default is 0
+                        (no limit).)")));
+
         insert(Configurable("platform", &ctx.platform)
                    .group("Basic")
                    .set_rc_configurable()
@@ -1226,6 +1268,32 @@ namespace mamba
                        "A dictionary with name: list of names/urls to use for custom multichannels."
                    ));
 
+        insert(Configurable("channel_mirrors", &ctx.channel_mirrors)
+                   .group("Channels")
+                   .set_rc_configurable()
+                   .description("Mirrors of channels")
+                   .long_description(unindent(R"(
+                        A dictionary with channel url: list of urls of its mirrors.
+                        Files of the channel are downloaded from the fastest of the
+                        channel and its mirrors, as measured while downloading, spreading
+                        downloads across them, and from another one when a download fails.)")));
+
+        insert(Configurable("package_cache_peers", &ctx.package_cache_peers)
+                   .group("Channels")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Servers of package caches to download packages from")
+                   .long_description(unindent(R"(
+                        Urls of micromamba servers sharing their package caches, such as
+                        one per rack. Each package is requested from one of them, picked
+                        by its filename, which downloads it from the channel if it does not
+                        have it yet, so that a package is downloaded once from the channel
+                        for all the machines using the peer. Peers only download from their
+                        own channel alias and channels, and check the packages against the
+                        repodata of the channel before serving them. The channel is used
+                        directly if the peer fails or sends a package that does not match
+                        its checksum. Urls with credentials are not sent to the peers.)")));
+
         insert(Configurable("override_channels_enabled", &ctx.override_channels_enabled)
                    .group("Channels")
                    .set_rc_configurable()
@@ -1237,6 +1305,251 @@ namespace mamba
                    .set_rc_configurable()
                    .description("Channels that have zstd encoded repodata (saves a HEAD request)"));
 
+        insert(Configurable("experimental_repodata_parsing", &ctx.experimental_repodata_parsing)
+                   .group("Repodata")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Stream repodata.json records directly into the solver pool")
+                   .long_description(unindent(R"(
+                        Parse repodata.json incrementally, adding each package record to
+                        the solver pool as soon as it is read rather than loading the
+                        whole index through libsolv. This bounds memory usage to a single
+                        record for very large channels.)")));
+
+        insert(Configurable("repodata_parse_threads", &ctx.threads_params.repodata_parse_threads)
+                   .group("Repodata")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Defines the number of threads for parsing repodata files")
+                   .long_description(unindent(R"(
+                        Defines the number of threads used to parse the repodata.json of
+                        multiple channel subdirectories concurrently when
+                        'experimental_repodata_parsing' is enabled.
+                        Positive number gives the number of threads, negative number gives
+                        host max concurrency minus the value, zero (default) is the host max
+                        concurrency value.)")));
+
+        insert(Configurable("extract_streaming", &ctx.extract_streaming)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Extract .conda packages while downloading them")
+                   .long_description(unindent(R"(
+                        Extract .conda packages from the downloaded bytes as they arrive,
+                        and hash them in the same pass, instead of reading the tarball again
+                        once downloaded. The tarball is still written to the package cache.
+                        Extraction falls back to the tarball if streaming fails.)")));
+
+        insert(Configurable("extract_dedup", &ctx.extract_dedup)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Share identical files between extracted packages")
+                   .long_description(unindent(R"(
+                        Store the files of extracted packages by content in the package cache,
+                        and hardlink identical files, such as license texts or headers, from
+                        the store, so that they use the disk and the page cache once. Hardlinks
+                        to environments share them too. As with hardlinked packages, modifying
+                        a hardlinked file in an environment modifies it for all the packages
+                        sharing it.)")));
+
+        insert(Configurable("link_while_downloading", &ctx.link_while_downloading)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Link packages while the next ones are downloaded")
+                   .long_description(unindent(R"(
+                        Link each package of a transaction as soon as it is extracted and the
+                        packages before it are linked, instead of once all the packages are
+                        downloaded and extracted. Packages are downloaded in the order they
+                        are linked in, and linked one after the other, as the files they
+                        overwrite are only known once extracted. If a package fails to
+                        download or extract, the packages already linked are unlinked.)")));
+
+        insert(Configurable("prefetch_while_solving", &ctx.prefetch_while_solving)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Download the requested packages while solving")
+                   .long_description(unindent(R"(
+                        Start downloading the latest builds of the requested packages, allowed
+                        by the pins, while the solver runs. The packages that the solution
+                        installs are then found in the package cache, and the others are
+                        discarded. Only the packages missing from the caches and the prefix
+                        are downloaded.)")));
+
+        insert(Configurable("pip_while_linking", &ctx.pip_while_linking)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Install the pip dependencies while the transaction is linked")
+                   .long_description(unindent(R"(
+                        Start installing the pip dependencies of an environment file as soon
+                        as python, pip and their dependencies are linked in the prefix,
+                        instead of once the whole transaction is done, so that pip resolves
+                        and downloads while the other packages are linked and compiled.
+                        Pip does not see the conda packages that are not linked yet, and may
+                        install a package that one of them would have provided.)")));
+
+        insert(Configurable("container_build", &ctx.container_build)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Keep nothing in the package caches, such as in container builds")
+                   .long_description(unindent(R"(
+                        Remove the tarballs downloaded and the packages extracted by a
+                        transaction once they are linked, instead of keeping them in the
+                        package cache for later transactions, such as when an environment is
+                        created in a container image and the cache would be cleaned anyway.
+                        .conda packages are extracted while downloading, extracted packages
+                        are not deduplicated, and compiled pyc files are not cached. Packages
+                        that were already in the caches are left there, so that a cache shared
+                        between builds keeps working. Files excluded by 'exclude_files' are
+                        neither extracted, linked, nor compiled.)")));
+
+        insert(Configurable("exclude_files", &ctx.exclude_files)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Glob patterns of package files to neither extract nor link")
+                   .long_description(unindent(R"(
+                        Glob patterns of package files, relative to the package root as in
+                        its paths.json, that are neither extracted to the package cache nor
+                        linked to environments, such as 'include/**' or '**/*.a'. '*' does
+                        not match '/' while '**' does. The skipped files are recorded in the
+                        'excluded_files' of the package records in conda-meta. Package caches
+                        extracted without files needed by other patterns are extracted again.)")));
+
+        insert(Configurable("background_solv_write", &ctx.background_solv_write)
+                   .group("Repodata")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Write the repodata solv cache in the background")
+                   .long_description(unindent(R"(
+                        After loading a repodata.json, write the corresponding solv cache
+                        file from a background task instead of blocking the current command.
+                        The file is written aside and moved into place once complete, so
+                        that other processes only ever see a full cache file. Concurrent
+                        processes missing the same cache file then each parse the json
+                        rather than waiting for the first one to write it.)")));
+
+        insert(Configurable("repodata_use_jlap", &ctx.repodata_use_jlap)
+                   .group("Repodata")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Update expired repodata caches using repodata.jlap patches")
+                   .long_description(unindent(R"(
+                        When a cached repodata.json has expired, fetch only the new part of
+                        the channel repodata.jlap JSON patch log and apply it to the cache,
+                        instead of downloading the full repodata again.
+                        If the patches cannot be verified or applied, the full repodata is
+                        downloaded as usual.)")));
+
+        insert(Configurable("repodata_use_shards", &ctx.repodata_use_shards)
+                   .group("Repodata")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Only fetch the repodata shards needed by an install")
+                   .long_description(unindent(R"(
+                        For channels publishing a repodata_shards.json index, only fetch the
+                        records of the requested packages, of the installed packages, and of
+                        their dependencies, instead of the full repodata.json.
+                        Shards are named after their hash and cached in the package cache.
+                        Channels without shards load their full repodata as usual.)")));
+
+        insert(Configurable("repodata_use_index", &ctx.repodata_use_index)
+                   .group("Repodata")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Fetch the binary repodata index instead of the json")
+                   .long_description(unindent(R"(
+                        For channels publishing a repodata_index.bin next to their
+                        repodata.json, such as written by 'micromamba index', fetch and cache
+                        that binary index instead, and read its records without parsing JSON.
+                        Channels without an index load their repodata.json as usual.
+                        Not used when verifying artifacts, the signatures being checked on
+                        the json.)")));
+
+        insert(Configurable("repodata_subset_cache", &ctx.repodata_subset_cache)
+                   .group("Repodata")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Cache the repodata needed by each set of requested packages")
+                   .long_description(unindent(R"(
+                        Store the packages reachable from the requested packages, and from the
+                        installed ones, in a solv cache of their own, and load only these the
+                        next time the same packages are requested.
+                        A subset is used as long as the repodata of all the channels is the
+                        same, and is stored in the package cache.
+                        Not used with repodata_use_shards channels, nor when verifying
+                        artifacts.)")));
+
+        insert(Configurable("repodata_stale_while_revalidate", &ctx.repodata_stale_while_revalidate)
+                   .group("Repodata")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Solve with expired repodata while it is refreshed")
+                   .long_description(unindent(R"(
+                        Use the expired repodata caches right away instead of waiting for
+                        the server, and check them for updates in the background while solving.
+                        Only if some repodata actually changed, the environment is solved
+                        again with the refreshed repodata before anything is installed.)")));
+
+        insert(Configurable("repodata_shared_cache", &ctx.repodata_shared_cache)
+                   .group("Repodata")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Fetch repodata once for the processes sharing a cache")
+                   .long_description(unindent(R"(
+                        For package caches shared by many users, such as on HPC login nodes.
+                        A single process fetches the outdated repodata of a channel while the
+                        others wait for it, then use the refreshed cache instead of fetching
+                        it again.)")));
+
+        insert(Configurable("repodata_exclude", &ctx.repodata_exclude)
+                   .group("Repodata")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Package records to leave out of the repodata indexes")
+                   .long_description(unindent(R"(
+                        Match specs, such as "foo" or "bar <2.0", of the channel packages
+                        that can never be installed.
+                        Matching records are dropped when loading the repodata, before
+                        solving, which reduces the time and memory used by the solver.
+                        The repodata caches keep all records.)")));
+
+        insert(Configurable("repodata_as_of", &ctx.repodata_as_of)
+                   .group("Repodata")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Only use the channel packages built before this date")
+                   .long_description(unindent(R"(
+                        An ISO 8601 timestamp such as "2023-06-01T00:00:00Z".
+                        Records with a later timestamp are dropped when loading the repodata,
+                        so that an environment is solved again as it would have been at that
+                        date. Records without a timestamp are kept.
+                        The records of each channel as of that date are cached aside the
+                        repodata, so that solving again at the same date does not load and
+                        filter the full repodata.)")));
+
+        insert(Configurable("repodata_exclude_licenses", &ctx.repodata_exclude_licenses)
+                   .group("Repodata")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Licenses of the channel packages to leave out")
+                   .long_description(unindent(R"(
+                        Records whose license is exactly one of these are dropped when loading
+                        the repodata.)")));
+
+        insert(Configurable("repodata_exclude_track_features", &ctx.repodata_exclude_track_features)
+                   .group("Repodata")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Track features of the channel packages to leave out")
+                   .long_description(unindent(R"(
+                        Records tracking any of these features are dropped when loading the
+                        repodata.)")));
+
         // Network
         insert(Configurable("cacert_path", std::string(""))
                    .group("Network")
@@ -1259,7 +1572,8 @@ namespace mamba
                         For a value of 1, respect the HTTP Cache-Control max-age header.
                         Any other positive integer values is the number of seconds to
                         locally cache repodata before checking the remote server for
-                        an update.)")));
+                        an update.
+                        The same applies to the content trust metadata of channels.)")));
 
         insert(Configurable("offline", &ctx.offline)
                    .group("Network")
@@ -1322,6 +1636,66 @@ namespace mamba
                    .set_env_var_names()
                    .description("The maximum number of retries each HTTP connection should attempt."));
 
+        insert(Configurable("remote_use_http2", &ctx.remote_fetch_params.use_http2)
+                   .group("Network")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Use HTTP/2 for HTTPS connections when the server supports it")
+                   .long_description(unindent(R"(
+                        Use HTTP/2 for HTTPS connections when the server supports it.
+                        Parallel downloads from the same server are then multiplexed over a
+                        single connection instead of opening (and TLS handshaking) one
+                        connection per download.)")));
+
+        insert(Configurable("remote_max_host_connections", &ctx.remote_fetch_params.max_host_connections)
+                   .group("Network")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("The maximum number of simultaneous connections to a single host")
+                   .long_description(unindent(R"(
+                        The maximum number of simultaneous connections to a single host,
+                        0 for no limit other than 'download_threads'. Downloads in excess
+                        wait for a connection to be available.)")));
+
+        insert(Configurable("remote_download_chunks", &ctx.remote_fetch_params.download_chunks)
+                   .group("Network")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("The number of concurrent range requests of large downloads")
+                   .long_description(unindent(R"(
+                        The number of concurrent range requests each download larger than
+                        'remote_download_chunk_threshold' is split in, 1 to not split
+                        downloads. Splitting helps when a single connection to the server
+                        is slower than the network. Downloads from servers that do not
+                        support ranges fall back to a single request.)")));
+
+        insert(Configurable(
+                   "remote_download_chunk_threshold",
+                   &ctx.remote_fetch_params.download_chunk_threshold
+        )
+                   .group("Network")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("The size in bytes above which downloads are split in chunks")
+                   .long_description(unindent(R"(
+                        The expected size in bytes above which downloads are split in
+                        'remote_download_chunks' concurrent range requests.)")));
+
+        insert(Configurable(
+                   "remote_download_direct_write",
+                   &ctx.remote_fetch_params.download_direct_write
+        )
+                   .group("Network")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Write downloads with large buffers, preallocating the files")
+                   .long_description(unindent(R"(
+                        Write downloaded data to the files in large page aligned buffers
+                        rather than through a file stream, preallocate the space of the
+                        files from their expected size, and sync each file to the disk once
+                        downloaded. This reduces the overhead of many concurrent downloads
+                        on fast disks. Only used on Linux and macOS.)")));
+
 
         // Solver
         insert(Configurable("channel_priority", &ctx.channel_priority)
@@ -1400,6 +1774,22 @@ namespace mamba
                    .group("Solver")
                    .description("Package categories to consider when installing from a lock file"));
 
+        insert(Configurable("clone", std::string(""))
+                   .group("Extract, Link & Install")
+                   .description("Create the environment as a copy of this one, by name or path")
+                   .long_description(unindent(R"(
+                        Packages are linked from the cloned environment instead of being
+                        solved, downloaded and extracted, and their scripts are not run.)")));
+
+        insert(Configurable("batch_files", std::vector<std::string>({}))
+                   .group("Extract, Link & Install")
+                   .description("Create the environment of each of these yaml files")
+                   .long_description(unindent(R"(
+                        Each file names its environment, created in the first writable
+                        environments directory. The repodata is loaded once and the packages
+                        shared by the environments are downloaded and extracted once, so the
+                        files must use the same channels.)")));
+
         insert(Configurable("retry_clean_cache", false)
                    .group("Solver")
                    .set_env_var_names()
@@ -1418,6 +1808,87 @@ namespace mamba
                    .set_env_var_names()
                    .description("Allow downgrade when installing packages. Default is false."));
 
+        insert(Configurable("solver_cache", &ctx.solver_cache)
+                   .group("Solver")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Reuse the solution of identical solves")
+                   .long_description(unindent(R"(
+                        Store the decisions of the solver in the package cache, and reuse
+                        them when solving the same specs against the same repodata and
+                        installed packages again, instead of running the solver.
+                        Repodata is identified by its url, etag and last modified time.)")));
+
+        insert(Configurable("solver_minimal_change", &ctx.solver_minimal_change)
+                   .group("Solver")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Keep the installed packages unrelated to the requested specs")
+                   .long_description(unindent(R"(
+                        Lock the installed packages that the requested specs cannot
+                        depend on, transitively, nor are required by, so that adding a
+                        package to a large environment is solved quickly. The solve is
+                        run again without the locks if there is no solution with them.)")));
+
+        insert(Configurable("solver_portfolio", &ctx.solver_portfolio)
+                   .group("Solver")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Race solvers with different heuristics on the same request")
+                   .long_description(unindent(R"(
+                        Solve with the configured flags, and concurrently with the same flags
+                        and libsolv focusing on the best versions or on the installed
+                        packages, each on a copy of the package pool. Every solution honors
+                        the configuration, such as the channel priority. The answer of the
+                        configured flags is kept whenever it is found by the time another
+                        solution is, so that requests only slow to solve with its heuristics
+                        are not waited for. This uses more cores and memory, and bypasses the
+                        solver cache.)")));
+
+        insert(Configurable("virtual_packages_cache", &ctx.virtual_packages_cache)
+                   .group("Solver")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Reuse the detected CUDA and macOS versions until the next boot")
+                   .long_description(unindent(R"(
+                        Store the versions of the '__cuda' and '__osx' virtual packages in the
+                        user cache directory, and reuse them while the host has not been
+                        rebooted and the loaded NVIDIA driver is unchanged.
+                        The CONDA_OVERRIDE_* environment variables still take precedence.)")));
+
+        insert(Configurable("prune_pool", &ctx.prune_pool)
+                   .group("Solver")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Only index the packages that can be part of an install")
+                   .long_description(unindent(R"(
+                        Before solving an install, ignore the packages whose name cannot be
+                        reached from the requested specs and the installed packages through
+                        dependencies.
+                        This reduces the time and memory used for indexing and solving small
+                        installs against large channels.)")));
+
+        insert(Configurable("explain_problems_timeout", &ctx.explain_problems_timeout)
+                   .group("Solver")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Time budget of the conflict explanation in seconds, 0 for none")
+                   .long_description(unindent(R"(
+                        When a solve fails, the conflicts are explained with a tree of the
+                        packages involved, which can take long on very large conflicts.
+                        Past this budget, the problems reported by the solver are printed
+                        as is instead.)")));
+
+        insert(Configurable("explain_problems_max_nodes", &ctx.explain_problems_max_nodes)
+                   .group("Solver")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Size budget of the conflict explanation, 0 for none")
+                   .long_description(unindent(R"(
+                        Maximum number of packages and dependencies in the graph used to
+                        explain conflicts.
+                        Larger conflicts are reported with the problems of the solver as is.)")));
+
         // Extract, Link & Install
         insert(Configurable("download_threads", &ctx.threads_params.download_threads)
                    .group("Extract, Link & Install")
@@ -1429,6 +1900,18 @@ namespace mamba
                         Defines the number of threads for package download.
                         It has to be strictly positive.)")));
 
+        insert(Configurable("max_download_threads", &ctx.threads_params.max_download_threads)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Maximum number of concurrent downloads when adapting them")
+                   .long_description(unindent(R"(
+                        When larger than 'download_threads', the number of concurrent package
+                        downloads starts at 'download_threads' and adapts to the measured
+                        throughput: it grows up to this value while the throughput does, and
+                        backs off when downloads stall or the server answers with HTTP 429
+                        or 503. Zero (default) keeps 'download_threads' concurrent downloads.)")));
+
         insert(Configurable("extract_threads", &ctx.threads_params.extract_threads)
                    .group("Extract, Link & Install")
                    .set_rc_configurable()
@@ -1441,6 +1924,31 @@ namespace mamba
                         host max concurrency minus the value, zero (default) is the host max
                         concurrency value.)")));
 
+        insert(Configurable("link_threads", &ctx.threads_params.link_threads)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Defines the number of threads for linking the files of a package")
+                   .long_description(unindent(R"(
+                        Defines the number of threads for linking the files of a package.
+                        Positive number gives the number of threads, negative number gives
+                        host max concurrency minus the value, zero (default) is the host max
+                        concurrency value. Small packages are linked on fewer threads.)")));
+
+        insert(Configurable("script_threads", &ctx.threads_params.script_threads)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Defines the number of post-link scripts run at once")
+                   .long_description(unindent(R"(
+                        Defines the number of post-link scripts run at once, for packages
+                        linked concurrently without dependencies between them.
+                        Positive number gives the number of scripts, negative number gives
+                        host max concurrency minus the value, zero is the host max
+                        concurrency value. One (default) runs the scripts one at a time.
+                        Scripts writing messages to the prefix always run alone. The messages
+                        are printed at the end of the transaction, by package name.)")));
+
         insert(Configurable("allow_softlinks", &ctx.allow_softlinks)
                    .group("Extract, Link & Install")
                    .set_rc_configurable()
@@ -1477,6 +1985,30 @@ namespace mamba
                         !WARNING: Using this option can result in corruption of long-lived
                         environments due to broken links (deleted cache).)")));
 
+        insert(Configurable("allow_reflinks", &ctx.allow_reflinks)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Allow to clone files instead of copying them")
+                   .long_description(unindent(R"(
+                        Allow to clone files (reflinks, or copy-on-write) instead of copying
+                        them into a prefix, when the file system of the package cache supports
+                        it, such as Btrfs, XFS or APFS. Clones behave as copies but share their
+                        data until modified, which makes them as fast as hard-links.
+                        This applies when hard-links are not possible, with 'always_copy',
+                        and to files that cannot be linked.)")));
+
+        insert(Configurable("relocation_cache", &ctx.relocation_cache)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Keep the files relocated to a prefix in the package cache")
+                   .long_description(unindent(R"(
+                        Keep the package files whose prefix placeholder was replaced in the
+                        package cache, so that installing the same packages again at the same
+                        prefix links them instead of rewriting them. This pays off when
+                        environments are created again and again at the same paths.)")));
+
         insert(Configurable("shortcuts", &ctx.shortcuts)
                    .group("Extract, Link & Install")
                    .set_rc_configurable()
@@ -1512,6 +2044,41 @@ namespace mamba
                         Spend extra time validating package contents. It consists of running
                         cryptographic verifications on channels and packages metadata.)")));
 
+        insert(Configurable("verify_package_cache", &ctx.verify_package_cache)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Compute the checksums of all cached tarballs")
+                   .long_description(unindent(R"(
+                        The checksums of the tarballs in the package caches are recorded in a
+                        ledger, and are not computed again for tarballs whose size, modification
+                        time, and inode did not change since. This forces computing them for
+                        every tarball.)")));
+
+        insert(Configurable("trusted_local_channels", &ctx.trusted_local_channels)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .set_post_merge_hook(detail::trusted_local_channels_hook)
+                   .description("Local channel directories whose packages are not hashed")
+                   .long_description(unindent(R"(
+                        Packages of 'file://' channels are extracted in place, without being
+                        copied to the package cache, but their checksums are computed.
+                        Packages under these directories, such as a build output channel,
+                        are only checked for their size and for not being newer than the
+                        repodata.json of their subdir, and are recorded as such in the ledger
+                        of the package cache.)")));
+
+        insert(Configurable("verify_index_cache", &ctx.verify_index_cache)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Verify the signatures of all cached repodata")
+                   .long_description(unindent(R"(
+                        With 'verify_artifacts', the signatures of the packages of a repodata
+                        are verified once, and not again while its etag and the trusted root
+                        version are the same. This forces verifying them on every load.)")));
+
         insert(Configurable("lock_timeout", &ctx.lock_timeout)
                    .group("Extract, Link & Install")
                    .set_rc_configurable()
@@ -1538,6 +2105,19 @@ namespace mamba
                    .set_env_var_names()
                    .description("Defines if PYC files will be compiled or not"));
 
+        insert(Configurable("compile_pyc_threads", &ctx.threads_params.compile_pyc_threads)
+                   .group("Extract, Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Defines the number of processes compiling PYC files")
+                   .long_description(unindent(R"(
+                        Defines the maximum number of Python processes compiling PYC files,
+                        among which the files are sharded. They are started as the number of
+                        files to compile grows.
+                        Positive number gives the number of processes, negative number gives
+                        host max concurrency minus the value, zero (default) is the host max
+                        concurrency value.)")));
+
         // Output, Prompt and Flow
         insert(Configurable("always_yes", &ctx.always_yes)
                    .group("Output, Prompt and Flow Control")
@@ -1588,6 +2168,17 @@ namespace mamba
                             Set the log backtrace size. It will replay the n last
                             logs if an error is thrown during the execution.)")));
 
+        insert(Configurable("log_async", &ctx.output_params.log_async)
+                   .group("Output, Prompt and Flow Control")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Write the logs from a background thread")
+                   .long_description(unindent(R"(
+                            Format and write the logs from a background thread, through a
+                            bounded queue, rather than from the thread emitting them. This
+                            reduces the cost of verbose logging. Logs queued when the process
+                            is abruptly terminated may be lost.)")));
+
         insert(Configurable("log_pattern", &ctx.output_params.log_pattern)
                    .group("Output, Prompt and Flow Control")
                    .set_rc_configurable()
@@ -1596,6 +2187,47 @@ namespace mamba
                    .long_description(unindent(R"(
                             Set the log pattern.)")));
 
+        insert(Configurable("trace_file", &ctx.output_params.trace_file)
+                   .group("Output, Prompt and Flow Control")
+                   .set_env_var_names()
+                   .description("Write the timings of the solve to a Chrome trace file")
+                   .long_description(unindent(R"(
+                        Write the timings of loading repodata, indexing packages, and solving
+                        to a file in the Chrome trace event format, to be opened with
+                        chrome://tracing or https://ui.perfetto.dev.
+                        Timings are also reported in the json output.)")));
+
+        insert(Configurable("progress_events", &ctx.output_params.progress_events)
+                   .group("Output, Prompt and Flow Control")
+                   .set_env_var_names()
+                   .description("Report the progress as JSON lines to 'stderr' or a file")
+                   .long_description(unindent(R"(
+                        Report the progress of downloads and extractions as one JSON
+                        object per line, written to the standard error with 'stderr' or
+                        appended to the given file. Progress bars are disabled.)"))
+                   .set_post_merge_hook<std::string>(
+                       [&](std::string& value)
+                       {
+                           if (!value.empty())
+                           {
+                               Context::instance().graphics_params.no_progress_bars = true;
+                           }
+                       }
+                   ));
+
+        insert(Configurable(
+                   "progress_bar_max_refresh_rate",
+                   &ctx.graphics_params.progress_bar_max_refresh_rate
+        )
+                   .group("Output, Prompt and Flow Control")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Maximum number of times per second the progress bars are drawn")
+                   .long_description(unindent(R"(
+                        Maximum number of times per second the progress bars are drawn.
+                        Only the lines that changed are written again to the terminal, and
+                        lower rates send less output to slow terminals, such as over ssh.)")));
+
         insert(Configurable("json", &ctx.output_params.json)
                    .group("Output, Prompt and Flow Control")
                    .set_rc_configurable()
@@ -1631,6 +2263,38 @@ namespace mamba
                         active environment is a named environment ('-n' flag), or otherwise holds the value
                         of '{prefix}'.)")));
 
+        insert(Configurable("activation_cache", &ctx.activation_cache)
+                   .group("Output, Prompt and Flow Control")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Reuse the activation variables and scripts of unchanged prefixes")
+                   .long_description(unindent(R"(
+                        Store the environment variables and the activation and deactivation
+                        scripts of a prefix in the user cache directory, and reuse them while
+                        its state file and 'etc/conda' directories are unchanged.)")));
+
+        insert(Configurable("run_without_shell", &ctx.run_without_shell)
+                   .group("Output, Prompt and Flow Control")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Start the command of 'run' directly when possible")
+                   .long_description(unindent(R"(
+                        When the environment has no activation scripts, compute its activated
+                        environment variables in process and start the command of 'run' without
+                        an intermediate shell script. Otherwise, or if disabled, the command is
+                        run from a shell script that activates the environment.)")));
+
+        insert(Configurable("static_shell_hook", &ctx.static_shell_hook)
+                   .group("Output, Prompt and Flow Control")
+                   .set_rc_configurable()
+                   .set_env_var_names()
+                   .description("Initialize bash and zsh with a hook that does not run micromamba")
+                   .long_description(unindent(R"(
+                        With 'shell init', write the shell hook in the root prefix and source
+                        it from the rc file, rather than running 'micromamba shell hook' on
+                        each shell startup. The hook is updated by 'shell init' or 'shell reinit',
+                        so that changes of 'shell_completion' or 'auto_activate_base' apply.)")));
+
         insert(Configurable("print_config_only", false)
                    .group("Output, Prompt and Flow Control")
                    .needs({ "debug" })
@@ -1697,7 +2361,7 @@ namespace mamba
         insert(Configurable("rc_files", std::vector<fs::u8path>({}))
                    .group("Config sources")
                    .set_env_var_names({ "MAMBARC", "CONDARC" })
-                   .needs({ "no_rc" })
+                   .needs({ "no_rc", "rc_cache" })
                    .set_post_merge_hook(detail::rc_files_hook)
                    .description("Paths to the configuration files to use"));
 
@@ -1715,6 +2379,15 @@ namespace mamba
                    .group("Config sources")
                    .set_env_var_names()
                    .description("Disable the use of environment variables"));
+
+        insert(Configurable("rc_cache", &ctx.src_params.rc_cache)
+                   .group("Config sources")
+                   .set_env_var_names()
+                   .description("Reuse the parsed configuration files while they are unchanged")
+                   .long_description(unindent(R"(
+                        Store the parsed configuration files in the user cache directory,
+                        and reuse them while the files and the environment variables they
+                        expand are unchanged, instead of parsing them on each run.)")));
     }
 
     Configuration::~Configuration() = default;
@@ -1813,6 +2486,50 @@ namespace mamba
     }
 
     void Configuration::load()
+    {
+        load_configurables(m_config_order);
+    }
+
+    void Configuration::load(std::vector<std::string> names)
+    {
+        for (const auto& name : names)
+        {
+            at(name);  // Fails early on unknown configurables
+        }
+
+        // Used by the loading itself, rc files being loaded with the root prefix
+        for (const auto& name : { "no_env",
+                                  "no_rc",
+                                  "root_prefix",
+                                  "print_config_only",
+                                  "print_context_only",
+                                  "json",
+                                  "quiet",
+                                  "log_level",
+                                  "log_backtrace",
+                                  "log_async",
+                                  "log_pattern",
+                                  "use_lockfiles" })
+        {
+            names.push_back(name);
+        }
+
+        // Keep the declaration order, in which rc configurables come after the rc files
+        const auto position = [this](const std::string& name)
+        {
+            const auto it = std::find(m_config_order.begin(), m_config_order.end(), name);
+            return it - m_config_order.begin();
+        };
+        std::stable_sort(
+            names.begin(),
+            names.end(),
+            [&](const std::string& lhs, const std::string& rhs)
+            { return position(lhs) < position(rhs); }
+        );
+        load_configurables(names);
+    }
+
+    void Configuration::load_configurables(const std::vector<std::string>& names)
     {
         spdlog::set_level(spdlog::level::n_levels);
         spdlog::flush_on(spdlog::level::n_levels);
@@ -1826,7 +2543,7 @@ namespace mamba
         clear_rc_sources();
         clear_rc_values();
 
-        compute_loading_sequence();
+        compute_loading_sequence(names);
         reset_compute_counters();
 
         m_load_lock = true;
@@ -1838,7 +2555,7 @@ namespace mamba
 
         allow_file_locking(Context::instance().use_lockfiles);
 
-        LOG_DEBUG << m_config.size() << " configurables computed";
+        LOG_DEBUG << m_loading_sequence.size() << " configurables computed";
 
         if (this->at("print_config_only").value<bool>())
         {
@@ -1855,6 +2572,10 @@ namespace mamba
         spdlog::flush_on(spdlog::level::off);
 
         Context::instance().dump_backtrace_no_guards();
+        if (ctx.output_params.log_async)
+        {
+            ctx.enable_async_logging();
+        }
         if (ctx.output_params.log_backtrace > 0)
         {
             spdlog::enable_backtrace(ctx.output_params.log_backtrace);
@@ -1870,12 +2591,12 @@ namespace mamba
         return m_load_lock;
     }
 
-    void Configuration::compute_loading_sequence()
+    void Configuration::compute_loading_sequence(const std::vector<std::string>& names)
     {
         m_loading_sequence.clear();
 
         std::vector<std::string> locks;
-        for (auto& c : m_config_order)
+        for (auto& c : names)
         {
             add_to_loading_sequence(m_loading_sequence, c, locks);
         }
@@ -2054,11 +2775,50 @@ namespace mamba
         m_sources = get_existing_rc_sources(possible_rc_paths);
         m_valid_sources.clear();
 
-        for (const auto& s : m_sources)
+        const bool parsed = std::all_of(
+            m_sources.begin(),
+            m_sources.end(),
+            [this](const fs::u8path& s) { return m_rc_yaml_nodes_cache.count(s) > 0; }
+        );
+        auto nodes = std::vector<YAML::Node>(m_sources.size());
+        if (!parsed && Context::instance().src_params.rc_cache)
+        {
+            const auto cache = RCFileCache(RCFileCache::default_path());
+            if (auto cached = cache.load(m_sources); cached.has_value())
+            {
+                nodes = std::move(cached).value();
+            }
+            else
+            {
+                // Described before being parsed, so that a concurrent change invalidates them
+                auto cache_sources = std::vector<RCFileCache::Source>();
+                for (const auto& s : m_sources)
+                {
+                    if (auto source = RCFileCache::Source::from_file(s); source.has_value())
+                    {
+                        cache_sources.push_back(std::move(source).value());
+                    }
+                }
+                for (std::size_t i = 0; i < m_sources.size(); ++i)
+                {
+                    auto it = m_rc_yaml_nodes_cache.find(m_sources[i]);
+                    nodes[i] = (it != m_rc_yaml_nodes_cache.end()) ? it->second
+                                                                  : load_rc_file(m_sources[i]);
+                }
+                if (cache_sources.size() == m_sources.size())
+                {
+                    cache.store(cache_sources, nodes);
+                }
+            }
+        }
+
+        for (std::size_t i = 0; i < m_sources.size(); ++i)
         {
+            const auto& s = m_sources[i];
             if (!m_rc_yaml_nodes_cache.count(s))
             {
-                auto node = load_rc_file(s);
+                // Invalid files are parsed again to report their errors
+                auto node = nodes[i].IsNull() ? load_rc_file(s) : nodes[i];
                 if (node.IsNull())
                 {
                     continue;
@@ -4,64 +4,194 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <set>
+#include <thread>
+#include <utility>
+
+#include "mamba/api/channel_loader.hpp"
 #include "mamba/api/configuration.hpp"
 #include "mamba/api/create.hpp"
 #include "mamba/api/install.hpp"
 #include "mamba/core/channel.hpp"
 #include "mamba/core/context.hpp"
+#include "mamba/core/environment.hpp"
+#include "mamba/core/fsutil.hpp"
+#include "mamba/core/link.hpp"
+#include "mamba/core/match_spec.hpp"
+#include "mamba/core/output.hpp"
+#include "mamba/core/package_cache.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/prefix_data.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/solver.hpp"
+#include "mamba/core/transaction.hpp"
 #include "mamba/core/util.hpp"
+#include "mamba/core/util_scope.hpp"
+#include "mamba/core/virtual_packages.hpp"
 
+#include "../core/parallel.hpp"
 
 namespace mamba
 {
+    namespace
+    {
+        /** Make room for a new environment at @p prefix, asking before removing one. */
+        void check_target_prefix(const fs::u8path& prefix)
+        {
+            const auto& ctx = Context::instance();
+            if (!fs::exists(prefix))
+            {
+                return;
+            }
+            if (prefix == ctx.prefix_params.root_prefix)
+            {
+                LOG_ERROR << "Overwriting root prefix is not permitted";
+                throw std::runtime_error("Aborting.");
+            }
+            else if (fs::exists(prefix / "conda-meta"))
+            {
+                if (Console::prompt(
+                        "Found conda-prefix at '" + prefix.string() + "'. Overwrite?",
+                        'n'
+                    ))
+                {
+                    fs::remove_all(prefix);
+                }
+                else
+                {
+                    throw std::runtime_error("Aborting.");
+                }
+            }
+            else
+            {
+                LOG_ERROR << "Non-conda folder exists at prefix";
+                throw std::runtime_error("Aborting.");
+            }
+        }
+
+        /**
+         * The environments of the yaml files of ``batch_files``, created in the first writable
+         * environments directory under the name given in each file.
+         *
+         * The channels of the files are added to the configured ones, and must be the same
+         * for all the files since the repodata is loaded once.
+         */
+        auto batch_environments(const std::vector<std::string>& files)
+            -> std::vector<EnvironmentSpecs>
+        {
+            auto& ctx = Context::instance();
+            auto envs_dir = ctx.prefix_params.root_prefix / "envs";
+            for (const auto& dir : ctx.envs_dirs)
+            {
+                if (path::is_writable(dir))
+                {
+                    envs_dir = dir;
+                    break;
+                }
+            }
+
+            auto envs = std::vector<EnvironmentSpecs>();
+            auto channels = std::optional<std::vector<std::string>>();
+            auto prefixes = std::set<fs::u8path>();
+            for (const auto& file : files)
+            {
+                auto contents = detail::read_yaml_file(file);
+                if (contents.name.empty())
+                {
+                    throw std::runtime_error("No environment name in batch file '" + file + "'");
+                }
+                if (!contents.others_pkg_mgrs_specs.empty())
+                {
+                    throw std::runtime_error(
+                        "Dependencies of other package managers are not supported in batch file '"
+                        + file + "'"
+                    );
+                }
+                if (channels.has_value() && (contents.channels != *channels))
+                {
+                    throw std::runtime_error(
+                        "Batch file '" + file + "' does not use the same channels as the others"
+                    );
+                }
+                channels = std::move(contents.channels);
+
+                auto prefix = envs_dir / contents.name;
+                if (!prefixes.insert(prefix).second)
+                {
+                    throw std::runtime_error("Environment '" + contents.name + "' given twice");
+                }
+                envs.push_back({ std::move(prefix), std::move(contents.dependencies) });
+            }
+
+            for (const auto& channel : channels.value_or(std::vector<std::string>()))
+            {
+                if (std::find(ctx.channels.cbegin(), ctx.channels.cend(), channel)
+                    == ctx.channels.cend())
+                {
+                    ctx.channels.push_back(channel);
+                }
+            }
+            return envs;
+        }
+    }
+
     void create(Configuration& config)
     {
         auto& ctx = Context::instance();
 
+        // Batch files name their environments, there is no target prefix to check
+        const bool batch = config.at("batch_files").cli_configured();
         config.at("use_target_prefix_fallback").set_value(false);
         config.at("target_prefix_checks")
             .set_value(
-                MAMBA_ALLOW_EXISTING_PREFIX | MAMBA_ALLOW_NOT_ENV_PREFIX
-                | MAMBA_NOT_ALLOW_MISSING_PREFIX | MAMBA_NOT_EXPECT_EXISTING_PREFIX
+                batch ? MAMBA_NO_PREFIX_CHECK
+                      : MAMBA_ALLOW_EXISTING_PREFIX | MAMBA_ALLOW_NOT_ENV_PREFIX
+                            | MAMBA_NOT_ALLOW_MISSING_PREFIX | MAMBA_NOT_EXPECT_EXISTING_PREFIX
             );
         config.load();
 
         auto& create_specs = config.at("specs").value<std::vector<std::string>>();
         auto& use_explicit = config.at("explicit_install").value<bool>();
+        auto& clone = config.at("clone").value<std::string>();
+        auto& batch_files = config.at("batch_files").value<std::vector<std::string>>();
+        if (!batch_files.empty())
+        {
+            if (!create_specs.empty() || !clone.empty() || ctx.env_lockfile)
+            {
+                throw std::runtime_error("Packages cannot be given with batch files");
+            }
+            ChannelContext channel_context;
+            create_environments(channel_context, batch_environments(batch_files));
+            return;
+        }
+        if (!clone.empty() && (!create_specs.empty() || Context::instance().env_lockfile))
+        {
+            throw std::runtime_error("Packages cannot be given when cloning an environment");
+        }
+        if (!clone.empty()
+            && (detail::clone_source_prefix(clone) == ctx.prefix_params.target_prefix))
+        {
+            throw std::runtime_error("An environment cannot be cloned to itself");
+        }
 
         ChannelContext channel_context;
 
         if (!ctx.dry_run)
         {
-            if (fs::exists(ctx.prefix_params.target_prefix))
+            check_target_prefix(ctx.prefix_params.target_prefix);
+            if (!clone.empty())
             {
-                if (ctx.prefix_params.target_prefix == ctx.prefix_params.root_prefix)
-                {
-                    LOG_ERROR << "Overwriting root prefix is not permitted";
-                    throw std::runtime_error("Aborting.");
-                }
-                else if (fs::exists(ctx.prefix_params.target_prefix / "conda-meta"))
-                {
-                    if (Console::prompt(
-                            "Found conda-prefix at '" + ctx.prefix_params.target_prefix.string()
-                                + "'. Overwrite?",
-                            'n'
-                        ))
-                    {
-                        fs::remove_all(ctx.prefix_params.target_prefix);
-                    }
-                    else
-                    {
-                        throw std::runtime_error("Aborting.");
-                    }
-                }
-                else
-                {
-                    LOG_ERROR << "Non-conda folder exists at prefix";
-                    throw std::runtime_error("Aborting.");
-                }
+                const auto source = detail::clone_source_prefix(clone);
+                Console::stream() << "Cloning " << source.string() << " to "
+                                  << ctx.prefix_params.target_prefix.string();
+                clone_prefix(source, ctx.prefix_params.target_prefix);
+                detail::create_target_directory(ctx.prefix_params.target_prefix);
+                Console::instance().json_write({ { "success", true } });
             }
-            if (create_specs.empty())
+            else if (create_specs.empty())
             {
                 detail::create_empty_target(ctx.prefix_params.target_prefix);
             }
@@ -95,8 +225,218 @@ namespace mamba
         }
     }
 
+    void
+    create_environments(ChannelContext& channel_context, const std::vector<EnvironmentSpecs>& envs)
+    {
+        auto& ctx = Context::instance();
+        detail::init_tracing();
+        if (envs.empty())
+        {
+            return;
+        }
+        if (!ctx.dry_run)
+        {
+            for (const auto& env : envs)
+            {
+                check_target_prefix(env.prefix);
+            }
+        }
+
+        MultiPackageCache package_caches(ctx.pkgs_dirs);
+
+        // The repodata of the packages of all the environments is loaded at once
+        auto names = std::vector<std::string>();
+        // A spec without a definite name needs all the packages, for all the environments
+        bool needs_all_packages = false;
+        for (const auto& env : envs)
+        {
+            for (const auto& spec : env.specs)
+            {
+                auto ms = MatchSpec{ spec, channel_context };
+                if (!ms.channel.empty())
+                {
+                    throw std::runtime_error("Channel specs are not supported: " + spec);
+                }
+                if (ms.name.empty() || (ms.name.find('*') != std::string::npos))
+                {
+                    needs_all_packages = true;
+                }
+                else if (!needs_all_packages)
+                {
+                    names.push_back(std::move(ms.name));
+                }
+            }
+        }
+        if (needs_all_packages)
+        {
+            names.clear();
+        }
+        auto pool = MPool(channel_context);
+        if (auto loaded = load_channels(pool, package_caches, 0, names); !loaded)
+        {
+            throw std::runtime_error(loaded.error().what());
+        }
+        const auto virtual_packages = get_virtual_packages();
+
+        auto prefixes = std::vector<PrefixData>();
+        auto solvers = std::vector<MSolver>();
+        prefixes.reserve(envs.size());
+        solvers.reserve(envs.size());
+        for (const auto& env : envs)
+        {
+            auto exp_prefix_data = PrefixData::create(env.prefix, channel_context);
+            if (!exp_prefix_data)
+            {
+                throw std::runtime_error(exp_prefix_data.error().what());
+            }
+            auto& prefix_data = prefixes.emplace_back(std::move(exp_prefix_data).value());
+            prefix_data.add_packages(virtual_packages);
+
+            auto env_pool = pool.fork();
+            MRepo(env_pool, prefix_data);
+            auto& solver = solvers.emplace_back(
+                env_pool,
+                std::vector<std::pair<int, int>>{
+                    { SOLVER_FLAG_ALLOW_UNINSTALL, ctx.allow_uninstall },
+                    { SOLVER_FLAG_ALLOW_DOWNGRADE, ctx.allow_downgrade },
+                    { SOLVER_FLAG_STRICT_REPO_PRIORITY,
+                      ctx.channel_priority == ChannelPriority::kStrict },
+                }
+            );
+            solver.add_pins(ctx.pinned_packages);
+            env_pool.create_whatprovides();
+            solver.add_jobs(env.specs, SOLVER_INSTALL);
+        }
+
+        // Each solver has its own fork of the pool
+        auto solved = std::vector<char>(envs.size(), false);
+        const auto n_threads = std::clamp<std::size_t>(
+            std::thread::hardware_concurrency(),
+            1,
+            envs.size()
+        );
+        parallel_for(
+            envs.size(),
+            n_threads,
+            [&](std::size_t i) { solved[i] = solvers[i].try_solve(); }
+        );
+
+        bool success = true;
+        for (std::size_t i = 0; i < envs.size(); ++i)
+        {
+            if (!solved[i])
+            {
+                LOG_ERROR << "Could not solve " << envs[i].prefix.string() << ":\n"
+                          << solvers[i].explain_problems();
+                success = false;
+            }
+        }
+        if (!success)
+        {
+            detail::report_tracing();
+            throw mamba_error(
+                "Could not solve for environment specs",
+                mamba_error_code::satisfiablitity_error
+            );
+        }
+
+        // Transactions take their prefix from the context
+        const auto target_prefix = ctx.prefix_params.target_prefix;
+        on_scope_exit restore_prefix([&] { ctx.prefix_params.target_prefix = target_prefix; });
+
+        auto transactions = std::vector<std::unique_ptr<MTransaction>>();
+        transactions.reserve(envs.size());
+        for (std::size_t i = 0; i < envs.size(); ++i)
+        {
+            ctx.prefix_params.target_prefix = envs[i].prefix;
+            transactions.push_back(
+                std::make_unique<MTransaction>(solvers[i].pool(), solvers[i], package_caches)
+            );
+            transactions.back()->print();
+        }
+        detail::report_tracing();
+        if (ctx.dry_run)
+        {
+            return;
+        }
+        if (!Console::prompt("Confirm changes", 'y'))
+        {
+            throw std::runtime_error("Aborted.");
+        }
+
+        // Fetched together, as an explicit install in an empty prefix, so that the packages
+        // shared by several environments are only downloaded and extracted once
+        auto all_packages = std::vector<PackageInfo>();
+        auto urls = std::set<std::string>();
+        for (const auto& trans : transactions)
+        {
+            for_each_to_install(
+                trans->solution().actions,
+                [&](const PackageInfo& pkg)
+                {
+                    if (urls.insert(pkg.url).second)
+                    {
+                        all_packages.push_back(pkg);
+                    }
+                }
+            );
+        }
+        {
+            auto empty_dir = TemporaryDirectory();
+            auto empty_prefix = PrefixData::create(empty_dir.path(), channel_context);
+            if (!empty_prefix)
+            {
+                throw std::runtime_error(empty_prefix.error().what());
+            }
+            auto fetch = MTransaction(pool, empty_prefix.value(), all_packages, package_caches);
+            if (!fetch.fetch_extract_packages())
+            {
+                throw std::runtime_error("Could not fetch the packages of the environments");
+            }
+        }
+
+        for (std::size_t i = 0; i < envs.size(); ++i)
+        {
+            ctx.prefix_params.target_prefix = envs[i].prefix;
+            detail::create_target_directory(envs[i].prefix);
+            transactions[i]->execute(prefixes[i]);
+        }
+        detail::write_trace_file();
+    }
+
     namespace detail
     {
+        auto clone_source_prefix(const std::string& clone) -> fs::u8path
+        {
+            const auto& ctx = Context::instance();
+            auto prefix = fs::u8path();
+            if (clone.find_first_of("/\\") != std::string::npos)
+            {
+                prefix = fs::weakly_canonical(env::expand_user(clone));
+            }
+            else if (clone == "base")
+            {
+                prefix = ctx.prefix_params.root_prefix;
+            }
+            else
+            {
+                prefix = ctx.prefix_params.root_prefix / "envs" / clone;
+                for (const auto& dir : ctx.envs_dirs)
+                {
+                    if (fs::exists(dir / clone / "conda-meta"))
+                    {
+                        prefix = dir / clone;
+                        break;
+                    }
+                }
+            }
+            if (!fs::exists(prefix / "conda-meta"))
+            {
+                throw std::runtime_error("No environment to clone at '" + prefix.string() + "'");
+            }
+            return prefix;
+        }
+
         void store_platform_config(const fs::u8path& prefix, const std::string& platform)
         {
             if (!fs::exists(prefix))
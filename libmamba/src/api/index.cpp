@@ -0,0 +1,250 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <array>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+#include <zstd.h>
+
+#include "mamba/api/index.hpp"
+#include "mamba/core/output.hpp"
+#include "mamba/core/package_handling.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/url.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/util_string.hpp"
+#include "mamba/core/validate.hpp"
+
+#include "core/parallel.hpp"
+#include "core/repodata_index.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        bool is_package_file(const fs::u8path& path)
+        {
+            const auto name = path.filename().string();
+            return ends_with(name, ".tar.bz2") || ends_with(name, ".conda");
+        }
+
+        auto packages_key(const std::string& filename) -> const char*
+        {
+            return ends_with(filename, ".conda") ? "packages.conda" : "packages";
+        }
+
+        /** Read the index of a package, with the hashes and size of its file. */
+        nlohmann::json make_package_record(const fs::u8path& pkg_file)
+        {
+            auto record = nlohmann::json::parse(read_package_index_json(pkg_file));
+
+            auto md5 = validation::HashStream::md5();
+            auto sha256 = validation::HashStream::sha256();
+            std::array<char, 1 << 16> buffer;
+            auto in = open_ifstream(pkg_file);
+            while (in)
+            {
+                in.read(buffer.data(), buffer.size());
+                const auto size = static_cast<std::size_t>(in.gcount());
+                md5.update(buffer.data(), size);
+                sha256.update(buffer.data(), size);
+            }
+            record["md5"] = md5.hex_digest();
+            record["sha256"] = sha256.hex_digest();
+            record["size"] = fs::file_size(pkg_file);
+            return record;
+        }
+
+        void write_file(const fs::u8path& path, const char* data, std::size_t size)
+        {
+            // Readers see either the previous or the new file
+            auto tmp_path = path;
+            tmp_path += ".tmp";
+            {
+                auto out = open_ofstream(tmp_path);
+                out.write(data, static_cast<std::streamsize>(size));
+                if (!out)
+                {
+                    throw std::runtime_error("Could not write " + tmp_path.string());
+                }
+            }
+            fs::rename(tmp_path, path);
+        }
+
+        void write_zstd_file(const fs::u8path& path, const std::string& content, int level)
+        {
+            std::string compressed(ZSTD_compressBound(content.size()), '\0');
+            const auto size = ZSTD_compress(
+                compressed.data(),
+                compressed.size(),
+                content.data(),
+                content.size(),
+                level
+            );
+            if (ZSTD_isError(size))
+            {
+                throw std::runtime_error(
+                    concat("zstd compression error: ", ZSTD_getErrorName(size))
+                );
+            }
+            write_file(path, compressed.data(), size);
+        }
+    }
+
+    IndexStats index_subdir(
+        ChannelContext& channel_context,
+        const fs::u8path& subdir_dir,
+        std::size_t n_threads,
+        int zstd_level
+    )
+    {
+        const auto subdir = subdir_dir.filename().string();
+        const auto json_file = subdir_dir / "repodata.json";
+
+        // The previous records can be reused if their file did not change since then
+        nlohmann::json previous = nlohmann::json::object();
+        auto previous_time = fs::file_time_type::min();
+        if (fs::exists(json_file))
+        {
+            try
+            {
+                previous = nlohmann::json::parse(open_ifstream(json_file));
+                previous_time = fs::last_write_time(json_file);
+            }
+            catch (const std::exception& e)
+            {
+                LOG_WARNING << "Ignoring invalid " << json_file.string() << ": " << e.what();
+            }
+        }
+
+        nlohmann::json repodata = {
+            { "info", { { "subdir", subdir } } },
+            { "packages", nlohmann::json::object() },
+            { "packages.conda", nlohmann::json::object() },
+            { "removed", nlohmann::json::array() },
+            { "repodata_version", 1 },
+        };
+
+        auto to_index = std::vector<fs::u8path>();
+        for (const auto& entry : fs::directory_iterator(subdir_dir))
+        {
+            if (!entry.is_regular_file() || !is_package_file(entry.path()))
+            {
+                continue;
+            }
+            const auto filename = entry.path().filename().string();
+            const auto* key = packages_key(filename);
+            const auto known = previous.find(key);
+            if ((known != previous.end()) && known->contains(filename)
+                && ((*known)[filename].value("size", std::uintmax_t(0)) == entry.file_size())
+                && (entry.last_write_time() <= previous_time))
+            {
+                repodata[key][filename] = (*known)[filename];
+            }
+            else
+            {
+                to_index.push_back(entry.path());
+            }
+        }
+
+        if (n_threads == 0)
+        {
+            n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        auto records = std::vector<nlohmann::json>(to_index.size());
+        auto errors = std::vector<std::string>(to_index.size());
+        parallel_for(
+            to_index.size(),
+            std::clamp<std::size_t>(n_threads, 1, std::max<std::size_t>(to_index.size(), 1)),
+            [&](std::size_t i)
+            {
+                try
+                {
+                    records[i] = make_package_record(to_index[i]);
+                }
+                catch (const std::exception& e)
+                {
+                    errors[i] = concat(to_index[i].string(), ": ", e.what());
+                }
+            }
+        );
+
+        IndexStats stats;
+        for (std::size_t i = 0; i < to_index.size(); ++i)
+        {
+            if (!errors[i].empty())
+            {
+                LOG_WARNING << "Could not index " << errors[i];
+                stats.errors.push_back(std::move(errors[i]));
+                continue;
+            }
+            const auto filename = to_index[i].filename().string();
+            repodata[packages_key(filename)][filename] = std::move(records[i]);
+            ++stats.n_indexed;
+        }
+        stats.n_packages = repodata["packages"].size() + repodata["packages.conda"].size();
+
+        const auto content = repodata.dump();
+        write_file(json_file, content.data(), content.size());
+        auto zst_file = json_file;
+        zst_file += ".zst";
+        write_zstd_file(zst_file, content, zstd_level);
+        RepoDataIndex::write(
+            RepoDataRecords::read_all(json_file),
+            subdir_dir / RepoDataIndex::filename
+        );
+
+        // Reading the repodata writes its solv file next to it
+        MPool pool{ channel_context };
+        auto metadata = RepoMetadata{};
+        metadata.url = path_to_url(fs::absolute(subdir_dir).string());
+        MRepo(pool, subdir, json_file, metadata);
+
+        return stats;
+    }
+
+    std::map<std::string, IndexStats> index_channel(
+        ChannelContext& channel_context,
+        const fs::u8path& channel_dir,
+        std::size_t n_threads,
+        int zstd_level
+    )
+    {
+        auto subdirs = std::vector<fs::u8path>{ channel_dir / "noarch" };
+        for (const auto& entry : fs::directory_iterator(channel_dir))
+        {
+            if (!entry.is_directory() || (entry.path().filename() == "noarch"))
+            {
+                continue;
+            }
+            for (const auto& file : fs::directory_iterator(entry.path()))
+            {
+                if (is_package_file(file.path()))
+                {
+                    subdirs.push_back(entry.path());
+                    break;
+                }
+            }
+        }
+
+        fs::create_directories(channel_dir / "noarch");
+        auto result = std::map<std::string, IndexStats>();
+        for (const auto& subdir_dir : subdirs)
+        {
+            LOG_INFO << "Indexing " << subdir_dir.string();
+            result[subdir_dir.filename().string()] = index_subdir(
+                channel_context,
+                subdir_dir,
+                n_threads,
+                zstd_level
+            );
+        }
+        return result;
+    }
+}
@@ -4,14 +4,29 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <fstream>
+#include <set>
+#include <thread>
+
+#include <fmt/format.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
 #include "mamba/api/configuration.hpp"
 #include "mamba/api/info.hpp"
 #include "mamba/core/channel.hpp"
 #include "mamba/core/context.hpp"
 #include "mamba/core/environment.hpp"
+#include "mamba/core/fetch.hpp"
+#include "mamba/core/fsutil.hpp"
+#include "mamba/core/url.hpp"
 #include "mamba/core/util.hpp"
+#include "mamba/core/util_random.hpp"
 #include "mamba/core/virtual_packages.hpp"
 
+#include "../core/curl.hpp"
 
 extern "C"
 {
@@ -36,6 +51,90 @@ namespace mamba
         config.operation_teardown();
     }
 
+    void perf_info(Configuration& config)
+    {
+        config.at("use_target_prefix_fallback").set_value(true);
+        config.at("target_prefix_checks")
+            .set_value(
+                MAMBA_ALLOW_EXISTING_PREFIX | MAMBA_ALLOW_MISSING_PREFIX | MAMBA_ALLOW_NOT_ENV_PREFIX
+            );
+        config.load();
+
+        ChannelContext channel_context;
+        detail::print_perf_info(channel_context);
+
+        config.operation_teardown();
+    }
+
+    namespace
+    {
+        /** The path, or its closest existing parent, such as for a prefix to be created. */
+        auto existing_ancestor(fs::u8path path) -> fs::u8path
+        {
+            std::error_code ec;
+            while (!fs::exists(path, ec) && path.has_parent_path()
+                   && (path.parent_path() != path))
+            {
+                path = path.parent_path();
+            }
+            return path;
+        }
+
+        auto describe_filesystem(const fs::u8path& path) -> std::string
+        {
+            std::error_code ec;
+            const auto info = mamba_fs::filesystem_info(path, ec);
+            if (ec)
+            {
+                return fmt::format("unknown ({})", ec.message());
+            }
+            return info.network ? fmt::format("{} (network)", info.type) : info.type;
+        }
+
+        struct LinkSupport
+        {
+            bool hardlink = false;
+            bool reflink = false;
+            std::string error = {};
+        };
+
+        /** Try to hardlink and clone a file of the package cache into the prefix. */
+        auto probe_link_support(const fs::u8path& pkgs_dir, const fs::u8path& prefix_dir)
+            -> LinkSupport
+        {
+            auto out = LinkSupport();
+            const auto name = ".mamba-probe-" + generate_random_alphanumeric_string(8);
+            const auto src = pkgs_dir / name;
+            if (!(std::ofstream(src.std_path()) << "probe"))
+            {
+                out.error = "package cache not writable";
+                return out;
+            }
+
+            std::error_code ec;
+            const auto hardlink = prefix_dir / (name + "-hardlink");
+            fs::create_hard_link(src, hardlink, ec);
+            out.hardlink = !ec;
+            if (ec && (ec != std::errc::cross_device_link) && !path::is_writable(prefix_dir))
+            {
+                out.error = "prefix not writable";
+            }
+            fs::remove(hardlink, ec);
+
+            const auto clone = prefix_dir / (name + "-reflink");
+            mamba_fs::clone_file(src, clone, ec);
+            out.reflink = !ec;
+            fs::remove(clone, ec);
+            fs::remove(src, ec);
+            return out;
+        }
+
+        auto milliseconds(double seconds) -> std::string
+        {
+            return fmt::format("{:.1f} ms", seconds * 1000);
+        }
+    }
+
     namespace detail
     {
         void info_pretty_print(std::vector<std::tuple<std::string, nlohmann::json>> items)
@@ -174,5 +273,116 @@ namespace mamba
             info_json_print(items);
             info_pretty_print(items);
         }
+
+        void print_perf_info(ChannelContext& channel_context)
+        {
+            auto& ctx = Context::instance();
+            std::vector<std::tuple<std::string, nlohmann::json>> items;
+
+            items.push_back({ "cpu threads", std::to_string(std::thread::hardware_concurrency()) });
+
+#ifndef _WIN32
+            // Extracting and linking packages concurrently opens many files at once
+            struct ::rlimit limit;
+            if (::getrlimit(RLIMIT_NOFILE, &limit) == 0)
+            {
+                const auto str = [](rlim_t value)
+                {
+                    return (value == RLIM_INFINITY) ? std::string("unlimited")
+                                                    : std::to_string(value);
+                };
+                items.push_back({ "open files limit",
+                                  fmt::format(
+                                      "{} (hard limit {}){}",
+                                      str(limit.rlim_cur),
+                                      str(limit.rlim_max),
+                                      (limit.rlim_cur < 1024) ? ", low" : ""
+                                  ) });
+            }
+#endif
+
+            const auto prefix_dir = existing_ancestor(
+                ctx.prefix_params.target_prefix.empty() ? ctx.prefix_params.root_prefix
+                                                        : ctx.prefix_params.target_prefix
+            );
+            items.push_back(
+                { "prefix file system",
+                  fmt::format("{}: {}", prefix_dir.string(), describe_filesystem(prefix_dir)) }
+            );
+
+            std::vector<std::string> caches;
+            for (const auto& pkgs_dir : ctx.pkgs_dirs)
+            {
+                if (!fs::exists(pkgs_dir))
+                {
+                    caches.push_back(fmt::format("{}: not created", pkgs_dir.string()));
+                    continue;
+                }
+                const auto support = probe_link_support(pkgs_dir, prefix_dir);
+                caches.push_back(fmt::format(
+                    "{}: {}, hardlinks {}, reflinks {}{}",
+                    pkgs_dir.string(),
+                    describe_filesystem(pkgs_dir),
+                    support.hardlink ? "yes" : "no",
+                    support.reflink ? "yes" : "no",
+                    support.error.empty() ? "" : fmt::format(" ({})", support.error)
+                ));
+            }
+            items.push_back({ "package caches", caches });
+
+            bool set_low_speed_opt, set_ssl_no_revoke;
+            long connect_timeout_secs;
+            std::string ssl_verify;
+            get_config(set_low_speed_opt, set_ssl_no_revoke, connect_timeout_secs, ssl_verify);
+            if (ssl_verify == "<false>")
+            {
+                ssl_verify = "";
+            }
+
+            // One request on a new connection for each host of the channels
+            std::set<std::string> hosts;
+            std::vector<std::string> connections;
+            for (auto channel : channel_context.get_channels(ctx.channels))
+            {
+                for (const auto& url : channel->urls(true))
+                {
+                    auto handler = URLHandler(url);
+                    if ((handler.scheme() == "file")
+                        || !hosts.insert(handler.scheme() + "://" + handler.host()).second)
+                    {
+                        continue;
+                    }
+                    const auto probe_url = url + "/repodata.json";
+                    const auto times = curl::probe_connection(
+                        probe_url,
+                        set_low_speed_opt,
+                        connect_timeout_secs,
+                        set_ssl_no_revoke,
+                        proxy_match(probe_url),
+                        ssl_verify
+                    );
+                    if (!times.has_value())
+                    {
+                        connections.push_back(
+                            fmt::format("{}: failed ({})", handler.host(), times.error())
+                        );
+                        continue;
+                    }
+                    connections.push_back(fmt::format(
+                        "{}: DNS {}, connect {}, TLS {}, first byte {} (HTTP {})",
+                        handler.host(),
+                        milliseconds(times->name_lookup),
+                        milliseconds(times->connect),
+                        milliseconds(times->tls_handshake),
+                        milliseconds(times->first_byte),
+                        times->http_status
+                    ));
+                }
+            }
+            items.push_back({ "channel hosts", connections });
+
+            info_json_print(items);
+            info_pretty_print(items);
+        }
     }  // detail
 }  // mamba
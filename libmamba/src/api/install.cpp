@@ -4,7 +4,13 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
+#include <thread>
+#include <unordered_set>
 
 #include <fmt/color.h>
 #include <fmt/format.h>
@@ -21,9 +27,14 @@
 #include "mamba/core/environments_manager.hpp"
 #include "mamba/core/fetch.hpp"
 #include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/match_spec.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/package_cache.hpp"
+#include "mamba/core/package_download.hpp"
 #include "mamba/core/pinning.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/solver.hpp"
+#include "mamba/core/tracing.hpp"
 #include "mamba/core/transaction.hpp"
 #include "mamba/core/util_string.hpp"
 #include "mamba/core/virtual_packages.hpp"
@@ -63,6 +74,23 @@ namespace mamba
             }
         }
 
+        /** The package names of the specs, unless some are not plain names such as globs. */
+        auto spec_names(ChannelContext& channel_context, const std::vector<std::string>& specs)
+            -> std::optional<std::vector<std::string>>
+        {
+            auto names = std::vector<std::string>();
+            for (const auto& spec : specs)
+            {
+                auto ms = MatchSpec{ spec, channel_context };
+                if (ms.name.empty() || (ms.name.find('*') != std::string::npos))
+                {
+                    LOG_INFO << "Spec " << spec << " does not have a plain package name";
+                    return std::nullopt;
+                }
+                names.push_back(std::move(ms.name));
+            }
+            return { std::move(names) };
+        }
     }
 
     bool reproc_killed(int status)
@@ -153,7 +181,7 @@ namespace mamba
             pkg_mgr,
             fmt::join(deps, ", ")
         );
-        fmt::print(LOG_INFO, "Calling: {}", fmt::join(install_instructions, " "));
+        LOG_INFO << fmt::format("Calling: {}", fmt::join(install_instructions, " "));
 
         auto [status, ec] = reproc::run(wrapped_command, options);
         assert_reproc_success(options, status, ec);
@@ -163,6 +191,182 @@ namespace mamba
         }
     }
 
+    namespace
+    {
+        /**
+         * Install the packages of the other package managers while a transaction is executed,
+         * as soon as the packages they need, such as python and pip, are linked.
+         */
+        class OtherPkgMgrInstaller
+        {
+        public:
+
+            OtherPkgMgrInstaller(
+                std::vector<detail::other_pkg_mgr_spec> specs,
+                const Solution& solution
+            )
+                : m_specs(std::move(specs))
+            {
+                // The interpreter and its dependencies, among the packages of the transaction
+                auto depends = std::unordered_map<std::string, const std::vector<std::string>*>();
+                for_each_to_install(
+                    solution.actions,
+                    [&](const PackageInfo& pkg) { depends.emplace(pkg.name, &pkg.depends); }
+                );
+                auto todo = std::vector<std::string>{ "python", "pip" };
+                while (!todo.empty())
+                {
+                    const auto name = std::move(todo.back());
+                    todo.pop_back();
+                    const auto it = depends.find(name);
+                    if ((it == depends.cend()) || !m_waiting.insert(name).second)
+                    {
+                        continue;
+                    }
+                    for (const auto& dep : *it->second)
+                    {
+                        todo.push_back(dep.substr(0, dep.find(' ')));
+                    }
+                }
+                LOG_INFO << "Installing other package managers packages after linking "
+                         << m_waiting.size() << " packages";
+            }
+
+            OtherPkgMgrInstaller(const OtherPkgMgrInstaller&) = delete;
+            OtherPkgMgrInstaller& operator=(const OtherPkgMgrInstaller&) = delete;
+
+            ~OtherPkgMgrInstaller()
+            {
+                if (m_thread.joinable())
+                {
+                    m_thread.join();
+                }
+            }
+
+            /** Start installing if the transaction does not link what is needed. */
+            void start_if_ready()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_waiting.empty())
+                {
+                    start();
+                }
+            }
+
+            void on_linked(const PackageInfo& pkg)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if ((m_waiting.erase(pkg.name) > 0) && m_waiting.empty())
+                {
+                    start();
+                }
+            }
+
+            /**
+             * Wait for the installs, started now if the transaction did not link the packages
+             * they need, and report how long they took.
+             */
+            void finish(std::chrono::steady_clock::time_point transaction_start)
+            {
+                const auto transaction_time = std::chrono::steady_clock::now() - transaction_start;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (!m_thread.joinable())
+                    {
+                        m_start = std::chrono::steady_clock::now();
+                        m_thread = std::thread([this] { install(); });
+                    }
+                }
+                m_thread.join();
+                Console::stream() << fmt::format(
+                    "\nTransaction executed in {:.1f}s, other package managers packages installed"
+                    " in {:.1f}s, starting after {:.1f}s",
+                    to_seconds(transaction_time),
+                    to_seconds(m_end - m_start),
+                    to_seconds(m_start - transaction_start)
+                );
+                if (m_error)
+                {
+                    std::rethrow_exception(m_error);
+                }
+            }
+
+        private:
+
+            std::vector<detail::other_pkg_mgr_spec> m_specs;
+            std::unordered_set<std::string> m_waiting;
+            std::mutex m_mutex;
+            std::thread m_thread;
+            std::exception_ptr m_error;
+            std::chrono::steady_clock::time_point m_start;
+            std::chrono::steady_clock::time_point m_end;
+
+            static auto to_seconds(std::chrono::steady_clock::duration d) -> double
+            {
+                return std::chrono::duration<double>(d).count();
+            }
+
+            void start()
+            {
+                if (!m_thread.joinable())
+                {
+                    LOG_INFO << "Starting other package managers installs while linking";
+                    m_start = std::chrono::steady_clock::now();
+                    m_thread = std::thread([this] { install(); });
+                }
+            }
+
+            void install()
+            {
+                try
+                {
+                    for (const auto& other_spec : m_specs)
+                    {
+                        install_for_other_pkgmgr(other_spec);
+                    }
+                }
+                catch (...)
+                {
+                    m_error = std::current_exception();
+                }
+                m_end = std::chrono::steady_clock::now();
+            }
+        };
+
+        /** Execute the transaction and install the packages of other package managers. */
+        void execute_with_other_pkgmgrs(
+            MTransaction& transaction,
+            PrefixData& prefix_data,
+            const std::vector<detail::other_pkg_mgr_spec>& other_specs
+        )
+        {
+            const auto& ctx = Context::instance();
+            if (!ctx.pip_while_linking || other_specs.empty() || ctx.dry_run)
+            {
+                transaction.execute(prefix_data);
+                for (const auto& other_spec : other_specs)
+                {
+                    install_for_other_pkgmgr(other_spec);
+                }
+                return;
+            }
+
+            auto installer = OtherPkgMgrInstaller(other_specs, transaction.solution());
+            const auto start = std::chrono::steady_clock::now();
+            installer.start_if_ready();
+            const bool executed = transaction.execute(
+                prefix_data,
+                [&](const PackageInfo& pkg) { installer.on_linked(pkg); }
+            );
+            if (!executed)
+            {
+                // Interrupted, which also interrupts the subprocesses
+                return;
+            }
+            installer.finish(start);
+        }
+    }
+
     auto& truthy_values()
     {
         static std::map<std::string, int> vals{
@@ -374,6 +578,43 @@ namespace mamba
         {
             return (s1.pkg_mgr == s2.pkg_mgr) && (s1.deps == s2.deps) && (s1.cwd == s2.cwd);
         }
+
+        bool
+        specs_already_installed(PrefixData& prefix_data, const std::vector<std::string>& specs)
+        {
+            if (specs.empty() || prefix_data.records().empty())
+            {
+                return false;
+            }
+
+            auto& channel_context = prefix_data.channel_context();
+            const auto requested = prefix_data.history().get_requested_specs_map();
+            // Only the installed packages, which is cheap compared to the channels
+            MPool pool{ channel_context };
+            MRepo(pool, prefix_data);
+            pool.create_whatprovides();
+
+            for (const auto& spec : specs)
+            {
+                const auto ms = MatchSpec{ spec, channel_context };
+                // Channels, files and bracket keys cannot be matched without the repodata
+                if (ms.name.empty() || !ms.channel.empty() || ms.is_file || !ms.url.empty()
+                    || !ms.fn.empty() || !ms.brackets.empty())
+                {
+                    return false;
+                }
+                // Otherwise the spec would still be added to the history
+                if (requested.find(ms.name) == requested.cend())
+                {
+                    return false;
+                }
+                if (pool.select_solvables(pool.matchspec2id(ms)).empty())
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
     }
 
     void install(Configuration& config)
@@ -422,6 +663,7 @@ namespace mamba
 
     int RETRY_SUBDIR_FETCH = 1 << 0;
     int RETRY_SOLVE_ERROR = 1 << 1;
+    int RETRY_STALE_REPODATA = 1 << 2;
 
     void install_specs(
         ChannelContext& channel_context,
@@ -442,6 +684,8 @@ namespace mamba
         auto& only_deps = config.at("only_deps").value<bool>();
         auto& retry_clean_cache = config.at("retry_clean_cache").value<bool>();
 
+        detail::init_tracing();
+
         if (ctx.prefix_params.target_prefix.empty())
         {
             throw std::runtime_error("No active target prefix");
@@ -477,12 +721,6 @@ namespace mamba
            PrefixData::create(ctx.prefix_params.target_prefix); } ) .map_error([](const mamba_error&
            err) { throw std::runtime_error(err.what());
                                 });*/
-        auto exp_load = load_channels(pool, package_caches, is_retry);
-        if (!exp_load)
-        {
-            throw std::runtime_error(exp_load.error().what());
-        }
-
         auto exp_prefix_data = PrefixData::create(
             ctx.prefix_params.target_prefix,
             pool.channel_context()
@@ -493,51 +731,123 @@ namespace mamba
         }
         PrefixData& prefix_data = exp_prefix_data.value();
 
+        // Nothing to do when the specs are already installed and nothing else is requested
+        if (!create_env && (solver_flag == SOLVER_INSTALL) && !force_reinstall && !only_deps
+            && !is_retry && detail::specs_already_installed(prefix_data, specs))
+        {
+            LOG_INFO << "All requested specs are installed, skipping channels and solver";
+            if (ctx.output_params.json)
+            {
+                Console::instance().json_write({ { "success", true } });
+            }
+            else
+            {
+                Console::instance().print(fmt::format(
+                    "Transaction\n  Prefix: {}\n  All requested packages already installed\n",
+                    ctx.prefix_params.target_prefix.string()
+                ));
+            }
+
+            for (auto other_spec :
+                 config.at("others_pkg_mgrs_specs").value<std::vector<detail::other_pkg_mgr_spec>>())
+            {
+                install_for_other_pkgmgr(other_spec);
+            }
+            return;
+        }
+
         std::vector<std::string> prefix_pkgs;
         for (auto& it : prefix_data.records())
         {
             prefix_pkgs.push_back(it.first);
         }
 
+        const auto names = spec_names(pool.channel_context(), specs);
+        auto shard_names = std::vector<std::string>();
+        if (names.has_value())
+        {
+            // Installed packages can also be updated
+            shard_names = names.value();
+            shard_names.insert(shard_names.end(), prefix_pkgs.cbegin(), prefix_pkgs.cend());
+        }
+        // Expired repodata is used while refreshed, and only once on retry
+        auto revalidation = RepodataRevalidation();
+        auto exp_load = load_channels(
+            pool,
+            package_caches,
+            is_retry,
+            shard_names,
+            {},
+            (is_retry & RETRY_STALE_REPODATA) ? nullptr : &revalidation
+        );
+        if (!exp_load)
+        {
+            throw std::runtime_error(exp_load.error().what());
+        }
+
         prefix_data.add_packages(get_virtual_packages());
 
         MRepo(pool, prefix_data);
 
-        MSolver solver(
-            pool,
-            {
-                { SOLVER_FLAG_ALLOW_UNINSTALL, ctx.allow_uninstall },
-                { SOLVER_FLAG_ALLOW_DOWNGRADE, ctx.allow_downgrade },
-                { SOLVER_FLAG_STRICT_REPO_PRIORITY, ctx.channel_priority == ChannelPriority::kStrict },
-            }
-        );
-
-        solver.set_flags({
-            /* .keep_dependencies= */ !no_deps,
-            /* .keep_specs= */ !only_deps,
-            /* .force_reinstall= */ force_reinstall,
-        });
+        const auto libsolv_flags = std::vector<std::pair<int, int>>{
+            { SOLVER_FLAG_ALLOW_UNINSTALL, ctx.allow_uninstall },
+            { SOLVER_FLAG_ALLOW_DOWNGRADE, ctx.allow_downgrade },
+            { SOLVER_FLAG_STRICT_REPO_PRIORITY, ctx.channel_priority == ChannelPriority::kStrict },
+        };
+        const auto py_pin = no_py_pin ? std::string() : python_pin(prefix_data, specs);
 
-        if (freeze_installed && !prefix_pkgs.empty())
+        // The request, added to each solver of a portfolio on the pool of the solver
+        const auto setup = [&](MSolver& solver)
         {
-            LOG_INFO << "Locking environment: " << prefix_pkgs.size() << " packages freezed";
-            solver.add_jobs(prefix_pkgs, SOLVER_LOCK);
-        }
+            solver.set_flags({
+                /* .keep_dependencies= */ !no_deps,
+                /* .keep_specs= */ !only_deps,
+                /* .force_reinstall= */ force_reinstall,
+                /* .minimal_change= */ ctx.solver_minimal_change,
+            });
+
+            if (freeze_installed && !prefix_pkgs.empty())
+            {
+                LOG_INFO << "Locking environment: " << prefix_pkgs.size() << " packages freezed";
+                solver.add_jobs(prefix_pkgs, SOLVER_LOCK);
+            }
 
-        if (!no_pin)
-        {
-            solver.add_pins(file_pins(prefix_data.path() / "conda-meta" / "pinned"));
-            solver.add_pins(ctx.pinned_packages);
-        }
+            if (!no_pin)
+            {
+                solver.add_pins(file_pins(prefix_data.path() / "conda-meta" / "pinned"));
+                solver.add_pins(ctx.pinned_packages);
+            }
 
-        if (!no_py_pin)
-        {
-            auto py_pin = python_pin(prefix_data, specs);
             if (!py_pin.empty())
             {
                 solver.add_pin(py_pin);
             }
+
+            if (ctx.prune_pool && names.has_value())
+            {
+                solver.pool().prune(names.value());
+            }
+
+            // FRAGILE this must be called after pins be before jobs in current ``MPool``
+            solver.pool().create_whatprovides();
+
+            solver.add_jobs(specs, solver_flag);
+        };
+
+        auto portfolio = std::optional<SolverPortfolio>();
+        auto single_solver = std::optional<MSolver>();
+        if (ctx.solver_portfolio)
+        {
+            portfolio.emplace(pool, SolverPortfolio::default_strategies(libsolv_flags), setup);
         }
+        else
+        {
+            single_solver.emplace(pool, libsolv_flags);
+            setup(single_solver.value());
+        }
+
+        // The solver of the configured flags, until the portfolio is solved
+        MSolver& solver = portfolio.has_value() ? portfolio->solver() : single_solver.value();
         if (!solver.pinned_specs().empty())
         {
             std::vector<std::string> pinned_str;
@@ -548,15 +858,28 @@ namespace mamba
             Console::instance().print("\nPinned packages:\n" + join("", pinned_str));
         }
 
-        // FRAGILE this must be called after pins be before jobs in current ``MPool``
-        pool.create_whatprovides();
-
-        solver.add_jobs(specs, solver_flag);
+        auto prefetch = PackagePrefetch();
+        if (ctx.prefetch_while_solving && !ctx.dry_run)
+        {
+            prefetch.start(pool, package_caches, prefix_data, specs, solver.pinned_specs());
+        }
 
-        bool success = solver.try_solve();
+        const bool success = portfolio.has_value() ? portfolio->try_solve() : solver.try_solve();
+        if (revalidation.wait())
+        {
+            Console::instance().print("Repodata changed while solving, solving again\n");
+            return install_specs(
+                channel_context,
+                config,
+                specs,
+                create_env,
+                solver_flag,
+                is_retry | RETRY_STALE_REPODATA
+            );
+        }
         if (!success)
         {
-            solver.explain_problems(LOG_ERROR);
+            LOG_ERROR << solver.explain_problems();
             if (retry_clean_cache && !(is_retry & RETRY_SOLVE_ERROR))
             {
                 ctx.local_repodata_ttl = 2;
@@ -579,13 +902,18 @@ namespace mamba
                 Console::instance().json_write({ { "success", false },
                                                  { "solver_problems", solver.all_problems() } });
             }
+            detail::report_tracing();
             throw mamba_error(
                 "Could not solve for environment specs",
                 mamba_error_code::satisfiablitity_error
             );
         }
 
-        MTransaction trans(pool, solver, package_caches);
+        // The solution kept from a portfolio can be on a fork of the pool
+        MSolver& solved = portfolio.has_value() ? portfolio->solver() : solver;
+        MTransaction trans(solved.pool(), solved, package_caches);
+        prefetch.finish(trans.solution());
+        detail::report_tracing();
 
         if (ctx.output_params.json)
         {
@@ -601,19 +929,19 @@ namespace mamba
                 detail::create_target_directory(ctx.prefix_params.target_prefix);
             }
 
-            trans.execute(prefix_data);
-
-            for (auto other_spec :
-                 config.at("others_pkg_mgrs_specs").value<std::vector<detail::other_pkg_mgr_spec>>())
-            {
-                install_for_other_pkgmgr(other_spec);
-            }
+            execute_with_other_pkgmgrs(
+                trans,
+                prefix_data,
+                config.at("others_pkg_mgrs_specs").value<std::vector<detail::other_pkg_mgr_spec>>()
+            );
+            detail::write_trace_file();
         }
     }
 
     namespace detail
     {
-        // TransactionFunc: (MPool& pool, MultiPackageCache& package_caches) -> MTransaction
+        // TransactionFunc: (MPool& pool, PrefixData& prefix_data, MultiPackageCache& pkg_caches,
+        //                   std::vector<detail::other_pkg_mgr_spec>& others) -> MTransaction
         template <typename TransactionFunc>
         void install_explicit_with_transaction(
             ChannelContext& channel_context,
@@ -633,13 +961,9 @@ namespace mamba
 
             MultiPackageCache pkg_caches(ctx.pkgs_dirs);
             prefix_data.add_packages(get_virtual_packages());
-            MRepo(pool, prefix_data);  // Potentially re-alloc (moves in memory) Solvables
-                                       // in the pool
 
             std::vector<detail::other_pkg_mgr_spec> others;
-            // Note that the Transaction will gather the Solvables,
-            // so they must have been ready in the pool before this line
-            auto transaction = create_transaction(pool, pkg_caches, others);
+            auto transaction = create_transaction(pool, prefix_data, pkg_caches, others);
 
             if (ctx.output_params.json)
             {
@@ -653,12 +977,7 @@ namespace mamba
                     detail::create_target_directory(ctx.prefix_params.target_prefix);
                 }
 
-                transaction.execute(prefix_data);
-
-                for (auto other_spec : others)
-                {
-                    install_for_other_pkgmgr(other_spec);
-                }
+                execute_with_other_pkgmgrs(transaction, prefix_data, others);
             }
         }
     }
@@ -671,8 +990,14 @@ namespace mamba
     {
         detail::install_explicit_with_transaction(
             channel_context,
-            [&](auto& pool, auto& pkg_caches, auto& others)
-            { return create_explicit_transaction_from_urls(pool, specs, pkg_caches, others); },
+            [&](auto& pool, auto& prefix_data, auto& pkg_caches, auto& others)
+            {
+                MRepo(pool, prefix_data);  // Potentially re-alloc (moves in memory) Solvables
+                                           // in the pool
+                // Note that the Transaction will gather the Solvables,
+                // so they must have been ready in the pool before this line
+                return create_explicit_transaction_from_urls(pool, specs, pkg_caches, others);
+            },
             create_env
         );
     }
@@ -709,8 +1034,17 @@ namespace mamba
 
         detail::install_explicit_with_transaction(
             channel_context,
-            [&](auto& pool, auto& pkg_caches, auto& others) {
-                return create_explicit_transaction_from_lockfile(pool, file, categories, pkg_caches, others);
+            [&](auto& pool, auto& prefix_data, auto& pkg_caches, auto& others)
+            {
+                // Compared to the prefix without loading it in the solver pool
+                return create_explicit_transaction_from_lockfile(
+                    pool,
+                    prefix_data,
+                    file,
+                    categories,
+                    pkg_caches,
+                    others
+                );
             },
             create_env
         );
@@ -729,6 +1063,38 @@ namespace mamba
             Console::instance().json_write({ { "success", true } });
         }
 
+        void init_tracing()
+        {
+            const auto& params = Context::instance().output_params;
+            Tracer::instance().set_enabled(params.json || !params.trace_file.empty());
+        }
+
+        void report_tracing()
+        {
+            const auto& params = Context::instance().output_params;
+            auto& tracer = Tracer::instance();
+            if (!tracer.enabled())
+            {
+                return;
+            }
+            if (params.json)
+            {
+                Console::instance().json_write({ { "timings", tracer.to_json() } });
+            }
+            write_trace_file();
+        }
+
+        void write_trace_file()
+        {
+            const auto& params = Context::instance().output_params;
+            auto& tracer = Tracer::instance();
+            if (tracer.enabled() && !params.trace_file.empty())
+            {
+                tracer.write_chrome_trace(params.trace_file);
+                LOG_INFO << "Trace written to " << params.trace_file;
+            }
+        }
+
         void create_target_directory(const fs::u8path prefix)
         {
             path::touch(prefix / "conda-meta" / "history", true);
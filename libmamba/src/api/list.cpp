@@ -5,13 +5,20 @@
 // The full license is in the file LICENSE, distributed with this software.
 
 #include <iostream>
+#include <optional>
 #include <regex>
+#include <string_view>
+
+#include <nlohmann/json.hpp>
 
 #include "mamba/api/configuration.hpp"
 #include "mamba/api/list.hpp"
 #include "mamba/core/channel.hpp"
 #include "mamba/core/context.hpp"
+#include "mamba/core/history.hpp"
 #include "mamba/core/prefix_data.hpp"
+#include "mamba/core/prefix_file_index.hpp"
+#include "mamba/core/util_string.hpp"
 
 namespace mamba
 {
@@ -29,6 +36,110 @@ namespace mamba
         detail::list_packages(regex, channel_context);
     }
 
+    void list_file_owners(Configuration& config, const std::vector<std::string>& paths)
+    {
+        config.at("use_target_prefix_fallback").set_value(true);
+        config.at("target_prefix_checks")
+            .set_value(
+                MAMBA_ALLOW_EXISTING_PREFIX | MAMBA_NOT_ALLOW_MISSING_PREFIX
+                | MAMBA_NOT_ALLOW_NOT_ENV_PREFIX | MAMBA_EXPECT_EXISTING_PREFIX
+            );
+        config.load();
+
+        const auto& ctx = Context::instance();
+        const auto& prefix = ctx.prefix_params.target_prefix;
+        const auto index = PrefixFileIndex(prefix);
+
+        auto owners = nlohmann::json::object();
+        for (const auto& path : paths)
+        {
+            // Absolute paths and paths relative to the working directory are accepted
+            auto file = fs::u8path(path);
+            if (file.is_absolute() || fs::exists(file))
+            {
+                file = fs::weakly_canonical(fs::absolute(file))
+                           .lexically_relative(fs::weakly_canonical(prefix));
+            }
+            const auto owner = index.find(file.string());
+            owners[path] = owner.has_value() ? nlohmann::json(owner->package) : nullptr;
+        }
+
+        if (ctx.output_params.json)
+        {
+            std::cout << owners.dump(4) << std::endl;
+            return;
+        }
+        for (const auto& [path, owner] : owners.items())
+        {
+            std::cout << path << ": "
+                      << (owner.is_null() ? "not owned by any package" : owner.get<std::string>())
+                      << '\n';
+        }
+    }
+
+    namespace
+    {
+        /**
+         * Match package names as ``std::regex_search`` would.
+         *
+         * Most filters are plain names, which are searched as substrings, optionally anchored
+         * at the start, without compiling a regex.
+         */
+        class NameFilter
+        {
+        public:
+
+            explicit NameFilter(const std::string& regex)
+            {
+                constexpr std::string_view metachars = R"(.^$|?*+()[]{}\)";
+                auto literal = std::string_view(regex);
+                if (starts_with(literal, "^"))
+                {
+                    m_anchored = true;
+                    literal.remove_prefix(1);
+                }
+                if (literal.find_first_of(metachars) == std::string_view::npos)
+                {
+                    m_literal = literal;
+                }
+                else
+                {
+                    m_regex = std::regex(regex);
+                }
+            }
+
+            bool operator()(const std::string& name) const
+            {
+                if (m_regex.has_value())
+                {
+                    return std::regex_search(name, *m_regex);
+                }
+                return m_anchored ? starts_with(name, m_literal) : contains(name, m_literal);
+            }
+
+        private:
+
+            std::string m_literal;
+            std::optional<std::regex> m_regex;
+            bool m_anchored = false;
+        };
+
+        auto package_json(const PrefixData::RecordSummary& pkg, const Channel& channel)
+            -> nlohmann::json
+        {
+            return {
+                { "base_url", channel.base_url() },
+                { "build_number", pkg.build_number },
+                { "build_string", pkg.build_string },
+                { "channel", channel.name() },
+                { "dist_name", concat(pkg.name, "-", pkg.version, "-", pkg.build_string) },
+                { "name", pkg.name },
+                { "platform", pkg.subdir },
+                { "version", pkg.version },
+            };
+        }
+    }
+
     namespace detail
     {
         struct formatted_pkg
@@ -44,82 +155,65 @@ namespace mamba
         void list_packages(std::string regex, ChannelContext& channel_context)
         {
             auto& ctx = Context::instance();
+            const auto& prefix = ctx.prefix_params.target_prefix;
 
-            auto sprefix_data = PrefixData::create(ctx.prefix_params.target_prefix, channel_context);
-            if (!sprefix_data)
+            // Only the listed fields are read, from the index of the installed records
+            std::vector<PrefixData::RecordSummary> summaries;
+            try
+            {
+                summaries = PrefixData::load_summaries(prefix);
+            }
+            catch (const std::exception& e)
             {
-                // TODO: propagate tl::expected mechanism
-                throw std::runtime_error("could not load prefix data");
+                throw std::runtime_error(std::string("could not load prefix data: ") + e.what());
             }
-            PrefixData& prefix_data = sprefix_data.value();
 
-            std::regex spec_pat(regex);
+            const auto matches = NameFilter(regex);
 
             if (ctx.output_params.json)
             {
-                auto jout = nlohmann::json::array();
-                std::vector<std::string> keys;
-
-                for (const auto& pkg : prefix_data.records())
-                {
-                    keys.push_back(pkg.first);
-                }
-                std::sort(keys.begin(), keys.end());
-
-                for (const auto& key : keys)
+                // Written one package at a time
+                auto writer = JsonArrayWriter(std::cout);
+                for (const auto& pkg : summaries)
                 {
-                    auto obj = nlohmann::json();
-                    const auto& pkg_info = prefix_data.records().find(key)->second;
-
-                    if (regex.empty() || std::regex_search(pkg_info.name, spec_pat))
+                    if (regex.empty() || matches(pkg.name))
                     {
-                        auto& channel = channel_context.make_channel(pkg_info.url);
-                        obj["base_url"] = channel.base_url();
-                        obj["build_number"] = pkg_info.build_number;
-                        obj["build_string"] = pkg_info.build_string;
-                        obj["channel"] = channel.name();
-                        obj["dist_name"] = pkg_info.str();
-                        obj["name"] = pkg_info.name;
-                        obj["platform"] = pkg_info.subdir;
-                        obj["version"] = pkg_info.version;
-                        jout.push_back(obj);
+                        writer.append(package_json(pkg, channel_context.make_channel(pkg.url)));
                     }
                 }
-                std::cout << jout.dump(4) << std::endl;
+                writer.finish();
+                std::cout << std::endl;
                 return;
             }
 
-            std::cout << "List of packages in environment: " << ctx.prefix_params.target_prefix
-                      << "\n\n";
+            std::cout << "List of packages in environment: " << prefix << "\n\n";
 
             formatted_pkg formatted_pkgs;
 
             std::vector<formatted_pkg> packages;
-            auto requested_specs = prefix_data.history().get_requested_specs_map();
+            auto requested_specs = History(prefix, channel_context).get_requested_specs_map();
 
-            // order list of packages from prefix_data by alphabetical order
-            for (const auto& package : prefix_data.records())
+            // summaries are in alphabetical order
+            for (const auto& pkg : summaries)
             {
-                if (regex.empty() || std::regex_search(package.second.name, spec_pat))
+                if (regex.empty() || matches(pkg.name))
                 {
-                    formatted_pkgs.name = package.second.name;
-                    formatted_pkgs.version = package.second.version;
-                    formatted_pkgs.build = package.second.build_string;
-                    if (package.second.channel.find("https://repo.anaconda.com/pkgs/") == 0)
+                    formatted_pkgs.name = pkg.name;
+                    formatted_pkgs.version = pkg.version;
+                    formatted_pkgs.build = pkg.build_string;
+                    if (pkg.channel.find("https://repo.anaconda.com/pkgs/") == 0)
                     {
                         formatted_pkgs.channel = "";
                     }
                     else
                     {
-                        const Channel& channel = channel_context.make_channel(package.second.url);
+                        const Channel& channel = channel_context.make_channel(pkg.url);
                         formatted_pkgs.channel = channel.name();
                     }
                     packages.push_back(formatted_pkgs);
                 }
             }
 
-            std::sort(packages.begin(), packages.end(), compare_alphabetically);
-
             // format and print table
             printers::Table t({ "Name", "Version", "Build", "Channel" });
             t.set_alignment({ printers::alignment::left,
@@ -4,9 +4,14 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <thread>
+
+#include <fmt/format.h>
+
 #include "mamba/api/configuration.hpp"
 #include "mamba/api/remove.hpp"
 #include "mamba/core/channel.hpp"
+#include "mamba/core/link.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/package_cache.hpp"
 #include "mamba/core/pool.hpp"
@@ -14,6 +19,9 @@
 #include "mamba/core/repo.hpp"
 #include "mamba/core/solver.hpp"
 #include "mamba/core/transaction.hpp"
+#include "mamba/core/util.hpp"
+
+#include "../core/parallel.hpp"
 
 namespace mamba
 {
@@ -22,6 +30,7 @@ namespace mamba
         bool prune = flags & MAMBA_REMOVE_PRUNE;
         bool force = flags & MAMBA_REMOVE_FORCE;
         bool remove_all = flags & MAMBA_REMOVE_ALL;
+        bool remove_env = flags & MAMBA_REMOVE_ENV;
 
         auto& ctx = Context::instance();
 
@@ -46,6 +55,24 @@ namespace mamba
                 throw std::runtime_error("could not load prefix data");
             }
             PrefixData& prefix_data = sprefix_data.value();
+
+            // The prefix is deleted next, the packages do not need to be unlinked one by one
+            if (remove_env && !ctx.dry_run && !prefix_data.records().empty()
+                && detail::only_deletes_files(prefix_data))
+            {
+                Console::instance().print(fmt::format(
+                    "Removing the {} packages of {}\n",
+                    prefix_data.records().size(),
+                    ctx.prefix_params.target_prefix.string()
+                ));
+                if (!Console::prompt("Confirm changes", 'y'))
+                {
+                    throw std::runtime_error("Aborted.");
+                }
+                detail::delete_prefix_content(ctx.prefix_params.target_prefix);
+                return;
+            }
+
             for (const auto& package : prefix_data.records())
             {
                 remove_specs.push_back(package.second.name);
@@ -157,5 +184,53 @@ namespace mamba
                 execute_transaction(transaction);
             }
         }
+
+        bool only_deletes_files(const PrefixData& prefix_data)
+        {
+            const auto& prefix = prefix_data.path();
+            if (fs::exists(prefix / "Menu") || fs::exists(prefix / "menu"))
+            {
+                return false;
+            }
+            for (const auto& [name, record] : prefix_data.records())
+            {
+                const auto script = "." + name + "-pre-unlink";
+                if (fs::exists(prefix / "bin" / (script + ".sh"))
+                    || fs::exists(prefix / "Scripts" / (script + ".bat")))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void delete_prefix_content(const fs::u8path& prefix)
+        {
+            auto files = std::vector<fs::u8path>();
+            auto directories = std::vector<fs::u8path>();
+            std::error_code ec;
+            for (auto it = fs::recursive_directory_iterator(prefix, ec);
+                 !ec && (it != fs::recursive_directory_iterator());
+                 it.increment(ec))
+            {
+                // Symbolic links to directories are not followed
+                if (it->is_directory(ec) && !it->is_symlink(ec))
+                {
+                    directories.push_back(it->path());
+                }
+                else
+                {
+                    files.push_back(it->path());
+                }
+            }
+
+            const auto n_threads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+            parallel_for(
+                files.size(),
+                n_threads,
+                [&](std::size_t i) { remove_or_rename(files[i]); }
+            );
+            remove_empty_directories(std::move(directories), prefix);
+        }
     }
 }  // mamba
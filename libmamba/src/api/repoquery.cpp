@@ -75,7 +75,7 @@ namespace mamba
         {
             if (ctx.output_params.json)
             {
-                std::cout << q.find(query).groupby("name").json(pool.channel_context()).dump(4);
+                q.find(query).groupby("name").write_json(std::cout, pool.channel_context());
             }
             else
             {
@@ -84,7 +84,7 @@ namespace mamba
                 switch (format)
                 {
                     case QueryResultFormat::kJSON:
-                        std::cout << res.json(pool.channel_context()).dump(4);
+                        res.write_json(std::cout, pool.channel_context());
                         break;
                     case QueryResultFormat::kPRETTY:
                         res.pretty(std::cout);
@@ -112,7 +112,7 @@ namespace mamba
                     res.tree(std::cout);
                     break;
                 case QueryResultFormat::kJSON:
-                    std::cout << res.json(pool.channel_context()).dump(4);
+                    res.write_json(std::cout, pool.channel_context());
                     break;
                 case QueryResultFormat::kTABLE:
                 case QueryResultFormat::kRECURSIVETABLE:
@@ -138,7 +138,7 @@ namespace mamba
                     res.tree(std::cout);
                     break;
                 case QueryResultFormat::kJSON:
-                    std::cout << res.json(pool.channel_context()).dump(4);
+                    res.write_json(std::cout, pool.channel_context());
                     break;
                 case QueryResultFormat::kTABLE:
                 case QueryResultFormat::kRECURSIVETABLE:
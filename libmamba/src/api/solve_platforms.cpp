@@ -0,0 +1,141 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include "mamba/api/channel_loader.hpp"
+#include "mamba/api/solve_platforms.hpp"
+#include "mamba/core/context.hpp"
+#include "mamba/core/match_spec.hpp"
+#include "mamba/core/package_cache.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/solver.hpp"
+#include "mamba/core/transaction.hpp"
+
+#include "core/parallel.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        auto solve_platform(
+            MPool& pool,
+            MultiPackageCache& caches,
+            const std::vector<std::string>& specs
+        ) -> expected_t<Solution>
+        {
+            const auto& ctx = Context::instance();
+            pool.create_whatprovides();
+
+            MSolver solver(
+                pool,
+                {
+                    { SOLVER_FLAG_ALLOW_UNINSTALL, ctx.allow_uninstall },
+                    { SOLVER_FLAG_ALLOW_DOWNGRADE, ctx.allow_downgrade },
+                    { SOLVER_FLAG_STRICT_REPO_PRIORITY,
+                      ctx.channel_priority == ChannelPriority::kStrict },
+                }
+            );
+            solver.add_jobs(specs, SOLVER_INSTALL);
+            if (!solver.try_solve())
+            {
+                return make_unexpected(
+                    solver.problems_to_str(),
+                    mamba_error_code::satisfiablitity_error
+                );
+            }
+            return MTransaction(pool, solver, caches).solution();
+        }
+    }
+
+    auto solve_for_platforms(
+        ChannelContext& channel_context,
+        MultiPackageCache& package_caches,
+        const std::vector<std::string>& specs,
+        const std::vector<std::string>& platforms,
+        const std::map<std::string, std::vector<PackageInfo>>& virtual_packages
+    ) -> std::map<std::string, expected_t<Solution>>
+    {
+        auto results = std::map<std::string, expected_t<Solution>>();
+        auto spec_names = std::vector<std::string>();
+        spec_names.reserve(specs.size());
+        for (const auto& spec : specs)
+        {
+            spec_names.push_back(MatchSpec(spec, channel_context).name);
+        }
+
+        auto noarch_pool = MPool(channel_context);
+        if (auto loaded = load_channels(noarch_pool, package_caches, 0, spec_names, { "noarch" });
+            !loaded)
+        {
+            for (const auto& platform : platforms)
+            {
+                results.emplace(
+                    platform,
+                    make_unexpected(loaded.error().what(), mamba_error_code::repodata_not_loaded)
+                );
+            }
+            return results;
+        }
+
+        // Loading repodata downloads and reports progress, so it is done one platform at a time
+        auto pools = std::vector<std::optional<MPool>>();
+        pools.reserve(platforms.size());
+        for (const auto& platform : platforms)
+        {
+            auto pool = noarch_pool.fork();
+            if (auto loaded = load_channels(pool, package_caches, 0, spec_names, { platform });
+                !loaded)
+            {
+                results.emplace(
+                    platform,
+                    make_unexpected(loaded.error().what(), mamba_error_code::repodata_not_loaded)
+                );
+                pools.emplace_back();
+                continue;
+            }
+            const auto vpkgs = virtual_packages.find(platform);
+            MRepo(
+                pool,
+                "installed",
+                (vpkgs != virtual_packages.end()) ? vpkgs->second : std::vector<PackageInfo>()
+            )
+                .set_installed();
+            pools.push_back(std::move(pool));
+        }
+
+        auto solutions = std::vector<std::optional<expected_t<Solution>>>(platforms.size());
+        const auto n_threads = std::clamp<std::size_t>(
+            std::thread::hardware_concurrency(),
+            1,
+            std::max<std::size_t>(platforms.size(), 1)
+        );
+        parallel_for(
+            platforms.size(),
+            n_threads,
+            [&](std::size_t i)
+            {
+                if (pools[i].has_value())
+                {
+                    solutions[i] = solve_platform(*pools[i], package_caches, specs);
+                }
+            }
+        );
+
+        for (std::size_t i = 0; i < platforms.size(); ++i)
+        {
+            if (solutions[i].has_value())
+            {
+                results.emplace(platforms[i], std::move(solutions[i]).value());
+            }
+        }
+        return results;
+    }
+}
@@ -6,6 +6,7 @@
 
 #include "mamba/api/channel_loader.hpp"
 #include "mamba/api/configuration.hpp"
+#include "mamba/api/install.hpp"
 #include "mamba/api/update.hpp"
 #include "mamba/core/channel.hpp"
 #include "mamba/core/context.hpp"
@@ -27,6 +28,7 @@ namespace mamba
                 | MAMBA_NOT_ALLOW_NOT_ENV_PREFIX | MAMBA_EXPECT_EXISTING_PREFIX
             );
         config.load();
+        detail::init_tracing();
 
         auto update_specs = config.at("specs").value<std::vector<std::string>>();
 
@@ -79,6 +81,10 @@ namespace mamba
             }
         );
 
+        auto flags = solver.flags();
+        flags.minimal_change = ctx.solver_minimal_change;
+        solver.set_flags(flags);
+
         auto& no_pin = config.at("no_pin").value<bool>();
         auto& no_py_pin = config.at("no_py_pin").value<bool>();
 
@@ -144,10 +150,12 @@ namespace mamba
             if (yes)
             {
                 transaction.execute(prefix_data);
+                detail::write_trace_file();
             }
         };
 
         MTransaction transaction(pool, solver, package_caches);
+        detail::report_tracing();
         execute_transaction(transaction);
     }
 }
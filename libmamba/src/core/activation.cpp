@@ -4,6 +4,8 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <stdexcept>
+
 #include "mamba/core/activation.hpp"
 #include "mamba/core/context.hpp"
 #include "mamba/core/environment.hpp"
@@ -11,6 +13,7 @@
 #include "mamba/core/shell_init.hpp"
 #include "mamba/core/util.hpp"
 #include "mamba/core/util_string.hpp"
+#include "mamba/core/validate.hpp"
 
 namespace mamba
 {
@@ -18,8 +21,203 @@ namespace mamba
     {
         fs::u8path PREFIX_STATE_FILE = fs::u8path("conda-meta") / "state";
         fs::u8path PACKAGE_ENV_VARS_DIR = fs::u8path("etc") / "conda" / "env_vars.d";
+        fs::u8path ACTIVATE_SCRIPTS_DIR = fs::u8path("etc") / "conda" / "activate.d";
+        fs::u8path DEACTIVATE_SCRIPTS_DIR = fs::u8path("etc") / "conda" / "deactivate.d";
         std::string CONDA_ENV_VARS_UNSET_VAR = "***unset***";  // NOLINT(runtime/string)
-    }                                                          // namespace
+        /** Bump when the format of the activation cache changes. */
+        constexpr int ACTIVATION_CACHE_VERSION = 1;
+
+        std::vector<fs::u8path>
+        compute_activate_scripts(const fs::u8path& prefix, const std::string& extension)
+        {
+            std::vector<fs::u8path> result = filter_dir(prefix / ACTIVATE_SCRIPTS_DIR, extension);
+            std::sort(result.begin(), result.end());
+            return result;
+        }
+
+        std::vector<fs::u8path>
+        compute_deactivate_scripts(const fs::u8path& prefix, const std::string& extension)
+        {
+            std::vector<fs::u8path> result = filter_dir(prefix / DEACTIVATE_SCRIPTS_DIR, extension);
+            // reverse sort!
+            std::sort(result.begin(), result.end(), std::greater<fs::u8path>());
+            return result;
+        }
+
+        std::vector<std::pair<std::string, std::string>>
+        compute_environment_vars(const fs::u8path& prefix)
+        {
+            fs::u8path env_vars_file = prefix / PREFIX_STATE_FILE;
+            fs::u8path pkg_env_var_dir = prefix / PACKAGE_ENV_VARS_DIR;
+
+            nlohmann::ordered_map<std::string, std::string> env_vars;
+
+            // # First get env vars from packages
+            auto env_var_files = filter_dir(pkg_env_var_dir, "");
+            std::sort(env_var_files.begin(), env_var_files.end());
+            for (auto& f : env_var_files)
+            {
+                auto fin = open_ifstream(f);
+                nlohmann::ordered_json j;
+                try
+                {
+                    fin >> j;
+                    for (auto it = j.begin(); it != j.end(); ++it)
+                    {
+                        env_vars[to_upper(it.key())] = it.value();
+                    }
+                }
+                catch (nlohmann::json::exception& error)
+                {
+                    LOG_WARNING << "Could not read JSON at " << f << ": " << error.what();
+                }
+            }
+
+            // Then get env vars from environment specification
+            if (fs::exists(env_vars_file))
+            {
+                auto fin = open_ifstream(env_vars_file);
+                try
+                {
+                    nlohmann::ordered_json j;
+                    fin >> j;
+                    if (j.contains("env_vars"))
+                    {
+                        auto& prefix_state_env_vars = j["env_vars"];
+                        for (auto it = prefix_state_env_vars.begin();
+                             it != prefix_state_env_vars.end();
+                             ++it)
+                        {
+                            if (env_vars.find(it.key()) != env_vars.end())
+                            {
+                                LOG_WARNING
+                                    << "Duplicate env vars detected. Vars from the environment "
+                                    << "will overwrite those from packages";
+                                LOG_WARNING << "Variable " << it.key() << " duplicated";
+                            }
+                            env_vars[to_upper(it.key())] = it.value();
+                        }
+                    }
+                }
+                catch (nlohmann::json::exception& error)
+                {
+                    LOG_WARNING << "Could not read JSON at " << env_vars_file << ": "
+                                << error.what();
+                }
+            }
+            std::vector<std::pair<std::string, std::string>> res(env_vars.begin(), env_vars.end());
+            return res;
+        }
+
+        fs::u8path activation_cache_path(const fs::u8path& prefix)
+        {
+            auto hash = validation::HashStream::sha256();
+            const auto prefix_str = prefix.string();
+            hash.update(prefix_str.data(), prefix_str.size());
+            return env::user_cache_dir() / "mamba" / "activation" / (hash.hex_digest() + ".json");
+        }
+
+        /**
+         * The modification times of what the activation reads from the prefix.
+         *
+         * Adding or removing scripts changes their directory, but the files of env_vars.d
+         * can be edited in place.
+         */
+        nlohmann::json prefix_stamps(const fs::u8path& prefix)
+        {
+            auto stamp = [](const fs::u8path& path) -> nlohmann::json
+            {
+                std::error_code ec;
+                const auto mtime = fs::last_write_time(path, ec);
+                if (ec)
+                {
+                    return nullptr;
+                }
+                return mtime.time_since_epoch().count();
+            };
+
+            auto stamps = nlohmann::json::object();
+            const auto stamped = {
+                PREFIX_STATE_FILE,
+                ACTIVATE_SCRIPTS_DIR,
+                DEACTIVATE_SCRIPTS_DIR,
+                PACKAGE_ENV_VARS_DIR,
+            };
+            for (const auto& path : stamped)
+            {
+                stamps[path.string()] = stamp(prefix / path);
+            }
+            for (const auto& file : filter_dir(prefix / PACKAGE_ENV_VARS_DIR, ""))
+            {
+                stamps[(PACKAGE_ENV_VARS_DIR / file.filename()).string()] = stamp(file);
+            }
+            return stamps;
+        }
+
+        nlohmann::json read_activation_cache(const fs::u8path& path)
+        {
+            try
+            {
+                if (fs::exists(path))
+                {
+                    auto fin = open_ifstream(path);
+                    auto cache = nlohmann::json::parse(fin);
+                    if (cache.value("version", 0) == ACTIVATION_CACHE_VERSION)
+                    {
+                        return cache;
+                    }
+                }
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Could not read activation cache " << path << ": " << e.what();
+            }
+            return nullptr;
+        }
+
+        void write_activation_cache(const fs::u8path& path, const nlohmann::json& cache)
+        {
+            try
+            {
+                fs::create_directories(path.parent_path());
+                // Replaced at once, so that concurrent shells read a complete file
+                auto tmp_file = TemporaryFile("mambaf", ".activation", path.parent_path());
+                {
+                    auto out = open_ofstream(tmp_file.path());
+                    out << cache.dump();
+                    if (!out.flush())
+                    {
+                        throw std::runtime_error("could not write " + tmp_file.path().string());
+                    }
+                }
+                fs::rename(tmp_file.path(), path);
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Could not write activation cache " << path << ": " << e.what();
+            }
+        }
+
+        std::vector<fs::u8path> to_paths(const nlohmann::json& j)
+        {
+            std::vector<fs::u8path> paths;
+            for (const auto& p : j)
+            {
+                paths.emplace_back(p.get<std::string>());
+            }
+            return paths;
+        }
+
+        nlohmann::json to_json(const std::vector<fs::u8path>& paths)
+        {
+            auto j = nlohmann::json::array();
+            for (const auto& p : paths)
+            {
+                j.push_back(p.string());
+            }
+            return j;
+        }
+    }  // namespace
 
     /****************************
      * Activator implementation *
@@ -32,19 +230,79 @@ namespace mamba
 
     std::vector<fs::u8path> Activator::get_activate_scripts(const fs::u8path& prefix)
     {
-        fs::u8path script_dir = prefix / "etc" / "conda" / "activate.d";
-        std::vector<fs::u8path> result = filter_dir(script_dir, shell_extension());
-        std::sort(result.begin(), result.end());
-        return result;
+        return prefix_activation(prefix).activate_scripts;
     }
 
     std::vector<fs::u8path> Activator::get_deactivate_scripts(const fs::u8path& prefix)
     {
-        fs::u8path script_dir = prefix / "etc" / "conda" / "deactivate.d";
-        std::vector<fs::u8path> result = filter_dir(script_dir, shell_extension());
-        // reverse sort!
-        std::sort(result.begin(), result.end(), std::greater<fs::u8path>());
-        return result;
+        return prefix_activation(prefix).deactivate_scripts;
+    }
+
+    auto Activator::prefix_activation(const fs::u8path& prefix) -> const PrefixActivation&
+    {
+        const auto key = prefix.string();
+        if (auto it = m_prefix_activations.find(key); it != m_prefix_activations.end())
+        {
+            return it->second;
+        }
+
+        const auto extension = shell_extension();
+        auto& activation = m_prefix_activations[key];
+        if (!Context::instance().activation_cache)
+        {
+            activation.env_vars = compute_environment_vars(prefix);
+            activation.activate_scripts = compute_activate_scripts(prefix, extension);
+            activation.deactivate_scripts = compute_deactivate_scripts(prefix, extension);
+            return activation;
+        }
+
+        const auto cache_path = activation_cache_path(prefix);
+        // Taken before reading, so that concurrent changes invalidate what is stored
+        auto stamps = prefix_stamps(prefix);
+        auto cache = read_activation_cache(cache_path);
+        if (cache.is_null() || (cache.value("prefix", "") != key) || (cache["stamps"] != stamps))
+        {
+            cache = { { "version", ACTIVATION_CACHE_VERSION },
+                      { "prefix", key },
+                      { "stamps", std::move(stamps) },
+                      { "env_vars", compute_environment_vars(prefix) },
+                      { "scripts", nlohmann::json::object() } };
+        }
+        else
+        {
+            LOG_DEBUG << "Using activation of " << prefix << " cached in " << cache_path;
+        }
+
+        auto& scripts = cache["scripts"];
+        const bool missing_scripts = !scripts.contains(extension);
+        if (missing_scripts)
+        {
+            scripts[extension] = {
+                { "activate", to_json(compute_activate_scripts(prefix, extension)) },
+                { "deactivate", to_json(compute_deactivate_scripts(prefix, extension)) },
+            };
+        }
+
+        try
+        {
+            activation.env_vars = cache["env_vars"].get<decltype(activation.env_vars)>();
+            activation.activate_scripts = to_paths(scripts[extension]["activate"]);
+            activation.deactivate_scripts = to_paths(scripts[extension]["deactivate"]);
+        }
+        catch (const nlohmann::json::exception& e)
+        {
+            LOG_DEBUG << "Invalid activation cache " << cache_path << ": " << e.what();
+            activation.env_vars = compute_environment_vars(prefix);
+            activation.activate_scripts = compute_activate_scripts(prefix, extension);
+            activation.deactivate_scripts = compute_deactivate_scripts(prefix, extension);
+            return activation;
+        }
+
+        if (missing_scripts && fs::exists(prefix))
+        {
+            write_activation_cache(cache_path, cache);
+        }
+        return activation;
     }
 
     std::string Activator::get_default_env(const fs::u8path& prefix)
@@ -67,63 +325,7 @@ namespace mamba
     std::vector<std::pair<std::string, std::string>>
     Activator::get_environment_vars(const fs::u8path& prefix)
     {
-        fs::u8path env_vars_file = prefix / PREFIX_STATE_FILE;
-        fs::u8path pkg_env_var_dir = prefix / PACKAGE_ENV_VARS_DIR;
-
-        nlohmann::ordered_map<std::string, std::string> env_vars;
-
-        // # First get env vars from packages
-        auto env_var_files = filter_dir(pkg_env_var_dir, "");
-        std::sort(env_var_files.begin(), env_var_files.end());
-        for (auto& f : env_var_files)
-        {
-            auto fin = open_ifstream(f);
-            nlohmann::ordered_json j;
-            try
-            {
-                fin >> j;
-                for (auto it = j.begin(); it != j.end(); ++it)
-                {
-                    env_vars[to_upper(it.key())] = it.value();
-                }
-            }
-            catch (nlohmann::json::exception& error)
-            {
-                LOG_WARNING << "Could not read JSON at " << f << ": " << error.what();
-            }
-        }
-
-        // Then get env vars from environment specification
-        if (fs::exists(env_vars_file))
-        {
-            auto fin = open_ifstream(env_vars_file);
-            try
-            {
-                nlohmann::ordered_json j;
-                fin >> j;
-                if (j.contains("env_vars"))
-                {
-                    auto& prefix_state_env_vars = j["env_vars"];
-                    for (auto it = prefix_state_env_vars.begin(); it != prefix_state_env_vars.end();
-                         ++it)
-                    {
-                        if (env_vars.find(it.key()) != env_vars.end())
-                        {
-                            LOG_WARNING << "Duplicate env vars detected. Vars from the environment "
-                                        << "will overwrite those from packages";
-                            LOG_WARNING << "Variable " << it.key() << " duplicated";
-                        }
-                        env_vars[to_upper(it.key())] = it.value();
-                    }
-                }
-            }
-            catch (nlohmann::json::exception& error)
-            {
-                LOG_WARNING << "Could not read JSON at " << env_vars_file << ": " << error.what();
-            }
-        }
-        std::vector<std::pair<std::string, std::string>> res(env_vars.begin(), env_vars.end());
-        return res;
+        return prefix_activation(prefix).env_vars;
     }
 
     std::string Activator::get_prompt_modifier(
@@ -692,6 +894,34 @@ namespace mamba
         return script(build_activate(prefix));
     }
 
+    std::optional<std::map<std::string, std::string>>
+    Activator::activated_environment(const fs::u8path& prefix)
+    {
+        m_stack = false;
+        m_action = ActivationType::ACTIVATE;
+        const EnvironmentTransform envt = build_activate(prefix);
+        if (!envt.activate_scripts.empty() || !envt.deactivate_scripts.empty())
+        {
+            return std::nullopt;
+        }
+
+        // Same order as the activation scripts, prompt variables are not exported
+        std::map<std::string, std::string> env = m_env;
+        if (!envt.export_path.empty())
+        {
+            env["PATH"] = envt.export_path;
+        }
+        for (const std::string& uvar : envt.unset_vars)
+        {
+            env.erase(uvar);
+        }
+        for (const auto& [ekey, evar] : envt.export_vars)
+        {
+            env[ekey] = evar;
+        }
+        return env;
+    }
+
     std::string Activator::reactivate()
     {
         m_action = ActivationType::REACTIVATE;
@@ -86,6 +86,15 @@ namespace mamba
                 package_name = "";
             }
 
+            if (const auto parts = split_simple_url(cleaned_url))
+            {
+                scheme = parts->scheme;
+                host = parts->host;
+                port = "";
+                path = parts->path;
+                auth = "";
+                return;
+            }
             URLHandler handler(cleaned_url);
             scheme = handler.scheme();
             host = handler.host();
@@ -269,6 +278,10 @@ namespace mamba
         , m_token(token)
         , m_package_filename(package_filename)
     {
+        const auto location_hash = std::hash<std::string>()(m_location);
+        m_hash = location_hash
+                 ^ (std::hash<std::string>()(m_name) + 0x9e3779b9 + (location_hash << 6)
+                    + (location_hash >> 2));
     }
 
     const std::string& Channel::scheme() const
@@ -401,7 +414,8 @@ namespace mamba
 
     bool operator==(const Channel& lhs, const Channel& rhs)
     {
-        return lhs.location() == rhs.location() && lhs.name() == rhs.name();
+        return (lhs.m_hash == rhs.m_hash) && (lhs.location() == rhs.location())
+               && (lhs.name() == rhs.name());
     }
 
     bool operator!=(const Channel& lhs, const Channel& rhs)
@@ -495,7 +509,7 @@ namespace mamba
 
     Channel ChannelContext::from_name(const std::string& name)
     {
-        std::string tmp_stripped = name;
+        auto tmp_stripped = std::string_view(name);
         const auto& custom_channels = get_custom_channels();
         auto it_end = custom_channels.end();
         auto it = custom_channels.find(tmp_stripped);
@@ -587,40 +601,79 @@ namespace mamba
     }
 
 
-    const Channel& ChannelContext::make_channel(const std::string& value)
+    std::optional<Channel> ChannelContext::from_package_url(std::string_view url)
     {
-        auto res = m_channel_cache.find(value);
-        if (res == m_channel_cache.end())
+        // The package filename does not change the channel parsed from the rest of the url,
+        // as long as it holds no token, platform list, or anything curl would normalize.
+        const auto [directory, filename] = rsplit_once(url, '/');
+        if (!directory.has_value() || !is_package_file(filename) || contains(url, "/t/")
+            || !split_simple_url(url).has_value() || !split_simple_url(*directory).has_value())
         {
-            auto& ctx = Context::instance();
+            return std::nullopt;
+        }
 
-            auto chan = from_value(value);
-            if (!chan.token())
+        const Channel& dir_chan = make_channel(*directory);
+        auto chan = Channel(
+            dir_chan.scheme(),
+            dir_chan.location(),
+            dir_chan.name(),
+            dir_chan.canonical_name(),
+            dir_chan.auth(),
+            dir_chan.token(),
+            std::string(filename)
+        );
+        chan.m_platforms = dir_chan.platforms();
+        return { std::move(chan) };
+    }
+
+    Channel ChannelContext::make_uncached_channel(const std::string& value)
+    {
+        auto& ctx = Context::instance();
+
+        auto chan = from_value(value);
+        if (!chan.token())
+        {
+            const auto& with_channel = join_url(
+                chan.location(),
+                chan.name() == UNKNOWN_CHANNEL ? "" : chan.name()
+            );
+            const auto& without_channel = chan.location();
+            for (const auto& auth : { with_channel, without_channel })
             {
-                const auto& with_channel = join_url(
-                    chan.location(),
-                    chan.name() == UNKNOWN_CHANNEL ? "" : chan.name()
-                );
-                const auto& without_channel = chan.location();
-                for (const auto& auth : { with_channel, without_channel })
+                const auto info = ctx.find_authentication_info(auth);
+                if (info.has_value() && info->type == AuthenticationType::kCondaToken)
                 {
-                    auto it = ctx.authentication_info().find(auth);
-                    if (it != ctx.authentication_info().end()
-                        && it->second.type == AuthenticationType::kCondaToken)
-                    {
-                        chan.m_token = it->second.value;
-                        break;
-                    }
-                    else if (it != ctx.authentication_info().end() && it->second.type == AuthenticationType::kBasicHTTPAuthentication)
-                    {
-                        chan.m_auth = it->second.value;
-                        break;
-                    }
+                    chan.m_token = info->value;
+                    break;
+                }
+                else if (info.has_value()
+                         && info->type == AuthenticationType::kBasicHTTPAuthentication)
+                {
+                    chan.m_auth = info->value;
+                    break;
                 }
             }
-            res = m_channel_cache.insert(std::make_pair(value, std::move(chan))).first;
         }
-        return res->second;
+        return chan;
+    }
+
+    const Channel& ChannelContext::make_channel(std::string_view value)
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_channel_cache_mutex);
+        if (const auto it = m_channel_cache.find(value); it != m_channel_cache.end())
+        {
+            return it->second->channel;
+        }
+
+        auto str_value = std::string(value);
+        auto pkg_chan = from_package_url(value);
+        auto chan = pkg_chan.has_value() ? std::move(pkg_chan).value()
+                                         : make_uncached_channel(str_value);
+        auto entry = std::make_unique<CachedChannel>(
+            CachedChannel{ std::move(str_value), std::move(chan) }
+        );
+        const auto key = std::string_view(entry->value);
+        return m_channel_cache.emplace(key, std::move(entry)).first->second->channel;
     }
 
     std::vector<const Channel*>
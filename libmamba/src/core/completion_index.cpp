@@ -0,0 +1,185 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/completion_index.hpp"
+#include "mamba/core/context.hpp"
+#include "mamba/core/environment.hpp"
+#include "mamba/core/environments_manager.hpp"
+#include "mamba/core/output.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/util.hpp"
+#include "solv-cpp/pool.hpp"
+#include "solv-cpp/solvable.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        /** Bump when the content of the file changes. */
+        constexpr int completion_index_version = 1;
+    }
+
+    auto CompletionIndex::default_path() -> fs::u8path
+    {
+        return env::user_cache_dir() / "mamba" / "completion.json";
+    }
+
+    auto CompletionIndex::read(const fs::u8path& path) -> std::optional<CompletionIndex>
+    {
+        try
+        {
+            if (!fs::exists(path))
+            {
+                return std::nullopt;
+            }
+            auto in = open_ifstream(path);
+            const auto j = nlohmann::json::parse(in);
+            if (j.at("version") != completion_index_version)
+            {
+                return std::nullopt;
+            }
+            auto out = CompletionIndex();
+            for (const auto& dir : j.at("envs_dirs"))
+            {
+                out.m_envs_dirs.emplace_back(dir.get<std::string>());
+            }
+            out.m_package_names = j.at("package_names").get<std::vector<std::string>>();
+            return { std::move(out) };
+        }
+        catch (const std::exception& e)
+        {
+            LOG_DEBUG << "Invalid completion index " << path << ": " << e.what();
+            return std::nullopt;
+        }
+    }
+
+    auto CompletionIndex::envs_dirs() const -> const std::vector<fs::u8path>&
+    {
+        return m_envs_dirs;
+    }
+
+    auto CompletionIndex::env_names() const -> std::vector<std::string>
+    {
+        auto out = std::vector<std::string>();
+        auto manager = EnvironmentsManager();
+        for (const auto& dir : m_envs_dirs)
+        {
+            for (const auto& prefix : manager.list_envs_dir_prefixes(dir))
+            {
+                out.push_back(prefix.filename().string());
+            }
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+        return out;
+    }
+
+    auto CompletionIndex::package_names() const -> const std::vector<std::string>&
+    {
+        return m_package_names;
+    }
+
+    auto CompletionIndex::set_envs_dirs(std::vector<fs::u8path> dirs) -> bool
+    {
+        if (dirs == m_envs_dirs)
+        {
+            return false;
+        }
+        m_envs_dirs = std::move(dirs);
+        return true;
+    }
+
+    auto CompletionIndex::add_package_names(const MPool& pool) -> bool
+    {
+        // Solvables mostly share their names, which are deduplicated by id before making strings
+        const auto& spool = pool.pool();
+        auto name_ids = std::vector<solv::StringId>();
+        spool.for_each_solvable([&](solv::ObjSolvableViewConst s)
+                                { name_ids.push_back(s.raw()->name); });
+        std::sort(name_ids.begin(), name_ids.end());
+        name_ids.erase(std::unique(name_ids.begin(), name_ids.end()), name_ids.end());
+
+        auto names = std::vector<std::string>();
+        names.reserve(name_ids.size());
+        for (const auto id : name_ids)
+        {
+            names.emplace_back(spool.get_string(id));
+        }
+        std::sort(names.begin(), names.end());
+
+        auto merged = std::vector<std::string>();
+        merged.reserve(m_package_names.size() + names.size());
+        std::set_union(
+            m_package_names.cbegin(),
+            m_package_names.cend(),
+            names.cbegin(),
+            names.cend(),
+            std::back_inserter(merged)
+        );
+        if (merged.size() == m_package_names.size())
+        {
+            return false;
+        }
+        m_package_names = std::move(merged);
+        return true;
+    }
+
+    void CompletionIndex::write(const fs::u8path& path) const
+    {
+        try
+        {
+            auto envs_dirs = nlohmann::json::array();
+            for (const auto& dir : m_envs_dirs)
+            {
+                envs_dirs.push_back(dir.string());
+            }
+            const auto j = nlohmann::json{
+                { "version", completion_index_version },
+                { "envs_dirs", std::move(envs_dirs) },
+                { "package_names", m_package_names },
+            };
+
+            fs::create_directories(path.parent_path());
+            // Replaced at once, so that a completion never reads a partial file
+            auto tmp_file = TemporaryFile("mambaf", ".completion", path.parent_path());
+            {
+                auto out = open_ofstream(tmp_file.path());
+                out << j.dump();
+                if (!out.flush())
+                {
+                    throw std::runtime_error("could not write " + tmp_file.path().string());
+                }
+            }
+            fs::rename(tmp_file.path(), path);
+        }
+        catch (const std::exception& e)
+        {
+            LOG_DEBUG << "Could not write completion index " << path << ": " << e.what();
+        }
+    }
+
+    void update_completion_index(const MPool* pool)
+    {
+        const auto path = CompletionIndex::default_path();
+        auto index = CompletionIndex::read(path).value_or(CompletionIndex());
+        bool changed = index.set_envs_dirs(Context::instance().envs_dirs);
+        if (pool != nullptr)
+        {
+            changed = index.add_package_names(*pool) || changed;
+        }
+        if (changed)
+        {
+            index.write(path);
+        }
+    }
+}
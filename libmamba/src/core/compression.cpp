@@ -13,10 +13,10 @@ namespace mamba
     size_t ZstdStream::write(char* in, size_t size)
     {
         ZSTD_inBuffer input = { in, size, 0 };
-        ZSTD_outBuffer output = { buffer, BUFFER_SIZE, 0 };
 
-        while (input.pos < input.size)
+        while (true)
         {
+            ZSTD_outBuffer output = { buffer.data(), buffer.size(), m_buffered };
             auto ret = ZSTD_decompressStream(stream, &output, &input);
             if (ZSTD_isError(ret))
             {
@@ -25,31 +25,38 @@ namespace mamba
                 spdlog::error("ZSTD decompression error: {}", ZSTD_getErrorName(ret));
                 return size + 1;
             }
-            if (output.pos > 0)
+            m_buffered = output.pos;
+            // A full buffer may leave decompressed data in the stream, even without input left
+            const bool full = (m_buffered == buffer.size());
+            if (full && !flush())
             {
-                size_t wcb_res = m_write_callback(buffer, 1, output.pos, m_write_callback_data);
-                if (wcb_res != output.pos)
-                {
-                    return size + 1;
-                }
-                output.pos = 0;
+                return size + 1;
+            }
+            if (!full && (input.pos == input.size))
+            {
+                return size;
             }
         }
-        return size;
+    }
+
+    bool ZstdStream::flush()
+    {
+        const bool ok = (m_buffered == 0) || m_sink(buffer.data(), m_buffered);
+        m_buffered = 0;
+        return ok;
     }
 
     size_t Bzip2Stream::write(char* in, size_t size)
     {
-        bz_stream* stream = static_cast<bz_stream*>(m_write_callback_data);
-        stream->next_in = in;
-        stream->avail_in = static_cast<unsigned int>(size);
+        m_stream.next_in = in;
+        m_stream.avail_in = static_cast<unsigned int>(size);
 
-        while (stream->avail_in > 0)
+        while (!m_ended)
         {
-            stream->next_out = buffer;
-            stream->avail_out = Bzip2Stream::BUFFER_SIZE;
+            m_stream.next_out = buffer.data() + m_buffered;
+            m_stream.avail_out = static_cast<unsigned int>(buffer.size() - m_buffered);
 
-            int ret = BZ2_bzDecompress(stream);
+            int ret = BZ2_bzDecompress(&m_stream);
             if (ret != BZ_OK && ret != BZ_STREAM_END)
             {
                 // This is temporary...
@@ -57,19 +64,26 @@ namespace mamba
                 spdlog::error("Bzip2 decompression error: {}", ret);
                 return size + 1;
             }
-
-            size_t wcb_res = m_write_callback(
-                buffer,
-                1,
-                BUFFER_SIZE - stream->avail_out,
-                m_write_callback_data
-            );
-            if (wcb_res != BUFFER_SIZE - stream->avail_out)
+            m_ended = (ret == BZ_STREAM_END);
+            m_buffered = buffer.size() - m_stream.avail_out;
+            const bool full = (m_buffered == buffer.size());
+            if (full && !flush())
             {
                 return size + 1;
             }
+            if (!full && (m_stream.avail_in == 0))
+            {
+                break;
+            }
         }
         return size;
     }
 
+    bool Bzip2Stream::flush()
+    {
+        const bool ok = (m_buffered == 0) || m_sink(buffer.data(), m_buffered);
+        m_buffered = 0;
+        return ok;
+    }
+
 }  // namespace mamba
@@ -7,20 +7,36 @@
 #ifndef MAMBA_COMPRESSION_HPP
 #define MAMBA_COMPRESSION_HPP
 
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
 #include <bzlib.h>
 #include <zstd.h>
 
-#include "curl.hpp"
-
 namespace mamba
 {
+    /** Receive decompressed data, returning false to abort the decompression. */
+    using DecompressionSink = std::function<bool(const char* data, std::size_t size)>;
+
+    /**
+     * Decompress zstd data written in pieces, such as received by curl.
+     *
+     * The decompressed data is gathered in a buffer reused for the whole stream, handed to the
+     * sink once full, and on ``flush`` after the last piece.
+     */
     struct ZstdStream
     {
-        static constexpr size_t BUFFER_SIZE = 256000;
-        ZstdStream(curl_write_callback lwrite_callback, void* write_callback_data)
+        /** A few times the size of the blocks the decompression outputs at once. */
+        static size_t buffer_size()
+        {
+            return 8 * ZSTD_DStreamOutSize();
+        }
+
+        explicit ZstdStream(DecompressionSink sink)
             : stream(ZSTD_createDCtx())
-            , m_write_callback(lwrite_callback)
-            , m_write_callback_data(write_callback_data)
+            , buffer(buffer_size())
+            , m_sink(std::move(sink))
         {
             ZSTD_initDStream(stream);
         }
@@ -30,7 +46,12 @@ namespace mamba
             ZSTD_freeDCtx(stream);
         }
 
+        ZstdStream(const ZstdStream&) = delete;
+        ZstdStream& operator=(const ZstdStream&) = delete;
+
         size_t write(char* in, size_t size);
+        /** Hand the decompressed data still buffered to the sink. */
+        bool flush();
 
         static size_t write_callback(char* ptr, size_t size, size_t nmemb, void* self)
         {
@@ -38,20 +59,24 @@ namespace mamba
         }
 
         ZSTD_DCtx* stream;
-        char buffer[BUFFER_SIZE];
+        std::vector<char> buffer;
+        size_t m_buffered = 0;
 
-        // original curl callback
-        curl_write_callback m_write_callback;
-        void* m_write_callback_data;
+        DecompressionSink m_sink;
     };
 
+    /**
+     * Decompress bzip2 data written in pieces, such as received by curl.
+     *
+     * The decompressed data is buffered as for ``ZstdStream``.
+     */
     struct Bzip2Stream
     {
-        static constexpr size_t BUFFER_SIZE = 256000;
+        static constexpr size_t BUFFER_SIZE = 1 << 20;
 
-        Bzip2Stream(curl_write_callback lwrite_callback, void* write_callback_data)
-            : m_write_callback(lwrite_callback)
-            , m_write_callback_data(write_callback_data)
+        explicit Bzip2Stream(DecompressionSink sink)
+            : buffer(BUFFER_SIZE)
+            , m_sink(std::move(sink))
         {
             m_stream.bzalloc = nullptr;
             m_stream.bzfree = nullptr;
@@ -64,7 +89,12 @@ namespace mamba
             }
         }
 
+        Bzip2Stream(const Bzip2Stream&) = delete;
+        Bzip2Stream& operator=(const Bzip2Stream&) = delete;
+
         size_t write(char* in, size_t size);
+        /** Hand the decompressed data still buffered to the sink. */
+        bool flush();
 
         static size_t write_callback(char* ptr, size_t size, size_t nmemb, void* self)
         {
@@ -78,11 +108,11 @@ namespace mamba
 
         int error;
         bz_stream m_stream;
-        char buffer[BUFFER_SIZE];
+        std::vector<char> buffer;
+        size_t m_buffered = 0;
+        bool m_ended = false;
 
-        // original curl callback
-        curl_write_callback m_write_callback;
-        void* m_write_callback_data;
+        DecompressionSink m_sink;
     };
 
     inline size_t get_zstd_buff_out_size()
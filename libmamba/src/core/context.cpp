@@ -8,6 +8,7 @@
 
 #include <fmt/format.h>
 #include <fmt/ostream.h>
+#include <spdlog/async.h>
 #include <spdlog/pattern_formatter.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
@@ -24,40 +25,142 @@
 
 namespace mamba
 {
-    class Logger : public spdlog::logger
+    class Logger
     {
     public:
 
-        Logger(const std::string& name, const std::string& pattern, const std::string& eol);
+        virtual ~Logger() = default;
 
-        void dump_backtrace_no_guards();
+        virtual std::shared_ptr<spdlog::logger> get() = 0;
+        virtual void dump_backtrace_no_guards() = 0;
     };
 
-    Logger::Logger(const std::string& name, const std::string& pattern, const std::string& eol)
-        : spdlog::logger(name, std::make_shared<spdlog::sinks::stderr_color_sink_mt>())
+    namespace
     {
-        auto f = std::make_unique<spdlog::pattern_formatter>(
-            pattern,
-            spdlog::pattern_time_type::local,
-            eol
-        );
-        set_formatter(std::move(f));
-    }
+        // Queued messages of the asynchronous loggers, the producers blocking once it is full
+        constexpr std::size_t async_log_queue_size = 8192;
 
-    void Logger::dump_backtrace_no_guards()
-    {
-        using spdlog::details::log_msg;
-        if (tracer_.enabled())
+        class SyncLogger
+            : public spdlog::logger
+            , public Logger
+            , public std::enable_shared_from_this<SyncLogger>
         {
-            tracer_.foreach_pop(
-                [this](const log_msg& msg)
-                {
-                    if (this->should_log(msg.level))
+        public:
+
+            SyncLogger(const std::string& name, const std::string& pattern, const std::string& eol);
+
+            std::shared_ptr<spdlog::logger> get() override;
+            void dump_backtrace_no_guards() override;
+        };
+
+        SyncLogger::SyncLogger(
+            const std::string& name,
+            const std::string& pattern,
+            const std::string& eol
+        )
+            : spdlog::logger(name, std::make_shared<spdlog::sinks::stderr_color_sink_mt>())
+        {
+            auto f = std::make_unique<spdlog::pattern_formatter>(
+                pattern,
+                spdlog::pattern_time_type::local,
+                eol
+            );
+            set_formatter(std::move(f));
+        }
+
+        std::shared_ptr<spdlog::logger> SyncLogger::get()
+        {
+            return shared_from_this();
+        }
+
+        void SyncLogger::dump_backtrace_no_guards()
+        {
+            using spdlog::details::log_msg;
+            if (tracer_.enabled())
+            {
+                tracer_.foreach_pop(
+                    [this](const log_msg& msg)
                     {
-                        this->sink_it_(msg);
+                        if (this->should_log(msg.level))
+                        {
+                            this->sink_it_(msg);
+                        }
                     }
-                }
+                );
+            }
+        }
+
+        // Formats and writes the messages on the thread of the spdlog thread pool
+        class AsyncLogger : public Logger
+        {
+        public:
+
+            AsyncLogger(const std::string& name, const std::string& pattern, const std::string& eol);
+
+            std::shared_ptr<spdlog::logger> get() override;
+            void dump_backtrace_no_guards() override;
+
+        private:
+
+            std::shared_ptr<spdlog::async_logger> p_logger;
+        };
+
+        AsyncLogger::AsyncLogger(
+            const std::string& name,
+            const std::string& pattern,
+            const std::string& eol
+        )
+            : p_logger(std::make_shared<spdlog::async_logger>(
+                name,
+                std::make_shared<spdlog::sinks::stderr_color_sink_mt>(),
+                spdlog::thread_pool(),
+                spdlog::async_overflow_policy::block
+            ))
+        {
+            auto f = std::make_unique<spdlog::pattern_formatter>(
+                pattern,
+                spdlog::pattern_time_type::local,
+                eol
             );
+            p_logger->set_formatter(std::move(f));
+        }
+
+        std::shared_ptr<spdlog::logger> AsyncLogger::get()
+        {
+            return p_logger;
+        }
+
+        void AsyncLogger::dump_backtrace_no_guards()
+        {
+            // The backtrace of the final spdlog::async_logger is only reachable with its guards
+            p_logger->dump_backtrace();
+        }
+
+        std::shared_ptr<Logger> make_logger(
+            const std::string& name,
+            const std::string& pattern,
+            const std::string& eol,
+            bool async
+        )
+        {
+            if (async)
+            {
+                return std::make_shared<AsyncLogger>(name, pattern, eol);
+            }
+            return std::make_shared<SyncLogger>(name, pattern, eol);
+        }
+
+        // Replace the loggers, the level and backtrace being set by the caller
+        std::shared_ptr<Logger> set_loggers(const std::string& pattern, bool async)
+        {
+            auto l = make_logger("libmamba", pattern, "\n", async);
+            for (const auto* name : { "libcurl", "libsolv" })
+            {
+                spdlog::drop(name);
+                spdlog::register_logger(make_logger(name, pattern, "", async)->get());
+            }
+            spdlog::set_default_logger(l->get());
+            return l;
         }
     }
 
@@ -68,7 +171,7 @@ namespace mamba
 
     Context::Context()
     {
-        MainExecutor::instance().on_close(tasksync.synchronized([this] { logger->flush(); }));
+        MainExecutor::instance().on_close(tasksync.synchronized([this] { logger->get()->flush(); }));
 
         on_ci = bool(env::get("CI"));
         prefix_params.root_prefix = env::get("MAMBA_ROOT_PREFIX").value_or("");
@@ -100,26 +203,7 @@ namespace mamba
 
         set_default_signal_handler();
 
-        std::shared_ptr<spdlog::logger> l = std::make_shared<Logger>(
-            "libmamba",
-            output_params.log_pattern,
-            "\n"
-        );
-        std::shared_ptr<spdlog::logger> libcurl_logger = std::make_shared<Logger>(
-            "libcurl",
-            output_params.log_pattern,
-            ""
-        );
-        std::shared_ptr<spdlog::logger> libsolv_logger = std::make_shared<Logger>(
-            "libsolv",
-            output_params.log_pattern,
-            ""
-        );
-        spdlog::register_logger(libcurl_logger);
-        spdlog::register_logger(libsolv_logger);
-
-        spdlog::set_default_logger(l);
-        logger = std::dynamic_pointer_cast<Logger>(l);
+        logger = set_loggers(output_params.log_pattern, false);
         spdlog::set_level(convert_log_level(output_params.logging_level));
     }
 
@@ -165,13 +249,42 @@ namespace mamba
         spdlog::set_level(convert_log_level(level));
     }
 
+    void Context::enable_async_logging()
+    {
+        if (spdlog::thread_pool())
+        {
+            return;
+        }
+        logger->get()->flush();
+        spdlog::init_thread_pool(async_log_queue_size, 1);
+        logger = set_loggers(output_params.log_pattern, true);
+        spdlog::set_level(convert_log_level(output_params.logging_level));
+    }
+
     std::vector<std::string> Context::platforms()
     {
         return { platform, "noarch" };
     }
 
+    namespace
+    {
+        auto authentication_file() -> fs::u8path
+        {
+            return env::home_directory() / ".mamba" / "auth" / "authentication.json";
+        }
+
+        auto last_write_time(const fs::u8path& path) -> fs::file_time_type
+        {
+            std::error_code ec;
+            const auto time = fs::last_write_time(path, ec);
+            return ec ? fs::file_time_type() : time;
+        }
+    }
+
     std::map<std::string, AuthenticationInfo>& Context::authentication_info()
     {
+        // Also loaded from the threads downloading files
+        std::lock_guard<std::mutex> lock(m_authentication_info_mutex);
         if (!m_authentication_infos_loaded)
         {
             load_authentication_info();
@@ -179,6 +292,33 @@ namespace mamba
         return m_authentication_info;
     }
 
+    std::optional<AuthenticationInfo> Context::find_authentication_info(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(m_authentication_info_mutex);
+        if (!m_authentication_infos_loaded)
+        {
+            load_authentication_info();
+        }
+        const auto it = m_authentication_info.find(key);
+        if (it == m_authentication_info.end())
+        {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    bool Context::reload_authentication_info()
+    {
+        std::lock_guard<std::mutex> lock(m_authentication_info_mutex);
+        if (m_authentication_infos_loaded
+            && (last_write_time(authentication_file()) == m_authentication_file_time))
+        {
+            return false;
+        }
+        load_authentication_info();
+        return true;
+    }
+
     void Context::load_authentication_info()
     {
         auto& ctx = Context::instance();
@@ -219,7 +359,8 @@ namespace mamba
         }
 
         std::map<std::string, AuthenticationInfo> res;
-        fs::u8path auth_loc(mamba::env::home_directory() / ".mamba" / "auth" / "authentication.json");
+        fs::u8path auth_loc = authentication_file();
+        m_authentication_file_time = last_write_time(auth_loc);
         try
         {
             if (fs::exists(auth_loc))
@@ -313,28 +454,78 @@ namespace mamba
         PRINT_CTX(out, dry_run);
         PRINT_CTX(out, always_yes);
         PRINT_CTX(out, allow_softlinks);
+        PRINT_CTX(out, allow_reflinks);
+        PRINT_CTX(out, relocation_cache);
         PRINT_CTX(out, offline);
         PRINT_CTX(out, output_params.quiet);
         PRINT_CTX(out, src_params.no_rc);
         PRINT_CTX(out, src_params.no_env);
+        PRINT_CTX(out, src_params.rc_cache);
         PRINT_CTX(out, remote_fetch_params.ssl_no_revoke);
         PRINT_CTX(out, remote_fetch_params.ssl_verify);
         PRINT_CTX(out, remote_fetch_params.retry_timeout);
         PRINT_CTX(out, remote_fetch_params.retry_backoff);
         PRINT_CTX(out, remote_fetch_params.max_retries);
         PRINT_CTX(out, remote_fetch_params.connect_timeout_secs);
+        PRINT_CTX(out, remote_fetch_params.use_http2);
+        PRINT_CTX(out, remote_fetch_params.max_host_connections);
+        PRINT_CTX(out, remote_fetch_params.download_chunks);
+        PRINT_CTX(out, remote_fetch_params.download_chunk_threshold);
+        PRINT_CTX(out, remote_fetch_params.download_direct_write);
         PRINT_CTX(out, add_pip_as_python_dependency);
         PRINT_CTX(out, override_channels_enabled);
         PRINT_CTX(out, use_only_tar_bz2);
+        PRINT_CTX(out, experimental_repodata_parsing);
+        PRINT_CTX(out, background_solv_write);
+        PRINT_CTX(out, repodata_use_jlap);
+        PRINT_CTX(out, repodata_use_shards);
+        PRINT_CTX(out, repodata_use_index);
+        PRINT_CTX(out, repodata_subset_cache);
+        PRINT_CTX(out, repodata_stale_while_revalidate);
+        PRINT_CTX(out, repodata_shared_cache);
+        PRINT_CTX(out, repodata_as_of);
         PRINT_CTX(out, auto_activate_base);
+        PRINT_CTX(out, activation_cache);
+        PRINT_CTX(out, run_without_shell);
+        PRINT_CTX(out, static_shell_hook);
+        PRINT_CTX(out, virtual_packages_cache);
         PRINT_CTX(out, extra_safety_checks);
+        PRINT_CTX(out, verify_package_cache);
+        PRINT_CTX(out, verify_index_cache);
+        PRINT_CTX(out, pkgs_dirs_max_size);
+        PRINT_CTX(out, memory_budget);
+        PRINT_CTX(out, solver_cache);
+        PRINT_CTX(out, solver_minimal_change);
+        PRINT_CTX(out, solver_portfolio);
+        PRINT_CTX(out, prune_pool);
+        PRINT_CTX(out, explain_problems_timeout);
+        PRINT_CTX(out, explain_problems_max_nodes);
         PRINT_CTX(out, threads_params.download_threads);
+        PRINT_CTX(out, threads_params.max_download_threads);
+        PRINT_CTX(out, threads_params.link_threads);
+        PRINT_CTX(out, threads_params.compile_pyc_threads);
+        PRINT_CTX(out, threads_params.script_threads);
+        PRINT_CTX(out, extract_streaming);
+        PRINT_CTX(out, container_build);
+        PRINT_CTX(out, extract_dedup);
+        PRINT_CTX(out, link_while_downloading);
+        PRINT_CTX(out, prefetch_while_solving);
+        PRINT_CTX(out, pip_while_linking);
         PRINT_CTX(out, output_params.verbosity);
+        PRINT_CTX(out, output_params.log_async);
+        PRINT_CTX(out, output_params.trace_file);
+        PRINT_CTX(out, output_params.progress_events);
+        PRINT_CTX(out, graphics_params.progress_bar_max_refresh_rate);
         PRINT_CTX(out, channel_alias);
         out << "channel_priority: " << static_cast<int>(channel_priority) << '\n';
         PRINT_CTX_VEC(out, default_channels);
         PRINT_CTX_VEC(out, channels);
+        PRINT_CTX_VEC(out, package_cache_peers);
         PRINT_CTX_VEC(out, pinned_packages);
+        PRINT_CTX_VEC(out, exclude_files);
+        PRINT_CTX_VEC(out, repodata_exclude);
+        PRINT_CTX_VEC(out, repodata_exclude_licenses);
+        PRINT_CTX_VEC(out, repodata_exclude_track_features);
         PRINT_CTX(out, platform);
         out << ">>> END MAMBA CONTEXT <<< \n" << std::endl;
 #undef PRINT_CTX
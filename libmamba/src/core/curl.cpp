@@ -4,12 +4,16 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <iterator>
+
 // TODO remove all these includes later?
 #include <spdlog/spdlog.h>
 
 #include "mamba/core/environment.hpp"  // for NETRC env var
 #include "mamba/core/mamba_fs.hpp"     // for fs::exists
 #include "mamba/core/util.hpp"         // for hide_secrets
+#include "mamba/core/util_scope.hpp"
 
 #include "curl.hpp"
 
@@ -46,12 +50,14 @@ namespace mamba
             // it's just wrong curl_easy_setopt(m_handle, CURLOPT_TIMEOUT,
             // Context::instance().remote_fetch_params.read_timeout_secs);
 
-            // TODO while libcurl in conda now _has_ http2 support we need to fix mamba to
-            // work properly with it this includes:
+            // HTTP/2 is opted in by ``DownloadTarget`` since we still need to fix mamba to
+            // properly work with it by default, this includes:
             // - setting the cache stuff correctly
             // - fixing how the progress bar works
             curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
 
+            curl_easy_setopt(handle, CURLOPT_SHARE, unwrap(CURLShareHandle::instance()));
+
             if (set_low_speed_opt)
             {
                 curl_easy_setopt(handle, CURLOPT_LOW_SPEED_TIME, 60L);
@@ -127,6 +133,7 @@ namespace mamba
             const std::string& ssl_verify
         )
         {
+            global_init();
             auto handle = curl_easy_init();
 
             configure_curl_handle(
@@ -164,6 +171,57 @@ namespace mamba
                 return false;
             }
         }
+
+        tl::expected<ConnectionTimes, std::string> probe_connection(
+            const std::string& url,
+            const bool set_low_speed_opt,
+            const long connect_timeout_secs,
+            const bool set_ssl_no_revoke,
+            const std::optional<std::string>& proxy,
+            const std::string& ssl_verify
+        )
+        {
+            global_init();
+            auto handle = curl_easy_init();
+            auto cleanup = on_scope_exit([&] { curl_easy_cleanup(handle); });
+
+            configure_curl_handle(
+                handle,
+                url,
+                set_low_speed_opt,
+                connect_timeout_secs,
+                set_ssl_no_revoke,
+                proxy,
+                ssl_verify
+            );
+            curl_easy_setopt(handle, CURLOPT_NOBODY, 1L);
+            curl_easy_setopt(handle, CURLOPT_FRESH_CONNECT, 1L);
+            curl_easy_setopt(handle, CURLOPT_FORBID_REUSE, 1L);
+
+            if (const auto res = curl_easy_perform(handle); res != CURLE_OK)
+            {
+                return tl::unexpected(std::string(curl_easy_strerror(res)));
+            }
+
+            // Times are from the start of the request to the end of each step
+            double name_lookup = 0;
+            double connect = 0;
+            double app_connect = 0;
+            double start_transfer = 0;
+            auto out = ConnectionTimes();
+            curl_easy_getinfo(handle, CURLINFO_NAMELOOKUP_TIME, &name_lookup);
+            curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME, &connect);
+            curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME, &app_connect);
+            curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME, &start_transfer);
+            curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &out.http_status);
+
+            const double connected = std::max(connect, app_connect);
+            out.name_lookup = name_lookup;
+            out.connect = std::max(connect - name_lookup, 0.);
+            out.tls_handshake = (app_connect > 0) ? std::max(app_connect - connect, 0.) : 0.;
+            out.first_byte = std::max(start_transfer - connected, 0.);
+            return out;
+        }
     }
 
     /**************
@@ -181,12 +239,53 @@ namespace mamba
         return m_serious;
     }
 
+    /*******************
+     * CURLShareHandle *
+     *******************/
+
+    CURLShareHandle::CURLShareHandle()
+        : p_handle((curl::global_init(), curl_share_init()))
+    {
+        if (p_handle == nullptr)
+        {
+            throw curl_error("Could not initialize CURL share handle");
+        }
+        curl_share_setopt(p_handle, CURLSHOPT_LOCKFUNC, &CURLShareHandle::lock);
+        curl_share_setopt(p_handle, CURLSHOPT_UNLOCKFUNC, &CURLShareHandle::unlock);
+        curl_share_setopt(p_handle, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(p_handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(p_handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        // Connections are not shared since curl does not enforce the multi handle connection
+        // limits on a shared connection cache.
+    }
+
+    CURLShareHandle::~CURLShareHandle()
+    {
+        // Fails, leaving the handle, if some easy handles still use it
+        curl_share_cleanup(p_handle);
+    }
+
+    void CURLShareHandle::lock(CURL*, curl_lock_data data, curl_lock_access, void* self)
+    {
+        static_cast<CURLShareHandle*>(self)->m_mutexes[static_cast<std::size_t>(data)].lock();
+    }
+
+    void CURLShareHandle::unlock(CURL*, curl_lock_data data, void* self)
+    {
+        static_cast<CURLShareHandle*>(self)->m_mutexes[static_cast<std::size_t>(data)].unlock();
+    }
+
+    CURLSH* unwrap(const CURLShareHandle& h)
+    {
+        return h.p_handle;
+    }
+
     /**************
      * CURLHandle *
      **************/
 
     CURLHandle::CURLHandle()  //(const Context& ctx)
-        : m_handle(curl_easy_init())
+        : m_handle((curl::global_init(), curl_easy_init()))
         , m_result(CURLE_OK)
     {
         if (m_handle == nullptr)
@@ -200,11 +299,14 @@ namespace mamba
     }
 
     CURLHandle::CURLHandle(CURLHandle&& rhs)
-        : m_handle(std::move(rhs.m_handle))
-        , p_headers(std::move(rhs.p_headers))
+        : m_handle(std::exchange(rhs.m_handle, nullptr))
+        , m_result(rhs.m_result)
+        , p_headers(std::exchange(rhs.p_headers, nullptr))
+        , m_in_multi(std::exchange(rhs.m_in_multi, false))
     {
-        std::swap(m_errorbuffer, rhs.m_errorbuffer);
-        std::swap(m_result, rhs.m_result);
+        std::copy(std::begin(rhs.m_errorbuffer), std::end(rhs.m_errorbuffer), m_errorbuffer);
+        // The error buffer is set by address, it must follow the handle
+        curl_easy_setopt(m_handle, CURLOPT_ERRORBUFFER, m_errorbuffer);
     }
 
     CURLHandle& CURLHandle::operator=(CURLHandle&& rhs)
@@ -214,6 +316,9 @@ namespace mamba
         swap(m_result, rhs.m_result);
         swap(p_headers, rhs.p_headers);
         swap(m_errorbuffer, rhs.m_errorbuffer);
+        swap(m_in_multi, rhs.m_in_multi);
+        curl_easy_setopt(m_handle, CURLOPT_ERRORBUFFER, m_errorbuffer);
+        curl_easy_setopt(rhs.m_handle, CURLOPT_ERRORBUFFER, rhs.m_errorbuffer);
         return *this;
     }
 
@@ -223,6 +328,16 @@ namespace mamba
         curl_slist_free_all(p_headers);
     }
 
+    void CURLHandle::reset()
+    {
+        curl_easy_reset(m_handle);
+        curl_slist_free_all(p_headers);
+        p_headers = nullptr;
+        m_result = CURLE_OK;
+        m_errorbuffer[0] = '\0';
+        set_opt(CURLOPT_ERRORBUFFER, m_errorbuffer);
+    }
+
     // TODO Rework this after a logging solution is established in the mamba project
     const std::pair<std::string_view, CurlLogLevel> CURLHandle::get_ssl_backend_info()
     {
@@ -455,6 +570,51 @@ namespace mamba
         m_result = curl_easy_perform(m_handle);
     }
 
+    /******************
+     * CURLHandlePool *
+     ******************/
+
+    CURLHandlePool::CURLHandlePool(std::size_t max_size)
+        : m_max_size(max_size)
+    {
+    }
+
+    std::unique_ptr<CURLHandle> CURLHandlePool::acquire()
+    {
+        std::unique_ptr<CURLHandle> handle;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_handles.empty())
+            {
+                return std::make_unique<CURLHandle>();
+            }
+            handle = std::move(m_handles.back());
+            m_handles.pop_back();
+        }
+        handle->reset();
+        return handle;
+    }
+
+    void CURLHandlePool::release(std::unique_ptr<CURLHandle> handle)
+    {
+        // A handle still in a multi handle, after an error, is not reused by another
+        if ((handle == nullptr) || handle->m_in_multi)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_handles.size() < m_max_size)
+        {
+            m_handles.push_back(std::move(handle));
+        }
+    }
+
+    std::size_t CURLHandlePool::size() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_handles.size();
+    }
+
     CURL* unwrap(const CURLHandle& h)
     {
         return h.m_handle;
@@ -518,9 +678,13 @@ namespace mamba
      * CURLMultiHandle *
      *******************/
 
-    CURLMultiHandle::CURLMultiHandle(std::size_t max_parallel_downloads)
-        : p_handle(curl_multi_init())
+    CURLMultiHandle::CURLMultiHandle(
+        std::size_t max_parallel_downloads,
+        std::size_t max_host_connections
+    )
+        : p_handle((curl::global_init(), curl_multi_init()))
         , m_max_parallel_downloads(max_parallel_downloads)
+        , m_max_host_connections(max_host_connections)
     {
         if (p_handle == nullptr)
         {
@@ -531,8 +695,15 @@ namespace mamba
             curl_multi_setopt(
                 p_handle,
                 CURLMOPT_MAX_TOTAL_CONNECTIONS,
-                static_cast<int>(max_parallel_downloads)
+                static_cast<long>(max_parallel_downloads)
+            );
+            curl_multi_setopt(
+                p_handle,
+                CURLMOPT_MAX_HOST_CONNECTIONS,
+                static_cast<long>(max_host_connections)
             );
+            // Transfers to the same host share a single connection when using HTTP/2
+            curl_multi_setopt(p_handle, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
         }
     }
 
@@ -546,15 +717,18 @@ namespace mamba
     CURLMultiHandle::CURLMultiHandle(CURLMultiHandle&& rhs)
         : p_handle(rhs.p_handle)
         , m_max_parallel_downloads(rhs.m_max_parallel_downloads)
+        , m_max_host_connections(rhs.m_max_host_connections)
     {
         rhs.p_handle = nullptr;
         rhs.m_max_parallel_downloads = 0u;
+        rhs.m_max_host_connections = 0u;
     }
 
     CURLMultiHandle& CURLMultiHandle::operator=(CURLMultiHandle&& rhs)
     {
         std::swap(p_handle, rhs.p_handle);
         std::swap(m_max_parallel_downloads, rhs.m_max_parallel_downloads);
+        std::swap(m_max_host_connections, rhs.m_max_host_connections);
         return *this;
     }
 
@@ -568,11 +742,13 @@ namespace mamba
                 throw std::runtime_error(curl_multi_strerror(code));
             }
         }
+        h.m_in_multi = true;
     }
 
     void CURLMultiHandle::remove_handle(const CURLHandle& h)
     {
         curl_multi_remove_handle(p_handle, unwrap(h));
+        h.m_in_multi = false;
     }
 
     std::size_t CURLMultiHandle::perform()
@@ -7,10 +7,14 @@
 #ifndef MAMBA_CURL_HPP
 #define MAMBA_CURL_HPP
 
+#include <array>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 // TODO to be removed later and forward declare specific curl structs
 extern "C"
@@ -25,6 +29,14 @@ namespace mamba
 {
     namespace curl
     {
+        /**
+         * Initialize curl, once and before any handle is created.
+         *
+         * It is not done at startup because initializing the TLS library is slow, while many
+         * commands do not use the network.
+         */
+        void global_init();
+
         void configure_curl_handle(
             CURL* handle,
             const std::string& url,
@@ -43,6 +55,28 @@ namespace mamba
             const std::optional<std::string>& proxy,
             const std::string& ssl_verify
         );
+
+        /** The time spent in each step of a request, in seconds. */
+        struct ConnectionTimes
+        {
+            double name_lookup = 0;
+            double connect = 0;
+            /** Zero for plain HTTP. */
+            double tls_handshake = 0;
+            /** From the end of the connection to the first byte of the response. */
+            double first_byte = 0;
+            long http_status = 0;
+        };
+
+        /** Time a HEAD request of @p url on a new connection, or return the curl error. */
+        tl::expected<ConnectionTimes, std::string> probe_connection(
+            const std::string& url,
+            const bool set_low_speed_opt,
+            const long connect_timeout_secs,
+            const bool set_ssl_no_revoke,
+            const std::optional<std::string>& proxy,
+            const std::string& ssl_verify
+        );
     }
 
     enum class CurlLogLevel
@@ -64,6 +98,38 @@ namespace mamba
         bool m_serious;
     };
 
+    /**
+     * A curl share handle for the DNS cache and TLS sessions.
+     *
+     * All handles configured with ``configure_curl_handle`` use the process instance, so that
+     * new connections to a known host resume the TLS session rather than doing a full
+     * handshake.
+     */
+    class CURLShareHandle
+    {
+    public:
+
+        CURLShareHandle();
+        ~CURLShareHandle();
+
+        CURLShareHandle(const CURLShareHandle&) = delete;
+        CURLShareHandle& operator=(const CURLShareHandle&) = delete;
+        CURLShareHandle(CURLShareHandle&&) = delete;
+        CURLShareHandle& operator=(CURLShareHandle&&) = delete;
+
+        static CURLShareHandle& instance();
+
+    private:
+
+        static void lock(CURL*, curl_lock_data data, curl_lock_access, void* self);
+        static void unlock(CURL*, curl_lock_data data, void* self);
+
+        CURLSH* p_handle;
+        std::array<std::mutex, CURL_LOCK_DATA_LAST> m_mutexes;
+
+        friend CURLSH* unwrap(const CURLShareHandle&);
+    };
+
     class CURLHandle
     {
     public:
@@ -109,14 +175,54 @@ namespace mamba
         bool can_proceed();
         void perform();
 
+        /**
+         * Reset the options and headers, as a new handle.
+         *
+         * Unlike a new handle, it keeps its live connections and its DNS and TLS session caches.
+         */
+        void reset();
+
     private:
 
         CURL* m_handle;
         CURLcode m_result;  // Enum range from 0 to 99
         curl_slist* p_headers = nullptr;
         char m_errorbuffer[CURL_ERROR_SIZE];
+        /** Whether the handle was added to a multi handle, and not removed yet. */
+        mutable bool m_in_multi = false;
 
         friend CURL* unwrap(const CURLHandle&);
+        friend class CURLMultiHandle;
+        friend class CURLHandlePool;
+    };
+
+    /**
+     * Easy handles kept once their transfer is done, to be reused by the next transfers.
+     *
+     * Creating a handle for each of hundreds of package downloads discards its connections and
+     * caches each time.
+     * Handles are reset when reused, so that no option of a previous transfer leaks to the next.
+     */
+    class CURLHandlePool
+    {
+    public:
+
+        static CURLHandlePool& instance();
+
+        explicit CURLHandlePool(std::size_t max_size = 32);
+
+        /** A handle from the pool, reset, or a new handle if the pool is empty. */
+        std::unique_ptr<CURLHandle> acquire();
+        /** Keep @p handle for reuse, unless the pool is full or it is still in a multi handle. */
+        void release(std::unique_ptr<CURLHandle> handle);
+
+        std::size_t size() const;
+
+    private:
+
+        mutable std::mutex m_mutex;
+        std::vector<std::unique_ptr<CURLHandle>> m_handles;
+        std::size_t m_max_size;
     };
 
     bool operator==(const CURLHandle& lhs, const CURLHandle& rhs);
@@ -155,7 +261,15 @@ namespace mamba
 
         using response_type = std::optional<CURLMultiResponse>;
 
-        explicit CURLMultiHandle(std::size_t max_parallel_downloads);
+        /**
+         * @param max_parallel_downloads The maximum number of connections.
+         * @param max_host_connections The maximum number of connections to a single host,
+         *                             zero for no limit.
+         */
+        explicit CURLMultiHandle(
+            std::size_t max_parallel_downloads,
+            std::size_t max_host_connections = 0
+        );
         ~CURLMultiHandle();
 
         CURLMultiHandle(CURLMultiHandle&&);
@@ -173,6 +287,7 @@ namespace mamba
 
         CURLM* p_handle;
         std::size_t m_max_parallel_downloads = 5;
+        std::size_t m_max_host_connections = 0;
     };
 
     template <class T>
@@ -0,0 +1,232 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mamba/core/util.hpp"
+
+#include "download_file.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        // Multiples of the page size, as expected by the disks and the page cache
+        constexpr std::size_t buffer_alignment = 4096;
+        constexpr std::size_t buffer_size = 1 << 20;
+    }
+
+    void DownloadFile::BufferDeleter::operator()(char* buffer) const
+    {
+        std::free(buffer);
+    }
+
+    DownloadFile::DownloadFile(bool direct)
+#ifdef _WIN32
+        : m_direct(false)
+#else
+        : m_direct(direct)
+#endif
+    {
+    }
+
+    DownloadFile::~DownloadFile()
+    {
+#ifndef _WIN32
+        if (m_fd >= 0)
+        {
+            flush();
+            ::close(m_fd);
+        }
+#endif
+    }
+
+    bool DownloadFile::create(const fs::u8path& path, std::size_t expected_size)
+    {
+        if (!m_direct)
+        {
+            m_stream = open_ofstream(path, std::ios::binary);
+            return static_cast<bool>(m_stream);
+        }
+#ifndef _WIN32
+        if (!open_direct(path, O_CREAT | O_TRUNC))
+        {
+            return false;
+        }
+#ifdef __linux__
+        // Reserve the space without changing the size, so that an interrupted download
+        // can still be resumed from the size of the file
+        if (expected_size > 0)
+        {
+            m_preallocated = ::fallocate(
+                                 m_fd,
+                                 FALLOC_FL_KEEP_SIZE,
+                                 0,
+                                 static_cast<off_t>(expected_size)
+                             )
+                             == 0;
+        }
+#else
+        (void) expected_size;
+#endif
+#endif
+        return true;
+    }
+
+    bool DownloadFile::append(const fs::u8path& path)
+    {
+        if (!m_direct)
+        {
+            m_stream = open_ofstream(path, std::ios::binary | std::ios::app);
+            return static_cast<bool>(m_stream);
+        }
+#ifndef _WIN32
+        if (!open_direct(path, 0))
+        {
+            return false;
+        }
+        struct stat st;
+        if (::fstat(m_fd, &st) != 0)
+        {
+            return false;
+        }
+        m_position = static_cast<std::size_t>(st.st_size);
+#endif
+        return true;
+    }
+
+    bool DownloadFile::open_at(const fs::u8path& path, std::size_t offset)
+    {
+        if (!m_direct)
+        {
+            m_stream = open_ofstream(path, std::ios::binary | std::ios::in | std::ios::out);
+            m_stream.seekp(static_cast<std::streamoff>(offset));
+            return static_cast<bool>(m_stream);
+        }
+        if (!open_direct(path, 0))
+        {
+            return false;
+        }
+        m_position = offset;
+        return true;
+    }
+
+    bool DownloadFile::is_open() const
+    {
+        return m_direct ? (m_fd >= 0) : m_stream.is_open();
+    }
+
+    bool DownloadFile::write(const char* data, std::size_t size)
+    {
+        if (!m_direct)
+        {
+            m_stream.write(data, static_cast<std::streamsize>(size));
+            return static_cast<bool>(m_stream);
+        }
+        while (size > 0)
+        {
+            const auto n = std::min(size, buffer_size - m_buffered);
+            std::memcpy(m_buffer.get() + m_buffered, data, n);
+            m_buffered += n;
+            data += n;
+            size -= n;
+            if ((m_buffered == buffer_size) && !flush())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool DownloadFile::close()
+    {
+        if (!m_direct)
+        {
+            m_stream.close();
+            return !m_stream.fail();
+        }
+        bool ok = true;
+#ifndef _WIN32
+        if (m_fd < 0)
+        {
+            return true;
+        }
+        ok = flush();
+        // Release the space preallocated beyond the data
+        if (m_preallocated)
+        {
+            ok = (::ftruncate(m_fd, static_cast<off_t>(m_position)) == 0) && ok;
+        }
+        ok = (::fsync(m_fd) == 0) && ok;
+        ok = (::close(m_fd) == 0) && ok;
+        m_fd = -1;
+#endif
+        return ok;
+    }
+
+    bool DownloadFile::open_direct(const fs::u8path& path, int flags)
+    {
+#ifndef _WIN32
+        m_fd = ::open(path.string().c_str(), O_WRONLY | O_CLOEXEC | flags, 0666);
+        if (m_fd < 0)
+        {
+            return false;
+        }
+        if (!m_buffer)
+        {
+            void* buffer = nullptr;
+            if (const int err = ::posix_memalign(&buffer, buffer_alignment, buffer_size); err != 0)
+            {
+                errno = err;
+                return false;
+            }
+            m_buffer.reset(static_cast<char*>(buffer));
+        }
+        return true;
+#else
+        (void) path;
+        (void) flags;
+        return false;
+#endif
+    }
+
+    bool DownloadFile::flush()
+    {
+#ifndef _WIN32
+        std::size_t written = 0;
+        while (written < m_buffered)
+        {
+            const auto n = ::pwrite(
+                m_fd,
+                m_buffer.get() + written,
+                m_buffered - written,
+                static_cast<off_t>(m_position + written)
+            );
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            written += static_cast<std::size_t>(n);
+        }
+        m_position += m_buffered;
+        m_buffered = 0;
+#endif
+        return true;
+    }
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_DOWNLOAD_FILE_HPP
+#define MAMBA_CORE_DOWNLOAD_FILE_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <memory>
+
+#include "mamba/core/mamba_fs.hpp"
+
+namespace mamba
+{
+    /**
+     * The file a download is written to.
+     *
+     * By default, the data is written through a ``std::ofstream``.
+     * With direct writes, the data is copied to a large page aligned buffer written to the file
+     * descriptor once full, the space of a new file is preallocated from its expected size, and
+     * the file is synced to the disk once when closed.
+     * Direct writes are only available on POSIX systems, the stream is used elsewhere.
+     */
+    class DownloadFile
+    {
+    public:
+
+        explicit DownloadFile(bool direct);
+        ~DownloadFile();
+
+        DownloadFile(const DownloadFile&) = delete;
+        DownloadFile& operator=(const DownloadFile&) = delete;
+
+        /** Create or truncate the file, preallocating ``expected_size`` bytes if not 0. */
+        bool create(const fs::u8path& path, std::size_t expected_size);
+        /** Write at the end of an existing file. */
+        bool append(const fs::u8path& path);
+        /** Write from ``offset`` in an existing file, keeping the rest of it. */
+        bool open_at(const fs::u8path& path, std::size_t offset);
+
+        bool is_open() const;
+        bool write(const char* data, std::size_t size);
+
+        /**
+         * Write the buffered data and close the file, syncing it with direct writes.
+         *
+         * Destroying an open file writes the buffered data without syncing.
+         */
+        bool close();
+
+    private:
+
+        struct BufferDeleter
+        {
+            void operator()(char* buffer) const;
+        };
+
+        bool m_direct;
+        std::ofstream m_stream;
+
+        int m_fd = -1;
+        std::unique_ptr<char, BufferDeleter> m_buffer;
+        std::size_t m_buffered = 0;
+        std::size_t m_position = 0;
+        bool m_preallocated = false;
+
+        bool open_direct(const fs::u8path& path, int flags);
+        bool flush();
+    };
+}
+
+#endif
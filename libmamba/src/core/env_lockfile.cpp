@@ -4,14 +4,23 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
 #include <spdlog/spdlog.h>
 #include <yaml-cpp/yaml.h>
 
+#include "mamba/core/channel.hpp"
 #include "mamba/core/env_lockfile.hpp"
+#include "mamba/core/environment.hpp"
 #include "mamba/core/mamba_fs.hpp"
 #include "mamba/core/match_spec.hpp"
 #include "mamba/core/output.hpp"
+#include "mamba/core/util.hpp"
 #include "mamba/core/util_string.hpp"
+#include "mamba/core/validate.hpp"
 
 namespace mamba
 {
@@ -145,8 +154,29 @@ namespace mamba
             return metadata;
         }
 
-        tl::expected<EnvironmentLockFile, mamba_error>
-        read_environment_lockfile(ChannelContext& channel_context, const YAML::Node& lockfile_yaml)
+        bool is_selected(const EnvLockFileFilter& filter, const YAML::Node& package_node)
+        {
+            if (!filter.platform.empty()
+                && (package_node["platform"].as<std::string>() != filter.platform))
+            {
+                return false;
+            }
+            if (!filter.categories.empty())
+            {
+                const auto category = package_node["category"]
+                                          ? package_node["category"].as<std::string>()
+                                          : "main";
+                return std::find(filter.categories.cbegin(), filter.categories.cend(), category)
+                       != filter.categories.cend();
+            }
+            return true;
+        }
+
+        tl::expected<EnvironmentLockFile, mamba_error> read_environment_lockfile(
+            ChannelContext& channel_context,
+            const YAML::Node& lockfile_yaml,
+            const EnvLockFileFilter& filter
+        )
         {
             const auto& maybe_metadata = read_metadata(lockfile_yaml["metadata"]);
             if (!maybe_metadata)
@@ -159,6 +189,11 @@ namespace mamba
             std::vector<Package> packages;
             for (const auto& package_node : lockfile_yaml["package"])
             {
+                // Only the selected packages are converted, which is most of the parsing time
+                if (!is_selected(filter, package_node))
+                {
+                    continue;
+                }
                 if (auto maybe_package = read_package_info(channel_context, package_node))
                 {
                     packages.push_back(maybe_package.value());
@@ -173,20 +208,341 @@ namespace mamba
         }
     }
 
+    namespace
+    {
+        /** Bump when the format of the cached files changes. */
+        constexpr std::uint64_t lockfile_cache_version = 1;
+        constexpr std::string_view lockfile_cache_magic = "MAMBALOCK";
+        /** Parsed lockfiles kept, the least recently used are removed first. */
+        constexpr std::size_t lockfile_cache_max_entries = 16;
+
+        class CacheWriter
+        {
+        public:
+
+            void write(std::uint64_t val)
+            {
+                char bytes[sizeof(val)];
+                std::memcpy(bytes, &val, sizeof(val));
+                m_out.append(bytes, sizeof(val));
+            }
+
+            void write(std::string_view str)
+            {
+                write(static_cast<std::uint64_t>(str.size()));
+                m_out.append(str.data(), str.size());
+            }
+
+            void write(const std::vector<std::string>& strs)
+            {
+                write(static_cast<std::uint64_t>(strs.size()));
+                for (const auto& str : strs)
+                {
+                    write(str);
+                }
+            }
+
+            auto str() const -> const std::string&
+            {
+                return m_out;
+            }
+
+        private:
+
+            std::string m_out;
+        };
+
+        class CacheReader
+        {
+        public:
+
+            explicit CacheReader(std::string data)
+                : m_data(std::move(data))
+            {
+            }
+
+            auto read_int() -> std::uint64_t
+            {
+                std::uint64_t val = 0;
+                std::memcpy(&val, take(sizeof(val)).data(), sizeof(val));
+                return val;
+            }
+
+            auto read_str() -> std::string
+            {
+                return std::string(take(read_int()));
+            }
+
+            auto read_strs() -> std::vector<std::string>
+            {
+                auto out = std::vector<std::string>();
+                for (auto n = read_int(); n > 0; --n)
+                {
+                    out.push_back(read_str());
+                }
+                return out;
+            }
+
+        private:
+
+            std::string m_data;
+            std::size_t m_pos = 0;
+
+            auto take(std::uint64_t n) -> std::string_view
+            {
+                if (n > m_data.size() - m_pos)
+                {
+                    throw std::runtime_error("truncated file");
+                }
+                const auto out = std::string_view(m_data).substr(m_pos, n);
+                m_pos += n;
+                return out;
+            }
+        };
+
+        auto read_file(const fs::u8path& path) -> std::optional<std::string>
+        {
+            if (!fs::exists(path))
+            {
+                return std::nullopt;
+            }
+            std::stringstream buffer;
+            buffer << open_ifstream(path).rdbuf();
+            return { buffer.str() };
+        }
+
+        auto lockfile_cache_key(std::string_view content, const EnvLockFileFilter& filter)
+            -> std::string
+        {
+            auto hash = validation::HashStream::sha256();
+            hash.update(content.data(), content.size());
+            // Separators cannot appear in the platform and category names
+            hash.update("\n", 1);
+            hash.update(filter.platform.data(), filter.platform.size());
+            for (const auto& category : filter.categories)
+            {
+                hash.update("\n", 1);
+                hash.update(category.data(), category.size());
+            }
+            return hash.hex_digest();
+        }
+
+        auto load_cached_lockfile(const fs::u8path& path, ChannelContext& channel_context)
+            -> std::optional<EnvironmentLockFile>
+        {
+            try
+            {
+                auto data = read_file(path);
+                if (!data.has_value())
+                {
+                    return std::nullopt;
+                }
+                auto reader = CacheReader(std::move(data).value());
+                if ((reader.read_str() != lockfile_cache_magic)
+                    || (reader.read_int() != lockfile_cache_version))
+                {
+                    return std::nullopt;
+                }
+
+                auto metadata = EnvironmentLockFile::Meta();
+                for (auto n = reader.read_int(); n > 0; --n)
+                {
+                    auto platform = reader.read_str();
+                    metadata.content_hash.emplace(std::move(platform), reader.read_str());
+                }
+                for (auto n = reader.read_int(); n > 0; --n)
+                {
+                    auto channel = EnvironmentLockFile::Channel();
+                    channel.url = reader.read_str();
+                    channel.used_env_vars = reader.read_strs();
+                    metadata.channels.push_back(std::move(channel));
+                }
+                metadata.platforms = reader.read_strs();
+                metadata.sources = reader.read_strs();
+
+                auto packages = std::vector<EnvironmentLockFile::Package>(reader.read_int());
+                for (auto& package : packages)
+                {
+                    package.info = PackageInfo(reader.read_str());
+                    package.info.version = reader.read_str();
+                    package.info.md5 = reader.read_str();
+                    package.info.sha256 = reader.read_str();
+                    package.info.url = reader.read_str();
+                    package.info.fn = reader.read_str();
+                    package.info.build_string = reader.read_str();
+                    package.info.subdir = reader.read_str();
+                    package.info.depends = reader.read_strs();
+                    package.info.constrains = reader.read_strs();
+                    package.is_optional = reader.read_int() != 0;
+                    package.category = reader.read_str();
+                    package.manager = reader.read_str();
+                    package.platform = reader.read_str();
+                    // The channel name depends on the configuration, not only on the file
+                    const auto& url = package.info.url;
+                    package.info.channel = is_package_file(url)
+                                               ? channel_context.make_channel(url).canonical_name()
+                                               : MatchSpec{ url, channel_context }.channel;
+                }
+
+                // Used again, so removed last from the cache
+                std::error_code ec;
+                fs::last_write_time(path, fs::now{}, ec);
+                LOG_DEBUG << "Using environment lockfile cached in " << path;
+                return { EnvironmentLockFile{ std::move(metadata), std::move(packages) } };
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Could not read environment lockfile cache " << path << ": "
+                          << e.what();
+            }
+            return std::nullopt;
+        }
+
+        void prune_lockfile_cache(const fs::u8path& cache_dir)
+        {
+            auto entries = std::vector<std::pair<fs::file_time_type, fs::u8path>>();
+            for (const auto& entry : fs::directory_iterator(cache_dir))
+            {
+                if (entry.path().extension() == ".bin")
+                {
+                    entries.emplace_back(entry.last_write_time(), entry.path());
+                }
+            }
+            if (entries.size() <= lockfile_cache_max_entries)
+            {
+                return;
+            }
+            // Most recent first
+            std::sort(
+                entries.begin(),
+                entries.end(),
+                [](const auto& a, const auto& b) { return a.first > b.first; }
+            );
+            for (std::size_t i = lockfile_cache_max_entries; i < entries.size(); ++i)
+            {
+                std::error_code ec;
+                fs::remove(entries[i].second, ec);
+            }
+        }
+
+        void store_cached_lockfile(const fs::u8path& path, const EnvironmentLockFile& lockfile)
+        {
+            try
+            {
+                auto writer = CacheWriter();
+                writer.write(lockfile_cache_magic);
+                writer.write(lockfile_cache_version);
+
+                const auto& metadata = lockfile.get_metadata();
+                writer.write(static_cast<std::uint64_t>(metadata.content_hash.size()));
+                for (const auto& [platform, hash] : metadata.content_hash)
+                {
+                    writer.write(platform);
+                    writer.write(hash);
+                }
+                writer.write(static_cast<std::uint64_t>(metadata.channels.size()));
+                for (const auto& channel : metadata.channels)
+                {
+                    writer.write(channel.url);
+                    writer.write(channel.used_env_vars);
+                }
+                writer.write(metadata.platforms);
+                writer.write(metadata.sources);
+
+                writer.write(static_cast<std::uint64_t>(lockfile.get_all_packages().size()));
+                for (const auto& package : lockfile.get_all_packages())
+                {
+                    writer.write(package.info.name);
+                    writer.write(package.info.version);
+                    writer.write(package.info.md5);
+                    writer.write(package.info.sha256);
+                    writer.write(package.info.url);
+                    writer.write(package.info.fn);
+                    writer.write(package.info.build_string);
+                    writer.write(package.info.subdir);
+                    writer.write(package.info.depends);
+                    writer.write(package.info.constrains);
+                    writer.write(static_cast<std::uint64_t>(package.is_optional));
+                    writer.write(package.category);
+                    writer.write(package.manager);
+                    writer.write(package.platform);
+                }
+
+                fs::create_directories(path.parent_path());
+                // Replaced at once, so that concurrent runs read a complete file
+                auto tmp_file = TemporaryFile("mambaf", ".lockfile_cache", path.parent_path());
+                {
+                    auto out = open_ofstream(tmp_file.path());
+                    const auto& data = writer.str();
+                    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+                    if (!out.flush())
+                    {
+                        throw std::runtime_error("could not write " + tmp_file.path().string());
+                    }
+                }
+                fs::rename(tmp_file.path(), path);
+                prune_lockfile_cache(path.parent_path());
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Could not write environment lockfile cache " << path << ": "
+                          << e.what();
+            }
+        }
+    }
+
     tl::expected<EnvironmentLockFile, mamba_error>
     read_environment_lockfile(ChannelContext& channel_context, const fs::u8path& lockfile_location)
+    {
+        return read_environment_lockfile(channel_context, lockfile_location, {});
+    }
+
+    tl::expected<EnvironmentLockFile, mamba_error> read_environment_lockfile(
+        ChannelContext& channel_context,
+        const fs::u8path& lockfile_location,
+        const EnvLockFileFilter& filter,
+        const fs::u8path& cache_dir
+    )
     {
         const auto file_path = fs::absolute(lockfile_location);  // Having the complete path helps
                                                                  // with logging and error reports.
         try
         {
+            auto content = std::optional<std::string>();
+            auto cache_path = fs::u8path();
+            if (!cache_dir.empty())
+            {
+                content = read_file(file_path);
+                if (content.has_value())
+                {
+                    cache_path = cache_dir / (lockfile_cache_key(*content, filter) + ".bin");
+                    if (auto cached = load_cached_lockfile(cache_path, channel_context))
+                    {
+                        return std::move(cached).value();
+                    }
+                }
+            }
+
             // TODO: add fields validation here (using some schema validation tool)
-            const YAML::Node lockfile_content = YAML::LoadFile(file_path.string());
+            const YAML::Node lockfile_content = content.has_value()
+                                                    ? YAML::Load(*content)
+                                                    : YAML::LoadFile(file_path.string());
             const auto lockfile_version = lockfile_content["version"].as<int>();
             switch (lockfile_version)
             {
                 case 1:
-                    return env_lockfile_v1::read_environment_lockfile(channel_context, lockfile_content);
+                {
+                    auto lockfile = env_lockfile_v1::read_environment_lockfile(
+                        channel_context,
+                        lockfile_content,
+                        filter
+                    );
+                    if (lockfile.has_value() && !cache_path.empty())
+                    {
+                        store_cached_lockfile(cache_path, lockfile.value());
+                    }
+                    return lockfile;
+                }
 
                 default:
                 {
@@ -225,6 +581,11 @@ namespace mamba
         }
     }
 
+    fs::u8path env_lockfile_cache_dir()
+    {
+        return env::user_cache_dir() / "mamba" / "env_lockfiles";
+    }
+
     std::vector<PackageInfo> EnvironmentLockFile::get_packages_for(
         std::string_view category,
         std::string_view platform,
@@ -270,6 +270,22 @@ namespace mamba
             return maybe_home;
         }
 
+        fs::u8path user_cache_dir()
+        {
+#ifdef _WIN32
+            if (auto local_app_data = env::get("LOCALAPPDATA");
+                local_app_data && !local_app_data->empty())
+            {
+                return fs::u8path(local_app_data.value());
+            }
+#endif
+            if (auto xdg_cache = env::get("XDG_CACHE_HOME"); xdg_cache && !xdg_cache->empty())
+            {
+                return fs::u8path(xdg_cache.value());
+            }
+            return home_directory() / ".cache";
+        }
+
         fs::u8path expand_user(const fs::u8path& path)
         {
             auto p = path.string();
@@ -3,8 +3,10 @@
 // Distributed under the terms of the BSD 3-Clause License.
 //
 // The full license is in the file LICENSE, distributed with this software.
+#include <algorithm>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "mamba/core/context.hpp"
@@ -14,8 +16,50 @@
 #include "mamba/core/output.hpp"
 #include "mamba/core/util.hpp"
 
+#include "parallel.hpp"
+
 namespace mamba
 {
+    namespace
+    {
+        /** The number of threads used to probe ``n_candidates`` environments. */
+        auto probe_threads(std::size_t n_candidates) -> std::size_t
+        {
+            // Probing is mostly waiting on the file system, which may be a network storage
+            constexpr std::size_t min_candidates_per_thread = 8;
+
+            const auto hardware_threads = std::size_t(std::thread::hardware_concurrency());
+            return std::clamp<std::size_t>(
+                hardware_threads,
+                1,
+                std::max<std::size_t>(n_candidates / min_candidates_per_thread, 1)
+            );
+        }
+
+        /** The candidates that are conda environments, in the same order. */
+        template <typename Path>
+        auto find_conda_environments(const std::vector<Path>& candidates) -> std::vector<Path>
+        {
+            // Not a std::vector<bool>, which elements cannot be written concurrently
+            auto is_env = std::vector<char>(candidates.size(), false);
+            parallel_for(
+                candidates.size(),
+                probe_threads(candidates.size()),
+                [&](std::size_t i) { is_env[i] = is_conda_environment(candidates[i]); }
+            );
+
+            auto out = std::vector<Path>();
+            for (std::size_t i = 0; i < candidates.size(); ++i)
+            {
+                if (is_env[i])
+                {
+                    out.push_back(candidates[i]);
+                }
+            }
+            return out;
+        }
+    }
+
     bool is_conda_environment(const fs::u8path& prefix)
     {
         return fs::exists(prefix / PREFIX_MAGIC_FILE);
@@ -139,21 +183,31 @@ namespace mamba
         }
         for (auto& d : Context::instance().envs_dirs)
         {
-            if (fs::exists(d) && fs::is_directory(d))
+            for (auto& env_path : list_envs_dir_prefixes(d))
             {
-                for (auto& potential_env : fs::directory_iterator(d))
-                {
-                    if (is_conda_environment(potential_env))
-                    {
-                        all_env_paths.insert(potential_env);
-                    }
-                }
+                all_env_paths.insert(env_path);
             }
         }
         all_env_paths.insert(Context::instance().prefix_params.root_prefix);
         return all_env_paths;
     }
 
+    std::set<fs::u8path> EnvironmentsManager::list_envs_dir_prefixes(const fs::u8path& envs_dir)
+    {
+        if (!fs::exists(envs_dir) || !fs::is_directory(envs_dir))
+        {
+            return {};
+        }
+
+        auto candidates = std::vector<fs::u8path>();
+        for (auto& potential_env : fs::directory_iterator(envs_dir))
+        {
+            candidates.push_back(potential_env.path());
+        }
+        const auto envs = find_conda_environments(candidates);
+        return { envs.cbegin(), envs.cend() };
+    }
+
     std::set<std::string>
     EnvironmentsManager::clean_environments_txt(const fs::u8path& env_txt_file, const fs::u8path& location)
     {
@@ -175,15 +229,21 @@ namespace mamba
         }
 
         std::vector<std::string> lines = read_lines(env_txt_file);
+        const std::size_t n_lines = lines.size();
+        lines.erase(
+            std::remove_if(
+                lines.begin(),
+                lines.end(),
+                [&](const std::string& l) { return fs::u8path(l) == abs_loc; }
+            ),
+            lines.end()
+        );
         std::set<std::string> final_lines;
-        for (auto& l : lines)
+        for (auto& l : find_conda_environments(lines))
         {
-            if (l != abs_loc && is_conda_environment(l))
-            {
-                final_lines.insert(l);
-            }
+            final_lines.insert(std::move(l));
         }
-        if (final_lines.size() != lines.size())
+        if (final_lines.size() != n_lines)
         {
             std::ofstream out = open_ofstream(env_txt_file);
             for (auto& l : final_lines)
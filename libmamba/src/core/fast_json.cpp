@@ -0,0 +1,297 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <cstdint>
+#include <string>
+
+#ifdef LIBMAMBA_USE_SIMDJSON
+#include <simdjson.h>
+#endif
+
+#include "fast_json.hpp"
+
+namespace mamba::fast_json
+{
+#ifdef LIBMAMBA_USE_SIMDJSON
+
+    namespace
+    {
+        using simdjson::dom::element;
+        using simdjson::dom::element_type;
+
+        /** The same json as parsed by ``nlohmann::json``. */
+        auto to_nlohmann(element elem) -> nlohmann::json
+        {
+            switch (elem.type())
+            {
+                case element_type::ARRAY:
+                {
+                    auto out = nlohmann::json::array();
+                    const simdjson::dom::array array = elem.get_array().value_unsafe();
+                    for (auto item : array)
+                    {
+                        out.push_back(to_nlohmann(item));
+                    }
+                    return out;
+                }
+                case element_type::OBJECT:
+                {
+                    auto out = nlohmann::json::object();
+                    const simdjson::dom::object object = elem.get_object().value_unsafe();
+                    for (auto field : object)
+                    {
+                        // The last duplicated key wins, as in nlohmann::json
+                        out[std::string(field.key)] = to_nlohmann(field.value);
+                    }
+                    return out;
+                }
+                case element_type::INT64:
+                {
+                    // Non-negative integers are unsigned in nlohmann::json
+                    const auto n = elem.get_int64().value_unsafe();
+                    if (n >= 0)
+                    {
+                        return nlohmann::json(static_cast<std::uint64_t>(n));
+                    }
+                    return nlohmann::json(n);
+                }
+                case element_type::UINT64:
+                    return nlohmann::json(elem.get_uint64().value_unsafe());
+                case element_type::DOUBLE:
+                    return nlohmann::json(elem.get_double().value_unsafe());
+                case element_type::STRING:
+                    return nlohmann::json(std::string(elem.get_string().value_unsafe()));
+                case element_type::BOOL:
+                    return nlohmann::json(elem.get_bool().value_unsafe());
+                case element_type::NULL_VALUE:
+                    return nlohmann::json(nullptr);
+            }
+            return nlohmann::json(nullptr);
+        }
+
+        /** A parser per thread, keeping its buffers between the many small files read. */
+        auto local_parser() -> simdjson::dom::parser&
+        {
+            thread_local auto parser = simdjson::dom::parser();
+            return parser;
+        }
+
+        auto load(simdjson::dom::parser& parser, const fs::u8path& file) -> std::optional<element>
+        {
+            element doc;
+            if (parser.load(file.string()).get(doc) != simdjson::SUCCESS)
+            {
+                return std::nullopt;
+            }
+            return { doc };
+        }
+
+        /** A string field, empty if missing and nothing if it is not a string. */
+        auto string_field(simdjson::dom::object obj, std::string_view key)
+            -> std::optional<std::string_view>
+        {
+            element value;
+            if (obj.at_key(key).get(value) != simdjson::SUCCESS)
+            {
+                return { std::string_view() };
+            }
+            std::string_view out;
+            if (value.get_string().get(out) != simdjson::SUCCESS)
+            {
+                return std::nullopt;
+            }
+            return { out };
+        }
+
+        /** The mode from the first letter of a ``paths.json`` field, as in ``read_paths``. */
+        template <typename Mode>
+        auto mode_of(std::string_view str, char a, Mode mode_a, char b, Mode mode_b, Mode other)
+            -> Mode
+        {
+            if (str.empty())
+            {
+                return other;
+            }
+            return (str.front() == a) ? mode_a : ((str.front() == b) ? mode_b : other);
+        }
+
+        auto read_path(simdjson::dom::object jpath) -> std::optional<PathData>
+        {
+            auto p = PathData();
+
+            std::string_view path;
+            std::uint64_t size_in_bytes = 0;
+            if ((jpath["_path"].get_string().get(path) != simdjson::SUCCESS)
+                || (jpath["size_in_bytes"].get_uint64().get(size_in_bytes) != simdjson::SUCCESS))
+            {
+                return std::nullopt;
+            }
+            p.path = path;
+            p.size_in_bytes = static_cast<std::size_t>(size_in_bytes);
+
+            const auto file_mode = string_field(jpath, "file_mode");
+            const auto path_type = string_field(jpath, "path_type");
+            const auto sha256 = string_field(jpath, "sha256");
+            const auto prefix_placeholder = string_field(jpath, "prefix_placeholder");
+            if (!file_mode || !path_type || !sha256 || !prefix_placeholder)
+            {
+                return std::nullopt;
+            }
+            p.file_mode = mode_of(
+                *file_mode,
+                't',
+                FileMode::TEXT,
+                'b',
+                FileMode::BINARY,
+                FileMode::UNDEFINED
+            );
+            p.path_type = mode_of(
+                *path_type,
+                's',
+                PathType::SOFTLINK,
+                'h',
+                PathType::HARDLINK,
+                PathType::UNDEFINED
+            );
+            if (p.path_type != PathType::SOFTLINK)
+            {
+                p.sha256 = *sha256;
+            }
+            bool no_link = false;
+            p.no_link = (jpath["no_link"].get_bool().get(no_link) == simdjson::SUCCESS) && no_link;
+            p.prefix_placeholder = *prefix_placeholder;
+            return { std::move(p) };
+        }
+    }
+
+    auto enabled() -> bool
+    {
+        return true;
+    }
+
+    auto
+    read_object(const fs::u8path& file, const std::function<bool(std::string_view)>& keep_key)
+        -> std::optional<nlohmann::json>
+    {
+        const auto doc = load(local_parser(), file);
+        simdjson::dom::object obj;
+        if (!doc.has_value() || (doc->get_object().get(obj) != simdjson::SUCCESS))
+        {
+            return std::nullopt;
+        }
+        auto out = nlohmann::json::object();
+        for (auto field : obj)
+        {
+            if (keep_key(field.key))
+            {
+                out[std::string(field.key)] = to_nlohmann(field.value);
+            }
+        }
+        return { std::move(out) };
+    }
+
+    auto read_paths_json(const fs::u8path& file) -> std::optional<std::vector<PathData>>
+    {
+        const auto doc = load(local_parser(), file);
+        simdjson::dom::object obj;
+        std::uint64_t paths_version = 0;
+        if (!doc.has_value() || (doc->get_object().get(obj) != simdjson::SUCCESS)
+            || (obj["paths_version"].get_uint64().get(paths_version) != simdjson::SUCCESS)
+            || (paths_version != 1))
+        {
+            return std::nullopt;
+        }
+
+        auto out = std::vector<PathData>();
+        element paths;
+        if (obj.at_key("paths").get(paths) != simdjson::SUCCESS)
+        {
+            return { std::move(out) };
+        }
+        simdjson::dom::array paths_array;
+        if (paths.get_array().get(paths_array) != simdjson::SUCCESS)
+        {
+            return std::nullopt;
+        }
+        out.reserve(paths_array.size());
+        for (auto item : paths_array)
+        {
+            simdjson::dom::object jpath;
+            if (item.get_object().get(jpath) != simdjson::SUCCESS)
+            {
+                return std::nullopt;
+            }
+            auto p = read_path(jpath);
+            if (!p.has_value())
+            {
+                return std::nullopt;
+            }
+            out.push_back(std::move(p).value());
+        }
+        return { std::move(out) };
+    }
+
+    auto for_each_repodata_record(
+        const fs::u8path& file,
+        const std::function<void(std::string_view, nlohmann::json&&)>& on_record
+    ) -> bool
+    {
+        // Not the parser of the thread, which would keep the buffers of the large file
+        auto parser = simdjson::dom::parser();
+        const auto doc = load(parser, file);
+        simdjson::dom::object repodata;
+        if (!doc.has_value() || (doc->get_object().get(repodata) != simdjson::SUCCESS))
+        {
+            return false;
+        }
+        for (auto section : repodata)
+        {
+            simdjson::dom::object records;
+            if (((section.key != "packages") && (section.key != "packages.conda"))
+                || (section.value.get_object().get(records) != simdjson::SUCCESS))
+            {
+                continue;
+            }
+            for (auto record : records)
+            {
+                // Values that are not objects are skipped, as by the streaming parser
+                if (record.value.type() == element_type::OBJECT)
+                {
+                    on_record(record.key, to_nlohmann(record.value));
+                }
+            }
+        }
+        return true;
+    }
+
+#else
+
+    auto enabled() -> bool
+    {
+        return false;
+    }
+
+    auto read_object(const fs::u8path&, const std::function<bool(std::string_view)>&)
+        -> std::optional<nlohmann::json>
+    {
+        return std::nullopt;
+    }
+
+    auto read_paths_json(const fs::u8path&) -> std::optional<std::vector<PathData>>
+    {
+        return std::nullopt;
+    }
+
+    auto for_each_repodata_record(
+        const fs::u8path&,
+        const std::function<void(std::string_view, nlohmann::json&&)>&
+    ) -> bool
+    {
+        return false;
+    }
+
+#endif
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_FAST_JSON_HPP
+#define MAMBA_CORE_FAST_JSON_HPP
+
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/package_paths.hpp"
+
+/**
+ * Readers of json files on hot paths using simdjson, when built with ``ENABLE_SIMDJSON``.
+ *
+ * They are fast paths for valid files only.
+ * They return nothing when simdjson is not built in, or on any parse error or value they do
+ * not handle, in which case the file must be read again with ``nlohmann::json``.
+ * Errors are hence always reported by ``nlohmann::json``, the same way whichever the backend.
+ */
+namespace mamba::fast_json
+{
+    /** Whether libmamba is built with simdjson. */
+    [[nodiscard]] auto enabled() -> bool;
+
+    /**
+     * The top level keys of a json object file for which @p keep_key is true.
+     *
+     * This is the object parsed by ``nlohmann::json`` with a parser callback discarding the
+     * other keys.
+     */
+    [[nodiscard]] auto
+    read_object(const fs::u8path& file, const std::function<bool(std::string_view)>& keep_key)
+        -> std::optional<nlohmann::json>;
+
+    /** The paths of a ``paths.json`` file, as in ``read_paths``. */
+    [[nodiscard]] auto read_paths_json(const fs::u8path& file)
+        -> std::optional<std::vector<PathData>>;
+
+    /**
+     * Call @p on_record with the filename and json of every record of a ``repodata.json``.
+     *
+     * Records are those of the ``packages`` and ``packages.conda`` sections, in file order.
+     * The whole file is parsed before calling @p on_record, so that nothing is called when
+     * returning false.
+     */
+    [[nodiscard]] auto for_each_repodata_record(
+        const fs::u8path& file,
+        const std::function<void(std::string_view, nlohmann::json&&)>& on_record
+    ) -> bool;
+}
+
+#endif
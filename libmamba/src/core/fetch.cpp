@@ -4,20 +4,31 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <limits>
+#include <mutex>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 
+#include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 
 #include "mamba/core/context.hpp"
 #include "mamba/core/fetch.hpp"
+#include "mamba/core/metrics.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/thread_utils.hpp"
+#include "mamba/core/tracing.hpp"
 #include "mamba/core/url.hpp"
 #include "mamba/core/util_string.hpp"
 #include "mamba/version.hpp"
 
 #include "compression.hpp"
 #include "curl.hpp"
+#include "download_file.hpp"
 #include "progress_bar_impl.hpp"
 
 namespace mamba
@@ -59,6 +70,193 @@ namespace mamba
      * DownloadTarget implementation *
      *********************************/
 
+    namespace
+    {
+        /** The URLs of a file on the mirrors of its channel, the URL itself first. */
+        auto mirror_urls(const std::string& url) -> std::vector<std::string>
+        {
+            auto urls = std::vector<std::string>{ url };
+            for (const auto& [channel, mirrors] : Context::instance().channel_mirrors)
+            {
+                const auto prefix = concat(rstrip(channel, '/'), "/");
+                if (starts_with(url, prefix))
+                {
+                    const auto path = std::string_view(url).substr(prefix.size());
+                    for (const auto& mirror : mirrors)
+                    {
+                        urls.push_back(unc_url(concat(rstrip(mirror, '/'), "/", path)));
+                    }
+                    break;
+                }
+            }
+            return urls;
+        }
+
+        /** The host of a URL, with its port, as mirrors are told apart by. */
+        auto mirror_host(const std::string& url) -> std::string
+        {
+            const auto url_handler = URLHandler(url);
+            auto host = url_handler.host();
+            const auto port = url_handler.port();
+            if (port.size())
+            {
+                host += ":" + port;
+            }
+            return host;
+        }
+
+        /**
+         * The ``Authorization`` headers of the requests to each host, resolved once per process.
+         *
+         * A header rejected by a server is resolved again after reloading the authentication
+         * information, so that a refreshed bearer token is used by all the downloads.
+         */
+        class AuthorizationHeaders
+        {
+        public:
+
+            static auto instance() -> AuthorizationHeaders&
+            {
+                static auto headers = AuthorizationHeaders();
+                return headers;
+            }
+
+            /** The header of @p host, empty if its requests are not authorized by a header. */
+            auto get(const std::string& host) -> std::string
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                auto it = m_headers.find(host);
+                if (it == m_headers.end())
+                {
+                    it = m_headers.emplace(host, resolve(host)).first;
+                }
+                return it->second;
+            }
+
+            /** Another header than the one @p rejected by @p host, empty if there is none. */
+            auto refresh(const std::string& host, const std::string& rejected) -> std::string
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                auto& header = m_headers[host];
+                // Unless another download already refreshed it
+                if ((header == rejected) && Context::instance().reload_authentication_info())
+                {
+                    header = resolve(host);
+                }
+                return (header != rejected) ? header : std::string();
+            }
+
+        private:
+
+            std::mutex m_mutex;
+            std::unordered_map<std::string, std::string> m_headers;
+
+            static auto resolve(const std::string& host) -> std::string
+            {
+                // A copy, the information may be reloaded meanwhile by another download
+                const auto info = Context::instance().find_authentication_info(host);
+                if (info.has_value() && (info->type == AuthenticationType::kBearerToken))
+                {
+                    return fmt::format("Authorization: Bearer {}", info->value);
+                }
+                return {};
+            }
+        };
+
+        /** The file recording the validator of the data of a partial download. */
+        auto validator_filename(const std::string& partial_filename) -> std::string
+        {
+            return partial_filename + ".json";
+        }
+
+        /** The validator of a partial download of ``url``, empty if there is none. */
+        auto read_validator(const std::string& partial_filename, const std::string& url)
+            -> std::string
+        {
+            const auto file = validator_filename(partial_filename);
+            if (!fs::exists(file))
+            {
+                return {};
+            }
+            try
+            {
+                auto in = open_ifstream(file);
+                const auto j = nlohmann::json::parse(in);
+                if (j.at("url").get<std::string>() == url)
+                {
+                    return j.at("validator").get<std::string>();
+                }
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Invalid partial download validator " << file << ": " << e.what();
+            }
+            return {};
+        }
+
+        void write_validator(
+            const std::string& partial_filename,
+            const std::string& url,
+            const std::string& validator
+        )
+        {
+            const auto file = validator_filename(partial_filename);
+            auto ec = std::error_code();
+            if (validator.empty())
+            {
+                fs::remove(file, ec);
+                return;
+            }
+            auto out = open_ofstream(file);
+            out << nlohmann::json{ { "url", url }, { "validator", validator } }.dump();
+            if (!out.flush())
+            {
+                LOG_DEBUG << "Could not write partial download validator " << file;
+                out.close();
+                fs::remove(file, ec);
+            }
+        }
+
+        /**
+         * The validator for an ``If-Range`` header, from the headers of a response.
+         *
+         * Weak entity tags cannot be used to validate ranges.
+         */
+        auto range_validator(const std::string& etag, const std::string& mod) -> std::string
+        {
+            return (etag.empty() || starts_with(etag, "W/")) ? mod : etag;
+        }
+
+        void hash_file(validation::HashStream& hash, const std::string& filename)
+        {
+            auto in = open_ifstream(filename);
+            std::array<char, 1 << 16> buffer;
+            while (in.read(buffer.data(), buffer.size()) || (in.gcount() > 0))
+            {
+                hash.update(buffer.data(), static_cast<std::size_t>(in.gcount()));
+            }
+        }
+
+        /** The first byte of a ``Content-Range`` header such as ``bytes 100-999/1000``. */
+        auto parse_range_start(std::string_view content_range) -> std::optional<std::size_t>
+        {
+            constexpr std::string_view unit = "bytes ";
+            if (!starts_with(content_range, unit))
+            {
+                return std::nullopt;
+            }
+            content_range.remove_prefix(unit.size());
+            std::size_t start = 0;
+            const auto* const end = content_range.data() + content_range.size();
+            const auto [ptr, ec] = std::from_chars(content_range.data(), end, start);
+            if ((ec != std::errc()) || (ptr == end) || (*ptr != '-'))
+            {
+                return std::nullopt;
+            }
+            return start;
+        }
+    }
+
     DownloadTarget::DownloadTarget(const std::string& name, const std::string& url, const std::string& filename)
         : m_name(name)
         , m_filename(filename)
@@ -71,14 +269,31 @@ namespace mamba
         , m_retries(0)
         , m_has_progress_bar(false)
         , m_ignore_failure(false)
+        , m_resumable(false)
+        , m_resume_offset(0)
+        , p_parent(nullptr)
+        , m_chunk_start(0)
+        , m_chunk_size(0)
+        , m_range_refused(false)
     {
-        m_curl_handle = std::make_unique<CURLHandle>();
+        m_mirror_urls = mirror_urls(m_url);
+        m_mirror = 0;
+        m_failed_mirrors = 0;
+        m_curl_handle = CURLHandlePool::instance().acquire();
         init_curl_ssl();
         init_curl_target(m_url);
     }
 
     DownloadTarget::~DownloadTarget()
     {
+        try
+        {
+            CURLHandlePool::instance().release(std::move(m_curl_handle));
+        }
+        catch (const mamba_error&)
+        {
+            // The pool is already destroyed at exit, the handle is cleaned up with the target
+        }
     }
 
     int
@@ -194,12 +409,22 @@ namespace mamba
             ssl_verify
         );
 
+        if (Context::instance().remote_fetch_params.use_http2)
+        {
+            // Falls back to HTTP/1.1 for servers without HTTP/2 and for plain http
+            m_curl_handle->set_opt(CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+            // Wait for a connection to be multiplexed on rather than opening a new one
+            m_curl_handle->set_opt(CURLOPT_PIPEWAIT, 1L);
+        }
+
         m_curl_handle->set_opt(CURLOPT_HEADERFUNCTION, &DownloadTarget::header_callback);
         m_curl_handle->set_opt(CURLOPT_HEADERDATA, this);
 
         if (ends_with(url, ".json.zst"))
         {
-            m_zstd_stream = std::make_unique<ZstdStream>(&DownloadTarget::write_callback, this);
+            m_zstd_stream = std::make_unique<ZstdStream>(
+                [this](const char* data, std::size_t size) { return write_data(data, size); }
+            );
             if (ends_with(m_filename, ".zst"))
             {
                 m_filename = m_filename.substr(0, m_filename.size() - 4);
@@ -209,7 +434,9 @@ namespace mamba
         }
         else if (ends_with(url, ".json.bz2"))
         {
-            m_bzip2_stream = std::make_unique<Bzip2Stream>(&DownloadTarget::write_callback, this);
+            m_bzip2_stream = std::make_unique<Bzip2Stream>(
+                [this](const char* data, std::size_t size) { return write_data(data, size); }
+            );
             if (ends_with(m_filename, ".bz2"))
             {
                 m_filename = m_filename.substr(0, m_filename.size() - 4);
@@ -240,22 +467,10 @@ namespace mamba
         m_curl_handle->set_opt_header();
         m_curl_handle->set_opt(CURLOPT_VERBOSE, Context::instance().output_params.verbosity >= 2);
 
-        // get url host
-        const auto url_handler = URLHandler(url);
-        auto host = url_handler.host();
-        const auto port = url_handler.port();
-        if (port.size())
+        m_authorization = AuthorizationHeaders::instance().get(mirror_host(url));
+        if (!m_authorization.empty())
         {
-            host += ":" + port;
-        }
-
-        if (Context::instance().authentication_info().count(host))
-        {
-            const auto& auth = Context::instance().authentication_info().at(host);
-            if (auth.type == AuthenticationType::kBearerToken)
-            {
-                m_curl_handle->add_header(fmt::format("Authorization: Bearer {}", auth.value));
-            }
+            m_curl_handle->add_header(m_authorization);
         }
 
         auto logger = spdlog::get("libcurl");
@@ -265,35 +480,94 @@ namespace mamba
 
     bool DownloadTarget::can_retry()
     {
-        if (!m_curl_handle->can_proceed())
+        if (needs_fallback() || needs_new_authorization())
+        {
+            return true;
+        }
+        if (!m_curl_handle->can_proceed() || m_range_refused)
         {
             return false;
         }
 
-        return m_retries < size_t(Context::instance().remote_fetch_params.max_retries)
+        // Each mirror is tried at least once
+        const auto max_retries = static_cast<std::size_t>(
+                                     Context::instance().remote_fetch_params.max_retries
+                                 )
+                                 + m_mirror_urls.size() - 1;
+        return m_retries < max_retries
                && (m_http_status == 413 || m_http_status == 429 || m_http_status >= 500)
                && !starts_with(m_url, "file://");
     }
 
     bool DownloadTarget::retry()
     {
+        if (needs_fallback())
+        {
+            LOG_INFO << "'" << m_url << "' not found, downloading '" << m_fallback_url << "'";
+            m_url = std::exchange(m_fallback_url, std::string());
+            m_mirror_urls = mirror_urls(m_url);
+            m_mirror = 0;
+            m_failed_mirrors = 0;
+            m_file.reset();
+            m_zstd_stream.reset();
+            m_bzip2_stream.reset();
+            m_data_callback = nullptr;
+            if (m_hash)
+            {
+                m_hash->reset();
+            }
+            m_hex_digest.reset();
+            m_curl_handle->set_opt(CURLOPT_FAILONERROR, 0L);
+            reset_curl_target();
+            return true;
+        }
+        if (needs_new_authorization())
+        {
+            LOG_INFO << "Authorization rejected, downloading '" << m_url << "' with a new token";
+            m_authorization_refreshed = true;
+            m_file.reset();
+            if ((m_chunk_size == 0) && fs::exists(m_filename))
+            {
+                fs::remove(m_filename);
+            }
+            m_data_callback = nullptr;
+            if (m_hash)
+            {
+                m_hash->reset();
+            }
+            m_hex_digest.reset();
+            // Right away, with the new header
+            reset_curl_target();
+            return true;
+        }
+
         auto now = std::chrono::steady_clock::now();
-        if (now >= m_next_retry)
+        // Another mirror is tried right away, until all of them failed
+        const bool failover = (m_mirror_urls.size() > 1)
+                              && ((m_failed_mirrors + 1) % m_mirror_urls.size() != 0);
+        if (failover || (now >= m_next_retry))
         {
-            if (m_file.is_open())
+            // The data already written is kept for a resume
+            m_file.reset();
+            if (m_mirror_urls.size() > 1)
             {
-                m_file.close();
+                ++m_failed_mirrors;
+                m_mirror = (m_mirror + 1) % m_mirror_urls.size();
+                m_url = m_mirror_urls[m_mirror];
+                LOG_INFO << "Downloading '" << m_name << "' from mirror " << m_url;
             }
-            if (fs::exists(m_filename))
+            // Chunks share the file
+            if ((m_chunk_size == 0) && fs::exists(m_filename))
             {
                 fs::remove(m_filename);
             }
-            init_curl_target(m_url);
-            if (m_has_progress_bar)
+            m_data_callback = nullptr;
+            if (m_hash)
             {
-                m_curl_handle->set_opt(CURLOPT_XFERINFOFUNCTION, &DownloadTarget::progress_callback);
-                m_curl_handle->set_opt(CURLOPT_XFERINFODATA, this);
+                m_hash->reset();
             }
+            m_hex_digest.reset();
+            reset_curl_target();
             m_retry_wait_seconds = m_retry_wait_seconds
                                    * static_cast<std::size_t>(
                                        Context::instance().remote_fetch_params.retry_backoff
@@ -308,31 +582,56 @@ namespace mamba
         }
     }
 
+    void DownloadTarget::reset_curl_target()
+    {
+        // The headers are added again, for the host of the URL
+        m_curl_handle->reset_headers();
+        init_curl_target(m_url);
+        m_curl_handle->add_headers(m_conditional_headers);
+        if (m_resumable)
+        {
+            prepare_resume();
+        }
+        if (m_has_progress_bar)
+        {
+            m_curl_handle->set_opt(CURLOPT_XFERINFOFUNCTION, &DownloadTarget::progress_callback);
+            m_curl_handle->set_opt(CURLOPT_XFERINFODATA, this);
+        }
+    }
+
     size_t DownloadTarget::write_callback(char* ptr, size_t size, size_t nmemb, void* self)
     {
         auto* s = reinterpret_cast<DownloadTarget*>(self);
         auto expected_write_size = size * nmemb;
-        if (!s->m_file.is_open())
+        if (!s->write_data(ptr, expected_write_size))
         {
-            s->m_file = open_ofstream(s->m_filename, std::ios::binary);
-            if (!s->m_file)
-            {
-                LOG_ERROR << "Could not open file for download " << s->m_filename << ": "
-                          << strerror(errno);
-                // Return a size _different_ than the expected write size to signal an error
-                return expected_write_size + 1;
-            }
+            // Return a size _different_ than the expected write size to signal an error
+            return expected_write_size + 1;
         }
+        return expected_write_size;
+    }
 
-        s->m_file.write(ptr, static_cast<std::streamsize>(expected_write_size));
+    bool DownloadTarget::write_data(const char* data, std::size_t size)
+    {
+        if (!m_file && !open_file())
+        {
+            return false;
+        }
 
-        if (!s->m_file)
+        if (!m_file->write(data, size))
         {
-            LOG_ERROR << "Could not write to file " << s->m_filename << ": " << strerror(errno);
-            // Return a size _different_ than the expected write size to signal an error
-            return expected_write_size + 1;
+            LOG_ERROR << "Could not write to file " << m_filename << ": " << strerror(errno);
+            return false;
         }
-        return expected_write_size;
+        if (m_hash)
+        {
+            m_hash->update(data, size);
+        }
+        if (m_data_callback)
+        {
+            m_data_callback(data, size);
+        }
+        return true;
     }
 
     size_t DownloadTarget::header_callback(char* buffer, size_t size, size_t nitems, void* self)
@@ -340,6 +639,11 @@ namespace mamba
         auto* s = reinterpret_cast<DownloadTarget*>(self);
 
         std::string_view header(buffer, size * nitems);
+        if (starts_with(header, "HTTP/"))
+        {
+            // The headers of a new response, such as after a redirection
+            s->m_range_start.reset();
+        }
         auto colon_idx = header.find(':');
         if (colon_idx != std::string_view::npos)
         {
@@ -358,7 +662,11 @@ namespace mamba
 
             // http headers are case insensitive!
             std::string lkey = to_lower(key);
-            if (lkey == "etag")
+            if (lkey == "content-range")
+            {
+                s->m_range_start = parse_range_start(value);
+            }
+            else if (lkey == "etag")
             {
                 s->m_etag = value;
             }
@@ -405,16 +713,6 @@ namespace mamba
         };
     }
 
-    std::chrono::steady_clock::time_point DownloadTarget::progress_throttle_time() const
-    {
-        return m_progress_throttle_time;
-    }
-
-    void DownloadTarget::set_progress_throttle_time(const std::chrono::steady_clock::time_point& time)
-    {
-        m_progress_throttle_time = time;
-    }
-
     int DownloadTarget::progress_callback(
         void* f,
         curl_off_t total_to_download,
@@ -424,39 +722,37 @@ namespace mamba
     )
     {
         auto* target = static_cast<DownloadTarget*>(f);
-
-        auto now = std::chrono::steady_clock::now();
-        if (now - target->progress_throttle_time() < std::chrono::milliseconds(50))
+        if (auto* parent = target->p_parent)
         {
-            return 0;
-        }
-        else
-        {
-            target->set_progress_throttle_time(now);
-        }
-
-        if (!total_to_download && !target->get_expected_size())
-        {
-            target->m_progress_bar.activate_spinner();
+            // The progress of all the chunks is the one of the download
+            return progress_callback(
+                parent,
+                static_cast<curl_off_t>(parent->m_expected_size),
+                static_cast<curl_off_t>(parent->get_transferred_size()),
+                0,
+                0
+            );
         }
-        else
+        // Count the data of a resumed download
+        const auto offset = static_cast<curl_off_t>(target->m_resume_offset);
+        now_downloaded += offset;
+        if (total_to_download)
         {
-            target->m_progress_bar.deactivate_spinner();
+            total_to_download += offset;
         }
 
-        if (!total_to_download && target->get_expected_size())
+        // Without a size from the server, the spinner is only shown if none is expected either
+        if (!total_to_download)
         {
-            target->m_progress_bar.update_current(static_cast<std::size_t>(now_downloaded));
-        }
-        else
-        {
-            target->m_progress_bar.update_progress(
-                static_cast<std::size_t>(now_downloaded),
-                static_cast<std::size_t>(total_to_download)
-            );
+            total_to_download = static_cast<curl_off_t>(target->get_expected_size());
         }
 
-        target->m_progress_bar.set_speed(target->get_speed());
+        // Only stores the counters, the progress bar manager samples them when rendering
+        target->m_progress_bar.post_progress(
+            static_cast<std::size_t>(now_downloaded),
+            static_cast<std::size_t>(total_to_download),
+            target->get_speed()
+        );
 
         return 0;
     }
@@ -468,11 +764,13 @@ namespace mamba
 
         if (!letag.empty())
         {
-            m_curl_handle->add_header(to_header("If-None-Match", letag));
+            m_conditional_headers.push_back(to_header("If-None-Match", letag));
+            m_curl_handle->add_header(m_conditional_headers.back());
         }
         if (!lmod.empty())
         {
-            m_curl_handle->add_header(to_header("If-Modified-Since", lmod));
+            m_conditional_headers.push_back(to_header("If-Modified-Since", lmod));
+            m_curl_handle->add_header(m_conditional_headers.back());
         }
     }
 
@@ -497,6 +795,285 @@ namespace mamba
         m_curl_handle->set_opt(CURLOPT_NOBODY, yes);
     }
 
+    void DownloadTarget::set_hash(validation::HashStream hash)
+    {
+        m_hash = std::move(hash);
+    }
+
+    const std::optional<std::string>& DownloadTarget::get_hex_digest() const
+    {
+        return m_hex_digest;
+    }
+
+    void DownloadTarget::set_range_start(std::size_t start)
+    {
+        m_curl_handle->set_opt(CURLOPT_RANGE, fmt::format("{}-", start));
+    }
+
+    void DownloadTarget::set_fallback_url(const std::string& url, bool on_any_error)
+    {
+        m_fallback_url = unc_url(url);
+        m_fallback_on_any_error = on_any_error;
+        // Error pages are not written to the file, and cannot be mistaken for the data
+        m_curl_handle->set_opt(CURLOPT_FAILONERROR, 1L);
+    }
+
+    bool DownloadTarget::needs_fallback()
+    {
+        if (m_fallback_url.empty())
+        {
+            return false;
+        }
+        const int status = m_curl_handle->get_info<int>(CURLINFO_RESPONSE_CODE).value_or(0);
+        if (m_fallback_on_any_error)
+        {
+            return (m_curl_handle->get_result() != 0) || (status >= 400);
+        }
+        return (status == 403) || (status == 404);
+    }
+
+    bool DownloadTarget::needs_new_authorization()
+    {
+        // Only once, as the server may reject any token
+        if (m_authorization.empty() || m_authorization_refreshed)
+        {
+            return false;
+        }
+        const int status = m_curl_handle->get_info<int>(CURLINFO_RESPONSE_CODE).value_or(0);
+        if (status != 401)
+        {
+            return false;
+        }
+        auto& headers = AuthorizationHeaders::instance();
+        return !headers.refresh(mirror_host(m_url), m_authorization).empty();
+    }
+
+    void DownloadTarget::set_resumable(bool yes)
+    {
+        m_resumable = yes;
+        if (m_resumable)
+        {
+            prepare_resume();
+        }
+    }
+
+    auto DownloadTarget::split(std::size_t count)
+        -> const std::vector<std::unique_ptr<DownloadTarget>>&
+    {
+        // Decompressed and resumed downloads are received in order
+        if ((count < 2) || (m_expected_size < count) || m_zstd_stream || m_bzip2_stream
+            || (m_resume_offset > 0) || !starts_with(m_url, "http") || !m_chunks.empty())
+        {
+            return m_chunks;
+        }
+
+        const auto filename = m_resumable ? partial_filename() : m_filename;
+        auto ec = std::error_code();
+        if (!open_ofstream(filename))
+        {
+            LOG_DEBUG << "Could not create " << filename << ": " << strerror(errno);
+            return m_chunks;
+        }
+        fs::resize_file(filename, m_expected_size, ec);
+        if (ec)
+        {
+            LOG_DEBUG << "Could not preallocate " << filename << ": " << ec.message();
+            return m_chunks;
+        }
+        if (m_resumable)
+        {
+            // The file has holes until all the chunks are downloaded
+            write_validator(filename, m_url, "");
+        }
+
+        LOG_INFO << "Downloading '" << m_name << "' in " << count << " chunks";
+        const auto chunk_size = m_expected_size / count;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto chunk = std::make_unique<DownloadTarget>(
+                fmt::format("{} ({}/{})", m_name, i + 1, count),
+                m_url,
+                filename
+            );
+            const auto start = i * chunk_size;
+            const auto size = (i + 1 == count) ? (m_expected_size - start) : chunk_size;
+            chunk->p_parent = this;
+            chunk->m_chunk_start = start;
+            chunk->m_chunk_size = size;
+            chunk->set_expected_size(size);
+            const auto range = fmt::format("{}-{}", start, start + size - 1);
+            chunk->m_curl_handle->set_opt(CURLOPT_RANGE, range);
+            // Failed chunks are downloaded again in a single transfer
+            chunk->set_ignore_failure(true);
+            chunk->set_finalize_callback([](const DownloadTarget&) { return true; });
+            if (m_has_progress_bar)
+            {
+                chunk->m_curl_handle->set_opt(
+                    CURLOPT_XFERINFOFUNCTION,
+                    &DownloadTarget::progress_callback
+                );
+                chunk->m_curl_handle->set_opt(CURLOPT_XFERINFODATA, chunk.get());
+                chunk->m_curl_handle->set_opt(CURLOPT_NOPROGRESS, 0L);
+            }
+            m_chunks.push_back(std::move(chunk));
+        }
+        return m_chunks;
+    }
+
+    auto DownloadTarget::get_chunks() const -> const std::vector<std::unique_ptr<DownloadTarget>>&
+    {
+        return m_chunks;
+    }
+
+    bool DownloadTarget::finalize_chunks()
+    {
+        std::size_t avg_speed = 0;
+        m_downloaded_size = 0;
+        for (const auto& chunk : m_chunks)
+        {
+            avg_speed += chunk->get_speed();
+            m_downloaded_size += chunk->get_downloaded_size();
+        }
+        // The whole file was received
+        m_http_status = 200;
+        m_effective_url = m_url.data();
+        if (m_hash)
+        {
+            hash_file(*m_hash, m_resumable ? partial_filename() : m_filename);
+            m_hex_digest = m_hash->hex_digest();
+        }
+
+        LOG_INFO << get_transfer_msg();
+        return finish(avg_speed);
+    }
+
+    void DownloadTarget::merge_chunks()
+    {
+        LOG_INFO << "Downloading '" << m_name << "' in a single transfer";
+        m_chunks.clear();
+        auto ec = std::error_code();
+        fs::remove(m_resumable ? partial_filename() : m_filename, ec);
+    }
+
+    std::string DownloadTarget::partial_filename() const
+    {
+        return m_filename + DOWNLOAD_PARTIAL_EXTENSION;
+    }
+
+    void DownloadTarget::prepare_resume()
+    {
+        const auto partial = partial_filename();
+        auto ec = std::error_code();
+        const auto size = fs::exists(partial, ec) ? fs::file_size(partial, ec) : 0;
+        // Ranges are validated by HTTP servers only
+        const auto validator = starts_with(m_url, "http") ? read_validator(partial, m_url) : "";
+        // A complete partial file was not renamed, the server would not send any data
+        if (ec || (size == 0) || validator.empty()
+            || ((m_expected_size > 0) && (size >= m_expected_size)))
+        {
+            m_resume_offset = 0;
+            m_curl_handle->set_opt(CURLOPT_RANGE, static_cast<const char*>(nullptr));
+            return;
+        }
+        LOG_DEBUG << "Resuming download of " << m_url << " after " << size << " bytes";
+        m_resume_offset = size;
+        set_range_start(size);
+        // The server sends the whole file if the data changed since
+        m_curl_handle->add_header("If-Range: " + validator);
+    }
+
+    bool DownloadTarget::open_file()
+    {
+        auto filename = m_filename;
+        bool append = false;
+        const auto status = m_curl_handle->get_info<int>(CURLINFO_RESPONSE_CODE).value_or(0);
+        if (m_chunk_size > 0)
+        {
+            if ((status != 206) || (m_range_start != m_chunk_start))
+            {
+                LOG_INFO << "Range request refused for " << m_url << " (status " << status << ")";
+                m_range_refused = true;
+                return false;
+            }
+        }
+        // An error page is written to the file as is, keeping the partial data for a retry
+        else if (m_resumable && (status < 300))
+        {
+            filename = partial_filename();
+            if ((m_resume_offset > 0) && (status == 206) && (m_range_start == m_resume_offset))
+            {
+                LOG_INFO << "Resuming download to " << filename << " after " << m_resume_offset
+                         << " bytes";
+                append = true;
+                // Consumers of the data would miss its beginning
+                m_data_callback = nullptr;
+                if (m_hash)
+                {
+                    hash_file(*m_hash, filename);
+                }
+            }
+            else if (status == 206)
+            {
+                // Not the range requested, download everything on retry
+                LOG_WARNING << "Unexpected range received for " << m_url;
+                m_resume_offset = 0;
+                write_validator(filename, m_url, "");
+                return false;
+            }
+            else
+            {
+                m_resume_offset = 0;
+                write_validator(filename, m_url, range_validator(m_etag, m_mod));
+            }
+        }
+
+        m_file = std::make_unique<DownloadFile>(
+            Context::instance().remote_fetch_params.download_direct_write
+        );
+        bool opened = false;
+        if (m_chunk_size > 0)
+        {
+            // Written at its offset in the preallocated file
+            opened = m_file->open_at(filename, m_chunk_start);
+        }
+        else if (append)
+        {
+            opened = m_file->append(filename);
+        }
+        else
+        {
+            // An error page is much smaller than the expected file
+            opened = m_file->create(filename, (status < 300) ? m_expected_size : 0);
+        }
+        if (!opened)
+        {
+            LOG_ERROR << "Could not open file for download " << filename << ": "
+                      << strerror(errno);
+            m_file.reset();
+            return false;
+        }
+        return true;
+    }
+
+    void DownloadTarget::complete_file()
+    {
+        const auto partial = partial_filename();
+        auto ec = std::error_code();
+        fs::remove(validator_filename(partial), ec);
+        if (!fs::exists(partial))
+        {
+            return;
+        }
+        if (m_http_status < 300)
+        {
+            fs::rename(partial, m_filename);
+        }
+        else
+        {
+            fs::remove(partial, ec);
+        }
+    }
+
     const std::string& DownloadTarget::get_name() const
     {
         return m_name;
@@ -507,6 +1084,22 @@ namespace mamba
         return m_url;
     }
 
+    const std::vector<std::string>& DownloadTarget::get_mirror_urls() const
+    {
+        return m_mirror_urls;
+    }
+
+    void DownloadTarget::set_mirror(std::size_t index)
+    {
+        if ((index == m_mirror) || (index >= m_mirror_urls.size()))
+        {
+            return;
+        }
+        m_mirror = index;
+        m_url = m_mirror_urls[m_mirror];
+        reset_curl_target();
+    }
+
     const std::string& DownloadTarget::get_etag() const
     {
         return m_etag;
@@ -537,8 +1130,31 @@ namespace mamba
         return m_downloaded_size;
     }
 
+    std::size_t DownloadTarget::get_transferred_size() const
+    {
+        if (!m_chunks.empty())
+        {
+            std::size_t size = 0;
+            for (const auto& chunk : m_chunks)
+            {
+                size += chunk->get_transferred_size();
+            }
+            return size;
+        }
+        return m_curl_handle->get_info<std::size_t>(CURLINFO_SIZE_DOWNLOAD_T).value_or(0);
+    }
+
     std::size_t DownloadTarget::get_speed()
     {
+        if (!m_chunks.empty())
+        {
+            std::size_t speed = 0;
+            for (const auto& chunk : m_chunks)
+            {
+                speed += chunk->get_speed();
+            }
+            return speed;
+        }
         auto speed = m_curl_handle->get_info<std::size_t>(CURLINFO_SPEED_DOWNLOAD_T);
         // TODO Should we just drop all code below with progress_bar and use value_or(0) in get_info
         // above instead?
@@ -584,6 +1200,35 @@ namespace mamba
 
     bool DownloadTarget::check_result()
     {
+        static auto& download_bytes = Metrics::instance().counter(
+            "mamba_download_bytes_total",
+            "Bytes received by the transfers, whose throughput is this over their total time"
+        );
+        static auto& download_seconds = Metrics::instance().histogram(
+            "mamba_download_seconds",
+            "Total time of the transfers, including retried ones and chunks of files"
+        );
+        const auto transfer_bytes = m_curl_handle->get_info<std::size_t>(CURLINFO_SIZE_DOWNLOAD_T)
+                                        .value_or(0);
+        const auto transfer_us = m_curl_handle->get_info<std::size_t>(CURLINFO_TOTAL_TIME_T)
+                                     .value_or(0);
+        download_bytes.add(static_cast<double>(transfer_bytes));
+        download_seconds.observe(static_cast<double>(transfer_us) / 1e6);
+
+        auto& tracer = Tracer::instance();
+        if (tracer.enabled())
+        {
+            // Transfers are driven by curl multi, so the span is rebuilt from curl's total time
+            const auto end = Tracer::clock::now();
+            const auto status = m_curl_handle->get_info<int>(CURLINFO_RESPONSE_CODE).value_or(0);
+            tracer.add_span(
+                "download " + m_name,
+                end - std::chrono::microseconds(transfer_us),
+                end,
+                { { "bytes", transfer_bytes }, { "http_status", static_cast<std::size_t>(status) } }
+            );
+        }
+
         if (!m_curl_handle->is_curl_res_ok())
         {
             std::stringstream err;
@@ -605,9 +1250,19 @@ namespace mamba
                 // m_progress_bar.set_elapsed_time();
                 m_progress_bar.set_postfix(m_curl_handle->get_res_error());
             }
-            if (!m_ignore_failure && !can_retry())
+            if (!can_retry())
             {
-                throw std::runtime_error(err.str());
+                if (!p_parent)
+                {
+                    const nlohmann::json event = { { "event", "download_failed" },
+                                                   { "name", m_name },
+                                                   { "error", m_curl_handle->get_res_error() } };
+                    Console::instance().progress_event(event);
+                }
+                if (!m_ignore_failure)
+                {
+                    throw std::runtime_error(err.str());
+                }
             }
             return false;
         }
@@ -629,10 +1284,25 @@ namespace mamba
 
     bool DownloadTarget::finalize()
     {
+        // The decompressed data is buffered until the end of the transfer
+        if (m_zstd_stream)
+        {
+            m_zstd_stream->flush();
+        }
+        if (m_bzip2_stream)
+        {
+            m_bzip2_stream->flush();
+        }
         auto avg_speed = get_speed();
         m_http_status = m_curl_handle->get_info<int>(CURLINFO_RESPONSE_CODE).value_or(10000);
         m_effective_url = m_curl_handle->get_info<char*>(CURLINFO_EFFECTIVE_URL).value();
-        m_downloaded_size = m_curl_handle->get_info<std::size_t>(CURLINFO_SIZE_DOWNLOAD_T).value_or(0);
+        m_downloaded_size = m_resume_offset
+                            + m_curl_handle->get_info<std::size_t>(CURLINFO_SIZE_DOWNLOAD_T)
+                                  .value_or(0);
+        if (m_hash)
+        {
+            m_hex_digest = m_hash->hex_digest();
+        }
 
         LOG_INFO << get_transfer_msg();
 
@@ -660,7 +1330,23 @@ namespace mamba
             return false;
         }
 
-        m_file.close();
+        return finish(avg_speed);
+    }
+
+    bool DownloadTarget::finish(std::size_t avg_speed)
+    {
+        if (m_file)
+        {
+            if (!m_file->close())
+            {
+                LOG_ERROR << "Could not write to file " << m_filename << ": " << strerror(errno);
+            }
+            m_file.reset();
+        }
+        if (m_resumable)
+        {
+            complete_file();
+        }
 
         if (m_has_progress_bar)
         {
@@ -669,6 +1355,15 @@ namespace mamba
             m_progress_bar.set_full();
             m_progress_bar.set_postfix("Downloaded");
         }
+        // Chunks are reported with their download
+        if (!p_parent && !Context::instance().output_params.progress_events.empty())
+        {
+            Console::instance().progress_event({ { "event", "downloaded" },
+                                                 { "name", m_name },
+                                                 { "size", m_downloaded_size },
+                                                 { "speed", avg_speed },
+                                                 { "http_status", m_http_status } });
+        }
 
         bool ret = true;
         if (m_finalize_callback)
@@ -719,14 +1414,95 @@ namespace mamba
         return *m_curl_handle;
     }
 
+    /**************************************
+     * DownloadConcurrency implementation *
+     **************************************/
+
+    DownloadConcurrency::DownloadConcurrency(std::size_t initial, std::size_t max)
+        : m_limit(std::max<std::size_t>(initial, 1))
+        , m_max(std::max(max, m_limit))
+    {
+    }
+
+    std::size_t DownloadConcurrency::limit() const
+    {
+        return m_limit;
+    }
+
+    void DownloadConcurrency::update(std::size_t throughput)
+    {
+        m_backed_off = false;
+        if (throughput == 0)
+        {
+            // Nothing received at all while transfers were running, unless still connecting
+            if (m_throughput > 0)
+            {
+                back_off();
+            }
+            return;
+        }
+        // Increase while it pays off, by a quarter to ramp up quickly from large limits
+        if (throughput > m_throughput + m_throughput / 10)
+        {
+            m_limit = std::min(m_max, m_limit + std::max<std::size_t>(m_limit / 4, 1));
+        }
+        m_throughput = throughput;
+    }
+
+    void DownloadConcurrency::back_off()
+    {
+        if (!m_backed_off)
+        {
+            m_limit = std::max<std::size_t>(m_limit / 2, 1);
+            m_backed_off = true;
+        }
+    }
+
+    void schedule_downloads(std::vector<DownloadTarget*>& targets, std::size_t slots)
+    {
+        std::stable_sort(
+            targets.begin(),
+            targets.end(),
+            [](DownloadTarget* a, DownloadTarget* b) -> bool
+            { return a->get_expected_size() > b->get_expected_size(); }
+        );
+
+        std::vector<DownloadTarget*> scheduled;
+        scheduled.reserve(targets.size());
+        auto largest = targets.begin();
+        auto smallest = targets.end();
+        for (; (largest != smallest) && (scheduled.size() < slots); ++largest)
+        {
+            scheduled.push_back(*largest);
+        }
+        bool take_largest = false;
+        while (largest != smallest)
+        {
+            scheduled.push_back(take_largest ? *(largest++) : *(--smallest));
+            take_largest = !take_largest;
+        }
+        targets = std::move(scheduled);
+    }
+
     /**************************************
      * MultiDownloadTarget implementation *
      **************************************/
 
     MultiDownloadTarget::MultiDownloadTarget()
+        : m_adaptive(
+            Context::instance().threads_params.max_download_threads
+            > Context::instance().threads_params.download_threads
+        )
+        , m_concurrency(
+              Context::instance().threads_params.download_threads,
+              Context::instance().threads_params.max_download_threads
+          )
     {
+        const auto& ctx = Context::instance();
         p_curl_handle = std::make_unique<CURLMultiHandle>(
-            Context::instance().threads_params.download_threads
+            m_adaptive ? ctx.threads_params.max_download_threads
+                       : ctx.threads_params.download_threads,
+            static_cast<std::size_t>(std::max(ctx.remote_fetch_params.max_host_connections, 0))
         );
     }
 
@@ -740,12 +1516,227 @@ namespace mamba
         {
             return;
         }
-        p_curl_handle->add_handle(target->get_curl_handle());
         m_targets.push_back(target);
     }
 
-    bool MultiDownloadTarget::check_msgs(bool failfast)
+    std::size_t MultiDownloadTarget::concurrency() const
+    {
+        if (m_adaptive)
+        {
+            return m_concurrency.limit();
+        }
+        return Context::instance().threads_params.download_threads;
+    }
+
+    double MultiDownloadTarget::elapsed_time() const
+    {
+        return m_elapsed_time;
+    }
+
+    std::size_t MultiDownloadTarget::retried_bytes() const
+    {
+        return m_retried_bytes;
+    }
+
+    std::optional<double> MultiDownloadTarget::estimated_time() const
+    {
+        return m_estimated_time;
+    }
+
+    void MultiDownloadTarget::select_mirror(DownloadTarget& target)
     {
+        const auto& urls = target.get_mirror_urls();
+        if (urls.size() < 2)
+        {
+            return;
+        }
+        // Mirrors are measured first, then downloads are spread in proportion to their speed
+        std::size_t best = 0;
+        double best_score = -1;
+        for (std::size_t i = 0; i < urls.size(); ++i)
+        {
+            const auto& stats = m_mirror_stats[mirror_host(urls[i])];
+            const double speed = stats.speed.value_or(std::numeric_limits<double>::max());
+            const double score = speed / static_cast<double>(stats.assigned + 1);
+            if (score > best_score)
+            {
+                best = i;
+                best_score = score;
+            }
+        }
+        ++m_mirror_stats[mirror_host(urls[best])].assigned;
+        target.set_mirror(best);
+    }
+
+    void MultiDownloadTarget::record_mirror_speed(DownloadTarget& target, bool failed)
+    {
+        if (target.get_mirror_urls().size() < 2)
+        {
+            return;
+        }
+        auto& stats = m_mirror_stats[mirror_host(target.get_url())];
+        if (failed)
+        {
+            // Until a download from it succeeds again
+            stats.speed = 0;
+            return;
+        }
+        const auto speed = static_cast<double>(target.get_speed());
+        stats.speed = stats.speed ? ((*stats.speed + speed) / 2) : speed;
+    }
+
+    void MultiDownloadTarget::schedule_retry(DownloadTarget& target)
+    {
+        record_mirror_speed(target, true);
+        // What the failed attempt transferred has to be downloaded again
+        m_retried_bytes += target.get_transferred_size();
+        LOG_INFO << "Setting retry for '" << target.get_name() << "'";
+        m_retry_targets.push_back(&target);
+    }
+
+    std::size_t MultiDownloadTarget::start_transfer(DownloadTarget& target)
+    {
+        select_mirror(target);
+        const auto& params = Context::instance().remote_fetch_params;
+        if ((params.download_chunks > 1)
+            && (target.get_expected_size() >= params.download_chunk_threshold))
+        {
+            const auto& chunks = target.split(static_cast<std::size_t>(params.download_chunks));
+            for (const auto& chunk : chunks)
+            {
+                p_curl_handle->add_handle(chunk->get_curl_handle());
+            }
+            if (!chunks.empty())
+            {
+                return chunks.size();
+            }
+        }
+        p_curl_handle->add_handle(target.get_curl_handle());
+        return 1;
+    }
+
+    std::size_t MultiDownloadTarget::start_transfers(std::size_t running)
+    {
+        // Without adaptation, all transfers are started and queued by curl
+        const std::size_t limit = m_adaptive ? m_concurrency.limit()
+                                             : std::numeric_limits<std::size_t>::max();
+        std::size_t started = 0;
+        for (; (m_started < m_targets.size()) && (running + started < limit); ++m_started)
+        {
+            started += start_transfer(*m_targets[m_started]);
+        }
+        return started;
+    }
+
+    void MultiDownloadTarget::sample_throughput()
+    {
+        constexpr auto period = std::chrono::seconds(1);
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - m_sample_time < period)
+        {
+            return;
+        }
+
+        std::size_t size = 0;
+        for (std::size_t i = 0; i < m_started; ++i)
+        {
+            size += m_targets[i]->get_transferred_size();
+        }
+        // Retried transfers start again from zero
+        const std::size_t received = (size > m_sampled_size) ? (size - m_sampled_size) : 0;
+        const double elapsed = std::chrono::duration<double>(now - m_sample_time).count();
+        m_sampled_size = size;
+        m_sample_time = now;
+        const auto throughput = static_cast<std::size_t>(static_cast<double>(received) / elapsed);
+
+        const bool report = !Context::instance().output_params.progress_events.empty();
+        std::size_t expected = 0;
+        if (report || (!m_estimated_time && (throughput > 0)))
+        {
+            for (const auto* target : m_targets)
+            {
+                expected += target->get_expected_size();
+            }
+        }
+
+        if (report)
+        {
+            Console::instance().progress_event({ { "event", "download" },
+                                                 { "downloaded", size },
+                                                 { "expected", expected },
+                                                 { "speed", throughput },
+                                                 { "started", m_started },
+                                                 { "targets", m_targets.size() } });
+        }
+
+        if (!m_estimated_time && (throughput > 0))
+        {
+            const std::size_t remaining = (expected > size) ? (expected - size) : 0;
+            m_estimated_time = std::chrono::duration<double>(now - m_start_time).count()
+                               + static_cast<double>(remaining) / static_cast<double>(throughput);
+            LOG_INFO << "Estimated download time: " << *m_estimated_time << "s";
+        }
+
+        // The limit is only relevant, and the throughput only representative of it, while
+        // some transfers are waiting for it
+        if (m_adaptive && (m_started < m_targets.size()))
+        {
+            const auto previous = m_concurrency.limit();
+            m_concurrency.update(throughput);
+            if (m_concurrency.limit() != previous)
+            {
+                LOG_INFO << "Download concurrency set to " << m_concurrency.limit() << " at "
+                         << to_human_readable_filesize(static_cast<double>(throughput), 1) << "/s";
+            }
+        }
+    }
+
+    std::size_t
+    MultiDownloadTarget::check_chunk(DownloadTarget& target, DownloadTarget& chunk, bool failfast)
+    {
+        p_curl_handle->remove_handle(chunk.get_curl_handle());
+        if (chunk.check_result() && chunk.finalize() && (chunk.get_http_status() == 206))
+        {
+            record_mirror_speed(chunk, false);
+            if (++m_finished_chunks[&target] < target.get_chunks().size())
+            {
+                return 0;
+            }
+            m_finished_chunks.erase(&target);
+            LOG_INFO << "Transfer done for '" << target.get_name() << "'";
+            if (!target.finalize_chunks() && failfast && !target.get_ignore_failure())
+            {
+                throw std::runtime_error(
+                    "Multi-download failed. Reason: " + target.get_transfer_msg()
+                );
+            }
+            return 0;
+        }
+        if (chunk.can_retry())
+        {
+            schedule_retry(chunk);
+            return 0;
+        }
+
+        // Such as when the server does not support ranges
+        for (const auto& other : target.get_chunks())
+        {
+            p_curl_handle->remove_handle(other->get_curl_handle());
+            m_retry_targets.erase(
+                std::remove(m_retry_targets.begin(), m_retry_targets.end(), other.get()),
+                m_retry_targets.end()
+            );
+        }
+        m_finished_chunks.erase(&target);
+        target.merge_chunks();
+        p_curl_handle->add_handle(target.get_curl_handle());
+        return 1;
+    }
+
+    std::size_t MultiDownloadTarget::check_msgs(bool failfast)
+    {
+        std::size_t started = 0;
         while (auto resp = p_curl_handle->pop_message())
         {
             const auto& msg = resp.value();
@@ -756,6 +1747,7 @@ namespace mamba
             }
 
             DownloadTarget* current_target = nullptr;
+            DownloadTarget* current_chunk = nullptr;
             for (const auto& target : m_targets)
             {
                 if (target->get_curl_handle() == msg.m_handle_ref)
@@ -763,18 +1755,37 @@ namespace mamba
                     current_target = target;
                     break;
                 }
+                for (const auto& chunk : target->get_chunks())
+                {
+                    if (chunk->get_curl_handle() == msg.m_handle_ref)
+                    {
+                        current_target = target;
+                        current_chunk = chunk.get();
+                        break;
+                    }
+                }
+                if (current_chunk)
+                {
+                    break;
+                }
             }
 
             if (!current_target)
             {
                 throw std::runtime_error("Could not find target associated with multi request");
             }
+            if (current_chunk)
+            {
+                current_chunk->set_result(msg.m_transfer_result);
+                started += check_chunk(*current_target, *current_chunk, failfast);
+                continue;
+            }
 
             current_target->set_result(msg.m_transfer_result);
             if (!current_target->check_result() && current_target->can_retry())
             {
                 p_curl_handle->remove_handle(current_target->get_curl_handle());
-                m_retry_targets.push_back(current_target);
+                schedule_retry(*current_target);
             }
             else
             {
@@ -783,16 +1794,29 @@ namespace mamba
                 p_curl_handle->remove_handle(current_target->get_curl_handle());
 
                 // flush file & finalize transfer
-                if (!current_target->finalize())
+                if (current_target->finalize())
                 {
+                    record_mirror_speed(*current_target, false);
+                    target_finished();
+                }
+                else
+                {
+                    const int status = current_target->get_http_status();
+                    if (m_adaptive && ((status == 429) || (status == 503)))
+                    {
+                        m_concurrency.back_off();
+                        LOG_INFO << "Server asked to slow down (" << status
+                                 << "), download concurrency set to " << m_concurrency.limit();
+                    }
+
                     // transfer did not work! can we retry?
                     if (current_target->can_retry())
                     {
-                        LOG_INFO << "Setting retry for '" << current_target->get_name() << "'";
-                        m_retry_targets.push_back(current_target);
+                        schedule_retry(*current_target);
                     }
                     else
                     {
+                        target_finished();
                         if (failfast && current_target->get_ignore_failure() == false)
                         {
                             throw std::runtime_error(
@@ -803,7 +1827,23 @@ namespace mamba
                 }
             }
         }
-        return true;
+        return started;
+    }
+
+    void MultiDownloadTarget::set_progress_callback(
+        std::function<void(std::size_t, std::size_t)> cb
+    )
+    {
+        m_progress_callback = std::move(cb);
+    }
+
+    void MultiDownloadTarget::target_finished()
+    {
+        ++m_finished_targets;
+        if (m_progress_callback)
+        {
+            m_progress_callback(m_finished_targets, m_targets.size());
+        }
     }
 
     bool MultiDownloadTarget::download(int options)
@@ -811,6 +1851,8 @@ namespace mamba
         bool failfast = options & MAMBA_DOWNLOAD_FAILFAST;
         bool sort = options & MAMBA_DOWNLOAD_SORT;
         bool no_clear_progress_bars = options & MAMBA_NO_CLEAR_PROGRESS_BARS;
+        bool no_progress_bars = options & MAMBA_NO_PROGRESS_BARS;
+        m_finished_targets = 0;
 
         auto& ctx = Context::instance();
 
@@ -822,12 +1864,7 @@ namespace mamba
 
         if (sort)
         {
-            std::sort(
-                m_targets.begin(),
-                m_targets.end(),
-                [](DownloadTarget* a, DownloadTarget* b) -> bool
-                { return a->get_expected_size() > b->get_expected_size(); }
-            );
+            schedule_downloads(m_targets, concurrency());
         }
 
         LOG_INFO << "Starting to download targets";
@@ -839,17 +1876,20 @@ namespace mamba
         // it would mean this code is part of a larger process using progress bars
         bool pbar_manager_started = pbar_manager.started();
         if (!(ctx.graphics_params.no_progress_bars || ctx.output_params.json
-              || ctx.output_params.quiet || pbar_manager_started))
+              || ctx.output_params.quiet || pbar_manager_started || no_progress_bars))
         {
             pbar_manager.watch_print();
         }
 
-        std::size_t still_running = size_t(0);
+        std::size_t still_running = start_transfers(0);
         std::size_t repeats = 0;
+        m_start_time = std::chrono::steady_clock::now();
+        m_sample_time = m_start_time;
+        m_estimated_time.reset();
         do
         {
             still_running = p_curl_handle->perform();
-            check_msgs(failfast);
+            still_running += check_msgs(failfast);
 
             if (!m_retry_targets.empty())
             {
@@ -860,7 +1900,7 @@ namespace mamba
                     {
                         p_curl_handle->add_handle((*it)->get_curl_handle());
                         it = m_retry_targets.erase(it);
-                        still_running = 1;
+                        still_running++;
                     }
                     else
                     {
@@ -869,6 +1909,9 @@ namespace mamba
                 }
             }
 
+            sample_throughput();
+            still_running += start_transfers(still_running);
+
             std::size_t timeout = p_curl_handle->get_timeout();
             if (timeout == 0u)
             {
@@ -894,6 +1937,13 @@ namespace mamba
             }
         } while ((still_running || !m_retry_targets.empty()) && !is_sig_interrupted());
 
+        const auto download_duration = std::chrono::steady_clock::now() - m_start_time;
+        m_elapsed_time = std::chrono::duration<double>(download_duration).count();
+        LOG_INFO << "Download finished in " << m_elapsed_time << "s";
+        Console::instance().progress_event({ { "event", "download_finished" },
+                                             { "targets", m_targets.size() },
+                                             { "elapsed", m_elapsed_time } });
+
         if (is_sig_interrupted())
         {
             Console::instance().print("Download interrupted");
@@ -901,7 +1951,7 @@ namespace mamba
         }
 
         if (!(ctx.graphics_params.no_progress_bars || ctx.output_params.json
-              || ctx.output_params.quiet || pbar_manager_started))
+              || ctx.output_params.quiet || pbar_manager_started || no_progress_bars))
         {
             pbar_manager.terminate();
             if (!no_clear_progress_bars)
@@ -8,6 +8,23 @@
 #include <string>
 #include <system_error>
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <sys/clonefile.h>
+#include <sys/mount.h>
+#include <sys/param.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include <fmt/format.h>
+
 #include "mamba/core/environment.hpp"
 #include "mamba/core/fsutil.hpp"
 #include "mamba/core/mamba_fs.hpp"
@@ -168,4 +185,142 @@ namespace mamba::mamba_fs
             }
         }
     }
+
+#if defined(__linux__) && defined(FICLONE)
+    void clone_file(const fs::u8path& from, const fs::u8path& to, std::error_code& ec)
+    {
+        ec.clear();
+        const int from_fd = ::open(from.string().c_str(), O_RDONLY | O_CLOEXEC);
+        if (from_fd < 0)
+        {
+            ec = std::error_code(errno, std::generic_category());
+            return;
+        }
+        const auto close_from = on_scope_exit([&] { ::close(from_fd); });
+
+        struct ::stat st;
+        if (::fstat(from_fd, &st) != 0)
+        {
+            ec = std::error_code(errno, std::generic_category());
+            return;
+        }
+        const int to_fd = ::open(
+            to.string().c_str(),
+            O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+            S_IRUSR | S_IWUSR
+        );
+        if (to_fd < 0)
+        {
+            ec = std::error_code(errno, std::generic_category());
+            return;
+        }
+        if ((::ioctl(to_fd, FICLONE, from_fd) != 0) || (::fchmod(to_fd, st.st_mode & 07777) != 0))
+        {
+            ec = std::error_code(errno, std::generic_category());
+            ::close(to_fd);
+            ::unlink(to.string().c_str());
+            return;
+        }
+        ::close(to_fd);
+    }
+#elif defined(__APPLE__)
+    void clone_file(const fs::u8path& from, const fs::u8path& to, std::error_code& ec)
+    {
+        ec.clear();
+        // Also clones the permissions and other metadata
+        if (::clonefile(from.string().c_str(), to.string().c_str(), 0) != 0)
+        {
+            ec = std::error_code(errno, std::generic_category());
+        }
+    }
+#else
+    void clone_file(const fs::u8path&, const fs::u8path&, std::error_code& ec)
+    {
+        ec = std::make_error_code(std::errc::operation_not_supported);
+    }
+#endif
+
+#if defined(__linux__)
+    FilesystemInfo filesystem_info(const fs::u8path& path, std::error_code& ec)
+    {
+        ec.clear();
+        struct ::statfs st;
+        if (::statfs(path.string().c_str(), &st) != 0)
+        {
+            ec = std::error_code(errno, std::generic_category());
+            return {};
+        }
+
+        // The magic numbers of linux/magic.h, not all defined by older kernel headers
+        struct Known
+        {
+            unsigned long magic;
+            const char* type;
+            bool network;
+        };
+        static constexpr Known known[] = {
+            { 0xEF53, "ext4", false },         { 0x58465342, "xfs", false },
+            { 0x9123683E, "btrfs", false },    { 0x2FC12FC1, "zfs", false },
+            { 0x01021994, "tmpfs", false },    { 0x794C7630, "overlay", false },
+            { 0x73717368, "squashfs", false }, { 0x5346544E, "ntfs", false },
+            { 0x4D44, "vfat", false },         { 0x65735546, "fuse", false },
+            { 0x6969, "nfs", true },           { 0x517B, "smb", true },
+            { 0xFF534D42, "cifs", true },      { 0xFE534D42, "smb2", true },
+            { 0x5346414F, "afs", true },       { 0x0BD00BD0, "lustre", true },
+            { 0x47504653, "gpfs", true },      { 0x00C36400, "ceph", true },
+            { 0x01021997, "9p", true },
+        };
+        const auto magic = static_cast<unsigned long>(st.f_type) & 0xFFFFFFFF;
+        for (const auto& fs_type : known)
+        {
+            if (fs_type.magic == magic)
+            {
+                return { fs_type.type, fs_type.network };
+            }
+        }
+        return { fmt::format("0x{:x}", magic), false };
+    }
+#elif defined(__APPLE__)
+    FilesystemInfo filesystem_info(const fs::u8path& path, std::error_code& ec)
+    {
+        ec.clear();
+        struct ::statfs st;
+        if (::statfs(path.string().c_str(), &st) != 0)
+        {
+            ec = std::error_code(errno, std::generic_category());
+            return {};
+        }
+        return { st.f_fstypename, (st.f_flags & MNT_LOCAL) == 0 };
+    }
+#elif defined(_WIN32)
+    FilesystemInfo filesystem_info(const fs::u8path& path, std::error_code& ec)
+    {
+        ec.clear();
+        wchar_t volume[MAX_PATH + 1];
+        wchar_t type[MAX_PATH + 1];
+        const bool found = ::GetVolumePathNameW(path.std_path().c_str(), volume, MAX_PATH + 1)
+                           && ::GetVolumeInformationW(
+                               volume,
+                               nullptr,
+                               0,
+                               nullptr,
+                               nullptr,
+                               nullptr,
+                               type,
+                               MAX_PATH + 1
+                           );
+        if (!found)
+        {
+            ec = std::error_code(static_cast<int>(::GetLastError()), std::system_category());
+            return {};
+        }
+        return { fs::u8path(type).string(), ::GetDriveTypeW(volume) == DRIVE_REMOTE };
+    }
+#else
+    FilesystemInfo filesystem_info(const fs::u8path&, std::error_code& ec)
+    {
+        ec = std::make_error_code(std::errc::operation_not_supported);
+        return {};
+    }
+#endif
 }
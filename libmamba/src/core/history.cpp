@@ -4,7 +4,13 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <cstdint>
+#include <iterator>
 #include <regex>
+#include <string_view>
+#include <utility>
+
+#include <nlohmann/json.hpp>
 
 #include "mamba/core/context.hpp"
 #include "mamba/core/fsutil.hpp"
@@ -15,79 +21,365 @@
 
 namespace mamba
 {
-    History::History(const fs::u8path& prefix, ChannelContext& channel_context)
-        : m_prefix(prefix)
-        , m_history_file_path(fs::absolute(m_prefix / "conda-meta" / "history"))
-        , m_channel_context(channel_context)
+    namespace
     {
-    }
+        /**
+         * The history index is a binary sidecar of the history file.
+         *
+         * After this header, it is a sequence of frames, each a little-endian 32 bits size
+         * followed by the msgpack of a parsed entry and of the range of its text in the history
+         * file.
+         * Entries are only appended, and the index covers the history file up to the end of its
+         * last entry, the rest of the text is parsed and appended to the index when read.
+         */
+        constexpr std::string_view history_index_header = "mamba-history-index-v1\n";
+        constexpr std::string_view history_index_filename = "history.mamba-index";
 
-    History::UserRequest History::UserRequest::prefilled()
-    {
-        UserRequest ur;
-        std::time_t t = std::time(nullptr);
-        char mbstr[100];
-        if (std::strftime(mbstr, sizeof(mbstr), "%Y-%m-%d %H:%M:%S", std::localtime(&t)))
+        /** A parsed entry of the history file, with the range of its text. */
+        struct HistoryEntry
         {
-            ur.date = mbstr;
-        }
-        ur.cmd = Context::instance().command_params.current_command;
-        ur.conda_version = Context::instance().command_params.conda_version;
-        return ur;
-    }
+            History::ParseResult result;
+            std::uint64_t offset = 0;
+            std::uint64_t end = 0;
+        };
 
-    std::vector<History::ParseResult> History::parse()
-    {
-        std::vector<ParseResult> res;
-        LOG_INFO << "parsing history: " << m_history_file_path;
+        /** An entry of the history index. */
+        struct IndexedRequest
+        {
+            History::UserRequest request;
+            std::uint64_t offset = 0;
+            std::uint64_t end = 0;
+        };
 
-        if (!fs::exists(m_history_file_path))
+        /** Parse the entries of the history file starting at ``offset``. */
+        auto parse_entries(const fs::u8path& history_file, std::uint64_t offset)
+            -> std::vector<HistoryEntry>
         {
-            // return empty
+            std::vector<HistoryEntry> res;
+            if (!fs::exists(history_file))
+            {
+                return res;
+            }
+
+            auto in_file = open_ifstream(history_file);
+            in_file.seekg(static_cast<std::streamoff>(offset));
+            const auto text = std::string(
+                std::istreambuf_iterator<char>(in_file),
+                std::istreambuf_iterator<char>()
+            );
+            const auto end = offset + text.size();
+
+            static const std::regex head_re("==>\\s*(.+?)\\s*<==");
+            auto new_entry = [&](std::size_t pos) -> HistoryEntry&
+            {
+                if (!res.empty())
+                {
+                    res.back().end = offset + pos;
+                }
+                res.push_back({ {}, offset + pos, end });
+                return res.back();
+            };
+
+            std::size_t pos = 0;
+            while (pos < text.size())
+            {
+                auto line_end = text.find('\n', pos);
+                if (line_end == std::string::npos)
+                {
+                    line_end = text.size();
+                }
+                auto line = text.substr(pos, line_end - pos);
+                const auto line_pos = std::exchange(pos, line_end + 1);
+                if (!line.empty() && (line.back() == '\r'))
+                {
+                    line.pop_back();
+                }
+
+                if (line.size() == 0)
+                {
+                    continue;
+                }
+                std::smatch base_match;
+                if (std::regex_match(line, base_match, head_re))
+                {
+                    new_entry(line_pos).result.head_line = base_match[1].str();
+                }
+                else if (line[0] == '#')
+                {
+                    auto& entry = res.empty() ? new_entry(line_pos) : res.back();
+                    entry.result.comments.push_back(line);
+                }
+                else
+                {
+                    auto& entry = res.empty() ? new_entry(line_pos) : res.back();
+                    entry.result.diff.insert(line);
+                }
+            }
             return res;
         }
 
-        static const std::regex head_re("==>\\s*(.+?)\\s*<==");
-        std::ifstream in_file = open_ifstream(m_history_file_path, std::ios::in);
+        auto to_user_request(History& history, const History::ParseResult& el)
+            -> History::UserRequest
+        {
+            History::UserRequest r;
+            r.date = el.head_line;
+            for (const auto& c : el.comments)
+            {
+                history.parse_comment_line(c, r);
+            }
+
+            for (const auto& x : el.diff)
+            {
+                if (x[0] == '-')
+                {
+                    r.unlink_dists.push_back(x.substr(1));
+                }
+                else if (x[0] == '+')
+                {
+                    r.link_dists.push_back(x.substr(1));
+                }
+            }
+            return r;
+        }
+
+        auto to_json(const IndexedRequest& entry) -> nlohmann::json
+        {
+            const auto& r = entry.request;
+            return {
+                { "offset", entry.offset },
+                { "end", entry.end },
+                { "date", r.date },
+                { "cmd", r.cmd },
+                { "conda_version", r.conda_version },
+                { "unlink_dists", r.unlink_dists },
+                { "link_dists", r.link_dists },
+                { "update", r.update },
+                { "remove", r.remove },
+                { "neutered", r.neutered },
+            };
+        }
 
-        std::string line;
-        while (getline(in_file, line))
+        auto from_json(const nlohmann::json& j) -> IndexedRequest
         {
-            if (line.size() == 0)
+            auto entry = IndexedRequest();
+            auto& r = entry.request;
+            j.at("offset").get_to(entry.offset);
+            j.at("end").get_to(entry.end);
+            j.at("date").get_to(r.date);
+            j.at("cmd").get_to(r.cmd);
+            j.at("conda_version").get_to(r.conda_version);
+            j.at("unlink_dists").get_to(r.unlink_dists);
+            j.at("link_dists").get_to(r.link_dists);
+            j.at("update").get_to(r.update);
+            j.at("remove").get_to(r.remove);
+            j.at("neutered").get_to(r.neutered);
+            return entry;
+        }
+
+        /** Whether the text of the history file at ``offset`` starts with ``prefix``. */
+        auto text_starts_with(
+            const fs::u8path& history_file,
+            std::uint64_t offset,
+            std::string_view prefix
+        ) -> bool
+        {
+            auto in_file = open_ifstream(history_file);
+            in_file.seekg(static_cast<std::streamoff>(offset));
+            auto text = std::string(prefix.size(), '\0');
+            in_file.read(text.data(), static_cast<std::streamsize>(text.size()));
+            return in_file && (text == prefix);
+        }
+
+        struct HistoryIndex
+        {
+            std::vector<IndexedRequest> entries;
+            /** Whether the index file is valid to its end, so that entries can be appended. */
+            bool appendable = false;
+        };
+
+        /**
+         * Read the history index, keeping the entries matching the history file.
+         *
+         * A trailing partial frame, left by an interrupted write, is ignored.
+         * The index is dropped if the history file was rewritten.
+         */
+        auto read_index(const fs::u8path& index_file, const fs::u8path& history_file)
+            -> HistoryIndex
+        {
+            auto index = HistoryIndex();
+            if (!fs::exists(index_file))
             {
-                continue;
+                return index;
             }
-            std::smatch base_match;
-            if (std::regex_match(line, base_match, head_re))
+
+            auto in = open_ifstream(index_file);
+            const auto data = std::string(
+                std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>()
+            );
+            if (!starts_with(data, history_index_header))
             {
-                ParseResult p;
-                p.head_line = base_match[1].str();
-                res.push_back(p);
+                LOG_DEBUG << "Invalid history index " << index_file;
+                return index;
             }
-            else if (line[0] == '#')
+
+            std::size_t pos = history_index_header.size();
+            index.appendable = true;
+            while (pos < data.size())
             {
-                if (res.size() > 0)
+                if (data.size() - pos < 4)
                 {
-                    res[res.size() - 1].comments.push_back(line);
+                    index.appendable = false;
+                    break;
                 }
-                else
+                std::size_t size = 0;
+                for (std::size_t i = 0; i < 4; ++i)
+                {
+                    size |= std::size_t(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+                }
+                pos += 4;
+                if (data.size() - pos < size)
+                {
+                    index.appendable = false;
+                    break;
+                }
+                try
                 {
-                    res.push_back(ParseResult());
-                    res[0].comments.push_back(line);
+                    const auto first = data.cbegin() + static_cast<std::ptrdiff_t>(pos);
+                    const auto last = first + static_cast<std::ptrdiff_t>(size);
+                    auto entry = from_json(nlohmann::json::from_msgpack(first, last));
+                    const auto expected_offset = index.entries.empty()
+                                                     ? 0
+                                                     : index.entries.back().end;
+                    if ((entry.offset != expected_offset) || (entry.end < entry.offset))
+                    {
+                        // For instance the same entries appended by concurrent readers
+                        index.appendable = false;
+                        break;
+                    }
+                    index.entries.push_back(std::move(entry));
                 }
+                catch (const std::exception& e)
+                {
+                    LOG_DEBUG << "Invalid history index entry in " << index_file << ": "
+                              << e.what();
+                    index.appendable = false;
+                    break;
+                }
+                pos += size;
             }
-            else if (line.size() != 0)
+
+            if (!index.entries.empty())
             {
-                if (res.size() > 0)
+                // The history file is only appended to, unless it was edited or replaced
+                const auto& last = index.entries.back();
+                auto ec = std::error_code();
+                const auto history_size = fs::file_size(history_file, ec);
+                const bool matches = !ec && (last.end <= history_size)
+                                     && (last.request.date.empty()
+                                         || text_starts_with(history_file, last.offset, "==>"))
+                                     && ((last.end == history_size)
+                                         || text_starts_with(history_file, last.end, "==>"));
+                if (!matches)
                 {
-                    res[res.size() - 1].diff.insert(line);
+                    LOG_DEBUG << "History index " << index_file << " is out of date";
+                    index = HistoryIndex();
                 }
-                else
+            }
+            return index;
+        }
+
+        void write_frames(std::ostream& out, const std::vector<IndexedRequest>& entries)
+        {
+            for (const auto& entry : entries)
+            {
+                const auto bytes = nlohmann::json::to_msgpack(to_json(entry));
+                char size[4];
+                for (std::size_t i = 0; i < 4; ++i)
+                {
+                    size[i] = static_cast<char>((bytes.size() >> (8 * i)) & 0xff);
+                }
+                out.write(size, 4);
+                out.write(
+                    reinterpret_cast<const char*>(bytes.data()),
+                    static_cast<std::streamsize>(bytes.size())
+                );
+            }
+        }
+
+        /**
+         * Append new entries to the index, or rewrite it if it cannot be appended to.
+         *
+         * The prefix may not be writable so failures are only logged.
+         */
+        void update_index(
+            const fs::u8path& index_file,
+            const HistoryIndex& index,
+            const std::vector<IndexedRequest>& new_entries
+        )
+        {
+            try
+            {
+                if (index.appendable)
+                {
+                    auto out = open_ofstream(index_file, std::ios::app | std::ios::binary);
+                    write_frames(out, new_entries);
+                    if (!out.flush())
+                    {
+                        throw std::runtime_error("could not write " + index_file.string());
+                    }
+                    return;
+                }
+
+                // Write to a temporary file so that concurrent readers never see a partial index
+                auto tmp_file = TemporaryFile("mambaf", "", index_file.parent_path());
                 {
-                    res.push_back(ParseResult());
-                    res[0].diff.insert(line);
+                    auto out = open_ofstream(tmp_file.path());
+                    out << history_index_header;
+                    write_frames(out, index.entries);
+                    write_frames(out, new_entries);
+                    if (!out.flush())
+                    {
+                        throw std::runtime_error("could not write " + tmp_file.path().string());
+                    }
                 }
+                fs::rename(tmp_file.path(), index_file);
             }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Could not write history index " << index_file << ": " << e.what();
+            }
+        }
+    }
+
+    History::History(const fs::u8path& prefix, ChannelContext& channel_context)
+        : m_prefix(prefix)
+        , m_history_file_path(fs::absolute(m_prefix / "conda-meta" / "history"))
+        , m_channel_context(channel_context)
+    {
+    }
+
+    History::UserRequest History::UserRequest::prefilled()
+    {
+        UserRequest ur;
+        std::time_t t = std::time(nullptr);
+        char mbstr[100];
+        if (std::strftime(mbstr, sizeof(mbstr), "%Y-%m-%d %H:%M:%S", std::localtime(&t)))
+        {
+            ur.date = mbstr;
+        }
+        ur.cmd = Context::instance().command_params.current_command;
+        ur.conda_version = Context::instance().command_params.conda_version;
+        return ur;
+    }
+
+    std::vector<History::ParseResult> History::parse()
+    {
+        LOG_INFO << "parsing history: " << m_history_file_path;
+        std::vector<ParseResult> res;
+        for (auto& entry : parse_entries(m_history_file_path, 0))
+        {
+            res.push_back(std::move(entry.result));
         }
         return res;
     }
@@ -164,27 +456,34 @@ namespace mamba
     std::vector<History::UserRequest> History::get_user_requests()
     {
         std::vector<UserRequest> res;
-        for (const auto& el : parse())
+        if (!fs::exists(m_history_file_path))
         {
-            UserRequest r;
-            r.date = el.head_line;
-            for (const auto& c : el.comments)
-            {
-                parse_comment_line(c, r);
-            }
+            return res;
+        }
 
-            for (const auto& x : el.diff)
-            {
-                if (x[0] == '-')
-                {
-                    r.unlink_dists.push_back(x.substr(1));
-                }
-                else if (x[0] == '+')
-                {
-                    r.link_dists.push_back(x.substr(1));
-                }
-            }
-            res.push_back(r);
+        // Only the entries added since the history file was last indexed are parsed
+        const auto index_file = m_history_file_path.parent_path() / history_index_filename;
+        const auto index = read_index(index_file, m_history_file_path);
+        const std::uint64_t indexed_end = index.entries.empty() ? 0 : index.entries.back().end;
+        LOG_INFO << "parsing history: " << m_history_file_path << " from offset " << indexed_end;
+        auto new_entries = std::vector<IndexedRequest>();
+        for (const auto& el : parse_entries(m_history_file_path, indexed_end))
+        {
+            new_entries.push_back({ to_user_request(*this, el.result), el.offset, el.end });
+        }
+        if (!new_entries.empty() || !index.appendable)
+        {
+            update_index(index_file, index, new_entries);
+        }
+
+        res.reserve(index.entries.size() + new_entries.size());
+        for (const auto& entry : index.entries)
+        {
+            res.push_back(entry.request);
+        }
+        for (auto& entry : new_entries)
+        {
+            res.push_back(std::move(entry.request));
         }
         // TODO add some stuff here regarding version of conda?
         return res;
@@ -292,5 +591,9 @@ namespace mamba
             out << specs_output("remove", entry.remove);
             out << specs_output("neutered", entry.neutered);
         }
+        out.close();
+
+        // Index the new entry
+        get_user_requests();
     }
 }  // namespace mamba
@@ -0,0 +1,350 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+#include <fmt/format.h>
+
+#include "mamba/core/util.hpp"
+#include "mamba/core/util_string.hpp"
+
+#include "jlap.hpp"
+
+namespace mamba::jlap
+{
+    /*************************************
+     * BLAKE2b implementation (RFC 7693) *
+     *************************************/
+
+    namespace
+    {
+        constexpr std::array<std::uint64_t, 8> blake2b_iv = {
+            0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+            0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179,
+        };
+
+        constexpr std::uint8_t blake2b_sigma[12][16] = {
+            { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+            { 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 },
+            { 11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4 },
+            { 7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8 },
+            { 9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13 },
+            { 2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9 },
+            { 12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11 },
+            { 13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10 },
+            { 6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5 },
+            { 10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0 },
+            { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+            { 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 },
+        };
+
+        class Blake2b
+        {
+        public:
+
+            static constexpr std::size_t block_size = 128;
+
+            Blake2b(std::size_t digest_size, std::string_view key)
+                : m_h(blake2b_iv)
+                , m_digest_size(digest_size)
+            {
+                m_h[0] ^= 0x01010000 ^ (key.size() << 8) ^ digest_size;
+                if (!key.empty())
+                {
+                    std::memcpy(m_buffer.data(), key.data(), key.size());
+                    m_buffer_size = block_size;
+                }
+            }
+
+            void update(std::string_view data)
+            {
+                while (!data.empty())
+                {
+                    // The last block must be compressed in final
+                    if (m_buffer_size == block_size)
+                    {
+                        m_counter += block_size;
+                        compress(false);
+                        m_buffer_size = 0;
+                    }
+                    const auto n = std::min(block_size - m_buffer_size, data.size());
+                    std::memcpy(m_buffer.data() + m_buffer_size, data.data(), n);
+                    m_buffer_size += n;
+                    data.remove_prefix(n);
+                }
+            }
+
+            auto final() -> digest
+            {
+                m_counter += m_buffer_size;
+                std::fill(
+                    m_buffer.begin() + static_cast<std::ptrdiff_t>(m_buffer_size),
+                    m_buffer.end(),
+                    0
+                );
+                compress(true);
+
+                auto out = digest{};
+                for (std::size_t i = 0; i < std::min(m_digest_size, out.size()); ++i)
+                {
+                    out[i] = static_cast<unsigned char>(m_h[i / 8] >> (8 * (i % 8)));
+                }
+                return out;
+            }
+
+        private:
+
+            std::array<std::uint64_t, 8> m_h;
+            std::array<unsigned char, block_size> m_buffer = {};
+            std::size_t m_buffer_size = 0;
+            std::uint64_t m_counter = 0;
+            std::size_t m_digest_size;
+
+            static auto rotr(std::uint64_t x, int n) -> std::uint64_t
+            {
+                return (x >> n) | (x << (64 - n));
+            }
+
+            void compress(bool last)
+            {
+                std::array<std::uint64_t, 16> m = {};
+                for (std::size_t i = 0; i < m.size(); ++i)
+                {
+                    for (std::size_t b = 0; b < 8; ++b)
+                    {
+                        m[i] |= std::uint64_t(m_buffer[8 * i + b]) << (8 * b);
+                    }
+                }
+
+                std::array<std::uint64_t, 16> v = {};
+                std::copy(m_h.begin(), m_h.end(), v.begin());
+                std::copy(blake2b_iv.begin(), blake2b_iv.end(), v.begin() + 8);
+                // The high 64 bits of the counter are always zero for our sizes
+                v[12] ^= m_counter;
+                if (last)
+                {
+                    v[14] = ~v[14];
+                }
+
+                auto g = [&](std::size_t a,
+                             std::size_t b,
+                             std::size_t c,
+                             std::size_t d,
+                             std::uint64_t x,
+                             std::uint64_t y)
+                {
+                    v[a] = v[a] + v[b] + x;
+                    v[d] = rotr(v[d] ^ v[a], 32);
+                    v[c] = v[c] + v[d];
+                    v[b] = rotr(v[b] ^ v[c], 24);
+                    v[a] = v[a] + v[b] + y;
+                    v[d] = rotr(v[d] ^ v[a], 16);
+                    v[c] = v[c] + v[d];
+                    v[b] = rotr(v[b] ^ v[c], 63);
+                };
+
+                for (const auto& s : blake2b_sigma)
+                {
+                    g(0, 4, 8, 12, m[s[0]], m[s[1]]);
+                    g(1, 5, 9, 13, m[s[2]], m[s[3]]);
+                    g(2, 6, 10, 14, m[s[4]], m[s[5]]);
+                    g(3, 7, 11, 15, m[s[6]], m[s[7]]);
+                    g(0, 5, 10, 15, m[s[8]], m[s[9]]);
+                    g(1, 6, 11, 12, m[s[10]], m[s[11]]);
+                    g(2, 7, 8, 13, m[s[12]], m[s[13]]);
+                    g(3, 4, 9, 14, m[s[14]], m[s[15]]);
+                }
+
+                for (std::size_t i = 0; i < m_h.size(); ++i)
+                {
+                    m_h[i] ^= v[i] ^ v[i + 8];
+                }
+            }
+        };
+
+        auto as_string_view(const digest& d) -> std::string_view
+        {
+            return { reinterpret_cast<const char*>(d.data()), d.size() };
+        }
+
+        auto from_hex(std::string_view hex) -> std::optional<digest>
+        {
+            auto nibble = [](char c) -> int
+            {
+                if ((c >= '0') && (c <= '9'))
+                {
+                    return c - '0';
+                }
+                if ((c >= 'a') && (c <= 'f'))
+                {
+                    return c - 'a' + 10;
+                }
+                if ((c >= 'A') && (c <= 'F'))
+                {
+                    return c - 'A' + 10;
+                }
+                return -1;
+            };
+
+            auto out = digest{};
+            if (hex.size() != 2 * out.size())
+            {
+                return std::nullopt;
+            }
+            for (std::size_t i = 0; i < out.size(); ++i)
+            {
+                const int hi = nibble(hex[2 * i]);
+                const int lo = nibble(hex[2 * i + 1]);
+                if ((hi < 0) || (lo < 0))
+                {
+                    return std::nullopt;
+                }
+                out[i] = static_cast<unsigned char>((hi << 4) | lo);
+            }
+            return out;
+        }
+
+        auto invalid(std::string_view msg) -> tl::unexpected<mamba_error>
+        {
+            return make_unexpected(
+                fmt::format("Invalid jlap file: {}", msg),
+                mamba_error_code::repodata_not_loaded
+            );
+        }
+    }
+
+    auto blake2b_256(std::string_view data, std::string_view key) -> digest
+    {
+        auto hasher = Blake2b(digest{}.size(), key.substr(0, 64));
+        hasher.update(data);
+        return hasher.final();
+    }
+
+    auto blake2b_256_file_hex(const fs::u8path& file) -> std::string
+    {
+        auto hasher = Blake2b(digest{}.size(), {});
+        auto infile = open_ifstream(file, std::ios::in | std::ios::binary);
+        auto buffer = std::array<char, 1 << 16>{};
+        while (infile)
+        {
+            infile.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            hasher.update({ buffer.data(), static_cast<std::size_t>(infile.gcount()) });
+        }
+        return hex_string(hasher.final());
+    }
+
+    /*********************
+     * JLAP file parsing *
+     *********************/
+
+    auto parse(std::string_view content, const Position& start) -> expected_t<Patches>
+    {
+        struct Line
+        {
+            std::size_t offset;
+            std::string_view text;
+        };
+
+        const bool from_start = start.iv.empty();
+        const std::size_t base_offset = from_start ? 0 : start.offset;
+
+        auto lines = std::vector<Line>();
+        for (std::size_t pos = 0; pos < content.size();)
+        {
+            const auto end = std::min(content.find('\n', pos), content.size());
+            lines.push_back({ base_offset + pos, content.substr(pos, end - pos) });
+            pos = end + 1;
+        }
+
+        auto iv = from_hex(from_start ? (lines.empty() ? "" : lines.front().text) : start.iv);
+        if (!iv)
+        {
+            return invalid("bad initialization vector");
+        }
+        const std::size_t first = from_start ? 1 : 0;
+        // At least the metadata and checksum lines
+        if (lines.size() < first + 2)
+        {
+            return invalid("missing trailing lines");
+        }
+        const std::size_t metadata_idx = lines.size() - 2;
+
+        auto out = Patches();
+        for (std::size_t i = first; i <= metadata_idx; ++i)
+        {
+            if (i == metadata_idx)
+            {
+                out.next = { hex_string(*iv), lines[i].offset };
+            }
+            iv = blake2b_256(lines[i].text, as_string_view(*iv));
+        }
+        if (hex_string(*iv) != strip(lines.back().text))
+        {
+            return invalid("checksum mismatch");
+        }
+
+        try
+        {
+            for (std::size_t i = first; i < metadata_idx; ++i)
+            {
+                out.patches.push_back(nlohmann::json::parse(lines[i].text));
+            }
+            out.latest = nlohmann::json::parse(lines[metadata_idx].text)
+                             .at("latest")
+                             .get<std::string>();
+        }
+        catch (const nlohmann::json::exception& e)
+        {
+            return invalid(e.what());
+        }
+        return { std::move(out) };
+    }
+
+    auto patch_to_latest(const Patches& patches, const std::string& from)
+        -> expected_t<nlohmann::json>
+    {
+        try
+        {
+            // Walk back from the latest hash, as older patches may not be relevant to us
+            auto chain = std::vector<const nlohmann::json*>();
+            auto current = patches.latest;
+            while (current != from)
+            {
+                const auto it = std::find_if(
+                    patches.patches.crbegin(),
+                    patches.patches.crend(),
+                    [&](const nlohmann::json& p) { return p.value("to", "") == current; }
+                );
+                if ((it == patches.patches.crend()) || (chain.size() >= patches.patches.size()))
+                {
+                    return make_unexpected(
+                        fmt::format("No jlap patches from {} to {}", from, patches.latest),
+                        mamba_error_code::repodata_not_loaded
+                    );
+                }
+                chain.push_back(&(*it));
+                current = it->value("from", "");
+            }
+
+            auto out = nlohmann::json::array();
+            for (auto it = chain.crbegin(); it != chain.crend(); ++it)
+            {
+                for (const auto& op : (*it)->at("patch"))
+                {
+                    out.push_back(op);
+                }
+            }
+            return { std::move(out) };
+        }
+        catch (const nlohmann::json::exception& e)
+        {
+            return invalid(e.what());
+        }
+    }
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_JLAP_HPP
+#define MAMBA_CORE_JLAP_HPP
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/error_handling.hpp"
+#include "mamba/core/mamba_fs.hpp"
+
+/**
+ * Support for JLAP, the JSON patch log of ``repodata.json`` published alongside it as
+ * ``repodata.jlap``.
+ *
+ * The file is made of lines:
+ *  - The first line is a 256 bits hexadecimal initialization vector;
+ *  - Each following line is a patch ``{"from": <hash>, "to": <hash>, "patch": [...]}``
+ *    where hashes are the BLAKE2b-256 of ``repodata.json`` and the patch a RFC 6902 JSON Patch;
+ *  - The penultimate line is metadata ``{"url": "repodata.json", "latest": <hash>}``;
+ *  - The last line is the rolling hash of all lines but the first and last, where each line
+ *    is hashed with BLAKE2b-256 keyed by the hash of the previous lines.
+ *
+ * New patches are written over the metadata line, so a client that remembers where that line
+ * started, along with the rolling hash before it, can range request only the file tail.
+ */
+namespace mamba::jlap
+{
+    using digest = std::array<unsigned char, 32>;
+
+    /** BLAKE2b hash with a 256 bits digest, keyed if @p key is non empty (at most 64 bytes). */
+    auto blake2b_256(std::string_view data, std::string_view key = {}) -> digest;
+
+    /** Lowercase hexadecimal BLAKE2b-256 of a file content. */
+    auto blake2b_256_file_hex(const fs::u8path& file) -> std::string;
+
+    /** Where to resume reading the jlap file from. */
+    struct Position
+    {
+        /** Hexadecimal rolling hash of the lines before @ref offset, empty to read from start. */
+        std::string iv = {};
+        /** Byte offset of the metadata line. */
+        std::size_t offset = 0;
+    };
+
+    struct Patches
+    {
+        /** The patch lines, in file order. */
+        std::vector<nlohmann::json> patches;
+        /** The hash of the latest repodata.json. */
+        std::string latest;
+        /** Where the next (range) read should start. */
+        Position next;
+    };
+
+    /**
+     * Parse and verify the rolling hash of a jlap content.
+     *
+     * @param content The full file if ``start.iv`` is empty, otherwise the file tail starting
+     *                at ``start.offset``.
+     */
+    auto parse(std::string_view content, const Position& start) -> expected_t<Patches>;
+
+    /**
+     * Compute the single patch leading a repodata.json with hash @p from to the latest one.
+     *
+     * The operations of each patch in the chain are concatenated in order. The patch is empty
+     * if @p from is already the latest. An error is returned if no chain of patches lead
+     * to the latest hash.
+     */
+    auto patch_to_latest(const Patches& patches, const std::string& from)
+        -> expected_t<nlohmann::json>;
+}
+#endif
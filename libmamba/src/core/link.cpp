@@ -4,20 +4,41 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <fstream>
 #include <iostream>
+#include <mutex>
 #include <regex>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
 #include <reproc++/reproc.hpp>
 #include <reproc++/run.hpp>
 
+#include "mamba/core/context.hpp"
 #include "mamba/core/environment.hpp"
+#include "mamba/core/fsutil.hpp"
 #include "mamba/core/link.hpp"
 #include "mamba/core/match_spec.hpp"
 #include "mamba/core/menuinst.hpp"
 #include "mamba/core/output.hpp"
+#include "mamba/core/package_cache.hpp"
+#include "mamba/core/thread_utils.hpp"
+#include "mamba/core/tracing.hpp"
 #include "mamba/core/transaction_context.hpp"
 #include "mamba/core/util_os.hpp"
 #include "mamba/core/util_string.hpp"
@@ -27,70 +48,134 @@
 #include "../data/conda_exe.hpp"
 #endif
 
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include "prefix_replacement.hpp"
+#include "relocation_cache.hpp"
+
 namespace mamba
 {
     static const std::regex MENU_PATH_REGEX("^menu[/\\\\].*\\.json$", std::regex_constants::icase);
 
-    void python_entry_point_template(std::ostream& out, const python_entry_point_parsed& p)
+    void python_entry_point_template(std::string& out, const python_entry_point_parsed& p)
     {
-        auto import_name = split(p.func, ".")[0];
-        out << "# -*- coding: utf-8 -*-\n";
-        out << "import re\n";
-        out << "import sys\n\n";
+        const auto import_name = std::get<0>(split_once(p.func, '.'));
+        out += "# -*- coding: utf-8 -*-\n";
+        out += "import re\n";
+        out += "import sys\n\n";
 
-        out << "from " << p.module << " import " << import_name << "\n\n";
+        out += concat("from ", p.module, " import ", import_name, "\n\n");
 
-        out << "if __name__ == '__main__':\n";
-        out << "    sys.argv[0] = re.sub(r'(-script\\.pyw?|\\.exe)?$', '', "
+        out += "if __name__ == '__main__':\n";
+        out += "    sys.argv[0] = re.sub(r'(-script\\.pyw?|\\.exe)?$', '', "
                "sys.argv[0])\n";
-        out << "    sys.exit(" << p.func << "())\n";
+        out += concat("    sys.exit(", p.func, "())\n");
     }
 
-    void application_entry_point_template(std::ostream& out, std::string_view source_full_path)
+    void application_entry_point_template(std::string& out, std::string_view source_full_path)
     {
-        out << "# -*- coding: utf-8 -*-\n";
-        out << "if __name__ == '__main__':\n";
-        out << "    import os\n";
-        out << "    import sys\n";
-        out << "    args = ['" << source_full_path << "']\n";
-        out << "    if len(sys.argv) > 1:\n";
-        out << "        args += sys.argv[1:]\n";
-        out << "    os.execv(args[0], args)\n";
+        out += "# -*- coding: utf-8 -*-\n";
+        out += "if __name__ == '__main__':\n";
+        out += "    import os\n";
+        out += "    import sys\n";
+        out += concat("    args = ['", source_full_path, "']\n");
+        out += "    if len(sys.argv) > 1:\n";
+        out += "        args += sys.argv[1:]\n";
+        out += "    os.execv(args[0], args)\n";
     }
 
-    fs::u8path pyc_path(const fs::u8path& py_path, const std::string& py_ver)
+    namespace
     {
-        /*
-        This must not return backslashes on Windows as that will break
-        tests and leads to an eventual need to make url_to_path return
-        backslashes too and that may end up changing files on disc or
-        to the result of comparisons with the contents of them.
-        */
-        if (py_ver[0] == '2')
+        /**
+         * Whether @p pyc was compiled from @p py as it currently is.
+         *
+         * This is the check of ``compileall`` for timestamp based pyc files (PEP 552), whose
+         * header stores the modification time and size of the source.
+         */
+        bool is_pyc_up_to_date(const fs::u8path& py, const fs::u8path& pyc)
         {
-            // make `.pyc` file in same directory
-            return concat(py_path.string(), 'c');
+#ifdef _WIN32
+            // Comparing modification times needs more than the standard library
+            return false;
+#else
+            std::array<unsigned char, 16> header = {};
+            std::ifstream pyc_file(pyc.std_path(), std::ios::in | std::ios::binary);
+            if (!pyc_file.read(reinterpret_cast<char*>(header.data()), header.size()))
+            {
+                return false;
+            }
+            const auto read_uint32 = [&](std::size_t pos)
+            {
+                return std::uint32_t(header[pos]) | (std::uint32_t(header[pos + 1]) << 8)
+                       | (std::uint32_t(header[pos + 2]) << 16)
+                       | (std::uint32_t(header[pos + 3]) << 24);
+            };
+            struct ::stat py_stat;
+            if (::stat(py.string().c_str(), &py_stat) != 0)
+            {
+                return false;
+            }
+            return (read_uint32(4) == 0)
+                   && (read_uint32(8) == static_cast<std::uint32_t>(py_stat.st_mtime))
+                   && (read_uint32(12) == static_cast<std::uint32_t>(py_stat.st_size));
+#endif
         }
-        else
+    }
+
+    namespace
+    {
+        /** Above this capacity, the scratch buffer of a thread is released once used. */
+        constexpr std::size_t max_kept_scratch_capacity = 16 << 20;
+
+        /**
+         * An empty buffer to build the contents of a file before writing it at once.
+         *
+         * The buffer is reused by the files written from the same thread, so that linking
+         * many files does not allocate a new buffer for each of them.
+         */
+        std::string& scratch_buffer()
+        {
+            thread_local std::string buffer;
+            if (buffer.capacity() > max_kept_scratch_capacity)
+            {
+                std::string().swap(buffer);
+            }
+            buffer.clear();
+            return buffer;
+        }
+
+        auto sha256_of(std::string_view data) -> std::string
+        {
+            auto hash = validation::HashStream::sha256();
+            hash.update(data.data(), data.size());
+            return hash.hex_digest();
+        }
+
+        /** Link a pyc file of the package cache into the prefix, or copy it. */
+        bool link_cached_pyc(const fs::u8path& cached_pyc, const fs::u8path& pyc)
         {
-            auto directory = py_path.parent_path();
-            auto py_file_stem = py_path.stem();
-            std::string py_ver_nodot = py_ver;
-            replace_all(py_ver_nodot, ".", "");
-            return directory / fs::u8path("__pycache__")
-                   / concat(py_file_stem.string(), ".cpython-", py_ver_nodot, ".pyc");
+            std::error_code ec;
+            fs::create_directories(pyc.parent_path(), ec);
+            fs::remove(pyc, ec);
+            fs::create_hard_link(cached_pyc, pyc, ec);
+            if (ec)
+            {
+                ec.clear();
+                fs::copy_file(cached_pyc, pyc, ec);
+            }
+            return !ec;
         }
     }
 
     python_entry_point_parsed parse_entry_point(const std::string& ep_def)
     {
         // def looks like: "wheel = wheel.cli:main"
-        auto cmd_mod_func = rsplit(ep_def, ":", 1);
-        auto command_module = rsplit(cmd_mod_func[0], "=", 1);
+        const auto [command_module, func] = rsplit_once(ep_def, ':');
+        const auto [command, module] = rsplit_once(command_module.value_or(""), '=');
         python_entry_point_parsed result;
-        result.command = strip(command_module[0]);
-        result.module = strip(command_module[1]);
-        result.func = strip(cmd_mod_func[1]);
+        result.command = strip(command.value_or(""));
+        result.module = strip(module);
+        result.func = strip(func);
         return result;
     }
 
@@ -152,7 +237,7 @@ namespace mamba
             m_clobber_warnings.push_back(fs::relative(script_path, m_context->target_prefix).string());
             fs::remove(script_path);
         }
-        std::ofstream out_file = open_ofstream(script_path);
+        auto& contents = scratch_buffer();
 
         fs::u8path python_path;
         if (m_context->has_python)
@@ -161,11 +246,12 @@ namespace mamba
         }
         if (!python_path.empty())
         {
-            out_file << python_shebang(python_path.string()) << "\n";
+            contents += python_shebang(python_path.string());
+            contents += "\n";
         }
 
-        python_entry_point_template(out_file, entry_point);
-        out_file.close();
+        python_entry_point_template(contents, entry_point);
+        write_contents(script_path, contents);
 
 #ifdef _WIN32
         fs::u8path script_exe = path;
@@ -177,12 +263,10 @@ namespace mamba
             fs::remove(m_context->target_prefix / script_exe);
         }
 
-        std::ofstream conda_exe_f = open_ofstream(
+        write_contents(
             m_context->target_prefix / script_exe,
-            std::ios::binary
+            { reinterpret_cast<char*>(conda_exe), conda_exe_len }
         );
-        conda_exe_f.write(reinterpret_cast<char*>(conda_exe), conda_exe_len);
-        conda_exe_f.close();
         make_executable(m_context->target_prefix / script_exe);
         return std::array<std::string, 2>{ win_script, script_exe.string() };
 #else
@@ -246,10 +330,10 @@ namespace mamba
             fs::create_directories(target_full_path.parent_path());
         }
 
-        std::ofstream out_file = open_ofstream(target_full_path);
-        out_file << "!#" << python_full_path.string() << "\n";
-        application_entry_point_template(out_file, win_path_double_escape(source_full_path.string()));
-        out_file.close();
+        auto& contents = scratch_buffer();
+        contents += concat("!#", python_full_path.string(), "\n");
+        application_entry_point_template(contents, win_path_double_escape(source_full_path.string()));
+        write_contents(target_full_path, contents);
 
         make_executable(target_full_path);
     }
@@ -280,6 +364,7 @@ namespace mamba
     std::string get_prefix_messages(const fs::u8path& prefix)
     {
         auto messages_file = prefix / ".messages.txt";
+        std::string messages;
         if (fs::exists(messages_file))
         {
             try
@@ -291,29 +376,47 @@ namespace mamba
                     std::istreambuf_iterator<char>(),
                     std::ostreambuf_iterator<char>(res)
                 );
-                return res.str();
+                messages = res.str();
             }
             catch (...)
             {
                 // ignore
             }
-            fs::remove(messages_file);
+            // Not read again after the next script
+            std::error_code ec;
+            fs::remove(messages_file, ec);
+        }
+        return messages;
+    }
+
+    /** Whether the @p script writes the messages file, read by ``get_prefix_messages``. */
+    bool writes_prefix_messages(const fs::u8path& script)
+    {
+        try
+        {
+            return read_contents(script).find(".messages.txt") != std::string::npos;
+        }
+        catch (...)
+        {
+            // Assume it does, to keep its messages apart
+            return true;
         }
-        return "";
     }
 
     /*
        call the post-link or pre-unlink script and return true / false on success /
-       failure
+       failure, its messages stored in the transaction context if any
     */
     bool run_script(
         const fs::u8path& prefix,
         const PackageInfo& pkg_info,
+        TransactionContext* context,
         const std::string& action = "post-link",
         const std::string& env_prefix = "",
         bool activate = false
     )
     {
+        auto trace = Tracer::instance().scope(action + " " + pkg_info.name);
         fs::u8path path;
         if (on_win)
         {
@@ -434,17 +537,33 @@ namespace mamba
                   << "\n PKG_BUILDNUM: " << envmap["PKG_BUILDNUM"] << "\n PATH: " << envmap["PATH"]
                   << "\n CWD: " << cwd;
 
-        auto [status, ec] = reproc::run(command_args, options);
-
-        auto msg = get_prefix_messages(envmap["PREFIX"]);
-        if (Context::instance().output_params.json)
+        int status = 0;
+        std::error_code ec;
+        std::string msg;
+        const auto run = [&]
         {
-            // TODO implement cerr also on Console?
-            std::cerr << msg;
+            std::tie(status, ec) = reproc::run(command_args, options);
+            // Read while holding the script slot, as all the scripts write the same file
+            msg = get_prefix_messages(envmap["PREFIX"]);
+        };
+        if (context != nullptr)
+        {
+            // Run alone, so that its messages are not mixed with the ones of another script
+            context->run_package_script(run, writes_prefix_messages(path));
+            context->add_script_messages(pkg_info.name, std::move(msg));
         }
         else
         {
-            Console::instance().print(msg);
+            run();
+            if (Context::instance().output_params.json)
+            {
+                // TODO implement cerr also on Console?
+                std::cerr << msg;
+            }
+            else
+            {
+                Console::instance().print(msg);
+            }
         }
 
         if (ec)
@@ -459,6 +578,38 @@ namespace mamba
         return true;
     }
 
+    void remove_empty_directories(std::vector<fs::u8path> directories, const fs::u8path& prefix)
+    {
+        // Deepest first, so that emptied parents are removed after their children
+        std::sort(directories.begin(), directories.end());
+        directories.erase(std::unique(directories.begin(), directories.end()), directories.end());
+        for (auto it = directories.rbegin(); it != directories.rend(); ++it)
+        {
+            auto parent_path = *it;
+            std::error_code err;
+            while ((parent_path != prefix) && fs::exists(parent_path, err) && !err
+                   && fs::is_empty(parent_path, err) && !err)
+            {
+                remove_or_rename(parent_path);
+                parent_path = parent_path.parent_path();
+            }
+        }
+    }
+
+    namespace
+    {
+        std::size_t link_threads(std::size_t n_paths)
+        {
+            // Below this number of files per thread, starting threads does not pay off
+            constexpr std::size_t min_paths_per_thread = 64;
+
+            return std::min(
+                clamp_worker_threads(Context::instance().threads_params.link_threads),
+                std::max<std::size_t>(n_paths / min_paths_per_thread, 1)
+            );
+        }
+    }
+
     UnlinkPackage::UnlinkPackage(
         const PackageInfo& pkg_info,
         const fs::u8path& cache_path,
@@ -471,129 +622,192 @@ namespace mamba
     {
     }
 
-    bool UnlinkPackage::unlink_path(const nlohmann::json& path_data)
+    UnlinkPackage::UnlinkPackage(
+        const PackageInfo& pkg_info,
+        const fs::u8path& cache_path,
+        TransactionContext* context,
+        std::vector<std::string> paths
+    )
+        : m_pkg_info(pkg_info)
+        , m_cache_path(cache_path)
+        , m_specifier(m_pkg_info.str())
+        , m_context(context)
+        , m_paths(std::move(paths))
+    {
+    }
+
+    bool UnlinkPackage::unlink_path(const std::string& subtarget)
     {
-        std::string subtarget = path_data["_path"].get<std::string>();
         fs::u8path dst = m_context->target_prefix / subtarget;
 
         LOG_TRACE << "Unlinking '" << dst.string() << "'";
-        std::error_code err;
-
         if (remove_or_rename(dst) == 0)
         {
             LOG_DEBUG << "Error when removing file '" << dst.string() << "' will be ignored";
         }
-
-        // TODO what do we do with empty directories?
-        // remove empty parent path
-        auto parent_path = dst.parent_path();
-        while (true)
-        {
-            bool exists = fs::exists(parent_path, err);
-            if (err)
-            {
-                break;
-            }
-            if (exists)
-            {
-                bool is_empty = fs::is_empty(parent_path, err);
-                if (err)
-                {
-                    break;
-                }
-                if (is_empty)
-                {
-                    remove_or_rename(parent_path);
-                }
-                else
-                {
-                    break;
-                }
-            }
-            parent_path = parent_path.parent_path();
-            if (parent_path == m_context->target_prefix)
-            {
-                break;
-            }
-        }
         return true;
     }
 
     bool UnlinkPackage::execute()
     {
+        auto trace = Tracer::instance().scope("unlink " + m_specifier);
         // find the recorded JSON file
-        fs::u8path json = m_context->target_prefix / "conda-meta" / (m_specifier + ".json");
+        fs::u8path json = m_context->record_path(m_specifier + ".json");
         LOG_INFO << "Unlinking package '" << m_specifier << "'";
-        LOG_DEBUG << "Use metadata found at '" << json.string() << "'";
 
-        std::ifstream json_file = open_ifstream(json);
-        nlohmann::json json_record;
-        json_file >> json_record;
+        // Without reading the record, if indexed
+        auto paths = m_paths.has_value() ? m_paths : m_context->file_index().files(m_specifier);
+        if (!paths.has_value())
+        {
+            LOG_DEBUG << "Use metadata found at '" << json.string() << "'";
+
+            std::ifstream json_file = open_ifstream(json);
+            nlohmann::json json_record;
+            json_file >> json_record;
 
-        for (auto& path : json_record["paths_data"]["paths"])
+            paths.emplace();
+            for (auto& path : json_record["paths_data"]["paths"])
+            {
+                paths->push_back(path["_path"].get<std::string>());
+            }
+        }
+
+        for (const auto& fpath : paths.value())
         {
-            std::string fpath = path["_path"];
             if (std::regex_match(fpath, MENU_PATH_REGEX))
             {
                 remove_menu_from_json(m_context->target_prefix / fpath, m_context);
             }
-
-            unlink_path(path);
         }
 
-        json_file.close();
+        // Files are independent, they are removed concurrently
+        const std::size_t n_threads = link_threads(paths->size());
+        LOG_TRACE << "Unlinking " << paths->size() << " files with " << n_threads << " threads";
+        parallel_for(paths->size(), n_threads, [&](std::size_t i) { unlink_path((*paths)[i]); });
 
-        fs::remove(json);
+        // Emptied directories are removed once, from the deepest, rather than after each file
+        for (const auto& fpath : paths.value())
+        {
+            auto dir = (m_context->target_prefix / fpath).parent_path();
+            if (m_unlinked_directories.empty() || (m_unlinked_directories.back() != dir))
+            {
+                m_unlinked_directories.push_back(std::move(dir));
+            }
+        }
+        if (!m_paths.has_value())
+        {
+            remove_empty_directories(m_unlinked_directories, m_context->target_prefix);
+            m_unlinked_directories.clear();
+        }
+
+        m_context->remove_record(m_specifier + ".json");
+        m_context->file_index().remove(m_specifier);
 
         return true;
     }
 
+    const std::vector<fs::u8path>& UnlinkPackage::unlinked_directories() const
+    {
+        return m_unlinked_directories;
+    }
+
     bool UnlinkPackage::undo()
     {
         LinkPackage lp(m_pkg_info, m_cache_path, m_context);
+        lp.m_interruptible = false;
         return lp.execute();
     }
 
+    LinkPlan make_link_plan(
+        const fs::u8path& pkg_dir,
+        const TransactionContext& context,
+        bool noarch_python
+    )
+    {
+        auto plan = LinkPlan();
+        plan.source = pkg_dir;
+        plan.noarch_python = noarch_python;
+        auto paths_data = read_paths(pkg_dir);
+        const auto excluded_paths = read_excluded_paths(pkg_dir);
+        plan.files.reserve(paths_data.size());
+        plan.targets.reserve(paths_data.size());
+        for (auto& path : paths_data)
+        {
+            if ((excluded_paths.count(path.path) > 0)
+                || is_excluded_path(context.exclude_files, path.path))
+            {
+                plan.excluded_files.push_back(std::move(path.path));
+                continue;
+            }
+            plan.targets.push_back(
+                noarch_python ? context.noarch_python_paths.target_path(path.path) : path.path
+            );
+            plan.files.push_back(std::move(path));
+        }
+        return plan;
+    }
+
     LinkPackage::LinkPackage(
         const PackageInfo& pkg_info,
         const fs::u8path& cache_path,
-        TransactionContext* context
+        TransactionContext* context,
+        nlohmann::json repodata_record,
+        std::optional<LinkPlan> plan
     )
         : m_pkg_info(pkg_info)
         , m_cache_path(cache_path)
         , m_source(cache_path / m_pkg_info.str())
+        , m_repodata_record(std::move(repodata_record))
+        , m_plan(std::move(plan))
         , m_context(context)
     {
     }
 
     std::tuple<std::string, std::string>
-    LinkPackage::link_path(const PathData& path_data, bool noarch_python)
+    LinkPackage::link_path(const PathData& path_data, const std::string& target)
     {
-        std::string subtarget = path_data.path;
+        const std::string& subtarget = path_data.path;
         LOG_TRACE << "linking '" << subtarget << "'";
-        fs::u8path dst, rel_dst;
-        if (noarch_python)
-        {
-            rel_dst = get_python_noarch_target_path(subtarget, m_context->site_packages_path);
-            dst = m_context->target_prefix / rel_dst;
-        }
-        else
-        {
-            rel_dst = subtarget;
-            dst = m_context->target_prefix / rel_dst;
-        }
+        const fs::u8path rel_dst = target;
+        const fs::u8path dst = m_context->target_prefix / rel_dst;
 
         fs::u8path src = m_source / subtarget;
         if (!fs::exists(dst.parent_path()))
         {
-            fs::create_directories(dst.parent_path());
+            // Other files of the package may be creating it concurrently
+            std::error_code dir_ec;
+            fs::create_directories(dst.parent_path(), dir_ec);
+            if (dir_ec && !fs::is_directory(dst.parent_path()))
+            {
+                throw std::filesystem::filesystem_error(
+                    "cannot create directories",
+                    dst.parent_path().std_path(),
+                    dir_ec
+                );
+            }
         }
 
         std::error_code ec;
         if (lexists(dst, ec) && !ec)
         {
             // Sometimes we might want to raise here ...
-            m_clobber_warnings.push_back(rel_dst.string());
+            {
+                // Files are linked concurrently, and clobbering is rare enough to lock globally
+                static std::mutex clobber_mutex;
+                // Files of other packages are found without reading their records
+                const auto owner = m_context->file_index().find(rel_dst.string());
+                std::lock_guard<std::mutex> lock(clobber_mutex);
+                if (owner.has_value() && (owner->package != m_pkg_info.str()))
+                {
+                    m_clobber_warnings.push_back(
+                        concat(rel_dst.string(), " (from ", owner->package, ")")
+                    );
+                }
+                else
+                {
+                    m_clobber_warnings.push_back(rel_dst.string());
+                }
+            }
 #ifdef _WIN32
             return std::make_tuple(validation::sha256sum(dst), rel_dst.string());
 #endif
@@ -616,38 +830,70 @@ namespace mamba
 #ifdef _WIN32
             replace_all(new_prefix, "\\", "/");
 #endif
+            // Files relocated to the same prefix before are linked from the package cache
+            std::string relocation_key;
+            if (m_context->relocation_cache && !path_data.sha256.empty()
+                && (!on_win || (path_data.file_mode != FileMode::BINARY)))
+            {
+                relocation_key = RelocationCache::key(
+                    path_data.sha256,
+                    path_data.prefix_placeholder,
+                    new_prefix,
+                    path_data.file_mode
+                );
+                const bool copy = path_data.no_link || m_context->always_copy;
+                if (auto sha256 = RelocationCache(m_cache_path).link(relocation_key, dst, copy))
+                {
+                    return std::make_tuple(std::move(*sha256), rel_dst.string());
+                }
+            }
+
             LOG_TRACE << "Copying file & replace prefix " << src << " -> " << dst;
             // TODO windows does something else here
 
-            std::string buffer;
-            if (path_data.file_mode != FileMode::BINARY)
+            // Files are streamed from their memory mapping when they can be mapped
+            const auto mapped = MappedFile::open(src);
+            std::string contents;
+            if (!mapped)
             {
-                buffer = read_contents(src, std::ios::in | std::ios::binary);
-                replace_all(buffer, path_data.prefix_placeholder, new_prefix);
+                contents = read_contents(src, std::ios::in | std::ios::binary);
+            }
+            const std::string_view data = mapped ? mapped->data() : std::string_view(contents);
+            const auto replacer = PrefixReplacer(path_data.prefix_placeholder, new_prefix);
+            // The checksum of the relocated contents, when known without reading the file
+            std::string sha256_in_prefix;
 
+            if (path_data.file_mode != FileMode::BINARY)
+            {
+                auto& relocated = scratch_buffer();
+                relocated.reserve(data.size());
+                std::string_view rest = data;
                 if constexpr (!on_win)  // only on non-windows platforms
                 {
                     // we need to check the first line for a shebang and replace it if it's too long
-                    if (buffer[0] == '#' && buffer[1] == '!')
+                    if (starts_with(data, "#!"))
                     {
-                        std::size_t end_of_line = buffer.find_first_of('\n');
-                        std::string first_line = buffer.substr(0, end_of_line);
-                        if (first_line.size() > MAX_SHEBANG_LENGTH)
+                        const std::size_t end_of_line = std::min(data.find('\n'), data.size());
+                        replacer.write_text(data.substr(0, end_of_line), relocated);
+                        if (relocated.size() > MAX_SHEBANG_LENGTH)
                         {
-                            std::string new_shebang = replace_long_shebang(first_line);
-                            buffer.replace(0, end_of_line, new_shebang);
+                            relocated = replace_long_shebang(relocated);
                         }
+                        rest = data.substr(end_of_line);
                     }
                 }
+                replacer.write_text(rest, relocated);
+                write_contents(dst, relocated);
+                sha256_in_prefix = sha256_of(relocated);
             }
             else
             {
                 assert(path_data.file_mode == FileMode::BINARY);
-                buffer = read_contents(src, std::ios::in | std::ios::binary);
 
 #ifdef _WIN32
-                auto has_pyzzer_entrypoint = [](const std::string& data)
-                { return data.rfind("PK\x05\x06"); };
+                const std::string buffer(data);
+                auto has_pyzzer_entrypoint = [](const std::string& content)
+                { return content.rfind("PK\x05\x06"); };
 
                 // on win we only replace pyzzer entrypoints apparently
                 auto entry_point = has_pyzzer_entrypoint(buffer);
@@ -689,40 +935,23 @@ namespace mamba
                     }
                     return std::make_tuple(validation::sha256sum(dst), rel_dst.string());
                 }
+
+                write_contents(dst, data);
 #else
-                std::size_t padding_size = (path_data.prefix_placeholder.size() > new_prefix.size())
-                                               ? path_data.prefix_placeholder.size()
-                                                     - new_prefix.size()
-                                               : 0;
-                std::string padding(padding_size, '\0');
-
-                std::size_t pos = buffer.find(path_data.prefix_placeholder);
-                while (pos != std::string::npos)
-                {
+                auto& relocated = scratch_buffer();
+                relocated.reserve(data.size());
+                [[maybe_unused]] const std::size_t n_replaced = replacer.write_binary(
+                    data,
+                    relocated
+                );
+                write_contents(dst, relocated);
+                sha256_in_prefix = sha256_of(relocated);
 #if defined(__APPLE__)
-                    binary_changed = true;
+                binary_changed = n_replaced > 0;
 #endif
-                    std::size_t end = pos + path_data.prefix_placeholder.size();
-                    std::string suffix;
-
-                    while (end < buffer.size() && buffer[end] != '\0')
-                    {
-                        suffix += buffer[end];
-                        ++end;
-                    }
-
-                    std::string replacement = concat(new_prefix, suffix, padding);
-                    buffer.replace(pos, end - pos, replacement);
-
-                    pos = buffer.find(path_data.prefix_placeholder, pos + new_prefix.size());
-                }
 #endif
             }
 
-            std::ofstream fo = open_ofstream(dst, std::ios::out | std::ios::binary);
-            fo << buffer;
-            fo.close();
-
             std::error_code lec;
             fs::permissions(dst, fs::status(src).permissions(), lec);
             if (lec)
@@ -734,9 +963,18 @@ namespace mamba
             if (binary_changed && m_pkg_info.subdir == "osx-arm64")
             {
                 codesign(dst, Context::instance().output_params.verbosity > 1);
+                sha256_in_prefix.clear();
             }
 #endif
-            return std::make_tuple(validation::sha256sum(dst), rel_dst.string());
+            if (sha256_in_prefix.empty())
+            {
+                sha256_in_prefix = validation::sha256sum(dst);
+            }
+            if (!relocation_key.empty())
+            {
+                RelocationCache(m_cache_path).store(relocation_key, dst, sha256_in_prefix);
+            }
+            return std::make_tuple(std::move(sha256_in_prefix), rel_dst.string());
         }
 
         if ((path_data.path_type == PathType::HARDLINK) || path_data.no_link)
@@ -774,7 +1012,12 @@ namespace mamba
                               << " --> '" << dst.string() << "'";
                 }
             }
-            if (copy)
+            if (copy && m_context->try_clone(m_cache_path, src, dst))
+            {
+                LOG_TRACE << "cloned '" << src.string() << "'" << std::endl
+                          << " --> '" << dst.string() << "'";
+            }
+            else if (copy)
             {
                 fs::copy(src, dst);
                 LOG_TRACE << "copied '" << src.string() << "'" << std::endl
@@ -809,15 +1052,48 @@ namespace mamba
         {
             return {};
         }
+        auto trace = Tracer::instance().scope("compile pyc " + m_pkg_info.name);
+        trace.add_counter("files", py_files.size());
 
         std::vector<fs::u8path> pyc_files;
         for (auto& f : py_files)
         {
-            pyc_files.push_back(pyc_path(f, m_context->short_python_version));
+            pyc_files.push_back(m_context->noarch_python_paths.pyc_path(f.string()));
         }
         if (m_context->compile_pyc)
         {
-            m_context->try_pyc_compilation(py_files);
+            const auto& prefix = m_context->target_prefix;
+            const auto pyc_cache_dir = PackageCacheData::get_pyc_cache_dir(
+                m_source,
+                m_context->short_python_version
+            );
+
+            // Such as pyc files left by a previous installation
+            std::vector<fs::u8path> outdated_py_files;
+            for (std::size_t i = 0; i < py_files.size(); ++i)
+            {
+                const auto& py = prefix / py_files[i];
+                const auto& pyc = prefix / pyc_files[i];
+                if (is_pyc_up_to_date(py, pyc))
+                {
+                    continue;
+                }
+                const auto cached_pyc = pyc_cache_dir / pyc_files[i];
+                if (is_pyc_up_to_date(py, cached_pyc) && link_cached_pyc(cached_pyc, pyc))
+                {
+                    LOG_TRACE << "Linked cached pyc " << cached_pyc << " -> " << pyc;
+                    continue;
+                }
+                outdated_py_files.push_back(py_files[i]);
+                if (!m_context->container_build)
+                {
+                    m_context->cache_compiled_pyc(pyc_files[i], cached_pyc);
+                }
+            }
+            if (!outdated_py_files.empty())
+            {
+                m_context->try_pyc_compilation(outdated_py_files);
+            }
         }
         return pyc_files;
     }
@@ -832,16 +1108,20 @@ namespace mamba
 
     bool LinkPackage::execute()
     {
+        auto trace = Tracer::instance().scope("link " + m_pkg_info.name);
         nlohmann::json index_json, out_json;
         LOG_TRACE << "Preparing linking from '" << m_source.string() << "'";
 
-        LOG_TRACE << "Opening: " << m_source / "info" / "paths.json";
-        auto paths_data = read_paths(m_source);
-
-        LOG_TRACE << "Opening: " << m_source / "info" / "repodata_record.json";
-
-        std::ifstream repodata_f = open_ifstream(m_source / "info" / "repodata_record.json");
-        repodata_f >> index_json;
+        if (m_repodata_record.is_null())
+        {
+            LOG_TRACE << "Opening: " << m_source / "info" / "repodata_record.json";
+            std::ifstream repodata_f = open_ifstream(m_source / "info" / "repodata_record.json");
+            repodata_f >> index_json;
+        }
+        else
+        {
+            index_json = std::exchange(m_repodata_record, nullptr);
+        }
 
         std::string f_name = m_pkg_info.str();
 
@@ -869,15 +1149,61 @@ namespace mamba
             }
         }
 
+        // Planned by the transaction, if any, for ordering the packages by their files
+        const bool noarch_python = noarch_type == NoarchType::PYTHON;
+        LinkPlan plan = m_plan.has_value() ? std::move(m_plan).value()
+                                           : make_link_plan(m_source, *m_context, noarch_python);
+        m_plan.reset();
+        auto& paths_data = plan.files;
+        const auto& excluded_files = plan.excluded_files;
+        if (!excluded_files.empty())
+        {
+            LOG_DEBUG << "Not linking " << excluded_files.size() << " excluded files";
+        }
+
         std::vector<std::string> files_record;
 
         nlohmann::json paths_json = nlohmann::json::object();
         paths_json["paths"] = nlohmann::json::array();
         paths_json["paths_version"] = 1;
 
-        for (auto& path : paths_data)
+        // Files are linked concurrently, then recorded in the order of paths.json
+        std::vector<std::tuple<std::string, std::string>> linked_paths(paths_data.size());
+        const std::size_t n_threads = link_threads(paths_data.size());
+        LOG_TRACE << "Linking " << paths_data.size() << " files with " << n_threads << " threads";
+        try
+        {
+            parallel_for(
+                paths_data.size(),
+                n_threads,
+                [&](std::size_t i)
+                {
+                    if (m_interruptible)
+                    {
+                        interruption_point();
+                    }
+                    linked_paths[i] = link_path(paths_data[i], plan.targets[i]);
+                }
+            );
+        }
+        catch (const thread_interrupted&)
         {
-            auto [sha256_in_prefix, final_path] = link_path(path, noarch_type == NoarchType::PYTHON);
+            // Not recorded, so the transaction rollback could not remove them
+            for (const auto& [sha256_in_prefix, final_path] : linked_paths)
+            {
+                if (!final_path.empty())
+                {
+                    std::error_code ec;
+                    fs::remove(m_context->target_prefix / final_path, ec);
+                }
+            }
+            throw;
+        }
+
+        for (std::size_t i = 0; i < paths_data.size(); ++i)
+        {
+            const auto& path = paths_data[i];
+            const auto& [sha256_in_prefix, final_path] = linked_paths[i];
             files_record.push_back(final_path);
 
             nlohmann::json json_record = { { "_path", final_path },
@@ -914,32 +1240,41 @@ namespace mamba
             paths_json["paths"].push_back(json_record);
         }
 
+        // The targets of symlinks are looked up among the files linked, by their path
+        std::unordered_map<std::string, std::size_t> linked_index;
         for (std::size_t i = 0; i < paths_data.size(); ++i)
         {
             auto& path = paths_data[i];
             if (path.path_type == PathType::SOFTLINK)
             {
+                if (linked_index.empty())
+                {
+                    linked_index.reserve(files_record.size());
+                    for (std::size_t pix = 0; pix < files_record.size(); ++pix)
+                    {
+                        const auto linked = m_context->target_prefix / files_record[pix];
+                        linked_index.emplace(linked.std_path().lexically_normal().string(), pix);
+                    }
+                }
                 // here we try to avoid recomputing the costly sha256 sum
                 std::error_code ec;
                 auto points_to = fs::canonical(m_context->target_prefix / files_record[i], ec);
                 bool found = false;
                 if (!ec)
                 {
-                    for (std::size_t pix = 0; pix < files_record.size(); ++pix)
+                    const auto it = linked_index.find(
+                        points_to.std_path().lexically_normal().string()
+                    );
+                    if ((it != linked_index.end())
+                        && paths_json["paths"][it->second].contains("sha256_in_prefix"))
                     {
-                        if ((m_context->target_prefix / files_record[pix]) == points_to)
-                        {
-                            if (paths_json["paths"][pix].contains("sha256_in_prefix"))
-                            {
-                                LOG_TRACE << "Found symlink and target " << files_record[i]
-                                          << " -> " << files_record[pix];
-                                // use already computed value
-                                paths_json["paths"][i]["sha256_in_prefix"] = paths_json["paths"][pix]
-                                                                                       ["sha256_in_prefix"];
-                                found = true;
-                                break;
-                            }
-                        }
+                        const std::size_t pix = it->second;
+                        LOG_TRACE << "Found symlink and target " << files_record[i] << " -> "
+                                  << files_record[pix];
+                        // use already computed value
+                        paths_json["paths"][i]["sha256_in_prefix"] = paths_json["paths"][pix]
+                                                                               ["sha256_in_prefix"];
+                        found = true;
                     }
                 }
                 if (!found)
@@ -973,6 +1308,10 @@ namespace mamba
         out_json = index_json;
         out_json["paths_data"] = paths_json;
         out_json["files"] = files_record;
+        if (!excluded_files.empty())
+        {
+            out_json["excluded_files"] = excluded_files;
+        }
 
         MatchSpec* requested_spec = nullptr;
         for (auto& ms : m_context->requested_specs)
@@ -983,11 +1322,15 @@ namespace mamba
             }
         }
         out_json["requested_spec"] = requested_spec != nullptr ? requested_spec->str() : "";
-        out_json["package_tarball_full_path"] = m_source.string() + ".tar.bz2";
-        out_json["extracted_package_dir"] = m_source.string();
+        // Not recorded when the package is removed from the cache once linked
+        if (!m_context->container_build)
+        {
+            out_json["package_tarball_full_path"] = m_source.string() + ".tar.bz2";
+            out_json["extracted_package_dir"] = m_source.string();
 
-        // TODO find out what `1` means
-        out_json["link"] = { { "source", m_source.string() }, { "type", 1 } };
+            // TODO find out what `1` means
+            out_json["link"] = { { "source", m_source.string() }, { "type", 1 } };
+        }
 
         if (noarch_type == NoarchType::PYTHON)
         {
@@ -1006,7 +1349,7 @@ namespace mamba
                 if (std::regex_match(sub_path_json.path, py_file_re))
                 {
                     for_compilation.push_back(
-                        get_python_noarch_target_path(sub_path_json.path, m_context->site_packages_path)
+                        m_context->noarch_python_paths.target_path(sub_path_json.path)
                     );
                 }
             }
@@ -1051,7 +1394,8 @@ namespace mamba
             }
         }
 
-        // Create all start menu shortcuts if prefix name doesn't start with underscore
+        // Create all start menu shortcuts, once all packages are linked, if prefix name doesn't
+        // start with underscore
         if (on_win && Context::instance().shortcuts
             && m_context->target_prefix.filename().string()[0] != '_')
         {
@@ -1059,24 +1403,16 @@ namespace mamba
             {
                 if (std::regex_match(path.path, MENU_PATH_REGEX))
                 {
-                    create_menu_from_json(m_context->target_prefix / path.path, m_context);
+                    m_context->defer_menu_creation(m_context->target_prefix / path.path);
                 }
             }
         }
 
-        run_script(m_context->target_prefix, m_pkg_info, "post-link", "", true);
-
-        fs::u8path prefix_meta = m_context->target_prefix / "conda-meta";
-        if (!fs::exists(prefix_meta))
-        {
-            fs::create_directory(prefix_meta);
-        }
+        run_script(m_context->target_prefix, m_pkg_info, m_context, "post-link", "", true);
 
         LOG_DEBUG << "Finalizing linking";
-        auto meta = prefix_meta / (f_name + ".json");
-        LOG_TRACE << "Adding package to prefix metadata at '" << meta.string() << "'";
-        std::ofstream out_file = open_ofstream(meta);
-        out_file << out_json.dump(4);
+        m_context->write_record(f_name + ".json", out_json.dump());
+        m_context->file_index().add(f_name, out_json["paths_data"]);
 
         if (!m_clobber_warnings.empty())
         {
@@ -1093,4 +1429,289 @@ namespace mamba
         UnlinkPackage ulp(m_pkg_info, m_cache_path, m_context);
         return ulp.execute();
     }
+
+    namespace
+    {
+        /** Whether the file @p path_json of a record was changed by the prefix when linked. */
+        bool is_relocated(
+            const nlohmann::json& path_json,
+            const fs::u8path& file,
+            std::string_view prefix
+        )
+        {
+            const auto path_type = path_json.value("path_type", std::string());
+            if ((path_type == "unix_python_entry_point")
+                || (path_type == "windows_python_entry_point_script"))
+            {
+                return true;
+            }
+            const auto sha256 = path_json.find("sha256");
+            const auto sha256_in_prefix = path_json.find("sha256_in_prefix");
+            if ((sha256 != path_json.end()) && (sha256_in_prefix != path_json.end()))
+            {
+                return *sha256 != *sha256_in_prefix;
+            }
+            if ((path_type == "pyc_file") || (path_type == "windows_python_entry_point_exe"))
+            {
+                return false;
+            }
+            // Records without checksums, such as the ones of older versions
+            const auto mapped = MappedFile::open(file);
+            return mapped && (mapped->data().find(prefix) != std::string_view::npos);
+        }
+
+        /** Write @p src to @p dst, with the prefix @p old_prefix replaced by @p new_prefix. */
+        void relocate_file(
+            const fs::u8path& src,
+            const fs::u8path& dst,
+            std::string_view old_prefix,
+            std::string_view new_prefix
+        )
+        {
+            const auto mapped = MappedFile::open(src);
+            std::string contents;
+            if (!mapped)
+            {
+                contents = read_contents(src, std::ios::in | std::ios::binary);
+            }
+            const std::string_view data = mapped ? mapped->data() : std::string_view(contents);
+            const auto replacer = PrefixReplacer(old_prefix, new_prefix);
+
+            // As git does, files with a NUL character in their first bytes are binary
+            constexpr std::size_t binary_check_size = 8000;
+            const bool binary = data.substr(0, binary_check_size).find('\0')
+                                != std::string_view::npos;
+            if (binary && (new_prefix.size() > old_prefix.size())
+                && (data.find(old_prefix) != std::string_view::npos))
+            {
+                throw std::length_error(
+                    "Cannot relocate binary file '" + src.string() + "' to a longer prefix"
+                );
+            }
+            auto& relocated = scratch_buffer();
+            relocated.reserve(data.size());
+            if (binary)
+            {
+                replacer.write_binary(data, relocated);
+            }
+            else
+            {
+                std::string_view rest = data;
+                if (!on_win && starts_with(data, "#!"))
+                {
+                    const std::size_t end_of_line = std::min(data.find('\n'), data.size());
+                    replacer.write_text(data.substr(0, end_of_line), relocated);
+                    if (relocated.size() > MAX_SHEBANG_LENGTH)
+                    {
+                        relocated = replace_long_shebang(relocated);
+                    }
+                    rest = data.substr(end_of_line);
+                }
+                replacer.write_text(rest, relocated);
+            }
+            write_contents(dst, relocated);
+
+            std::error_code ec;
+            fs::permissions(dst, fs::status(src).permissions(), ec);
+            if (ec)
+            {
+                LOG_WARNING << "Could not set permissions on [" << dst << "]: " << ec.message();
+            }
+#if defined(__APPLE__)
+            if (binary && (data.find(old_prefix) != std::string_view::npos))
+            {
+                codesign(dst, Context::instance().output_params.verbosity > 1);
+            }
+#endif
+        }
+
+        /** Create @p dst with the content of @p src, sharing it when allowed. */
+        void share_file(const fs::u8path& src, const fs::u8path& dst, bool copy)
+        {
+            const auto& ctx = Context::instance();
+            std::error_code ec;
+            if (!copy && !ctx.always_copy)
+            {
+                fs::create_hard_link(src, dst, ec);
+                if (!ec)
+                {
+                    return;
+                }
+            }
+            if (ctx.allow_reflinks)
+            {
+                ec.clear();
+                mamba_fs::clone_file(src, dst, ec);
+                if (!ec)
+                {
+                    return;
+                }
+            }
+            fs::copy(src, dst);
+        }
+    }
+
+    void clone_prefix(const fs::u8path& source, const fs::u8path& target)
+    {
+        auto trace = Tracer::instance().scope("clone prefix");
+        const auto source_meta = source / "conda-meta";
+        const auto target_meta = target / "conda-meta";
+
+        std::string old_prefix = source.string();
+        std::string new_prefix = target.string();
+#ifdef _WIN32
+        // As written when linking
+        replace_all(old_prefix, "\\", "/");
+        replace_all(new_prefix, "\\", "/");
+#endif
+
+        auto record_files = std::vector<fs::u8path>();
+        for (const auto& entry : fs::directory_iterator(source_meta))
+        {
+            if (ends_with(entry.path().filename().string(), ".json"))
+            {
+                record_files.push_back(entry.path());
+            }
+        }
+        auto records = std::vector<nlohmann::json>(record_files.size());
+        parallel_for(
+            records.size(),
+            link_threads(records.size()),
+            [&](std::size_t i)
+            {
+                auto file = open_ifstream(record_files[i]);
+                records[i] = nlohmann::json::parse(file);
+            }
+        );
+
+        // Files are cloned concurrently, whatever their package
+        auto files = std::vector<std::pair<std::size_t, nlohmann::json*>>();
+        for (std::size_t i = 0; i < records.size(); ++i)
+        {
+            for (auto& path_json : records[i]["paths_data"]["paths"])
+            {
+                files.emplace_back(i, &path_json);
+            }
+        }
+
+        // The files of the extracted packages, read if a file cannot be relocated from the
+        // source prefix
+        auto cache_paths = std::vector<std::optional<std::vector<PathData>>>(records.size());
+        std::mutex cache_paths_mutex;
+        const auto relocate_from_cache = [&](std::size_t i, const nlohmann::json& path_json)
+        {
+            const auto pkg_dir = fs::u8path(records[i].value("extracted_package_dir", ""));
+            if (pkg_dir.empty())
+            {
+                return false;
+            }
+            const auto sha256 = path_json.value("sha256", std::string());
+            auto src = PathData();
+            {
+                std::lock_guard<std::mutex> lock(cache_paths_mutex);
+                if (!cache_paths[i].has_value())
+                {
+                    cache_paths[i] = fs::exists(pkg_dir / "info" / "paths.json")
+                                         ? read_paths(pkg_dir)
+                                         : std::vector<PathData>();
+                }
+                // Files with the same content have the same placeholder
+                const auto it = std::find_if(
+                    cache_paths[i]->cbegin(),
+                    cache_paths[i]->cend(),
+                    [&](const PathData& p) { return !sha256.empty() && (p.sha256 == sha256); }
+                );
+                if ((it == cache_paths[i]->cend()) || it->prefix_placeholder.empty())
+                {
+                    return false;
+                }
+                src = *it;
+            }
+            relocate_file(
+                pkg_dir / src.path,
+                target / path_json["_path"].get<std::string>(),
+                src.prefix_placeholder,
+                new_prefix
+            );
+            return true;
+        };
+        fs::create_directories(target_meta);
+        auto file_index = PrefixFileIndex(target);
+
+        const std::size_t n_threads = link_threads(files.size());
+        LOG_INFO << "Cloning " << files.size() << " files of " << records.size()
+                 << " packages with " << n_threads << " threads";
+        std::atomic<std::size_t> n_relocated = 0;
+        parallel_for(
+            files.size(),
+            n_threads,
+            [&](std::size_t k)
+            {
+                auto& path_json = *files[k].second;
+                const auto rel_path = path_json["_path"].get<std::string>();
+                const auto src = source / rel_path;
+                const auto dst = target / rel_path;
+
+                std::error_code ec;
+                fs::create_directories(dst.parent_path(), ec);
+                if (fs::is_symlink(src))
+                {
+                    auto link_target = fs::read_symlink(src);
+                    if (link_target.is_absolute() && starts_with(link_target.string(), old_prefix))
+                    {
+                        link_target = new_prefix + link_target.string().substr(old_prefix.size());
+                    }
+                    fs::create_symlink(link_target, dst);
+                }
+                else if (fs::is_directory(src))
+                {
+                    fs::create_directories(dst);
+                }
+                else if (!fs::exists(src))
+                {
+                    LOG_WARNING << "Not cloning missing file '" << src.string() << "'";
+                }
+                else if ((old_prefix != new_prefix) && is_relocated(path_json, src, old_prefix))
+                {
+                    try
+                    {
+                        relocate_file(src, dst, old_prefix, new_prefix);
+                    }
+                    catch (const std::length_error&)
+                    {
+                        // The placeholder of the package is long enough
+                        if (!relocate_from_cache(files[k].first, path_json))
+                        {
+                            throw;
+                        }
+                    }
+                    path_json["sha256_in_prefix"] = validation::sha256sum(dst);
+                    ++n_relocated;
+                }
+                else
+                {
+                    share_file(src, dst, path_json.value("no_link", false));
+                }
+            }
+        );
+        LOG_DEBUG << n_relocated << " files relocated to the cloned prefix";
+
+        for (std::size_t i = 0; i < records.size(); ++i)
+        {
+            const auto filename = record_files[i].filename().string();
+            {
+                auto out = open_ofstream(target_meta / filename);
+                out << records[i].dump();
+            }
+            file_index.add(filename.substr(0, filename.size() - 5), records[i]["paths_data"]);
+        }
+        file_index.write();
+        for (const auto& name : { "history", "pinned" })
+        {
+            if (fs::exists(source_meta / name))
+            {
+                fs::copy_file(source_meta / name, target_meta / name);
+            }
+        }
+    }
 }  // namespace mamba
@@ -0,0 +1,118 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.hpp"
+
+namespace mamba
+{
+    MappedFile::MappedFile(const char* ptr, std::size_t size)
+        : m_ptr(ptr)
+        , m_size(size)
+    {
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+        : m_ptr(std::exchange(other.m_ptr, nullptr))
+        , m_size(std::exchange(other.m_size, 0))
+    {
+    }
+
+    auto MappedFile::data() const -> std::string_view
+    {
+        return { m_ptr, m_size };
+    }
+
+#ifdef _WIN32
+    auto MappedFile::open(const fs::u8path& path) -> std::optional<MappedFile>
+    {
+        HANDLE file = ::CreateFileW(
+            path.wstring().c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr
+        );
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return std::nullopt;
+        }
+        LARGE_INTEGER size;
+        if (!::GetFileSizeEx(file, &size) || size.QuadPart == 0)
+        {
+            ::CloseHandle(file);
+            return std::nullopt;
+        }
+        HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        ::CloseHandle(file);
+        if (mapping == nullptr)
+        {
+            return std::nullopt;
+        }
+        // The view keeps a reference on the mapping object
+        const void* ptr = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        ::CloseHandle(mapping);
+        if (ptr == nullptr)
+        {
+            return std::nullopt;
+        }
+        const auto mapped_size = static_cast<std::size_t>(size.QuadPart);
+        return { MappedFile(static_cast<const char*>(ptr), mapped_size) };
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (m_ptr != nullptr)
+        {
+            ::UnmapViewOfFile(m_ptr);
+        }
+    }
+#else
+    auto MappedFile::open(const fs::u8path& path) -> std::optional<MappedFile>
+    {
+        const int fd = ::open(path.string().c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return std::nullopt;
+        }
+        struct ::stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            return std::nullopt;
+        }
+        const auto size = static_cast<std::size_t>(st.st_size);
+        // The mapping stays valid after closing the file descriptor
+        void* ptr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (ptr == MAP_FAILED)
+        {
+            return std::nullopt;
+        }
+        return { MappedFile(static_cast<const char*>(ptr), size) };
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (m_ptr != nullptr)
+        {
+            ::munmap(const_cast<char*>(m_ptr), m_size);
+        }
+    }
+#endif
+}
@@ -0,0 +1,49 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_MAPPED_FILE_HPP
+#define MAMBA_CORE_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+#include "mamba/core/mamba_fs.hpp"
+
+namespace mamba
+{
+    /**
+     * A read-only, shared, memory mapping of a whole file.
+     *
+     * The pages are shared with the system page cache, and therefore with other processes
+     * mapping the same file.
+     */
+    class MappedFile
+    {
+    public:
+
+        /** Map the file, or return an empty optional if it cannot be mapped. */
+        static auto open(const fs::u8path& path) -> std::optional<MappedFile>;
+
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&&) = delete;
+
+        auto data() const -> std::string_view;
+
+    private:
+
+        MappedFile(const char* ptr, std::size_t size);
+
+        const char* m_ptr = nullptr;
+        std::size_t m_size = 0;
+    };
+}
+
+#endif
@@ -4,13 +4,14 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
-#include <regex>
+#include <algorithm>
 
 #include "mamba/core/channel.hpp"
 #include "mamba/core/environment.hpp"
 #include "mamba/core/match_spec.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/url.hpp"
+#include "mamba/core/util.hpp"
 #include "mamba/core/util_string.hpp"
 
 namespace mamba
@@ -27,10 +28,149 @@ namespace mamba
         return split_str;
     }
 
+    namespace
+    {
+        // The spec sections used to be parsed with ``std::regex``, which was a hotspot when
+        // parsing many specs. The functions below keep the exact semantics of these regexes.
+
+        auto is_line_terminator(char c) -> bool
+        {
+            return (c == '\n') || (c == '\r');
+        }
+
+        auto is_key_char(char c) -> bool
+        {
+            return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z'))
+                   || ((c >= '0') && (c <= '9')) || (c == '_') || (c == '-');
+        }
+
+        auto is_quote(char c) -> bool
+        {
+            return (c == '\'') || (c == '"');
+        }
+
+        /**
+         * Find the section opened by @p open and closed by @p close.
+         *
+         * The section goes from the last @p open before the last @p close of the first line
+         * that has one, as the regex ``.*(\[.*\])`` (where ``.`` does not match line
+         * terminators).
+         *
+         * @return The position and length of the section, or a npos position.
+         */
+        auto find_section(std::string_view str, char open, char close)
+            -> std::pair<std::size_t, std::size_t>
+        {
+            for (std::size_t start = 0; start <= str.size();)
+            {
+                const auto line_end = std::find_if(
+                    str.cbegin() + static_cast<std::ptrdiff_t>(start),
+                    str.cend(),
+                    is_line_terminator
+                );
+                const auto end = static_cast<std::size_t>(line_end - str.cbegin());
+                const auto line = str.substr(start, end - start);
+                if (const auto close_pos = line.rfind(close); close_pos != line.npos)
+                {
+                    if (const auto open_pos = line.rfind(open, close_pos); open_pos != line.npos)
+                    {
+                        return { start + open_pos, close_pos - open_pos + 1 };
+                    }
+                }
+                start = end + 1;
+            }
+            return { std::string_view::npos, 0 };
+        }
+
+        /**
+         * Call @p func on the key and value of each ``key=value`` pair of @p str.
+         *
+         * Values can be quoted, and end at a quote, comma or space otherwise.
+         * This is the same as repeatedly searching the regex
+         * ``([a-zA-Z0-9_-]+?)=(["']?)([^'"]*?)(\2)(?:['", ]|$)``.
+         */
+        template <typename Func>
+        void for_each_key_value(std::string_view str, Func&& func)
+        {
+            static constexpr auto npos = std::string_view::npos;
+            static constexpr std::string_view separators = "'\", ";
+
+            // The regex was searched in a C string
+            str = str.substr(0, str.find('\0'));
+
+            std::size_t pos = 0;
+            while (pos < str.size())
+            {
+                // The first '=' preceded by a key is the earliest possible match
+                std::size_t eq = str.find('=', pos);
+                while ((eq != npos) && ((eq == pos) || !is_key_char(str[eq - 1])))
+                {
+                    eq = str.find('=', eq + 1);
+                }
+                if (eq == npos)
+                {
+                    return;
+                }
+                std::size_t key_start = eq - 1;
+                while ((key_start > pos) && is_key_char(str[key_start - 1]))
+                {
+                    --key_start;
+                }
+                const auto key = str.substr(key_start, eq - key_start);
+
+                // A quoted value ends at the next quote, if it is the same followed by a
+                // separator. Otherwise, the value is read unquoted.
+                const std::size_t value_start = eq + 1;
+                if ((value_start < str.size()) && is_quote(str[value_start]))
+                {
+                    const std::size_t closing = str.find_first_of("'\"", value_start + 1);
+                    const std::size_t after = closing + 1;
+                    if ((closing != npos) && (str[closing] == str[value_start])
+                        && ((after == str.size()) || (separators.find(str[after]) != npos)))
+                    {
+                        func(key, str.substr(value_start + 1, closing - value_start - 1));
+                        pos = after + 1;
+                        continue;
+                    }
+                }
+                const std::size_t value_end = std::min(
+                    str.find_first_of(separators, value_start),
+                    str.size()
+                );
+                func(key, str.substr(value_start, value_end - value_start));
+                pos = value_end + 1;
+            }
+        }
+    }
+
+    namespace
+    {
+        /** Whether the spec is the path of a package file, relative to the working directory. */
+        auto is_package_path(std::string_view spec) -> bool
+        {
+            const auto str = std::string(strip(spec.substr(0, spec.find('#'))));
+            return is_package_file(str) && !has_scheme(str);
+        }
+    }
+
     MatchSpec::MatchSpec(std::string_view i_spec, ChannelContext& channel_context)
-        : spec(i_spec)
     {
-        parse(channel_context);
+        const auto parse_spec = [&](std::string_view str)
+        {
+            auto out = MatchSpec();
+            out.spec = str;
+            out.parse(channel_context);
+            return out;
+        };
+        if (is_package_path(i_spec))
+        {
+            *this = parse_spec(i_spec);
+        }
+        else
+        {
+            // The same specs are parsed again, such as the dependencies shared by packages
+            *this = channel_context.m_match_spec_cache.get_or_make(i_spec, parse_spec);
+        }
     }
 
     std::tuple<std::string, std::string> MatchSpec::parse_version_and_build(const std::string& s)
@@ -104,78 +244,50 @@ namespace mamba
             return;
         }
 
-        auto extract_kv = [&spec_str](const std::string& kv_string, auto& map)
+        auto extract_kv = [&spec_str](std::string_view kv_string, auto& map)
         {
-            static std::regex kv_re("([a-zA-Z0-9_-]+?)=([\"\']?)([^\'\"]*?)(\\2)(?:[\'\", ]|$)");
-            std::cmatch kv_match;
-            const char* text_iter = kv_string.c_str();
-
-            while (std::regex_search(text_iter, kv_match, kv_re))
-            {
-                auto key = kv_match[1].str();
-                auto value = kv_match[3].str();
-                if (key.size() == 0 || value.size() == 0)
+            for_each_key_value(
+                kv_string,
+                [&](std::string_view key, std::string_view value)
                 {
-                    throw std::runtime_error("key-value mismatch in brackets " + spec_str);
+                    if (key.size() == 0 || value.size() == 0)
+                    {
+                        throw std::runtime_error("key-value mismatch in brackets " + spec_str);
+                    }
+                    map[std::string(key)] = value;
                 }
-                text_iter += kv_match.position() + kv_match.length();
-                map[key] = value;
-            }
+            );
         };
 
-        std::smatch match;
-
         // Step 3. strip off brackets portion
-        static std::regex brackets_re(".*(?:(\\[.*\\]))");
-        if (std::regex_search(spec_str, match, brackets_re))
+        if (auto [pos, len] = find_section(spec_str, '[', ']'); pos != std::string::npos)
         {
-            auto brackets_str = match[1].str();
-            brackets_str = brackets_str.substr(1, brackets_str.size() - 2);
-            extract_kv(brackets_str, brackets);
-            spec_str.erase(
-                static_cast<std::size_t>(match.position(1)),
-                static_cast<std::size_t>(match.length(1))
-            );
+            extract_kv(std::string_view(spec_str).substr(pos + 1, len - 2), brackets);
+            spec_str.erase(pos, len);
         }
 
         // Step 4. strip off parens portion
-        static std::regex parens_re(".*(?:(\\(.*\\)))");
-        if (std::regex_search(spec_str, match, parens_re))
+        if (auto [pos, len] = find_section(spec_str, '(', ')'); pos != std::string::npos)
         {
-            auto parens_str = match[1].str();
-            parens_str = parens_str.substr(1, parens_str.size() - 2);
+            const auto parens_str = std::string_view(spec_str).substr(pos + 1, len - 2);
             extract_kv(parens_str, this->parens);
             if (parens_str.find("optional") != parens_str.npos)
             {
                 optional = true;
             }
-            spec_str.erase(
-                static_cast<std::size_t>(match.position(1)),
-                static_cast<std::size_t>(match.length(1))
-            );
+            spec_str.erase(pos, len);
         }
 
-        auto m5 = rsplit(spec_str, ":", 2);
-        auto m5_len = m5.size();
-        std::string channel_str;
-        if (m5_len == 3)
-        {
-            channel = m5[0];
-            ns = m5[1];
-            spec_str = m5[2];
-        }
-        else if (m5_len == 2)
-        {
-            ns = m5[0];
-            spec_str = m5[1];
-        }
-        else if (m5_len == 1)
+        // Step 5. strip off the channel and namespace, as in ``channel:namespace:spec``
+        if (const auto [head, spec_part] = rsplit_once(spec_str, ':'); head.has_value())
         {
-            spec_str = m5[0];
-        }
-        else
-        {
-            throw std::runtime_error("Parsing of channel / namespace / subdir failed.");
+            const auto [channel_part, ns_part] = rsplit_once(head.value(), ':');
+            if (channel_part.has_value())
+            {
+                channel = channel_part.value();
+            }
+            ns = ns_part;
+            spec_str.erase(0, spec_str.size() - spec_part.size());
         }
         // TODO implement Channel, and parsing of the channel here!
         // channel = subdir = channel_str;
@@ -195,21 +307,18 @@ namespace mamba
         {
             spec_str.push_back('*');
         }
-        // This is #6 of the spec parsing
-        static std::regex version_build_re("([^ =<>!~]+)?([><!=~ ].+)?");
-        std::smatch vb_match;
-        if (std::regex_match(spec_str, vb_match, version_build_re))
+        // This is #6 of the spec parsing, the name is followed by an operator then the version
+        // on a single line, as the regex ``([^ =<>!~]+)?([><!=~ ].+)?``.
         {
-            name = vb_match[1].str();
-            version = strip(vb_match[2].str());
-            if (name.size() == 0)
+            const auto name_end = std::min(spec_str.find_first_of(" =<>!~"), spec_str.size());
+            const auto rest = std::string_view(spec_str).substr(name_end);
+            if ((name_end == 0) || (rest.size() == 1)
+                || std::any_of(rest.cbegin(), rest.cend(), is_line_terminator))
             {
                 throw std::runtime_error("Invalid spec, no package name found: " + spec_str);
             }
-        }
-        else
-        {
-            throw std::runtime_error("Invalid spec, no package name found: " + spec_str);
+            name = spec_str.substr(0, name_end);
+            version = strip(rest);
         }
 
         // # Step 7. otherwise sort out version + build
@@ -0,0 +1,114 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <utility>
+
+#include "mamba/core/memory_budget.hpp"
+
+namespace mamba
+{
+    MemoryBudget::Reservation::Reservation(MemoryBudget* budget, std::size_t size)
+        : p_budget(budget)
+        , m_size(size)
+    {
+    }
+
+    MemoryBudget::Reservation::~Reservation()
+    {
+        release();
+    }
+
+    MemoryBudget::Reservation::Reservation(Reservation&& other) noexcept
+        : p_budget(std::exchange(other.p_budget, nullptr))
+        , m_size(std::exchange(other.m_size, 0))
+    {
+    }
+
+    auto MemoryBudget::Reservation::operator=(Reservation&& other) noexcept -> Reservation&
+    {
+        if (this != &other)
+        {
+            release();
+            p_budget = std::exchange(other.p_budget, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+        }
+        return *this;
+    }
+
+    auto MemoryBudget::Reservation::size() const -> std::size_t
+    {
+        return m_size;
+    }
+
+    void MemoryBudget::Reservation::release()
+    {
+        if (p_budget != nullptr)
+        {
+            p_budget->release(m_size);
+            p_budget = nullptr;
+            m_size = 0;
+        }
+    }
+
+    MemoryBudget::MemoryBudget(std::size_t limit)
+        : m_limit(limit)
+    {
+    }
+
+    auto MemoryBudget::limit() const -> std::size_t
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_limit;
+    }
+
+    void MemoryBudget::set_limit(std::size_t limit)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_limit = limit;
+        }
+        m_cv.notify_all();
+    }
+
+    auto MemoryBudget::reserved() const -> std::size_t
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_reserved;
+    }
+
+    auto MemoryBudget::reserve(std::size_t size) -> Reservation
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&]() { return (m_reserved == 0) || fits(size); });
+        m_reserved += size;
+        return Reservation(this, size);
+    }
+
+    auto MemoryBudget::try_reserve(std::size_t size) -> std::optional<Reservation>
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!fits(size))
+        {
+            return std::nullopt;
+        }
+        m_reserved += size;
+        return { Reservation(this, size) };
+    }
+
+    auto MemoryBudget::fits(std::size_t size) const -> bool
+    {
+        return (m_limit == 0) || ((size <= m_limit) && (m_reserved <= m_limit - size));
+    }
+
+    void MemoryBudget::release(std::size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_reserved -= size;
+        }
+        m_cv.notify_all();
+    }
+}
@@ -0,0 +1,160 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#include "mamba/core/metrics.hpp"
+
+namespace mamba
+{
+    /********************************
+     * MetricCounter implementation *
+     ********************************/
+
+    void MetricCounter::add(double value)
+    {
+        // No fetch_add for floating point atomics before C++20
+        double current = m_value.load(std::memory_order_relaxed);
+        while (!m_value.compare_exchange_weak(current, current + value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    auto MetricCounter::value() const -> double
+    {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+    /**********************************
+     * MetricHistogram implementation *
+     **********************************/
+
+    MetricHistogram::MetricHistogram(std::vector<double> bounds)
+        : m_bounds(std::move(bounds))
+    {
+        std::sort(m_bounds.begin(), m_bounds.end());
+        m_bounds.erase(std::unique(m_bounds.begin(), m_bounds.end()), m_bounds.end());
+        m_counts.resize(m_bounds.size(), 0);
+    }
+
+    void MetricHistogram::observe(double value)
+    {
+        const auto bucket = std::lower_bound(m_bounds.cbegin(), m_bounds.cend(), value)
+                            - m_bounds.cbegin();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (static_cast<std::size_t>(bucket) < m_counts.size())
+        {
+            ++m_counts[static_cast<std::size_t>(bucket)];
+        }
+        ++m_count;
+        m_sum += value;
+    }
+
+    void MetricHistogram::observe_since(clock::time_point start)
+    {
+        observe(std::chrono::duration<double>(clock::now() - start).count());
+    }
+
+    auto MetricHistogram::snapshot() const -> Snapshot
+    {
+        auto out = Snapshot{ m_bounds, {}, 0, 0 };
+        std::lock_guard<std::mutex> lock(m_mutex);
+        out.cumulative_counts.reserve(m_counts.size());
+        std::size_t cumulative = 0;
+        for (const auto n : m_counts)
+        {
+            cumulative += n;
+            out.cumulative_counts.push_back(cumulative);
+        }
+        out.count = m_count;
+        out.sum = m_sum;
+        return out;
+    }
+
+    /**************************
+     * Metrics implementation *
+     **************************/
+
+    auto Metrics::instance() -> Metrics&
+    {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    auto Metrics::default_seconds_bounds() -> std::vector<double>
+    {
+        return { 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120, 300 };
+    }
+
+    auto Metrics::counter(const std::string& name, std::string help) -> MetricCounter&
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& entry = m_entries[name];
+        if (entry.histogram)
+        {
+            throw std::invalid_argument("Metric '" + name + "' is a histogram");
+        }
+        if (!entry.counter)
+        {
+            entry.help = std::move(help);
+            entry.counter = std::make_unique<MetricCounter>();
+        }
+        return *entry.counter;
+    }
+
+    auto Metrics::histogram(const std::string& name, std::string help, std::vector<double> bounds)
+        -> MetricHistogram&
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& entry = m_entries[name];
+        if (entry.counter)
+        {
+            throw std::invalid_argument("Metric '" + name + "' is a counter");
+        }
+        if (!entry.histogram)
+        {
+            entry.help = std::move(help);
+            entry.histogram = std::make_unique<MetricHistogram>(std::move(bounds));
+        }
+        return *entry.histogram;
+    }
+
+    auto Metrics::to_prometheus() const -> std::string
+    {
+        auto out = std::string();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& [name, entry] : m_entries)
+        {
+            out += fmt::format("# HELP {} {}\n", name, entry.help);
+            if (entry.counter)
+            {
+                out += fmt::format("# TYPE {} counter\n", name);
+                out += fmt::format("{} {}\n", name, entry.counter->value());
+            }
+            else if (entry.histogram)
+            {
+                const auto snapshot = entry.histogram->snapshot();
+                out += fmt::format("# TYPE {} histogram\n", name);
+                for (std::size_t i = 0; i < snapshot.bounds.size(); ++i)
+                {
+                    out += fmt::format(
+                        "{}_bucket{{le=\"{}\"}} {}\n",
+                        name,
+                        snapshot.bounds[i],
+                        snapshot.cumulative_counts[i]
+                    );
+                }
+                out += fmt::format("{}_bucket{{le=\"+Inf\"}} {}\n", name, snapshot.count);
+                out += fmt::format("{}_sum {}\n", name, snapshot.sum);
+                out += fmt::format("{}_count {}\n", name, snapshot.count);
+            }
+        }
+        return out;
+    }
+}
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <map>
 #include <string>
@@ -205,6 +206,49 @@ namespace mamba
             return out;
         }
 
+        StreamedTable::StreamedTable(const std::vector<FormattedString>& header)
+            : m_header(header)
+        {
+            for (const auto& cell : m_header)
+            {
+                m_cell_sizes.push_back(cell.size());
+            }
+        }
+
+        void StreamedTable::fit(const std::vector<FormattedString>& row)
+        {
+            for (std::size_t j = 0; j < row.size(); ++j)
+            {
+                m_cell_sizes[j] = std::max(m_cell_sizes[j], row[j].size());
+            }
+        }
+
+        void StreamedTable::print_header(std::ostream& out) const
+        {
+            print_row(out, m_header);
+            // Sum of the cell sizes with a padding of one before each cell and the first one
+            const std::size_t total_length = std::accumulate(
+                m_cell_sizes.begin(),
+                m_cell_sizes.end(),
+                m_cell_sizes.size() + 1
+            );
+            for (std::size_t i = 0; i < total_length; ++i)
+            {
+                out << MAMBA_TABLE_DELIM;
+            }
+            out << '\n';
+        }
+
+        void
+        StreamedTable::print_row(std::ostream& out, const std::vector<FormattedString>& row) const
+        {
+            for (std::size_t j = 0; j < row.size(); ++j)
+            {
+                fmt::print(out, " {: <{}}", fmt::styled(row[j].s, row[j].style), m_cell_sizes[j]);
+            }
+            out << '\n';
+        }
+
         bool string_comparison(const std::string& a, const std::string& b)
         {
             return a < b;
@@ -273,10 +317,14 @@ namespace mamba
         std::string json_hier;
         unsigned int json_index;
         nlohmann::json json_log;
+        // Appended elements by path, not flattened as they are only inserted when printing
+        std::map<std::string, std::vector<nlohmann::json>> json_arrays;
         bool is_json_print_cancelled = false;
 
         std::vector<std::string> m_buffer;
 
+        std::mutex m_progress_events_mutex;
+
         TaskSynchronizer tasksync;
     };
 
@@ -296,11 +344,9 @@ namespace mamba
 
     Console::~Console()
     {
-        if (!p_data->is_json_print_cancelled && !p_data->json_log.is_null())  // Note: we cannot
-                                                                              // rely on
-                                                                              // Context::instance()
-                                                                              // to still be valid
-                                                                              // at this point.
+        // Note: we cannot rely on Context::instance() to still be valid at this point.
+        if (!p_data->is_json_print_cancelled
+            && (!p_data->json_log.is_null() || !p_data->json_arrays.empty()))
         {
             this->json_print();
         }
@@ -459,7 +505,21 @@ namespace mamba
 
     void Console::json_print()
     {
-        print(p_data->json_log.unflatten().dump(4), true);
+        auto root = p_data->json_log.is_null() ? nlohmann::json::object()
+                                               : p_data->json_log.unflatten();
+        for (auto& [path, elements] : p_data->json_arrays)
+        {
+            auto& node = root[nlohmann::json::json_pointer(path)];
+            if (!node.is_array())
+            {
+                node = nlohmann::json::array();
+            }
+            for (std::size_t i = 0; i < elements.size(); ++i)
+            {
+                node[i] = std::move(elements[i]);
+            }
+        }
+        print(root.dump(4), true);
     }
 
     // write all the key/value pairs of a JSON object into the current entry, which
@@ -476,13 +536,32 @@ namespace mamba
         }
     }
 
+    void Console::progress_event(const nlohmann::json& event)
+    {
+        const auto& sink = Context::instance().output_params.progress_events;
+        if (sink.empty())
+        {
+            return;
+        }
+
+        const std::string line = event.dump() + '\n';
+        std::lock_guard<std::mutex> lock(p_data->m_progress_events_mutex);
+        if (sink == "stderr")
+        {
+            std::cerr << line << std::flush;
+            return;
+        }
+        // Events are sparse, the file is not kept open so that it can be rotated or removed
+        auto out = open_ofstream(sink, std::ios::app);
+        out << line;
+    }
+
     // append a value to the current entry, which is then a list
     void Console::json_append(const std::string& value)
     {
         if (Context::instance().output_params.json)
         {
-            p_data->json_log[p_data->json_hier + '/' + std::to_string(p_data->json_index)] = value;
-            p_data->json_index += 1;
+            json_append(nlohmann::json(value));
         }
     }
 
@@ -491,12 +570,12 @@ namespace mamba
     {
         if (Context::instance().output_params.json)
         {
-            nlohmann::json tmp = j.flatten();
-            for (auto it = tmp.begin(); it != tmp.end(); ++it)
+            auto& elements = p_data->json_arrays[p_data->json_hier];
+            if (elements.size() <= p_data->json_index)
             {
-                p_data->json_log[p_data->json_hier + '/' + std::to_string(p_data->json_index) + it.key()] = it.value(
-                );
+                elements.resize(p_data->json_index + 1);
             }
+            elements[p_data->json_index] = j;
             p_data->json_index += 1;
         }
     }
@@ -520,6 +599,65 @@ namespace mamba
         }
     }
 
+    /*******************
+     * JsonArrayWriter *
+     *******************/
+
+    JsonArrayWriter::JsonArrayWriter(std::ostream& out, std::size_t level, std::size_t buffer_size)
+        : m_out(out)
+        , m_level(level)
+        , m_buffer_size(buffer_size)
+    {
+        m_buffer.reserve(m_buffer_size);
+    }
+
+    JsonArrayWriter::~JsonArrayWriter()
+    {
+        flush(0);
+    }
+
+    void JsonArrayWriter::append(const nlohmann::json& element)
+    {
+        const auto indent = std::string(4 * (m_level + 1), ' ');
+        m_buffer += m_empty ? "[\n" : ",\n";
+        m_buffer += indent;
+        m_empty = false;
+        // Strings are escaped, so new lines only separate the lines of the element
+        for (const char c : element.dump(4))
+        {
+            m_buffer += c;
+            if (c == '\n')
+            {
+                m_buffer += indent;
+            }
+        }
+        flush(m_buffer_size);
+    }
+
+    void JsonArrayWriter::finish()
+    {
+        if (m_empty)
+        {
+            m_buffer += "[]";
+        }
+        else
+        {
+            m_buffer += '\n';
+            m_buffer.append(4 * m_level, ' ');
+            m_buffer += ']';
+        }
+        flush(0);
+    }
+
+    void JsonArrayWriter::flush(std::size_t min_size)
+    {
+        if (!m_buffer.empty() && (m_buffer.size() >= min_size))
+        {
+            m_out.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+            m_buffer.clear();
+        }
+    }
+
     /*****************
      * MessageLogger *
      *****************/
@@ -589,6 +727,18 @@ namespace mamba
         return m_stream;
     }
 
+    bool MessageLogger::enabled(log_level level)
+    {
+        // Compiled out of the SPDLOG_* macros used to emit it
+        if (static_cast<int>(level) < SPDLOG_ACTIVE_LEVEL)
+        {
+            return false;
+        }
+        const auto* logger = spdlog::default_logger_raw();
+        return logger->should_log(static_cast<spdlog::level::level_enum>(level))
+               || logger->should_backtrace();
+    }
+
     void MessageLogger::activate_buffer()
     {
         MessageLoggerData::use_buffer = true;
@@ -4,19 +4,26 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+
 #include "mamba/core/context.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/package_cache.hpp"
 #include "mamba/core/package_handling.hpp"
+#include "mamba/core/package_paths.hpp"
 #include "mamba/core/url.hpp"
 #include "mamba/core/validate.hpp"
 
 #include "nlohmann/json.hpp"
 
+#include "package_cache_ledger.hpp"
+#include "parallel.hpp"
+
 namespace mamba
 {
     PackageCacheData::PackageCacheData(const fs::u8path& path)
         : m_path(path)
+        , m_ledger(std::make_shared<PackageCacheLedger>(path))
     {
     }
 
@@ -109,14 +116,48 @@ namespace mamba
         }
     }
 
+    auto PackageCacheData::tarball_checksum(const std::string& filename, bool sha256) const
+        -> std::string
+    {
+        if (!Context::instance().verify_package_cache)
+        {
+            if (const auto entry = m_ledger->find(filename); entry.has_value())
+            {
+                const auto& checksum = sha256 ? entry->sha256 : entry->md5;
+                if (!checksum.empty())
+                {
+                    LOG_TRACE << "Using checksum of '" << filename << "' from the ledger";
+                    return checksum;
+                }
+            }
+        }
+
+        const auto tarball_path = m_path / filename;
+        if (sha256)
+        {
+            auto checksum = validation::sha256sum(tarball_path);
+            m_ledger->record(filename, "", checksum);
+            return checksum;
+        }
+        auto checksum = validation::md5sum(tarball_path);
+        m_ledger->record(filename, checksum, "");
+        return checksum;
+    }
+
     bool PackageCacheData::has_valid_tarball(const PackageInfo& s)
     {
-        std::string pkg = s.str();
-        if (m_valid_tarballs.find(pkg) != m_valid_tarballs.end())
+        const std::string pkg = s.str();
+        if (const auto it = m_valid_tarballs.find(pkg); it != m_valid_tarballs.end())
         {
-            return m_valid_tarballs[pkg];
+            return it->second;
         }
+        const bool valid = check_tarball(s);
+        m_valid_tarballs[pkg] = valid;
+        return valid;
+    }
 
+    bool PackageCacheData::check_tarball(const PackageInfo& s) const
+    {
         assert(!s.fn.empty());
         auto pkg_name = strip_package_extension(s.fn);
         LOG_DEBUG << "Verify cache '" << m_path.string() << "' for package tarball '"
@@ -131,11 +172,11 @@ namespace mamba
             valid = s.size == 0 || validation::file_size(tarball_path, s.size);
             if (!s.md5.empty())
             {
-                valid = valid && validation::md5(tarball_path, s.md5);
+                valid = valid && (tarball_checksum(s.fn, false) == s.md5);
             }
             else if (!s.sha256.empty())
             {
-                valid = valid && validation::sha256(tarball_path, s.md5);
+                valid = valid && (tarball_checksum(s.fn, true) == s.sha256);
             }
             else
             {
@@ -165,7 +206,6 @@ namespace mamba
             {
                 LOG_WARNING << "Package tarball '" << tarball_path.string() << "' is invalid";
             }
-            m_valid_tarballs[pkg] = valid;
         }
 
         LOG_DEBUG << "'" << pkg_name.string() << "' tarball cache is "
@@ -175,13 +215,19 @@ namespace mamba
 
     bool PackageCacheData::has_valid_extracted_dir(const PackageInfo& s)
     {
-        bool valid = false, can_validate = false;
-
-        std::string pkg = s.str();
-        if (m_valid_extracted_dir.find(pkg) != m_valid_extracted_dir.end())
+        const std::string pkg = s.str();
+        if (const auto it = m_valid_extracted_dir.find(pkg); it != m_valid_extracted_dir.end())
         {
-            return m_valid_extracted_dir[pkg];
+            return it->second;
         }
+        const bool valid = check_extracted_dir(s);
+        m_valid_extracted_dir[pkg] = valid;
+        return valid;
+    }
+
+    bool PackageCacheData::check_extracted_dir(const PackageInfo& s) const
+    {
+        bool valid = false, can_validate = false;
 
         auto pkg_name = strip_package_extension(s.fn);
         fs::u8path extracted_dir = m_path / pkg_name;
@@ -190,6 +236,8 @@ namespace mamba
 
         if (fs::exists(extracted_dir))
         {
+            // Not while another process replaces it
+            const auto entry_lock = lock_package_entry(m_path, s.fn, LockMode::shared);
             auto repodata_record_path = extracted_dir / "info" / "repodata_record.json";
             if (fs::exists(repodata_record_path))
             {
@@ -317,6 +365,22 @@ namespace mamba
                     valid = false;
                 }
 
+                if (valid)
+                {
+                    // Extracted without files that are not excluded anymore
+                    const auto& exclude = Context::instance().exclude_files;
+                    for (const auto& path : read_excluded_paths(extracted_dir))
+                    {
+                        if (!is_excluded_path(exclude, path))
+                        {
+                            LOG_INFO << "Extracted package cache '" << extracted_dir.string()
+                                     << "' lacks excluded file '" << path << "'";
+                            valid = false;
+                            break;
+                        }
+                    }
+                }
+
                 if (valid)
                 {
                     valid = validate(extracted_dir);
@@ -328,7 +392,6 @@ namespace mamba
             LOG_DEBUG << "Extracted package cache '" << extracted_dir.string() << "' not found";
         }
 
-        m_valid_extracted_dir[pkg] = valid;
         LOG_DEBUG << "'" << pkg_name.string() << "' extracted directory cache is "
                   << (valid ? "valid" : "invalid");
 
@@ -453,6 +516,127 @@ namespace mamba
         }
     }
 
+    void MultiPackageCache::validate(const std::vector<PackageInfo>& pkgs, std::size_t n_threads)
+    {
+        struct Validation
+        {
+            const PackageInfo* pkg;
+            std::string key;
+            /** The results of the caches checked, in order, until a valid one. */
+            std::vector<bool> extracted_dirs = {};
+            std::vector<bool> tarballs = {};
+        };
+
+        auto validations = std::vector<Validation>();
+        for (const auto& pkg : pkgs)
+        {
+            auto key = pkg.str();
+            if (m_cached_extracted_dirs.find(key) == m_cached_extracted_dirs.end())
+            {
+                validations.push_back({ &pkg, std::move(key) });
+            }
+        }
+
+        // Previous results are only read concurrently, new results are stored afterwards
+        parallel_for(
+            validations.size(),
+            std::clamp<std::size_t>(n_threads, 1, std::max<std::size_t>(validations.size(), 1)),
+            [&](std::size_t i)
+            {
+                auto& v = validations[i];
+                for (const auto& cache : m_caches)
+                {
+                    const auto& known = cache.m_valid_extracted_dir;
+                    const auto it = known.find(v.key);
+                    v.extracted_dirs.push_back(
+                        (it != known.end()) ? it->second : cache.check_extracted_dir(*v.pkg)
+                    );
+                    if (v.extracted_dirs.back())
+                    {
+                        return;
+                    }
+                }
+                if (m_cached_tarballs.find(v.key) != m_cached_tarballs.end())
+                {
+                    return;
+                }
+                for (const auto& cache : m_caches)
+                {
+                    const auto& known = cache.m_valid_tarballs;
+                    const auto it = known.find(v.key);
+                    v.tarballs.push_back(
+                        (it != known.end()) ? it->second : cache.check_tarball(*v.pkg)
+                    );
+                    if (v.tarballs.back())
+                    {
+                        return;
+                    }
+                }
+            },
+            TaskPriority::high
+        );
+
+        for (const auto& v : validations)
+        {
+            for (std::size_t i = 0; i < v.extracted_dirs.size(); ++i)
+            {
+                m_caches[i].m_valid_extracted_dir[v.key] = v.extracted_dirs[i];
+                if (v.extracted_dirs[i])
+                {
+                    m_cached_extracted_dirs[v.key] = m_caches[i].path();
+                }
+            }
+            for (std::size_t i = 0; i < v.tarballs.size(); ++i)
+            {
+                m_caches[i].m_valid_tarballs[v.key] = v.tarballs[i];
+                if (v.tarballs[i])
+                {
+                    m_cached_tarballs[v.key] = m_caches[i].path();
+                }
+            }
+        }
+    }
+
+    auto lock_package_entry(const fs::u8path& pkgs_dir, const std::string& filename, LockMode mode)
+        -> std::optional<LockFile>
+    {
+        if (!is_file_locking_allowed())
+        {
+            return std::nullopt;
+        }
+
+        // The lock-files of missing packages are not created next to them in the cache
+        const auto locks_dir = pkgs_dir / ".locks";
+        const auto entry_file = locks_dir / strip_package_extension(filename);
+        std::error_code ec;
+        if (!fs::exists(entry_file, ec))
+        {
+            fs::create_directories(locks_dir, ec);
+            std::ofstream(entry_file.std_path(), std::ios::out | std::ios::app);
+        }
+        if (!fs::exists(entry_file, ec))
+        {
+            // Not a writable cache, which no process modifies
+            return std::nullopt;
+        }
+
+        auto lock = LockFile(entry_file, mode);
+        if (!lock)
+        {
+            LOG_WARNING << "Could not lock package cache entry " << entry_file;
+            return std::nullopt;
+        }
+        return { std::move(lock) };
+    }
+
+    fs::u8path PackageCacheData::get_pyc_cache_dir(
+        const fs::u8path& extracted_dir,
+        const std::string& short_python_version
+    )
+    {
+        return extracted_dir / "info" / "pyc_cache" / short_python_version;
+    }
+
     std::vector<fs::u8path> MultiPackageCache::paths() const
     {
         std::vector<fs::u8path> paths;
@@ -0,0 +1,128 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+#include <utility>
+
+#include "mamba/core/output.hpp"
+#include "mamba/core/util_string.hpp"
+
+#include "package_cache_eviction.hpp"
+#include "package_cache_ledger.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        auto directory_size(const fs::u8path& dir) -> std::size_t
+        {
+            std::size_t size = 0;
+            for (auto& fp : fs::recursive_directory_iterator(dir))
+            {
+                if (!fp.is_symlink() && !fp.is_directory())
+                {
+                    size += fp.file_size();
+                }
+            }
+            return size;
+        }
+
+        /** A file time, in seconds since the epoch of the system clock. */
+        auto to_system_seconds(fs::file_time_type time) -> std::int64_t
+        {
+            // The epoch of file times is not specified before C++20
+            using system_duration = std::chrono::system_clock::duration;
+            const auto age = std::chrono::duration_cast<system_duration>(
+                fs::file_time_type::clock::now() - time
+            );
+            const auto system_time = std::chrono::system_clock::now() - age;
+            return std::chrono::duration_cast<std::chrono::seconds>(system_time.time_since_epoch())
+                .count();
+        }
+    }
+
+    auto list_cached_packages(const fs::u8path& pkgs_dir) -> std::vector<CachedPackage>
+    {
+        auto packages = std::map<std::string, CachedPackage>();
+        auto add = [&](std::string name, const fs::u8path& path, std::size_t size)
+        {
+            auto& pkg = packages[name];
+            pkg.name = std::move(name);
+            pkg.paths.push_back(path);
+            pkg.size += size;
+            const auto written = to_system_seconds(fs::last_write_time(path));
+            pkg.last_access = std::max(pkg.last_access, written);
+        };
+
+        for (auto& p : fs::directory_iterator(pkgs_dir))
+        {
+            const auto filename = p.path().filename().string();
+            if (p.is_directory() && fs::exists(p.path() / "info" / "index.json"))
+            {
+                add(filename, p.path(), directory_size(p.path()));
+            }
+            else if (!p.is_directory() && ends_with(filename, ".tar.bz2"))
+            {
+                add(filename.substr(0, filename.size() - 8), p.path(), p.file_size());
+            }
+            else if (!p.is_directory() && ends_with(filename, ".conda"))
+            {
+                add(filename.substr(0, filename.size() - 6), p.path(), p.file_size());
+            }
+        }
+
+        auto ledger = PackageCacheLedger(pkgs_dir);
+        auto out = std::vector<CachedPackage>();
+        out.reserve(packages.size());
+        for (auto& [name, pkg] : packages)
+        {
+            if (const auto accessed = ledger.last_access(name))
+            {
+                pkg.last_access = std::max(pkg.last_access, *accessed);
+            }
+            out.push_back(std::move(pkg));
+        }
+        std::sort(
+            out.begin(),
+            out.end(),
+            [](const auto& a, const auto& b)
+            { return std::tie(a.last_access, a.name) < std::tie(b.last_access, b.name); }
+        );
+        return out;
+    }
+
+    auto select_evicted_packages(
+        const std::vector<CachedPackage>& packages,
+        std::size_t max_size,
+        const std::map<std::string, std::set<fs::u8path>>& usage
+    ) -> std::vector<CachedPackage>
+    {
+        std::size_t total_size = 0;
+        for (const auto& pkg : packages)
+        {
+            total_size += pkg.size;
+        }
+
+        auto out = std::vector<CachedPackage>();
+        for (const auto& pkg : packages)
+        {
+            if (total_size <= max_size)
+            {
+                break;
+            }
+            if (usage.find(pkg.name) != usage.end())
+            {
+                LOG_DEBUG << "Keeping installed package " << pkg.name;
+                continue;
+            }
+            total_size -= pkg.size;
+            out.push_back(pkg);
+        }
+        return out;
+    }
+}
@@ -0,0 +1,52 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_PACKAGE_CACHE_EVICTION_HPP
+#define MAMBA_CORE_PACKAGE_CACHE_EVICTION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mamba/core/mamba_fs.hpp"
+
+namespace mamba
+{
+    /** A package of a package cache, with its tarballs and extracted directory. */
+    struct CachedPackage
+    {
+        /** The name of the extracted directory, such as ``xtensor-0.24.6-h0_0``. */
+        std::string name;
+        std::vector<fs::u8path> paths;
+        std::size_t size = 0;
+        /**
+         * The last time the package was used, in seconds since the epoch.
+         *
+         * Packages never recorded as used in the ledger default to when they were written.
+         */
+        std::int64_t last_access = 0;
+    };
+
+    /** The packages of a package cache, from the least to the most recently used. */
+    auto list_cached_packages(const fs::u8path& pkgs_dir) -> std::vector<CachedPackage>;
+
+    /**
+     * The least recently used packages to remove so that the others use at most ``max_size``.
+     *
+     * Packages used by an environment in ``usage`` are never selected, so the remaining packages
+     * can use more than ``max_size`` if these are too large.
+     */
+    auto select_evicted_packages(
+        const std::vector<CachedPackage>& packages,
+        std::size_t max_size,
+        const std::map<std::string, std::set<fs::u8path>>& usage
+    ) -> std::vector<CachedPackage>;
+}
+
+#endif
@@ -0,0 +1,359 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/output.hpp"
+#include "mamba/core/util.hpp"
+
+#include "package_cache_ledger.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        /** Serialize appends from the threads of this process, the file lock is per process. */
+        std::mutex ledger_mutex;
+
+        auto same_file(const PackageCacheLedger::Entry& lhs, const PackageCacheLedger::Entry& rhs)
+            -> bool
+        {
+            return (lhs.size == rhs.size) && (lhs.mtime == rhs.mtime) && (lhs.inode == rhs.inode);
+        }
+
+        auto to_json_line(const std::string& filename, const PackageCacheLedger::Entry& entry)
+            -> std::string
+        {
+            const auto j = nlohmann::json{
+                { "fn", filename },       { "size", entry.size }, { "mtime", entry.mtime },
+                { "inode", entry.inode }, { "md5", entry.md5 },   { "sha256", entry.sha256 },
+            };
+            return j.dump() + '\n';
+        }
+
+        auto to_access_line(const std::string& pkg_name, std::int64_t accessed) -> std::string
+        {
+            return nlohmann::json{ { "pkg", pkg_name }, { "accessed", accessed } }.dump() + '\n';
+        }
+
+        using AccessMap = std::unordered_map<std::string, std::int64_t>;
+
+        /**
+         * Read the entries of a ledger file into @p entries and the accesses into @p accesses.
+         *
+         * Invalid lines, such as one being written by another process, are skipped.
+         * @return The number of lines read.
+         */
+        auto read_entries(
+            const fs::u8path& file,
+            std::unordered_map<std::string, PackageCacheLedger::Entry>& entries,
+            AccessMap& accesses
+        ) -> std::size_t
+        {
+            if (!fs::exists(file))
+            {
+                return 0;
+            }
+            auto in = open_ifstream(file);
+            std::size_t n_lines = 0;
+            for (std::string line; std::getline(in, line);)
+            {
+                ++n_lines;
+                try
+                {
+                    const auto j = nlohmann::json::parse(line);
+                    if (const auto pkg = j.find("pkg"); pkg != j.end())
+                    {
+                        auto& accessed = accesses[pkg->get<std::string>()];
+                        accessed = std::max(accessed, j.at("accessed").get<std::int64_t>());
+                        continue;
+                    }
+                    auto entry = PackageCacheLedger::Entry{
+                        /* .size= */ j.at("size").get<std::uintmax_t>(),
+                        /* .mtime= */ j.at("mtime").get<std::int64_t>(),
+                        /* .inode= */ j.at("inode").get<std::uint64_t>(),
+                        /* .md5= */ j.at("md5").get<std::string>(),
+                        /* .sha256= */ j.at("sha256").get<std::string>(),
+                    };
+                    auto [it, inserted] = entries.try_emplace(j.at("fn").get<std::string>());
+                    if (!inserted && same_file(it->second, entry))
+                    {
+                        // An entry can complete the checksums of an earlier one
+                        if (entry.md5.empty())
+                        {
+                            entry.md5 = std::move(it->second.md5);
+                        }
+                        if (entry.sha256.empty())
+                        {
+                            entry.sha256 = std::move(it->second.sha256);
+                        }
+                    }
+                    it->second = std::move(entry);
+                }
+                catch (const nlohmann::json::exception&)
+                {
+                    LOG_DEBUG << "Skipping invalid line " << n_lines << " of ledger " << file;
+                }
+            }
+            return n_lines;
+        }
+    }
+
+    auto PackageCacheLedger::file_entry(const fs::u8path& file) -> std::optional<Entry>
+    {
+        auto ec = std::error_code();
+        const auto size = fs::file_size(file, ec);
+        if (ec)
+        {
+            return std::nullopt;
+        }
+        const auto mtime = fs::last_write_time(file, ec);
+        if (ec)
+        {
+            return std::nullopt;
+        }
+
+        auto out = Entry();
+        out.size = size;
+        out.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch())
+                        .count();
+#ifndef _WIN32
+        // Detect a tarball replaced by another one with the same size and modification time
+        struct ::stat st;
+        if (::stat(file.string().c_str(), &st) != 0)
+        {
+            return std::nullopt;
+        }
+        out.inode = st.st_ino;
+#endif
+        return { std::move(out) };
+    }
+
+    PackageCacheLedger::PackageCacheLedger(fs::u8path pkgs_dir)
+        : m_pkgs_dir(std::move(pkgs_dir))
+    {
+    }
+
+    auto PackageCacheLedger::ledger_file() const -> fs::u8path
+    {
+        return m_pkgs_dir / PACKAGE_CACHE_LEDGER_FILE;
+    }
+
+    void PackageCacheLedger::load()
+    {
+        m_loaded = true;
+        try
+        {
+            const auto n_lines = read_entries(ledger_file(), m_entries, m_accesses);
+            // Tarballs are recorded again when they change, and packages every time they are
+            // used, so stale lines accumulate
+            if (n_lines > 2 * (m_entries.size() + m_accesses.size()) + 64)
+            {
+                compact(n_lines);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            LOG_WARNING << "Could not read package cache ledger " << ledger_file() << ": "
+                        << e.what();
+        }
+    }
+
+    void PackageCacheLedger::compact(std::size_t n_lines)
+    {
+        auto file_guard = std::lock_guard(ledger_mutex);
+        auto file_lock = LockFile(ledger_file());
+        if (!file_lock)
+        {
+            return;
+        }
+
+        // Read again, now that no other process can append
+        auto entries = std::unordered_map<std::string, Entry>();
+        auto accesses = AccessMap();
+        read_entries(ledger_file(), entries, accesses);
+        auto tmp_file = TemporaryFile("mambaf", ".ledger", m_pkgs_dir);
+        {
+            auto out = open_ofstream(tmp_file.path());
+            for (auto it = entries.begin(); it != entries.end();)
+            {
+                const auto current = file_entry(m_pkgs_dir / it->first);
+                if (current.has_value() && same_file(*current, it->second))
+                {
+                    out << to_json_line(it->first, it->second);
+                    ++it;
+                }
+                else
+                {
+                    it = entries.erase(it);
+                }
+            }
+            for (auto it = accesses.begin(); it != accesses.end();)
+            {
+                // Packages that are in the cache, extracted or as a tarball
+                const auto pkg_path = m_pkgs_dir / it->first;
+                if (fs::exists(pkg_path) || fs::exists(pkg_path.string() + ".tar.bz2")
+                    || fs::exists(pkg_path.string() + ".conda"))
+                {
+                    out << to_access_line(it->first, it->second);
+                    ++it;
+                }
+                else
+                {
+                    it = accesses.erase(it);
+                }
+            }
+            if (!out.flush())
+            {
+                throw std::runtime_error("could not write " + tmp_file.path().string());
+            }
+        }
+        fs::rename(tmp_file.path(), ledger_file());
+        LOG_DEBUG << "Compacted package cache ledger " << ledger_file() << " from " << n_lines
+                  << " to " << entries.size() + accesses.size() << " entries";
+        m_entries = std::move(entries);
+        m_accesses = std::move(accesses);
+    }
+
+    auto PackageCacheLedger::find(const std::string& filename) -> std::optional<Entry>
+    {
+        auto entry = std::optional<Entry>();
+        {
+            auto lock = std::lock_guard(m_mutex);
+            if (!m_loaded)
+            {
+                load();
+            }
+            if (const auto it = m_entries.find(filename); it != m_entries.end())
+            {
+                entry = it->second;
+            }
+        }
+        if (!entry.has_value())
+        {
+            return std::nullopt;
+        }
+        const auto current = file_entry(m_pkgs_dir / filename);
+        if (!current.has_value() || !same_file(*current, *entry))
+        {
+            return std::nullopt;
+        }
+        return entry;
+    }
+
+    void
+    PackageCacheLedger::record(const std::string& filename, std::string md5, std::string sha256)
+    {
+        auto entry = file_entry(m_pkgs_dir / filename);
+        if (!entry.has_value())
+        {
+            return;
+        }
+        entry->md5 = std::move(md5);
+        entry->sha256 = std::move(sha256);
+        auto lock = std::lock_guard(m_mutex);
+        const auto it = m_entries.find(filename);
+        if ((it != m_entries.end()) && same_file(it->second, *entry))
+        {
+            if (entry->md5.empty())
+            {
+                entry->md5 = it->second.md5;
+            }
+            if (entry->sha256.empty())
+            {
+                entry->sha256 = it->second.sha256;
+            }
+        }
+
+        try
+        {
+            auto file_guard = std::lock_guard(ledger_mutex);
+            // Create the ledger before locking it
+            auto out = open_ofstream(
+                ledger_file(),
+                std::ios::out | std::ios::binary | std::ios::app
+            );
+            auto file_lock = LockFile(ledger_file());
+            out << to_json_line(filename, *entry);
+            if (!out.flush())
+            {
+                throw std::runtime_error("could not write " + ledger_file().string());
+            }
+        }
+        catch (const std::exception& e)
+        {
+            LOG_WARNING << "Could not record " << filename << " in package cache ledger: "
+                        << e.what();
+            return;
+        }
+        m_entries.insert_or_assign(filename, std::move(*entry));
+    }
+
+    auto PackageCacheLedger::last_access(const std::string& pkg_name)
+        -> std::optional<std::int64_t>
+    {
+        auto lock = std::lock_guard(m_mutex);
+        if (!m_loaded)
+        {
+            load();
+        }
+        if (const auto it = m_accesses.find(pkg_name); it != m_accesses.end())
+        {
+            return it->second;
+        }
+        return std::nullopt;
+    }
+
+    void PackageCacheLedger::record_access(const std::vector<std::string>& pkg_names)
+    {
+        if (pkg_names.empty())
+        {
+            return;
+        }
+        const auto since_epoch = std::chrono::system_clock::now().time_since_epoch();
+        const std::int64_t now = std::chrono::duration_cast<std::chrono::seconds>(since_epoch)
+                                     .count();
+        auto lock = std::lock_guard(m_mutex);
+        try
+        {
+            auto file_guard = std::lock_guard(ledger_mutex);
+            // Create the ledger before locking it
+            auto out = open_ofstream(
+                ledger_file(),
+                std::ios::out | std::ios::binary | std::ios::app
+            );
+            auto file_lock = LockFile(ledger_file());
+            for (const auto& name : pkg_names)
+            {
+                out << to_access_line(name, now);
+            }
+            if (!out.flush())
+            {
+                throw std::runtime_error("could not write " + ledger_file().string());
+            }
+        }
+        catch (const std::exception& e)
+        {
+            LOG_WARNING << "Could not record package accesses in package cache ledger: "
+                        << e.what();
+            return;
+        }
+        for (const auto& name : pkg_names)
+        {
+            m_accesses.insert_or_assign(name, now);
+        }
+    }
+}
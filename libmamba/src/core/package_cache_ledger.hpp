@@ -0,0 +1,97 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_PACKAGE_CACHE_LEDGER_HPP
+#define MAMBA_CORE_PACKAGE_CACHE_LEDGER_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mamba/core/mamba_fs.hpp"
+
+#define PACKAGE_CACHE_LEDGER_FILE "tarballs.ledger"
+
+namespace mamba
+{
+    /**
+     * The checksums of the tarballs of a package cache, computed by previous processes.
+     *
+     * Each entry records the size, modification time, and inode of the tarball when it was
+     * hashed, so that a tarball with the same attributes is trusted without hashing it again.
+     * The ledger is a file in the package cache with one json entry per line.
+     * Entries are appended under a file lock, so that processes sharing the package cache can
+     * record tarballs concurrently, and later entries override earlier ones.
+     * Tarballs extracted in place from local channels are recorded by their absolute path.
+     * The ledger also records when packages were last used, to evict the least recently used
+     * packages from the cache first.
+     * A ledger can be used from multiple threads.
+     */
+    class PackageCacheLedger
+    {
+    public:
+
+        struct Entry
+        {
+            std::uintmax_t size = 0;
+            std::int64_t mtime = 0;
+            std::uint64_t inode = 0;
+            std::string md5 = {};
+            std::string sha256 = {};
+        };
+
+        /** The attributes of a file, with empty checksums. */
+        static auto file_entry(const fs::u8path& file) -> std::optional<Entry>;
+
+        explicit PackageCacheLedger(fs::u8path pkgs_dir);
+
+        /**
+         * The entry of a tarball of the package cache.
+         *
+         * Nothing is returned if the tarball was never recorded, or if it changed since.
+         */
+        auto find(const std::string& filename) -> std::optional<Entry>;
+
+        /**
+         * Record the checksums of a tarball of the package cache.
+         *
+         * Empty checksums are filled from the existing entry, if the tarball did not change.
+         * Failures are only logged as the package cache may not be writable.
+         */
+        void record(const std::string& filename, std::string md5, std::string sha256);
+
+        /**
+         * The last time, in seconds since the epoch, a package of the cache was used.
+         *
+         * Nothing is returned if the package was never recorded as used.
+         */
+        auto last_access(const std::string& pkg_name) -> std::optional<std::int64_t>;
+
+        /**
+         * Record that packages of the cache, such as ``xtensor-0.24.6-h0_0``, were used now.
+         *
+         * Failures are only logged as the package cache may not be writable.
+         */
+        void record_access(const std::vector<std::string>& pkg_names);
+
+    private:
+
+        fs::u8path m_pkgs_dir;
+        std::mutex m_mutex = {};
+        std::unordered_map<std::string, Entry> m_entries = {};
+        std::unordered_map<std::string, std::int64_t> m_accesses = {};
+        bool m_loaded = false;
+
+        auto ledger_file() const -> fs::u8path;
+        void load();
+        void compact(std::size_t n_lines);
+    };
+}
+
+#endif
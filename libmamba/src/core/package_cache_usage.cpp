@@ -0,0 +1,252 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/output.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/util_string.hpp"
+
+#include "package_cache_usage.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        /** Bump when the content of the index changes. */
+        constexpr int usage_version = 1;
+        constexpr std::int64_t nanoseconds_per_second = 1'000'000'000;
+
+        /** Serialize updates from the threads of this process, the file lock is per process. */
+        std::mutex usage_mutex;
+
+        auto to_nanoseconds(fs::file_time_type time) -> std::int64_t
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch())
+                .count();
+        }
+
+        auto conda_meta_mtime(const fs::u8path& prefix) -> std::optional<std::int64_t>
+        {
+            auto ec = std::error_code();
+            const auto mtime = fs::last_write_time(prefix / "conda-meta", ec);
+            if (ec)
+            {
+                return std::nullopt;
+            }
+            return to_nanoseconds(mtime);
+        }
+
+        /**
+         * Whether an environment could have changed without changing its modification time.
+         *
+         * On file systems with a resolution of a second, the ``conda-meta`` directory can be
+         * modified again in the second it was listed.
+         */
+        auto is_racy(std::int64_t mtime, std::int64_t listed_at) -> bool
+        {
+            return ((mtime % nanoseconds_per_second) == 0)
+                   && (listed_at - mtime < 2 * nanoseconds_per_second);
+        }
+
+        /** List the packages of an environment, nothing if it is not an environment. */
+        auto list_environment(const fs::u8path& prefix) -> std::optional<nlohmann::json>
+        {
+            // Read before listing, so that a later change is detected
+            const auto mtime = conda_meta_mtime(prefix);
+            if (!mtime.has_value())
+            {
+                return std::nullopt;
+            }
+            const auto listed_at = to_nanoseconds(fs::file_time_type::clock::now());
+            return nlohmann::json{
+                { "mtime", *mtime },
+                { "listed_at", listed_at },
+                { "packages", PackageCacheUsage::installed_packages(prefix) },
+            };
+        }
+
+        /** The recorded environments, empty if the index is missing or invalid. */
+        auto read_usage(const fs::u8path& file) -> nlohmann::json
+        {
+            if (!fs::exists(file) || fs::is_empty(file))
+            {
+                return nlohmann::json::object();
+            }
+            try
+            {
+                auto in = open_ifstream(file);
+                auto usage = nlohmann::json::parse(in);
+                if (usage.at("version").get<int>() == usage_version)
+                {
+                    for (const auto& entry : usage.at("environments"))
+                    {
+                        entry.at("mtime").get<std::int64_t>();
+                        entry.at("listed_at").get<std::int64_t>();
+                        entry.at("packages").get<std::set<std::string>>();
+                    }
+                    return std::move(usage.at("environments"));
+                }
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Invalid package cache usage index " << file << ": " << e.what();
+            }
+            return nlohmann::json::object();
+        }
+
+        /** Update the recorded environments, removing the ones that no longer exist. */
+        void update_usage(const fs::u8path& file, const nlohmann::json& environments)
+        {
+            auto file_guard = std::lock_guard(usage_mutex);
+            // A file can only be locked once it exists
+            open_ofstream(file, std::ios::app | std::ios::binary);
+            auto file_lock = LockFile(file);
+            if (!file_lock)
+            {
+                return;
+            }
+
+            // Read again, now that no other process can update the index
+            auto usage_envs = read_usage(file);
+            for (const auto& [prefix, entry] : environments.items())
+            {
+                usage_envs[prefix] = entry;
+            }
+            for (auto it = usage_envs.begin(); it != usage_envs.end();)
+            {
+                if (fs::exists(fs::u8path(it.key()) / "conda-meta"))
+                {
+                    ++it;
+                }
+                else
+                {
+                    it = usage_envs.erase(it);
+                }
+            }
+
+            const auto usage = nlohmann::json{
+                { "version", usage_version },
+                { "environments", std::move(usage_envs) },
+            };
+            // Write to a temporary file so that readers never see a partial index
+            auto tmp_file = TemporaryFile("mambaf", ".json", file.parent_path());
+            {
+                auto out = open_ofstream(tmp_file.path());
+                out << usage.dump();
+                if (!out.flush())
+                {
+                    throw std::runtime_error("could not write " + tmp_file.path().string());
+                }
+            }
+            fs::rename(tmp_file.path(), file);
+        }
+    }
+
+    auto PackageCacheUsage::installed_packages(const fs::u8path& prefix) -> std::set<std::string>
+    {
+        std::set<std::string> out;
+        for (auto& pkg : fs::directory_iterator(prefix / "conda-meta"))
+        {
+            if (ends_with(pkg.path().string(), ".json"))
+            {
+                std::string pkg_name = pkg.path().filename().string();
+                out.insert(pkg_name.substr(0, pkg_name.size() - 5));
+            }
+        }
+        return out;
+    }
+
+    PackageCacheUsage::PackageCacheUsage(fs::u8path pkgs_dir)
+        : m_pkgs_dir(std::move(pkgs_dir))
+    {
+    }
+
+    auto PackageCacheUsage::usage_file() const -> fs::u8path
+    {
+        return m_pkgs_dir / PACKAGE_CACHE_USAGE_FILE;
+    }
+
+    void PackageCacheUsage::record(const fs::u8path& prefix)
+    {
+        if (m_pkgs_dir.empty())
+        {
+            return;
+        }
+        try
+        {
+            if (auto entry = list_environment(prefix))
+            {
+                update_usage(
+                    usage_file(),
+                    { { fs::absolute(prefix).string(), std::move(*entry) } }
+                );
+            }
+        }
+        catch (const std::exception& e)
+        {
+            LOG_DEBUG << "Could not record environment " << prefix
+                      << " in package cache usage index " << usage_file() << ": " << e.what();
+        }
+    }
+
+    auto PackageCacheUsage::usage(const std::vector<fs::u8path>& prefixes)
+        -> std::map<std::string, std::set<fs::u8path>>
+    {
+        std::map<std::string, std::set<fs::u8path>> out;
+        // Without a package cache, environments are always listed
+        const auto usage_envs = m_pkgs_dir.empty() ? nlohmann::json::object()
+                                                   : read_usage(usage_file());
+        auto updated = nlohmann::json::object();
+        for (const auto& prefix : prefixes)
+        {
+            const auto key = fs::absolute(prefix).string();
+            const auto mtime = conda_meta_mtime(prefix);
+            const nlohmann::json* entry = nullptr;
+            if (auto it = usage_envs.find(key); mtime.has_value() && (it != usage_envs.end())
+                                                && (it->at("mtime") == *mtime)
+                                                && !is_racy(*mtime, it->at("listed_at")))
+            {
+                entry = &(*it);
+            }
+            else if (auto listed = list_environment(prefix))
+            {
+                LOG_DEBUG << "Listing packages of environment " << prefix;
+                entry = &(updated[key] = std::move(*listed));
+            }
+            else
+            {
+                continue;
+            }
+
+            for (const auto& pkg : entry->at("packages"))
+            {
+                out[pkg.get<std::string>()].insert(prefix);
+            }
+        }
+
+        if (!updated.empty() && !m_pkgs_dir.empty())
+        {
+            try
+            {
+                update_usage(usage_file(), updated);
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Could not update package cache usage index " << usage_file() << ": "
+                          << e.what();
+            }
+        }
+        return out;
+    }
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_PACKAGE_CACHE_USAGE_HPP
+#define MAMBA_CORE_PACKAGE_CACHE_USAGE_HPP
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mamba/core/mamba_fs.hpp"
+
+#define PACKAGE_CACHE_USAGE_FILE "mamba-usage.json"
+
+namespace mamba
+{
+    /**
+     * The environments using the packages of a package cache.
+     *
+     * For each environment, the index records the packages installed in it, listed from its
+     * ``conda-meta`` directory, with the modification time of that directory.
+     * The packages of an environment that did not change since it was recorded are not listed
+     * again, while environments changed since, for instance by another tool, are listed again.
+     * The index is a file in the package cache, updated under a file lock so that processes
+     * sharing the package cache can record environments concurrently.
+     */
+    class PackageCacheUsage
+    {
+    public:
+
+        /** The packages installed in ``prefix``, such as ``xtensor-0.24.6-h0_0``. */
+        static auto installed_packages(const fs::u8path& prefix) -> std::set<std::string>;
+
+        explicit PackageCacheUsage(fs::u8path pkgs_dir);
+
+        /**
+         * Record the packages installed in an environment.
+         *
+         * Failures are only logged as the package cache may not be writable.
+         */
+        void record(const fs::u8path& prefix);
+
+        /**
+         * The environments using each package, among ``prefixes``.
+         *
+         * Environments that changed since they were recorded are recorded again.
+         */
+        auto usage(const std::vector<fs::u8path>& prefixes)
+            -> std::map<std::string, std::set<fs::u8path>>;
+
+    private:
+
+        fs::u8path m_pkgs_dir;
+
+        auto usage_file() const -> fs::u8path;
+    };
+}
+
+#endif
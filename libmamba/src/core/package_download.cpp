@@ -4,8 +4,14 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
 #include <stack>
+#include <string>
+#include <string_view>
+#include <utility>
 
 #include <fmt/color.h>
 #include <fmt/format.h>
@@ -16,14 +22,26 @@
 #include "mamba/core/execution.hpp"
 #include "mamba/core/fetch.hpp"
 #include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/match_spec.hpp"
+#include "mamba/core/memory_budget.hpp"
+#include "mamba/core/metrics.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/package_cache.hpp"
 #include "mamba/core/package_download.hpp"
 #include "mamba/core/package_handling.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/prefix_data.hpp"
 #include "mamba/core/progress_bar.hpp"
+#include "mamba/core/solution.hpp"
 #include "mamba/core/thread_utils.hpp"
+#include "mamba/core/tracing.hpp"
+#include "mamba/core/url.hpp"
+#include "mamba/core/util_random.hpp"
+#include "mamba/core/util_scope.hpp"
 #include "mamba/core/util_string.hpp"
 
+#include "package_cache_ledger.hpp"
+#include "package_store.hpp"
 #include "progress_bar_impl.hpp"
 
 namespace mamba
@@ -32,6 +50,98 @@ namespace mamba
      * PackageDownloadExtractTarget *
      ********************************/
 
+    namespace
+    {
+        /**
+         * The memory estimated to be needed to extract a package of @p size bytes.
+         *
+         * The decompression window is at most the size of the compressed data, and the
+         * decompressed chunks read ahead of the archive reader are bounded.
+         */
+        std::size_t extract_memory(std::size_t size)
+        {
+            constexpr std::size_t max_window = std::size_t(128) << 20;
+            constexpr std::size_t read_ahead = std::size_t(8) << 20;
+            return std::min(size, max_window) + read_ahead;
+        }
+    }
+
+    namespace detail
+    {
+        /** Whether @p path is below @p dir, comparing whole path components. */
+        bool is_below(const fs::u8path& path, const fs::u8path& dir)
+        {
+            const auto& p = path.std_path();
+            const auto& d = dir.std_path();
+            // A trailing separator is an empty last component
+            const auto d_end = (d.has_relative_path() && !d.has_filename()) ? std::prev(d.end())
+                                                                             : d.end();
+            const auto [d_it, p_it] = std::mismatch(d.begin(), d_end, p.begin(), p.end());
+            return (d_it == d_end) && (p_it != p.end());
+        }
+
+        /** Whether a local tarball is in one of the ``trusted_local_channels``. */
+        bool is_trusted_local(const fs::u8path& tarball)
+        {
+            const auto path = fs::weakly_canonical(tarball);
+            const auto& trusted = Context::instance().trusted_local_channels;
+            return std::any_of(
+                trusted.cbegin(),
+                trusted.cend(),
+                [&](const fs::u8path& dir) { return is_below(path, dir); }
+            );
+        }
+
+        /** Whether a local tarball was written before the ``repodata.json`` of its subdir. */
+        bool is_indexed(const fs::u8path& tarball)
+        {
+            std::error_code ec;
+            const auto indexed = fs::last_write_time(tarball.parent_path() / "repodata.json", ec);
+            if (ec)
+            {
+                return false;
+            }
+            const auto written = fs::last_write_time(tarball, ec);
+            return !ec && (written <= indexed);
+        }
+
+        /** The 64 bits FNV-1a hash of @p str, the same on every platform and build. */
+        std::uint64_t stable_hash(std::string_view str)
+        {
+            std::uint64_t hash = 14695981039346656037ULL;
+            for (const char c : str)
+            {
+                hash ^= static_cast<unsigned char>(c);
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        /**
+         * The url of @p filename on the package cache peer picked for it, empty if none.
+         *
+         * A filename is always requested from the same peer, so that the peers do not all
+         * download it from the channel @p url, which they are given to do so.
+         */
+        std::string peer_url(const std::string& url, const std::string& filename)
+        {
+            const auto& peers = Context::instance().package_cache_peers;
+            if (peers.empty() || !(starts_with(url, "https://") || starts_with(url, "http://")))
+            {
+                return "";
+            }
+            std::string remaining_url, scheme, auth, token;
+            split_scheme_auth_token(url, remaining_url, scheme, auth, token);
+            if (!auth.empty() || !token.empty())
+            {
+                return "";
+            }
+            // Picked the same by all the clients, whichever their platform
+            const auto& peer = peers[stable_hash(filename) % peers.size()];
+            return concat(rstrip(peer, '/'), "/pkgs/", filename, "?url=", encode_url(url));
+        }
+    }
+
     counting_semaphore DownloadExtractSemaphore::semaphore(0);
 
     std::ptrdiff_t DownloadExtractSemaphore::get_max()
@@ -48,8 +158,7 @@ namespace mamba
         const PackageInfo& pkg_info,
         ChannelContext& channel_context
     )
-        : m_finished(false)
-        , m_package_info(pkg_info)
+        : m_package_info(pkg_info)
     {
         m_filename = pkg_info.fn;
 
@@ -75,6 +184,11 @@ namespace mamba
         );
     }
 
+    PackageDownloadExtractTarget::~PackageDownloadExtractTarget()
+    {
+        abort_stream_extract();
+    }
+
     void PackageDownloadExtractTarget::write_repodata_record(const fs::u8path& base_path)
     {
         fs::u8path repodata_record_path = base_path / "info" / "repodata_record.json";
@@ -92,8 +206,10 @@ namespace mamba
             index["size"] = fs::file_size(m_tarball_path);
         }
 
+        // Compact, as it is only read by programs
         std::ofstream repodata_record(repodata_record_path.std_path());
-        repodata_record << index.dump(4);
+        repodata_record << index.dump();
+        m_repodata_record = std::move(index);
     }
 
     static std::mutex urls_txt_mutex;
@@ -107,13 +223,19 @@ namespace mamba
 
     void PackageDownloadExtractTarget::validate()
     {
+        auto trace = Tracer::instance().scope("validate " + m_name);
+        trace.add_counter("bytes", m_expected_size);
         m_validation_result = VALIDATION_RESULT::VALID;
-        if (m_expected_size && (m_target->get_downloaded_size() != m_expected_size))
+        // Local tarballs are validated in place, from their file
+        const std::size_t size = m_target ? m_target->get_downloaded_size()
+                                          : static_cast<std::size_t>(fs::file_size(m_tarball_path));
+        auto digest = m_target ? m_target->get_hex_digest() : std::optional<std::string>();
+        if (m_expected_size && (size != m_expected_size))
         {
             LOG_ERROR << "File not valid: file size doesn't match expectation " << m_tarball_path
                       << "\nExpected: " << m_expected_size
-                      << "\nActual: " << m_target->get_downloaded_size() << "\n";
-            if (m_has_progress_bars)
+                      << "\nActual: " << size << "\n";
+            if (m_has_progress_bars && m_target)
             {
                 m_download_bar.set_postfix("validation failed");
                 m_download_bar.mark_as_completed();
@@ -124,13 +246,42 @@ namespace mamba
         }
         interruption_point();
 
+        // Local tarballs are recorded in the ledger by their path, not being in the cache
+        auto ledger = PackageCacheLedger(m_cache_path);
+        const auto ledger_key = m_local_tarball ? m_tarball_path.string() : m_filename;
+        if (m_local_tarball && detail::is_trusted_local(m_tarball_path))
+        {
+            // Built on this machine, only checked for having been indexed since
+            if (detail::is_indexed(m_tarball_path))
+            {
+                LOG_DEBUG << "Trusting local tarball '" << m_tarball_path.string() << "'";
+                ledger.record(ledger_key, m_md5, m_sha256);
+                return;
+            }
+            LOG_WARNING << "Local tarball '" << m_tarball_path.string()
+                        << "' is newer than its repodata, computing its checksum";
+        }
+        if (m_local_tarball && !Context::instance().verify_package_cache)
+        {
+            // Unchanged since hashed by a previous process
+            if (const auto entry = ledger.find(ledger_key); entry.has_value())
+            {
+                const auto& checksum = m_sha256.empty() ? entry->md5 : entry->sha256;
+                if (!checksum.empty())
+                {
+                    digest = checksum;
+                }
+            }
+        }
+
+        // Hashed while downloading
         if (!m_sha256.empty())
         {
-            auto sha256sum = validation::sha256sum(m_tarball_path);
+            auto sha256sum = digest ? *digest : validation::sha256sum(m_tarball_path);
             if (m_sha256 != sha256sum)
             {
                 m_validation_result = SHA256_ERROR;
-                if (m_has_progress_bars)
+                if (m_has_progress_bars && m_target)
                 {
                     m_download_bar.set_postfix("validation failed");
                     m_download_bar.mark_as_completed();
@@ -138,16 +289,19 @@ namespace mamba
                 Console::instance().print(m_filename + " tarball has incorrect checksum");
                 LOG_ERROR << "File not valid: SHA256 sum doesn't match expectation " << m_tarball_path
                           << "\nExpected: " << m_sha256 << "\nActual: " << sha256sum << "\n";
+                return;
             }
+            // Spare the next processes hashing the tarball again
+            ledger.record(ledger_key, "", std::move(sha256sum));
             return;
         }
         if (!m_md5.empty())
         {
-            auto md5sum = validation::md5sum(m_tarball_path);
+            auto md5sum = digest ? *digest : validation::md5sum(m_tarball_path);
             if (m_md5 != md5sum)
             {
                 m_validation_result = MD5SUM_ERROR;
-                if (m_has_progress_bars)
+                if (m_has_progress_bars && m_target)
                 {
                     m_download_bar.set_postfix("validation failed");
                     m_download_bar.mark_as_completed();
@@ -155,7 +309,9 @@ namespace mamba
                 Console::instance().print(m_filename + " tarball has incorrect checksum");
                 LOG_ERROR << "File not valid: MD5 sum doesn't match expectation " << m_tarball_path
                           << "\nExpected: " << m_md5 << "\nActual: " << md5sum << "\n";
+                return;
             }
+            ledger.record(ledger_key, std::move(md5sum), "");
         }
     }
 
@@ -185,10 +341,117 @@ namespace mamba
         };
     }
 
+    fs::u8path PackageDownloadExtractTarget::extract_path() const
+    {
+        std::string fn = m_filename;
+        if (ends_with(fn, ".tar.bz2"))
+        {
+            fn = fn.substr(0, fn.size() - 8);
+        }
+        else if (ends_with(fn, ".conda"))
+        {
+            fn = fn.substr(0, fn.size() - 6);
+        }
+        else
+        {
+            LOG_ERROR << "Unknown package format '" << m_filename << "'";
+            throw std::runtime_error("Unknown package format.");
+        }
+        return m_cache_path / fn;
+    }
+
+    nlohmann::json PackageDownloadExtractTarget::take_repodata_record()
+    {
+        return std::exchange(m_repodata_record, nullptr);
+    }
+
+    fs::u8path PackageDownloadExtractTarget::make_staging_path() const
+    {
+        // Other processes never see partially extracted packages
+        return m_cache_path / ".extracting"
+               / (extract_path().filename().string() + "-"
+                  + generate_random_alphanumeric_string(8));
+    }
+
+    void PackageDownloadExtractTarget::publish_extracted()
+    {
+        const auto path = extract_path();
+        const auto entry_lock = lock_package_entry(m_cache_path, m_filename, LockMode::exclusive);
+        // Be sure the first writable cache doesn't contain invalid extracted package
+        if (fs::exists(path))
+        {
+            LOG_DEBUG << "Removing '" << path.string() << "' before replacing it";
+            fs::remove_all(path);
+        }
+        fs::rename(m_staging_path, path);
+        m_staging_path.clear();
+    }
+
+    void PackageDownloadExtractTarget::stream_data(const char* data, std::size_t size)
+    {
+        m_streamed_size += size;
+
+        if (!m_extract_future.valid())
+        {
+            m_extract_future = m_stream_extracted.get_future();
+            MainExecutor::instance().schedule(&PackageDownloadExtractTarget::stream_extract, this);
+        }
+        m_stream_extractor->write(data, size);
+    }
+
+    void PackageDownloadExtractTarget::stream_extract()
+    {
+        bool extracted = false;
+        try
+        {
+            m_staging_path = make_staging_path();
+            LOG_DEBUG << "Extracting '" << m_filename << "' while downloading it";
+            m_stream_extractor->extract(m_staging_path, Context::instance().exclude_files);
+            extracted = true;
+        }
+        catch (const std::exception& e)
+        {
+            LOG_DEBUG << "Extraction while downloading '" << m_filename << "' failed: " << e.what();
+        }
+        m_stream_memory.release();
+        m_stream_extracted.set_value(extracted);
+    }
+
+    bool PackageDownloadExtractTarget::is_fully_streamed() const
+    {
+        return m_stream_extractor && (m_streamed_size == m_target->get_downloaded_size());
+    }
+
+    void PackageDownloadExtractTarget::abort_stream_extract()
+    {
+        if (m_stream_extractor && m_extract_future.valid())
+        {
+            m_stream_extractor->abort();
+            m_extract_future.get();
+            if (!m_staging_path.empty())
+            {
+                // Extracted from data that is not valid
+                std::error_code ec;
+                fs::remove_all(m_staging_path, ec);
+                m_staging_path.clear();
+            }
+        }
+    }
+
     bool PackageDownloadExtractTarget::extract()
     {
-        // Extracting is __not__ yet thread safe it seems...
         interruption_point();
+        auto trace = Tracer::instance().scope("extract " + m_name);
+        trace.add_counter("bytes", m_expected_size);
+        static auto& extract_seconds = Metrics::instance().histogram(
+            "mamba_extract_seconds",
+            "Time of the package extractions, including the wait for those streamed"
+        );
+        const auto start = MetricHistogram::clock::now();
+        auto observe = on_scope_exit([&] { extract_seconds.observe_since(start); });
+
+        // Waits for the extraction while downloading, if any, to finish
+        const bool streamed = m_extract_future.valid() && m_extract_future.get();
 
         if (m_has_progress_bars)
         {
@@ -202,49 +465,52 @@ namespace mamba
         }
         {
             std::lock_guard<counting_semaphore> lock(DownloadExtractSemaphore::semaphore);
+            auto memory = MemoryBudget::Reservation();
+            if (!streamed)
+            {
+                memory = MemoryBudget::instance().reserve(extract_memory(m_expected_size));
+            }
             interruption_point();
             LOG_DEBUG << "Decompressing '" << m_tarball_path.string() << "'";
             fs::u8path extract_path;
             try
             {
-                std::string fn = m_filename;
-                if (ends_with(fn, ".tar.bz2"))
-                {
-                    fn = fn.substr(0, fn.size() - 8);
-                }
-                else if (ends_with(fn, ".conda"))
+                extract_path = this->extract_path();
+                if (streamed)
                 {
-                    fn = fn.substr(0, fn.size() - 6);
+                    LOG_DEBUG << "Extracted while downloading '" << m_filename << "'";
                 }
                 else
                 {
-                    LOG_ERROR << "Unknown package format '" << m_filename << "'";
-                    throw std::runtime_error("Unknown package format.");
+                    // Extraction does not depend on the working directory, so archives are
+                    // extracted concurrently on the extraction threads
+                    if (!m_staging_path.empty())
+                    {
+                        // Left by a failed extraction while downloading
+                        std::error_code ec;
+                        fs::remove_all(m_staging_path, ec);
+                    }
+                    m_staging_path = make_staging_path();
+                    mamba::extract(
+                        m_tarball_path,
+                        m_staging_path,
+                        Context::instance().exclude_files
+                    );
                 }
-                // Be sure the first writable cache doesn't contain invalid extracted package
-                extract_path = m_cache_path / fn;
-                if (fs::exists(extract_path))
-                {
-                    LOG_DEBUG << "Removing '" << extract_path.string()
-                              << "' before extracting it again";
-                    fs::remove_all(extract_path);
-                }
-
-                // Use non-subproc version if concurrency is disabled to avoid
-                // any potential subprocess issues
-                if (DownloadExtractSemaphore::get_max() == 1)
-                {
-                    mamba::extract(m_tarball_path, extract_path);
-                }
-                else
-                {
-                    mamba::extract_subproc(m_tarball_path, extract_path);
-                }
-                // mamba::extract(m_tarball_path, extract_path);
                 interruption_point();
+                write_repodata_record(m_staging_path);
+                // Readers of the cache wait only while the extracted directory is replaced
+                publish_extracted();
                 LOG_DEBUG << "Extracted to '" << extract_path.string() << "'";
-                write_repodata_record(extract_path);
+                // Not worth sharing when removed once linked
+                const auto& ctx = Context::instance();
+                if (ctx.extract_dedup && !ctx.container_build)
+                {
+                    PackageStore(extract_path.parent_path()).deduplicate(extract_path);
+                }
                 add_url();
+                Console::instance().progress_event({ { "event", "extracted" },
+                                                     { "name", m_name } });
 
                 if (m_has_progress_bars)
                 {
@@ -254,10 +520,19 @@ namespace mamba
             }
             catch (std::exception& e)
             {
+                if (!m_staging_path.empty())
+                {
+                    std::error_code ec;
+                    fs::remove_all(m_staging_path, ec);
+                    m_staging_path.clear();
+                }
                 Console::instance().print(m_filename + " extraction failed");
                 LOG_ERROR << "Error when extracting package: " << e.what();
                 m_decompress_exception = e;
                 m_validation_result = VALIDATION_RESULT::EXTRACT_ERROR;
+                Console::instance().progress_event(
+                    { { "event", "extract_failed" }, { "name", m_name }, { "error", e.what() } }
+                );
                 if (m_has_progress_bars)
                 {
                     m_extract_bar.set_postfix("extraction failed");
@@ -271,8 +546,9 @@ namespace mamba
 
     bool PackageDownloadExtractTarget::extract_from_cache()
     {
+        // Also when interrupted, so that nothing waits for the package forever
+        const auto finish = on_scope_exit([this] { set_finished(); });
         this->extract();
-        m_finished = true;
         return true;
     }
 
@@ -280,12 +556,19 @@ namespace mamba
     {
         using std::chrono::nanoseconds;
 
+        const auto finish = on_scope_exit([this] { set_finished(); });
+
         if (m_has_progress_bars)
         {
             m_extract_bar.start();
             m_extract_bar.set_postfix("validating");
         }
         validate();
+        if ((m_validation_result != VALIDATION_RESULT::VALID) && downloaded_from_peer()
+            && download_from_channel())
+        {
+            validate();
+        }
 
         // Validation
         if (m_validation_result != VALIDATION_RESULT::VALID)
@@ -295,8 +578,10 @@ namespace mamba
                 m_extract_bar.set_postfix("validation failed");
             }
             LOG_WARNING << "'" << m_tarball_path.string() << "' validation failed";
-            // abort here, but set finished to true
-            m_finished = true;
+            Console::instance().progress_event({ { "event", "validation_failed" },
+                                                 { "name", m_name } });
+            abort_stream_extract();
+            // abort here, but finished all the same
             return true;
         }
 
@@ -306,13 +591,56 @@ namespace mamba
         }
         LOG_DEBUG << "'" << m_tarball_path.string() << "' successfully validated";
 
-        bool result = this->extract();
-        m_finished = true;
-        return result;
+        return this->extract();
+    }
+
+    bool PackageDownloadExtractTarget::downloaded_from_peer() const
+    {
+        // Unless the download already fell back to the channel
+        return m_target && !m_local_tarball && (m_target->get_url() != m_url);
+    }
+
+    bool PackageDownloadExtractTarget::download_from_channel()
+    {
+        LOG_WARNING << "'" << m_filename << "' from package cache peer '" << m_target->get_url()
+                    << "' is not valid, downloading it from '" << m_url << "'";
+        abort_stream_extract();
+        std::error_code ec;
+        fs::remove(m_tarball_path, ec);
+
+        m_peer_target = std::move(m_target);
+        m_target = std::make_unique<DownloadTarget>(m_name, m_url, m_tarball_path.string());
+        m_target->set_expected_size(m_expected_size);
+        if (!m_sha256.empty())
+        {
+            m_target->set_hash(validation::HashStream::sha256());
+        }
+        else if (!m_md5.empty())
+        {
+            m_target->set_hash(validation::HashStream::md5());
+        }
+        return m_target->perform() && (m_target->get_http_status() < 400);
     }
 
     bool PackageDownloadExtractTarget::finalize_callback(const DownloadTarget&)
     {
+        if (m_stream_extractor)
+        {
+            if ((m_target->get_http_status() < 400) && is_fully_streamed())
+            {
+                m_stream_extractor->close();
+            }
+            else
+            {
+                m_stream_extractor->abort();
+            }
+            if (!m_extract_future.valid())
+            {
+                // No data was received, so the extraction never started
+                m_stream_memory.release();
+            }
+        }
+
         if (m_has_progress_bars)
         {
             m_download_bar.repr().postfix.set_value("Downloaded").deactivate();
@@ -338,6 +666,20 @@ namespace mamba
         return m_finished;
     }
 
+    void PackageDownloadExtractTarget::set_finished_callback(finished_callback_type callback)
+    {
+        m_finished_callback = std::move(callback);
+    }
+
+    void PackageDownloadExtractTarget::set_finished()
+    {
+        m_finished = true;
+        if (m_finished_callback)
+        {
+            m_finished_callback(*this);
+        }
+    }
+
     auto PackageDownloadExtractTarget::validation_result() const -> VALIDATION_RESULT
     {
         return m_validation_result;
@@ -345,6 +687,19 @@ namespace mamba
 
     void PackageDownloadExtractTarget::clear_cache() const
     {
+        if (m_local_tarball)
+        {
+            // The tarball belongs to the channel, only the extracted package is ours
+            const auto entry_lock = lock_package_entry(
+                m_cache_path,
+                m_filename,
+                LockMode::exclusive
+            );
+            std::error_code ec;
+            fs::remove_all(extract_path(), ec);
+            return;
+        }
+        const auto entry_lock = lock_package_entry(m_cache_path, m_filename, LockMode::exclusive);
         fs::remove_all(m_tarball_path);
         fs::u8path dest_dir = strip_package_extension(m_tarball_path.string());
         if (fs::exists(dest_dir))
@@ -358,6 +713,11 @@ namespace mamba
         return m_name;
     }
 
+    const PackageInfo& PackageDownloadExtractTarget::package_info() const
+    {
+        return m_package_info;
+    }
+
     std::size_t PackageDownloadExtractTarget::expected_size() const
     {
         return m_expected_size;
@@ -402,6 +762,20 @@ namespace mamba
                 LOG_DEBUG << "Using cached tarball '" << m_filename << "'";
                 return nullptr;
             }
+            else if (const auto local_path = local_path_from_url(m_url);
+                     !local_path.empty() && fs::is_regular_file(local_path))
+            {
+                // Local channels, such as on network file systems, are not copied to the cache
+                LOG_DEBUG << "Extracting '" << m_filename << "' in place from '" << local_path
+                          << "'";
+                m_tarball_path = local_path;
+                m_local_tarball = true;
+                MainExecutor::instance().schedule(
+                    &PackageDownloadExtractTarget::validate_extract,
+                    this
+                );
+                return nullptr;
+            }
             else
             {
                 caches.clear_query_cache(m_package_info);
@@ -409,9 +783,54 @@ namespace mamba
                 LOG_DEBUG << "Adding '" << m_name << "' to download targets from '" << m_url << "'";
 
                 m_tarball_path = m_cache_path / m_filename;
-                m_target = std::make_unique<DownloadTarget>(m_name, m_url, m_tarball_path.string());
+                if (const auto peer = detail::peer_url(m_url, m_filename); !peer.empty())
+                {
+                    LOG_DEBUG << "Downloading '" << m_filename << "' from '" << peer << "'";
+                    m_target = std::make_unique<DownloadTarget>(
+                        m_name,
+                        peer,
+                        m_tarball_path.string()
+                    );
+                    m_target->set_fallback_url(m_url, true);
+                }
+                else
+                {
+                    m_target = std::make_unique<DownloadTarget>(
+                        m_name,
+                        m_url,
+                        m_tarball_path.string()
+                    );
+                }
                 m_target->set_finalize_callback(&PackageDownloadExtractTarget::finalize_callback, this);
                 m_target->set_expected_size(m_expected_size);
+                if (!m_sha256.empty())
+                {
+                    m_target->set_hash(validation::HashStream::sha256());
+                }
+                else if (!m_md5.empty())
+                {
+                    m_target->set_hash(validation::HashStream::md5());
+                }
+                // Interrupted downloads of large packages continue where they stopped
+                m_target->set_resumable(true);
+                // Extracted after downloading instead if the memory is needed by the others
+                constexpr std::size_t max_buffered = std::size_t(64) << 20;
+                auto stream_memory = std::optional<MemoryBudget::Reservation>();
+                const auto& ctx = Context::instance();
+                const bool streaming = ctx.extract_streaming || ctx.container_build;
+                if (streaming && ends_with(m_filename, ".conda"))
+                {
+                    stream_memory = MemoryBudget::instance().try_reserve(
+                        extract_memory(m_expected_size) + std::min(m_expected_size, max_buffered)
+                    );
+                }
+                if (stream_memory.has_value())
+                {
+                    m_stream_memory = std::move(stream_memory).value();
+                    m_stream_extractor = std::make_unique<CondaStreamExtractor>(max_buffered);
+                    m_target->set_data_callback([this](const char* data, std::size_t size)
+                                                { stream_data(data, size); });
+                }
                 if (m_has_progress_bars)
                 {
                     m_download_bar = Console::instance().add_progress_bar(m_name, m_expected_size);
@@ -422,7 +841,222 @@ namespace mamba
             }
         }
         LOG_DEBUG << "Using cached '" << m_name << "'";
-        m_finished = true;
+        m_cache_path = extracted_cache;
+        set_finished();
         return nullptr;
     }
+
+    /*******************
+     * PackagePrefetch *
+     *******************/
+
+    namespace
+    {
+        /** The latest build of @p spec in @p pool, allowed by the @p pins of its name. */
+        std::optional<PackageInfo>
+        latest_build(MPool& pool, const MatchSpec& spec, const std::vector<MatchSpec>& pins)
+        {
+            auto allowed = std::optional<std::set<Id>>();
+            for (const auto& pin : pins)
+            {
+                if (pin.name != spec.name)
+                {
+                    continue;
+                }
+                const auto pinned = pool.select_solvables(pool.matchspec2id(pin));
+                auto still_allowed = std::set<Id>();
+                for (const auto id : pinned)
+                {
+                    if (!allowed.has_value() || (allowed->count(id) > 0))
+                    {
+                        still_allowed.insert(id);
+                    }
+                }
+                allowed = std::move(still_allowed);
+            }
+
+            // By decreasing version, the builds of the latest one by build number
+            auto best = std::optional<PackageInfo>();
+            for (const auto id : pool.select_solvables(pool.matchspec2id(spec), true))
+            {
+                if (allowed.has_value() && (allowed->count(id) == 0))
+                {
+                    continue;
+                }
+                auto pkg = pool.id2pkginfo(id);
+                if (!pkg.has_value())
+                {
+                    continue;
+                }
+                if (best.has_value() && (pkg->version != best->version))
+                {
+                    break;
+                }
+                if (!best.has_value() || (pkg->build_number > best->build_number))
+                {
+                    best = std::move(pkg);
+                }
+            }
+            return best;
+        }
+    }
+
+    PackagePrefetch::PackagePrefetch() = default;
+
+    PackagePrefetch::~PackagePrefetch()
+    {
+        wait();
+    }
+
+    void PackagePrefetch::start(
+        MPool& pool,
+        MultiPackageCache& caches,
+        const PrefixData& prefix,
+        const std::vector<std::string>& specs,
+        const std::vector<MatchSpec>& pins
+    )
+    {
+        wait();
+        m_prefetched.clear();
+        m_caches = &caches;
+        try
+        {
+            m_cache_path = caches.first_writable_path();
+            const auto& installed = prefix.records();
+            for (const auto& str : specs)
+            {
+                const auto spec = MatchSpec(str, pool.channel_context());
+                // Virtual packages are never downloaded
+                if (spec.name.empty() || starts_with(spec.name, "__"))
+                {
+                    continue;
+                }
+                auto pkg = latest_build(pool, spec, pins);
+                if (!pkg.has_value() || pkg->url.empty())
+                {
+                    continue;
+                }
+                if (const auto it = installed.find(pkg->name);
+                    (it != installed.end()) && (it->second.str() == pkg->str()))
+                {
+                    continue;
+                }
+                if (!caches.get_extracted_dir_path(*pkg).empty()
+                    || !caches.get_tarball_path(*pkg).empty())
+                {
+                    continue;
+                }
+
+                auto url = Context::instance().command_params.is_micromamba
+                               ? pool.channel_context().make_channel(pkg->url).urls(true)[0]
+                               : pkg->url;
+                // Not in the cache until validated and installed by the solution
+                auto file = std::make_unique<TemporaryFile>("mambap", "", m_cache_path);
+                auto target = std::make_unique<DownloadTarget>(
+                    pkg->name,
+                    url,
+                    file->path().string()
+                );
+                target->set_expected_size(pkg->size);
+                if (!pkg->sha256.empty())
+                {
+                    target->set_hash(validation::HashStream::sha256());
+                }
+                m_prefetched.push_back({ std::move(*pkg), std::move(file), std::move(target) });
+            }
+        }
+        catch (const std::exception& e)
+        {
+            LOG_DEBUG << "Not prefetching packages: " << e.what();
+            m_prefetched.clear();
+        }
+        if (m_prefetched.empty())
+        {
+            return;
+        }
+
+        LOG_INFO << "Prefetching " << m_prefetched.size() << " packages while solving";
+        m_thread = std::thread(
+            [this]()
+            {
+                auto multi_dl = MultiDownloadTarget();
+                for (auto& prefetched : m_prefetched)
+                {
+                    multi_dl.add(prefetched.target.get());
+                }
+                try
+                {
+                    multi_dl.download(MAMBA_NO_PROGRESS_BARS);
+                }
+                catch (const std::exception& e)
+                {
+                    LOG_DEBUG << "Could not prefetch packages: " << e.what();
+                }
+            }
+        );
+    }
+
+    void PackagePrefetch::wait()
+    {
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    std::size_t PackagePrefetch::finish(const Solution& solution)
+    {
+        wait();
+        auto to_install = std::set<std::string>();
+        for_each_to_install(
+            solution.actions,
+            [&](const PackageInfo& pkg) { to_install.insert(pkg.url); }
+        );
+
+        std::size_t kept = 0;
+        for (auto& prefetched : m_prefetched)
+        {
+            const auto& pkg = prefetched.package;
+            const auto& target = *prefetched.target;
+            const auto& path = prefetched.file->path();
+            if ((to_install.count(pkg.url) == 0) || (target.get_http_status() >= 400))
+            {
+                continue;
+            }
+            std::error_code ec;
+            const auto size = fs::file_size(path, ec);
+            if (ec || (pkg.size && (size != pkg.size))
+                || (!pkg.sha256.empty() && (target.get_hex_digest() != pkg.sha256)))
+            {
+                LOG_DEBUG << "Discarding invalid prefetched package '" << pkg.fn << "'";
+                continue;
+            }
+            try
+            {
+                const auto entry_lock = lock_package_entry(
+                    m_cache_path,
+                    pkg.fn,
+                    LockMode::exclusive
+                );
+                fs::rename(path, m_cache_path / pkg.fn);
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Could not move prefetched package '" << pkg.fn << "': " << e.what();
+                continue;
+            }
+            if (!pkg.sha256.empty())
+            {
+                PackageCacheLedger(m_cache_path).record(pkg.fn, "", pkg.sha256);
+            }
+            // Queried as missing when the download started
+            m_caches->clear_query_cache(pkg);
+            ++kept;
+        }
+        LOG_INFO << "Prefetched " << kept << " of " << m_prefetched.size()
+                 << " packages installed by the solution";
+        // The temporary files of the discarded packages are removed
+        m_prefetched.clear();
+        return kept;
+    }
 }
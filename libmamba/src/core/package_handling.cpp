@@ -5,7 +5,19 @@
 // The full license is in the file LICENSE, distributed with this software.
 
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
 
 #include <archive.h>
 #include <archive_entry.h>
@@ -17,12 +29,15 @@
 #include "mamba/core/package_paths.hpp"
 #include "mamba/core/thread_utils.hpp"
 #include "mamba/core/util_os.hpp"
+#include "mamba/core/util_scope.hpp"
 #include "mamba/core/util_string.hpp"
 #include "mamba/core/validate.hpp"
 
 #include "nlohmann/json.hpp"
 
 #include "compression.hpp"
+#include "parallel.hpp"
+#include "progress_bar_impl.hpp"
 
 namespace mamba
 {
@@ -162,9 +177,85 @@ namespace mamba
         archive_entry* m_entry;
     };
 
-    void stream_extract_archive(scoped_archive_read& a, const fs::u8path& destination);
+    namespace
+    {
+        /**
+         * The files of a package left out of its extraction.
+         *
+         * It also collects the SHA-256 of the regular files written, when ``hash_files`` is set,
+         * so that they are checked against ``paths.json`` without reading them again.
+         */
+        struct extract_filter
+        {
+            const std::vector<std::string>& patterns;
+            std::vector<std::string> excluded = {};
+            bool hash_files = false;
+            /** The hashes of the files extracted, by path in the package. */
+            std::unordered_map<std::string, std::string> hashes = {};
+
+            bool skip(archive_entry* entry)
+            {
+                if (patterns.empty())
+                {
+                    return false;
+                }
+                // Directories are created for the files they contain anyway
+                const char* path = archive_entry_pathname_utf8(entry);
+                if ((path == nullptr) || (archive_entry_filetype(entry) == AE_IFDIR)
+                    || !is_excluded_path(patterns, path))
+                {
+                    return false;
+                }
+                excluded.emplace_back(path);
+                return true;
+            }
+        };
+
+        /** The SHA-256 of the data of an archive entry, read in blocks at given offsets. */
+        class entry_hasher
+        {
+        public:
+
+            void update(const void* data, std::size_t size, la_int64_t offset)
+            {
+                pad_to(offset);
+                m_hash.update(static_cast<const char*>(data), size);
+                m_size = offset + static_cast<la_int64_t>(size);
+            }
+
+            std::string hex_digest(la_int64_t entry_size)
+            {
+                pad_to(entry_size);
+                return m_hash.hex_digest();
+            }
+
+        private:
+
+            validation::HashStream m_hash = validation::HashStream::sha256();
+            la_int64_t m_size = 0;
+
+            /** Holes of sparse files are read as zeros. */
+            void pad_to(la_int64_t offset)
+            {
+                static constexpr std::array<char, 4096> zeros = {};
+                while (m_size < offset)
+                {
+                    const auto n = std::min(static_cast<la_int64_t>(zeros.size()), offset - m_size);
+                    m_hash.update(zeros.data(), static_cast<std::size_t>(n));
+                    m_size += n;
+                }
+            }
+        };
+    }
+
+    void stream_extract_archive(
+        scoped_archive_read& a,
+        const fs::u8path& destination,
+        extract_filter* filter = nullptr
+    );
 
-    static int copy_data(scoped_archive_read& ar, scoped_archive_write& aw)
+    static int
+    copy_data(scoped_archive_read& ar, scoped_archive_write& aw, entry_hasher* hash = nullptr)
     {
         int r = 0;
         const void* buff = nullptr;
@@ -182,6 +273,10 @@ namespace mamba
             {
                 throw std::runtime_error(archive_error_string(ar));
             }
+            if (hash != nullptr)
+            {
+                hash->update(buff, size, offset);
+            }
             r = static_cast<int>(archive_write_data_block(aw, buff, size, offset));
             if (r < ARCHIVE_OK)
             {
@@ -220,22 +315,14 @@ namespace mamba
         return init_order;
     }
 
-    // Bundle up all files in directory and create destination archive
-    void create_archive(
-        const fs::u8path& directory,
-        const fs::u8path& destination,
+    // Set the format and compression of an archive to write
+    void set_archive_compression(
+        scoped_archive_write& a,
         compression_algorithm ca,
         int compression_level,
-        int compression_threads,
-        bool (*filter)(const fs::u8path&)
+        int compression_threads
     )
     {
-        int r;
-
-        extraction_guard g(destination);
-
-        fs::u8path abs_out_path = fs::absolute(destination);
-        scoped_archive_write a;
         if (ca == compression_algorithm::bzip2)
         {
             archive_write_set_format_gnutar(a);
@@ -282,7 +369,7 @@ namespace mamba
                 LOG_ERROR << "libarchive error (" << res << ") " << archive_error_string(a);
             }
 
-            if (compression_threads > 2)
+            if (compression_threads > 1)
             {
                 std::string comp_threads_level = std::string("zstd:threads=")
                                                  + std::to_string(compression_threads);
@@ -293,6 +380,25 @@ namespace mamba
                 }
             }
         }
+    }
+
+    // Bundle up all files in directory and create destination archive
+    void create_archive(
+        const fs::u8path& directory,
+        const fs::u8path& destination,
+        compression_algorithm ca,
+        int compression_level,
+        int compression_threads,
+        bool (*filter)(const fs::u8path&)
+    )
+    {
+        int r;
+
+        extraction_guard g(destination);
+
+        fs::u8path abs_out_path = fs::absolute(destination);
+        scoped_archive_write a;
+        set_archive_compression(a, ca, compression_level, compression_threads);
 
         archive_write_open_filename(a, abs_out_path.string().c_str());
 
@@ -465,26 +571,38 @@ namespace mamba
         }
     }
 
-    void extract_archive(const fs::u8path& file, const fs::u8path& destination)
+    namespace
     {
-        LOG_INFO << "Extracting " << file << " to " << destination;
-        extraction_guard g(destination);
+        void extract_archive(
+            const fs::u8path& file,
+            const fs::u8path& destination,
+            extract_filter* filter
+        )
+        {
+            LOG_INFO << "Extracting " << file << " to " << destination;
+            extraction_guard g(destination);
 
-        scoped_archive_read a;
-        archive_read_support_format_tar(a);
-        archive_read_support_format_zip(a);
-        archive_read_support_filter_all(a);
+            scoped_archive_read a;
+            archive_read_support_format_tar(a);
+            archive_read_support_format_zip(a);
+            archive_read_support_filter_all(a);
 
-        auto lock = LockFile(file);
-        int r = archive_read_open_filename(a, file.string().c_str(), 10240);
+            auto lock = LockFile(file);
+            int r = archive_read_open_filename(a, file.string().c_str(), 10240);
 
-        if (r != ARCHIVE_OK)
-        {
-            LOG_ERROR << "Error opening archive: " << archive_error_string(a);
-            throw std::runtime_error(file.string() + " : Could not open archive for reading.");
+            if (r != ARCHIVE_OK)
+            {
+                LOG_ERROR << "Error opening archive: " << archive_error_string(a);
+                throw std::runtime_error(file.string() + " : Could not open archive for reading.");
+            }
+
+            stream_extract_archive(a, destination, filter);
         }
+    }
 
-        stream_extract_archive(a, destination);
+    void extract_archive(const fs::u8path& file, const fs::u8path& destination)
+    {
+        extract_archive(file, destination, nullptr);
     }
 
     namespace
@@ -500,23 +618,63 @@ namespace mamba
             archive* source;
             std::vector<char> buffer;
         };
+
+        /**
+         * Make the entry paths relative to the extraction root.
+         *
+         * Entries are written with absolute paths rather than relative to the current
+         * directory, which is shared by all threads. Absolute paths in the archive are
+         * therefore refused here instead of by libarchive.
+         */
+        void rebase_entry_paths(const fs::u8path& root, archive_entry* entry)
+        {
+            auto rebase = [&root](const char* path) -> std::string
+            {
+                if (path == nullptr)
+                {
+                    throw std::runtime_error("Invalid path encoding in archive");
+                }
+                const auto relative = fs::u8path(path);
+                if (relative.has_root_name() || relative.has_root_directory())
+                {
+                    throw std::runtime_error(concat("Absolute path in archive: ", path));
+                }
+                return (root / relative).string();
+            };
+
+            archive_entry_update_pathname_utf8(
+                entry,
+                rebase(archive_entry_pathname_utf8(entry)).c_str()
+            );
+            if (archive_entry_hardlink(entry) != nullptr)
+            {
+                archive_entry_update_hardlink_utf8(
+                    entry,
+                    rebase(archive_entry_hardlink_utf8(entry)).c_str()
+                );
+            }
+        }
     }
 
-    void stream_extract_archive(scoped_archive_read& a, const fs::u8path& destination)
+    void stream_extract_archive(
+        scoped_archive_read& a,
+        const fs::u8path& destination,
+        extract_filter* filter
+    )
     {
-        auto prev_path = fs::current_path();
         if (!fs::exists(destination))
         {
             fs::create_directories(destination);
         }
-        fs::current_path(destination);
+        // Without symlinks in the root, ARCHIVE_EXTRACT_SECURE_SYMLINKS only applies to the
+        // paths written by the archive itself
+        const auto root = fs::weakly_canonical(destination);
 
         /* Select which attributes we want to restore. */
         int flags = ARCHIVE_EXTRACT_TIME;
         flags |= ARCHIVE_EXTRACT_PERM;
         flags |= ARCHIVE_EXTRACT_SECURE_NODOTDOT;
         flags |= ARCHIVE_EXTRACT_SECURE_SYMLINKS;
-        flags |= ARCHIVE_EXTRACT_SECURE_NOABSOLUTEPATHS;
         flags |= ARCHIVE_EXTRACT_UNLINK;
 
         if (Context::instance().extract_sparse)
@@ -547,6 +705,26 @@ namespace mamba
                 throw std::runtime_error(archive_error_string(a));
             }
 
+            if ((filter != nullptr) && filter->skip(entry))
+            {
+                continue;
+            }
+            auto hash = std::optional<entry_hasher>();
+            auto hash_path = std::string();
+            if ((filter != nullptr) && filter->hash_files
+                && (archive_entry_filetype(entry) == AE_IFREG)
+                && (archive_entry_hardlink(entry) == nullptr)
+                && (archive_entry_pathname_utf8(entry) != nullptr))
+            {
+                hash.emplace();
+                hash_path = archive_entry_pathname_utf8(entry);
+                if (starts_with(hash_path, "./"))
+                {
+                    hash_path.erase(0, 2);
+                }
+            }
+            rebase_entry_paths(root, entry);
+
             r = archive_write_header(ext, entry);
             if (r < ARCHIVE_OK)
             {
@@ -554,7 +732,7 @@ namespace mamba
             }
             else if (archive_entry_size(entry) > 0)
             {
-                r = copy_data(a, ext);
+                r = copy_data(a, ext, hash ? &hash.value() : nullptr);
                 if (r < ARCHIVE_OK)
                 {
                     const char* err_str = archive_error_string(ext);
@@ -578,9 +756,11 @@ namespace mamba
             {
                 throw std::runtime_error(archive_error_string(ext));
             }
+            if (hash.has_value())
+            {
+                filter->hashes[std::move(hash_path)] = hash->hex_digest(archive_entry_size(entry));
+            }
         }
-
-        fs::current_path(prev_path);
     }
 
 
@@ -608,133 +788,566 @@ namespace mamba
     }
 
 
-    void
-    extract_conda(const fs::u8path& file, const fs::u8path& dest_dir, const std::vector<std::string>& parts)
+    namespace
     {
-        scoped_archive_read a;
-        archive_read_support_format_zip(a);
-
-        conda_extract_context extract_context(a);
-
-        if (archive_read_open_filename(a, file.string().c_str(), extract_context.buffer.size())
-            != ARCHIVE_OK)
+        /**
+         * Decompress a zstd archive entry on a separate thread.
+         *
+         * This overlaps the decompression with the writing of the decompressed entries.
+         * Frames of multithreaded zstd compression cannot be decoded independently, so the
+         * decompression itself remains sequential.
+         */
+        class threaded_zstd_reader : non_copyable_base
         {
-            throw std::runtime_error(archive_error_string(a));
-        }
+        public:
 
-        auto check_parts = [&parts](const std::string& name)
-        {
-            std::size_t pos = name.find_first_of('-');
-            if (pos == std::string::npos)
+            explicit threaded_zstd_reader(archive* source)
+                : m_source(source)
+                , m_thread(&threaded_zstd_reader::decode, this)
             {
-                return false;
             }
-            std::string part = name.substr(0, pos);
-            if (std::find(parts.begin(), parts.end(), part) != parts.end())
+
+            ~threaded_zstd_reader()
             {
-                return true;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_aborted = true;
+                }
+                m_cv.notify_all();
+                m_thread.join();
             }
-            return false;
-        };
 
-        int r;
-        archive_entry* entry;
-        for (;;)
-        {
-            if (is_sig_interrupted())
+            int open(scoped_archive_read& a)
             {
-                throw std::runtime_error("SIGINT received. Aborting extraction.");
+                archive_clear_error(a);
+                archive_read_set_read_callback(
+                    a,
+                    [](archive* self, void* client_data, const void** buff) -> la_ssize_t
+                    {
+                        auto* reader = static_cast<threaded_zstd_reader*>(client_data);
+                        if (!reader->next_chunk())
+                        {
+                            archive_set_error(self, EIO, "%s", reader->m_error.c_str());
+                            return ARCHIVE_FATAL;
+                        }
+                        *buff = reader->m_reading.first.data();
+                        return static_cast<la_ssize_t>(reader->m_reading.second);
+                    }
+                );
+                archive_read_set_callback_data(a, this);
+                return archive_read_open1(a);
             }
 
-            r = archive_read_next_header(a, &entry);
-            if (r == ARCHIVE_EOF)
+        private:
+
+            static constexpr std::size_t max_chunks = 4;
+            static constexpr std::size_t chunk_size = 1 << 20;
+
+            void decode()
             {
-                break;
+                ZSTD_DCtx* stream = ZSTD_createDCtx();
+                on_scope_exit _{ [stream] { ZSTD_freeDCtx(stream); } };
+
+                std::vector<char> in(ZSTD_DStreamInSize());
+                std::vector<char> out = next_buffer();
+                ZSTD_outBuffer output = { out.data(), out.size(), 0 };
+                std::string error;
+                std::size_t ret = 0;
+                for (;;)
+                {
+                    la_ssize_t read = archive_read_data(m_source, in.data(), in.size());
+                    if (read < 0)
+                    {
+                        error = archive_error_string(m_source);
+                        break;
+                    }
+                    if (read == 0)
+                    {
+                        if (ret != 0)
+                        {
+                            error = "Truncated zstd data";
+                        }
+                        break;
+                    }
+
+                    ZSTD_inBuffer input = { in.data(), static_cast<std::size_t>(read), 0 };
+                    while ((input.pos < input.size) || (output.pos == output.size))
+                    {
+                        ret = ZSTD_decompressStream(stream, &output, &input);
+                        if (ZSTD_isError(ret))
+                        {
+                            error = concat("zstd decompression error: ", ZSTD_getErrorName(ret));
+                            break;
+                        }
+                        if (output.pos == output.size)
+                        {
+                            if (!push(std::move(out), output.pos))
+                            {
+                                return;
+                            }
+                            out = next_buffer();
+                            output = { out.data(), out.size(), 0 };
+                        }
+                        else if (input.pos == input.size)
+                        {
+                            break;
+                        }
+                    }
+                    if (!error.empty())
+                    {
+                        break;
+                    }
+                }
+                if (error.empty() && (output.pos > 0) && !push(std::move(out), output.pos))
+                {
+                    return;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_error = std::move(error);
+                    m_finished = true;
+                }
+                m_cv.notify_all();
             }
-            if (r < ARCHIVE_OK)
+
+            std::vector<char> next_buffer()
             {
-                throw std::runtime_error(archive_error_string(a));
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_free.empty())
+                {
+                    return std::vector<char>(chunk_size);
+                }
+                auto buffer = std::move(m_free.back());
+                m_free.pop_back();
+                return buffer;
             }
 
-            fs::u8path p(archive_entry_pathname(entry));
-            if (p.extension() == ".zst" && check_parts(p.filename().string()))
+            bool push(std::vector<char>&& chunk, std::size_t size)
             {
-                // extract zstd file
-                scoped_archive_read inner;
-                archive_read_support_filter_zstd(inner);
-                archive_read_support_format_tar(inner);
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this] { return m_aborted || (m_chunks.size() < max_chunks); });
+                if (m_aborted)
+                {
+                    return false;
+                }
+                m_chunks.emplace_back(std::move(chunk), size);
+                lock.unlock();
+                m_cv.notify_all();
+                return true;
+            }
 
-                archive_read_open_archive_entry(inner, &extract_context);
-                stream_extract_archive(inner, dest_dir);
+            bool next_chunk()
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (!m_reading.first.empty())
+                {
+                    m_free.push_back(std::move(m_reading.first));
+                    m_reading.first.clear();
+                }
+                m_cv.wait(lock, [this] { return m_aborted || m_finished || !m_chunks.empty(); });
+                m_reading.second = 0;
+                if (!m_chunks.empty())
+                {
+                    m_reading = std::move(m_chunks.front());
+                    m_chunks.pop_front();
+                    lock.unlock();
+                    m_cv.notify_all();
+                    return true;
+                }
+                return !m_aborted && m_error.empty();
             }
-            else if (p.filename() == "metadata.json")
+
+            archive* m_source;
+            std::mutex m_mutex;
+            std::condition_variable m_cv;
+            // Decompressed buffers with the size of their data
+            std::deque<std::pair<std::vector<char>, std::size_t>> m_chunks;
+            std::pair<std::vector<char>, std::size_t> m_reading;
+            std::vector<std::vector<char>> m_free;
+            std::string m_error;
+            bool m_finished = false;
+            bool m_aborted = false;
+            std::thread m_thread;
+        };
+
+        bool use_threaded_zstd_reader(archive_entry* entry)
+        {
+            // Below this compressed size, starting a thread does not pay off
+            constexpr la_int64_t min_size = 1 << 20;
+            const bool is_small = archive_entry_size_is_set(entry)
+                                  && (archive_entry_size(entry) < min_size);
+            return !is_small && (std::thread::hardware_concurrency() > 1);
+        }
+
+        void extract_conda(
+            const fs::u8path& file,
+            const fs::u8path& dest_dir,
+            const std::vector<std::string>& parts,
+            extract_filter* filter
+        );
+
+        void extract_conda_entries(
+            scoped_archive_read& a,
+            const fs::u8path& file,
+            const fs::u8path& dest_dir,
+            const std::vector<std::string>& parts,
+            extract_filter* filter = nullptr
+        )
+        {
+            conda_extract_context extract_context(a);
+
+            auto check_parts = [&parts](const std::string& name)
             {
-                std::size_t json_size = static_cast<std::size_t>(archive_entry_size(entry));
-                if (json_size == 0)
+                std::size_t pos = name.find_first_of('-');
+                if (pos == std::string::npos)
                 {
-                    LOG_INFO << "Package contains empty metadata.json file (" << file << ")";
-                    continue;
+                    return false;
                 }
-                std::string json(json_size, '\0');
-                archive_read_data(a, json.data(), json_size);
-                try
+                std::string part = name.substr(0, pos);
+                if (std::find(parts.begin(), parts.end(), part) != parts.end())
+                {
+                    return true;
+                }
+                return false;
+            };
+
+            int r;
+            archive_entry* entry;
+            for (;;)
+            {
+                if (is_sig_interrupted())
+                {
+                    throw std::runtime_error("SIGINT received. Aborting extraction.");
+                }
+
+                r = archive_read_next_header(a, &entry);
+                if (r == ARCHIVE_EOF)
                 {
-                    auto obj = nlohmann::json::parse(json);
-                    if (obj["conda_pkg_format_version"] != 2)
+                    break;
+                }
+                if (r < ARCHIVE_OK)
+                {
+                    throw std::runtime_error(archive_error_string(a));
+                }
+
+                fs::u8path p(archive_entry_pathname(entry));
+                if (p.extension() == ".zst" && check_parts(p.filename().string()))
+                {
+                    // extract zstd file
+                    if (use_threaded_zstd_reader(entry))
+                    {
+                        threaded_zstd_reader reader(a);
+                        scoped_archive_read inner;
+                        archive_read_support_format_tar(inner);
+
+                        if (reader.open(inner) != ARCHIVE_OK)
+                        {
+                            throw std::runtime_error(archive_error_string(inner));
+                        }
+                        stream_extract_archive(inner, dest_dir, filter);
+                    }
+                    else
                     {
-                        LOG_WARNING << "Unsupported conda package format version (" << file
-                                    << ") - still trying to extract";
+                        scoped_archive_read inner;
+                        archive_read_support_filter_zstd(inner);
+                        archive_read_support_format_tar(inner);
+
+                        archive_read_open_archive_entry(inner, &extract_context);
+                        stream_extract_archive(inner, dest_dir, filter);
                     }
                 }
-                catch (const std::exception& e)
+                else if (p.filename() == "metadata.json")
                 {
-                    LOG_WARNING << "Error parsing metadata.json (" << file << "): " << e.what();
+                    // The size is not known when streaming entries with a data descriptor
+                    std::string json;
+                    std::array<char, 4096> buf;
+                    la_ssize_t read;
+                    while ((read = archive_read_data(a, buf.data(), buf.size())) > 0)
+                    {
+                        json.append(buf.data(), static_cast<std::size_t>(read));
+                    }
+                    if (json.empty())
+                    {
+                        LOG_INFO << "Package contains empty metadata.json file (" << file << ")";
+                        continue;
+                    }
+                    try
+                    {
+                        auto obj = nlohmann::json::parse(json);
+                        if (obj["conda_pkg_format_version"] != 2)
+                        {
+                            LOG_WARNING << "Unsupported conda package format version (" << file
+                                        << ") - still trying to extract";
+                        }
+                    }
+                    catch (const std::exception& e)
+                    {
+                        LOG_WARNING << "Error parsing metadata.json (" << file << "): " << e.what();
+                    }
                 }
             }
         }
-    }
 
-    static fs::u8path extract_dest_dir(const fs::u8path& file)
-    {
-        if (ends_with(file.string(), ".tar.bz2"))
-        {
-            return file.string().substr(0, file.string().size() - 8);
-        }
-        else if (ends_with(file.string(), ".conda"))
+        void extract_conda(
+            const fs::u8path& file,
+            const fs::u8path& dest_dir,
+            const std::vector<std::string>& parts,
+            extract_filter* filter
+        )
         {
-            return file.string().substr(0, file.string().size() - 6);
+            scoped_archive_read a;
+            archive_read_support_format_zip(a);
+
+            if (archive_read_open_filename(a, file.string().c_str(), get_zstd_buff_out_size())
+                != ARCHIVE_OK)
+            {
+                throw std::runtime_error(archive_error_string(a));
+            }
+            extract_conda_entries(a, file, dest_dir, parts, filter);
         }
-        LOG_ERROR << "Unknown package format '" << file.string() << "'";
-        throw std::runtime_error("Unknown package format.");
     }
 
-    void extract(const fs::u8path& file, const fs::u8path& dest)
+    void
+    extract_conda(const fs::u8path& file, const fs::u8path& dest_dir, const std::vector<std::string>& parts)
     {
-        static std::mutex extract_mutex;
-        std::lock_guard<std::mutex> lock(extract_mutex);
+        extract_conda(file, dest_dir, parts, nullptr);
+    }
 
-        if (ends_with(file.string(), ".tar.bz2"))
-        {
-            extract_archive(file, dest);
-        }
-        else if (ends_with(file.string(), ".conda"))
+    namespace
+    {
+        auto make_extract_filter(const std::vector<std::string>& exclude) -> extract_filter
         {
-            extract_conda(file, dest);
+            const auto& ctx = Context::instance();
+            auto filter = extract_filter{ exclude };
+            filter.hash_files = ctx.extra_safety_checks
+                                && (ctx.safety_checks != VerificationLevel::kDisabled);
+            return filter;
         }
-        else
+
+        /**
+         * Check the files hashed while extracting against the ``paths.json`` of the package.
+         *
+         * Files that were not hashed, such as hard links in the archive, are checked later by
+         * ``validate`` when the extracted directory is used from the cache.
+         */
+        void check_extracted_hashes(const fs::u8path& dest, const extract_filter& filter)
         {
-            LOG_ERROR << "Unknown package format '" << file.string() << "'";
-            throw std::runtime_error("Unknown package format.");
+            if (!filter.hash_files || !fs::exists(dest / "info" / "paths.json"))
+            {
+                return;
+            }
+            for (const auto& p : read_paths(dest))
+            {
+                const auto it = filter.hashes.find(p.path);
+                if ((it == filter.hashes.end()) || p.sha256.empty() || (it->second == p.sha256))
+                {
+                    continue;
+                }
+                if (Context::instance().safety_checks == VerificationLevel::kEnabled)
+                {
+                    throw std::runtime_error(
+                        concat("File '", p.path, "' of '", dest.string(), "' has incorrect SHA-256")
+                    );
+                }
+                LOG_WARNING << "Extracted file '" << p.path << "' of '" << dest.string()
+                            << "' has incorrect SHA-256 checksum";
+            }
+            LOG_DEBUG << "Checked " << filter.hashes.size() << " files hashed while extracting '"
+                      << dest.string() << "'";
         }
     }
 
-    fs::u8path extract(const fs::u8path& file)
+    CondaStreamExtractor::CondaStreamExtractor(std::size_t max_buffered)
+        : m_max_buffered(max_buffered)
     {
-        fs::u8path dest_dir = extract_dest_dir(file);
-        extract(file, dest_dir);
+    }
+
+    bool CondaStreamExtractor::write(const char* data, std::size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_aborted || m_done)
+            {
+                return false;
+            }
+            if (m_buffered + size > m_max_buffered)
+            {
+                LOG_DEBUG << "Streaming extraction is lagging behind, aborting it";
+                m_aborted = true;
+            }
+            else
+            {
+                m_chunks.emplace_back(data, size);
+                m_buffered += size;
+            }
+        }
+        m_cv.notify_one();
+        return true;
+    }
+
+    void CondaStreamExtractor::close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_cv.notify_one();
+    }
+
+    void CondaStreamExtractor::abort()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_aborted = true;
+        }
+        m_cv.notify_one();
+    }
+
+    bool CondaStreamExtractor::next_chunk()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_aborted && m_chunks.empty() && !m_closed)
+        {
+            if (is_sig_interrupted())
+            {
+                m_aborted = true;
+                break;
+            }
+            m_cv.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        if (m_aborted)
+        {
+            return false;
+        }
+        m_reading.clear();
+        if (!m_chunks.empty())
+        {
+            m_reading = std::move(m_chunks.front());
+            m_chunks.pop_front();
+            m_buffered -= m_reading.size();
+        }
+        return true;
+    }
+
+    void CondaStreamExtractor::extract(
+        const fs::u8path& dest_dir,
+        const std::vector<std::string>& exclude
+    )
+    {
+        on_scope_exit _{ [this]
+                         {
+                             std::lock_guard<std::mutex> lock(m_mutex);
+                             m_done = true;
+                             m_chunks.clear();
+                         } };
+
+        scoped_archive_read a;
+        // Entries are read from their local headers, without the central directory at the end
+        archive_read_support_format_zip_streamable(a);
+        archive_read_set_read_callback(
+            a,
+            [](archive* self, void* client_data, const void** buff) -> la_ssize_t
+            {
+                auto* extractor = static_cast<CondaStreamExtractor*>(client_data);
+                if (!extractor->next_chunk())
+                {
+                    archive_set_error(self, ECANCELED, "Streaming extraction aborted");
+                    return ARCHIVE_FATAL;
+                }
+                *buff = extractor->m_reading.data();
+                return static_cast<la_ssize_t>(extractor->m_reading.size());
+            }
+        );
+        archive_read_set_callback_data(a, this);
+        if (archive_read_open1(a) != ARCHIVE_OK)
+        {
+            throw std::runtime_error(archive_error_string(a));
+        }
+        auto filter = make_extract_filter(exclude);
+        extract_conda_entries(a, dest_dir, dest_dir, { "info", "pkg" }, &filter);
+        check_extracted_hashes(dest_dir, filter);
+        if (!filter.excluded.empty())
+        {
+            write_excluded_paths(dest_dir, filter.excluded);
+        }
+    }
+
+    static fs::u8path extract_dest_dir(const fs::u8path& file)
+    {
+        if (ends_with(file.string(), ".tar.bz2"))
+        {
+            return file.string().substr(0, file.string().size() - 8);
+        }
+        else if (ends_with(file.string(), ".conda"))
+        {
+            return file.string().substr(0, file.string().size() - 6);
+        }
+        LOG_ERROR << "Unknown package format '" << file.string() << "'";
+        throw std::runtime_error("Unknown package format.");
+    }
+
+    void extract(const fs::u8path& file, const fs::u8path& dest)
+    {
+        extract(file, dest, {});
+    }
+
+    void
+    extract(const fs::u8path& file, const fs::u8path& dest, const std::vector<std::string>& exclude)
+    {
+        auto filter = make_extract_filter(exclude);
+        if (ends_with(file.string(), ".tar.bz2"))
+        {
+            extract_archive(file, dest, &filter);
+        }
+        else if (ends_with(file.string(), ".conda"))
+        {
+            extract_conda(file, dest, { "info", "pkg" }, &filter);
+        }
+        else
+        {
+            LOG_ERROR << "Unknown package format '" << file.string() << "'";
+            throw std::runtime_error("Unknown package format.");
+        }
+        check_extracted_hashes(dest, filter);
+        if (!filter.excluded.empty())
+        {
+            write_excluded_paths(dest, filter.excluded);
+        }
+    }
+
+    fs::u8path extract(const fs::u8path& file)
+    {
+        fs::u8path dest_dir = extract_dest_dir(file);
+        extract(file, dest_dir);
         return dest_dir;
     }
 
+    std::vector<fs::u8path> extract_all(
+        const std::vector<fs::u8path>& files,
+        std::size_t n_threads,
+        const std::function<void(std::size_t)>& on_extract
+    )
+    {
+        auto dest_dirs = std::vector<fs::u8path>(files.size());
+        std::mutex on_extract_mutex;
+        parallel_for(
+            files.size(),
+            std::clamp<std::size_t>(n_threads, 1, std::max<std::size_t>(files.size(), 1)),
+            [&](std::size_t i)
+            {
+                if (on_extract)
+                {
+                    std::lock_guard<std::mutex> lock(on_extract_mutex);
+                    on_extract(i);
+                }
+                dest_dirs[i] = extract(files[i]);
+            },
+            TaskPriority::high
+        );
+        return dest_dirs;
+    }
+
     void extract_subproc(const fs::u8path& file, const fs::u8path& dest)
     {
         std::vector<std::string> args;
@@ -765,9 +1378,347 @@ namespace mamba
         }
     }
 
+    namespace
+    {
+        void check_archive_result(archive* a, int r)
+        {
+            if (r == ARCHIVE_WARN)
+            {
+                LOG_WARNING << "libarchive warning: " << archive_error_string(a);
+            }
+            else if (r < ARCHIVE_OK)
+            {
+                throw std::runtime_error(concat("libarchive error: ", archive_error_string(a)));
+            }
+        }
+
+        void clean_archive_entry(archive_entry* entry)
+        {
+            // clean out UID and GID
+            archive_entry_set_uid(entry, 0);
+            archive_entry_set_gid(entry, 0);
+            archive_entry_set_gname(entry, "");
+            archive_entry_set_uname(entry, "");
+        }
+
+        void write_archive_data(archive* dest, const char* data, std::size_t size)
+        {
+            if ((size > 0) && (archive_write_data(dest, data, size) < 0))
+            {
+                check_archive_result(dest, ARCHIVE_FATAL);
+            }
+        }
+
+        /**
+         * Read the header of the next entry of ``source``.
+         *
+         * Return nullptr when there are no more entries.
+         */
+        archive_entry* next_archive_entry(archive* source)
+        {
+            if (is_sig_interrupted())
+            {
+                throw std::runtime_error("SIGINT received. Aborting transmutation.");
+            }
+            archive_entry* entry = nullptr;
+            const int r = archive_read_next_header(source, &entry);
+            if (r == ARCHIVE_EOF)
+            {
+                return nullptr;
+            }
+            check_archive_result(source, r);
+            return entry;
+        }
+
+        /**
+         * Copy the entries of ``source`` to ``dest`` in their order.
+         *
+         * The data are streamed from one archive to the other, nothing is written to disk.
+         */
+        void copy_archive_entries(archive* source, archive* dest)
+        {
+            std::vector<char> buffer(1 << 16);
+            while (archive_entry* entry = next_archive_entry(source))
+            {
+                clean_archive_entry(entry);
+                check_archive_result(dest, archive_write_header(dest, entry));
+
+                la_ssize_t read = 0;
+                while ((read = archive_read_data(source, buffer.data(), buffer.size())) > 0)
+                {
+                    write_archive_data(dest, buffer.data(), static_cast<std::size_t>(read));
+                }
+                check_archive_result(source, static_cast<int>(read));
+                check_archive_result(dest, archive_write_finish_entry(dest));
+            }
+        }
+
+        struct archive_entry_deleter
+        {
+            void operator()(archive_entry* entry) const
+            {
+                archive_entry_free(entry);
+            }
+        };
+
+        struct buffered_archive_entry
+        {
+            int order;
+            fs::u8path path;
+            std::unique_ptr<archive_entry, archive_entry_deleter> entry;
+            std::string data;
+        };
+
+        /**
+         * Read all the entries of ``source`` in memory, in the order of ``create_archive``.
+         *
+         * Return false if they need more than ``max_size`` bytes.
+         */
+        bool read_sorted_archive_entries(
+            archive* source,
+            std::size_t max_size,
+            std::vector<buffered_archive_entry>& entries
+        )
+        {
+            std::size_t total_size = 0;
+            std::vector<char> buffer(1 << 16);
+            while (archive_entry* entry = next_archive_entry(source))
+            {
+                const auto path = fs::u8path(
+                    fs::u8path(archive_entry_pathname(entry)).std_path().lexically_normal()
+                );
+                auto& buffered = entries.emplace_back(buffered_archive_entry{
+                    order(path),
+                    path,
+                    decltype(buffered_archive_entry::entry)(archive_entry_clone(entry)),
+                    {},
+                });
+                if (archive_entry_size_is_set(entry))
+                {
+                    buffered.data.reserve(
+                        std::min(static_cast<std::size_t>(archive_entry_size(entry)), max_size)
+                    );
+                }
+
+                la_ssize_t read = 0;
+                while ((read = archive_read_data(source, buffer.data(), buffer.size())) > 0)
+                {
+                    total_size += static_cast<std::size_t>(read);
+                    if (total_size > max_size)
+                    {
+                        return false;
+                    }
+                    buffered.data.append(buffer.data(), static_cast<std::size_t>(read));
+                }
+                check_archive_result(source, static_cast<int>(read));
+            }
+
+            std::sort(
+                entries.begin(),
+                entries.end(),
+                [](const auto& lhs, const auto& rhs)
+                { return std::tie(lhs.order, lhs.path) < std::tie(rhs.order, rhs.path); }
+            );
+            return true;
+        }
+
+        void open_archive_write(
+            scoped_archive_write& a,
+            const fs::u8path& file,
+            compression_algorithm ca,
+            int compression_level,
+            int compression_threads
+        )
+        {
+            set_archive_compression(a, ca, compression_level, compression_threads);
+            check_archive_result(a, archive_write_open_filename(a, file.string().c_str()));
+        }
+
+        void open_archive_read(scoped_archive_read& a, const fs::u8path& file)
+        {
+            check_archive_result(
+                a,
+                archive_read_open_filename(a, file.string().c_str(), get_zstd_buff_out_size())
+            );
+        }
+
+        // Unlike ``create_archive``, this does not change the current directory
+        void write_conda_zip(const fs::u8path& out_file, const fs::u8path& directory)
+        {
+            scoped_archive_write a;
+            open_archive_write(a, out_file, zip, 0, 1);
+
+            auto files = std::vector<std::pair<int, fs::u8path>>();
+            for (const auto& dir_entry : fs::directory_iterator(directory))
+            {
+                files.push_back({ zip_order(dir_entry.path().filename()), dir_entry.path() });
+            }
+            std::sort(files.begin(), files.end());
+
+            std::array<char, 1 << 16> buffer;
+            for (const auto& [_, path] : files)
+            {
+                scoped_archive_entry entry;
+                archive_entry_set_pathname(entry, path.filename().string().c_str());
+                archive_entry_set_filetype(entry, AE_IFREG);
+                archive_entry_set_perm(entry, 0644);
+                archive_entry_set_size(entry, static_cast<la_int64_t>(fs::file_size(path)));
+                check_archive_result(a, archive_write_header(a, entry));
+
+                std::ifstream fin(path.std_path(), std::ios::in | std::ios::binary);
+                while (fin)
+                {
+                    fin.read(buffer.data(), buffer.size());
+                    const auto len = static_cast<std::size_t>(fin.gcount());
+                    if ((len > 0) && (archive_write_data(a, buffer.data(), len) < 0))
+                    {
+                        check_archive_result(a, ARCHIVE_FATAL);
+                    }
+                }
+                check_archive_result(a, archive_write_finish_entry(a));
+            }
+            check_archive_result(a, archive_write_close(a));
+        }
+
+        // Above this size, packages are extracted to disk to sort their entries
+        constexpr std::size_t max_streamed_package_size = std::size_t(256) << 20;
+
+        /**
+         * Convert a ``.tar.bz2`` package without extracting it to disk.
+         *
+         * Its entries are sorted in memory as in ``create_archive``, so this returns false
+         * without writing anything if the package is too large.
+         */
+        bool transmute_to_conda(
+            const fs::u8path& pkg_file,
+            const fs::u8path& target,
+            int compression_level,
+            int compression_threads
+        )
+        {
+            std::vector<buffered_archive_entry> entries;
+            {
+                scoped_archive_read source;
+                archive_read_support_filter_bzip2(source);
+                archive_read_support_format_tar(source);
+                open_archive_read(source, pkg_file);
+                if (!read_sorted_archive_entries(source, max_streamed_package_size, entries))
+                {
+                    return false;
+                }
+            }
+
+            TemporaryDirectory tdir;
+            const std::string stem = target.stem().string();
+            for (const std::string part : { "info", "pkg" })
+            {
+                scoped_archive_write out;
+                open_archive_write(
+                    out,
+                    tdir.path() / concat(part, "-", stem, ".tar.zst"),
+                    zstd,
+                    compression_level,
+                    compression_threads
+                );
+                const int part_order = (part == "info") ? 0 : 1;
+                for (auto& buffered : entries)
+                {
+                    if (buffered.order == part_order)
+                    {
+                        clean_archive_entry(buffered.entry.get());
+                        check_archive_result(out, archive_write_header(out, buffered.entry.get()));
+                        write_archive_data(out, buffered.data.data(), buffered.data.size());
+                        check_archive_result(out, archive_write_finish_entry(out));
+                        // Release the memory as soon as possible
+                        buffered.data = std::string();
+                    }
+                }
+                check_archive_result(out, archive_write_close(out));
+            }
+
+            nlohmann::json pkg_metadata;
+            pkg_metadata["conda_pkg_format_version"] = 2;
+            open_ofstream(tdir.path() / "metadata.json") << pkg_metadata;
+
+            write_conda_zip(target, tdir.path());
+            return true;
+        }
+
+        void transmute_to_tar_bz2(
+            const fs::u8path& pkg_file,
+            const fs::u8path& target,
+            int compression_level
+        )
+        {
+            scoped_archive_write out;
+            open_archive_write(out, target, bzip2, compression_level, 1);
+
+            // The info entries go first as in ``create_archive``, although they are last in the
+            // zip, so the package is read once per part.
+            for (const std::string part : { "info-", "pkg-" })
+            {
+                scoped_archive_read outer;
+                archive_read_support_format_zip(outer);
+                open_archive_read(outer, pkg_file);
+                conda_extract_context extract_context(outer);
+
+                archive_entry* entry = nullptr;
+                int r = ARCHIVE_OK;
+                while ((r = archive_read_next_header(outer, &entry)) != ARCHIVE_EOF)
+                {
+                    check_archive_result(outer, r);
+                    const auto name = fs::u8path(archive_entry_pathname(entry)).filename();
+                    if (starts_with(name.string(), part) && (name.extension() == ".zst"))
+                    {
+                        scoped_archive_read inner;
+                        archive_read_support_filter_zstd(inner);
+                        archive_read_support_format_tar(inner);
+                        check_archive_result(
+                            inner,
+                            archive_read_open_archive_entry(inner, &extract_context)
+                        );
+                        copy_archive_entries(inner, out);
+                    }
+                }
+            }
+            check_archive_result(out, archive_write_close(out));
+        }
+    }
+
     bool
     transmute(const fs::u8path& pkg_file, const fs::u8path& target, int compression_level, int compression_threads)
     {
+        const bool to_conda = ends_with(target.string(), ".conda");
+        if (compression_level == -1)
+        {
+            compression_level = to_conda ? 15 : 9;
+        }
+        if (compression_threads <= 0)
+        {
+            compression_threads = static_cast<int>(
+                std::max(std::thread::hardware_concurrency(), 1u)
+            );
+        }
+
+        if (ends_with(pkg_file.string(), ".tar.bz2") && to_conda)
+        {
+            extraction_guard g(target);
+            if (transmute_to_conda(pkg_file, target, compression_level, compression_threads))
+            {
+                return true;
+            }
+            LOG_INFO << "Extracting large package " << pkg_file.string() << " to transmute it";
+        }
+        if (ends_with(pkg_file.string(), ".conda") && ends_with(target.string(), ".tar.bz2"))
+        {
+            extraction_guard g(target);
+            transmute_to_tar_bz2(pkg_file, target, compression_level);
+            return true;
+        }
+
+        // ``create_archive`` changes the current directory, which is shared by all threads
+        static std::mutex fallback_mutex;
+        std::lock_guard<std::mutex> lock(fallback_mutex);
         TemporaryDirectory extract_dir;
 
         if (ends_with(pkg_file.string(), ".tar.bz2"))
@@ -787,6 +1738,176 @@ namespace mamba
         return true;
     }
 
+    std::vector<std::string> transmute_packages(
+        const std::vector<std::pair<fs::u8path, fs::u8path>>& packages,
+        int compression_level,
+        int compression_threads,
+        std::size_t n_jobs
+    )
+    {
+        const std::size_t hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        if (n_jobs == 0)
+        {
+            n_jobs = hardware_threads;
+        }
+        n_jobs = std::clamp<std::size_t>(n_jobs, 1, std::max<std::size_t>(packages.size(), 1));
+        if (compression_threads <= 0)
+        {
+            // Share the cores between the packages transmuted at once
+            compression_threads = static_cast<int>(
+                std::max<std::size_t>(hardware_threads / n_jobs, 1)
+            );
+        }
+
+        auto errors = std::vector<std::string>(packages.size());
+        parallel_for(
+            packages.size(),
+            n_jobs,
+            [&](std::size_t i)
+            {
+                const auto& [pkg_file, target] = packages[i];
+                try
+                {
+                    transmute(pkg_file, target, compression_level, compression_threads);
+                }
+                catch (const std::exception& e)
+                {
+                    errors[i] = concat(pkg_file.string(), ": ", e.what());
+                }
+            }
+        );
+        errors.erase(
+            std::remove_if(errors.begin(), errors.end(), [](const auto& e) { return e.empty(); }),
+            errors.end()
+        );
+        return errors;
+    }
+
+    namespace
+    {
+        /** Return the content of the ``info/index.json`` entry of a tar archive, if any. */
+        std::optional<std::string> read_tar_index_json(archive* source)
+        {
+            while (archive_entry* entry = next_archive_entry(source))
+            {
+                const auto path = fs::u8path(archive_entry_pathname(entry)).std_path();
+                if (path.lexically_normal() == std::filesystem::path("info/index.json"))
+                {
+                    std::string json;
+                    std::array<char, 4096> buf;
+                    la_ssize_t read = 0;
+                    while ((read = archive_read_data(source, buf.data(), buf.size())) > 0)
+                    {
+                        json.append(buf.data(), static_cast<std::size_t>(read));
+                    }
+                    check_archive_result(source, static_cast<int>(read));
+                    return json;
+                }
+            }
+            return std::nullopt;
+        }
+    }
+
+    std::string read_package_index_json(const fs::u8path& pkg_file)
+    {
+        std::optional<std::string> json;
+        if (ends_with(pkg_file.string(), ".tar.bz2"))
+        {
+            scoped_archive_read source;
+            archive_read_support_filter_bzip2(source);
+            archive_read_support_format_tar(source);
+            open_archive_read(source, pkg_file);
+            json = read_tar_index_json(source);
+        }
+        else if (ends_with(pkg_file.string(), ".conda"))
+        {
+            scoped_archive_read outer;
+            archive_read_support_format_zip(outer);
+            open_archive_read(outer, pkg_file);
+            conda_extract_context extract_context(outer);
+            while (archive_entry* entry = next_archive_entry(outer))
+            {
+                const auto name = fs::u8path(archive_entry_pathname(entry)).filename();
+                if (starts_with(name.string(), "info-") && (name.extension() == ".zst"))
+                {
+                    scoped_archive_read inner;
+                    archive_read_support_filter_zstd(inner);
+                    archive_read_support_format_tar(inner);
+                    check_archive_result(
+                        inner,
+                        archive_read_open_archive_entry(inner, &extract_context)
+                    );
+                    json = read_tar_index_json(inner);
+                    break;
+                }
+            }
+        }
+        else
+        {
+            throw std::runtime_error("Unknown package format (" + pkg_file.string() + ")");
+        }
+
+        if (!json.has_value())
+        {
+            throw std::runtime_error("Package has no info/index.json (" + pkg_file.string() + ")");
+        }
+        return std::move(json).value();
+    }
+
+    namespace
+    {
+        enum class FileValidation
+        {
+            valid,
+            missing,
+            incorrect_size,
+            incorrect_checksum,
+        };
+
+        auto validate_file(const fs::u8path& full_path, const PathData& p, bool full_validation)
+            -> FileValidation
+        {
+            // "exists" follows symlink so if the symlink doesn't link to existing target it
+            // will return false. There is such symlink in _openmp_mutex package. So if the file
+            // is a symlink we don't want to follow the symlink. The "paths_data" should include
+            // path of all the files and we should not need to follow symlink.
+            std::error_code ec;
+            auto exists = lexists(full_path, ec);
+            if (ec)
+            {
+                LOG_WARNING << "Could not check existence: " << ec.message() << " (" << p.path
+                            << ")";
+            }
+            if (!exists)
+            {
+                return FileValidation::missing;
+            }
+
+            // old packages don't have paths.json with validation information
+            if ((p.size_in_bytes == 0) || (p.path_type == PathType::SOFTLINK))
+            {
+                return FileValidation::valid;
+            }
+            if (!validation::file_size(full_path, p.size_in_bytes))
+            {
+                return FileValidation::incorrect_size;
+            }
+            if (full_validation && !validation::sha256(full_path, p.sha256))
+            {
+                return FileValidation::incorrect_checksum;
+            }
+            return FileValidation::valid;
+        }
+
+        std::size_t validate_threads(std::size_t n_files)
+        {
+            return std::min(
+                clamp_worker_threads(Context::instance().threads_params.extract_threads),
+                std::max<std::size_t>(n_files, 1)
+            );
+        }
+    }
+
     bool validate(const fs::u8path& pkg_folder)
     {
         auto safety_checks = Context::instance().safety_checks;
@@ -795,63 +1916,81 @@ namespace mamba
             return true;
         }
 
-        bool is_warn = safety_checks == VerificationLevel::kWarn;
         bool is_fail = safety_checks == VerificationLevel::kEnabled;
         bool full_validation = Context::instance().extra_safety_checks;
 
         try
         {
+            const auto start = std::chrono::steady_clock::now();
             auto paths_data = read_paths(pkg_folder);
-            for (auto& p : paths_data)
-            {
-                fs::u8path full_path = pkg_folder / p.path;
-                // "exists" follows symlink so if the symlink doesn't link to existing target it
-                // will return false. There is such symlink in _openmp_mutex package. So if the file
-                // is a symlink we don't want to follow the symlink. The "paths_data" should include
-                // path of all the files and we should not need to follow symlink.
-                std::error_code ec;
-                auto exists = lexists(full_path, ec);
-                if (ec)
-                {
-                    LOG_WARNING << "Could not check existence: " << ec.message() << " (" << p.path
-                                << ")";
-                }
-                if (!exists)
+            const auto excluded_paths = read_excluded_paths(pkg_folder);
+            paths_data.erase(
+                std::remove_if(
+                    paths_data.begin(),
+                    paths_data.end(),
+                    [&](const PathData& p) { return excluded_paths.count(p.path) > 0; }
+                ),
+                paths_data.end()
+            );
+
+            // Only hashing the files is worth other threads, checking sizes is a stat per file
+            std::atomic<bool> invalid = false;
+            std::atomic<std::size_t> hashed_bytes = 0;
+            parallel_for(
+                paths_data.size(),
+                full_validation ? validate_threads(paths_data.size()) : 1,
+                [&](std::size_t i)
                 {
-                    if (is_warn || is_fail)
+                    if (invalid)
                     {
-                        LOG_WARNING << "Invalid package cache, file '" << full_path.string()
-                                    << "' is missing";
-                        return false;
+                        return;
                     }
-                }
-
-                // old packages don't have paths.json with validation information
-                if (p.size_in_bytes != 0)
-                {
-                    bool is_invalid = false;
-                    if (p.path_type != PathType::SOFTLINK
-                        && !validation::file_size(full_path, p.size_in_bytes))
+                    const auto& p = paths_data[i];
+                    const fs::u8path full_path = pkg_folder / p.path;
+                    switch (validate_file(full_path, p, full_validation))
                     {
-                        LOG_WARNING << "Invalid package cache, file '" << full_path.string()
-                                    << "' has incorrect size";
-                        is_invalid = true;
-                        if (is_fail)
-                        {
-                            return false;
-                        }
+                        case FileValidation::valid:
+                            if (full_validation && (p.path_type != PathType::SOFTLINK))
+                            {
+                                hashed_bytes += p.size_in_bytes;
+                            }
+                            return;
+                        case FileValidation::missing:
+                            LOG_WARNING << "Invalid package cache, file '" << full_path.string()
+                                        << "' is missing";
+                            invalid = true;
+                            return;
+                        case FileValidation::incorrect_size:
+                            LOG_WARNING << "Invalid package cache, file '" << full_path.string()
+                                        << "' has incorrect size";
+                            break;
+                        case FileValidation::incorrect_checksum:
+                            LOG_WARNING << "Invalid package cache, file '" << full_path.string()
+                                        << "' has incorrect SHA-256 checksum";
+                            break;
                     }
-                    if (full_validation && !is_invalid && p.path_type != PathType::SOFTLINK
-                        && !validation::sha256(full_path, p.sha256))
+                    if (is_fail)
                     {
-                        LOG_WARNING << "Invalid package cache, file '" << full_path.string()
-                                    << "' has incorrect SHA-256 checksum";
-                        if (is_fail)
-                        {
-                            return false;
-                        }
+                        invalid = true;
                     }
-                }
+                },
+                TaskPriority::high
+            );
+            if (invalid)
+            {
+                return false;
+            }
+
+            if (full_validation)
+            {
+                const auto elapsed = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start
+                );
+                const double throughput = static_cast<double>(hashed_bytes)
+                                          / std::max(elapsed.count(), 1e-6);
+                LOG_DEBUG << "Validated " << paths_data.size() << " files of '"
+                          << pkg_folder.string() << "' in " << elapsed.count() << "s at "
+                          << to_human_readable_filesize(throughput, 1) << "/s";
             }
         }
         catch (const std::exception& e)
@@ -4,6 +4,7 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include <string>
@@ -11,8 +12,16 @@
 #include "mamba/core/package_paths.hpp"
 #include "mamba/core/util_string.hpp"
 
+#include "fast_json.hpp"
+
 namespace mamba
 {
+    namespace
+    {
+        // Not part of any package, next to the repodata_record.json written at extraction
+        constexpr std::string_view excluded_paths_filename = "mamba-excluded.json";
+    }
+
     std::map<std::string, PrefixFileParse> read_has_prefix(const fs::u8path& path)
     {
         // reads `has_prefix` file and return dict mapping filepaths to
@@ -114,6 +123,11 @@ namespace mamba
         std::vector<PathData> res;
         if (fs::exists(paths_json_path))
         {
+            if (auto paths = fast_json::read_paths_json(paths_json_path))
+            {
+                return std::move(paths).value();
+            }
+
             nlohmann::json paths_json;
             std::ifstream paths_file = open_ifstream(paths_json_path);
             paths_file >> paths_json;
@@ -185,4 +199,40 @@ namespace mamba
         }
         return res;
     }
+
+    bool is_excluded_path(const std::vector<std::string>& patterns, std::string_view path)
+    {
+        if (starts_with(path, "./"))
+        {
+            path.remove_prefix(2);
+        }
+        if (starts_with(path, "info/"))
+        {
+            return false;
+        }
+        return std::any_of(
+            patterns.cbegin(),
+            patterns.cend(),
+            [&path](const std::string& pattern) { return glob_match(pattern, path); }
+        );
+    }
+
+    std::set<std::string> read_excluded_paths(const fs::u8path& directory)
+    {
+        const auto file = directory / "info" / excluded_paths_filename;
+        std::error_code ec;
+        if (!fs::exists(file, ec))
+        {
+            return {};
+        }
+        auto in = open_ifstream(file);
+        return nlohmann::json::parse(in).get<std::set<std::string>>();
+    }
+
+    void write_excluded_paths(const fs::u8path& directory, const std::vector<std::string>& paths)
+    {
+        fs::create_directories(directory / "info");
+        auto out = open_ofstream(directory / "info" / excluded_paths_filename);
+        out << nlohmann::json(paths).dump();
+    }
 }  // namespace mamba
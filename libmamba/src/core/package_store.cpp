@@ -0,0 +1,152 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <system_error>
+
+#include <fmt/format.h>
+
+#include "mamba/core/output.hpp"
+#include "mamba/core/package_paths.hpp"
+#include "mamba/core/validate.hpp"
+
+#include "package_store.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        /**
+         * The stored file for a content and permissions.
+         *
+         * Hardlinks share their permissions, so files that only differ by them are stored apart.
+         */
+        auto stored_path(const fs::u8path& store_dir, const std::string& sha256, fs::perms perms)
+            -> fs::u8path
+        {
+            const auto mode = static_cast<unsigned int>(perms & fs::perms::mask);
+            return store_dir / sha256.substr(0, 2) / fmt::format("{}-{:o}", sha256, mode);
+        }
+
+        /** Atomically replace ``file`` by a hardlink to ``target``. */
+        auto replace_by_hardlink(const fs::u8path& target, const fs::u8path& file) -> bool
+        {
+            auto ec = std::error_code();
+            const auto tmp_path = fs::u8path(file.string() + ".mamba_store");
+            fs::create_hard_link(target, tmp_path, ec);
+            if (ec)
+            {
+                LOG_DEBUG << "Could not hardlink " << file << " to the package store: "
+                          << ec.message();
+                return false;
+            }
+            fs::rename(tmp_path, file, ec);
+            if (ec)
+            {
+                fs::remove(tmp_path, ec);
+                return false;
+            }
+            return true;
+        }
+
+        /** Store the files of an extracted package, the package must have a paths.json. */
+        auto deduplicate_files(const fs::u8path& store_dir, const fs::u8path& extracted_dir)
+            -> std::size_t
+        {
+            std::size_t saved = 0;
+            for (const auto& path : read_paths(extracted_dir))
+            {
+                if ((path.path_type != PathType::HARDLINK) || path.sha256.empty()
+                    || (path.size_in_bytes == 0))
+                {
+                    continue;
+                }
+
+                const auto file = extracted_dir / path.path;
+                auto ec = std::error_code();
+                const auto status = fs::symlink_status(file, ec);
+                if (ec || !fs::is_regular_file(status) || (fs::hard_link_count(file, ec) > 1))
+                {
+                    // Missing, or already stored
+                    continue;
+                }
+                // Stored files are shared, a file not matching its declared content must not be
+                if ((fs::file_size(file, ec) != path.size_in_bytes) || ec
+                    || (validation::sha256sum(file) != path.sha256))
+                {
+                    LOG_DEBUG << "Not storing " << file << " that does not match its sha256";
+                    continue;
+                }
+
+                const auto stored = stored_path(store_dir, path.sha256, status.permissions());
+                fs::create_directories(stored.parent_path(), ec);
+                fs::create_hard_link(file, stored, ec);
+                if (!ec)
+                {
+                    // First package with this file
+                    continue;
+                }
+                if (fs::exists(stored) && replace_by_hardlink(stored, file))
+                {
+                    saved += path.size_in_bytes;
+                }
+            }
+            return saved;
+        }
+    }
+
+    PackageStore::PackageStore(const fs::u8path& pkgs_dir)
+        : m_store_dir(pkgs_dir / PACKAGE_STORE_DIR)
+    {
+    }
+
+    auto PackageStore::deduplicate(const fs::u8path& extracted_dir) -> std::size_t
+    {
+        if (!fs::exists(extracted_dir / "info" / "paths.json"))
+        {
+            return 0;
+        }
+
+        std::size_t saved = 0;
+        try
+        {
+            saved = deduplicate_files(m_store_dir, extracted_dir);
+        }
+        catch (const std::exception& e)
+        {
+            LOG_WARNING << "Could not deduplicate the files of " << extracted_dir << ": "
+                        << e.what();
+        }
+        if (saved > 0)
+        {
+            LOG_DEBUG << "Deduplicated " << saved << " bytes of " << extracted_dir;
+        }
+        return saved;
+    }
+
+    auto PackageStore::prune() -> std::size_t
+    {
+        if (!fs::exists(m_store_dir))
+        {
+            return 0;
+        }
+
+        std::size_t removed = 0;
+        for (auto& p : fs::recursive_directory_iterator(m_store_dir))
+        {
+            auto ec = std::error_code();
+            if (p.is_regular_file() && (fs::hard_link_count(p.path(), ec) == 1) && !ec)
+            {
+                const auto size = p.file_size(ec);
+                if (fs::remove(p.path(), ec))
+                {
+                    removed += size;
+                }
+            }
+        }
+        return removed;
+    }
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_PACKAGE_STORE_HPP
+#define MAMBA_CORE_PACKAGE_STORE_HPP
+
+#include <cstddef>
+
+#include "mamba/core/mamba_fs.hpp"
+
+#define PACKAGE_STORE_DIR ".mamba-store"
+
+namespace mamba
+{
+    /**
+     * Share the identical files of the extracted packages of a cache.
+     *
+     * Files are stored by their sha256 and permissions in a directory of the package cache,
+     * and the files of extracted packages are hardlinks to them, so that identical files use
+     * the disk and the page cache once, including in environments where they are hardlinked.
+     * Stored files are never modified, a file is removed from the store once no extracted
+     * package uses it.
+     */
+    class PackageStore
+    {
+    public:
+
+        explicit PackageStore(const fs::u8path& pkgs_dir);
+
+        /**
+         * Replace the files of an extracted package by hardlinks to the stored files.
+         *
+         * Only the files with a sha256 in ``info/paths.json`` that matches their content are
+         * stored. Files that cannot be hardlinked, for instance across file systems, are kept.
+         * Failures are only logged, the extracted package stays valid.
+         * @return The number of bytes no longer used by the package.
+         */
+        auto deduplicate(const fs::u8path& extracted_dir) -> std::size_t;
+
+        /**
+         * Remove the stored files no longer used by an extracted package.
+         *
+         * @return The number of bytes removed.
+         */
+        auto prune() -> std::size_t;
+
+    private:
+
+        fs::u8path m_store_dir;
+    };
+}
+
+#endif
@@ -0,0 +1,111 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_PARALLEL_HPP
+#define MAMBA_CORE_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+#include "thread_pool.hpp"
+
+namespace mamba
+{
+    /**
+     * Call ``func`` on all indices in [0, n) from up to ``n_threads`` threads.
+     *
+     * The calling thread is helped by the workers of the ``ThreadPool`` that are free, with
+     * the given ``priority``, so that the loop always progresses even if none is.
+     * The first exception thrown stops the remaining calls and is rethrown.
+     */
+    template <typename Func>
+    void parallel_for(
+        std::size_t n,
+        std::size_t n_threads,
+        const Func& func,
+        TaskPriority priority = TaskPriority::normal
+    )
+    {
+        std::atomic<std::size_t> next = 0;
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto work = [&]()
+        {
+            for (std::size_t i = next++; i < n; i = next++)
+            {
+                try
+                {
+                    func(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error)
+                    {
+                        error = std::current_exception();
+                    }
+                    next = n;
+                }
+            }
+        };
+
+        // Helpers starting after the loop is done must not use it anymore
+        struct Helpers
+        {
+            std::mutex mutex = {};
+            std::condition_variable done_cv = {};
+            std::size_t running = 0;
+            bool done = false;
+        };
+        auto helpers = std::make_shared<Helpers>();
+        const auto n_helpers = std::min(std::max<std::size_t>(n_threads, 1), n);
+        auto& pool = ThreadPool::instance();
+        for (std::size_t t = 1; t < n_helpers; ++t)
+        {
+            const bool queued = pool.try_submit(
+                [helpers, &work]()
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(helpers->mutex);
+                        if (helpers->done)
+                        {
+                            return;
+                        }
+                        ++helpers->running;
+                    }
+                    work();
+                    {
+                        std::lock_guard<std::mutex> lock(helpers->mutex);
+                        --helpers->running;
+                    }
+                    helpers->done_cv.notify_all();
+                },
+                priority
+            );
+            if (!queued)
+            {
+                break;
+            }
+        }
+        work();
+        {
+            std::unique_lock<std::mutex> lock(helpers->mutex);
+            helpers->done = true;
+            helpers->done_cv.wait(lock, [&]() { return helpers->running == 0; });
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+#endif
@@ -4,6 +4,7 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
 #include <fstream>
 
 #include "mamba/core/output.hpp"
@@ -13,34 +14,66 @@
 
 namespace mamba
 {
-    std::string python_pin(PrefixData& prefix_data, const std::vector<std::string>& specs)
+    namespace
     {
-        std::string pin = "";
-        std::string py_version;
-
-        auto iter = prefix_data.records().find("python");
-        if (iter != prefix_data.records().end())
+        std::string python_pin(
+            const std::string& py_version,
+            const std::vector<std::string>& specs,
+            ChannelContext& channel_context
+        )
         {
-            py_version = iter->second.version;
+            for (const auto& spec : specs)
+            {
+                // Only the specs that can be about python are parsed
+                if (spec.find("python") == std::string::npos)
+                {
+                    continue;
+                }
+                MatchSpec ms{ spec, channel_context };
+                if (ms.name == "python")
+                {
+                    return "";
+                }
+            }
+
+            std::vector<std::string> elems = split(py_version, ".");
+            if (elems.size() < 2)
+            {
+                return "";
+            }
+            std::string py_pin = concat("python ", elems[0], ".", elems[1], ".*");
+            LOG_DEBUG << "Pinning Python to '" << py_pin << "'";
+            return py_pin;
         }
-        else
+    }
+
+    std::string python_pin(PrefixData& prefix_data, const std::vector<std::string>& specs)
+    {
+        auto iter = prefix_data.records().find("python");
+        if (iter == prefix_data.records().end())
         {
             return "";  // Python not found in prefix
         }
+        return python_pin(iter->second.version, specs, prefix_data.channel_context());
+    }
 
-        for (const auto& spec : specs)
+    std::string python_pin(
+        const std::vector<PrefixData::RecordSummary>& summaries,
+        const std::vector<std::string>& specs,
+        ChannelContext& channel_context
+    )
+    {
+        const auto iter = std::lower_bound(
+            summaries.cbegin(),
+            summaries.cend(),
+            "python",
+            [](const PrefixData::RecordSummary& s, const char* name) { return s.name < name; }
+        );
+        if ((iter == summaries.cend()) || (iter->name != "python"))
         {
-            MatchSpec ms{ spec, prefix_data.channel_context() };
-            if (ms.name == "python")
-            {
-                return "";
-            }
+            return "";  // Python not found in prefix
         }
-
-        std::vector<std::string> elems = split(py_version, ".");
-        std::string py_pin = concat("python ", elems[0], ".", elems[1], ".*");
-        LOG_DEBUG << "Pinning Python to '" << py_pin << "'";
-        return py_pin;
+        return python_pin(iter->version, specs, channel_context);
     }
 
     std::vector<std::string> file_pins(const fs::u8path& file)
@@ -4,11 +4,16 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <cassert>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include <fmt/format.h>
 #include <solv/evr.h>
 #include <solv/pool.h>
+#include <solv/repo.h>
 #include <solv/selection.h>
 #include <solv/solver.h>
 extern "C"  // Incomplete header
@@ -22,6 +27,7 @@ extern "C"  // Incomplete header
 #include "mamba/core/match_spec.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/pool.hpp"
+#include "mamba/core/tracing.hpp"
 #include "mamba/core/util_string.hpp"
 #include "mamba/util/cast.hpp"
 #include "mamba/util/compare.hpp"
@@ -39,6 +45,13 @@ namespace mamba
 
         solv::ObjPool pool = {};
         ChannelContext& channel_context;
+        /** The channel of each repo, as parsed from its url on first use. */
+        std::unordered_map<::Id, const Channel*> repo_channels = {};
+        /** The dependency ids of the match spec strings parsed so far. */
+        std::unordered_map<std::string, ::Id> dependency_ids = {};
+        /** The names of the solvables in order, and the solvable count they were read at. */
+        std::vector<std::pair<std::string, ::Id>> sorted_names = {};
+        std::size_t sorted_names_solvables = 0;
     };
 
     MPool::MPool(ChannelContext& channel_context)
@@ -100,7 +113,120 @@ namespace mamba
 
     void MPool::create_whatprovides()
     {
+        auto trace = Tracer::instance().scope("create_whatprovides");
         pool().create_whatprovides();
+        trace.add_counter("solvables", pool().solvable_count());
+    }
+
+    namespace
+    {
+        /** Libsolv ids are non-negative, and used as vector indices. */
+        auto as_index(::Id id) -> std::size_t
+        {
+            assert(id >= 0);
+            return static_cast<std::size_t>(id);
+        }
+
+        /** Call the function on each package name used in a dependency. */
+        template <typename UnaryFunc>
+        void for_each_dependency_name(const ::Pool* pool, ::Id dep, UnaryFunc&& func)
+        {
+            // The libsolv macros test and clear the sign bit of the id
+            while (ISRELDEP(static_cast<unsigned int>(dep)))
+            {
+                const ::Reldep* const rel = GETRELDEP(pool, static_cast<unsigned int>(dep));
+                switch (rel->flags)
+                {
+                    case REL_AND:
+                    case REL_OR:
+                    case REL_WITH:
+                    case REL_WITHOUT:
+                    case REL_COND:
+                    case REL_UNLESS:
+                    case REL_ELSE:
+                        // Both sides are dependencies
+                        for_each_dependency_name(pool, rel->evr, func);
+                        break;
+                    default:
+                        break;
+                }
+                dep = rel->name;
+            }
+            func(dep);
+        }
+    }
+
+    void MPool::prune(const std::vector<std::string>& names)
+    {
+        auto trace = Tracer::instance().scope("prune");
+        auto& pool = this->pool();
+        pool.reset_considered_solvables();
+        const ::Pool* const raw_pool = pool.raw();
+
+        // Chain solvables by name, which is much cheaper than the whatprovides index.
+        // String ids are contiguous so they are used as vector indices.
+        const auto n_strings = static_cast<std::size_t>(raw_pool->ss.nstrings);
+        auto first_with_name = std::vector<solv::SolvableId>(n_strings, 0);
+        const auto n_solvables = static_cast<std::size_t>(raw_pool->nsolvables);
+        auto next_with_name = std::vector<solv::SolvableId>(n_solvables, 0);
+        pool.for_each_solvable_id(
+            [&](solv::SolvableId id)
+            {
+                const ::Id name = raw_pool->solvables[id].name;
+                next_with_name[as_index(id)] = first_with_name[as_index(name)];
+                first_with_name[as_index(name)] = id;
+            }
+        );
+
+        auto visited = std::vector<bool>(n_strings, false);
+        auto to_visit = std::vector<::Id>();
+        auto visit = [&](::Id name)
+        {
+            assert(0 <= name && static_cast<std::size_t>(name) < n_strings);
+            if (!visited[as_index(name)])
+            {
+                visited[as_index(name)] = true;
+                to_visit.push_back(name);
+            }
+        };
+        for (const auto& name : names)
+        {
+            if (auto id = pool.find_string(name))
+            {
+                visit(id.value());
+            }
+        }
+        pool.for_each_installed_solvable_id(
+            [&](solv::SolvableId id) { visit(raw_pool->solvables[id].name); }
+        );
+
+        auto considered = solv::ObjQueue();
+        while (!to_visit.empty())
+        {
+            const auto name = to_visit.back();
+            to_visit.pop_back();
+            for (auto id = first_with_name[as_index(name)]; id != 0;
+                 id = next_with_name[as_index(id)])
+            {
+                considered.push_back(id);
+                const ::Solvable& s = raw_pool->solvables[id];
+                if (s.requires == 0)
+                {
+                    continue;
+                }
+                // Zero terminated array, read in place to avoid copies
+                for (const ::Id* dep = s.repo->idarraydata + s.requires; *dep != 0; ++dep)
+                {
+                    for_each_dependency_name(raw_pool, *dep, visit);
+                }
+            }
+        }
+
+        LOG_INFO << "Pruned pool to " << considered.size() << " out of "
+                 << pool.solvable_count() << " solvables";
+        trace.add_counter("solvables", pool.solvable_count());
+        trace.add_counter("considered", considered.size());
+        pool.set_considered_solvables(considered);
     }
 
     MPool::operator Pool*()
@@ -165,6 +291,7 @@ namespace mamba
          */
         auto add_channel_specific_matchspec(
             ChannelContext& channel_context,
+            std::unordered_map<::Id, const Channel*>& repo_channels,
             solv::ObjPool& pool,
             const MatchSpec& ms
         ) -> solv::DependencyId
@@ -185,7 +312,9 @@ namespace mamba
             );
 
             const Channel& c = channel_context.make_channel(ms.channel);
-            solv::ObjQueue selected_pkgs = {};
+            // Whether the channel of each repo matches, so that it is checked once per repo
+            std::unordered_map<::Id, bool> repo_matches = {};
+            solv::ObjSmallQueue<32> selected_pkgs = {};
             pool.for_each_whatprovides(
                 match,
                 [&](solv::ObjSolvableViewConst s)
@@ -193,9 +322,18 @@ namespace mamba
                     // TODO this does not work with s.url(), we need to proper channel class
                     // to properly manage this.
                     auto repo = solv::ObjRepoView(*s.raw()->repo);
-                    // TODO make_channel should disapear avoiding conflict here
-                    auto const url = std::string(repo.url());
-                    if (channel_match(channel_context, channel_context.make_channel(url), c))
+                    auto [match_it, inserted] = repo_matches.emplace(repo.id(), false);
+                    if (inserted)
+                    {
+                        auto [chan_it, chan_inserted] = repo_channels.emplace(repo.id(), nullptr);
+                        if (chan_inserted)
+                        {
+                            // TODO make_channel should disapear avoiding conflict here
+                            chan_it->second = &channel_context.make_channel(repo.url());
+                        }
+                        match_it->second = channel_match(channel_context, *chan_it->second, c);
+                    }
+                    if (match_it->second)
                     {
                         selected_pkgs.push_back(s.id());
                     }
@@ -211,19 +349,34 @@ namespace mamba
         }
     }
 
+    ::Id MPool::conda_dependency_id(const std::string& spec)
+    {
+        auto [it, inserted] = m_data->dependency_ids.try_emplace(spec, 0);
+        if (inserted)
+        {
+            it->second = pool_conda_matchspec(pool().raw(), spec.c_str());
+        }
+        return it->second;
+    }
+
     ::Id MPool::matchspec2id(const MatchSpec& ms)
     {
         ::Id id = 0;
         if (ms.channel.empty())
         {
-            id = pool_conda_matchspec(pool().raw(), ms.conda_build_form().c_str());
+            id = conda_dependency_id(ms.conda_build_form());
         }
         else
         {
             // Working around shortcomings of ``pool_conda_matchspec``
             // The channels are not processed.
             // TODO Fragile! Installing this matchspec will always trigger a reinstall
-            id = add_channel_specific_matchspec(channel_context(), pool(), ms);
+            id = add_channel_specific_matchspec(
+                channel_context(),
+                m_data->repo_channels,
+                pool(),
+                ms
+            );
         }
         if (id == 0)
         {
@@ -245,6 +398,22 @@ namespace mamba
             out.build_number = s.build_number();
             out.channel = s.channel();
             out.url = s.url();
+            // Repodata records do not store their url, which is that of their repo
+            if (out.channel.empty() || out.url.empty())
+            {
+                const auto repo_url = solv::ObjRepoViewConst(*s.raw()->repo).url();
+                if (!repo_url.empty())
+                {
+                    if (out.channel.empty())
+                    {
+                        out.channel = repo_url;
+                    }
+                    if (out.url.empty())
+                    {
+                        out.url = fmt::format("{}/{}", repo_url, s.file_name());
+                    }
+                }
+            }
             out.subdir = s.subdir();
             out.fn = s.file_name();
             out.license = s.license();
@@ -291,6 +460,31 @@ namespace mamba
         return std::nullopt;
     }
 
+    std::optional<PackageView> MPool::id2pkgview(Id solv_id) const
+    {
+        if (const auto s = pool().get_solvable(solv_id))
+        {
+            return { PackageView{
+                /* .id= */ s->id(),
+                /* .name= */ s->name(),
+                /* .version= */ s->version(),
+                /* .build_string= */ s->build_string(),
+                /* .build_number= */ s->build_number(),
+                /* .channel= */ s->channel(),
+                /* .subdir= */ s->subdir(),
+                /* .fn= */ s->file_name(),
+                /* .url= */ s->url(),
+                /* .noarch= */ s->noarch(),
+            } };
+        }
+        return std::nullopt;
+    }
+
+    auto PackageView::spec() const -> std::string
+    {
+        return fmt::format("{} {} {}", name, version, build_string);
+    }
+
     std::optional<std::string> MPool::dep2str(Id dep_id) const
     {
         if (!dep_id)
@@ -301,8 +495,165 @@ namespace mamba
         return pool_dep2str(const_cast<::Pool*>(pool().raw()), dep_id);
     }
 
+    SolvableColumns MPool::solvable_columns(const std::vector<Id>& solv_ids) const
+    {
+        auto columns = SolvableColumns{};
+        columns.ids.reserve(solv_ids.size());
+        columns.names.reserve(solv_ids.size());
+        columns.versions.reserve(solv_ids.size());
+        columns.build_strings.reserve(solv_ids.size());
+        columns.build_numbers.reserve(solv_ids.size());
+        columns.depends_offsets.reserve(solv_ids.size() + 1);
+        columns.depends_offsets.push_back(0);
+
+        // Reused for all solvables
+        auto deps = solv::ObjQueue{};
+        for (const Id id : solv_ids)
+        {
+            const auto s = pool().get_solvable(id);
+            if (!s.has_value())
+            {
+                continue;
+            }
+            auto* const raw = const_cast<::Solvable*>(s->raw());
+            columns.ids.push_back(id);
+            columns.names.push_back(raw->name);
+            columns.versions.push_back(raw->evr);
+            columns.build_strings.push_back(::solvable_lookup_id(raw, SOLVABLE_BUILDFLAVOR));
+            columns.build_numbers.push_back(static_cast<std::int64_t>(s->build_number()));
+
+            deps.clear();
+            ::solvable_lookup_deparray(raw, SOLVABLE_REQUIRES, deps.raw(), -1);
+            columns.depends.insert(columns.depends.end(), deps.cbegin(), deps.cend());
+            columns.depends_offsets.push_back(static_cast<std::int64_t>(columns.depends.size()));
+        }
+        return columns;
+    }
+
+    SolvableColumns MPool::solvable_columns() const
+    {
+        auto ids = std::vector<Id>{};
+        ids.reserve(pool().solvable_count());
+        pool().for_each_solvable_id([&](Id id) { ids.push_back(id); });
+        return solvable_columns(ids);
+    }
+
+    std::vector<Id> MPool::match_names(std::string_view pattern) const
+    {
+        // Adding repos changes the solvable count, removing them clears the names
+        auto& names = m_data->sorted_names;
+        if (names.empty() || (m_data->sorted_names_solvables != pool().solvable_count()))
+        {
+            auto trace = Tracer::instance().scope("sort names");
+            auto ids = std::vector<::Id>();
+            ids.reserve(pool().solvable_count());
+            pool().for_each_solvable(
+                [&](solv::ObjSolvableViewConst s) { ids.push_back(s.raw()->name); }
+            );
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+            names.clear();
+            names.reserve(ids.size());
+            for (const ::Id id : ids)
+            {
+                names.emplace_back(pool().get_string(id), id);
+            }
+            std::sort(names.begin(), names.end());
+            m_data->sorted_names_solvables = pool().solvable_count();
+            trace.add_counter("names", names.size());
+        }
+
+        // Only the names with the literal prefix of the pattern can match
+        const auto prefix = pattern.substr(0, pattern.find('*'));
+        auto out = std::vector<Id>();
+        auto it = std::lower_bound(
+            names.cbegin(),
+            names.cend(),
+            prefix,
+            [](const auto& name, std::string_view p) { return std::string_view(name.first) < p; }
+        );
+        for (; (it != names.cend()) && starts_with(it->first, prefix); ++it)
+        {
+            if ((prefix.size() == pattern.size()) ? (it->first == pattern)
+                                                   : glob_match(pattern, it->first))
+            {
+                out.push_back(it->second);
+            }
+        }
+        return out;
+    }
+
+    auto MPool::snapshot() const -> Snapshot
+    {
+        auto snap = Snapshot{};
+        pool().for_each_repo_id([&](::Id id) { snap.repo_ids.push_back(id); });
+        if (const auto installed = pool().installed_repo())
+        {
+            snap.installed_repo_id = installed->id();
+        }
+        return snap;
+    }
+
+    void MPool::restore(const Snapshot& snapshot)
+    {
+        auto trace = Tracer::instance().scope("restore pool");
+        auto added = std::vector<::Id>();
+        pool().for_each_repo_id(
+            [&](::Id id)
+            {
+                if (std::find(snapshot.repo_ids.cbegin(), snapshot.repo_ids.cend(), id)
+                    == snapshot.repo_ids.cend())
+                {
+                    added.push_back(id);
+                }
+            }
+        );
+        for (const ::Id id : added)
+        {
+            remove_repo(id, true);
+        }
+
+        if ((snapshot.installed_repo_id != 0) && pool().has_repo(snapshot.installed_repo_id))
+        {
+            pool().set_installed_repo(snapshot.installed_repo_id);
+        }
+        else
+        {
+            ::pool_set_installed(pool().raw(), nullptr);
+        }
+        pool().reset_considered_solvables();
+        pool().create_whatprovides();
+    }
+
+    MPool MPool::fork()
+    {
+        auto trace = Tracer::instance().scope("fork pool");
+        auto forked = MPool(channel_context());
+        const auto installed = pool().installed_repo();
+        pool().for_each_repo(
+            [&](solv::ObjRepoView repo)
+            {
+                auto [forked_id, forked_repo] = forked.pool().add_repo(repo.name());
+                // Including the repo attributes, such as its url
+                repo.internalize();
+                forked_repo.read_buffer(repo.write_buffer());
+                forked_repo.raw()->priority = repo.raw()->priority;
+                forked_repo.raw()->subpriority = repo.raw()->subpriority;
+                if (installed.has_value() && (installed->id() == repo.id()))
+                {
+                    forked.pool().set_installed_repo(forked_id);
+                }
+            }
+        );
+        forked.create_whatprovides();
+        return forked;
+    }
+
     void MPool::remove_repo(::Id repo_id, bool reuse_ids)
     {
+        m_data->repo_channels.erase(repo_id);
+        m_data->sorted_names.clear();
         pool().remove_repo(repo_id, reuse_ids);
     }
 }  // namespace mamba
@@ -4,19 +4,301 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <optional>
 #include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
 
 #include "mamba/core/output.hpp"
 #include "mamba/core/prefix_data.hpp"
 #include "mamba/core/util.hpp"
 #include "mamba/core/util_string.hpp"
+#include "mamba/core/validate.hpp"
 #include "mamba/util/graph.hpp"
 
+#include "fast_json.hpp"
+#include "parallel.hpp"
+
 namespace mamba
 {
+    namespace
+    {
+        /** Bump when the content of the index changes. */
+        constexpr int prefix_index_version = 1;
+        constexpr std::string_view prefix_index_filename = "mamba-index.msgpack";
+
+        /**
+         * The keys of the records read by ``PackageInfo``.
+         *
+         * Other keys, such as the large ``files`` and ``paths_data``, are not loaded.
+         */
+        constexpr auto indexed_keys = std::array{
+            "name", "version", "build", "build_string", "build_number", "channel", "url", "subdir",
+            "fn", "size", "timestamp", "license", "md5", "sha256", "track_features", "noarch",
+            "depends", "constrains",
+        };
+
+        /** The attributes of a record file, which change whenever it is written. */
+        auto file_stamp(const fs::u8path& path) -> std::optional<nlohmann::json>
+        {
+            auto ec = std::error_code();
+            const auto size = fs::file_size(path, ec);
+            if (ec)
+            {
+                return std::nullopt;
+            }
+            const auto mtime = fs::last_write_time(path, ec);
+            if (ec)
+            {
+                return std::nullopt;
+            }
+            return nlohmann::json{
+                size,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch())
+                    .count(),
+            };
+        }
+
+        /**
+         * Read the fields of a record file used by ``PackageInfo``.
+         *
+         * Other fields are skipped by the parser without being built, so that reading the
+         * record of a package with many files does not allocate its file list.
+         */
+        auto read_record(const fs::u8path& path) -> nlohmann::json
+        {
+            const auto is_indexed = [](std::string_view key)
+            {
+                return std::find(indexed_keys.cbegin(), indexed_keys.cend(), key)
+                       != indexed_keys.cend();
+            };
+            if (auto record = fast_json::read_object(path, is_indexed))
+            {
+                return std::move(record).value();
+            }
+
+            auto infile = open_ifstream(path);
+            return nlohmann::json::parse(
+                infile,
+                [&](int depth, nlohmann::json::parse_event_t event, nlohmann::json& parsed)
+                {
+                    if ((depth != 1) || (event != nlohmann::json::parse_event_t::key))
+                    {
+                        return true;
+                    }
+                    return is_indexed(parsed.get_ref<const std::string&>());
+                }
+            );
+        }
+
+        /** The number of threads used to parse ``n_files`` record files. */
+        auto record_load_threads(std::size_t n_files) -> std::size_t
+        {
+            // Below this number of files per thread, starting threads does not pay off
+            constexpr std::size_t min_files_per_thread = 16;
+
+            const auto hardware_threads = std::size_t(std::thread::hardware_concurrency());
+            return std::clamp<std::size_t>(
+                hardware_threads,
+                1,
+                std::max<std::size_t>(n_files / min_files_per_thread, 1)
+            );
+        }
+
+        /**
+         * The name of the package required by a dependency of a record.
+         *
+         * Same as the name of its ``MatchSpec``, for the forms of dependencies found in records,
+         * such as ``python >=3.8`` or ``conda-forge::numpy[version='>=1.0']``, without parsing
+         * the whole spec.
+         */
+        auto dependency_name(std::string_view dep) -> std::string_view
+        {
+            dep = strip(dep);
+            if (const auto channel_end = dep.substr(0, dep.find('[')).rfind("::");
+                channel_end != std::string_view::npos)
+            {
+                dep.remove_prefix(channel_end + 2);
+            }
+            return dep.substr(0, dep.find_first_of(" =<>!~[(,|"));
+        }
+
+        /** The indexed records by filename, empty if the index is missing or invalid. */
+        auto read_index(const fs::u8path& index_file) -> nlohmann::json
+        {
+            if (!fs::exists(index_file))
+            {
+                return nlohmann::json::object();
+            }
+            try
+            {
+                auto in = open_ifstream(index_file);
+                auto index = nlohmann::json::from_msgpack(
+                    std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>()
+                );
+                if (index.at("version").get<int>() == prefix_index_version)
+                {
+                    return std::move(index.at("records"));
+                }
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Invalid prefix index " << index_file << ": " << e.what();
+            }
+            return nlohmann::json::object();
+        }
+
+        /** Write the index, the prefix may not be writable so failures are only logged. */
+        void write_index(const fs::u8path& index_file, nlohmann::json records)
+        {
+            const auto index = nlohmann::json{
+                { "version", prefix_index_version },
+                { "records", std::move(records) },
+            };
+            try
+            {
+                // Write to a temporary file so that concurrent readers never see a partial index
+                auto tmp_file = TemporaryFile("mambaf", "", index_file.parent_path());
+                {
+                    auto out = open_ofstream(tmp_file.path());
+                    nlohmann::json::to_msgpack(index, out);
+                    if (!out.flush())
+                    {
+                        throw std::runtime_error("could not write " + tmp_file.path().string());
+                    }
+                }
+                fs::rename(tmp_file.path(), index_file);
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Could not write prefix index " << index_file << ": " << e.what();
+            }
+        }
+
+        /**
+         * The records of the ``conda-meta`` directory, in the directory order.
+         *
+         * Records are read from the index when their file did not change since they were
+         * indexed, and the index is refreshed if any record was parsed.
+         * If @p stamp is given, it is set to a digest of the filename and attributes of all the
+         * record files, or to an empty string if the attributes of a file cannot be read.
+         */
+        auto load_record_files(const fs::u8path& conda_meta_dir, std::string* stamp = nullptr)
+            -> std::vector<nlohmann::json>
+        {
+            struct RecordFile
+            {
+                fs::u8path path;
+                std::string filename;
+                std::optional<nlohmann::json> stamp;
+                nlohmann::json record;
+            };
+
+            const auto index_file = conda_meta_dir / prefix_index_filename;
+            auto index = read_index(index_file);
+            auto files = std::vector<RecordFile>();
+            auto stale = std::vector<std::size_t>();
+            for (auto& p : fs::directory_iterator(conda_meta_dir))
+            {
+                auto filename = p.path().filename().string();
+                if (!ends_with(filename, ".json"))
+                {
+                    continue;
+                }
+
+                auto file = RecordFile{ p.path(), std::move(filename), file_stamp(p.path()), {} };
+                if (auto it = index.find(file.filename); file.stamp.has_value()
+                                                         && (it != index.end())
+                                                         && (it->at("stamp") == *file.stamp))
+                {
+                    file.record = std::move(it->at("record"));
+                }
+                else
+                {
+                    stale.push_back(files.size());
+                }
+                files.push_back(std::move(file));
+            }
+
+            // Files are parsed concurrently, then records are returned in the directory order
+            const std::size_t n_threads = record_load_threads(stale.size());
+            LOG_INFO << "Loading " << stale.size() << " package records with " << n_threads
+                     << " threads";
+            parallel_for(
+                stale.size(),
+                n_threads,
+                [&](std::size_t i)
+                {
+                    auto& file = files[stale[i]];
+                    LOG_TRACE << "Loading single package record: " << file.path;
+                    file.record = read_record(file.path);
+                }
+            );
+
+            if (stamp != nullptr)
+            {
+                // Sorted, as the directory order is not guaranteed to be stable
+                auto stamps = std::vector<std::string>();
+                stamps.reserve(files.size());
+                for (const auto& file : files)
+                {
+                    if (!file.stamp.has_value())
+                    {
+                        stamps.clear();
+                        break;
+                    }
+                    stamps.push_back(file.filename + ":" + file.stamp->dump() + "\n");
+                }
+                std::sort(stamps.begin(), stamps.end());
+                stamp->clear();
+                if (!stamps.empty() || files.empty())
+                {
+                    auto hash = validation::HashStream::sha256();
+                    const auto version = std::to_string(prefix_index_version) + "\n";
+                    hash.update(version.data(), version.size());
+                    for (const auto& s : stamps)
+                    {
+                        hash.update(s.data(), s.size());
+                    }
+                    *stamp = hash.hex_digest();
+                }
+            }
+
+            auto new_index = nlohmann::json::object();
+            auto records = std::vector<nlohmann::json>();
+            records.reserve(files.size());
+            for (auto& file : files)
+            {
+                if (file.stamp.has_value())
+                {
+                    new_index[file.filename] = {
+                        { "stamp", std::move(*file.stamp) },
+                        { "record", file.record },
+                    };
+                }
+                records.push_back(std::move(file.record));
+            }
+
+            LOG_INFO << "Loaded " << records.size() << " package records, " << stale.size()
+                     << " not from the prefix index";
+            if (!stale.empty() || (new_index.size() != index.size()))
+            {
+                write_index(index_file, std::move(new_index));
+            }
+            return records;
+        }
+    }
+
     auto PrefixData::create(const fs::u8path& prefix_path, ChannelContext& channel_context)
         -> expected_t<PrefixData>
     {
@@ -46,23 +328,79 @@ namespace mamba
         load();
     }
 
-    void PrefixData::load()
+    auto PrefixData::load_summaries(const fs::u8path& prefix_path)
+        -> std::vector<RecordSummary>
     {
-        auto conda_meta_dir = m_prefix_path / "conda-meta";
-        if (lexists(conda_meta_dir))
+        const auto conda_meta_dir = prefix_path / "conda-meta";
+        if (!lexists(conda_meta_dir))
         {
-            for (auto& p : fs::directory_iterator(conda_meta_dir))
+            return {};
+        }
+
+        auto summaries = std::vector<RecordSummary>();
+        for (auto& record : load_record_files(conda_meta_dir))
+        {
+            auto summary = RecordSummary();
+            summary.name = record.value("name", "");
+            summary.version = record.value("version", "");
+            // Same precedence as in PackageInfo
+            summary.build_string = record.value("build", "<UNKNOWN>");
+            if (summary.build_string == "<UNKNOWN>")
             {
-                if (ends_with(p.path().string(), ".json"))
-                {
-                    load_single_record(p.path());
-                }
+                summary.build_string = record.value("build_string", "");
             }
+            summary.build_number = record.value("build_number", std::size_t(0));
+            summary.channel = record.value("channel", "");
+            summary.url = record.value("url", "");
+            summary.subdir = record.value("subdir", "");
+            summaries.push_back(std::move(summary));
+        }
+
+        // Sorted by name, keeping the first record of a name as in ``records``
+        std::stable_sort(
+            summaries.begin(),
+            summaries.end(),
+            [](const RecordSummary& a, const RecordSummary& b) { return a.name < b.name; }
+        );
+        summaries.erase(
+            std::unique(
+                summaries.begin(),
+                summaries.end(),
+                [](const RecordSummary& a, const RecordSummary& b) { return a.name == b.name; }
+            ),
+            summaries.end()
+        );
+        return summaries;
+    }
+
+    void PrefixData::load()
+    {
+        auto conda_meta_dir = m_prefix_path / "conda-meta";
+        if (!lexists(conda_meta_dir))
+        {
+            return;
+        }
+
+        for (auto& record : load_record_files(conda_meta_dir, &m_records_stamp))
+        {
+            auto prec = PackageInfo(std::move(record));
+            m_package_records.insert({ prec.name, std::move(prec) });
         }
     }
 
     void PrefixData::add_packages(const std::vector<PackageInfo>& packages)
     {
+        if (!m_records_stamp.empty())
+        {
+            auto hash = validation::HashStream::sha256();
+            hash.update(m_records_stamp.data(), m_records_stamp.size());
+            for (const auto& pkg : packages)
+            {
+                const auto record = pkg.json_record().dump() + "\n";
+                hash.update(record.data(), record.size());
+            }
+            m_records_stamp = hash.hex_digest();
+        }
         for (const auto& pkg : packages)
         {
             LOG_DEBUG << "Adding virtual package: " << pkg.name << "=" << pkg.version << "="
@@ -76,6 +414,11 @@ namespace mamba
         return m_package_records;
     }
 
+    const std::string& PrefixData::records_stamp() const
+    {
+        return m_records_stamp;
+    }
+
     std::vector<PackageInfo> PrefixData::sorted_records() const
     {
         // TODO add_pip_as_python_dependency
@@ -98,11 +441,9 @@ namespace mamba
             {
                 for (const auto& dep : record->depends)
                 {
-                    // Creating a matchspec to parse the name (there may be a channel)
-                    auto ms = MatchSpec{ dep, m_channel_context };
                     // Ignoring unmatched dependencies, the environment could be broken
                     // or it could be a matchspec
-                    const auto from_iter = name_to_node_id.find(ms.name);
+                    const auto from_iter = name_to_node_id.find(dependency_name(dep));
                     if (from_iter != name_to_node_id.cend())
                     {
                         dep_graph.add_edge(from_iter->second, to_id);
@@ -132,11 +473,13 @@ namespace mamba
             }
         }
 
+        // Same node ids and order, on a graph faster to traverse
+        const auto compressed = util::CompressedDiGraph<const PackageInfo*>(dep_graph);
         auto sorted = std::vector<PackageInfo>();
-        sorted.reserve(dep_graph.number_of_nodes());
+        sorted.reserve(compressed.number_of_nodes());
         util::topological_sort_for_each_node_id(
-            dep_graph,
-            [&](node_id id) { sorted.push_back(*dep_graph.node(id)); }
+            compressed,
+            [&](std::size_t id) { sorted.push_back(*compressed.node(id)); }
         );
 
         return sorted;
@@ -155,10 +498,31 @@ namespace mamba
     void PrefixData::load_single_record(const fs::u8path& path)
     {
         LOG_INFO << "Loading single package record: " << path;
-        auto infile = open_ifstream(path);
-        nlohmann::json j;
-        infile >> j;
-        auto prec = PackageInfo(std::move(j));
+        m_records_stamp.clear();
+        auto prec = PackageInfo(read_record(path));
         m_package_records.insert({ prec.name, std::move(prec) });
     }
+
+    void PrefixData::load_records(const std::vector<fs::u8path>& paths)
+    {
+        m_records_stamp.clear();
+        auto records = std::vector<std::optional<PackageInfo>>(paths.size());
+        const std::size_t n_threads = record_load_threads(paths.size());
+        LOG_INFO << "Loading " << paths.size() << " package records with " << n_threads
+                 << " threads";
+        parallel_for(
+            paths.size(),
+            n_threads,
+            [&](std::size_t i)
+            {
+                LOG_TRACE << "Loading single package record: " << paths[i];
+                records[i].emplace(read_record(paths[i]));
+            }
+        );
+        // Inserted in order, so that the same record is kept for duplicated names
+        for (auto& prec : records)
+        {
+            m_package_records.insert({ prec->name, std::move(prec).value() });
+        }
+    }
 }  // namespace mamba
@@ -0,0 +1,280 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <chrono>
+#include <iterator>
+#include <set>
+#include <string_view>
+
+#include "mamba/core/output.hpp"
+#include "mamba/core/prefix_file_index.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/util_string.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        /** Bump when the content of the index changes. */
+        constexpr int file_index_version = 1;
+        // Not ending with .json, so that it is never read as a package record
+        constexpr std::string_view file_index_filename = "mamba-files.msgpack";
+
+        /** The attributes of a record file, which change whenever it is written. */
+        auto record_stamp(const fs::u8path& path) -> nlohmann::json
+        {
+            auto ec = std::error_code();
+            const auto size = fs::file_size(path, ec);
+            if (ec)
+            {
+                return nullptr;
+            }
+            const auto mtime = fs::last_write_time(path, ec);
+            if (ec)
+            {
+                return nullptr;
+            }
+            return nlohmann::json{
+                size,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch())
+                    .count(),
+            };
+        }
+
+        auto paths_of(const nlohmann::json& paths_data)
+            -> std::vector<std::pair<std::string, std::string>>
+        {
+            auto out = std::vector<std::pair<std::string, std::string>>();
+            const auto paths = paths_data.find("paths");
+            if (paths == paths_data.end())
+            {
+                return out;
+            }
+            out.reserve(paths->size());
+            for (const auto& path : *paths)
+            {
+                out.emplace_back(
+                    path["_path"].get<std::string>(),
+                    path.value("sha256_in_prefix", path.value("sha256", std::string()))
+                );
+            }
+            return out;
+        }
+    }
+
+    PrefixFileIndex::PrefixFileIndex(fs::u8path prefix)
+        : m_prefix(std::move(prefix))
+    {
+        load();
+    }
+
+    auto PrefixFileIndex::index_file() const -> fs::u8path
+    {
+        return m_prefix / "conda-meta" / file_index_filename;
+    }
+
+    void PrefixFileIndex::load()
+    {
+        const auto meta_dir = m_prefix / "conda-meta";
+        try
+        {
+            if (fs::exists(index_file()))
+            {
+                auto in = open_ifstream(index_file());
+                const auto index = nlohmann::json::from_msgpack(
+                    std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>()
+                );
+                if (index.at("version").get<int>() == file_index_version)
+                {
+                    for (const auto& [package, record] : index.at("records").items())
+                    {
+                        auto entry = Record();
+                        entry.stamp = record.at("stamp");
+                        entry.paths = record.at("paths").get<decltype(entry.paths)>();
+                        insert(package, std::move(entry));
+                    }
+                }
+            }
+        }
+        catch (const std::exception& e)
+        {
+            LOG_DEBUG << "Invalid prefix file index " << index_file() << ": " << e.what();
+            m_records.clear();
+            m_owners.clear();
+        }
+
+        // Refresh from the records that changed since the index was written
+        auto installed = std::set<std::string>();
+        auto ec = std::error_code();
+        for (const auto& entry : fs::directory_iterator(meta_dir, ec))
+        {
+            const auto filename = entry.path().filename().string();
+            if (!ends_with(filename, ".json"))
+            {
+                continue;
+            }
+            const auto package = filename.substr(0, filename.size() - 5);
+            installed.insert(package);
+
+            auto stamp = record_stamp(entry.path());
+            if (const auto it = m_records.find(package);
+                !stamp.is_null() && (it != m_records.end()) && (it->second.stamp == stamp))
+            {
+                continue;
+            }
+            try
+            {
+                auto file = open_ifstream(entry.path());
+                const auto j = nlohmann::json::parse(file);
+                auto record = Record{ std::move(stamp) };
+                if (const auto paths_data = j.find("paths_data"); paths_data != j.end())
+                {
+                    record.paths = paths_of(*paths_data);
+                }
+                erase(package);
+                insert(package, std::move(record));
+            }
+            catch (const std::exception& e)
+            {
+                LOG_WARNING << "Could not index the files of '" << entry.path().string()
+                            << "': " << e.what();
+                erase(package);
+            }
+            m_changed = true;
+        }
+
+        for (auto it = m_records.begin(); it != m_records.end();)
+        {
+            const auto package = (it++)->first;
+            if (installed.count(package) == 0)
+            {
+                erase(package);
+                m_changed = true;
+            }
+        }
+    }
+
+    void PrefixFileIndex::insert(const std::string& package, Record record)
+    {
+        for (const auto& [path, sha256] : record.paths)
+        {
+            // Later packages clobber the files of the earlier ones
+            m_owners.insert_or_assign(path, FileEntry{ package, sha256 });
+        }
+        m_records.insert_or_assign(package, std::move(record));
+    }
+
+    void PrefixFileIndex::erase(const std::string& package)
+    {
+        const auto it = m_records.find(package);
+        if (it == m_records.end())
+        {
+            return;
+        }
+        for (const auto& [path, sha256] : it->second.paths)
+        {
+            if (const auto owner = m_owners.find(path);
+                (owner != m_owners.end()) && (owner->second.package == package))
+            {
+                m_owners.erase(owner);
+            }
+        }
+        m_records.erase(it);
+    }
+
+    auto PrefixFileIndex::find(const std::string& path) const -> std::optional<FileEntry>
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto owner = m_owners.find(path);
+        if (owner == m_owners.end())
+        {
+            return std::nullopt;
+        }
+        return { owner->second };
+    }
+
+    auto PrefixFileIndex::files(const std::string& package) const
+        -> std::optional<std::vector<std::string>>
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it = m_records.find(package);
+        if (it == m_records.end())
+        {
+            return std::nullopt;
+        }
+        auto out = std::vector<std::string>();
+        out.reserve(it->second.paths.size());
+        for (const auto& [path, sha256] : it->second.paths)
+        {
+            out.push_back(path);
+        }
+        return { std::move(out) };
+    }
+
+    void PrefixFileIndex::add(const std::string& package, const nlohmann::json& paths_data)
+    {
+        auto record = Record();
+        record.paths = paths_of(paths_data);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // The stamp of the record is read once it is written
+        erase(package);
+        insert(package, std::move(record));
+        m_changed = true;
+    }
+
+    void PrefixFileIndex::remove(const std::string& package)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        erase(package);
+        m_changed = true;
+    }
+
+    void PrefixFileIndex::write()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_changed)
+        {
+            return;
+        }
+
+        const auto meta_dir = m_prefix / "conda-meta";
+        auto records = nlohmann::json::object();
+        for (auto& [package, record] : m_records)
+        {
+            if (record.stamp.is_null())
+            {
+                // Still null if the record is missing, so that it is read again when loading
+                record.stamp = record_stamp(meta_dir / (package + ".json"));
+            }
+            records[package] = { { "stamp", record.stamp }, { "paths", record.paths } };
+        }
+        const auto index = nlohmann::json{
+            { "version", file_index_version },
+            { "records", std::move(records) },
+        };
+        try
+        {
+            // Write to a temporary file so that concurrent readers never see a partial index
+            auto tmp_file = TemporaryFile("mambaf", "", meta_dir);
+            {
+                auto out = open_ofstream(tmp_file.path());
+                nlohmann::json::to_msgpack(index, out);
+                if (!out.flush())
+                {
+                    throw std::runtime_error("could not write " + tmp_file.path().string());
+                }
+            }
+            fs::rename(tmp_file.path(), index_file());
+            m_changed = false;
+        }
+        catch (const std::exception& e)
+        {
+            LOG_DEBUG << "Could not write prefix file index " << index_file() << ": " << e.what();
+        }
+    }
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <array>
+
+#include "prefix_replacement.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        void write(std::ostream& out, std::string_view data)
+        {
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        }
+
+        void write(std::string& out, std::string_view data)
+        {
+            out.append(data);
+        }
+    }
+
+    PrefixReplacer::PrefixReplacer(std::string_view placeholder, std::string_view new_prefix)
+        : m_placeholder(placeholder)
+        , m_new_prefix(new_prefix)
+        , m_searcher(placeholder.cbegin(), placeholder.cend())
+    {
+    }
+
+    auto PrefixReplacer::find(std::string_view data, std::size_t pos) const -> std::size_t
+    {
+        if (m_placeholder.empty() || (pos >= data.size()))
+        {
+            return std::string_view::npos;
+        }
+        const auto first = data.cbegin() + static_cast<std::ptrdiff_t>(pos);
+        const auto match = std::search(first, data.cend(), m_searcher);
+        return (match == data.cend()) ? std::string_view::npos
+                                      : static_cast<std::size_t>(match - data.cbegin());
+    }
+
+    template <typename Out>
+    auto PrefixReplacer::replace_text(std::string_view data, Out& out) const -> std::size_t
+    {
+        std::size_t count = 0;
+        std::size_t written = 0;
+        for (std::size_t pos = find(data, 0); pos != std::string_view::npos;
+             pos = find(data, written))
+        {
+            write(out, data.substr(written, pos - written));
+            write(out, m_new_prefix);
+            written = pos + m_placeholder.size();
+            ++count;
+        }
+        write(out, data.substr(written));
+        return count;
+    }
+
+    template <typename Out>
+    auto PrefixReplacer::replace_binary(std::string_view data, Out& out) const -> std::size_t
+    {
+        const std::size_t padding_size = (m_placeholder.size() > m_new_prefix.size())
+                                             ? m_placeholder.size() - m_new_prefix.size()
+                                             : 0;
+        static constexpr std::array<char, 256> zeros = {};
+
+        std::size_t count = 0;
+        std::size_t written = 0;
+        for (std::size_t pos = find(data, 0); pos != std::string_view::npos;
+             pos = find(data, written))
+        {
+            // Replace all the occurrences in the string, then pad it before its terminator
+            const std::size_t end = std::min(data.find('\0', pos), data.size());
+            const auto str = data.substr(0, end);
+            std::size_t string_count = 0;
+            while (pos != std::string_view::npos)
+            {
+                write(out, data.substr(written, pos - written));
+                write(out, m_new_prefix);
+                written = pos + m_placeholder.size();
+                ++string_count;
+                pos = find(str, written);
+            }
+            write(out, data.substr(written, end - written));
+            written = end;
+            for (std::size_t padding = padding_size * string_count; padding > 0;)
+            {
+                const std::size_t n = std::min(padding, zeros.size());
+                write(out, { zeros.data(), n });
+                padding -= n;
+            }
+            count += string_count;
+        }
+        write(out, data.substr(written));
+        return count;
+    }
+
+    auto PrefixReplacer::write_text(std::string_view data, std::ostream& out) const -> std::size_t
+    {
+        return replace_text(data, out);
+    }
+
+    auto PrefixReplacer::write_binary(std::string_view data, std::ostream& out) const
+        -> std::size_t
+    {
+        return replace_binary(data, out);
+    }
+
+    auto PrefixReplacer::write_text(std::string_view data, std::string& out) const -> std::size_t
+    {
+        return replace_text(data, out);
+    }
+
+    auto PrefixReplacer::write_binary(std::string_view data, std::string& out) const
+        -> std::size_t
+    {
+        return replace_binary(data, out);
+    }
+}
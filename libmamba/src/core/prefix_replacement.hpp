@@ -0,0 +1,75 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_PREFIX_REPLACEMENT_HPP
+#define MAMBA_CORE_PREFIX_REPLACEMENT_HPP
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * Replacement of the prefix placeholder of relocatable package files.
+ *
+ * Files are streamed to the output as they are scanned, so they can be read from a memory
+ * mapping without being copied. The placeholder is searched with a Boyer-Moore-Horspool
+ * searcher, which skips up to the placeholder length at each mismatch. Placeholders are long
+ * (up to 255 characters), which makes it much faster than searching for their first
+ * character, a path separator that is frequent in binaries.
+ */
+namespace mamba
+{
+    /** Replace a placeholder, that must outlive the replacer like the new prefix. */
+    class PrefixReplacer
+    {
+    public:
+
+        PrefixReplacer(std::string_view placeholder, std::string_view new_prefix);
+
+        /**
+         * Write @p data with all occurrences of the placeholder replaced by the new prefix.
+         *
+         * @return The number of replaced occurrences.
+         */
+        auto write_text(std::string_view data, std::ostream& out) const -> std::size_t;
+
+        /**
+         * Same as @ref write_text for binary files, where the placeholder is part of a NUL
+         * terminated string.
+         *
+         * When the new prefix is shorter than the placeholder, the size of the string is kept
+         * by padding it with as many NUL characters as were removed. Otherwise the rest of the
+         * file is shifted.
+         */
+        auto write_binary(std::string_view data, std::ostream& out) const -> std::size_t;
+
+        /** Same as @ref write_text, appending to @p out, to write files in a single call. */
+        auto write_text(std::string_view data, std::string& out) const -> std::size_t;
+
+        /** Same as @ref write_binary, appending to @p out. */
+        auto write_binary(std::string_view data, std::string& out) const -> std::size_t;
+
+    private:
+
+        using iterator = std::string_view::const_iterator;
+        using searcher_type = std::boyer_moore_horspool_searcher<iterator>;
+
+        std::string_view m_placeholder;
+        std::string_view m_new_prefix;
+        searcher_type m_searcher;
+
+        auto find(std::string_view data, std::size_t pos) const -> std::size_t;
+
+        template <typename Out>
+        auto replace_text(std::string_view data, Out& out) const -> std::size_t;
+        template <typename Out>
+        auto replace_binary(std::string_view data, Out& out) const -> std::size_t;
+    };
+}
+
+#endif
@@ -95,6 +95,13 @@ namespace mamba
         return *this;
     }
 
+    ProgressProxy&
+    ProgressProxy::post_progress(std::size_t current, std::size_t total, std::size_t speed)
+    {
+        p_bar->post_progress(current, total, speed);
+        return *this;
+    }
+
     std::size_t ProgressProxy::current() const
     {
         return p_bar->current();
@@ -9,6 +9,7 @@
 
 #include "mamba/core/context.hpp"
 #include "mamba/core/execution.hpp"
+#include "mamba/core/util_string.hpp"
 #include "mamba/util/compare.hpp"
 
 #include "progress_bar_impl.hpp"
@@ -1009,6 +1010,53 @@ namespace mamba
         progress.set_value(sstream.str());
     }
 
+    void write_lines_update(
+        std::ostream& ostream,
+        const std::vector<std::string>& previous,
+        const std::vector<std::string>& lines,
+        const std::string& messages
+    )
+    {
+        if (messages.empty() && (previous.size() == lines.size()))
+        {
+            const auto mismatch = std::mismatch(previous.cbegin(), previous.cend(), lines.cbegin());
+            const auto first_changed = mismatch.first - previous.cbegin();
+            const auto n_lines = static_cast<std::ptrdiff_t>(lines.size());
+            if (first_changed == n_lines)
+            {
+                return;
+            }
+            // A movement of zero lines moves by one line
+            if (first_changed < n_lines - 1)
+            {
+                ostream << cursor::up(static_cast<int>(n_lines - 1 - first_changed));
+            }
+            for (auto i = first_changed; i < n_lines; ++i)
+            {
+                const auto idx = static_cast<std::size_t>(i);
+                if (previous[idx] != lines[idx])
+                {
+                    ostream << cursor::horizontal_abs(0) << cursor::erase_line(2) << lines[idx];
+                }
+                if (i < n_lines - 1)
+                {
+                    ostream << cursor::next_line(1);
+                }
+            }
+            return;
+        }
+
+        for (std::size_t i = 1; i < previous.size(); ++i)
+        {
+            ostream << cursor::erase_line(2) << cursor::up(1);
+        }
+        ostream << cursor::erase_line(2) << cursor::horizontal_abs(0) << messages;
+        for (std::size_t i = 0; i < lines.size(); ++i)
+        {
+            ostream << (i > 0 ? "\n" : "") << lines[i];
+        }
+    }
+
     /**********************
      * ProgressBarManager *
      **********************/
@@ -1110,7 +1158,8 @@ namespace mamba
     {
         auto time = start_time();
         bool watch = m_period > duration_t::zero();
-        std::size_t previously_printed = 0;
+        // The lines on the terminal, of which only the changed ones are written again
+        std::vector<std::string> printed_lines;
         std::cout << cursor::hide();
 
         do
@@ -1118,20 +1167,29 @@ namespace mamba
             std::stringstream ostream;
             auto duration = time - start_time();
 
-            erase_lines(ostream, previously_printed);
             if (m_marked_to_terminate)
             {
+                erase_lines(ostream, printed_lines.empty() ? 0 : printed_lines.size() - 1);
                 std::cout << ostream.str() << cursor::show() << std::flush;
                 m_marked_to_terminate = false;
                 break;
             }
 
-            ostream << "[+] " << std::fixed << std::setprecision(1) << duration_str(duration) << "\n";
-            previously_printed = std::max(
-                print(ostream, 0, static_cast<std::size_t>(get_console_height() - 1), false),
-                std::size_t(1)
-            );
-            std::cout << ostream.str() << std::flush;
+            std::stringstream messages;
+            for (auto& f : m_print_hooks)
+            {
+                f(messages);
+            }
+            std::stringstream frame;
+            frame << "[+] " << std::fixed << std::setprecision(1) << duration_str(duration) << "\n";
+            print(frame, 0, static_cast<std::size_t>(get_console_height() - 1), false);
+            auto lines = split(frame.str(), "\n");
+            write_lines_update(ostream, printed_lines, lines, messages.str());
+            printed_lines = std::move(lines);
+            if (const auto update = ostream.str(); !update.empty())
+            {
+                std::cout << update << std::flush;
+            }
 
             auto now = std::chrono::high_resolution_clock::now();
             while (now > time)
@@ -1148,6 +1206,12 @@ namespace mamba
         m_watch_print_started = false;
     }
 
+    auto ProgressBarManager::default_period() -> duration_t
+    {
+        const auto rate = Context::instance().graphics_params.progress_bar_max_refresh_rate;
+        return std::chrono::milliseconds(1000) / std::max<std::size_t>(rate, 1);
+    }
+
     void ProgressBarManager::watch_print(const duration_t& period)
     {
         m_period = period;
@@ -1279,11 +1343,9 @@ namespace mamba
      ***************/
 
     ProgressBar::ProgressBar(const std::string& prefix, std::size_t total, int width)
-        : m_progress(0)
-        , m_total(total)
+        : m_total(total)
         , m_width(width)
         , m_repr(this)
-        , m_is_spinner(false)
     {
         m_repr.prefix.set_value(prefix);
     }
@@ -1296,6 +1358,8 @@ namespace mamba
 
     ProgressBar& ProgressBar::set_progress(std::size_t current, std::size_t total)
     {
+        // Supersedes a posted progress not sampled yet
+        m_progress_posted = false;
         m_current = current;
         m_total = total;
 
@@ -1362,13 +1426,14 @@ namespace mamba
 
     ProgressBar& ProgressBar::set_full()
     {
+        m_progress_posted = false;
         if (m_total && m_total < std::numeric_limits<std::size_t>::max())
         {
-            m_current = m_total;
+            m_current = m_total.load();
         }
         else
         {
-            m_total = m_current;
+            m_total = m_current.load();
         }
         m_is_spinner = false;
         m_progress = 100.;
@@ -1410,6 +1475,40 @@ namespace mamba
         return *this;
     }
 
+    ProgressBar&
+    ProgressBar::post_progress(std::size_t current, std::size_t total, std::size_t speed)
+    {
+        if (!started())
+        {
+            start();
+        }
+
+        m_current.store(current, std::memory_order_relaxed);
+        m_total.store(total, std::memory_order_relaxed);
+        m_speed.store(speed, std::memory_order_relaxed);
+        m_progress_posted.store(true, std::memory_order_release);
+        return *this;
+    }
+
+    ProgressBar& ProgressBar::sample_progress()
+    {
+        if (m_progress_posted.exchange(false, std::memory_order_acquire))
+        {
+            const std::size_t current = m_current.load(std::memory_order_relaxed);
+            const std::size_t total = m_total.load(std::memory_order_relaxed);
+            if (total)
+            {
+                deactivate_spinner();
+            }
+            else
+            {
+                activate_spinner();
+            }
+            set_progress(current, total);
+        }
+        return *this;
+    }
+
     std::size_t ProgressBar::current() const
     {
         return m_current;
@@ -1633,6 +1732,7 @@ namespace mamba
 
     ProgressBarRepr& ProgressBar::update_repr(bool compute_progress)
     {
+        sample_progress();
         call_progress_hook();
         m_repr.elapsed.set_value(fmt::format("{:>5}", elapsed_time_to_str()));
         call_repr_hook();
@@ -1888,6 +1988,7 @@ namespace mamba
 
             for (auto& bar : bars)
             {
+                bar->sample_progress();
                 current += bar->current();
                 total += bar->total();
                 ++total_count;
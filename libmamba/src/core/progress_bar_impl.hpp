@@ -32,6 +32,21 @@ namespace mamba
     int get_console_width();
     int get_console_height();
 
+    /**
+     * Write to a terminal the updates replacing the lines @p previous by @p lines.
+     *
+     * The cursor is expected on the last of the @p previous lines. The @p messages, if any,
+     * are written first, above the new lines.
+     * When there are no messages and as many lines as before, only the changed lines are
+     * written again, and nothing at all if none changed.
+     */
+    void write_lines_update(
+        std::ostream& ostream,
+        const std::vector<std::string>& previous,
+        const std::vector<std::string>& lines,
+        const std::string& messages = ""
+    );
+
     enum ChronoState
     {
         unset = 0,
@@ -188,7 +203,10 @@ namespace mamba
         virtual void clear_progress_bars();
         virtual void add_label(const std::string& label, const ProgressProxy& progress_bar);
 
-        void watch_print(const duration_t& period = std::chrono::milliseconds(100));
+        /** The refresh period of the ``progress_bar_max_refresh_rate`` setting. */
+        static duration_t default_period();
+
+        void watch_print(const duration_t& period = default_period());
         virtual std::size_t print(
             std::ostream& os,
             std::size_t width = 0,
@@ -330,6 +348,11 @@ namespace mamba
         ProgressBar& activate_spinner();
         ProgressBar& deactivate_spinner();
 
+        // Lock-free update from a transfer thread, the progress and spinner state
+        // being computed when the bar is sampled for rendering
+        ProgressBar& post_progress(std::size_t current, std::size_t total, std::size_t speed);
+        ProgressBar& sample_progress();
+
         ProgressBar&
         mark_as_completed(const std::chrono::milliseconds& delay = std::chrono::milliseconds::zero());
 
@@ -365,11 +388,13 @@ namespace mamba
 
         ProgressBar(const std::string& prefix, std::size_t total, int width = 0);
 
-        double m_progress = 0.;
-        std::size_t m_current = 0;
-        std::size_t m_in_progress = 0;
-        std::size_t m_total = 0;
-        std::size_t m_speed = 0, m_avg_speed = 0, m_current_avg = 0;
+        // Read by the rendering thread while being updated
+        std::atomic<double> m_progress{ 0. };
+        std::atomic<std::size_t> m_current{ 0 };
+        std::atomic<std::size_t> m_in_progress{ 0 };
+        std::atomic<std::size_t> m_total{ 0 };
+        std::atomic<std::size_t> m_speed{ 0 };
+        std::size_t m_avg_speed = 0, m_current_avg = 0;
         int m_width = 0;
 
         std::set<std::string> m_active_tasks = {};
@@ -379,8 +404,9 @@ namespace mamba
 
         ProgressBarRepr m_repr;
 
-        bool m_is_spinner;
-        bool m_completed = false;
+        std::atomic<bool> m_is_spinner{ false };
+        std::atomic<bool> m_completed{ false };
+        std::atomic<bool> m_progress_posted{ false };
 
         std::mutex m_mutex;
 
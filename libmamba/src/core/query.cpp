@@ -4,8 +4,11 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
 #include <iostream>
 #include <stack>
+#include <string_view>
+#include <thread>
 
 #include <fmt/chrono.h>
 #include <fmt/color.h>
@@ -21,8 +24,11 @@
 #include "mamba/core/query.hpp"
 #include "mamba/core/url.hpp"
 #include "mamba/core/util_string.hpp"
+#include "solv-cpp/pool.hpp"
 #include "solv-cpp/queue.hpp"
 
+#include "parallel.hpp"
+
 namespace mamba
 {
     namespace
@@ -50,9 +56,10 @@ namespace mamba
 
                 while (req != 0)
                 {
-                    solv::ObjQueue rec_solvables = {};
+                    // Queues of a few ids, not allocated for each dependency
+                    solv::ObjSmallQueue<32> rec_solvables = {};
                     // the following prints the requested version
-                    solv::ObjQueue job = { SOLVER_SOLVABLE_PROVIDES, req };
+                    solv::ObjSmallQueue<2> job = { SOLVER_SOLVABLE_PROVIDES, req };
                     selection_solvables(pool, job.raw(), rec_solvables.raw());
 
                     if (rec_solvables.size() != 0)
@@ -106,6 +113,7 @@ namespace mamba
 
         void reverse_walk_graph(
             MPool& pool,
+            const std::unordered_map<Id, std::vector<Id>>& reverse_deps,
             query_result::dependency_graph& dep_graph,
             query_result::dependency_graph::node_id parent,
             Solvable* s,
@@ -115,32 +123,148 @@ namespace mamba
             if (s)
             {
                 // figure out who requires `s`
-                solv::ObjQueue solvables = {};
-
-                pool_whatmatchesdep(pool, SOLVABLE_REQUIRES, s->name, solvables.raw(), -1);
+                const auto requiring = reverse_deps.find(s->name);
+                if (requiring == reverse_deps.end())
+                {
+                    return;
+                }
+                for (const Id el : requiring->second)
+                {
+                    ::Solvable* rs = pool_id2solvable(pool, el);
+                    auto it = visited.find(rs);
+                    if (it == visited.end())
+                    {
+                        auto pkg_info = pool.id2pkginfo(el);
+                        assert(pkg_info.has_value());
+                        auto dep_id = dep_graph.add_node(std::move(pkg_info).value());
+                        dep_graph.add_edge(parent, dep_id);
+                        visited.insert(std::make_pair(rs, dep_id));
+                        reverse_walk_graph(pool, reverse_deps, dep_graph, dep_id, rs, visited);
+                    }
+                    else
+                    {
+                        dep_graph.add_edge(parent, it->second);
+                    }
+                }
+            }
+        }
 
-                if (solvables.size() != 0)
+        /**
+         * Add the names that a dependency may match, following boolean dependencies.
+         *
+         * This can be more than the names matched by ``pool_match_dep``, which is used to
+         * check them.
+         */
+        void add_dep_names(const ::Pool* pool, Id dep, std::vector<Id>& names)
+        {
+            while (ISRELDEP(dep))
+            {
+                const ::Reldep* rd = GETRELDEP(pool, dep);
+                switch (rd->flags)
                 {
-                    for (auto& el : solvables)
+                    case REL_AND:
+                    case REL_OR:
+                    case REL_WITH:
+                    case REL_WITHOUT:
+                    case REL_COND:
+                    case REL_UNLESS:
+                    case REL_ELSE:
+                        add_dep_names(pool, rd->evr, names);
+                        break;
+                    default:
+                        break;
+                }
+                dep = rd->name;
+            }
+            names.push_back(dep);
+        }
+
+        /**
+         * The solvables requiring each name, in increasing order of solvable id.
+         *
+         * These are the same as the ones found by ``pool_whatmatchesdep`` with the name, for
+         * all names at once.
+         * The requirements of the solvables are read concurrently.
+         */
+        auto build_reverse_dependencies(::Pool* pool) -> std::unordered_map<Id, std::vector<Id>>
+        {
+            using reverse_dependencies = std::unordered_map<Id, std::vector<Id>>;
+
+            // The first two solvables are reserved by libsolv
+            constexpr Id first_solvable = 2;
+            // Below this number of solvables per thread, starting threads does not pay off
+            constexpr std::size_t min_solvables_per_thread = 20000;
+
+            const auto n_solvables = static_cast<std::size_t>(
+                std::max(pool->nsolvables - first_solvable, 0)
+            );
+            const std::size_t n_chunks = std::clamp<std::size_t>(
+                std::thread::hardware_concurrency(),
+                1,
+                std::max<std::size_t>(n_solvables / min_solvables_per_thread, 1)
+            );
+            const std::size_t chunk_size = (n_solvables + n_chunks - 1) / n_chunks;
+
+            auto chunks = std::vector<reverse_dependencies>(n_chunks);
+            parallel_for(
+                n_chunks,
+                n_chunks,
+                [&](std::size_t c)
+                {
+                    auto& requiring = chunks[c];
+                    auto names = std::vector<Id>();
+                    const auto begin = first_solvable + static_cast<Id>(c * chunk_size);
+                    const auto end = std::min(
+                        begin + static_cast<Id>(chunk_size),
+                        pool->nsolvables
+                    );
+                    for (Id p = begin; p < end; ++p)
                     {
-                        ::Solvable* rs = pool_id2solvable(pool, el);
-                        auto it = visited.find(rs);
-                        if (it == visited.end())
+                        ::Solvable* s = pool_id2solvable(pool, p);
+                        // Same solvables as the ones considered by ``pool_whatmatchesdep``
+                        if ((s->repo == nullptr) || s->repo->disabled
+                            || ((s->repo != pool->installed) && !pool_installable(pool, s))
+                            || (s->requires == 0))
                         {
-                            auto pkg_info = pool.id2pkginfo(el);
-                            assert(pkg_info.has_value());
-                            auto dep_id = dep_graph.add_node(std::move(pkg_info).value());
-                            dep_graph.add_edge(parent, dep_id);
-                            visited.insert(std::make_pair(rs, dep_id));
-                            reverse_walk_graph(pool, dep_graph, dep_id, rs, visited);
+                            continue;
                         }
-                        else
+                        for (Id* reqp = s->repo->idarraydata + s->requires; *reqp != 0; ++reqp)
                         {
-                            dep_graph.add_edge(parent, it->second);
+                            // Pre-requirements are not included, as with a negative marker
+                            if (*reqp == SOLVABLE_PREREQMARKER)
+                            {
+                                break;
+                            }
+                            names.clear();
+                            add_dep_names(pool, *reqp, names);
+                            for (const Id name : names)
+                            {
+                                if (pool_match_dep(pool, *reqp, name) == 0)
+                                {
+                                    continue;
+                                }
+                                auto& ids = requiring[name];
+                                if (ids.empty() || (ids.back() != p))
+                                {
+                                    ids.push_back(p);
+                                }
+                            }
                         }
                     }
                 }
+            );
+
+            // Chunks are merged in order, so that the solvables stay sorted
+            auto out = std::move(chunks.front());
+            for (std::size_t c = 1; c < chunks.size(); ++c)
+            {
+                for (auto& [name, ids] : chunks[c])
+                {
+                    auto& merged = out[name];
+                    merged.insert(merged.end(), ids.begin(), ids.end());
+                }
             }
+            return out;
         }
     }
 
@@ -154,6 +278,17 @@ namespace mamba
         m_pool.get().create_whatprovides();
     }
 
+    auto Query::get_reverse_dependencies() const -> const reverse_dependencies&
+    {
+        if (m_reverse_deps == nullptr)
+        {
+            m_reverse_deps = std::make_shared<const reverse_dependencies>(
+                build_reverse_dependencies(m_pool.get())
+            );
+        }
+        return *m_reverse_deps;
+    }
+
     namespace
     {
         auto print_solvable(const PackageInfo& pkg)
@@ -209,18 +344,55 @@ namespace mamba
         }
     }
 
+    namespace
+    {
+        /** Whether the query is only a package name with ``*`` wildcards, such as ``py*``. */
+        auto is_name_glob(std::string_view query) -> bool
+        {
+            const auto is_name_char = [](char c)
+            {
+                return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z'))
+                       || ((c >= '0') && (c <= '9')) || (c == '-') || (c == '_') || (c == '.')
+                       || (c == '*');
+            };
+            return (query.find('*') != std::string_view::npos)
+                   && std::all_of(query.cbegin(), query.cend(), is_name_char);
+        }
+    }
+
     query_result Query::find(const std::string& query) const
     {
-        solv::ObjQueue job, solvables;
+        solv::ObjQueue solvables = {};
 
-        const Id id = pool_conda_matchspec(m_pool.get(), query.c_str());
-        if (!id)
+        if (is_name_glob(query))
         {
-            throw std::runtime_error("Could not generate query for " + query);
+            // The same solvables as libsolv, which matches the glob against all the solvables,
+            // looked up from the matching names instead
+            const auto& pool = m_pool.get().pool();
+            for (const Id name : m_pool.get().match_names(query))
+            {
+                pool.for_each_whatprovides(
+                    name,
+                    [&](solv::ObjSolvableViewConst s)
+                    {
+                        if (s.raw()->name == name)
+                        {
+                            solvables.push_back(s.id());
+                        }
+                    }
+                );
+            }
+        }
+        else
+        {
+            const Id id = pool_conda_matchspec(m_pool.get(), query.c_str());
+            if (!id)
+            {
+                throw std::runtime_error("Could not generate query for " + query);
+            }
+            solv::ObjSmallQueue<2> job = { SOLVER_SOLVABLE_PROVIDES, id };
+            selection_solvables(m_pool.get(), job.raw(), solvables.raw());
         }
-        job.push_back(SOLVER_SOLVABLE_PROVIDES, id);
-
-        selection_solvables(m_pool.get(), job.raw(), solvables.raw());
         query_result::dependency_graph g;
 
         Pool* pool = m_pool.get();
@@ -255,7 +427,7 @@ namespace mamba
             throw std::runtime_error("Could not generate query for " + query);
         }
 
-        solv::ObjQueue job = { SOLVER_SOLVABLE_PROVIDES, id };
+        solv::ObjSmallQueue<2> job = { SOLVER_SOLVABLE_PROVIDES, id };
         query_result::dependency_graph g;
 
         if (tree)
@@ -269,7 +441,7 @@ namespace mamba
                 const auto node_id = g.add_node(std::move(pkg_info).value());
                 Solvable* const latest = pool_id2solvable(m_pool.get(), solvables.front());
                 std::map<Solvable*, size_t> visited = { { latest, node_id } };
-                reverse_walk_graph(m_pool, g, node_id, latest, visited);
+                reverse_walk_graph(m_pool, get_reverse_dependencies(), g, node_id, latest, visited);
             }
         }
         else
@@ -288,7 +460,8 @@ namespace mamba
 
     query_result Query::depends(const std::string& query, bool tree) const
     {
-        solv::ObjQueue job, solvables;
+        solv::ObjSmallQueue<2> job = {};
+        solv::ObjQueue solvables = {};
 
         const Id id = pool_conda_matchspec(m_pool.get(), query.c_str());
         if (!id)
@@ -416,7 +589,7 @@ namespace mamba
         /** Remove potential subdir from channel name (not url!). */
         auto cut_subdir(std::string_view str) -> std::string
         {
-            return split(str, "/", 1).front();  // Has at least one element
+            return std::string(std::get<0>(split_once(str, '/')));
         }
 
     }
@@ -440,10 +613,10 @@ namespace mamba
             }
             else
             {
-                auto sfmt = split(f, ":", 1);
-                headers.push_back(sfmt[0]);
-                cmds.push_back(sfmt[0]);
-                args.push_back(sfmt[1]);
+                const auto [cmd, arg] = split_once(f, ':');
+                headers.push_back(std::string(cmd));
+                cmds.push_back(std::string(cmd));
+                args.push_back(std::string(arg.value_or("")));
             }
         }
 
@@ -486,26 +659,38 @@ namespace mamba
             return row;
         };
 
-        printers::Table printer(headers);
-
-        if (!m_ordered_pkg_id_list.empty())
+        auto for_each_package = [&](auto&& func)
         {
-            for (auto& entry : m_ordered_pkg_id_list)
+            if (!m_ordered_pkg_id_list.empty())
             {
-                for (const auto& id : entry.second)
+                for (auto& entry : m_ordered_pkg_id_list)
                 {
-                    printer.add_row(format_row(m_dep_graph.node(id)));
+                    for (const auto& id : entry.second)
+                    {
+                        func(m_dep_graph.node(id));
+                    }
                 }
             }
-        }
-        else
-        {
-            for (const auto& id : m_pkg_id_list)
+            else
             {
-                printer.add_row(format_row(m_dep_graph.node(id)));
+                for (const auto& id : m_pkg_id_list)
+                {
+                    func(m_dep_graph.node(id));
+                }
             }
+        };
+
+        if (m_pkg_id_list.empty())
+        {
+            return out;
         }
-        return printer.print(out);
+
+        // Rows are formatted twice rather than all held, since results can be whole channels
+        printers::StreamedTable printer(headers);
+        for_each_package([&](const PackageInfo& pkg) { printer.fit(format_row(pkg)); });
+        printer.print_header(out);
+        for_each_package([&](const PackageInfo& pkg) { printer.print_row(out, format_row(pkg)); });
+        return out << std::flush;
     }
 
     class graph_printer
@@ -625,14 +810,54 @@ namespace mamba
         return out;
     }
 
-    nlohmann::json query_result::json(ChannelContext& channel_context) const
+    namespace
+    {
+        auto package_json(const PackageInfo& pkg) -> nlohmann::json
+        {
+            auto pkg_info_json = pkg.json_record();
+            // We want the cannonical channel name here.
+            // We do not know what is in the `channel` field so we need to make sure.
+            // This is most likely legacy and should be updated on the next major release.
+            pkg_info_json["channel"] = cut_subdir(cut_repo_name(pkg_info_json["channel"]));
+            return pkg_info_json;
+        }
+
+        /** A value dumped with an indent of 4, nested at the given level. */
+        auto dump_nested(const nlohmann::json& value, std::size_t level) -> std::string
+        {
+            auto out = value.dump(4);
+            replace_all(out, "\n", "\n" + std::string(4 * level, ' '));
+            return out;
+        }
+    }
+
+    nlohmann::json query_result::json_query(ChannelContext& channel_context) const
     {
-        nlohmann::json j;
         std::string query_type = m_type == QueryType::kSEARCH
                                      ? "search"
                                      : (m_type == QueryType::kDEPENDS ? "depends" : "whoneeds");
-        j["query"] = { { "query", MatchSpec{ m_query, channel_context }.conda_build_form() },
-                       { "type", query_type } };
+        return { { "query", MatchSpec{ m_query, channel_context }.conda_build_form() },
+                 { "type", query_type } };
+    }
+
+    nlohmann::json query_result::json_graph_roots() const
+    {
+        auto roots = nlohmann::json::array();
+        if (!m_dep_graph.successors(0).empty())
+        {
+            roots.push_back(package_json(m_dep_graph.node(0)));
+        }
+        else
+        {
+            roots.push_back(nlohmann::json(m_query));
+        }
+        return roots;
+    }
+
+    nlohmann::json query_result::json(ChannelContext& channel_context) const
+    {
+        nlohmann::json j;
+        j["query"] = json_query(channel_context);
 
         std::string msg = m_pkg_id_list.empty() ? "No entries matching \"" + m_query + "\" found"
                                                 : "";
@@ -641,34 +866,41 @@ namespace mamba
         j["result"]["pkgs"] = nlohmann::json::array();
         for (size_t i = 0; i < m_pkg_id_list.size(); ++i)
         {
-            auto pkg_info_json = m_dep_graph.node(m_pkg_id_list[i]).json_record();
-            // We want the cannonical channel name here.
-            // We do not know what is in the `channel` field so we need to make sure.
-            // This is most likely legacy and should be updated on the next major release.
-            pkg_info_json["channel"] = cut_subdir(cut_repo_name(pkg_info_json["channel"]));
-            j["result"]["pkgs"].push_back(std::move(pkg_info_json));
+            j["result"]["pkgs"].push_back(package_json(m_dep_graph.node(m_pkg_id_list[i])));
         }
 
         if (m_type != QueryType::kSEARCH && !m_pkg_id_list.empty())
         {
-            j["result"]["graph_roots"] = nlohmann::json::array();
-            if (!m_dep_graph.successors(0).empty())
-            {
-                auto pkg_info_json = m_dep_graph.node(0).json_record();
-                // We want the cannonical channel name here.
-                // We do not know what is in the `channel` field so we need to make sure.
-                // This is most likely legacy and should be updated on the next major release.
-                pkg_info_json["channel"] = cut_subdir(cut_repo_name(pkg_info_json["channel"]));
-                j["result"]["graph_roots"].push_back(std::move(pkg_info_json));
-            }
-            else
-            {
-                j["result"]["graph_roots"].push_back(nlohmann::json(m_query));
-            }
+            j["result"]["graph_roots"] = json_graph_roots();
         }
         return j;
     }
 
+    std::ostream& query_result::write_json(std::ostream& out, ChannelContext& channel_context) const
+    {
+        // The keys are written in the sorted order of the objects of ``json``
+        out << "{\n    \"query\": " << dump_nested(json_query(channel_context), 1)
+            << ",\n    \"result\": {\n";
+        if (m_type != QueryType::kSEARCH && !m_pkg_id_list.empty())
+        {
+            out << "        \"graph_roots\": " << dump_nested(json_graph_roots(), 2) << ",\n";
+        }
+        const std::string msg = m_pkg_id_list.empty()
+                                    ? "No entries matching \"" + m_query + "\" found"
+                                    : "";
+        out << "        \"msg\": " << nlohmann::json(msg).dump() << ",\n";
+
+        out << "        \"pkgs\": ";
+        auto pkgs = JsonArrayWriter(out, 2);
+        for (const auto& id : m_pkg_id_list)
+        {
+            pkgs.append(package_json(m_dep_graph.node(id)));
+        }
+        pkgs.finish();
+
+        return out << ",\n        \"status\": \"OK\"\n    }\n}";
+    }
+
     std::ostream& query_result::pretty(std::ostream& out) const
     {
         if (!m_pkg_id_list.empty())
@@ -0,0 +1,440 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <cstring>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+#include "mamba/core/environment.hpp"
+#include "mamba/core/output.hpp"
+#include "mamba/core/util.hpp"
+
+#include "rc_cache.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        /** Bump when the format of the file changes. */
+        constexpr std::uint64_t rc_cache_version = 1;
+        constexpr std::string_view rc_cache_magic = "MAMBARC";
+        /** Lists of rc files kept, such as the ones of the root and target prefixes. */
+        constexpr std::size_t rc_cache_max_entries = 8;
+
+        enum class NodeKind : std::uint64_t
+        {
+            null = 0,
+            scalar = 1,
+            sequence = 2,
+            map = 3,
+        };
+
+        struct Entry
+        {
+            std::vector<RCFileCache::Source> sources;
+            std::vector<YAML::Node> nodes;
+        };
+
+        class Writer
+        {
+        public:
+
+            void write(std::uint64_t val)
+            {
+                char bytes[sizeof(val)];
+                std::memcpy(bytes, &val, sizeof(val));
+                m_out.append(bytes, sizeof(val));
+            }
+
+            void write(std::string_view str)
+            {
+                write(static_cast<std::uint64_t>(str.size()));
+                m_out.append(str.data(), str.size());
+            }
+
+            void write(const YAML::Node& node)
+            {
+                switch (node.Type())
+                {
+                    case YAML::NodeType::Scalar:
+                        write(static_cast<std::uint64_t>(NodeKind::scalar));
+                        write(node.Tag());
+                        write(static_cast<std::uint64_t>(node.Style()));
+                        write(node.Scalar());
+                        break;
+                    case YAML::NodeType::Sequence:
+                        write(static_cast<std::uint64_t>(NodeKind::sequence));
+                        write(node.Tag());
+                        write(static_cast<std::uint64_t>(node.Style()));
+                        write(static_cast<std::uint64_t>(node.size()));
+                        for (const auto& item : node)
+                        {
+                            write(item);
+                        }
+                        break;
+                    case YAML::NodeType::Map:
+                        write(static_cast<std::uint64_t>(NodeKind::map));
+                        write(node.Tag());
+                        write(static_cast<std::uint64_t>(node.Style()));
+                        write(static_cast<std::uint64_t>(node.size()));
+                        for (const auto& item : node)
+                        {
+                            write(item.first);
+                            write(item.second);
+                        }
+                        break;
+                    default:
+                        write(static_cast<std::uint64_t>(NodeKind::null));
+                        break;
+                }
+            }
+
+            void write(const RCFileCache::Source& source)
+            {
+                write(source.path.string());
+                write(static_cast<std::uint64_t>(source.mtime));
+                write(source.size);
+                write(static_cast<std::uint64_t>(source.env_vars.size()));
+                for (const auto& [name, value] : source.env_vars)
+                {
+                    write(name);
+                    write(static_cast<std::uint64_t>(value.has_value()));
+                    write(value.value_or(""));
+                }
+            }
+
+            auto str() const -> const std::string&
+            {
+                return m_out;
+            }
+
+        private:
+
+            std::string m_out;
+        };
+
+        class Reader
+        {
+        public:
+
+            explicit Reader(std::string data)
+                : m_data(std::move(data))
+            {
+            }
+
+            auto read_int() -> std::uint64_t
+            {
+                std::uint64_t val = 0;
+                std::memcpy(&val, take(sizeof(val)).data(), sizeof(val));
+                return val;
+            }
+
+            auto read_str() -> std::string
+            {
+                return std::string(take(read_int()));
+            }
+
+            auto read_node() -> YAML::Node
+            {
+                const auto kind = static_cast<NodeKind>(read_int());
+                if (kind == NodeKind::null)
+                {
+                    return YAML::Node();
+                }
+                const auto tag = read_str();
+                const auto style = static_cast<YAML::EmitterStyle::value>(read_int());
+                auto node = YAML::Node();
+                switch (kind)
+                {
+                    case NodeKind::scalar:
+                        node = YAML::Node(read_str());
+                        break;
+                    case NodeKind::sequence:
+                    {
+                        node = YAML::Node(YAML::NodeType::Sequence);
+                        for (auto n = read_int(); n > 0; --n)
+                        {
+                            node.push_back(read_node());
+                        }
+                        break;
+                    }
+                    case NodeKind::map:
+                    {
+                        node = YAML::Node(YAML::NodeType::Map);
+                        for (auto n = read_int(); n > 0; --n)
+                        {
+                            auto key = read_node();
+                            node.force_insert(key, read_node());
+                        }
+                        break;
+                    }
+                    default:
+                        throw std::runtime_error("invalid node kind");
+                }
+                node.SetTag(tag);
+                node.SetStyle(style);
+                return node;
+            }
+
+            auto read_source() -> RCFileCache::Source
+            {
+                auto source = RCFileCache::Source();
+                source.path = fs::u8path(read_str());
+                source.mtime = static_cast<std::int64_t>(read_int());
+                source.size = read_int();
+                for (auto n = read_int(); n > 0; --n)
+                {
+                    auto name = read_str();
+                    const bool has_value = read_int() != 0;
+                    auto value = read_str();
+                    source.env_vars.emplace_back(
+                        std::move(name),
+                        has_value ? std::optional(std::move(value)) : std::nullopt
+                    );
+                }
+                return source;
+            }
+
+        private:
+
+            std::string m_data;
+            std::size_t m_pos = 0;
+
+            auto take(std::uint64_t n) -> std::string_view
+            {
+                if (n > m_data.size() - m_pos)
+                {
+                    throw std::runtime_error("truncated file");
+                }
+                const auto out = std::string_view(m_data).substr(m_pos, n);
+                m_pos += n;
+                return out;
+            }
+        };
+
+        auto read_entries(const fs::u8path& path) -> std::vector<Entry>
+        {
+            auto in = open_ifstream(path);
+            std::stringstream buffer;
+            buffer << in.rdbuf();
+            auto reader = Reader(buffer.str());
+            if ((reader.read_str() != rc_cache_magic) || (reader.read_int() != rc_cache_version))
+            {
+                return {};
+            }
+
+            const auto n_entries = reader.read_int();
+            if (n_entries > rc_cache_max_entries)
+            {
+                throw std::runtime_error("invalid number of entries");
+            }
+            auto entries = std::vector<Entry>(n_entries);
+            for (auto& entry : entries)
+            {
+                for (auto n = reader.read_int(); n > 0; --n)
+                {
+                    entry.sources.push_back(reader.read_source());
+                    entry.nodes.push_back(reader.read_node());
+                }
+            }
+            return entries;
+        }
+
+        auto has_paths(const Entry& entry, const std::vector<fs::u8path>& paths) -> bool
+        {
+            return std::equal(
+                entry.sources.begin(),
+                entry.sources.end(),
+                paths.begin(),
+                paths.end(),
+                [](const RCFileCache::Source& source, const fs::u8path& path)
+                { return source.path == path; }
+            );
+        }
+
+        /** Only stat the file, it is read again on a mismatch. */
+        auto is_unchanged(const RCFileCache::Source& cached) -> bool
+        {
+            std::error_code ec;
+            const auto mtime = fs::last_write_time(cached.path, ec);
+            if (ec || (mtime.time_since_epoch().count() != cached.mtime))
+            {
+                return false;
+            }
+            const auto size = fs::file_size(cached.path, ec);
+            if (ec || (size != cached.size))
+            {
+                return false;
+            }
+            // The variables expanded in the unchanged content
+            for (const auto& [name, value] : cached.env_vars)
+            {
+                if (env::get(name) != value)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    auto RCFileCache::Source::from_file(const fs::u8path& path) -> std::optional<Source>
+    {
+        std::error_code ec;
+        auto source = Source();
+        source.path = path;
+        source.mtime = static_cast<std::int64_t>(
+            fs::last_write_time(path, ec).time_since_epoch().count()
+        );
+        if (ec)
+        {
+            return std::nullopt;
+        }
+        source.size = fs::file_size(path, ec);
+        if (ec)
+        {
+            return std::nullopt;
+        }
+
+        std::stringstream buffer;
+        try
+        {
+            buffer << open_ifstream(path).rdbuf();
+        }
+        catch (const std::exception&)
+        {
+            return std::nullopt;
+        }
+        const auto content = buffer.str();
+        // Same variables as the ones expanded when parsing the file
+        static const auto env_var_re = std::regex(R"(\$\{([^\}'\"\s]+)\})");
+        for (auto it = std::sregex_iterator(content.begin(), content.end(), env_var_re);
+             it != std::sregex_iterator();
+             ++it)
+        {
+            auto name = (*it)[1].str();
+            auto value = env::get(name);
+            source.env_vars.emplace_back(std::move(name), std::move(value));
+        }
+        return { std::move(source) };
+    }
+
+    auto RCFileCache::default_path() -> fs::u8path
+    {
+        return env::user_cache_dir() / "mamba" / "rc_cache.bin";
+    }
+
+    RCFileCache::RCFileCache(fs::u8path path)
+        : m_path(std::move(path))
+    {
+    }
+
+    auto RCFileCache::load(const std::vector<fs::u8path>& sources) const
+        -> std::optional<std::vector<YAML::Node>>
+    {
+        if (!fs::exists(m_path))
+        {
+            return std::nullopt;
+        }
+
+        try
+        {
+            for (auto& entry : read_entries(m_path))
+            {
+                if (!has_paths(entry, sources))
+                {
+                    continue;
+                }
+                if (!std::all_of(entry.sources.begin(), entry.sources.end(), is_unchanged))
+                {
+                    LOG_DEBUG << "rc files changed since they were cached in " << m_path;
+                    return std::nullopt;
+                }
+                LOG_DEBUG << "Using rc files cached in " << m_path;
+                return { std::move(entry.nodes) };
+            }
+        }
+        catch (const std::exception& e)
+        {
+            LOG_DEBUG << "Could not read rc cache " << m_path << ": " << e.what();
+        }
+        return std::nullopt;
+    }
+
+    void RCFileCache::store(const std::vector<Source>& sources, const std::vector<YAML::Node>& nodes)
+        const
+    {
+        try
+        {
+            auto entries = std::vector<Entry>();
+            if (fs::exists(m_path))
+            {
+                try
+                {
+                    entries = read_entries(m_path);
+                }
+                catch (const std::exception&)
+                {
+                    // Overwritten by a valid cache
+                }
+            }
+
+            auto paths = std::vector<fs::u8path>();
+            for (const auto& source : sources)
+            {
+                paths.push_back(source.path);
+            }
+            entries.erase(
+                std::remove_if(
+                    entries.begin(),
+                    entries.end(),
+                    [&](const Entry& entry) { return has_paths(entry, paths); }
+                ),
+                entries.end()
+            );
+            // Most recent first
+            entries.insert(entries.begin(), Entry{ sources, nodes });
+            if (entries.size() > rc_cache_max_entries)
+            {
+                entries.resize(rc_cache_max_entries);
+            }
+
+            auto writer = Writer();
+            writer.write(rc_cache_magic);
+            writer.write(rc_cache_version);
+            writer.write(static_cast<std::uint64_t>(entries.size()));
+            for (const auto& entry : entries)
+            {
+                writer.write(static_cast<std::uint64_t>(entry.sources.size()));
+                for (std::size_t i = 0; i < entry.sources.size(); ++i)
+                {
+                    writer.write(entry.sources[i]);
+                    writer.write(entry.nodes[i]);
+                }
+            }
+
+            fs::create_directories(m_path.parent_path());
+            // Replaced at once, so that concurrent runs read a complete file
+            auto tmp_file = TemporaryFile("mambaf", ".rc_cache", m_path.parent_path());
+            {
+                auto out = open_ofstream(tmp_file.path());
+                out.write(writer.str().data(), static_cast<std::streamsize>(writer.str().size()));
+                if (!out.flush())
+                {
+                    throw std::runtime_error("could not write " + tmp_file.path().string());
+                }
+            }
+            fs::rename(tmp_file.path(), m_path);
+        }
+        catch (const std::exception& e)
+        {
+            LOG_DEBUG << "Could not write rc cache " << m_path << ": " << e.what();
+        }
+    }
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_RC_CACHE_HPP
+#define MAMBA_CORE_RC_CACHE_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "mamba/core/mamba_fs.hpp"
+
+namespace mamba
+{
+    /**
+     * An on disk cache of the parsed rc files.
+     *
+     * Parsing the yaml of the rc files is a large part of the startup time of short commands,
+     * while the files rarely change.
+     * The parsed files are stored in a compact binary form, for the last few lists of rc files
+     * that were loaded.
+     * An entry is only used if all of its files have the same modification time and size as
+     * when it was stored, and the environment variables they expand have the same values.
+     */
+    class RCFileCache
+    {
+    public:
+
+        /** What the content of a parsed rc file depends on. */
+        struct Source
+        {
+            fs::u8path path;
+            std::int64_t mtime = 0;
+            std::uint64_t size = 0;
+            /** The environment variables expanded in the file, with their values if set. */
+            std::vector<std::pair<std::string, std::optional<std::string>>> env_vars = {};
+
+            /** Describe the current state of a file, before parsing it. */
+            static auto from_file(const fs::u8path& path) -> std::optional<Source>;
+        };
+
+        /** In the user cache directory, since it is used before the configuration is known. */
+        static auto default_path() -> fs::u8path;
+
+        explicit RCFileCache(fs::u8path path);
+
+        /** The parsed files, in the order of @p sources, if all of them are unchanged. */
+        auto load(const std::vector<fs::u8path>& sources) const
+            -> std::optional<std::vector<YAML::Node>>;
+
+        /** Store parsed files, failures are only logged as they do not prevent loading. */
+        void store(const std::vector<Source>& sources, const std::vector<YAML::Node>& nodes) const;
+
+    private:
+
+        fs::u8path m_path;
+    };
+}
+
+#endif
@@ -0,0 +1,125 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include "mamba/core/fsutil.hpp"
+#include "mamba/core/output.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/util_random.hpp"
+#include "mamba/core/validate.hpp"
+
+#include "relocation_cache.hpp"
+
+namespace mamba
+{
+    RelocationCache::RelocationCache(fs::u8path pkgs_dir)
+        : m_dir(std::move(pkgs_dir) / RELOCATION_CACHE_DIR)
+    {
+    }
+
+    auto RelocationCache::key(
+        std::string_view sha256,
+        std::string_view placeholder,
+        std::string_view new_prefix,
+        FileMode mode
+    ) -> std::string
+    {
+        auto hash = validation::HashStream::sha256();
+        // Separated by NUL characters, which none of them contains
+        for (const auto part : { sha256, placeholder, new_prefix })
+        {
+            hash.update(part.data(), part.size());
+            hash.update("", 1);
+        }
+        const char mode_char = (mode == FileMode::BINARY) ? 'b' : 't';
+        hash.update(&mode_char, 1);
+        return hash.hex_digest();
+    }
+
+    auto RelocationCache::file_path(const std::string& key) const -> fs::u8path
+    {
+        // Not too many files per directory
+        return m_dir / key.substr(0, 2) / key;
+    }
+
+    auto RelocationCache::link(const std::string& key, const fs::u8path& dst, bool copy) const
+        -> std::optional<std::string>
+    {
+        const auto file = file_path(key);
+        std::error_code ec;
+        if (!fs::exists(file, ec))
+        {
+            return std::nullopt;
+        }
+
+        std::string sha256;
+        try
+        {
+            auto in = open_ifstream(file.string() + ".sha256");
+            in >> sha256;
+        }
+        catch (const std::exception&)
+        {
+            return std::nullopt;
+        }
+        if (sha256.empty())
+        {
+            return std::nullopt;
+        }
+
+        if (!copy)
+        {
+            fs::create_hard_link(file, dst, ec);
+        }
+        if (copy || ec)
+        {
+            ec.clear();
+            mamba_fs::clone_file(file, dst, ec);
+        }
+        if (ec)
+        {
+            ec.clear();
+            fs::copy_file(file, dst, ec);
+        }
+        if (ec)
+        {
+            LOG_DEBUG << "Could not link relocated file " << file << ": " << ec.message();
+            fs::remove(dst, ec);
+            return std::nullopt;
+        }
+        LOG_TRACE << "Linked relocated file '" << file.string() << "' to '" << dst.string() << "'";
+        return { std::move(sha256) };
+    }
+
+    void RelocationCache::store(
+        const std::string& key,
+        const fs::u8path& file,
+        const std::string& sha256
+    ) const
+    {
+        const auto cached = file_path(key);
+        try
+        {
+            fs::create_directories(cached.parent_path());
+            {
+                auto out = open_ofstream(cached.string() + ".sha256");
+                out << sha256;
+            }
+            // Other processes only see complete files
+            const auto tmp = cached.string() + "." + generate_random_alphanumeric_string(8);
+            std::error_code ec;
+            fs::create_hard_link(file, tmp, ec);
+            if (ec)
+            {
+                fs::copy_file(file, tmp);
+            }
+            fs::rename(tmp, cached);
+        }
+        catch (const std::exception& e)
+        {
+            LOG_DEBUG << "Could not cache relocated file " << file << ": " << e.what();
+        }
+    }
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_RELOCATION_CACHE_HPP
+#define MAMBA_CORE_RELOCATION_CACHE_HPP
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/package_paths.hpp"
+
+#define RELOCATION_CACHE_DIR ".relocated"
+
+namespace mamba
+{
+    /**
+     * The files of a package cache already relocated to a prefix, to link them again.
+     *
+     * Files are keyed by the checksum of the package file, its placeholder, the new prefix
+     * and the file mode, so that installing a package again at the same prefix links the
+     * relocated files instead of rewriting them.
+     * Files are stored under the ``.relocated`` directory of the package cache, next to the
+     * checksum of their relocated content.
+     */
+    class RelocationCache
+    {
+    public:
+
+        explicit RelocationCache(fs::u8path pkgs_dir);
+
+        static auto key(
+            std::string_view sha256,
+            std::string_view placeholder,
+            std::string_view new_prefix,
+            FileMode mode
+        ) -> std::string;
+
+        /**
+         * Create @p dst as a hard-link to the relocated file @p key, or as a copy.
+         *
+         * @return The checksum of the relocated file, or nothing if it is not cached.
+         */
+        auto link(const std::string& key, const fs::u8path& dst, bool copy) const
+            -> std::optional<std::string>;
+
+        /**
+         * Store the relocated file @p file, of checksum @p sha256, as @p key.
+         *
+         * Failures are only logged, as the package cache may not be writable.
+         */
+        void store(const std::string& key, const fs::u8path& file, const std::string& sha256) const;
+
+    private:
+
+        fs::u8path m_dir;
+
+        auto file_path(const std::string& key) const -> fs::u8path;
+    };
+}
+
+#endif
@@ -6,7 +6,15 @@
 
 #include <algorithm>
 #include <array>
+#include <ctime>
+#include <functional>
+#include <optional>
+#include <set>
+#include <string_view>
 #include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 #include <nlohmann/json.hpp>
 #include <solv/repo.h>
@@ -20,16 +28,25 @@ extern "C"  // Incomplete header
 }
 
 #include "mamba/core/context.hpp"
+#include "mamba/core/fsutil.hpp"
+#include "mamba/core/match_spec.hpp"
 #include "mamba/core/mamba_fs.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/package_info.hpp"
 #include "mamba/core/pool.hpp"
 #include "mamba/core/prefix_data.hpp"
 #include "mamba/core/repo.hpp"
+#include "mamba/core/thread_utils.hpp"
 #include "mamba/core/util.hpp"
+#include "mamba/core/util_string.hpp"
+#include "mamba/specs/repo_data.hpp"
 #include "solv-cpp/pool.hpp"
 #include "solv-cpp/repo.hpp"
 
+#include "fast_json.hpp"
+#include "mapped_file.hpp"
+#include "repodata_index.hpp"
+#include "thread_pool.hpp"
 
 #define MAMBA_TOOL_VERSION "1.3"
 
@@ -94,7 +111,69 @@ namespace mamba
         m_repo = repo.raw();
         repo.set_url(m_metadata.url);
         load_file(index);
-        set_solvables_url(m_metadata.url);
+        exclude_records();
+        // Solvable urls are composed from the repo url when needed, rather than stored
+        // for each solvable, and reading an outdated solv file may have replaced it
+        repo.set_url(m_metadata.url);
+        repo.internalize();
+    }
+
+    MRepo::MRepo(
+        MPool& pool,
+        const std::string& name,
+        RepoDataRecords&& records,
+        const RepoMetadata& metadata
+    )
+        : m_pool(pool)
+        , m_metadata(metadata)
+    {
+        auto [_, repo] = pool.pool().add_repo(name);
+        m_repo = repo.raw();
+        repo.set_url(m_metadata.url);
+        add_repodata_records(records);
+        if (Context::instance().add_pip_as_python_dependency)
+        {
+            add_pip_as_python_dependency();
+        }
+        // Records not read from a single file, such as repodata shards, have no solv cache
+        if (!records.filename.empty())
+        {
+            auto solv_file = records.filename;
+            solv_file.replace_extension("solv");
+            write_solv(solv_file);
+        }
+        exclude_records();
+        repo.set_url(m_metadata.url);
+        repo.internalize();
+    }
+
+    MRepo::MRepo(
+        MPool& pool,
+        const std::string& name,
+        RepoDataRecordsUpdate&& update,
+        const RepoMetadata& metadata
+    )
+        : m_pool(pool)
+        , m_metadata(metadata)
+    {
+        auto [_, repo] = pool.pool().add_repo(name);
+        m_repo = repo.raw();
+        repo.set_url(m_metadata.url);
+        const auto& json_file = update.records.filename;
+        auto solv_file = json_file;
+        solv_file.replace_extension("solv");
+        if (read_solv(solv_file))
+        {
+            update_repodata_records(update);
+            write_solv(solv_file);
+        }
+        else
+        {
+            LOG_INFO << "Cannot update solv file " << solv_file << ", reading full repodata";
+            load_file(json_file);
+        }
+        exclude_records();
+        repo.set_url(m_metadata.url);
         repo.internalize();
     }
 
@@ -103,49 +182,296 @@ namespace mamba
     {
         auto [_, repo] = pool.pool().add_repo(name);
         m_repo = repo.raw();
-        for (auto& info : package_infos)
+        auto infos = std::vector<const PackageInfo*>();
+        infos.reserve(package_infos.size());
+        for (const auto& info : package_infos)
         {
-            add_package_info(info);
+            infos.push_back(&info);
         }
+        add_package_infos(infos);
         repo.internalize();
     }
 
+    MRepo::MRepo(MPool& pool, const std::string& name, const RepoMetadata& metadata)
+        : m_pool(pool)
+        , m_metadata(metadata)
+    {
+        auto [_, repo] = pool.pool().add_repo(name);
+        m_repo = repo.raw();
+        repo.set_url(m_metadata.url);
+    }
+
+    auto MRepo::read_solv_file(
+        MPool& pool,
+        const std::string& name,
+        const fs::u8path& filename,
+        const RepoMetadata& metadata
+    ) -> std::optional<MRepo>
+    {
+        auto out = MRepo(pool, name, metadata);
+        bool read = false;
+        try
+        {
+            const auto lock = LockFile(filename, LockMode::shared);
+            read = out.read_solv(filename);
+        }
+        catch (const std::exception& e)
+        {
+            LOG_INFO << "Could not read solv file " << filename << ": " << e.what();
+        }
+        if (!read)
+        {
+            pool.pool().remove_repo(srepo(out).id(), /* reuse_ids= */ true);
+            return std::nullopt;
+        }
+        out.exclude_records();
+        srepo(out).set_url(metadata.url);
+        srepo(out).internalize();
+        return { std::move(out) };
+    }
+
+    namespace
+    {
+        /** The solv cache of the installed repo, in the ``conda-meta`` directory. */
+        constexpr std::string_view installed_solv_filename = "mamba-installed.solv";
+
+        /** The installed repo is identified by the state of the records of the prefix. */
+        auto installed_metadata(const PrefixData& prefix_data) -> RepoMetadata
+        {
+            return {
+                /* .url= */ "",
+                /* .etag= */ "",
+                /* .mod= */ prefix_data.records_stamp(),
+                /* .pip_added= */ Context::instance().add_pip_as_python_dependency,
+            };
+        }
+    }
+
     MRepo::MRepo(MPool& pool, const PrefixData& prefix_data)
         : m_pool(pool)
+        , m_metadata(installed_metadata(prefix_data))
+    {
+        auto [repo_id, repo] = pool.pool().add_repo("installed");
+        m_repo = repo.raw();
+
+        const auto solv_file = prefix_data.path() / "conda-meta" / installed_solv_filename;
+        const bool cacheable = !m_metadata.mod.empty();
+        bool read = false;
+        if (cacheable && fs::exists(solv_file))
+        {
+            try
+            {
+                read = read_solv(solv_file);
+            }
+            catch (const std::exception& e)
+            {
+                LOG_INFO << "Could not read solv file " << solv_file << ": " << e.what();
+                repo.clear(/* reuse_ids= */ false);
+            }
+        }
+        if (!read)
+        {
+            add_prefix_records(prefix_data);
+            // Such as read-only prefixes
+            if (cacheable && path::is_writable(solv_file))
+            {
+                try
+                {
+                    write_solv(solv_file);
+                }
+                catch (const std::exception& e)
+                {
+                    LOG_INFO << "Could not write " << solv_file << ": " << e.what();
+                }
+            }
+        }
+
+        repo.internalize();
+        pool.pool().set_installed_repo(repo_id);
+    }
+
+    MRepo::MRepo(MPool& pool, const PrefixData& prefix_data, const RepoMetadata& metadata)
+        : m_pool(pool)
+        , m_metadata(metadata)
     {
         auto [repo_id, repo] = pool.pool().add_repo("installed");
         m_repo = repo.raw();
+        if (!m_metadata.url.empty())
+        {
+            repo.set_url(m_metadata.url);
+        }
+        add_prefix_records(prefix_data);
+        repo.internalize();
+        pool.pool().set_installed_repo(repo_id);
+    }
 
-        for (auto& [name, record] : prefix_data.records())
+    void MRepo::add_prefix_records(const PrefixData& prefix_data)
+    {
+        auto infos = std::vector<const PackageInfo*>();
+        infos.reserve(prefix_data.records().size());
+        for (const auto& [name, record] : prefix_data.records())
         {
-            add_package_info(record);
+            infos.push_back(&record);
         }
+        add_package_infos(infos);
 
         if (Context::instance().add_pip_as_python_dependency)
         {
             add_pip_as_python_dependency();
         }
-
-        repo.internalize();
-        pool.pool().set_installed_repo(repo_id);
     }
 
-    void MRepo::set_solvables_url(const std::string& repo_url)
+    namespace
     {
-        // WARNING cannot call ``url()`` at this point because it has not been internalized.
-        // Setting the channel url on where the solvable so that we can retrace
-        // where it came from
-        srepo(*this).for_each_solvable(
-            [&](solv::ObjSolvableView s)
+        /** The ``repodata_as_of`` cutoff in seconds, or zero if not set. */
+        auto as_of_timestamp(const Context& ctx) -> std::size_t
+        {
+            if (ctx.repodata_as_of.empty())
+            {
+                return 0;
+            }
+            const auto as_of = parse_utc_timestamp(ctx.repodata_as_of);
+            return static_cast<std::size_t>(std::max<std::time_t>(as_of, 0));
+        }
+
+        /** Remove the solvables matching @p pred, returning how many were removed. */
+        template <typename UnaryPred>
+        auto remove_solvables_if(solv::ObjRepoView repo, UnaryPred&& pred) -> std::size_t
+        {
+            auto removed = std::vector<solv::SolvableId>();
+            repo.for_each_solvable(
+                [&](solv::ObjSolvableView s)
+                {
+                    if (pred(s))
+                    {
+                        removed.push_back(s.id());
+                    }
+                }
+            );
+            for (const auto id : removed)
+            {
+                repo.remove_solvable(id, /* reuse_id= */ true);
+            }
+            return removed.size();
+        }
+
+        /**
+         * The records left out of the repodata indexes by the context.
+         *
+         * Names and track features are compared as pool string ids, so that most solvables
+         * are checked without reading any string.
+         */
+        class record_filter
+        {
+        public:
+
+            record_filter(MPool& pool, const Context& ctx)
             {
-                // The solvable url, this is not set in libsolv parsing so we set it manually
-                // while we still rely on libsolv for parsing
-                s.set_url(fmt::format("{}/{}", repo_url, s.file_name()));
-                // The name of the channel where it came from, may be different from repo name
-                // for instance with the installed repo
-                s.set_channel(repo_url);
+                for (const auto& str : ctx.repodata_exclude)
+                {
+                    const auto ms = MatchSpec(str, pool.channel_context());
+                    // A name that is not in the pool cannot match any record
+                    if (const auto name_id = pool.pool().find_string(ms.name))
+                    {
+                        // As parsed by libsolv conda match specs, empty matching any record
+                        auto version = ms.version;
+                        if (!ms.build_string.empty())
+                        {
+                            version = (version.empty() ? "*" : version) + " " + ms.build_string;
+                        }
+                        m_versions[*name_id].push_back(std::move(version));
+                    }
+                }
+                m_max_timestamp = as_of_timestamp(ctx);
+                m_licenses.insert(
+                    ctx.repodata_exclude_licenses.cbegin(),
+                    ctx.repodata_exclude_licenses.cend()
+                );
+                for (const auto& feature : ctx.repodata_exclude_track_features)
+                {
+                    if (const auto feature_id = pool.pool().find_string(feature))
+                    {
+                        m_track_features.insert(*feature_id);
+                    }
+                }
+            }
+
+            static auto enabled(const Context& ctx) -> bool
+            {
+                return !ctx.repodata_exclude.empty() || !ctx.repodata_as_of.empty()
+                       || !ctx.repodata_exclude_licenses.empty()
+                       || !ctx.repodata_exclude_track_features.empty();
+            }
+
+            auto excludes(solv::ObjSolvableView s) const -> bool
+            {
+                // Records without a timestamp are kept, as they predate timestamps
+                if ((m_max_timestamp > 0) && (s.timestamp() > m_max_timestamp))
+                {
+                    return true;
+                }
+                if (const auto it = m_versions.find(s.raw()->name); it != m_versions.end())
+                {
+                    for (const auto& version : it->second)
+                    {
+                        if (version.empty()
+                            || solvable_conda_matchversion(s.raw(), version.c_str()))
+                        {
+                            return true;
+                        }
+                    }
+                }
+                if (!m_licenses.empty() && (m_licenses.find(s.license()) != m_licenses.end()))
+                {
+                    return true;
+                }
+                if (!m_track_features.empty())
+                {
+                    for (const auto feature_id : s.track_features())
+                    {
+                        if (m_track_features.count(feature_id) > 0)
+                        {
+                            return true;
+                        }
+                    }
+                }
+                return false;
             }
+
+        private:
+
+            std::unordered_map<solv::StringId, std::vector<std::string>> m_versions = {};
+            std::set<std::string, std::less<>> m_licenses = {};
+            std::unordered_set<solv::StringId> m_track_features = {};
+            std::size_t m_max_timestamp = 0;
+        };
+    }
+
+    void MRepo::exclude_records()
+    {
+        const auto& ctx = Context::instance();
+        if (!record_filter::enabled(ctx))
+        {
+            return;
+        }
+
+        // Applied once the solv cache is written, so that it does not depend on the filter
+        const auto filter = record_filter(m_pool, ctx);
+        const auto excluded = remove_solvables_if(
+            srepo(*this),
+            [&](solv::ObjSolvableView s) { return filter.excludes(s); }
+        );
+        LOG_INFO << "Excluded " << excluded << " package records from repo " << name();
+    }
+
+    auto MRepo::keep_names(const std::unordered_set<std::string>& names) -> std::size_t
+    {
+        const auto removed = remove_solvables_if(
+            srepo(*this),
+            [&](solv::ObjSolvableView s) { return names.count(std::string(s.name())) == 0; }
         );
+        srepo(*this).internalize();
+        return removed;
     }
 
     void MRepo::set_installed()
@@ -159,51 +485,72 @@ namespace mamba
         m_repo->subpriority = subpriority;
     }
 
-    void MRepo::add_package_info(const PackageInfo& info)
+    namespace
     {
-        LOG_INFO << "Adding package record to repo " << info.name;
-
-        auto [id, solv] = srepo(*this).add_solvable();
-
-        solv.set_name(info.name);
-        solv.set_version(info.version);
-        solv.set_build_string(info.build_string);
-        solv.set_noarch(info.noarch);
-        solv.set_build_number(info.build_number);
-        solv.set_channel(info.channel);
-        solv.set_url(info.url);
-        solv.set_subdir(info.subdir);
-        solv.set_file_name(info.fn);
-        solv.set_license(info.license);
-        solv.set_size(info.size);
         // TODO conda timestamp are not Unix timestamp.
         // Libsolv normalize them this way, we need to do the same here otherwise the current
         // package may get arbitrary priority.
-        solv.set_timestamp(
-            (info.timestamp > 253402300799ULL) ? (info.timestamp / 1000) : info.timestamp
-        );
-        solv.set_md5(info.md5);
-        solv.set_sha256(info.sha256);
-
-        for (const auto& dep : info.depends)
+        auto normalize_timestamp(std::size_t timestamp) -> std::size_t
         {
-            // TODO pool's matchspec2id
-            solv::DependencyId const dep_id = pool_conda_matchspec(m_pool, dep.c_str());
-            assert(dep_id);
-            solv.add_dependency(dep_id);
+            return (timestamp > 253402300799ULL) ? (timestamp / 1000) : timestamp;
         }
+    }
 
-        for (const auto& cons : info.constrains)
+    namespace
+    {
+        void set_solvable(MPool& pool, solv::ObjSolvableView solv, const PackageInfo& info)
         {
-            // TODO pool's matchspec2id
-            solv::DependencyId const dep_id = pool_conda_matchspec(m_pool, cons.c_str());
-            assert(dep_id);
-            solv.add_constraint(dep_id);
+            solv.set_name(info.name);
+            solv.set_version(info.version);
+            solv.set_build_string(info.build_string);
+            solv.set_noarch(info.noarch);
+            solv.set_build_number(info.build_number);
+            solv.set_channel(info.channel);
+            solv.set_url(info.url);
+            solv.set_subdir(info.subdir);
+            solv.set_file_name(info.fn);
+            solv.set_license(info.license);
+            solv.set_size(info.size);
+            solv.set_timestamp(normalize_timestamp(info.timestamp));
+            solv.set_md5(info.md5);
+            solv.set_sha256(info.sha256);
+
+            for (const auto& dep : info.depends)
+            {
+                solv::DependencyId const dep_id = pool.conda_dependency_id(dep);
+                assert(dep_id);
+                solv.add_dependency(dep_id);
+            }
+
+            for (const auto& cons : info.constrains)
+            {
+                solv::DependencyId const dep_id = pool.conda_dependency_id(cons);
+                assert(dep_id);
+                solv.add_constraint(dep_id);
+            }
+
+            solv.add_track_features(info.track_features);
+
+            solv.add_self_provide();
         }
+    }
 
-        solv.add_track_features(info.track_features);
+    void MRepo::add_package_infos(const std::vector<const PackageInfo*>& infos)
+    {
+        LOG_INFO << "Adding " << infos.size() << " package records to repo " << name();
 
-        solv.add_self_provide();
+        if (infos.empty())
+        {
+            return;
+        }
+        auto repo = srepo(*this);
+        const auto first_id = repo.add_solvables(infos.size());
+        for (std::size_t i = 0; i < infos.size(); ++i)
+        {
+            // Safe because the solvables were just added
+            auto solv = repo.get_solvable(first_id + static_cast<solv::SolvableId>(i)).value();
+            set_solvable(m_pool, solv, *infos[i]);
+        }
     }
 
     auto MRepo::name() const -> std::string_view
@@ -221,20 +568,629 @@ namespace mamba
         return m_repo;
     }
 
+    namespace
+    {
+        void add_pip_dependency(
+            solv::ObjSolvableView s,
+            solv::DependencyId python_id,
+            solv::DependencyId pip_id
+        )
+        {
+            if ((s.name() == "python") && !s.version().empty() && (s.version()[0] >= '2'))
+            {
+                s.add_dependency(pip_id);
+            }
+            if (s.name() == "pip")
+            {
+                s.add_dependency(python_id, SOLVABLE_PREREQMARKER);
+            }
+        }
+    }
+
     void MRepo::add_pip_as_python_dependency()
     {
         solv::DependencyId const python_id = pool_conda_matchspec(m_pool, "python");
         solv::DependencyId const pip_id = pool_conda_matchspec(m_pool, "pip");
-        srepo(*this).for_each_solvable(
+        srepo(*this).for_each_solvable([&](solv::ObjSolvableView s)
+                                       { add_pip_dependency(s, python_id, pip_id); });
+    }
+
+    namespace
+    {
+        /**
+         * SAX handler calling back on every package record of a repodata.json.
+         *
+         * Only the record currently being parsed is held in memory as a JSON object, everything
+         * outside of the ``packages`` and ``packages.conda`` sections is skipped.
+         * The callback is given the package filename and the record.
+         */
+        template <typename OnRecord>
+        class RepoDataRecordSax final : public nlohmann::json_sax<nlohmann::json>
+        {
+        public:
+
+            using json = nlohmann::json;
+
+            explicit RepoDataRecordSax(OnRecord on_record)
+                : m_on_record(std::move(on_record))
+            {
+            }
+
+            bool null() override
+            {
+                return add_value(nullptr);
+            }
+
+            bool boolean(bool val) override
+            {
+                return add_value(val);
+            }
+
+            bool number_integer(number_integer_t val) override
+            {
+                return add_value(val);
+            }
+
+            bool number_unsigned(number_unsigned_t val) override
+            {
+                return add_value(val);
+            }
+
+            bool number_float(number_float_t val, const string_t&) override
+            {
+                return add_value(val);
+            }
+
+            bool string(string_t& val) override
+            {
+                return add_value(std::move(val));
+            }
+
+            bool binary(binary_t& val) override
+            {
+                return add_value(json::binary(std::move(val)));
+            }
+
+            bool start_object(std::size_t) override
+            {
+                ++m_depth;
+                if (m_depth == section_depth)
+                {
+                    m_in_section = (m_section_key == "packages")
+                                   || (m_section_key == "packages.conda");
+                }
+                else if (m_in_section && (m_depth == record_depth))
+                {
+                    m_record = json::object();
+                    m_stack = { &m_record };
+                    return true;
+                }
+                return start_nested(json::object());
+            }
+
+            bool end_object() override
+            {
+                if (!m_stack.empty())
+                {
+                    m_stack.pop_back();
+                    if (m_depth == record_depth)
+                    {
+                        m_on_record(std::string_view(m_filename), std::move(m_record));
+                        m_record = nullptr;
+                    }
+                }
+                if (m_depth == section_depth)
+                {
+                    m_in_section = false;
+                }
+                --m_depth;
+                return true;
+            }
+
+            bool start_array(std::size_t) override
+            {
+                ++m_depth;
+                return start_nested(json::array());
+            }
+
+            bool end_array() override
+            {
+                if (!m_stack.empty())
+                {
+                    m_stack.pop_back();
+                }
+                --m_depth;
+                return true;
+            }
+
+            bool key(string_t& val) override
+            {
+                if (m_depth == section_depth - 1)
+                {
+                    m_section_key = val;
+                }
+                else if (m_in_section && (m_depth == section_depth))
+                {
+                    m_filename = val;
+                }
+                else if (!m_stack.empty())
+                {
+                    m_key = val;
+                }
+                return true;
+            }
+
+            bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& ex)
+                override
+            {
+                m_error = fmt::format("at byte {}: {}", position, ex.what());
+                return false;
+            }
+
+            auto error() const -> const std::string&
+            {
+                return m_error;
+            }
+
+        private:
+
+            static constexpr std::size_t section_depth = 2;
+            static constexpr std::size_t record_depth = 3;
+
+            auto add_value_ptr(json&& val) -> json*
+            {
+                json* const parent = m_stack.back();
+                if (parent->is_object())
+                {
+                    auto& ref = (*parent)[m_key];
+                    ref = std::move(val);
+                    return &ref;
+                }
+                parent->push_back(std::move(val));
+                return &parent->back();
+            }
+
+            bool add_value(json&& val)
+            {
+                if (!m_stack.empty())
+                {
+                    add_value_ptr(std::move(val));
+                }
+                return true;
+            }
+
+            bool start_nested(json&& val)
+            {
+                if (!m_stack.empty())
+                {
+                    m_stack.push_back(add_value_ptr(std::move(val)));
+                }
+                return true;
+            }
+
+            OnRecord m_on_record;
+            json m_record = nullptr;
+            std::vector<json*> m_stack = {};
+            std::string m_section_key = {};
+            std::string m_filename = {};
+            std::string m_key = {};
+            std::string m_error = {};
+            std::size_t m_depth = 0;
+            bool m_in_section = false;
+        };
+
+        auto noarch_str(specs::NoArchType noarch) -> const char*
+        {
+            switch (noarch)
+            {
+                case specs::NoArchType::Python:
+                    return "python";
+                case specs::NoArchType::Generic:
+                    return "generic";
+            }
+            return "";
+        }
+
+        /**
+         * Set the solvable attributes from a repodata record.
+         *
+         * The @p version is the raw version string from the file since ``specs::Version``
+         * parsing is not injective.
+         */
+        void set_solvable(
+            MPool& pool,
+            solv::ObjSolvableView solv,
+            const std::string& filename,
+            const std::string& version,
+            const specs::RepoDataPackage& pkg
+        )
+        {
+            solv.set_name(pkg.name);
+            solv.set_version(version);
+            solv.set_build_string(pkg.build_string);
+            if (pkg.noarch.has_value())
+            {
+                solv.set_noarch(noarch_str(pkg.noarch.value()));
+            }
+            solv.set_build_number(pkg.build_number);
+            solv.set_subdir(pkg.subdir);
+            solv.set_file_name(filename);
+            if (pkg.license.has_value())
+            {
+                solv.set_license(pkg.license.value());
+            }
+            if (pkg.size.has_value())
+            {
+                solv.set_size(pkg.size.value());
+            }
+            if (pkg.timestamp.has_value())
+            {
+                solv.set_timestamp(normalize_timestamp(pkg.timestamp.value()));
+            }
+            if (pkg.md5.has_value())
+            {
+                solv.set_md5(pkg.md5.value());
+            }
+            if (pkg.sha256.has_value())
+            {
+                solv.set_sha256(pkg.sha256.value());
+            }
+
+            for (const auto& dep : pkg.depends)
+            {
+                solv::DependencyId const dep_id = pool.conda_dependency_id(dep);
+                assert(dep_id);
+                solv.add_dependency(dep_id);
+            }
+
+            for (const auto& cons : pkg.constrains)
+            {
+                solv::DependencyId const dep_id = pool.conda_dependency_id(cons);
+                assert(dep_id);
+                solv.add_constraint(dep_id);
+            }
+
+            // Like libsolv, track features may be given as a single comma or space separated
+            // string.
+            const auto add_sub_feature = [&solv](std::string_view sub_feat)
+            {
+                if (!sub_feat.empty())
+                {
+                    solv.add_track_feature(sub_feat);
+                }
+            };
+            for (const auto& features : pkg.track_features)
+            {
+                split_for_each(
+                    features,
+                    ",",
+                    [&](std::string_view feat) { split_for_each(strip(feat), " ", add_sub_feature); }
+                );
+            }
+
+            solv.add_self_provide();
+        }
+
+        auto package_stem(std::string_view filename) -> std::string_view
+        {
+            for (std::string_view ext : { ".conda", ".tar.bz2" })
+            {
+                if (ends_with(filename, ext))
+                {
+                    return filename.substr(0, filename.size() - ext.size());
+                }
+            }
+            return filename;
+        }
+
+        /**
+         * Parse a package record into its raw version string and package.
+         *
+         * Invalid records are skipped with a warning.
+         */
+        auto
+        parse_record(std::string_view fn, const nlohmann::json& record, std::string_view repo_name)
+            -> std::optional<std::pair<std::string, specs::RepoDataPackage>>
+        {
+            try
+            {
+                return { { record.at("version").get<std::string>(),
+                           record.get<specs::RepoDataPackage>() } };
+            }
+            catch (const std::exception& e)
+            {
+                LOG_WARNING << "Skipping invalid record '" << fn << "' in repo " << repo_name
+                            << ": " << e.what();
+                return std::nullopt;
+            }
+        }
+
+        /**
+         * Call @p on_record on every valid record of a repodata.json file.
+         *
+         * The callback is given the package filename, the raw version string, and the parsed
+         * record. Invalid records are skipped with a warning.
+         */
+        template <typename OnRecord>
+        void for_each_repodata_record(
+            const fs::u8path& filename,
+            bool only_tar_bz2,
+            std::string_view repo_name,
+            OnRecord&& on_record
+        )
+        {
+            auto on_json_record = [&](std::string_view fn, nlohmann::json&& record)
+            {
+                // Large files take seconds to parse
+                interruption_point();
+                if (only_tar_bz2 && ends_with(fn, ".conda"))
+                {
+                    return;
+                }
+
+                if (auto parsed = parse_record(fn, record, repo_name))
+                {
+                    on_record(fn, std::move(parsed->first), std::move(parsed->second));
+                }
+            };
+
+            if (fast_json::for_each_repodata_record(filename, on_json_record))
+            {
+                return;
+            }
+
+            auto file = open_ifstream(filename);
+            auto sax = RepoDataRecordSax<decltype(on_json_record)>(std::move(on_json_record));
+            if (!nlohmann::json::sax_parse(file, &sax))
+            {
+                throw std::runtime_error(fmt::format(
+                    "Unable to read repodata JSON file '{}' for repo '{}': {}",
+                    filename.string(),
+                    repo_name,
+                    sax.error()
+                ));
+            }
+        }
+    }
+
+    auto RepoDataRecords::read(const fs::u8path& filename, bool only_tar_bz2) -> RepoDataRecords
+    {
+        LOG_INFO << "Reading repodata.json file " << filename << " records";
+
+        auto lock = LockFile(filename);
+        auto out = RepoDataRecords{ filename, {} };
+
+        // Like libsolv, ``.conda`` artifacts are preferred over their ``.tar.bz2`` counterpart
+        // regardless of the order in which they appear in the file.
+        auto stem_indices = std::unordered_map<std::string, std::size_t>();
+        for_each_repodata_record(
+            filename,
+            only_tar_bz2,
+            filename.string(),
+            [&](std::string_view fn, std::string&& version, specs::RepoDataPackage&& pkg)
+            {
+                auto record = Record{ std::string(fn), std::move(version), std::move(pkg) };
+                auto [it, inserted] = stem_indices.emplace(package_stem(fn), out.records.size());
+                if (inserted)
+                {
+                    out.records.push_back(std::move(record));
+                }
+                else if (ends_with(fn, ".conda"))
+                {
+                    out.records[it->second] = std::move(record);
+                }
+            }
+        );
+        return out;
+    }
+
+    auto RepoDataRecords::read_all(const fs::u8path& filename) -> RepoDataRecords
+    {
+        auto lock = LockFile(filename);
+        auto out = RepoDataRecords{ filename, {} };
+        for_each_repodata_record(
+            filename,
+            false,
+            filename.string(),
+            [&](std::string_view fn, std::string&& version, specs::RepoDataPackage&& pkg)
+            { out.records.push_back({ std::string(fn), std::move(version), std::move(pkg) }); }
+        );
+        return out;
+    }
+
+    namespace
+    {
+        /**
+         * The filename of the package record changed by a JSON Patch operation path.
+         *
+         * @return An empty string if the path is outside of the package sections, and nothing
+         *         if it changes a package section as a whole.
+         */
+        auto patched_record_filename(const std::string& path) -> std::optional<std::string>
+        {
+            auto record = nlohmann::json::json_pointer(path);
+            if (record.empty())
+            {
+                return std::nullopt;
+            }
+            while (!record.parent_pointer().parent_pointer().empty())
+            {
+                record = record.parent_pointer();
+            }
+
+            const bool is_section = record.parent_pointer().empty();
+            const auto section = is_section ? record.back() : record.parent_pointer().back();
+            if ((section != "packages") && (section != "packages.conda"))
+            {
+                return { std::string() };
+            }
+            if (is_section || (package_stem(record.back()).size() == record.back().size()))
+            {
+                return std::nullopt;
+            }
+            return { record.back() };
+        }
+    }
+
+    auto RepoDataRecordsUpdate::from_patch(
+        const fs::u8path& filename,
+        const nlohmann::json& repodata,
+        const nlohmann::json& patch,
+        bool only_tar_bz2
+    ) -> std::optional<RepoDataRecordsUpdate>
+    {
+        auto stems = std::set<std::string>();
+        try
+        {
+            for (const auto& op : patch)
+            {
+                for (const char* key : { "path", "from" })
+                {
+                    if (!op.contains(key))
+                    {
+                        continue;
+                    }
+                    const auto fn = patched_record_filename(op.at(key).get<std::string>());
+                    if (!fn.has_value())
+                    {
+                        return std::nullopt;
+                    }
+                    if (!fn->empty())
+                    {
+                        stems.emplace(package_stem(fn.value()));
+                    }
+                }
+            }
+        }
+        catch (const nlohmann::json::exception& e)
+        {
+            LOG_DEBUG << "Cannot compute records update from patch: " << e.what();
+            return std::nullopt;
+        }
+
+        auto out = RepoDataRecordsUpdate{ { stems.cbegin(), stems.cend() }, { filename, {} } };
+        const auto empty_section = nlohmann::json::object();
+        const auto section = [&](const char* name) -> const nlohmann::json&
+        {
+            const auto it = repodata.find(name);
+            return ((it != repodata.end()) && it->is_object()) ? *it : empty_section;
+        };
+        const auto& tar_bz2_records = section("packages");
+        const auto& conda_records = section("packages.conda");
+
+        for (const auto& stem : out.stems)
+        {
+            // Like libsolv, ``.conda`` artifacts are preferred over their ``.tar.bz2`` counterpart
+            auto fn = stem + ".conda";
+            auto it = only_tar_bz2 ? conda_records.end() : conda_records.find(fn);
+            if (it == conda_records.end())
+            {
+                fn = stem + ".tar.bz2";
+                it = tar_bz2_records.find(fn);
+                if (it == tar_bz2_records.end())
+                {
+                    continue;
+                }
+            }
+            if (auto parsed = parse_record(fn, *it, filename.string()))
+            {
+                out.records.records.push_back(
+                    { std::move(fn), std::move(parsed->first), std::move(parsed->second) }
+                );
+            }
+        }
+        return { std::move(out) };
+    }
+
+    void MRepo::add_repodata_records(const RepoDataRecords& records)
+    {
+        LOG_INFO << "Adding " << records.records.size() << " package records to repo " << name();
+
+        auto repo = srepo(*this);
+        for (const auto& record : records.records)
+        {
+            auto [id, solv] = repo.add_solvable();
+            set_solvable(m_pool, solv, record.filename, record.version, record.package);
+        }
+    }
+
+    void MRepo::update_repodata_records(const RepoDataRecordsUpdate& update)
+    {
+        LOG_INFO << "Updating " << update.stems.size() << " package records in repo " << name();
+
+        auto repo = srepo(*this);
+
+        const auto stems = std::unordered_set<std::string_view>(
+            update.stems.cbegin(),
+            update.stems.cend()
+        );
+        auto removed = std::vector<solv::SolvableId>();
+        repo.for_each_solvable(
             [&](solv::ObjSolvableView s)
             {
-                if ((s.name() == "python") && !s.version().empty() && (s.version()[0] >= '2'))
+                if (stems.count(package_stem(s.file_name())) > 0)
                 {
-                    s.add_dependency(pip_id);
+                    removed.push_back(s.id());
                 }
-                if (s.name() == "pip")
+            }
+        );
+        for (const auto id : removed)
+        {
+            repo.remove_solvable(id, /* reuse_id= */ true);
+        }
+
+        const bool add_pip = Context::instance().add_pip_as_python_dependency;
+        const auto python_id = add_pip ? pool_conda_matchspec(m_pool, "python") : 0;
+        const auto pip_id = add_pip ? pool_conda_matchspec(m_pool, "pip") : 0;
+        for (const auto& record : update.records.records)
+        {
+            auto [id, solv] = repo.add_solvable();
+            set_solvable(m_pool, solv, record.filename, record.version, record.package);
+            if (add_pip)
+            {
+                add_pip_dependency(solv, python_id, pip_id);
+            }
+        }
+    }
+
+    void MRepo::read_json_stream(const fs::u8path& filename)
+    {
+        LOG_INFO << "Streaming repodata.json file " << filename << " for repo " << name();
+
+        auto repo = srepo(*this);
+
+        // Like libsolv, ``.conda`` artifacts are preferred over their ``.tar.bz2`` counterpart
+        // regardless of the order in which they appear in the file.
+        auto tar_bz2_ids = std::unordered_map<std::string, solv::SolvableId>();
+        auto conda_stems = std::unordered_set<std::string>();
+
+        for_each_repodata_record(
+            filename,
+            Context::instance().use_only_tar_bz2,
+            name(),
+            [&](std::string_view fn, std::string&& version, specs::RepoDataPackage&& pkg)
+            {
+                const bool is_conda = ends_with(fn, ".conda");
+                auto stem = std::string(package_stem(fn));
+                if (is_conda)
+                {
+                    if (auto it = tar_bz2_ids.find(stem); it != tar_bz2_ids.end())
+                    {
+                        repo.remove_solvable(it->second, /* reuse_id= */ true);
+                        tar_bz2_ids.erase(it);
+                    }
+                    conda_stems.insert(std::move(stem));
+                }
+                else if (conda_stems.count(stem) > 0)
                 {
-                    s.add_dependency(python_id, SOLVABLE_PREREQMARKER);
+                    return;
+                }
+
+                auto [id, solv] = repo.add_solvable();
+                set_solvable(m_pool, solv, std::string(fn), version, pkg);
+                if (!is_conda)
+                {
+                    tar_bz2_ids.emplace(std::move(stem), id);
                 }
             }
         );
@@ -242,12 +1198,40 @@ namespace mamba
 
     void MRepo::read_json(const fs::u8path& filename)
     {
+        if (Context::instance().experimental_repodata_parsing)
+        {
+            return read_json_stream(filename);
+        }
+
         LOG_INFO << "Reading repodata.json file " << filename << " for repo " << name();
         // TODO make this as part of options of the repo/pool
         const int flags = Context::instance().use_only_tar_bz2 ? CONDA_ADD_USE_ONLY_TAR_BZ2 : 0;
         srepo(*this).legacy_read_conda_repodata(filename, flags);
     }
 
+    void MRepo::read_index(const fs::u8path& filename)
+    {
+        auto index = RepoDataIndex::open(filename);
+        if (!index)
+        {
+            throw std::runtime_error(index.error().what());
+        }
+        add_repodata_records(index->read_records(Context::instance().use_only_tar_bz2));
+    }
+
+    namespace
+    {
+        /**
+         * Cheap check of the solv magic number, before handing the file to libsolv.
+         *
+         * The version is checked by libsolv and the metadata after reading.
+         */
+        auto has_solv_header(std::string_view data) -> bool
+        {
+            return (data.size() >= 8) && (data.substr(0, 4) == "SOLV");
+        }
+    }
+
     bool MRepo::read_solv(const fs::u8path& filename)
     {
         LOG_INFO << "Attempting to read libsolv solv file " << filename << " for repo " << name();
@@ -255,7 +1239,20 @@ namespace mamba
         auto repo = srepo(*this);
 
         auto lock = LockFile(filename);
-        repo.read(filename);
+        if (auto mapped = MappedFile::open(filename))
+        {
+            if (!has_solv_header(mapped->data()))
+            {
+                LOG_INFO << "Invalid solv file header, canceling solv file load";
+                return false;
+            }
+            repo.read_buffer(mapped->data());
+        }
+        else
+        {
+            LOG_DEBUG << "Could not memory-map solv file, reading it instead";
+            repo.read(filename);
+        }
 
         const auto read_metadata = RepoMetadata{
             /* .url= */ std::string(repo.url()),
@@ -299,6 +1296,13 @@ namespace mamba
         if (is_solv)
         {
             json_file.replace_extension("json");
+            // Cached instead of the json, see ``MSubdirData``
+            auto index_file = json_file;
+            index_file.replace_extension("index");
+            if (!fs::exists(json_file) && fs::exists(index_file))
+            {
+                json_file = index_file;
+            }
         }
         else
         {
@@ -308,28 +1312,118 @@ namespace mamba
         LOG_INFO << "Reading cache files '" << (filename.parent_path() / filename).string()
                  << ".*' for repo index '" << name() << "'";
 
-        if (is_solv)
+        // Snapshots of the records as of a date, so that they are not filtered at every load
+        const auto as_of = as_of_timestamp(Context::instance());
+        auto snapshot_file = fs::u8path();
+        if ((as_of > 0) && (name() != "installed"))
         {
-            const auto lock = LockFile(solv_file);
-            const bool read = read_solv(solv_file);
-            if (read)
+            snapshot_file = json_file.parent_path()
+                            / (json_file.stem().string() + ".asof-" + std::to_string(as_of)
+                               + ".solv");
+            const auto lock = LockFile(snapshot_file, LockMode::shared);
+            if (read_solv(snapshot_file))
             {
                 return;
             }
         }
 
-        auto lock = LockFile(json_file);
-        read_json(json_file);
+        bool read = false;
+        if (is_solv)
+        {
+            const auto lock = LockFile(solv_file, LockMode::shared);
+            read = read_solv(solv_file);
+        }
 
-        // TODO move this to a more structured approach for repodata patching?
-        if (Context::instance().add_pip_as_python_dependency)
+        // Repodata read in place from a read-only local channel get no solv file
+        const bool solv_cacheable = (name() != "installed") && path::is_writable(solv_file);
+        if (!read)
         {
-            add_pip_as_python_dependency();
+            // Concurrent processes missing the same solv file build it once: the first one
+            // parses the json under an exclusive lock, the others wait for it and read the
+            // solv file it wrote. A solv file written in the background is only complete after
+            // the lock is released, so waiting would not spare the parsing.
+            const bool build_once = solv_cacheable && !Context::instance().background_solv_write;
+            const auto mode = build_once ? LockMode::exclusive : LockMode::shared;
+            auto lock = LockFile(json_file, mode);
+            if (build_once && fs::exists(solv_file) && read_solv(solv_file))
+            {
+                LOG_INFO << "Solv file " << solv_file << " written by another process";
+            }
+            else
+            {
+                if (RepoDataIndex::is_index_file(json_file))
+                {
+                    read_index(json_file);
+                }
+                else
+                {
+                    read_json(json_file);
+                }
+
+                // TODO move this to a more structured approach for repodata patching?
+                if (Context::instance().add_pip_as_python_dependency)
+                {
+                    add_pip_as_python_dependency();
+                }
+
+                if (solv_cacheable)
+                {
+                    write_solv(solv_file);
+                }
+            }
         }
 
-        if (name() != "installed")
+        if (!snapshot_file.empty())
         {
-            write_solv(solv_file);
+            const auto removed = remove_solvables_if(
+                repo,
+                [&](solv::ObjSolvableView s) { return s.timestamp() > as_of; }
+            );
+            LOG_INFO << "Removed " << removed << " package records after " << as_of
+                     << " from repo " << name();
+            if (path::is_writable(snapshot_file))
+            {
+                write_solv(snapshot_file);
+            }
+        }
+    }
+
+    namespace
+    {
+        /**
+         * Atomically replace a file with a complete temporary file from the same directory.
+         *
+         * Processes reading (or mapping) the previous file keep seeing it unchanged.
+         */
+        void replace_file(const fs::u8path& tmp_file, const fs::u8path& filename)
+        {
+            std::error_code ec;
+            fs::rename(tmp_file, filename, ec);
+            if (ec)
+            {
+                throw std::runtime_error(fmt::format(
+                    "Could not move file from {} to {}: {}",
+                    tmp_file.string(),
+                    filename.string(),
+                    ec.message()
+                ));
+            }
+        }
+
+        void write_solv_data(const fs::u8path& filename, const std::string& data)
+        {
+            auto tmp_file = TemporaryFile("mambaf", ".solv", filename.parent_path());
+            {
+                auto out = open_ofstream(tmp_file.path(), std::ios::out | std::ios::binary);
+                out.write(data.data(), static_cast<std::streamsize>(data.size()));
+                if (!out.flush())
+                {
+                    throw std::runtime_error(
+                        "Could not write solv file " + tmp_file.path().string()
+                    );
+                }
+            }
+            replace_file(tmp_file.path(), filename);
         }
     }
 
@@ -345,7 +1439,32 @@ namespace mamba
         repo.set_tool_version(MAMBA_SOLV_VERSION);
         repo.internalize();
 
-        repo.write(filename);
+        if (Context::instance().background_solv_write)
+        {
+            // Serializing needs the pool, which is not thread safe, but writing to disk does not
+            auto data = repo.write_buffer();
+            ThreadPool::instance().submit(
+                [filename = std::move(filename), data = std::move(data)]()
+                {
+                    try
+                    {
+                        write_solv_data(filename, data);
+                        LOG_INFO << "Written libsolv solv file " << filename << " in background";
+                    }
+                    catch (const std::exception& e)
+                    {
+                        LOG_WARNING << "Could not write solv file " << filename << ": " << e.what();
+                    }
+                },
+                TaskPriority::low
+            );
+            return;
+        }
+
+        // Readers may have the file mapped, it is replaced rather than truncated
+        auto tmp_file = TemporaryFile("mambaf", ".solv", filename.parent_path());
+        repo.write(tmp_file.path());
+        replace_file(tmp_file.path(), filename);
     }
 
     void MRepo::clear(bool reuse_ids)
@@ -0,0 +1,510 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <array>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "mamba/core/output.hpp"
+#include "mamba/core/thread_utils.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/util_string.hpp"
+
+#include "repodata_index.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        constexpr std::string_view magic = "MAMBARDX";
+        constexpr std::size_t header_size = 64;
+        constexpr std::size_t record_size_v1 = 168;
+        constexpr std::size_t ref_size = 8;
+
+        // Fields of a record
+        constexpr std::size_t flags_offset = 0;
+        constexpr std::size_t numbers_offset = 8;
+        constexpr std::size_t strings_offset = 40;
+        constexpr std::size_t lists_offset = 144;
+
+        namespace number_field
+        {
+            constexpr std::size_t build_number = 0;
+            constexpr std::size_t size = 1;
+            constexpr std::size_t legacy_bz2_size = 2;
+            constexpr std::size_t timestamp = 3;
+        }
+
+        namespace string_field
+        {
+            constexpr std::size_t filename = 0;
+            constexpr std::size_t name = 1;
+            constexpr std::size_t version = 2;
+            constexpr std::size_t build = 3;
+            constexpr std::size_t subdir = 4;
+            constexpr std::size_t md5 = 5;
+            constexpr std::size_t sha256 = 6;
+            constexpr std::size_t legacy_bz2_md5 = 7;
+            constexpr std::size_t arch = 8;
+            constexpr std::size_t platform = 9;
+            constexpr std::size_t features = 10;
+            constexpr std::size_t license = 11;
+            constexpr std::size_t license_family = 12;
+        }
+
+        namespace list_field
+        {
+            constexpr std::size_t depends = 0;
+            constexpr std::size_t constrains = 1;
+            constexpr std::size_t track_features = 2;
+        }
+
+        // Which optional fields are set
+        namespace flag
+        {
+            constexpr std::uint32_t md5 = 1u << 0;
+            constexpr std::uint32_t sha256 = 1u << 1;
+            constexpr std::uint32_t legacy_bz2_md5 = 1u << 2;
+            constexpr std::uint32_t legacy_bz2_size = 1u << 3;
+            constexpr std::uint32_t size = 1u << 4;
+            constexpr std::uint32_t arch = 1u << 5;
+            constexpr std::uint32_t platform = 1u << 6;
+            constexpr std::uint32_t features = 1u << 7;
+            constexpr std::uint32_t license = 1u << 8;
+            constexpr std::uint32_t license_family = 1u << 9;
+            constexpr std::uint32_t timestamp = 1u << 10;
+            constexpr std::uint32_t noarch_generic = 1u << 16;
+            constexpr std::uint32_t noarch_python = 1u << 17;
+        }
+
+        void put_u32(std::string& out, std::size_t pos, std::uint32_t value)
+        {
+            for (std::size_t i = 0; i < 4; ++i)
+            {
+                out[pos + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+            }
+        }
+
+        void put_u64(std::string& out, std::size_t pos, std::uint64_t value)
+        {
+            for (std::size_t i = 0; i < 8; ++i)
+            {
+                out[pos + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+            }
+        }
+
+        auto get_u32(std::string_view data, std::size_t pos) -> std::uint32_t
+        {
+            std::uint32_t value = 0;
+            for (std::size_t i = 0; i < 4; ++i)
+            {
+                value |= std::uint32_t(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+            }
+            return value;
+        }
+
+        auto get_u64(std::string_view data, std::size_t pos) -> std::uint64_t
+        {
+            std::uint64_t value = 0;
+            for (std::size_t i = 0; i < 8; ++i)
+            {
+                value |= std::uint64_t(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+            }
+            return value;
+        }
+
+        auto to_u32(std::size_t value) -> std::uint32_t
+        {
+            if (value > std::numeric_limits<std::uint32_t>::max())
+            {
+                throw std::length_error("Repodata too large for a repodata index");
+            }
+            return static_cast<std::uint32_t>(value);
+        }
+
+        /** The strings of an index being written, each stored once. */
+        class StringTable
+        {
+        public:
+
+            auto add(const std::string& str) -> std::pair<std::uint32_t, std::uint32_t>
+            {
+                auto [it, inserted] = m_offsets.try_emplace(str, m_data.size());
+                if (inserted)
+                {
+                    m_data += str;
+                }
+                return { to_u32(it->second), to_u32(str.size()) };
+            }
+
+            auto data() const -> const std::string&
+            {
+                return m_data;
+            }
+
+        private:
+
+            std::unordered_map<std::string, std::size_t> m_offsets = {};
+            std::string m_data = {};
+        };
+
+        auto package_stem(std::string_view fn) -> std::string_view
+        {
+            for (std::string_view ext : { ".conda", ".tar.bz2" })
+            {
+                if (ends_with(fn, ext))
+                {
+                    return fn.substr(0, fn.size() - ext.size());
+                }
+            }
+            return fn;
+        }
+
+        /** Sections fitting in the file, without overflowing. */
+        auto
+        fits(std::size_t file_size, std::uint64_t offset, std::uint64_t count, std::size_t item)
+            -> bool
+        {
+            return (offset <= file_size) && (count <= (file_size - offset) / item);
+        }
+    }
+
+    auto RepoDataIndex::is_index_file(const fs::u8path& file) -> bool
+    {
+        auto buffer = std::array<char, magic.size()>();
+        std::ifstream in(file.std_path(), std::ios::in | std::ios::binary);
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        return in && (std::string_view(buffer.data(), buffer.size()) == magic);
+    }
+
+    void RepoDataIndex::write(const RepoDataRecords& records, const fs::u8path& file)
+    {
+        auto strings = StringTable();
+        auto lists = std::string();
+        auto record_data = std::string(records.records.size() * record_size_v1, '\0');
+
+        const auto add_string = [&](std::size_t pos, const std::string& str)
+        {
+            const auto [offset, size] = strings.add(str);
+            put_u32(record_data, pos, offset);
+            put_u32(record_data, pos + 4, size);
+        };
+        const auto add_list = [&](std::size_t pos, const std::vector<std::string>& items)
+        {
+            put_u32(record_data, pos, to_u32(lists.size() / ref_size));
+            put_u32(record_data, pos + 4, to_u32(items.size()));
+            for (const auto& item : items)
+            {
+                const auto [offset, size] = strings.add(item);
+                lists.append(ref_size, '\0');
+                put_u32(lists, lists.size() - ref_size, offset);
+                put_u32(lists, lists.size() - 4, size);
+            }
+        };
+
+        for (std::size_t i = 0; i < records.records.size(); ++i)
+        {
+            const auto& record = records.records[i];
+            const auto& pkg = record.package;
+            const std::size_t pos = i * record_size_v1;
+            std::uint32_t flags = 0;
+            const auto add_optional =
+                [&](std::size_t field, const std::optional<std::string>& value, std::uint32_t bit)
+            {
+                if (value.has_value())
+                {
+                    flags |= bit;
+                    add_string(pos + strings_offset + field * ref_size, *value);
+                }
+            };
+            const auto add_number = [&](std::size_t field, std::size_t value)
+            { put_u64(record_data, pos + numbers_offset + field * 8, value); };
+
+            add_string(pos + strings_offset + string_field::filename * ref_size, record.filename);
+            add_string(pos + strings_offset + string_field::name * ref_size, pkg.name);
+            add_string(pos + strings_offset + string_field::version * ref_size, record.version);
+            add_string(pos + strings_offset + string_field::build * ref_size, pkg.build_string);
+            add_string(pos + strings_offset + string_field::subdir * ref_size, pkg.subdir);
+            add_optional(string_field::md5, pkg.md5, flag::md5);
+            add_optional(string_field::sha256, pkg.sha256, flag::sha256);
+            add_optional(string_field::legacy_bz2_md5, pkg.legacy_bz2_md5, flag::legacy_bz2_md5);
+            add_optional(string_field::arch, pkg.arch, flag::arch);
+            add_optional(string_field::platform, pkg.platform, flag::platform);
+            add_optional(string_field::features, pkg.features, flag::features);
+            add_optional(string_field::license, pkg.license, flag::license);
+            add_optional(string_field::license_family, pkg.license_family, flag::license_family);
+
+            add_number(number_field::build_number, pkg.build_number);
+            if (pkg.size.has_value())
+            {
+                flags |= flag::size;
+                add_number(number_field::size, *pkg.size);
+            }
+            if (pkg.legacy_bz2_size.has_value())
+            {
+                flags |= flag::legacy_bz2_size;
+                add_number(number_field::legacy_bz2_size, *pkg.legacy_bz2_size);
+            }
+            if (pkg.timestamp.has_value())
+            {
+                flags |= flag::timestamp;
+                add_number(number_field::timestamp, *pkg.timestamp);
+            }
+            if (pkg.noarch.has_value())
+            {
+                flags |= (*pkg.noarch == specs::NoArchType::Python) ? flag::noarch_python
+                                                                     : flag::noarch_generic;
+            }
+            put_u32(record_data, pos + flags_offset, flags);
+
+            add_list(pos + lists_offset + list_field::depends * ref_size, pkg.depends);
+            add_list(pos + lists_offset + list_field::constrains * ref_size, pkg.constrains);
+            add_list(
+                pos + lists_offset + list_field::track_features * ref_size,
+                pkg.track_features
+            );
+        }
+
+        auto header = std::string(header_size, '\0');
+        header.replace(0, magic.size(), magic);
+        put_u32(header, 8, format_version);
+        put_u32(header, 12, static_cast<std::uint32_t>(record_size_v1));
+        put_u64(header, 16, records.records.size());
+        put_u64(header, 24, header_size);
+        put_u64(header, 32, header_size + record_data.size());
+        put_u64(header, 40, lists.size() / ref_size);
+        put_u64(header, 48, header_size + record_data.size() + lists.size());
+        put_u64(header, 56, strings.data().size());
+
+        // Readers, which map the file, see either the previous or the new index
+        auto tmp_file = TemporaryFile("mambaf", ".tmp", file.parent_path());
+        {
+            auto out = open_ofstream(tmp_file.path(), std::ios::out | std::ios::binary);
+            const auto sections = std::array<const std::string*, 4>{
+                &header,
+                &record_data,
+                &lists,
+                &strings.data(),
+            };
+            for (const auto* section : sections)
+            {
+                out.write(section->data(), static_cast<std::streamsize>(section->size()));
+            }
+            if (!out.flush())
+            {
+                throw std::runtime_error("Could not write repodata index " + file.string());
+            }
+        }
+        fs::rename(tmp_file.path(), file);
+    }
+
+    auto RepoDataIndex::open(const fs::u8path& file) -> expected_t<RepoDataIndex>
+    {
+        auto mapped = MappedFile::open(file);
+        if (!mapped.has_value())
+        {
+            return make_unexpected(
+                fmt::format("Could not map repodata index '{}'", file.string()),
+                mamba_error_code::repodata_not_loaded
+            );
+        }
+        const auto data = mapped->data();
+        const auto invalid = [&](std::string_view reason)
+        {
+            return make_unexpected(
+                fmt::format("Invalid repodata index '{}': {}", file.string(), reason),
+                mamba_error_code::repodata_not_loaded
+            );
+        };
+        if ((data.size() < header_size) || (data.substr(0, magic.size()) != magic))
+        {
+            return invalid("not a repodata index");
+        }
+        if (get_u32(data, 8) != format_version)
+        {
+            return invalid(fmt::format("unsupported format version {}", get_u32(data, 8)));
+        }
+
+        auto out = RepoDataIndex(file, std::move(mapped).value());
+        out.m_record_size = get_u32(data, 12);
+        const auto n_records = get_u64(data, 16);
+        const auto records_offset = get_u64(data, 24);
+        const auto lists_offset = get_u64(data, 32);
+        const auto n_list_items = get_u64(data, 40);
+        const auto strings_offset = get_u64(data, 48);
+        const auto strings_size = get_u64(data, 56);
+        if ((out.m_record_size < record_size_v1)
+            || !fits(data.size(), records_offset, n_records, out.m_record_size)
+            || !fits(data.size(), lists_offset, n_list_items, ref_size)
+            || !fits(data.size(), strings_offset, strings_size, 1))
+        {
+            return invalid("sections out of the file");
+        }
+        out.m_n_records = static_cast<std::size_t>(n_records);
+        out.m_records_offset = static_cast<std::size_t>(records_offset);
+        out.m_lists_offset = static_cast<std::size_t>(lists_offset);
+        out.m_n_list_items = static_cast<std::size_t>(n_list_items);
+        out.m_strings_offset = static_cast<std::size_t>(strings_offset);
+        out.m_strings_size = static_cast<std::size_t>(strings_size);
+        return { std::move(out) };
+    }
+
+    RepoDataIndex::RepoDataIndex(fs::u8path file, MappedFile mapped)
+        : m_file(std::move(file))
+        , m_mapped(std::move(mapped))
+    {
+    }
+
+    auto RepoDataIndex::size() const -> std::size_t
+    {
+        return m_n_records;
+    }
+
+    auto RepoDataIndex::read_records(bool only_tar_bz2) const -> RepoDataRecords
+    {
+        LOG_INFO << "Reading repodata index " << m_file << " records";
+
+        const auto data = m_mapped.data();
+        const auto corrupted = [&]()
+        { return std::runtime_error("Corrupted repodata index " + m_file.string()); };
+        const auto get_string = [&](std::size_t pos) -> std::string
+        {
+            const std::size_t offset = get_u32(data, pos);
+            const std::size_t size = get_u32(data, pos + 4);
+            if ((offset > m_strings_size) || (size > m_strings_size - offset))
+            {
+                throw corrupted();
+            }
+            return std::string(data.substr(m_strings_offset + offset, size));
+        };
+        const auto get_list = [&](std::size_t pos) -> std::vector<std::string>
+        {
+            const std::size_t first = get_u32(data, pos);
+            const std::size_t count = get_u32(data, pos + 4);
+            if ((first > m_n_list_items) || (count > m_n_list_items - first))
+            {
+                throw corrupted();
+            }
+            auto items = std::vector<std::string>();
+            items.reserve(count);
+            for (std::size_t i = first; i < first + count; ++i)
+            {
+                items.push_back(get_string(m_lists_offset + i * ref_size));
+            }
+            return items;
+        };
+
+        auto out = RepoDataRecords{ m_file, {} };
+        out.records.reserve(m_n_records);
+        // Like libsolv, ``.conda`` artifacts are preferred over their ``.tar.bz2`` counterpart
+        // regardless of the order in which they appear in the index
+        auto stem_indices = std::unordered_map<std::string, std::size_t>();
+        for (std::size_t i = 0; i < m_n_records; ++i)
+        {
+            // Large indices take a while to read
+            interruption_point();
+            const std::size_t pos = m_records_offset + i * m_record_size;
+            auto fn = get_string(pos + strings_offset + string_field::filename * ref_size);
+            const bool is_conda = ends_with(fn, ".conda");
+            if (only_tar_bz2 && is_conda)
+            {
+                continue;
+            }
+
+            const auto flags = get_u32(data, pos + flags_offset);
+            const auto optional_string = [&](std::size_t field,
+                                             std::uint32_t bit) -> std::optional<std::string>
+            {
+                if ((flags & bit) == 0)
+                {
+                    return std::nullopt;
+                }
+                return get_string(pos + strings_offset + field * ref_size);
+            };
+            const auto optional_number = [&](std::size_t field,
+                                             std::uint32_t bit) -> std::optional<std::size_t>
+            {
+                if ((flags & bit) == 0)
+                {
+                    return std::nullopt;
+                }
+                return static_cast<std::size_t>(get_u64(data, pos + numbers_offset + field * 8));
+            };
+
+            auto record = RepoDataRecords::Record();
+            auto& pkg = record.package;
+            record.version = get_string(pos + strings_offset + string_field::version * ref_size);
+            try
+            {
+                pkg.version = specs::Version::parse(record.version);
+            }
+            catch (const std::exception& e)
+            {
+                LOG_WARNING << "Skipping invalid record '" << fn << "' in repodata index "
+                            << m_file << ": " << e.what();
+                continue;
+            }
+            pkg.name = get_string(pos + strings_offset + string_field::name * ref_size);
+            pkg.build_string = get_string(pos + strings_offset + string_field::build * ref_size);
+            pkg.subdir = get_string(pos + strings_offset + string_field::subdir * ref_size);
+            pkg.md5 = optional_string(string_field::md5, flag::md5);
+            pkg.sha256 = optional_string(string_field::sha256, flag::sha256);
+            pkg.legacy_bz2_md5 = optional_string(
+                string_field::legacy_bz2_md5,
+                flag::legacy_bz2_md5
+            );
+            pkg.arch = optional_string(string_field::arch, flag::arch);
+            pkg.platform = optional_string(string_field::platform, flag::platform);
+            pkg.features = optional_string(string_field::features, flag::features);
+            pkg.license = optional_string(string_field::license, flag::license);
+            pkg.license_family = optional_string(
+                string_field::license_family,
+                flag::license_family
+            );
+            pkg.build_number = static_cast<std::size_t>(
+                get_u64(data, pos + numbers_offset + number_field::build_number * 8)
+            );
+            pkg.size = optional_number(number_field::size, flag::size);
+            pkg.legacy_bz2_size = optional_number(
+                number_field::legacy_bz2_size,
+                flag::legacy_bz2_size
+            );
+            pkg.timestamp = optional_number(number_field::timestamp, flag::timestamp);
+            if ((flags & flag::noarch_python) != 0)
+            {
+                pkg.noarch = specs::NoArchType::Python;
+            }
+            else if ((flags & flag::noarch_generic) != 0)
+            {
+                pkg.noarch = specs::NoArchType::Generic;
+            }
+            pkg.depends = get_list(pos + lists_offset + list_field::depends * ref_size);
+            pkg.constrains = get_list(pos + lists_offset + list_field::constrains * ref_size);
+            pkg.track_features = get_list(
+                pos + lists_offset + list_field::track_features * ref_size
+            );
+
+            const auto stem = std::string(package_stem(fn));
+            record.filename = std::move(fn);
+            auto [it, inserted] = stem_indices.emplace(stem, out.records.size());
+            if (inserted)
+            {
+                out.records.push_back(std::move(record));
+            }
+            else if (is_conda)
+            {
+                out.records[it->second] = std::move(record);
+            }
+        }
+        return out;
+    }
+}
@@ -0,0 +1,113 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_REPODATA_INDEX_HPP
+#define MAMBA_CORE_REPODATA_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "mamba/core/error_handling.hpp"
+#include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/repo.hpp"
+
+#include "mapped_file.hpp"
+
+namespace mamba
+{
+    /**
+     * A binary index of the package records of a ``repodata.json``.
+     *
+     * Channels can publish it as ``repodata_index.bin`` next to their ``repodata.json``.
+     * Unlike a solv file, it depends neither on the libsolv version nor on the architecture,
+     * and it is read from a memory mapping without parsing JSON.
+     *
+     * All integers are little-endian. The file starts with a header of 64 bytes:
+     *
+     * ======  ====  ============================================================
+     * Offset  Size  Content
+     * ======  ====  ============================================================
+     * 0       8     ``MAMBARDX``
+     * 8       4     Format version, readers only accept the version they know
+     * 12      4     Size of a record, at least the one of the format version
+     * 16      8     Number of records
+     * 24      8     Offset of the records
+     * 32      8     Offset of the lists
+     * 40      8     Number of list items
+     * 48      8     Offset of the strings
+     * 56      8     Size of the strings
+     * ======  ====  ============================================================
+     *
+     * A string is referenced by its offset and size in the strings, as two 32 bits integers.
+     * Identical strings are stored once.
+     * A list, such as the dependencies of a record, is referenced by the index of its first
+     * item and its number of items, as two 32 bits integers. Its items are string references.
+     *
+     * Version 1 records have the following fields:
+     *
+     * ======  ====  ============================================================
+     * Offset  Size  Content
+     * ======  ====  ============================================================
+     * 0       4     Which optional fields are set, and the noarch type
+     * 4       4     Reserved, zero
+     * 8       32    Build number, size, legacy bz2 size, and timestamp
+     * 40      104   Strings: filename, name, version, build, subdir, md5, sha256,
+     *               legacy bz2 md5, arch, platform, features, license, and
+     *               license family
+     * 144     24    Lists: depends, constrains, and track features
+     * ======  ====  ============================================================
+     *
+     * Both the ``.conda`` and ``.tar.bz2`` records are stored, so that readers can choose.
+     */
+    class RepoDataIndex
+    {
+    public:
+
+        static constexpr std::string_view filename = "repodata_index.bin";
+        static constexpr std::uint32_t format_version = 1;
+
+        /** Whether a file starts like a repodata index, rather than a ``repodata.json``. */
+        static auto is_index_file(const fs::u8path& file) -> bool;
+
+        /**
+         * Write the records, atomically replacing @p file.
+         *
+         * @param records All the records of a repodata, as read by ``RepoDataRecords::read_all``.
+         */
+        static void write(const RepoDataRecords& records, const fs::u8path& file);
+
+        /** Map an index, checking its header. */
+        static auto open(const fs::u8path& file) -> expected_t<RepoDataIndex>;
+
+        /** The number of records, both ``.conda`` and ``.tar.bz2``. */
+        auto size() const -> std::size_t;
+
+        /**
+         * The records, like ``RepoDataRecords::read`` for the ``repodata.json``.
+         *
+         * ``.conda`` artifacts are preferred over their ``.tar.bz2`` counterpart.
+         * Throw a ``std::runtime_error`` if the index is corrupted.
+         */
+        auto read_records(bool only_tar_bz2) const -> RepoDataRecords;
+
+    private:
+
+        RepoDataIndex(fs::u8path file, MappedFile mapped);
+
+        fs::u8path m_file;
+        MappedFile m_mapped;
+        std::uint32_t m_record_size = 0;
+        std::size_t m_n_records = 0;
+        std::size_t m_records_offset = 0;
+        std::size_t m_lists_offset = 0;
+        std::size_t m_n_list_items = 0;
+        std::size_t m_strings_offset = 0;
+        std::size_t m_strings_size = 0;
+    };
+}
+
+#endif
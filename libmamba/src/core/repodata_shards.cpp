@@ -0,0 +1,264 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/fetch.hpp"
+#include "mamba/core/output.hpp"
+#include "mamba/core/url.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/validate.hpp"
+
+#include "repodata_shards.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        /** The package name of a dependency such as ``python >=3.8``. */
+        auto dependency_name(std::string_view dep) -> std::string
+        {
+            return std::string(dep.substr(0, dep.find_first_of(" =<>!~[")));
+        }
+
+        /** Whether a shard hash is a hexadecimal SHA-256, and thus a safe filename. */
+        auto is_shard_hash(std::string_view hash) -> bool
+        {
+            const auto is_hex_digit = [](char c)
+            { return ((c >= '0') && (c <= '9')) || ((c >= 'a') && (c <= 'f')); };
+            return (hash.size() == 64) && std::all_of(hash.cbegin(), hash.cend(), is_hex_digit);
+        }
+
+        auto shard_path(const fs::u8path& cache_dir, const std::string& hash) -> fs::u8path
+        {
+            assert(is_shard_hash(hash));
+            return cache_dir / (hash + ".json");
+        }
+
+        /** Whether a shard is in the cache, removing it if it does not match its hash. */
+        auto is_cached(const fs::u8path& cache_dir, const std::string& hash) -> bool
+        {
+            const auto file = shard_path(cache_dir, hash);
+            if (!fs::exists(file))
+            {
+                return false;
+            }
+            if (validation::sha256sum(file) == hash)
+            {
+                return true;
+            }
+            LOG_WARNING << "Cached repodata shard " << file
+                        << " is corrupted, downloading it again";
+            std::error_code ec;
+            fs::remove(file, ec);
+            return false;
+        }
+
+        /** A shard being downloaded to a temporary file in the cache. */
+        struct ShardDownload
+        {
+            ShardDownload(std::string shard_hash, const std::string& url, const fs::u8path& dir)
+                : hash(std::move(shard_hash))
+                , file("mambaf", ".json", dir)
+                , target("shard " + hash, url, file.path().string())
+            {
+                target.set_hash(validation::HashStream::sha256());
+                // Shards are small and numerous, they are not reported individually
+                target.set_finalize_callback([](const DownloadTarget&) { return true; });
+            }
+
+            std::string hash;
+            TemporaryFile file;
+            DownloadTarget target;
+        };
+
+        /** Download the shards missing from the cache, all at once. */
+        void download_shards(
+            const RepoDataShards& shards,
+            const std::vector<std::string>& hashes,
+            const fs::u8path& cache_dir
+        )
+        {
+            auto downloads = std::vector<std::unique_ptr<ShardDownload>>();
+            for (const auto& hash : hashes)
+            {
+                if (is_cached(cache_dir, hash))
+                {
+                    continue;
+                }
+                downloads.push_back(
+                    std::make_unique<ShardDownload>(hash, shards.shard_url(hash), cache_dir)
+                );
+            }
+            if (downloads.empty())
+            {
+                return;
+            }
+
+            LOG_INFO << "Downloading " << downloads.size() << " repodata shards";
+            auto multi_dl = MultiDownloadTarget();
+            for (auto& dl : downloads)
+            {
+                multi_dl.add(&dl->target);
+            }
+            multi_dl.download(MAMBA_DOWNLOAD_FAILFAST | MAMBA_NO_CLEAR_PROGRESS_BARS);
+
+            for (auto& dl : downloads)
+            {
+                const auto& target = dl->target;
+                // Note HTTP status == 0 for files
+                const int status = target.get_http_status();
+                if ((target.get_result() != 0) || ((status != 0) && (status != 200)))
+                {
+                    throw std::runtime_error(fmt::format(
+                        "Could not download repodata shard {} (response: {})",
+                        target.get_url(),
+                        status
+                    ));
+                }
+                if (target.get_hex_digest() != dl->hash)
+                {
+                    throw std::runtime_error(
+                        fmt::format("Repodata shard {} does not match its hash", target.get_url())
+                    );
+                }
+                // Content-addressed, a concurrent writer would have written the same content
+                fs::rename(dl->file.path(), shard_path(cache_dir, dl->hash));
+            }
+        }
+    }
+
+    auto RepoDataShards::read(const fs::u8path& index_file, const std::string& subdir_url)
+        -> expected_t<RepoDataShards>
+    {
+        try
+        {
+            auto in = open_ifstream(index_file);
+            const auto index = nlohmann::json::parse(in);
+
+            auto out = RepoDataShards();
+            auto base_url = std::string("shards/");
+            if (auto info = index.find("info"); info != index.end())
+            {
+                base_url = info->value("shards_base_url", base_url);
+            }
+            out.m_shards_base_url = has_scheme(base_url) ? base_url
+                                                         : join_url(subdir_url, base_url);
+            if (!out.m_shards_base_url.empty() && (out.m_shards_base_url.back() != '/'))
+            {
+                out.m_shards_base_url += '/';
+            }
+
+            const auto& shards = index.at("shards");
+            out.m_shards.reserve(shards.size());
+            for (const auto& [name, hash] : shards.items())
+            {
+                // Hashes are used as filenames in the cache
+                auto hash_str = hash.get<std::string>();
+                if (!is_shard_hash(hash_str))
+                {
+                    throw std::invalid_argument(
+                        fmt::format("invalid hash '{}' of shard '{}'", hash_str, name)
+                    );
+                }
+                out.m_shards.emplace(name, std::move(hash_str));
+            }
+            return { std::move(out) };
+        }
+        catch (const std::exception& e)
+        {
+            return make_unexpected(
+                fmt::format("Invalid repodata shards index {}: {}", index_file.string(), e.what()),
+                mamba_error_code::repodata_not_loaded
+            );
+        }
+    }
+
+    auto RepoDataShards::shard_hash(const std::string& name) const -> const std::string*
+    {
+        const auto it = m_shards.find(name);
+        return (it != m_shards.cend()) ? &it->second : nullptr;
+    }
+
+    auto RepoDataShards::shard_url(const std::string& hash) const -> std::string
+    {
+        return m_shards_base_url + hash + ".json";
+    }
+
+    auto RepoDataShards::fetch_records(
+        const std::vector<std::string>& names,
+        const fs::u8path& cache_dir,
+        bool only_tar_bz2,
+        bool add_pip_as_python_dependency
+    ) const -> expected_t<RepoDataRecords>
+    {
+        auto out = RepoDataRecords();
+        try
+        {
+            fs::create_directories(cache_dir);
+
+            auto visited = std::unordered_set<std::string>(names.cbegin(), names.cend());
+            auto level = std::vector<std::string>(visited.cbegin(), visited.cend());
+            // Records are added in a deterministic order
+            std::sort(level.begin(), level.end());
+            auto visited_hashes = std::unordered_set<std::string>();
+            auto visit = [&](std::string name)
+            {
+                if (visited.insert(name).second)
+                {
+                    level.push_back(std::move(name));
+                }
+            };
+            while (!level.empty())
+            {
+                auto hashes = std::vector<std::string>();
+                for (const auto& name : level)
+                {
+                    const auto* hash = shard_hash(name);
+                    if ((hash != nullptr) && visited_hashes.insert(*hash).second)
+                    {
+                        hashes.push_back(*hash);
+                    }
+                }
+                level.clear();
+
+                download_shards(*this, hashes, cache_dir);
+
+                for (const auto& hash : hashes)
+                {
+                    auto shard = RepoDataRecords::read(shard_path(cache_dir, hash), only_tar_bz2);
+                    for (auto& record : shard.records)
+                    {
+                        for (const auto& dep : record.package.depends)
+                        {
+                            visit(dependency_name(dep));
+                        }
+                        if (add_pip_as_python_dependency && (record.package.name == "python"))
+                        {
+                            visit("pip");
+                        }
+                        out.records.push_back(std::move(record));
+                    }
+                }
+            }
+        }
+        catch (const std::exception& e)
+        {
+            return make_unexpected(e.what(), mamba_error_code::repodata_not_loaded);
+        }
+        LOG_INFO << "Fetched " << out.records.size() << " records from repodata shards";
+        return { std::move(out) };
+    }
+}
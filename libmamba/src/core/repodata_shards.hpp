@@ -0,0 +1,82 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_REPODATA_SHARDS_HPP
+#define MAMBA_CORE_REPODATA_SHARDS_HPP
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mamba/core/error_handling.hpp"
+#include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/repo.hpp"
+
+namespace mamba
+{
+    /**
+     * The index of a sharded repodata.
+     *
+     * Instead of a single ``repodata.json``, a sharded subdir publishes a
+     * ``repodata_shards.json`` index with the sha256 of the shard of each package name:
+     *
+     * .. code:: json
+     *
+     *    {
+     *      "info": {"subdir": "linux-64", "shards_base_url": "shards/"},
+     *      "shards": {"python": "<sha256>", "...": "..."}
+     *    }
+     *
+     * A shard is a ``repodata.json`` that only has the records of one package name, stored
+     * under ``<shards_base_url><sha256>.json``.
+     * Shards are content-addressed, hence never expire once cached.
+     */
+    class RepoDataShards
+    {
+    public:
+
+        static constexpr std::string_view index_filename = "repodata_shards.json";
+
+        /**
+         * Read a shards index.
+         *
+         * @param subdir_url The url of the subdir, used to resolve relative shard urls.
+         */
+        static auto read(const fs::u8path& index_file, const std::string& subdir_url)
+            -> expected_t<RepoDataShards>;
+
+        /** The hexadecimal sha256 of the shard of a package name, if it has one. */
+        auto shard_hash(const std::string& name) const -> const std::string*;
+
+        auto shard_url(const std::string& hash) const -> std::string;
+
+        /**
+         * Fetch the records of the given package names, and transitively of the names of
+         * their dependencies.
+         *
+         * Shards are first looked up in @p cache_dir.
+         * Other shards are downloaded, concurrently for each level of dependencies, and stored
+         * in @p cache_dir once their hash is checked.
+         *
+         * @param add_pip_as_python_dependency Also fetch ``pip`` with ``python``, as it is
+         *        added as a dependency by ``MRepo::add_pip_as_python_dependency``.
+         */
+        auto fetch_records(
+            const std::vector<std::string>& names,
+            const fs::u8path& cache_dir,
+            bool only_tar_bz2,
+            bool add_pip_as_python_dependency
+        ) const -> expected_t<RepoDataRecords>;
+
+    private:
+
+        std::unordered_map<std::string, std::string> m_shards = {};
+        std::string m_shards_base_url = {};
+    };
+}
+
+#endif
@@ -0,0 +1,201 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "mamba/core/context.hpp"
+#include "mamba/core/output.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/validate.hpp"
+#include "solv-cpp/pool.hpp"
+#include "solv-cpp/solvable.hpp"
+
+#include "repodata_subset.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        /** Bump when the content of the key changes, solv files check their own version. */
+        constexpr int subset_version = 1;
+
+        class KeyHasher
+        {
+        public:
+
+            void add(std::string_view str)
+            {
+                // Prefixed with the size so that consecutive strings cannot be confused
+                const auto size = fmt::format("{};", str.size());
+                m_hash.update(size.data(), size.size());
+                m_hash.update(str.data(), str.size());
+            }
+
+            void add(const std::vector<std::string>& strs)
+            {
+                add(fmt::format("{}", strs.size()));
+                for (const auto& str : strs)
+                {
+                    add(str);
+                }
+            }
+
+            auto hex_digest() -> std::string
+            {
+                return m_hash.hex_digest();
+            }
+
+        private:
+
+            validation::HashStream m_hash = validation::HashStream::sha256();
+        };
+    }
+
+    auto reachable_names(const MPool& pool, const std::vector<std::string>& names)
+        -> std::unordered_set<std::string>
+    {
+        const auto& spool = pool.pool();
+        // The names of the dependencies of the packages of each name
+        auto dependencies = std::unordered_map<std::string_view, std::vector<std::string_view>>();
+        spool.for_each_solvable(
+            [&](solv::ObjSolvableViewConst s)
+            {
+                auto& deps = dependencies[s.name()];
+                for (const auto dep : s.dependencies())
+                {
+                    deps.push_back(spool.get_dependency_name(dep));
+                }
+            }
+        );
+
+        auto out = std::unordered_set<std::string>(names.cbegin(), names.cend());
+        auto todo = std::vector<std::string>(out.cbegin(), out.cend());
+        while (!todo.empty())
+        {
+            const auto name = std::move(todo.back());
+            todo.pop_back();
+            const auto it = dependencies.find(name);
+            if (it == dependencies.cend())
+            {
+                continue;
+            }
+            for (const auto dep : it->second)
+            {
+                if (out.insert(std::string(dep)).second)
+                {
+                    todo.emplace_back(dep);
+                }
+            }
+        }
+        return out;
+    }
+
+    RepoDataSubsets::RepoDataSubsets(
+        const fs::u8path& cache_dir,
+        std::vector<std::string> names,
+        std::vector<std::pair<std::string, RepoMetadata>> subdirs
+    )
+        : m_names(std::move(names))
+        , m_subdirs(std::move(subdirs))
+    {
+        std::sort(m_names.begin(), m_names.end());
+        m_names.erase(std::unique(m_names.begin(), m_names.end()), m_names.end());
+
+        const auto& ctx = Context::instance();
+        auto hasher = KeyHasher();
+        hasher.add(fmt::format("{}", subset_version));
+        hasher.add(m_names);
+        for (const auto& [name, meta] : m_subdirs)
+        {
+            hasher.add(name);
+            hasher.add(meta.url);
+            hasher.add(meta.etag);
+            hasher.add(meta.mod);
+            hasher.add(meta.pip_added ? "pip" : "");
+        }
+        // The subsets are written once the records are filtered
+        hasher.add(ctx.use_only_tar_bz2 ? "tar.bz2" : "");
+        hasher.add(ctx.repodata_exclude);
+        hasher.add(ctx.repodata_as_of);
+        hasher.add(ctx.repodata_exclude_licenses);
+        hasher.add(ctx.repodata_exclude_track_features);
+        m_key = hasher.hex_digest();
+        m_dir = cache_dir / m_key;
+    }
+
+    auto RepoDataSubsets::key() const -> const std::string&
+    {
+        return m_key;
+    }
+
+    auto RepoDataSubsets::load(MPool& pool) const -> std::optional<std::vector<MRepo>>
+    {
+        for (std::size_t i = 0; i < m_subdirs.size(); ++i)
+        {
+            if (!fs::exists(subset_path(i)))
+            {
+                LOG_DEBUG << "No repodata subset " << m_key;
+                return std::nullopt;
+            }
+        }
+
+        auto out = std::vector<MRepo>();
+        out.reserve(m_subdirs.size());
+        for (std::size_t i = 0; i < m_subdirs.size(); ++i)
+        {
+            const auto& [name, meta] = m_subdirs[i];
+            auto repo = MRepo::read_solv_file(pool, name, subset_path(i), meta);
+            if (!repo.has_value())
+            {
+                LOG_WARNING << "Invalid repodata subset " << subset_path(i)
+                            << ", loading the full repodata";
+                for (const auto& loaded : out)
+                {
+                    pool.pool().remove_repo(loaded.id(), /* reuse_ids= */ true);
+                }
+                return std::nullopt;
+            }
+            out.push_back(std::move(repo).value());
+        }
+        LOG_INFO << "Loaded repodata subset " << m_key;
+        return { std::move(out) };
+    }
+
+    void RepoDataSubsets::store(MPool& pool, std::vector<MRepo>& repos) const
+    {
+        if (repos.size() != m_subdirs.size())
+        {
+            return;
+        }
+        const auto names = reachable_names(pool, m_names);
+        LOG_INFO << "Storing repodata subset " << m_key << " of " << names.size() << " names";
+        try
+        {
+            fs::create_directories(m_dir);
+            for (std::size_t i = 0; i < repos.size(); ++i)
+            {
+                const auto removed = repos[i].keep_names(names);
+                LOG_DEBUG << "Removed " << removed << " unreachable packages from repo "
+                          << m_subdirs[i].first;
+                repos[i].write_solv(subset_path(i));
+            }
+        }
+        catch (const std::exception& e)
+        {
+            LOG_WARNING << "Could not store repodata subset " << m_key << ": " << e.what();
+        }
+    }
+
+    auto RepoDataSubsets::subset_path(std::size_t i) const -> fs::u8path
+    {
+        return m_dir / (std::to_string(i) + ".solv");
+    }
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_REPODATA_SUBSET_HPP
+#define MAMBA_CORE_REPODATA_SUBSET_HPP
+
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/repo.hpp"
+
+namespace mamba
+{
+    class MPool;
+
+    /**
+     * The names of the packages that can be installed for @p names.
+     *
+     * These are the given names and, transitively, the names of the dependencies of all the
+     * packages of the pool with one of these names.
+     */
+    auto reachable_names(const MPool& pool, const std::vector<std::string>& names)
+        -> std::unordered_set<std::string>;
+
+    /**
+     * Solv caches of the subdirs only holding the packages reachable from a set of names.
+     *
+     * A solve only ever considers the packages reachable from the requested names, so the
+     * subsets give the same solutions as the full subdirs, while loading much faster.
+     * Subsets are stored under a key computed from the names, and from the url, etag and last
+     * modified time of all the subdirs: a change to one subdir can change the names reachable
+     * in the others, hence invalidates all the subsets of the key.
+     */
+    class RepoDataSubsets
+    {
+    public:
+
+        /**
+         * @param subdirs The name and metadata of the repo of each subdir, in loading order.
+         */
+        RepoDataSubsets(
+            const fs::u8path& cache_dir,
+            std::vector<std::string> names,
+            std::vector<std::pair<std::string, RepoMetadata>> subdirs
+        );
+
+        auto key() const -> const std::string&;
+
+        /** Load the subsets of all the subdirs, or none if any is missing or invalid. */
+        auto load(MPool& pool) const -> std::optional<std::vector<MRepo>>;
+
+        /**
+         * Remove the packages that are not reachable from the names from @p repos, the full
+         * repo of each subdir, and store the subsets.
+         *
+         * Failures are only logged, as the subsets are only a cache.
+         */
+        void store(MPool& pool, std::vector<MRepo>& repos) const;
+
+    private:
+
+        fs::u8path m_dir;
+        std::vector<std::string> m_names;
+        std::vector<std::pair<std::string, RepoMetadata>> m_subdirs;
+        std::string m_key;
+
+        auto subset_path(std::size_t i) const -> fs::u8path;
+    };
+}
+
+#endif
@@ -8,6 +8,9 @@
 #include <csignal>
 #include <exception>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
 #include <string>
 #include <thread>
 #include <vector>
@@ -19,6 +22,7 @@
 #include <reproc++/run.hpp>
 #include <spdlog/spdlog.h>
 
+#include "mamba/core/activation.hpp"
 #include "mamba/core/context.hpp"
 #include "mamba/core/environment.hpp"
 #include "mamba/core/error_handling.hpp"
@@ -309,7 +313,7 @@ namespace mamba
         }
 
         LOG_DEBUG << "Currently running processes: " << get_all_running_processes_info();
-        fmt::print(LOG_DEBUG, "Remaining args to run as command: {}", fmt::join(command, " "));
+        LOG_DEBUG << fmt::format("Remaining args to run as command: {}", fmt::join(command, " "));
 
         // replace the wrapping bash with new process entirely
 #ifndef _WIN32
@@ -319,9 +323,44 @@ namespace mamba
         }
 #endif
 
-        auto [wrapped_command, script_file] = prepare_wrapped_call(prefix, command);
+        // Without activation scripts to source, the activated environment is computed here and
+        // the command started directly, rather than from a shell script doing the activation.
+        std::optional<std::map<std::string, std::string>> activated_env;
+#ifndef _WIN32
+        if (Context::instance().run_without_shell && !clean_env)
+        {
+            activated_env = PosixActivator().activated_environment(prefix);
+        }
+#endif
+
+        std::vector<std::string> wrapped_command;
+        std::unique_ptr<TemporaryFile> script_file;
+        if (activated_env)
+        {
+            if (Context::instance().command_params.is_micromamba)
+            {
+                (*activated_env)["MAMBA_EXE"] = get_self_exe_path().string();
+            }
+            wrapped_command = command;
+            // Only meaningful for the wrapping shell
+            wrapped_command.erase(wrapped_command.begin());
+            if (wrapped_command.front().find('/') == std::string::npos)
+            {
+                // Looked up in the activated PATH, like the shell would
+                const auto& path = (*activated_env)["PATH"];
+                if (auto exe = env::which(wrapped_command.front(), path); !exe.empty())
+                {
+                    wrapped_command.front() = exe.string();
+                }
+            }
+            LOG_DEBUG << fmt::format("Running without shell: {}", fmt::join(command, " "));
+        }
+        else
+        {
+            std::tie(wrapped_command, script_file) = prepare_wrapped_call(prefix, command);
 
-        fmt::print(LOG_DEBUG, "Running wrapped script: {}", fmt::join(command, " "));
+            LOG_DEBUG << fmt::format("Running wrapped script: {}", fmt::join(command, " "));
+        }
 
         bool sinkout = stream_options & static_cast<int>(STREAM_OPTIONS::SINKOUT);
         bool sinkerr = stream_options & static_cast<int>(STREAM_OPTIONS::SINKERR);
@@ -363,6 +402,15 @@ namespace mamba
             }
             opt.env.extra = env_map;
         }
+        if (activated_env)
+        {
+            for (const auto& [name, value] : env_map)
+            {
+                (*activated_env)[name] = value;
+            }
+            opt.env.behavior = reproc::env::empty;
+            opt.env.extra = *activated_env;
+        }
 
         opt.redirect.out.type = sinkout ? reproc::redirect::discard : reproc::redirect::parent;
         opt.redirect.err.type = sinkerr ? reproc::redirect::discard : reproc::redirect::parent;
@@ -5,12 +5,14 @@
 // The full license is in the file LICENSE, distributed with this software.
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <limits>
 #include <map>
 #include <regex>
 #include <stdexcept>
 #include <string_view>
+#include <thread>
 #include <tuple>
 #include <type_traits>
 #include <vector>
@@ -53,42 +55,63 @@ namespace mamba
      ******************************************/
 
     ProblemsGraph simplify_conflicts(const ProblemsGraph& pbs)
+    {
+        return simplify_conflicts(ProblemsGraph(pbs));
+    }
+
+    ProblemsGraph simplify_conflicts(ProblemsGraph&& pbs)
     {
         using node_id = ProblemsGraph::node_id;
         using node_t = ProblemsGraph::node_t;
 
-        const auto& old_graph = pbs.graph();
-        const auto& old_conflicts = pbs.conflicts();
+        auto& graph = pbs.m_graph;
+        auto& conflicts = pbs.m_conflicts;
 
         const auto is_constraint = [](const node_t& node) -> bool
         { return std::holds_alternative<ProblemsGraph::ConstraintNode>(node); };
 
         const auto has_constraint_child = [&](node_id n)
         {
-            if (old_graph.out_degree(n) == 1)
+            if (graph.out_degree(n) == 1)
             {
-                node_id const s = old_graph.successors(n).front();
+                node_id const s = graph.successors(n).front();
                 // If s is of constraint type, it has conflicts
-                assert(!is_constraint(old_graph.node(s)) || old_conflicts.has_conflict(s));
-                return is_constraint(old_graph.node(s));
+                assert(!is_constraint(graph.node(s)) || conflicts.has_conflict(s));
+                return is_constraint(graph.node(s));
             }
             return false;
         };
 
-        // Working on a copy since we cannot safely iterate through object
-        // and modify them at the same time
-        auto graph = pbs.graph();
-        auto conflicts = pbs.conflicts();
+        // The graph is modified in place but the simplification is defined on the original
+        // graph, so the node ids read from it are copied beforehand (only ids, not node data).
+        const auto old_conflicts = pbs.conflicts();
+        auto constraint_child = std::unordered_map<node_id, node_id>();
+        using node_id_list = ProblemsGraph::graph_t::node_id_list;
+        auto constraint_parents = std::unordered_map<node_id, node_id_list>();
+        for (const auto& [id, id_conflicts] : old_conflicts)
+        {
+            if (has_constraint_child(id))
+            {
+                assert(graph.out_degree(id) == 1);
+                constraint_child[id] = graph.successors(id).front();
+                for (const auto& c : id_conflicts)
+                {
+                    if (is_constraint(graph.node(c)) && (constraint_parents.count(c) == 0))
+                    {
+                        constraint_parents[c] = graph.predecessors(c);
+                    }
+                }
+            }
+        }
 
         for (const auto& [id, id_conflicts] : old_conflicts)
         {
             // We are trying to detect node that are in conflicts but are not leaves.
             // This shows up in Pyhon dependencies because the constraint on ``python`` and
             // ``python_abi`` was reversed.
-            if (has_constraint_child(id))
+            if (const auto child_it = constraint_child.find(id); child_it != constraint_child.end())
             {
-                assert(old_graph.out_degree(id) == 1);
-                const node_id id_child = old_graph.successors(id).front();
+                const node_id id_child = child_it->second;
                 for (const auto& c : id_conflicts)
                 {
                     // Since ``id`` has a constraint node child (``id-child``) and is itself in
@@ -100,9 +123,10 @@ namespace mamba
                     // merge later on.
 
                     // id_child may alrady have been removed through a preivous iteration
-                    if (graph.has_node(id_child) && is_constraint(old_graph.node(c)))
+                    const auto parents_it = constraint_parents.find(c);
+                    if (graph.has_node(id_child) && (parents_it != constraint_parents.end()))
                     {
-                        for (const node_id c_parent : old_graph.predecessors(c))
+                        for (const node_id c_parent : parents_it->second)
                         {
                             assert(graph.has_node(id_child));
                             assert(graph.has_node(c_parent));
@@ -118,7 +142,7 @@ namespace mamba
                 }
             }
         }
-        return { std::move(graph), std::move(conflicts), pbs.root_node() };
+        return std::move(pbs);
     }
 
     /***********************************************
@@ -264,7 +288,10 @@ namespace mamba
             auto tmp = std::vector<O>();
             tmp.reserve(rng.size());
             std::transform(rng.begin(), rng.end(), std::back_inserter(tmp), std::forward<Func>(f));
-            return CompressedProblemsGraph::NamedList<O>(tmp.begin(), tmp.end());
+            return CompressedProblemsGraph::NamedList<O>(
+                std::make_move_iterator(tmp.begin()),
+                std::make_move_iterator(tmp.end())
+            );
         }
 
         /**
@@ -304,32 +331,193 @@ namespace mamba
         }
 
         /**
-         * The criteria for deciding whether to merge two nodes together.
+         * The leaves reachable from each node, indexed by node id, with independent searches.
+         *
+         * Searches are spread across threads for large graphs.
+         */
+        auto leaves_by_node_searched(const ProblemsGraph::graph_t& g)
+            -> std::vector<ProblemsGraph::graph_t::node_id_list>
+        {
+            using node_id = ProblemsGraph::node_id;
+
+            auto sources = std::vector<node_id>();
+            g.for_each_node_id([&](node_id n) { sources.push_back(n); });
+
+            auto out = std::vector<ProblemsGraph::graph_t::node_id_list>(g.successors().size());
+            auto next = std::atomic<std::size_t>(0);
+            auto work = [&]()
+            {
+                auto leaves = std::vector<node_id>();
+                for (std::size_t i = next++; i < sources.size(); i = next++)
+                {
+                    leaves.clear();
+                    g.for_each_leaf_id_from(sources[i], [&](node_id m) { leaves.push_back(m); });
+                    // Each thread writes to different elements
+                    out[sources[i]] = { leaves.begin(), leaves.end() };
+                }
+            };
+
+            // Below this number of searches per thread, starting threads does not pay off
+            constexpr std::size_t min_sources_per_thread = 256;
+            const auto n_threads = std::clamp<std::size_t>(
+                sources.size() / min_sources_per_thread,
+                1,
+                std::max(std::thread::hardware_concurrency(), 1u)
+            );
+            auto workers = std::vector<std::thread>();
+            workers.reserve(n_threads - 1);
+            for (std::size_t t = 1; t < n_threads; ++t)
+            {
+                workers.emplace_back(work);
+            }
+            work();
+            for (auto& w : workers)
+            {
+                w.join();
+            }
+            return out;
+        }
+
+        /**
+         * The leaves reachable from each node, indexed by node id.
+         *
+         * In an acyclic graph, the leaves of a node are the union of the leaves of its
+         * children, which are all computed in a single depth first search.
+         * Cycles, from cyclic dependencies, fall back to one search per node.
          */
-        auto default_merge_criteria(
+        auto leaves_by_node(const ProblemsGraph::graph_t& g)
+            -> std::vector<ProblemsGraph::graph_t::node_id_list>
+        {
+            using graph_t = ProblemsGraph::graph_t;
+            using node_id = ProblemsGraph::node_id;
+
+            struct LeavesVisitor : util::EmptyVisitor<graph_t>
+            {
+                std::vector<graph_t::node_id_list> leaves;
+                std::vector<node_id> buffer = {};
+                bool has_cycle = false;
+
+                void back_edge(node_id, node_id, const graph_t&)
+                {
+                    has_cycle = true;
+                }
+
+                void finish_node(node_id n, const graph_t& graph)
+                {
+                    if (has_cycle)
+                    {
+                        return;
+                    }
+                    buffer.clear();
+                    if (graph.out_degree(n) == 0)
+                    {
+                        buffer.push_back(n);
+                    }
+                    for (const node_id child : graph.successors(n))
+                    {
+                        buffer.insert(buffer.end(), leaves[child].begin(), leaves[child].end());
+                    }
+                    leaves[n] = { buffer.begin(), buffer.end() };
+                }
+            } visitor{ {}, std::vector<graph_t::node_id_list>(g.successors().size()) };
+
+            util::dfs_raw(g, visitor);
+            if (visitor.has_cycle)
+            {
+                return leaves_by_node_searched(g);
+            }
+            return std::move(visitor.leaves);
+        }
+
+        /**
+         * Merge node indices together with the default criteria.
+         *
+         * Two nodes of the same type are merged if they have the same name, are not in conflict,
+         * and either both are leaves with the same parents, or neither is a leaf and they lead
+         * to the same leaves.
+         * Parents in the last case can "inject" themselves into a bigger problem.
+         * Merging conflicts would be counter-productive in explaining problems.
+         *
+         * Rather than applying the criteria on every pair of nodes, which is quadratic and
+         * searches the leaves of both nodes each time, nodes are bucketed by the attributes
+         * compared, which are computed once per node.
+         * Only conflicts are checked between nodes of a bucket.
+         */
+        auto default_merge_node_indices(
             const ProblemsGraph& pbs,
-            ProblemsGraph::node_id n1,
-            ProblemsGraph::node_id n2
-        ) -> bool
+            const node_type_list<old_node_id_list>& nodes_by_type
+        ) -> node_type_list<std::vector<old_node_id_list>>
         {
             using node_id = ProblemsGraph::node_id;
             const auto& g = pbs.graph();
-            auto is_leaf = [&g](node_id n) -> bool { return g.successors(n).size() == 0; };
-            auto leaves_from = [&g](node_id n) -> util::flat_set<node_id>
+            const auto leaves = leaves_by_node(g);
+
+            // Leaves are compared by their parents, other nodes by their leaves
+            using node_set = ProblemsGraph::graph_t::node_id_list;
+            using merge_key = std::tuple<std::string_view, bool, const node_set*>;
+            const auto key_of = [&](node_id n) -> merge_key
             {
-                auto leaves = std::vector<node_id>();
-                g.for_each_leaf_id_from(n, [&leaves](node_id m) { leaves.push_back(m); });
-                return util::flat_set(std::move(leaves));
+                const bool is_leaf = g.out_degree(n) == 0;
+                return { node_name(g.node(n)), is_leaf, is_leaf ? &g.predecessors(n) : &leaves[n] };
             };
-            return (node_name(g.node(n1)) == node_name(g.node(n2)))
-                   // Merging conflicts would be counter-productive in explaining problems
-                   && !(pbs.conflicts().in_conflict(n1, n2))
-                   // We don't want to use leaves_from for leaves because it resolve to themselves,
-                   // preventing any merging.
-                   && ((is_leaf(n1) && is_leaf(n2)) || (leaves_from(n1) == leaves_from(n2)))
-                   // We only check the parents for leaves meaning parents can "inject"
-                   // themselves into a bigger problem
-                   && ((!is_leaf(n1) && !is_leaf(n2)) || (g.predecessors(n1) == g.predecessors(n2)));
+            const auto key_less = [](const merge_key& a, const merge_key& b)
+            {
+                const auto& [name_a, leaf_a, set_a] = a;
+                const auto& [name_b, leaf_b, set_b] = b;
+                if ((name_a != name_b) || (leaf_a != leaf_b))
+                {
+                    return std::tie(name_a, leaf_a) < std::tie(name_b, leaf_b);
+                }
+                return std::lexicographical_compare(
+                    set_a->begin(),
+                    set_a->end(),
+                    set_b->begin(),
+                    set_b->end()
+                );
+            };
+
+            auto groups = node_type_list<std::vector<old_node_id_list>>(nodes_by_type.size());
+            for (std::size_t type = 0; type < nodes_by_type.size(); ++type)
+            {
+                const auto& node_indices = nodes_by_type[type];
+
+                // Each bucket lists positions in node_indices in increasing order
+                auto buckets = std::map<merge_key, std::vector<std::size_t>, decltype(key_less)>(
+                    key_less
+                );
+                auto bucket_of = std::vector<std::vector<std::size_t>*>(node_indices.size());
+                for (std::size_t i = 0; i < node_indices.size(); ++i)
+                {
+                    auto& bucket = buckets[key_of(node_indices[i])];
+                    bucket.push_back(i);
+                    bucket_of[i] = &bucket;
+                }
+
+                // Same greedy grouping as merge_node_indices_for_one_node_type, restricted to
+                // the nodes of the bucket.
+                auto node_added_to_a_group = std::vector<bool>(node_indices.size(), false);
+                for (std::size_t i = 0; i < node_indices.size(); ++i)
+                {
+                    if (node_added_to_a_group[i])
+                    {
+                        continue;
+                    }
+                    const auto id_i = node_indices[i];
+                    auto current_group = old_node_id_list{ id_i };
+                    node_added_to_a_group[i] = true;
+                    for (const std::size_t j : *bucket_of[i])
+                    {
+                        const auto id_j = node_indices[j];
+                        if ((!node_added_to_a_group[j]) && !pbs.conflicts().in_conflict(id_i, id_j))
+                        {
+                            current_group.push_back(id_j);
+                            node_added_to_a_group[j] = true;
+                        }
+                    }
+                    groups[type].push_back(std::move(current_group));
+                }
+            }
+            return groups;
         }
 
         using node_id_mapping = std::map<ProblemsGraph::node_id, CompressedProblemsGraph::node_id>;
@@ -338,6 +526,7 @@ namespace mamba
          * For a given type of node, merge nodes together and add them to the new graph.
          *
          * @param old_graph The graph containing the node data referenced by @p old_groups.
+         * The node data is moved out of it.
          * @param old_groups A partition of the node indices to merge together.
          * @param new_graph The graph where the merged nodes are added.
          * @param old_to_new A mapping of old node indices to new node indices updated with the new
@@ -345,7 +534,7 @@ namespace mamba
          */
         template <typename Node>
         void merge_nodes_for_one_node_type(
-            const ProblemsGraph::graph_t& old_graph,
+            ProblemsGraph::graph_t& old_graph,
             const std::vector<old_node_id_list>& old_groups,
             CompressedProblemsGraph::graph_t& new_graph,
             node_id_mapping& old_to_new
@@ -353,7 +542,7 @@ namespace mamba
         {
             auto get_old_node = [&old_graph](ProblemsGraph::node_id id)
             {
-                auto node = old_graph.node(id);
+                auto& node = old_graph.node(id);
                 // Must always be the case that old_groups only references node ids of type Node
                 assert(std::holds_alternative<Node>(node));
                 return std::get<Node>(std::move(node));
@@ -372,36 +561,32 @@ namespace mamba
         /**
          * Merge nodes together.
          *
-         * Merge by applying the @p merge_criteria to nodes that hold the same type in the variant.
-         *
-         * @param merge_criteria A binary function that decices whether two nodes should be merged
-         * together. The function is assumed to be symetric and transitive.
+         * @param old_graph The graph from which the node data is moved.
+         * @param old_root_node The root node of @p old_graph.
+         * @param old_ids_groups For each node type, a partition of the node indices to merge
+         * together, as given by ``merge_node_indices``.
          * @return A tuple of the graph with newly created nodes (without edges), the new root node,
          * and a mapping between old node ids and new node ids.
          */
-        template <typename CompFunc>
-        auto merge_nodes(const ProblemsGraph& pbs, CompFunc&& merge_criteria)
-            -> std::tuple<CompressedProblemsGraph::graph_t, CompressedProblemsGraph::node_id, node_id_mapping>
+        auto merge_nodes(
+            ProblemsGraph::graph_t& old_graph,
+            ProblemsGraph::node_id old_root_node,
+            const node_type_list<std::vector<old_node_id_list>>& old_ids_groups
+        ) -> std::tuple<CompressedProblemsGraph::graph_t, CompressedProblemsGraph::node_id, node_id_mapping>
         {
-            const auto& old_graph = pbs.graph();
             auto new_graph = CompressedProblemsGraph::graph_t();
             const auto new_root_node = new_graph.add_node(CompressedProblemsGraph::RootNode());
 
             auto old_to_new = node_id_mapping{};
 
-            auto old_ids_groups = merge_node_indices(
-                node_id_by_type(pbs.graph()),
-                std::forward<CompFunc>(merge_criteria)
-            );
-
             {
                 using Node = ProblemsGraph::RootNode;
                 [[maybe_unused]] static constexpr auto type_idx = variant_type_index<ProblemsGraph::node_t, Node>(
                 );
                 assert(old_ids_groups[type_idx].size() == 1);
                 assert(old_ids_groups[type_idx][0].size() == 1);
-                assert(old_ids_groups[type_idx][0][0] == pbs.root_node());
-                old_to_new[pbs.root_node()] = new_root_node;
+                assert(old_ids_groups[type_idx][0][0] == old_root_node);
+                old_to_new[old_root_node] = new_root_node;
             }
             {
                 using Node = ProblemsGraph::PackageNode;
@@ -439,12 +624,12 @@ namespace mamba
         /**
          * For all groups in the new graph, merge the edges in-between nodes of those groups.
          *
-         * @param old_graph The graph with the nodes use for merging.
+         * @param old_graph The graph with the nodes use for merging, from which edge data is moved.
          * @param new_graph The graph with nodes already merged, modified to add new edges.
          * @param old_to_new A mapping between old node ids and new node ids.
          */
         void merge_edges(
-            const ProblemsGraph::graph_t& old_graph,
+            ProblemsGraph::graph_t& old_graph,
             CompressedProblemsGraph::graph_t& new_graph,
             const node_id_mapping& old_to_new
         )
@@ -457,7 +642,8 @@ namespace mamba
                 {
                     new_graph.add_edge(new_from, new_to, CompressedProblemsGraph::edge_t());
                 }
-                new_graph.edge(new_from, new_to).insert(old_graph.edge(old_from, old_to));
+                auto& old_edge = old_graph.edge(old_from, old_to);
+                new_graph.edge(new_from, new_to).insert(std::move(old_edge));
             };
             old_graph.for_each_edge_id(add_new_edge);
         }
@@ -485,11 +671,18 @@ namespace mamba
         }
     }
 
-    // TODO move graph nodes and edges.
     auto CompressedProblemsGraph::from_problems_graph(
         const ProblemsGraph& pbs,
         const merge_criteria_t& merge_criteria
     ) -> CompressedProblemsGraph
+    {
+        return from_problems_graph(ProblemsGraph(pbs), merge_criteria);
+    }
+
+    auto CompressedProblemsGraph::from_problems_graph(
+        ProblemsGraph&& pbs,
+        const merge_criteria_t& merge_criteria
+    ) -> CompressedProblemsGraph
     {
         graph_t graph = {};
         node_id root_node = {};
@@ -499,15 +692,23 @@ namespace mamba
             auto merge_func =
                 [&pbs, &merge_criteria](ProblemsGraph::node_id n1, ProblemsGraph::node_id n2)
             { return merge_criteria(pbs, n1, n2); };
-            std::tie(graph, root_node, old_to_new) = merge_nodes(pbs, merge_func);
+            auto groups = merge_node_indices(node_id_by_type(pbs.graph()), merge_func);
+            std::tie(graph, root_node, old_to_new) = merge_nodes(
+                pbs.m_graph,
+                pbs.m_root_node,
+                groups
+            );
         }
         else
         {
-            auto merge_func = [&pbs](ProblemsGraph::node_id n1, ProblemsGraph::node_id n2)
-            { return default_merge_criteria(pbs, n1, n2); };
-            std::tie(graph, root_node, old_to_new) = merge_nodes(pbs, merge_func);
+            auto groups = default_merge_node_indices(pbs, node_id_by_type(pbs.graph()));
+            std::tie(graph, root_node, old_to_new) = merge_nodes(
+                pbs.m_graph,
+                pbs.m_root_node,
+                groups
+            );
         }
-        merge_edges(pbs.graph(), graph, old_to_new);
+        merge_edges(pbs.m_graph, graph, old_to_new);
         auto conflicts = merge_conflicts(pbs.conflicts(), old_to_new);
         return { std::move(graph), std::move(conflicts), root_node };
     }
@@ -31,13 +31,48 @@ namespace mamba
 {
     namespace
     {
-        static std::regex const MAMBA_INITIALIZE_RE_BLOCK("\n?# >>> mamba initialize >>>(?:\n|\r\n)?"
-                                                          "([\\s\\S]*?)"
-                                                          "# <<< mamba initialize <<<(?:\n|\r\n)?");
+        constexpr std::string_view MAMBA_INITIALIZE_BEGIN = "# >>> mamba initialize >>>";
+        constexpr std::string_view MAMBA_INITIALIZE_END = "# <<< mamba initialize <<<";
+        constexpr std::string_view MAMBA_INITIALIZE_PS_BEGIN = "#region mamba initialize";
+        constexpr std::string_view MAMBA_INITIALIZE_PS_END = "#endregion";
 
-        static std::regex const MAMBA_INITIALIZE_PS_RE_BLOCK("\n?#region mamba initialize(?:\n|\r\n)?"
-                                                             "([\\s\\S]*?)"
-                                                             "#endregion(?:\n|\r\n)?");
+        std::size_t skip_line_ending(std::string_view content, std::size_t pos)
+        {
+            if (content.substr(pos, 1) == "\n")
+            {
+                return pos + 1;
+            }
+            if (content.substr(pos, 2) == "\r\n")
+            {
+                return pos + 2;
+            }
+            return pos;
+        }
+
+        /** What ``micromamba shell hook`` outputs, without depending on the calling shell. */
+        std::string static_hook_contents(const std::string& shell)
+        {
+            std::stringstream contents;
+            contents << get_hook_contents(shell) << "\n";
+            if (Context::instance().shell_completion && (shell == "zsh" || shell == "bash"))
+            {
+                contents << data_mamba_completion_posix;
+            }
+            if (Context::instance().auto_activate_base)
+            {
+                // Checked when sourced, as in a `micromamba shell -n <env>`
+                contents << "if [ -z \"${CONDA_PREFIX:-}\" ]; then\n"
+                         << "    micromamba activate base\n"
+                         << "fi\n";
+            }
+            return contents.str();
+        }
+
+        bool use_static_hook(const std::string& shell)
+        {
+            return !on_win && Context::instance().static_shell_hook
+                   && (shell == "bash" || shell == "zsh" || shell == "posix");
+        }
         static std::wregex const
             MAMBA_CMDEXE_HOOK_REGEX(L"(\"[^\"]*?mamba[-_]hook\\.bat\")", std::regex_constants::icase);
 
@@ -279,6 +314,48 @@ namespace mamba
     }
 
 
+    std::string replace_init_blocks(
+        std::string_view content,
+        std::string_view begin_marker,
+        std::string_view end_marker,
+        std::string_view replacement
+    )
+    {
+        std::string result;
+        std::size_t pos = 0;
+        while (true)
+        {
+            std::size_t block_begin = content.find(begin_marker, pos);
+            if (block_begin == std::string_view::npos)
+            {
+                break;
+            }
+            const std::size_t body_begin = skip_line_ending(
+                content,
+                block_begin + begin_marker.size()
+            );
+            const std::size_t block_end = content.find(end_marker, body_begin);
+            if (block_end == std::string_view::npos)
+            {
+                break;
+            }
+            if ((block_begin > pos) && (content[block_begin - 1] == '\n'))
+            {
+                --block_begin;
+            }
+            result.append(content.substr(pos, block_begin - pos));
+            result.append(replacement);
+            pos = skip_line_ending(content, block_end + end_marker.size());
+        }
+        result.append(content.substr(pos));
+        return result;
+    }
+
+    fs::u8path static_hook_path(const fs::u8path& root_prefix)
+    {
+        return root_prefix / "etc" / "profile.d" / "micromamba_static_hook.sh";
+    }
+
     std::string
     rcfile_content(const fs::u8path& env_prefix, const std::string& shell, const fs::u8path& mamba_exe)
     {
@@ -300,6 +377,29 @@ namespace mamba
 
         fs::u8path env_bin = env_prefix / "bin";
 
+        if (use_static_hook(shell))
+        {
+            // Sourced without starting micromamba on each shell startup
+            return fmt::format(
+                "\n"
+                "# >>> mamba initialize >>>\n"
+                "# !! Contents within this block are managed by 'mamba init' !!\n"
+                "export MAMBA_EXE={mamba_exe_path};\n"
+                "export MAMBA_ROOT_PREFIX={root_prefix};\n"
+                "if [ -f {hook_path} ]; then\n"
+                "    . {hook_path}\n"
+                "else\n"
+                R"sh(    alias {mamba_exe_name}="$MAMBA_EXE"  # Fallback on help from mamba activate)sh"
+                "\n"
+                "fi\n"
+                "# <<< mamba initialize <<<\n",
+                fmt::arg("mamba_exe_path", mamba_exe),
+                fmt::arg("mamba_exe_name", mamba_exe.filename().string()),
+                fmt::arg("root_prefix", env_prefix),
+                fmt::arg("hook_path", static_hook_path(env_prefix))
+            );
+        }
+
         // Note that fs::path are already quoted by fmt.
         return fmt::format(
             "\n"
@@ -465,9 +565,14 @@ namespace mamba
             return;
         }
 
-        std::string result = std::regex_replace(rc_content, MAMBA_INITIALIZE_RE_BLOCK, conda_init_content);
+        std::string result = replace_init_blocks(
+            rc_content,
+            MAMBA_INITIALIZE_BEGIN,
+            MAMBA_INITIALIZE_END,
+            conda_init_content
+        );
 
-        if (result.find("# >>> mamba initialize >>>") == std::string::npos)
+        if (result.find(MAMBA_INITIALIZE_BEGIN) == std::string::npos)
         {
             std::ofstream rc_file = open_ofstream(file_path, std::ios::app | std::ios::binary);
             rc_file << conda_init_content;
@@ -507,13 +612,18 @@ namespace mamba
             )
         );
 
-        if (rc_content.find("# >>> mamba initialize >>>") == std::string::npos)
+        if (rc_content.find(MAMBA_INITIALIZE_BEGIN) == std::string::npos)
         {
             LOG_INFO << "No mamba initialize block found, nothing to do.";
             return;
         }
 
-        std::string result = std::regex_replace(rc_content, MAMBA_INITIALIZE_RE_BLOCK, "");
+        std::string result = replace_init_blocks(
+            rc_content,
+            MAMBA_INITIALIZE_BEGIN,
+            MAMBA_INITIALIZE_END,
+            ""
+        );
 
         if (Context::instance().dry_run)
         {
@@ -707,6 +817,12 @@ namespace mamba
             }
             std::ofstream sh_file = open_ofstream(sh_source_path);
             sh_file << data_micromamba_sh;
+
+            if (use_static_hook(shell))
+            {
+                std::ofstream static_hook_file = open_ofstream(static_hook_path(root_prefix));
+                static_hook_file << static_hook_contents(shell);
+            }
         }
         else if (shell == "csh")
         {
@@ -790,6 +906,11 @@ namespace mamba
 
             fs::remove(sh_source_path);
             LOG_INFO << "Removed " << sh_source_path << " file.";
+
+            if (fs::remove(static_hook_path(root_prefix)))
+            {
+                LOG_INFO << "Removed " << static_hook_path(root_prefix) << " file.";
+            }
         }
         else if (shell == "csh")
         {
@@ -866,7 +987,7 @@ namespace mamba
 
         std::string conda_init_content = powershell_contents(conda_prefix);
 
-        bool found_mamba_initialize = profile_content.find("#region mamba initialize")
+        bool found_mamba_initialize = profile_content.find(MAMBA_INITIALIZE_PS_BEGIN)
                                       != std::string::npos;
 
         // Find what content we need to add.
@@ -881,9 +1002,10 @@ namespace mamba
         if (found_mamba_initialize)
         {
             LOG_DEBUG << "Found mamba initialize. Replacing mamba initialize block.";
-            profile_content = std::regex_replace(
+            profile_content = replace_init_blocks(
                 profile_content,
-                MAMBA_INITIALIZE_PS_RE_BLOCK,
+                MAMBA_INITIALIZE_PS_BEGIN,
+                MAMBA_INITIALIZE_PS_END,
                 conda_init_content
             );
         }
@@ -944,7 +1066,12 @@ namespace mamba
             );
         }
 
-        profile_content = std::regex_replace(profile_content, MAMBA_INITIALIZE_PS_RE_BLOCK, "");
+        profile_content = replace_init_blocks(
+            profile_content,
+            MAMBA_INITIALIZE_PS_BEGIN,
+            MAMBA_INITIALIZE_PS_END,
+            ""
+        );
         LOG_DEBUG << "Profile content:\n" << profile_content;
 
         if (Context::instance().dry_run)
@@ -1180,7 +1307,7 @@ namespace mamba
             if (fs::exists(config_path))
             {
                 auto contents = read_contents(config_path);
-                if (contents.find("# >>> mamba initialize >>>") != std::string::npos)
+                if (contents.find(MAMBA_INITIALIZE_BEGIN) != std::string::npos)
                 {
                     result.push_back(shell);
                 }
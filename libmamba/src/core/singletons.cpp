@@ -1,8 +1,10 @@
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <mutex>
 #include <regex>
+#include <thread>
 
 extern "C"
 {
@@ -13,11 +15,15 @@ extern "C"
 #include "mamba/core/channel.hpp"
 #include "mamba/core/context.hpp"
 #include "mamba/core/execution.hpp"
+#include "mamba/core/memory_budget.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/validate.hpp"
 
 #include "spdlog/spdlog.h"
 
+#include "curl.hpp"
+#include "thread_pool.hpp"
+
 
 namespace mamba
 {
@@ -40,7 +46,25 @@ namespace mamba
     {
     public:
 
-        CURLSetup()
+        ~CURLSetup()
+        {
+            if (m_initialized)
+            {
+                curl_global_cleanup();
+            }
+        }
+
+        void init()
+        {
+            std::call_once(m_init_flag, [this] { do_init(); });
+        }
+
+    private:
+
+        std::once_flag m_init_flag;
+        bool m_initialized = false;
+
+        void do_init()
         {
 #ifdef LIBMAMBA_STATIC_DEPS
             CURLsslset sslset_res;
@@ -80,16 +104,18 @@ namespace mamba
             {
                 throw std::runtime_error("failed to initialize curl");
             }
-        }
-
-        ~CURLSetup()
-        {
-            curl_global_cleanup();
+            m_initialized = true;
         }
     };
 
+    // Destroyed after the singletons below, but only initialized when first needed
     static CURLSetup curl_setup;
 
+    void curl::global_init()
+    {
+        curl_setup.init();
+    }
+
     struct MessageLoggerData
     {
         static std::mutex m_mutex;
@@ -104,6 +130,38 @@ namespace mamba
     //--- Concurrency resources / thread-handling
     //------------------------------------------------------------------
 
+    // Destroyed after the main executor below, which waits for the tasks of the pool
+    static std::unique_ptr<ThreadPool> thread_pool;
+    static std::mutex thread_pool_mutex;
+
+    ThreadPool& ThreadPool::instance()
+    {
+        std::scoped_lock lock{ thread_pool_mutex };
+        if (!thread_pool)
+        {
+            thread_pool = std::make_unique<ThreadPool>(
+                std::max(std::thread::hardware_concurrency(), 4u)
+            );
+        }
+        return *thread_pool;
+    }
+
+    void MainExecutor::wait_thread_pool()
+    {
+        std::scoped_lock lock{ thread_pool_mutex };
+        if (thread_pool)
+        {
+            thread_pool->wait_idle();
+        }
+    }
+
+    static MemoryBudget memory_budget;
+
+    MemoryBudget& MemoryBudget::instance()
+    {
+        return memory_budget;
+    }
+
     static std::atomic<MainExecutor*> main_executor{ nullptr };
 
     static std::unique_ptr<MainExecutor> default_executor;
@@ -179,6 +237,9 @@ namespace mamba
 
         static std::unique_ptr<Singleton<Context>> context;
         static std::unique_ptr<Singleton<Console>> console;
+        static std::unique_ptr<Singleton<CURLShareHandle>> curl_share;
+        // Destroyed before the share handle, which cannot be cleaned up while handles use it
+        static std::unique_ptr<Singleton<CURLHandlePool>> curl_handle_pool;
     }
 
     Context& Context::instance()
@@ -191,4 +252,14 @@ namespace mamba
         return singletons::init_once(singletons::console);
     }
 
+    CURLShareHandle& CURLShareHandle::instance()
+    {
+        return singletons::init_once(singletons::curl_share);
+    }
+
+    CURLHandlePool& CURLHandlePool::instance()
+    {
+        return singletons::init_once(singletons::curl_handle_pool);
+    }
+
 }
@@ -4,8 +4,16 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
 #include <sstream>
 #include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
 
 #include <fmt/format.h>
 #include <fmt/ostream.h>
@@ -16,14 +24,21 @@
 #include "mamba/core/channel.hpp"
 #include "mamba/core/context.hpp"
 #include "mamba/core/match_spec.hpp"
+#include "mamba/core/metrics.hpp"
 #include "mamba/core/output.hpp"
+#include "mamba/core/package_cache.hpp"
 #include "mamba/core/package_info.hpp"
 #include "mamba/core/pool.hpp"
 #include "mamba/core/satisfiability_error.hpp"
 #include "mamba/core/solver.hpp"
+#include "mamba/core/tracing.hpp"
+#include "mamba/core/util_scope.hpp"
 #include "solv-cpp/pool.hpp"
 #include "solv-cpp/queue.hpp"
 #include "solv-cpp/solver.hpp"
+#include "solv-cpp/transaction.hpp"
+
+#include "solver_cache.hpp"
 
 namespace mamba
 {
@@ -106,7 +121,7 @@ namespace mamba
         }
 
         MatchSpec modified_spec(ms);
-        const Channel& chan = m_pool.channel_context().make_channel(std::string(solvable->channel()));
+        const Channel& chan = m_pool.channel_context().make_channel(solvable->channel());
         modified_spec.channel = chan.name();
 
         modified_spec.version = solvable->version();
@@ -121,6 +136,8 @@ namespace mamba
 
     void MSolver::add_jobs(const std::vector<std::string>& jobs, int job_flag)
     {
+        auto trace = Tracer::instance().scope("add_jobs");
+        trace.add_counter("specs", jobs.size());
         for (const auto& job : jobs)
         {
             MatchSpec ms{ job, m_pool.channel_context() };
@@ -200,7 +217,36 @@ namespace mamba
         // Therefore, we add a dummy solvable marked as already installed, and add the pin/spec
         // as one of its constrains.
         // Then we lock this solvable and force the re-checking of its dependencies.
+        const auto cons_solv_name = add_pin_solvable(pin);
+
+        // Necessary for attributes to be properly stored
+        m_pool.pool().installed_repo()->internalize();
+
+        // Lock the dummy solvable so that it stays install.
+        // Force verify the dummy solvable dependencies, as this is not the default for
+        // installed packages.
+        return add_jobs({ cons_solv_name }, SOLVER_LOCK & SOLVER_VERIFY);
+    }
+
+    void MSolver::add_pins(const std::vector<std::string>& pins)
+    {
+        if (pins.empty())
+        {
+            return;
+        }
+        // As with ``add_pin``, with the repo internalized and the jobs added once for all
+        auto names = std::vector<std::string>();
+        names.reserve(pins.size());
+        for (const auto& pin : pins)
+        {
+            names.push_back(add_pin_solvable(pin));
+        }
+        m_pool.pool().installed_repo()->internalize();
+        add_jobs(names, SOLVER_LOCK & SOLVER_VERIFY);
+    }
 
+    auto MSolver::add_pin_solvable(const std::string& pin) -> std::string
+    {
         const auto pin_ms = MatchSpec{ pin, m_pool.channel_context() };
         m_pinned_specs.push_back(pin_ms);
 
@@ -225,22 +271,7 @@ namespace mamba
 
         // Solvable need to provide itself
         cons_solv.add_self_provide();
-
-        // Necessary for attributes to be properly stored
-        installed->internalize();
-
-        // Lock the dummy solvable so that it stays install.
-        // Force verify the dummy solvable dependencies, as this is not the default for
-        // installed packages.
-        return add_jobs({ cons_solv_name }, SOLVER_LOCK & SOLVER_VERIFY);
-    }
-
-    void MSolver::add_pins(const std::vector<std::string>& pins)
-    {
-        for (auto pin : pins)
-        {
-            add_pin(pin);
-        }
+        return cons_solv_name;
     }
 
     void MSolver::py_set_postsolve_flags(const std::vector<std::pair<int, int>>& flags)
@@ -286,6 +317,13 @@ namespace mamba
         }
     }
 
+    void MSolver::reset_solver()
+    {
+        m_solver = std::make_unique<solv::ObjSolver>(m_pool.pool());
+        m_cached_decision = nullptr;
+        apply_libsolv_flags();
+    }
+
     bool MSolver::is_solved() const
     {
         return m_is_solved;
@@ -326,15 +364,289 @@ namespace mamba
         return m_pinned_specs;
     }
 
+    auto MSolver::cached_decision() const -> const solv::ObjQueue*
+    {
+        return m_cached_decision.get();
+    }
+
+    namespace
+    {
+        auto solve_seconds() -> MetricHistogram&
+        {
+            static auto& histogram = Metrics::instance().histogram(
+                "mamba_solve_seconds",
+                "Time of the solves, including those answered by the solver cache"
+            );
+            return histogram;
+        }
+
+        auto failed_solves() -> MetricCounter&
+        {
+            static auto& counter = Metrics::instance().counter(
+                "mamba_solve_failures_total",
+                "Solves without a solution"
+            );
+            return counter;
+        }
+
+        auto solver_cache_dir() -> std::optional<fs::u8path>
+        {
+            auto caches = MultiPackageCache(Context::instance().pkgs_dirs);
+            if (auto dir = caches.first_writable_path(); !dir.empty())
+            {
+                return { dir / "cache" / "solver" };
+            }
+            return std::nullopt;
+        }
+
+        /**
+         * The decisions needed to recreate the transaction of the solver.
+         *
+         * These are the packages in the solution, and the installed packages that are removed.
+         * The transaction created from them must be the same as the one of the solver.
+         */
+        auto reusable_decision(const solv::ObjPool& pool, const solv::ObjSolver& solver)
+            -> std::optional<solv::ObjQueue>
+        {
+            auto all_decisions = solv::ObjQueue();
+            solver_get_decisionqueue(const_cast<::Solver*>(solver.raw()), all_decisions.raw());
+
+            auto decision = solv::ObjQueue();
+            for (auto id : all_decisions)
+            {
+                if (id == SYSTEMSOLVABLE)
+                {
+                    continue;
+                }
+                if (id > 0)
+                {
+                    decision.push_back(id);
+                }
+                else if (auto s = pool.get_solvable(-id); s.has_value() && s->installed())
+                {
+                    decision.push_back(id);
+                }
+            }
+
+            auto sorted_steps = [](const solv::ObjTransaction& trans)
+            {
+                auto steps = trans.steps();
+                std::sort(steps.begin(), steps.end());
+                return steps;
+            };
+            const auto expected = solv::ObjTransaction::from_solver(pool, solver);
+            const auto actual = solv::ObjTransaction::from_solvables(pool, decision);
+            if (sorted_steps(expected) != sorted_steps(actual))
+            {
+                return std::nullopt;
+            }
+            return { std::move(decision) };
+        }
+    }
+
+    namespace
+    {
+        /**
+         * The names of the packages that the jobs on the packages named @p names can change.
+         *
+         * These are the given names, the names of the installed packages requiring one of them, as
+         * they may have to change with the packages they require, and transitively the names of
+         * the dependencies of any package with one of these names.
+         */
+        auto related_names(
+            const solv::ObjPool& pool,
+            const std::unordered_set<std::string>& requested
+        ) -> std::unordered_set<std::string_view>
+        {
+            auto out = std::unordered_set<std::string_view>();
+            auto todo = std::vector<std::string_view>();
+            auto add = [&](std::string_view name)
+            {
+                if (out.insert(name).second)
+                {
+                    todo.push_back(name);
+                }
+            };
+            for (const auto& name : requested)
+            {
+                if (const auto id = pool.find_string(name); id.has_value())
+                {
+                    add(pool.get_string(id.value()));
+                }
+            }
+            pool.for_each_installed_solvable(
+                [&](solv::ObjSolvableViewConst s)
+                {
+                    for (const auto dep : s.dependencies())
+                    {
+                        if (requested.count(std::string(pool.get_dependency_name(dep))) > 0)
+                        {
+                            add(s.name());
+                            break;
+                        }
+                    }
+                }
+            );
+
+            while (!todo.empty())
+            {
+                const auto name = todo.back();
+                todo.pop_back();
+                const auto name_id = pool.find_string(name);
+                if (!name_id.has_value())
+                {
+                    continue;
+                }
+                pool.for_each_whatprovides(
+                    name_id.value(),
+                    [&](solv::ObjSolvableViewConst s)
+                    {
+                        for (const auto dep : s.dependencies())
+                        {
+                            add(pool.get_dependency_name(dep));
+                        }
+                    }
+                );
+            }
+            return out;
+        }
+    }
+
+    auto MSolver::add_minimal_change_jobs(solv::ObjQueue& jobs) const -> std::size_t
+    {
+        // Nothing is unrelated to updating all the packages
+        for (std::size_t i = 0; i + 1 < m_jobs->size(); i += 2)
+        {
+            if (((*m_jobs)[i] & SOLVER_SELECTMASK) == SOLVER_SOLVABLE_ALL)
+            {
+                return 0;
+            }
+        }
+        if (m_install_specs.empty())
+        {
+            return 0;
+        }
+
+        auto requested = std::unordered_set<std::string>();
+        for (const auto* spec_list : { &m_install_specs, &m_remove_specs })
+        {
+            for (const auto& ms : *spec_list)
+            {
+                requested.insert(ms.name);
+            }
+        }
+        const auto& pool = m_pool.pool();
+        const auto related = related_names(pool, requested);
+        std::size_t n_locked = 0;
+        pool.for_each_installed_solvable(
+            [&](solv::ObjSolvableViewConst s)
+            {
+                if (related.count(s.name()) == 0)
+                {
+                    jobs.push_back(SOLVER_LOCK | SOLVER_SOLVABLE, s.id());
+                    ++n_locked;
+                }
+            }
+        );
+        return n_locked;
+    }
+
     bool MSolver::try_solve()
     {
-        m_solver = std::make_unique<solv::ObjSolver>(m_pool.pool());
-        apply_libsolv_flags();
+        auto trace = Tracer::instance().scope("solve");
+        const auto start = MetricHistogram::clock::now();
+        auto observe = on_scope_exit([&] { solve_seconds().observe_since(start); });
+        reset_solver();
+
+        auto cache = std::optional<SolverCache>();
+        auto cache_key = std::string();
+        if (Context::instance().solver_cache)
+        {
+            if (auto dir = solver_cache_dir(); dir.has_value())
+            {
+                auto specs = std::vector<std::string>();
+                for (const auto* spec_list :
+                     { &m_install_specs, &m_remove_specs, &m_neuter_specs, &m_pinned_specs })
+                {
+                    specs.push_back(fmt::format("{}", spec_list->size()));
+                    for (const auto& ms : *spec_list)
+                    {
+                        specs.push_back(ms.str());
+                    }
+                }
+                if (m_flags.minimal_change)
+                {
+                    specs.push_back("minimal_change");
+                }
+                cache.emplace(std::move(dir).value());
+                cache_key = SolverCache::make_key(m_pool.pool(), *m_jobs, m_libsolv_flags, specs);
+                if (auto decision = cache->load(cache_key, m_pool.pool()); decision.has_value())
+                {
+                    m_cached_decision = std::make_unique<solv::ObjQueue>(std::move(decision).value()
+                    );
+                    m_is_solved = true;
+                    trace.add_counter("cache_hit", 1);
+                    trace.add_counter("decisions", m_cached_decision->size());
+                    Console::instance().json_write({ { "success", true } });
+                    return true;
+                }
+            }
+        }
 
-        const bool success = solver().solve(m_pool.pool(), *m_jobs);
-        m_is_solved = true;
+        std::size_t n_locked = 0;
+        const bool success = solve_jobs(n_locked);
+        if (m_flags.minimal_change)
+        {
+            trace.add_counter("locked", n_locked);
+        }
         LOG_INFO << "Problem count: " << solver().problem_count();
+        trace.add_counter("solvables", m_pool.pool().solvable_count());
+        trace.add_counter("package_rules", solver().package_rule_count());
+        trace.add_counter("decisions", solver().decision_count());
+        trace.add_counter("problems", solver().problem_count());
         Console::instance().json_write({ { "success", success } });
+        if (!success)
+        {
+            failed_solves().add();
+        }
+
+        if (success && cache.has_value())
+        {
+            if (auto decision = reusable_decision(m_pool.pool(), solver()); decision.has_value())
+            {
+                cache->store(cache_key, m_pool.pool(), decision.value());
+            }
+            else
+            {
+                LOG_INFO << "Solver decisions cannot be cached for this transaction";
+            }
+        }
+        return success;
+    }
+
+    auto MSolver::solve_jobs(std::size_t& n_locked) -> bool
+    {
+        auto success = false;
+        if (m_flags.minimal_change)
+        {
+            auto jobs = *m_jobs;
+            n_locked = add_minimal_change_jobs(jobs);
+            if (n_locked > 0)
+            {
+                LOG_INFO << "Locking " << n_locked << " installed packages unrelated to the specs";
+                success = solver().solve(m_pool.pool(), jobs);
+                if (!success)
+                {
+                    LOG_INFO << "No solution keeping the unrelated packages, solving again";
+                    reset_solver();
+                }
+            }
+        }
+        if (!success)
+        {
+            success = solver().solve(m_pool.pool(), *m_jobs);
+        }
+        m_is_solved = true;
         return success;
     }
 
@@ -343,7 +655,7 @@ namespace mamba
         const bool success = try_solve();
         if (!success)
         {
-            explain_problems(LOG_ERROR);
+            LOG_ERROR << explain_problems();
             throw mamba_error(
                 "Could not solve for environment specs",
                 mamba_error_code::satisfiablitity_error
@@ -428,9 +740,62 @@ namespace mamba
     {
         const auto& ctx = Context::instance();
         out << "Could not solve for environment specs\n";
-        const auto pbs = problems_graph();
-        const auto pbs_simplified = simplify_conflicts(pbs);
-        const auto cp_pbs = CompressedProblemsGraph::from_problems_graph(pbs_simplified);
+
+        // The explanation is checked against its budget between stages, falling back to the
+        // problems as reported by libsolv, since the stages grow quickly with the conflicts.
+        const auto start = std::chrono::steady_clock::now();
+        const auto timeout = std::chrono::seconds(ctx.explain_problems_timeout);
+        const auto max_nodes = ctx.explain_problems_max_nodes;
+        const auto exceeds_budget =
+            [&](std::string_view stage, std::size_t size, std::string_view unit) -> bool
+        {
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            std::string reason = {};
+            if ((max_nodes > 0) && (size > max_nodes))
+            {
+                reason = fmt::format("{} {}, more than {}", size, unit, max_nodes);
+            }
+            else if ((timeout.count() > 0) && (elapsed > timeout))
+            {
+                reason = fmt::format("more than {}s", timeout.count());
+            }
+            if (reason.empty())
+            {
+                return false;
+            }
+            LOG_WARNING << "Conflict explanation budget exceeded by " << stage << " (" << reason
+                        << ")";
+            out << "The conflicts are too large to be explained (" << stage << ": " << reason
+                << ").\n"
+                << problems_to_str();
+            return true;
+        };
+
+        // The graph has about one node per rule, so the largest conflicts are detected before
+        // the graph is built.
+        std::size_t n_rules = 0;
+        solver().for_each_problem_id([&](solv::ProblemId pb)
+                                     { n_rules += solver().problem_rules(pb).size(); });
+        if (exceeds_budget("solver problems", n_rules, "rules"))
+        {
+            return out;
+        }
+        auto pbs = problems_graph();
+        if (exceeds_budget("problems graph", pbs.graph().number_of_nodes(), "nodes"))
+        {
+            return out;
+        }
+        // Each step moves the nodes of the previous graph rather than copying them
+        pbs = simplify_conflicts(std::move(pbs));
+        if (exceeds_budget("conflicts simplification", pbs.graph().number_of_nodes(), "nodes"))
+        {
+            return out;
+        }
+        const auto cp_pbs = CompressedProblemsGraph::from_problems_graph(std::move(pbs));
+        if (exceeds_budget("graph compression", cp_pbs.graph().number_of_nodes(), "nodes"))
+        {
+            return out;
+        }
         print_problem_tree_msg(
             out,
             cp_pbs,
@@ -565,9 +930,19 @@ namespace mamba
             for (const auto& solv_id : m_pool.select_solvables(dep_id))
             {
                 added = true;
-                auto pkg_info = m_pool.id2pkginfo(solv_id);
-                assert(pkg_info.has_value());
-                node_id to_id = add_solvable(solv_id, PackageNode{ std::move(pkg_info).value() }, false);
+                // Large conflicts expand the same dependencies many times, building the
+                // PackageInfo is avoided for solvables that already have a node.
+                auto to_id = node_id();
+                if (const auto iter = m_solv2node.find(solv_id); iter != m_solv2node.end())
+                {
+                    to_id = iter->second;
+                }
+                else
+                {
+                    auto pkg_info = m_pool.id2pkginfo(solv_id);
+                    assert(pkg_info.has_value());
+                    to_id = add_solvable(solv_id, PackageNode{ std::move(pkg_info).value() });
+                }
                 m_graph.add_edge(from_id, to_id, edge);
             }
             return added;
@@ -763,4 +1138,173 @@ namespace mamba
         return ProblemsGraphCreator(*this, m_pool).problem_graph();
     }
 
+    /***********************************
+     * SolverPortfolio implementation *
+     ***********************************/
+
+    struct SolverPortfolio::Race
+    {
+        /** The solvers in order of preference, not resized once the race started. */
+        std::vector<MSolver> solvers = {};
+        std::mutex mutex = {};
+        std::condition_variable finished = {};
+        /** Whether each solver found a solution, once it is done. */
+        std::vector<std::optional<bool>> results = {};
+        std::optional<std::size_t> kept = std::nullopt;
+    };
+
+    auto SolverPortfolio::default_strategies(const flag_list& flags) -> std::vector<flag_list>
+    {
+        auto strategies = std::vector<flag_list>{ flags };
+        // Heuristics only, off by default in libsolv
+        for (const int flag : { SOLVER_FLAG_FOCUS_BEST, SOLVER_FLAG_FOCUS_INSTALLED })
+        {
+            auto out = flags;
+            auto it = std::find_if(
+                out.begin(),
+                out.end(),
+                [flag](const auto& f) { return f.first == flag; }
+            );
+            if (it == out.end())
+            {
+                out.emplace_back(flag, 1);
+            }
+            else if (it->second == 0)
+            {
+                it->second = 1;
+            }
+            else
+            {
+                // Already the configured flags
+                continue;
+            }
+            strategies.push_back(std::move(out));
+        }
+        return strategies;
+    }
+
+    SolverPortfolio::SolverPortfolio(
+        MPool pool,
+        const std::vector<flag_list>& strategies,
+        const setup_func& setup
+    )
+        : m_race(std::make_unique<Race>())
+    {
+        if (strategies.empty())
+        {
+            throw std::invalid_argument("A solver portfolio needs at least one strategy");
+        }
+
+        // All forked before the solvers add their pins to the pools, and the given pool is not
+        // used by the solvers still running once the portfolio is destroyed
+        auto trace = Tracer::instance().scope("fork solver pools");
+        auto pools = std::vector<MPool>();
+        for (std::size_t i = 0; i < strategies.size(); ++i)
+        {
+            pools.push_back(pool.fork());
+        }
+        trace.add_counter("strategies", strategies.size());
+
+        auto& solvers = m_race->solvers;
+        solvers.reserve(strategies.size());
+        for (std::size_t i = 0; i < strategies.size(); ++i)
+        {
+            solvers.emplace_back(std::move(pools[i]), strategies[i]);
+            setup(solvers.back());
+            solvers.back().reset_solver();
+        }
+        m_race->results.resize(solvers.size());
+    }
+
+    SolverPortfolio::~SolverPortfolio()
+    {
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    bool SolverPortfolio::try_solve()
+    {
+        auto& race = *m_race;
+        if (race.kept.has_value())
+        {
+            return race.results[race.kept.value()].value();
+        }
+
+        auto trace = Tracer::instance().scope("solve portfolio");
+        const auto start = MetricHistogram::clock::now();
+        for (std::size_t i = 0; i < race.solvers.size(); ++i)
+        {
+            // The losers are only waited for when the portfolio is destroyed
+            m_threads.emplace_back(
+                [&race, i]()
+                {
+                    auto success = false;
+                    try
+                    {
+                        std::size_t n_locked = 0;
+                        success = race.solvers[i].solve_jobs(n_locked);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        LOG_WARNING << "Solver strategy " << i << " failed: " << e.what();
+                    }
+                    {
+                        auto lock = std::lock_guard(race.mutex);
+                        race.results[i] = success;
+                    }
+                    race.finished.notify_all();
+                }
+            );
+        }
+
+        {
+            auto lock = std::unique_lock(race.mutex);
+            race.finished.wait(
+                lock,
+                [&race]()
+                {
+                    const auto& results = race.results;
+                    return results.front().has_value()
+                           || std::any_of(
+                               results.cbegin(),
+                               results.cend(),
+                               [](const auto& res) { return res.value_or(false); }
+                           );
+                }
+            );
+            // The answer of the configured strategy, or the preferred of the solutions found
+            const auto it = std::find(race.results.cbegin(), race.results.cend(), true);
+            race.kept = (race.results.front().has_value() || (it == race.results.cend()))
+                            ? 0
+                            : static_cast<std::size_t>(it - race.results.cbegin());
+        }
+
+        auto& kept = race.solvers[race.kept.value()];
+        const bool success = race.results[race.kept.value()].value();
+        LOG_INFO << "Kept solver strategy " << race.kept.value() << " of "
+                 << race.solvers.size();
+        LOG_INFO << "Problem count: " << kept.solver().problem_count();
+        trace.add_counter("strategy", race.kept.value());
+        trace.add_counter("decisions", kept.solver().decision_count());
+        Console::instance().json_write({ { "success", success } });
+        solve_seconds().observe_since(start);
+        if (!success)
+        {
+            failed_solves().add();
+        }
+        return success;
+    }
+
+    auto SolverPortfolio::solver() -> MSolver&
+    {
+        return m_race->solvers[strategy()];
+    }
+
+    auto SolverPortfolio::strategy() const -> std::size_t
+    {
+        return m_race->kept.value_or(0);
+    }
+
 }  // namespace mamba
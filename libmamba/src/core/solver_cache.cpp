@@ -0,0 +1,249 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+#include <solv/pool.h>
+#include <solv/repo.h>
+#include <solv/solver.h>
+
+#include "mamba/core/output.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/validate.hpp"
+#include "solv-cpp/pool.hpp"
+#include "solv-cpp/repo.hpp"
+#include "solv-cpp/solvable.hpp"
+
+#include "solver_cache.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        /** Bump when the content of the key or of the entries changes. */
+        constexpr int solver_cache_version = 1;
+
+        class KeyHasher
+        {
+        public:
+
+            void add(std::string_view str)
+            {
+                // Prefix with the size so that consecutive strings cannot be confused
+                add(static_cast<std::int64_t>(str.size()));
+                m_hash.update(str.data(), str.size());
+            }
+
+            void add(std::int64_t val)
+            {
+                const auto str = fmt::format("{};", val);
+                m_hash.update(str.data(), str.size());
+            }
+
+            auto hex_digest() -> std::string
+            {
+                return m_hash.hex_digest();
+            }
+
+        private:
+
+            validation::HashStream m_hash = validation::HashStream::sha256();
+        };
+
+        void add_deps(KeyHasher& hasher, const solv::ObjPool& pool, const solv::ObjQueue& deps)
+        {
+            hasher.add(static_cast<std::int64_t>(deps.size()));
+            for (auto dep : deps)
+            {
+                hasher.add(pool.dependency_to_string(dep));
+            }
+        }
+
+        void add_repo(KeyHasher& hasher, const solv::ObjPool& pool, solv::ObjRepoViewConst repo)
+        {
+            hasher.add(repo.name());
+            hasher.add(repo.url());
+            hasher.add(repo.raw()->priority);
+            hasher.add(repo.raw()->subpriority);
+            hasher.add(static_cast<std::int64_t>(repo.solvable_count()));
+            const auto installed = pool.installed_repo();
+            hasher.add(installed.has_value() && (installed->id() == repo.id()));
+
+            // The metadata identify the repodata the repo was read from
+            if (!repo.etag().empty() || !repo.mod().empty())
+            {
+                hasher.add(repo.etag());
+                hasher.add(repo.mod());
+                hasher.add(repo.pip_added());
+                return;
+            }
+            repo.for_each_solvable(
+                [&](solv::ObjSolvableViewConst s)
+                {
+                    hasher.add(s.name());
+                    hasher.add(s.version());
+                    hasher.add(s.build_string());
+                    hasher.add(static_cast<std::int64_t>(s.build_number()));
+                    hasher.add(s.url());
+                    hasher.add(s.channel());
+                    hasher.add(static_cast<std::int64_t>(s.timestamp()));
+                    add_deps(hasher, pool, s.dependencies());
+                    add_deps(hasher, pool, s.constraints());
+                    add_deps(hasher, pool, s.track_features());
+                }
+            );
+        }
+
+        auto solvable_repr(solv::ObjSolvableViewConst s) -> std::string
+        {
+            return fmt::format("{}-{}-{}", s.name(), s.version(), s.build_string());
+        }
+    }
+
+    auto SolverCache::make_key(
+        const solv::ObjPool& pool,
+        const solv::ObjQueue& jobs,
+        const std::vector<std::pair<int, int>>& solver_flags,
+        const std::vector<std::string>& specs
+    ) -> std::string
+    {
+        auto hasher = KeyHasher();
+        hasher.add(solver_cache_version);
+
+        hasher.add(static_cast<std::int64_t>(pool.repo_count()));
+        pool.for_each_repo([&](solv::ObjRepoViewConst repo) { add_repo(hasher, pool, repo); });
+
+        hasher.add(static_cast<std::int64_t>(jobs.size()));
+        for (std::size_t i = 0; i + 1 < jobs.size(); i += 2)
+        {
+            const auto how = jobs[i];
+            const auto what = jobs[i + 1];
+            hasher.add(how);
+            const auto select = how & SOLVER_SELECTMASK;
+            if ((select == SOLVER_SOLVABLE_PROVIDES) || (select == SOLVER_SOLVABLE_NAME))
+            {
+                hasher.add(pool.dependency_to_string(what));
+            }
+            else
+            {
+                hasher.add(what);
+            }
+        }
+
+        hasher.add(static_cast<std::int64_t>(solver_flags.size()));
+        for (const auto& [flag, value] : solver_flags)
+        {
+            hasher.add(flag);
+            hasher.add(value);
+        }
+
+        hasher.add(static_cast<std::int64_t>(specs.size()));
+        for (const auto& spec : specs)
+        {
+            hasher.add(spec);
+        }
+        return hasher.hex_digest();
+    }
+
+    SolverCache::SolverCache(fs::u8path cache_dir)
+        : m_cache_dir(std::move(cache_dir))
+    {
+    }
+
+    auto SolverCache::entry_path(const std::string& key) const -> fs::u8path
+    {
+        return m_cache_dir / (key + ".json");
+    }
+
+    auto SolverCache::load(const std::string& key, const solv::ObjPool& pool) const
+        -> std::optional<solv::ObjQueue>
+    {
+        const auto path = entry_path(key);
+        if (!fs::exists(path))
+        {
+            return std::nullopt;
+        }
+
+        try
+        {
+            auto in = open_ifstream(path);
+            const auto entry = nlohmann::json::parse(in);
+            if (entry.at("version").get<int>() != solver_cache_version)
+            {
+                return std::nullopt;
+            }
+
+            auto decision = solv::ObjQueue();
+            for (const auto& item : entry.at("decision"))
+            {
+                const auto id = item.at(0).get<solv::SolvableId>();
+                const auto solvable = pool.get_solvable(std::abs(id));
+                const auto repr = item.at(1).get<std::string>();
+                if (!solvable.has_value() || (solvable_repr(*solvable) != repr))
+                {
+                    LOG_INFO << "Solver cache entry " << path << " does not match the pool";
+                    return std::nullopt;
+                }
+                decision.push_back(id);
+            }
+            LOG_INFO << "Using solver cache entry " << path;
+            return { std::move(decision) };
+        }
+        catch (const std::exception& e)
+        {
+            LOG_WARNING << "Could not read solver cache entry " << path << ": " << e.what();
+            return std::nullopt;
+        }
+    }
+
+    void SolverCache::store(
+        const std::string& key,
+        const solv::ObjPool& pool,
+        const solv::ObjQueue& decision
+    ) const
+    {
+        auto items = nlohmann::json::array();
+        for (auto id : decision)
+        {
+            const auto solvable = pool.get_solvable(std::abs(id));
+            if (!solvable.has_value())
+            {
+                return;
+            }
+            items.push_back({ id, solvable_repr(*solvable) });
+        }
+        const auto entry = nlohmann::json{
+            { "version", solver_cache_version },
+            { "decision", std::move(items) },
+        };
+
+        try
+        {
+            fs::create_directories(m_cache_dir);
+            // Write to a temporary file so that concurrent readers never see a partial entry
+            auto tmp_file = TemporaryFile("mambaf", ".json", m_cache_dir);
+            {
+                auto out = open_ofstream(tmp_file.path());
+                out << entry.dump();
+                if (!out.flush())
+                {
+                    throw std::runtime_error("could not write " + tmp_file.path().string());
+                }
+            }
+            fs::rename(tmp_file.path(), entry_path(key));
+            LOG_INFO << "Stored solver cache entry " << entry_path(key);
+        }
+        catch (const std::exception& e)
+        {
+            LOG_WARNING << "Could not store solver cache entry " << entry_path(key) << ": "
+                        << e.what();
+        }
+    }
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_SOLVER_CACHE_HPP
+#define MAMBA_CORE_SOLVER_CACHE_HPP
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mamba/core/mamba_fs.hpp"
+#include "solv-cpp/queue.hpp"
+
+namespace mamba::solv
+{
+    class ObjPool;
+}
+
+namespace mamba
+{
+    /**
+     * An on disk cache of the decisions of the solver.
+     *
+     * Solving the same jobs on the same pool always gives the same decisions, which can then
+     * be reused instead of running the solver again.
+     * Each entry is a file named after a key computed from the repos loaded in the pool, the
+     * jobs and the solver flags.
+     */
+    class SolverCache
+    {
+    public:
+
+        /**
+         * Compute the key of a solve.
+         *
+         * Repos are identified by their url, etag and last modified time when they have some,
+         * and by the content of their solvables otherwise, such as for the installed repo.
+         * Jobs are identified by their dependency string, and @p specs are also added to
+         * cover the specs that are not part of the jobs, such as pins.
+         */
+        static auto make_key(
+            const solv::ObjPool& pool,
+            const solv::ObjQueue& jobs,
+            const std::vector<std::pair<int, int>>& solver_flags,
+            const std::vector<std::string>& specs
+        ) -> std::string;
+
+        explicit SolverCache(fs::u8path cache_dir);
+
+        /**
+         * Load the decisions of previous solve.
+         *
+         * Decisions are returned only if all of their solvables are in the pool, with the same
+         * package as when they were stored.
+         */
+        auto load(const std::string& key, const solv::ObjPool& pool) const
+            -> std::optional<solv::ObjQueue>;
+
+        /** Store decisions, failures are only logged as they do not prevent solving. */
+        void store(
+            const std::string& key,
+            const solv::ObjPool& pool,
+            const solv::ObjQueue& decision
+        ) const;
+
+    private:
+
+        fs::u8path m_cache_dir;
+
+        auto entry_path(const std::string& key) const -> fs::u8path;
+    };
+}
+
+#endif
@@ -4,16 +4,23 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <iterator>
 #include <stdexcept>
+#include <utility>
 
 #include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/metrics.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/package_cache.hpp"
 #include "mamba/core/subdirdata.hpp"
 #include "mamba/core/url.hpp"
+#include "mamba/core/util_scope.hpp"
 #include "mamba/core/util_string.hpp"
 
+#include "jlap.hpp"
 #include "progress_bar_impl.hpp"
+#include "repodata_index.hpp"
 
 namespace mamba
 {
@@ -36,6 +43,32 @@ namespace mamba
             j["has_zst"]["value"] = has_zst.value().value;
             j["has_zst"]["last_checked"] = timestamp(has_zst.value().last_checked);
         }
+        if (has_jlap.has_value())
+        {
+            j["has_jlap"]["value"] = has_jlap.value().value;
+            j["has_jlap"]["last_checked"] = timestamp(has_jlap.value().last_checked);
+        }
+        if (has_index.has_value())
+        {
+            j["has_index"]["value"] = has_index.value().value;
+            j["has_index"]["last_checked"] = timestamp(has_index.value().last_checked);
+        }
+        if (!repodata_hash.empty())
+        {
+            j["blake2_256"] = repodata_hash;
+        }
+        if (!jlap_iv.empty())
+        {
+            j["jlap"]["iv"] = jlap_iv;
+            j["jlap"]["pos"] = jlap_pos;
+        }
+        if (verified.has_value())
+        {
+            j["verified"]["etag"] = verified->etag;
+            j["verified"]["blake2_256"] = verified->repodata_hash;
+            j["verified"]["size"] = verified->file_size;
+            j["verified"]["root_version"] = verified->root_version;
+        }
         out << j.dump(4);
     }
 
@@ -85,6 +118,20 @@ namespace mamba
     }
 #endif
 
+    bool subdir_metadata::is_index_verified(std::size_t root_version) const
+    {
+        // Without etag nor hash, the size is not enough to identify the content
+        return verified.has_value() && (!etag.empty() || !repodata_hash.empty())
+               && (verified->etag == etag) && (verified->repodata_hash == repodata_hash)
+               && (verified->file_size == stored_file_size)
+               && (verified->root_version == root_version);
+    }
+
+    void subdir_metadata::set_index_verified(std::size_t root_version)
+    {
+        verified = { etag, repodata_hash, stored_file_size, root_version };
+    }
+
     void subdir_metadata::store_file_metadata(const fs::u8path& file)
     {
 #ifndef _WIN32
@@ -140,6 +187,35 @@ namespace mamba
                     parse_utc_timestamp(j["has_zst"]["last_checked"].get<std::string>(), err_code)
                 };
             }
+            if (j.find("has_jlap") != j.end())
+            {
+                m.has_jlap = {
+                    j["has_jlap"]["value"].get<bool>(),
+                    parse_utc_timestamp(j["has_jlap"]["last_checked"].get<std::string>(), err_code)
+                };
+            }
+            if (j.find("has_index") != j.end())
+            {
+                m.has_index = {
+                    j["has_index"]["value"].get<bool>(),
+                    parse_utc_timestamp(j["has_index"]["last_checked"].get<std::string>(), err_code)
+                };
+            }
+            m.repodata_hash = j.value("blake2_256", "");
+            if (j.find("jlap") != j.end())
+            {
+                m.jlap_iv = j["jlap"]["iv"].get<std::string>();
+                m.jlap_pos = j["jlap"]["pos"].get<std::size_t>();
+            }
+            if (j.find("verified") != j.end())
+            {
+                m.verified = {
+                    j["verified"]["etag"].get<std::string>(),
+                    j["verified"]["blake2_256"].get<std::string>(),
+                    j["verified"]["size"].get<std::size_t>(),
+                    j["verified"]["root_version"].get<std::size_t>(),
+                };
+            }
         }
         catch (const std::exception& e)
         {
@@ -201,9 +277,8 @@ namespace mamba
             // "_etag": "W/\"6092e6a2b6cec6ea5aade4e177c3edda-8\"",
             // "_mod": "Sat, 04 Apr 2020 03:29:49 GMT",
             // "_cache_control": "public, max-age=1200"
-            auto extract_subjson = [](std::ifstream& s) -> std::string
+            auto extract_subjson = [](std::string_view s) -> std::string
             {
-                char next = {};
                 std::string result = {};
                 bool escaped = false;
                 int i = 0, N = 4;
@@ -212,7 +287,7 @@ namespace mamba
                 bool in_key = false;
                 std::string key = "";
 
-                while (s.get(next))
+                for (const char next : s)
                 {
                     idx++;
                     if (next == '"')
@@ -269,8 +344,15 @@ namespace mamba
                 return std::string();
             };
 
-            std::ifstream in_file = open_ifstream(file);
-            auto json = extract_subjson(in_file);
+            // The header is read from a bounded prefix, in a single read rather than char by char
+            static constexpr std::size_t header_prefix_size = 4096;
+            auto prefix = std::string(header_prefix_size, '\0');
+            {
+                std::ifstream in_file = open_ifstream(file);
+                in_file.read(prefix.data(), static_cast<std::streamsize>(prefix.size()));
+                prefix.resize(static_cast<std::size_t>(in_file.gcount()));
+            }
+            auto json = extract_subjson(prefix);
 
             nlohmann::json result;
             try
@@ -340,6 +422,7 @@ namespace mamba
     {
         m_json_fn = cache_fn_url(m_repodata_url);
         m_solv_fn = m_json_fn.substr(0, m_json_fn.size() - 4) + "solv";
+        m_index_fn = m_json_fn.substr(0, m_json_fn.size() - 4) + "index";
         load(caches, channel_context);
     }
 
@@ -350,18 +433,23 @@ namespace mamba
         , m_solv_cache_valid(rhs.m_solv_cache_valid)
         , m_valid_cache_path(std::move(rhs.m_valid_cache_path))
         , m_expired_cache_path(std::move(rhs.m_expired_cache_path))
+        , m_local_repodata(std::move(rhs.m_local_repodata))
         , m_writable_pkgs_dir(std::move(rhs.m_writable_pkgs_dir))
         , m_progress_bar(std::move(rhs.m_progress_bar))
-        , m_progress_bar_check(std::move(rhs.m_progress_bar_check))
         , m_loaded(rhs.m_loaded)
+        , m_stale(rhs.m_stale)
         , m_download_complete(rhs.m_download_complete)
         , m_repodata_url(std::move(rhs.m_repodata_url))
         , m_name(std::move(rhs.m_name))
         , m_json_fn(std::move(rhs.m_json_fn))
         , m_solv_fn(std::move(rhs.m_solv_fn))
+        , m_index_fn(std::move(rhs.m_index_fn))
         , m_is_noarch(rhs.m_is_noarch)
         , m_metadata(std::move(rhs.m_metadata))
         , m_temp_file(std::move(rhs.m_temp_file))
+        , m_jlap_temp_file(std::move(rhs.m_jlap_temp_file))
+        , m_records_update(std::move(rhs.m_records_update))
+        , m_fetch_lock(std::move(rhs.m_fetch_lock))
         , p_channel(rhs.p_channel)
     {
         if (m_target != nullptr)
@@ -382,18 +470,23 @@ namespace mamba
         swap(m_solv_cache_valid, rhs.m_solv_cache_valid);
         swap(m_valid_cache_path, rhs.m_valid_cache_path);
         swap(m_expired_cache_path, rhs.m_expired_cache_path);
+        swap(m_local_repodata, rhs.m_local_repodata);
         swap(m_writable_pkgs_dir, rhs.m_writable_pkgs_dir);
         swap(m_progress_bar, m_progress_bar);
-        swap(m_progress_bar_check, m_progress_bar_check);
         swap(m_loaded, rhs.m_loaded);
+        swap(m_stale, rhs.m_stale);
         swap(m_download_complete, rhs.m_download_complete);
         swap(m_repodata_url, rhs.m_repodata_url);
         swap(m_name, rhs.m_name);
         swap(m_json_fn, rhs.m_json_fn);
         swap(m_solv_fn, rhs.m_solv_fn);
+        swap(m_index_fn, rhs.m_index_fn);
         swap(m_is_noarch, rhs.m_is_noarch);
         swap(m_metadata, rhs.m_metadata);
+        swap(m_fetch_lock, rhs.m_fetch_lock);
         swap(m_temp_file, rhs.m_temp_file);
+        swap(m_jlap_temp_file, rhs.m_jlap_temp_file);
+        swap(m_records_update, rhs.m_records_update);
         swap(m_check_targets, rhs.m_check_targets);
         swap(p_channel, rhs.p_channel);
 
@@ -448,30 +541,30 @@ namespace mamba
 
     void MSubdirData::finalize_checks()
     {
+        if (load_jlap())
+        {
+            m_fetch_lock.reset();
+            return;
+        }
         create_target();
     }
 
     bool MSubdirData::finalize_check(const DownloadTarget& target)
     {
         LOG_INFO << "Checked: " << target.get_url() << " [" << target.get_http_status() << "]";
-        if (m_progress_bar_check)
-        {
-            m_progress_bar_check.repr().postfix.set_value("Checked");
-            m_progress_bar_check.repr().speed.deactivate();
-            m_progress_bar_check.repr().total.deactivate();
-            m_progress_bar_check.mark_as_completed();
-        }
-
-        if (ends_with(target.get_url(), ".zst"))
+        if (ends_with(target.get_url(), ".jlap"))
         {
-            this->m_metadata.has_zst = { target.get_http_status() == 200, utc_time_now() };
+            // 416 is a range request past the end of the file, which therefore exists
+            const int status = target.get_http_status();
+            this->m_metadata.has_jlap = { status == 200 || status == 206 || status == 416,
+                                          utc_time_now() };
         }
         return true;
     }
 
     std::vector<std::unique_ptr<DownloadTarget>>& MSubdirData::check_targets()
     {
-        // check if zst or (later) jlap are available
+        // check if jlap is available
         return m_check_targets;
     }
 
@@ -485,15 +578,79 @@ namespace mamba
             values.erase(end_it, values.end());
             return values;
         }
+
+        /**
+         * Record the headers of a cache file without state file, so next loads only read it.
+         *
+         * The headers are read again under the exclusive lock, the cache file could have been
+         * replaced since the shared lock of the load was released.
+         */
+        void write_missing_state_file(const fs::u8path& cache_dir, const fs::u8path& file)
+        {
+            auto state_file = file;
+            state_file.replace_extension(".state.json");
+            std::error_code ec;
+            if (fs::exists(state_file, ec) || !path::is_writable(file))
+            {
+                return;
+            }
+            try
+            {
+                auto lock = LockFile(cache_dir);
+                if (fs::exists(state_file, ec))
+                {
+                    return;
+                }
+                if (auto metadata = detail::read_metadata(file))
+                {
+                    metadata.value().store_file_metadata(file);
+                    auto state_file_stream = open_ofstream(state_file);
+                    metadata.value().serialize_to_stream(state_file_stream);
+                }
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Could not write state file " << state_file << ": " << e.what();
+            }
+        }
     }
 
-    bool MSubdirData::load(MultiPackageCache& caches, ChannelContext& channel_context)
+    bool MSubdirData::load(
+        MultiPackageCache& caches,
+        ChannelContext& channel_context,
+        bool coordinate_fetch
+    )
     {
         auto now = fs::file_time_type::clock::now();
 
         m_valid_cache_path = "";
         m_expired_cache_path = "";
+        m_local_repodata = "";
         m_loaded = false;
+        m_stale = false;
+
+        // Local channels, such as on network file systems, are read in place without copies
+        if (const auto local_path = local_path_from_url(m_repodata_url); !local_path.empty())
+        {
+            std::error_code ec;
+            if (fs::is_regular_file(local_path, ec))
+            {
+                LOG_INFO << "Reading local repodata '" << local_path << "' in place";
+                m_local_repodata = local_path;
+                m_metadata.url = m_repodata_url;
+                m_json_cache_valid = true;
+                // Such as written by ``micromamba index``, only used if not older than the json
+                auto solv_file = m_local_repodata;
+                solv_file.replace_extension("solv");
+                m_solv_cache_valid = fs::is_regular_file(solv_file, ec)
+                                     && (fs::last_write_time(solv_file, ec)
+                                         >= fs::last_write_time(m_local_repodata, ec));
+                m_loaded = true;
+                Console::stream()
+                    << fmt::format("{:<50} {:>20}", m_name, std::string("Using local"));
+                return true;
+            }
+        }
 
         LOG_INFO << "Searching index cache file for repo '" << m_repodata_url << "'";
 
@@ -501,7 +658,7 @@ namespace mamba
 
         for (const auto& cache_path : cache_paths)
         {
-            auto json_file = cache_path / "cache" / m_json_fn;
+            auto json_file = repodata_cache_file(cache_path);
             auto solv_file = cache_path / "cache" / m_solv_fn;
 
             std::error_code ec;
@@ -510,7 +667,7 @@ namespace mamba
                 continue;
             }
 
-            auto lock = LockFile(cache_path / "cache");
+            auto lock = LockFile(cache_path / "cache", LockMode::shared);
             auto cache_age = check_cache(json_file, now);
 
             if (cache_age != fs::file_time_type::duration::max() && !forbid_cache())
@@ -584,8 +741,44 @@ namespace mamba
             }
         }
 
+        auto& ctx = Context::instance();
+        if (!m_loaded && !m_expired_cache_path.empty() && ctx.repodata_stale_while_revalidate
+            && !ctx.offline)
+        {
+            // Used right away, the cache is refreshed later on with ``revalidation_target``
+            const auto json_file = repodata_cache_file(m_expired_cache_path);
+            const auto solv_file = m_expired_cache_path / "cache" / m_solv_fn;
+            if (auto metadata = detail::read_metadata(json_file))
+            {
+                LOG_INFO << "Using expired cache found at '" << m_expired_cache_path.string()
+                         << "' until revalidated";
+                m_metadata = std::move(metadata).value();
+                m_valid_cache_path = m_expired_cache_path;
+                m_json_cache_valid = true;
+                const auto solv_age = check_cache(solv_file, now);
+                m_solv_cache_valid = (solv_age != fs::file_time_type::duration::max())
+                                     && (solv_age <= check_cache(json_file, now));
+                m_stale = true;
+                m_loaded = true;
+                Console::stream()
+                    << fmt::format("{:<50} {:>20}", m_name, std::string("Using stale cache"));
+                return true;
+            }
+        }
+
+        if (!m_loaded && coordinate_fetch && ctx.repodata_shared_cache && !ctx.offline
+            && !forbid_cache() && !m_writable_pkgs_dir.empty() && !acquire_fetch_lock())
+        {
+            LOG_INFO << "Repodata of '" << m_name << "' fetched by another process";
+            return load(caches, channel_context, false);
+        }
+
         if (m_loaded)
         {
+            write_missing_state_file(
+                m_valid_cache_path / "cache",
+                repodata_cache_file(m_valid_cache_path)
+            );
             Console::stream() << fmt::format("{:<50} {:>20}", m_name, std::string("Using cache"));
         }
         else
@@ -597,32 +790,15 @@ namespace mamba
                          << m_expired_cache_path.string() << "'";
             }
 
-            auto& ctx = Context::instance();
             if (!ctx.offline || forbid_cache())
             {
-                bool has_value = m_metadata.has_zst.has_value();
-                bool is_expired = m_metadata.has_zst.has_value()
-                                  && m_metadata.has_zst.value().has_expired();
-                bool has_zst = m_metadata.check_zst(channel_context, p_channel);
-                if (!has_zst && (is_expired || !has_value))
+                create_jlap_check_target();
+                // Seeds the availability of zst for the channels known to have it, the others
+                // are probed by the download itself
+                m_metadata.check_zst(channel_context, p_channel);
+                if (!m_check_targets.empty())
                 {
-                    m_check_targets.push_back(std::make_unique<DownloadTarget>(
-                        m_name + " (check zst)",
-                        m_repodata_url + ".zst",
-                        ""
-                    ));
-                    m_check_targets.back()->set_head_only(true);
-                    m_check_targets.back()->set_finalize_callback(&MSubdirData::finalize_check, this);
-                    m_check_targets.back()->set_ignore_failure(true);
-                    if (!(ctx.graphics_params.no_progress_bars || ctx.output_params.quiet
-                          || ctx.output_params.json))
-                    {
-                        m_progress_bar_check = Console::instance().add_progress_bar(
-                            m_name + " (check zst)"
-                        );
-                        m_check_targets.back()->set_progress_bar(m_progress_bar_check);
-                        m_progress_bar_check.repr().postfix.set_value("Checking");
-                    }
+                    // The final target is created once the checks are done
                     return true;
                 }
                 create_target();
@@ -633,6 +809,25 @@ namespace mamba
 
     expected_t<std::string> MSubdirData::cache_path() const
     {
+        if (!m_local_repodata.empty())
+        {
+            auto solv_file = m_local_repodata;
+            solv_file.replace_extension("solv");
+            if (m_solv_cache_valid)
+            {
+                return solv_file.string();
+            }
+            // Such as written by ``micromamba index``, only used if not older than the json
+            const auto index_file = m_local_repodata.parent_path() / RepoDataIndex::filename;
+            std::error_code ec;
+            if (uses_index() && fs::is_regular_file(index_file, ec)
+                && (fs::last_write_time(index_file, ec)
+                    >= fs::last_write_time(m_local_repodata, ec)))
+            {
+                return index_file.string();
+            }
+            return m_local_repodata.string();
+        }
         // TODO invalidate solv cache on version updates!!
         if (m_json_cache_valid && m_solv_cache_valid)
         {
@@ -640,16 +835,41 @@ namespace mamba
         }
         else if (m_json_cache_valid)
         {
-            return (m_valid_cache_path / "cache" / m_json_fn).string();
+            return repodata_cache_file(m_valid_cache_path).string();
         }
         return make_unexpected("Cache not loaded", mamba_error_code::cache_not_loaded);
     }
 
+    bool MSubdirData::has_records_update() const
+    {
+        return m_records_update.has_value();
+    }
+
     DownloadTarget* MSubdirData::target()
     {
         return m_target.get();
     }
 
+    bool MSubdirData::is_stale() const
+    {
+        return m_stale;
+    }
+
+    DownloadTarget* MSubdirData::revalidation_target(bool with_progress_bar)
+    {
+        if (!m_stale)
+        {
+            return nullptr;
+        }
+        if (m_target == nullptr)
+        {
+            create_target(with_progress_bar);
+            // The stale cache remains in use if the repodata cannot be fetched
+            m_target->set_ignore_failure(true);
+        }
+        return m_target.get();
+    }
+
     const std::string& MSubdirData::name() const
     {
         return m_name;
@@ -685,6 +905,9 @@ namespace mamba
 
     bool MSubdirData::finalize_transfer(const DownloadTarget&)
     {
+        // Other processes waiting for this fetch find the cache up to date
+        auto release_fetch_lock = on_scope_exit([this] { m_fetch_lock.reset(); });
+
         if (m_target->get_result() != 0 || m_target->get_http_status() >= 400)
         {
             LOG_INFO << "Unable to retrieve repodata (response: " << m_target->get_http_status()
@@ -696,16 +919,37 @@ namespace mamba
                 m_progress_bar.set_full();
                 m_progress_bar.mark_as_completed();
             }
-            m_loaded = false;
+            // A stale cache remains in use
+            m_loaded = m_stale;
             return false;
         }
 
         LOG_DEBUG << "HTTP response code: " << m_target->get_http_status();
+        static auto& repodata_updates = Metrics::instance().counter(
+            "mamba_repodata_updates_total",
+            "Repodata fetched again from their channels"
+        );
+        static auto& repodata_not_modified = Metrics::instance().counter(
+            "mamba_repodata_not_modified_total",
+            "Repodata revalidated unchanged with their channels"
+        );
+        (m_target->get_http_status() == 304 ? repodata_not_modified : repodata_updates).add();
         // Note HTTP status == 0 for files
         if (m_target->get_http_status() == 0 || m_target->get_http_status() == 200
             || m_target->get_http_status() == 304)
         {
             m_download_complete = true;
+            if (probes_index())
+            {
+                // The target fell back to the json if the server has no index
+                m_metadata.has_index = { ends_with(m_target->get_url(), RepoDataIndex::filename),
+                                         utc_time_now() };
+            }
+            else if (probes_zst())
+            {
+                // The target fell back to the json if the server has no zst
+                m_metadata.has_zst = { ends_with(m_target->get_url(), ".zst"), utc_time_now() };
+            }
         }
         else
         {
@@ -722,7 +966,7 @@ namespace mamba
         {
             // cache still valid
             LOG_INFO << "Cache is still valid";
-            json_file = m_expired_cache_path / "cache" / m_json_fn;
+            json_file = repodata_cache_file(m_expired_cache_path);
             solv_file = m_expired_cache_path / "cache" / m_solv_fn;
 
             if (path::is_writable(json_file)
@@ -747,7 +991,7 @@ namespace mamba
                 fs::u8path writable_cache_dir = create_cache_dir(m_writable_pkgs_dir);
                 auto lock = LockFile(writable_cache_dir);
 
-                auto copied_json_file = writable_cache_dir / m_json_fn;
+                auto copied_json_file = writable_cache_dir / json_file.filename();
                 if (fs::exists(copied_json_file))
                 {
                     fs::remove(copied_json_file);
@@ -787,6 +1031,7 @@ namespace mamba
 
             m_json_cache_valid = true;
             m_loaded = true;
+            m_stale = false;
             m_temp_file.reset();
             return true;
         }
@@ -802,7 +1047,8 @@ namespace mamba
         LOG_DEBUG << "Finalized transfer of '" << m_target->get_url() << "'";
 
         fs::u8path writable_cache_dir = create_cache_dir(m_writable_pkgs_dir);
-        json_file = writable_cache_dir / m_json_fn;
+        const bool is_index = ends_with(m_target->get_url(), RepoDataIndex::filename);
+        json_file = writable_cache_dir / (is_index ? m_index_fn : m_json_fn);
         auto lock = LockFile(writable_cache_dir);
 
         auto file_size = fs::file_size(m_temp_file->path());
@@ -812,6 +1058,17 @@ namespace mamba
         m_metadata.mod = m_target->get_mod();
         m_metadata.cache_control = m_target->get_cache_control();
         m_metadata.stored_file_size = file_size;
+        if (is_index)
+        {
+            m_metadata.repodata_hash.clear();
+        }
+        else if (Context::instance().repodata_use_jlap)
+        {
+            // The jlap patches are identified by the hash of the file before (and after) them
+            m_metadata.repodata_hash = jlap::blake2b_256_file_hex(m_temp_file->path());
+            m_metadata.jlap_iv.clear();
+            m_metadata.jlap_pos = 0;
+        }
 
         fs::u8path state_file = json_file;
         state_file.replace_extension(".state.json");
@@ -830,6 +1087,8 @@ namespace mamba
             );
         }
         fs::last_write_time(json_file, fs::now());
+        // The other kind of repodata would be older than its state file
+        fs::remove(writable_cache_dir / (is_index ? m_json_fn : m_index_fn), ec);
 
         m_metadata.store_file_metadata(json_file);
         std::ofstream state_file_stream = open_ofstream(state_file);
@@ -844,26 +1103,228 @@ namespace mamba
         m_temp_file.reset();
         m_valid_cache_path = m_writable_pkgs_dir;
         m_json_cache_valid = true;
+        m_solv_cache_valid = false;
         m_loaded = true;
+        m_stale = false;
 
         return true;
     }
 
-    void MSubdirData::create_target()
+    bool MSubdirData::acquire_fetch_lock()
+    {
+        const auto cache_dir = fs::u8path(create_cache_dir(m_writable_pkgs_dir));
+        // Written with both the json and the index
+        auto state_file = cache_dir / m_json_fn;
+        state_file.replace_extension(".state.json");
+        auto fetch_file = cache_dir / m_json_fn;
+        fetch_file.replace_extension(".fetch");
+
+        std::error_code ec;
+        if (!fs::exists(fetch_file, ec))
+        {
+            open_ofstream(fetch_file, std::ios::out | std::ios::app);
+        }
+        const auto last_write = fs::last_write_time(state_file, ec);
+
+        // Waits if another process is fetching the same repodata
+        auto lock = LockFile(fetch_file);
+        if (fs::last_write_time(state_file, ec) != last_write)
+        {
+            return false;
+        }
+        if (lock)
+        {
+            m_fetch_lock = std::move(lock);
+        }
+        return true;
+    }
+
+    void MSubdirData::create_jlap_check_target()
+    {
+        const auto& has_jlap = m_metadata.has_jlap;
+        // Patches apply to the json, the hash of an index is never recorded
+        if (!Context::instance().repodata_use_jlap || m_expired_cache_path.empty()
+            || m_writable_pkgs_dir.empty() || m_metadata.repodata_hash.empty()
+            || (has_jlap.has_value() && !has_jlap.value().value && !has_jlap.value().has_expired()))
+        {
+            return;
+        }
+
+        fs::u8path writable_cache_dir = create_cache_dir(m_writable_pkgs_dir);
+        auto lock = LockFile(writable_cache_dir);
+        m_jlap_temp_file = std::make_unique<TemporaryFile>("mambaf", "", writable_cache_dir);
+
+        auto jlap_url = m_repodata_url;
+        jlap_url.replace(jlap_url.size() - 4, 4, "jlap");
+        m_check_targets.push_back(std::make_unique<DownloadTarget>(
+            m_name + " (jlap)",
+            jlap_url,
+            m_jlap_temp_file->path().string()
+        ));
+        auto& target = m_check_targets.back();
+        if (!m_metadata.jlap_iv.empty())
+        {
+            target->set_range_start(m_metadata.jlap_pos);
+        }
+        target->set_finalize_callback(&MSubdirData::finalize_check, this);
+        target->set_ignore_failure(true);
+    }
+
+    bool MSubdirData::load_jlap()
+    {
+        const auto target_it = std::find_if(
+            m_check_targets.cbegin(),
+            m_check_targets.cend(),
+            [](const auto& t) { return ends_with(t->get_url(), ".jlap"); }
+        );
+        if ((target_it == m_check_targets.cend()) || !m_jlap_temp_file)
+        {
+            return false;
+        }
+        auto temp_file = std::move(m_jlap_temp_file);
+
+        const int status = (*target_it)->get_http_status();
+        if ((status != 200) && (status != 206))
+        {
+            LOG_INFO << "Could not fetch jlap for '" << m_name << "' (response: " << status << ")";
+            // The jlap file may have been truncated on the server
+            m_metadata.jlap_iv.clear();
+            m_metadata.jlap_pos = 0;
+            return false;
+        }
+
+        auto content = std::string();
+        {
+            auto infile = open_ifstream(temp_file->path(), std::ios::in | std::ios::binary);
+            content.assign(std::istreambuf_iterator<char>(infile), {});
+        }
+
+        const auto start = (status == 206)
+                               ? jlap::Position{ m_metadata.jlap_iv, m_metadata.jlap_pos }
+                               : jlap::Position{};
+        auto patches = jlap::parse(content, start);
+        auto patch = patches.and_then(
+            [&](const jlap::Patches& p)
+            { return jlap::patch_to_latest(p, m_metadata.repodata_hash); }
+        );
+        if (!patch)
+        {
+            LOG_WARNING << "Cannot use jlap for '" << m_name << "', downloading full repodata: "
+                        << patch.error().what();
+            m_metadata.jlap_iv.clear();
+            m_metadata.jlap_pos = 0;
+            return false;
+        }
+
+        const auto expired_json_file = m_expired_cache_path / "cache" / m_json_fn;
+        const auto expired_solv_file = m_expired_cache_path / "cache" / m_solv_fn;
+        m_metadata.repodata_hash = patches.value().latest;
+        m_metadata.jlap_iv = patches.value().next.iv;
+        m_metadata.jlap_pos = patches.value().next.offset;
+
+        if (patch.value().empty() && (m_expired_cache_path == m_writable_pkgs_dir))
+        {
+            LOG_INFO << "No jlap patches to apply for '" << m_name << "'";
+            m_valid_cache_path = m_expired_cache_path;
+            refresh_last_write_time(expired_json_file, expired_solv_file);
+        }
+        else
+        {
+            LOG_INFO << "Applying " << patch.value().size() << " jlap patch operations for '"
+                     << m_name << "'";
+            nlohmann::json repodata;
+            try
+            {
+                auto lock = LockFile(expired_json_file, LockMode::shared);
+                auto infile = open_ifstream(expired_json_file);
+                repodata = nlohmann::json::parse(infile).patch(patch.value());
+            }
+            catch (const nlohmann::json::exception& e)
+            {
+                LOG_WARNING << "Could not apply jlap patches for '" << m_name
+                            << "', downloading full repodata: " << e.what();
+                m_metadata.jlap_iv.clear();
+                m_metadata.jlap_pos = 0;
+                return false;
+            }
+
+            // The previous solv cache can be updated in place rather than regenerated
+            const auto now = fs::file_time_type::clock::now();
+            const auto solv_age = check_cache(expired_solv_file, now);
+            const bool update_solv = (m_expired_cache_path == m_writable_pkgs_dir)
+                                     && (solv_age != fs::file_time_type::duration::max())
+                                     && (solv_age <= check_cache(expired_json_file, now));
+
+            fs::u8path writable_cache_dir = create_cache_dir(m_writable_pkgs_dir);
+            auto json_file = writable_cache_dir / m_json_fn;
+            auto lock = LockFile(writable_cache_dir);
+            {
+                auto outfile = open_ofstream(temp_file->path());
+                outfile << repodata.dump();
+            }
+            std::error_code ec;
+            mamba_fs::rename_or_move(temp_file->path(), json_file, ec);
+            if (ec)
+            {
+                LOG_WARNING << "Could not move patched repodata file to " << json_file << ": "
+                            << ec.message();
+                return false;
+            }
+            fs::last_write_time(json_file, fs::now());
+
+            fs::u8path state_file = json_file;
+            state_file.replace_extension(".state.json");
+            m_metadata.store_file_metadata(json_file);
+            auto state_file_stream = open_ofstream(state_file);
+            m_metadata.serialize_to_stream(state_file_stream);
+            m_valid_cache_path = m_writable_pkgs_dir;
+
+            if (update_solv)
+            {
+                m_records_update = RepoDataRecordsUpdate::from_patch(
+                    json_file,
+                    repodata,
+                    patch.value(),
+                    Context::instance().use_only_tar_bz2
+                );
+            }
+        }
+
+        Console::stream() << fmt::format("{:<50} {:>20}", m_name, std::string("Patched (jlap)"));
+        m_json_cache_valid = true;
+        m_loaded = true;
+        return true;
+    }
+
+    void MSubdirData::create_target(bool with_progress_bar)
     {
         auto& ctx = Context::instance();
         fs::u8path writable_cache_dir = create_cache_dir(m_writable_pkgs_dir);
         auto lock = LockFile(writable_cache_dir);
         m_temp_file = std::make_unique<TemporaryFile>("mambaf", "", writable_cache_dir);
 
-        bool use_zst = m_metadata.has_zst.has_value() && m_metadata.has_zst.value().value;
+        const bool probe_zst = probes_zst();
+        const bool use_zst = probe_zst
+                             || (m_metadata.has_zst.has_value() && m_metadata.has_zst.value().value);
+        const bool probe_index = probes_index();
+        const bool use_index = probe_index
+                               || (uses_index() && m_metadata.has_index.has_value()
+                                   && m_metadata.has_index.value().value);
+        const auto json_url = m_repodata_url + (use_zst && !probe_index ? ".zst" : "");
         m_target = std::make_unique<DownloadTarget>(
             m_name,
-            m_repodata_url + (use_zst ? ".zst" : ""),
+            use_index ? concat(rsplit(m_repodata_url, "/", 1).front(), "/", RepoDataIndex::filename)
+                      : json_url,
             m_temp_file->path().string()
         );
-        if (!(ctx.graphics_params.no_progress_bars || ctx.output_params.quiet
-              || ctx.output_params.json))
+        // Only one fallback, the zst is probed once the index is known to be missing
+        if (probe_index || (probe_zst && !use_index))
+        {
+            m_target->set_fallback_url(probe_index ? json_url : m_repodata_url);
+        }
+        if (with_progress_bar
+            && !(ctx.graphics_params.no_progress_bars || ctx.output_params.quiet
+                 || ctx.output_params.json))
         {
             m_progress_bar = Console::instance().add_progress_bar(m_name);
             m_target->set_progress_bar(m_progress_bar);
@@ -878,6 +1339,40 @@ namespace mamba
         m_target->set_mod_etag_headers(m_metadata.mod, m_metadata.etag);
     }
 
+    bool MSubdirData::probes_zst() const
+    {
+        // Only HTTP servers tell a missing file apart from other failures
+        const auto& has_zst = m_metadata.has_zst;
+        return starts_with(m_repodata_url, "http")
+               && (!has_zst.has_value() || has_zst.value().has_expired());
+    }
+
+    bool MSubdirData::uses_index() const
+    {
+        // Signatures are verified on the json
+        const auto& ctx = Context::instance();
+        return ctx.repodata_use_index && !(ctx.experimental && ctx.verify_artifacts);
+    }
+
+    bool MSubdirData::probes_index() const
+    {
+        const auto& has_index = m_metadata.has_index;
+        return uses_index() && starts_with(m_repodata_url, "http")
+               && (!has_index.has_value() || has_index.value().has_expired());
+    }
+
+    fs::u8path MSubdirData::repodata_cache_file(const fs::u8path& pkgs_dir) const
+    {
+        const auto cache_dir = pkgs_dir / "cache";
+        std::error_code ec;
+        if (uses_index() && !fs::exists(cache_dir / m_json_fn, ec)
+            && fs::exists(cache_dir / m_index_fn, ec))
+        {
+            return cache_dir / m_index_fn;
+        }
+        return cache_dir / m_json_fn;
+    }
+
     std::size_t MSubdirData::get_cache_control_max_age(const std::string& val)
     {
         static std::regex max_age_re("max-age=(\\d+)");
@@ -905,21 +1400,73 @@ namespace mamba
         return cache_dir.string();
     }
 
-    expected_t<MRepo> MSubdirData::create_repo(MPool& pool)
+    RepoMetadata MSubdirData::repo_metadata() const
     {
-        using return_type = expected_t<MRepo>;
-        RepoMetadata meta{
+        return {
             /* .url= */ rsplit(m_metadata.url, "/", 1).front(),
             /* .etag= */ m_metadata.etag,
             /* .mod= */ m_metadata.mod,
             /* .pip_added= */ Context::instance().add_pip_as_python_dependency,
         };
+    }
 
+    expected_t<MRepo> MSubdirData::create_repo(MPool& pool)
+    {
+        using return_type = expected_t<MRepo>;
+        if (m_records_update.has_value())
+        {
+            auto update = std::exchange(m_records_update, std::nullopt).value();
+            return MRepo(pool, m_name, std::move(update), repo_metadata());
+        }
         auto cache = cache_path();
-        return cache ? return_type(MRepo(pool, m_name, *cache, meta))
+        return cache ? return_type(MRepo(pool, m_name, *cache, repo_metadata()))
                      : return_type(forward_error(cache));
     }
 
+    expected_t<MRepo> MSubdirData::create_repo(MPool& pool, RepoDataRecords&& records)
+    {
+        return MRepo(pool, m_name, std::move(records), repo_metadata());
+    }
+
+    void MSubdirData::verify_index(MultiPackageCache& caches)
+    {
+        const auto& checker = p_channel->repo_checker(caches);
+        const auto root_version = checker.root_version();
+        if (!Context::instance().verify_index_cache && m_metadata.is_index_verified(root_version))
+        {
+            LOG_DEBUG << "Signatures of '" << m_name << "' already verified with root version "
+                      << root_version;
+            return;
+        }
+
+        const auto json_file = m_local_repodata.empty()
+                                   ? m_valid_cache_path / "cache" / m_json_fn
+                                   : m_local_repodata;
+        checker.verify_index(json_file);
+        LOG_INFO << "Signatures of '" << m_name << "' verified with root version "
+                 << root_version;
+
+        m_metadata.set_index_verified(root_version);
+        if (!m_local_repodata.empty())
+        {
+            // Local channels have no state file, they are verified each time
+            return;
+        }
+        auto state_file = json_file;
+        state_file.replace_extension(".state.json");
+        try
+        {
+            auto lock = LockFile(m_valid_cache_path / "cache");
+            auto state_file_stream = open_ofstream(state_file);
+            m_metadata.serialize_to_stream(state_file_stream);
+        }
+        catch (const std::exception& e)
+        {
+            // Only verified again next time
+            LOG_DEBUG << "Could not record verification in " << state_file << ": " << e.what();
+        }
+    }
+
     void MSubdirData::clear_cache()
     {
         if (fs::exists(m_json_fn))
@@ -930,5 +1477,9 @@ namespace mamba
         {
             fs::remove(m_solv_fn);
         }
+        if (fs::exists(m_index_fn))
+        {
+            fs::remove(m_index_fn);
+        }
     }
 }  // namespace mamba
@@ -0,0 +1,220 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <utility>
+
+#include "mamba/core/invoke.hpp"
+#include "mamba/core/output.hpp"
+#include "mamba/core/thread_utils.hpp"
+
+#include "thread_pool.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        // The pool and queue of the current worker, to which the tasks it submits are added
+        thread_local const ThreadPool* current_pool = nullptr;
+        thread_local std::size_t current_index = 0;
+    }
+
+    ThreadPool::ThreadPool(std::size_t n_workers, std::size_t max_queued)
+        : m_max_queued(max_queued)
+    {
+        n_workers = std::max<std::size_t>(n_workers, 1);
+        m_queues.reserve(n_workers);
+        for (std::size_t i = 0; i < n_workers; ++i)
+        {
+            m_queues.push_back(std::make_unique<WorkerQueue>());
+        }
+        m_workers.reserve(n_workers);
+        for (std::size_t i = 0; i < n_workers; ++i)
+        {
+            m_workers.emplace_back([this, i]() { run(i); });
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        close();
+    }
+
+    auto ThreadPool::size() const -> std::size_t
+    {
+        return m_queues.size();
+    }
+
+    auto ThreadPool::enqueue(task_type& task, TaskPriority priority) -> bool
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closed || (m_queued >= m_max_queued))
+            {
+                ++m_rejected;
+                return false;
+            }
+            const auto index = (current_pool == this) ? current_index
+                                                      : (m_next_queue++ % m_queues.size());
+            {
+                auto& queue = *m_queues[index];
+                std::lock_guard<std::mutex> queue_lock(queue.mutex);
+                queue.tasks[static_cast<std::size_t>(priority)].push_back(std::move(task));
+            }
+            ++m_queued;
+            ++m_submitted;
+        }
+        m_work_cv.notify_one();
+        return true;
+    }
+
+    auto ThreadPool::try_submit(task_type task, TaskPriority priority) -> bool
+    {
+        return enqueue(task, priority);
+    }
+
+    void ThreadPool::submit(task_type task, TaskPriority priority)
+    {
+        if (!enqueue(task, priority))
+        {
+            const auto result = safe_invoke(task);
+            if (!result)
+            {
+                LOG_ERROR << "Thread pool task failed (ignored): " << result.error().what();
+            }
+        }
+    }
+
+    auto ThreadPool::pop(std::size_t index, task_type& task) -> bool
+    {
+        const auto take = [&](std::size_t queue_index, std::size_t priority, bool own) -> bool
+        {
+            auto& queue = *m_queues[queue_index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            auto& tasks = queue.tasks[priority];
+            if (tasks.empty())
+            {
+                return false;
+            }
+            // The last task of its own queue is the most likely to still be in cache
+            if (own)
+            {
+                task = std::move(tasks.back());
+                tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            --m_queued;
+            return true;
+        };
+
+        const auto n_queues = m_queues.size();
+        for (std::size_t priority = 0; priority < 3; ++priority)
+        {
+            if (take(index, priority, true))
+            {
+                return true;
+            }
+            for (std::size_t k = 1; k < n_queues; ++k)
+            {
+                if (take((index + k) % n_queues, priority, false))
+                {
+                    ++m_stolen;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void ThreadPool::run(std::size_t index)
+    {
+        current_pool = this;
+        current_index = index;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_work_cv.wait(lock, [&]() { return (m_queued > 0) || m_closed; });
+                if ((m_queued == 0) && m_closed)
+                {
+                    return;
+                }
+                ++m_running;
+            }
+
+            auto task = task_type();
+            if (pop(index, task))
+            {
+                if (is_sig_interrupted())
+                {
+                    ++m_cancelled;
+                }
+                else
+                {
+                    const auto result = safe_invoke(task);
+                    if (!result)
+                    {
+                        LOG_ERROR << "Thread pool task failed (ignored): " << result.error().what();
+                    }
+                    ++m_executed;
+                }
+                // Captures are released before the pool is seen idle
+                task = nullptr;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_running;
+            if ((m_running == 0) && (m_queued == 0))
+            {
+                m_idle_cv.notify_all();
+            }
+        }
+    }
+
+    void ThreadPool::wait_idle()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle_cv.wait(lock, [&]() { return (m_running == 0) && (m_queued == 0); });
+    }
+
+    void ThreadPool::close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closed)
+            {
+                return;
+            }
+            m_closed = true;
+        }
+        m_work_cv.notify_all();
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+        m_workers.clear();
+
+        const auto s = stats();
+        LOG_DEBUG << "Thread pool closed: " << s.submitted << " tasks submitted, " << s.executed
+                  << " executed, " << s.stolen << " stolen, " << s.cancelled << " cancelled, "
+                  << s.rejected << " rejected";
+    }
+
+    auto ThreadPool::stats() const -> Stats
+    {
+        return {
+            /* .submitted= */ m_submitted,
+            /* .executed= */ m_executed,
+            /* .stolen= */ m_stolen,
+            /* .cancelled= */ m_cancelled,
+            /* .rejected= */ m_rejected,
+        };
+    }
+}
@@ -0,0 +1,126 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_THREAD_POOL_HPP
+#define MAMBA_CORE_THREAD_POOL_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mamba
+{
+    /** The order in which the queued tasks of a ``ThreadPool`` are started. */
+    enum class TaskPriority
+    {
+        /** Such as extracting packages, needed before anything is linked. */
+        high = 0,
+        /** Such as linking packages or compiling their Python files. */
+        normal = 1,
+        /** Such as writing caches, which nothing waits for. */
+        low = 2,
+    };
+
+    /**
+     * Worker threads shared by the whole process for short CPU or disk bound tasks.
+     *
+     * Each worker has its own queue of tasks, to which the tasks submitted from that worker
+     * are added, and takes tasks from the other queues when its own is empty.
+     * Higher priority tasks are always started first.
+     * Queued tasks that have not started when the process is interrupted are dropped.
+     *
+     * Tasks must not wait for other tasks of the pool, as all workers could be waiting.
+     * Long running or blocking tasks, such as progress bars, are scheduled on the
+     * ``MainExecutor`` instead.
+     */
+    class ThreadPool
+    {
+    public:
+
+        using task_type = std::function<void()>;
+
+        struct Stats
+        {
+            std::size_t submitted = 0;
+            std::size_t executed = 0;
+            /** Tasks taken from the queue of another worker. */
+            std::size_t stolen = 0;
+            /** Tasks dropped because the process was interrupted. */
+            std::size_t cancelled = 0;
+            /** Tasks refused because the queues were full or the pool closed. */
+            std::size_t rejected = 0;
+        };
+
+        /** The pool of the process, created with a worker per core on first use. */
+        static ThreadPool& instance();
+
+        ThreadPool(std::size_t n_workers, std::size_t max_queued = 4096);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        auto size() const -> std::size_t;
+
+        /**
+         * Queue @p task, unless the queues are full or the pool is closed.
+         *
+         * Exceptions thrown by the task are logged and ignored.
+         */
+        auto try_submit(task_type task, TaskPriority priority = TaskPriority::normal) -> bool;
+
+        /** Queue @p task, or run it right away if it cannot be queued. */
+        void submit(task_type task, TaskPriority priority = TaskPriority::normal);
+
+        /** Wait until there are no queued or running tasks, not from a task of the pool. */
+        void wait_idle();
+
+        /** Run the queued tasks and stop the workers, tasks submitted afterwards are refused. */
+        void close();
+
+        auto stats() const -> Stats;
+
+    private:
+
+        struct WorkerQueue
+        {
+            std::mutex mutex = {};
+            std::array<std::deque<task_type>, 3> tasks = {};
+        };
+
+        std::vector<std::unique_ptr<WorkerQueue>> m_queues = {};
+        std::vector<std::thread> m_workers = {};
+        const std::size_t m_max_queued;
+
+        std::mutex m_mutex = {};
+        std::condition_variable m_work_cv = {};
+        std::condition_variable m_idle_cv = {};
+        bool m_closed = false;
+        std::atomic<std::size_t> m_queued = 0;
+        std::size_t m_running = 0;
+        std::atomic<std::size_t> m_next_queue = 0;
+
+        std::atomic<std::size_t> m_submitted = 0;
+        std::atomic<std::size_t> m_executed = 0;
+        std::atomic<std::size_t> m_stolen = 0;
+        std::atomic<std::size_t> m_cancelled = 0;
+        std::atomic<std::size_t> m_rejected = 0;
+
+        /** Move @p task to a queue, leaving it untouched if refused. */
+        auto enqueue(task_type& task, TaskPriority priority) -> bool;
+        void run(std::size_t index);
+        auto pop(std::size_t index, task_type& task) -> bool;
+    };
+}
+
+#endif
@@ -4,7 +4,9 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
 #include <atomic>
+#include <limits>
 #ifndef _WIN32
 #include <signal.h>
 #endif
@@ -22,6 +24,11 @@ namespace mamba
     namespace
     {
         std::atomic<bool> sig_interrupted(false);
+
+        using deadline_rep = std::chrono::steady_clock::duration::rep;
+        constexpr deadline_rep no_deadline = std::numeric_limits<deadline_rep>::max();
+        std::atomic<deadline_rep> interruption_deadline(no_deadline);
+        std::atomic<bool> deadline_reached(false);
     }
 
 #ifndef _WIN32
@@ -98,7 +105,19 @@ namespace mamba
 
     bool is_sig_interrupted() noexcept
     {
-        return sig_interrupted.load();
+        if (sig_interrupted.load())
+        {
+            return true;
+        }
+        const auto deadline = interruption_deadline.load(std::memory_order_relaxed);
+        if ((deadline != no_deadline)
+            && (std::chrono::steady_clock::now().time_since_epoch().count() >= deadline))
+        {
+            deadline_reached.store(true);
+            sig_interrupted.store(true);
+            return true;
+        }
+        return false;
     }
 
     void set_sig_interrupted() noexcept
@@ -106,6 +125,20 @@ namespace mamba
         sig_interrupted.store(true);
     }
 
+    void set_interruption_deadline(std::chrono::steady_clock::time_point deadline) noexcept
+    {
+        interruption_deadline.store(deadline.time_since_epoch().count());
+    }
+
+    void clear_interruption_deadline() noexcept
+    {
+        interruption_deadline.store(no_deadline);
+        if (deadline_reached.exchange(false))
+        {
+            sig_interrupted.store(false);
+        }
+    }
+
     void interruption_point()
     {
         if (is_sig_interrupted())
@@ -152,6 +185,13 @@ namespace mamba
         clean_var.wait(lk, []() { return thread_count == 0; });
     }
 
+    std::size_t clamp_worker_threads(int configured)
+    {
+        const int hardware_threads = static_cast<int>(std::thread::hardware_concurrency());
+        const int wanted_threads = (configured > 0) ? configured : hardware_threads + configured;
+        return static_cast<std::size_t>(std::max(wanted_threads, 1));
+    }
+
     /*************************
      * thread implementation *
      *************************/
@@ -0,0 +1,239 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#include "mamba/core/tracing.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/util_string.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        /** A small stable index for the current thread, displayed as the thread of a span. */
+        auto current_thread_index() -> std::size_t
+        {
+            static std::atomic<std::size_t> next_index = 0;
+            thread_local const std::size_t index = next_index++;
+            return index;
+        }
+    }
+
+    /********************************
+     * Tracer::Scope implementation *
+     ********************************/
+
+    Tracer::Scope::Scope(Tracer* tracer, std::string name)
+        : p_tracer(tracer)
+        , m_name(std::move(name))
+        , m_start(clock::now())
+    {
+    }
+
+    Tracer::Scope::~Scope()
+    {
+        if (p_tracer == nullptr)
+        {
+            return;
+        }
+        p_tracer->add_span(std::move(m_name), m_start, clock::now(), std::move(m_counters));
+    }
+
+    void Tracer::Scope::add_counter(std::string name, std::size_t value)
+    {
+        if (p_tracer != nullptr)
+        {
+            m_counters.emplace_back(std::move(name), value);
+        }
+    }
+
+    /*************************
+     * Tracer implementation *
+     *************************/
+
+    auto Tracer::instance() -> Tracer&
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    Tracer::Tracer()
+        : m_origin(clock::now())
+    {
+    }
+
+    void Tracer::set_enabled(bool enabled)
+    {
+        m_enabled = enabled;
+    }
+
+    auto Tracer::enabled() const -> bool
+    {
+        return m_enabled;
+    }
+
+    auto Tracer::scope(std::string name) -> Scope
+    {
+        if (!enabled())
+        {
+            return { nullptr, {} };
+        }
+        return { this, std::move(name) };
+    }
+
+    void Tracer::add_span(
+        std::string name,
+        clock::time_point start,
+        clock::time_point end,
+        std::vector<std::pair<std::string, std::size_t>> counters
+    )
+    {
+        if (!enabled())
+        {
+            return;
+        }
+        record({
+            /* .name= */ std::move(name),
+            /* .start= */ std::chrono::duration_cast<TraceSpan::duration_type>(start - m_origin),
+            /* .duration= */ std::chrono::duration_cast<TraceSpan::duration_type>(end - start),
+            /* .thread= */ current_thread_index(),
+            /* .counters= */ std::move(counters),
+        });
+    }
+
+    auto Tracer::phase(std::string_view prefix, std::string_view within) const -> TracePhase
+    {
+        const auto all_spans = spans();
+
+        auto window_start = TraceSpan::duration_type::min();
+        auto window_end = TraceSpan::duration_type::max();
+        if (!within.empty())
+        {
+            const auto parent = std::find_if(
+                all_spans.rbegin(),
+                all_spans.rend(),
+                [&](const TraceSpan& span) { return span.name == within; }
+            );
+            if (parent == all_spans.rend())
+            {
+                return {};
+            }
+            window_start = parent->start;
+            window_end = parent->start + parent->duration;
+        }
+
+        auto out = TracePhase();
+        auto intervals = std::vector<std::pair<TraceSpan::duration_type, TraceSpan::duration_type>>();
+        for (const auto& span : all_spans)
+        {
+            if (!starts_with(span.name, prefix) || (span.start < window_start)
+                || (span.start + span.duration > window_end))
+            {
+                continue;
+            }
+            out.count++;
+            intervals.emplace_back(span.start, span.start + span.duration);
+            for (const auto& [name, value] : span.counters)
+            {
+                if (name == "bytes")
+                {
+                    out.bytes += value;
+                }
+            }
+        }
+
+        // Concurrent spans, such as parallel downloads, are only counted once
+        std::sort(intervals.begin(), intervals.end());
+        auto end = TraceSpan::duration_type::min();
+        for (const auto& [span_start, span_end] : intervals)
+        {
+            const auto from = std::max(span_start, end);
+            if (span_end > from)
+            {
+                out.wall_time += span_end - from;
+                end = span_end;
+            }
+        }
+        return out;
+    }
+
+    auto Tracer::spans() const -> std::vector<TraceSpan>
+    {
+        auto lock = std::lock_guard(m_mutex);
+        return m_spans;
+    }
+
+    void Tracer::clear()
+    {
+        auto lock = std::lock_guard(m_mutex);
+        m_spans.clear();
+    }
+
+    void Tracer::record(TraceSpan span)
+    {
+        auto lock = std::lock_guard(m_mutex);
+        m_spans.push_back(std::move(span));
+    }
+
+    auto Tracer::to_json() const -> nlohmann::json
+    {
+        auto out = nlohmann::json::array();
+        for (const auto& span : spans())
+        {
+            auto j = nlohmann::json{
+                { "name", span.name },
+                { "duration_ms",
+                  std::chrono::duration<double, std::milli>(span.duration).count() },
+            };
+            for (const auto& [name, value] : span.counters)
+            {
+                j[name] = value;
+            }
+            out.push_back(std::move(j));
+        }
+        return out;
+    }
+
+    auto Tracer::to_chrome_trace() const -> nlohmann::json
+    {
+        auto events = nlohmann::json::array();
+        for (const auto& span : spans())
+        {
+            // Complete events, nested by the viewer from their start and duration
+            auto event = nlohmann::json{
+                { "name", span.name },
+                { "cat", "mamba" },
+                { "ph", "X" },
+                { "ts", span.start.count() },
+                { "dur", span.duration.count() },
+                { "pid", 0 },
+                { "tid", span.thread },
+                { "args", nlohmann::json::object() },
+            };
+            for (const auto& [name, value] : span.counters)
+            {
+                event["args"][name] = value;
+            }
+            events.push_back(std::move(event));
+        }
+        return { { "traceEvents", std::move(events) }, { "displayTimeUnit", "ms" } };
+    }
+
+    void Tracer::write_chrome_trace(const fs::u8path& path) const
+    {
+        auto out = open_ofstream(path);
+        if (!out)
+        {
+            throw std::runtime_error(fmt::format("Could not write trace file {}", path.string()));
+        }
+        out << to_chrome_trace().dump();
+    }
+}
@@ -5,9 +5,20 @@
 // The full license is in the file LICENSE, distributed with this software.
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <stack>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -25,37 +36,68 @@ extern "C"  // Incomplete header
 #include "mamba/core/env_lockfile.hpp"
 #include "mamba/core/link.hpp"
 #include "mamba/core/match_spec.hpp"
+#include "mamba/core/memory_budget.hpp"
+#include "mamba/core/metrics.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/package_download.hpp"
+#include "mamba/core/package_paths.hpp"
 #include "mamba/core/pool.hpp"
 #include "mamba/core/thread_utils.hpp"
+#include "mamba/core/tracing.hpp"
 #include "mamba/core/transaction.hpp"
+#include "mamba/core/util_os.hpp"
+#include "mamba/core/util_scope.hpp"
 #include "mamba/core/util_string.hpp"
+#include "mamba/specs/version.hpp"
 #include "mamba/util/flat_set.hpp"
+#include "mamba/util/graph.hpp"
 #include "solv-cpp/pool.hpp"
 #include "solv-cpp/queue.hpp"
 #include "solv-cpp/repo.hpp"
 #include "solv-cpp/solver.hpp"
 #include "solv-cpp/transaction.hpp"
 
+#include "package_cache_ledger.hpp"
+#include "package_cache_usage.hpp"
+#include "parallel.hpp"
 #include "progress_bar_impl.hpp"
 
 namespace mamba
 {
     namespace
     {
-        bool need_pkg_download(const PackageInfo& pkg_info, MultiPackageCache& caches)
+        /** Validate the caches of all the packages to install at once, before querying them. */
+        void validate_caches(const Solution& solution, MultiPackageCache& caches)
         {
-            return caches.get_extracted_dir_path(pkg_info).empty()
-                   && caches.get_tarball_path(pkg_info).empty();
+            auto pkgs = std::vector<PackageInfo>();
+            for_each_to_install(solution.actions, [&](const auto& pkg) { pkgs.push_back(pkg); });
+            // Bound by the latency of the file system as much as by hashing tarballs
+            const auto& threads = Context::instance().threads_params;
+            const auto n_threads = std::max<std::size_t>(
+                threads.download_threads,
+                std::thread::hardware_concurrency()
+            );
+            caches.validate(pkgs, n_threads);
         }
 
-        auto mk_pkginfo(const MPool& pool, solv::ObjSolvableViewConst s) -> PackageInfo
+        /** Record that the installed packages were used, in the ledger of their cache. */
+        void record_package_accesses(const Solution& solution, MultiPackageCache& caches)
         {
-            const auto pkginfo = pool.id2pkginfo(s.id());
-            assert(pkginfo.has_value());  // There is Solvable so the optional must no be empty
-            return std::move(pkginfo).value();
-        };
+            auto accessed = std::map<std::string, std::vector<std::string>>();
+            for_each_to_install(
+                solution.actions,
+                [&](const auto& pkg)
+                { accessed[caches.get_extracted_dir_path(pkg).string()].push_back(pkg.str()); }
+            );
+            // Read-only caches are never evicted from
+            for (auto* cache : caches.writable_caches())
+            {
+                if (auto it = accessed.find(cache->path().string()); it != accessed.end())
+                {
+                    PackageCacheLedger(cache->path()).record_access(it->second);
+                }
+            }
+        }
 
         template <typename Range>
         auto make_pkg_info_from_explicit_match_specs(Range&& specs)
@@ -85,11 +127,11 @@ namespace mamba
             return out;
         }
 
-        auto specs_names(const MSolver& solver) -> util::flat_set<std::string>
+        auto specs_names(const MSolver& solver) -> util::flat_set<std::string, std::less<>>
         {
             // TODO C++20
             // to_install_names and to_remove_names need not be allocated, only that
-            // flat_set::insert with iterators is more efficient (because it sorts only once).
+            // flat_set::insert with iterators is more efficient (because it sorts and merges once).
             // This could be solved with std::range::transform
             const auto& to_install_specs = solver.install_specs();
             auto to_install_names = std::vector<std::string>();
@@ -111,7 +153,7 @@ namespace mamba
                 [](const auto& spec) { return spec.name; }
             );
 
-            auto specs = util::flat_set<std::string>{};
+            auto specs = util::flat_set<std::string, std::less<>>{};
             specs.reserve(to_install_specs.size() + to_remove_specs.size());
             specs.insert(to_install_names.cbegin(), to_install_names.cend());
             specs.insert(to_remove_names.cbegin(), to_remove_names.cend());
@@ -122,14 +164,15 @@ namespace mamba
         auto transaction_to_solution(
             const MPool& pool,
             const solv::ObjTransaction& trans,
-            const util::flat_set<std::string>& specs = {},
+            const util::flat_set<std::string, std::less<>>& specs = {},
             /** true to filter out specs, false to filter in specs */
             bool keep_only = true
         ) -> Solution
         {
             auto get_pkginfo = [&](solv::SolvableId id)
             {
-                const auto pkginfo = pool.id2pkginfo(id);
+                // Not const, so that it is moved rather than copied out of the optional
+                auto pkginfo = pool.id2pkginfo(id);
                 assert(pkginfo.has_value());
                 return std::move(pkginfo).value();
             };
@@ -146,11 +189,15 @@ namespace mamba
             trans.for_each_step_id(
                 [&](const solv::SolvableId id)
                 {
-                    auto pkginfo = get_pkginfo(id);
+                    // Packages are only copied out of the pool for the steps making an action,
+                    // not for the ignored steps installing the newer side of an upgrade
+                    const auto view = pool.id2pkgview(id);
+                    assert(view.has_value());
                     // keep_only ? specs.contains(...) : !specs.contains(...);
                     // TODO ideally we should use Matchspecs::contains(pkginfo)
-                    if (keep_only == specs.contains(pkginfo.name))
+                    if (keep_only == specs.contains(view->name))
                     {
+                        auto pkginfo = get_pkginfo(id);
                         LOG_DEBUG << "Solution: Omit " << pkginfo.str();
                         out.push_back(Solution::Omit{ std::move(pkginfo) });
                         return;
@@ -160,6 +207,11 @@ namespace mamba
                         id,
                         SOLVER_TRANSACTION_SHOW_OBSOLETES | SOLVER_TRANSACTION_OBSOLETE_IS_UPGRADE
                     );
+                    if (type == SOLVER_TRANSACTION_IGNORE)
+                    {
+                        return;
+                    }
+                    auto pkginfo = get_pkginfo(id);
                     switch (type)
                     {
                         case SOLVER_TRANSACTION_UPGRADED:
@@ -213,8 +265,6 @@ namespace mamba
                             out.push_back(Solution::Install{ std::move(pkginfo) });
                             break;
                         }
-                        case SOLVER_TRANSACTION_IGNORE:
-                            break;
                         default:
                             LOG_WARNING << "solv::ObjTransaction case not handled: " << type;
                             break;
@@ -224,15 +274,32 @@ namespace mamba
             return { std::move(out) };
         }
 
-        auto find_python_version(const Solution& solution, const solv::ObjPool& pool)
+        auto find_python_version(const Solution& solution, std::string installed_py_ver)
             -> std::pair<std::string, std::string>
         {
             // We need to find the python version that will be there after this
             // Transaction is finished in order to compile the noarch packages correctly,
+            // starting from the installed one in case we are keeping the current one.
+            std::string new_py_ver = installed_py_ver;
+            for_each_to_install(
+                solution.actions,
+                [&](const auto& pkg)
+                {
+                    if (pkg.name == "python")
+                    {
+                        new_py_ver = pkg.version;
+                        LOG_INFO << "Found python version in packages to be installed " << new_py_ver;
+                        // Could break but not supported with for_each API
+                    }
+                }
+            );
+
+            return { std::move(new_py_ver), std::move(installed_py_ver) };
+        }
 
-            // We need to look into installed packages in case we are not installing a new python
-            // version but keeping the current one.
-            // Could also be written in term of PrefixData.
+        auto find_python_version(const Solution& solution, const solv::ObjPool& pool)
+            -> std::pair<std::string, std::string>
+        {
             std::string installed_py_ver = {};
             pool.for_each_installed_solvable(
                 [&](solv::ObjSolvableViewConst s)
@@ -246,22 +313,159 @@ namespace mamba
                     return solv::LoopControl::Continue;
                 }
             );
+            return find_python_version(solution, std::move(installed_py_ver));
+        }
 
-            std::string new_py_ver = installed_py_ver;
-            for_each_to_install(
-                solution.actions,
-                [&](const auto& pkg)
+        auto find_python_version(const Solution& solution, const PrefixData& prefix)
+            -> std::pair<std::string, std::string>
+        {
+            std::string installed_py_ver = {};
+            if (const auto it = prefix.records().find("python"); it != prefix.records().cend())
+            {
+                installed_py_ver = it->second.version;
+                LOG_INFO << "Found python in installed packages " << installed_py_ver;
+            }
+            return find_python_version(solution, std::move(installed_py_ver));
+        }
+
+        /** Whether an installed record is the same artifact as a package to install. */
+        auto is_same_package(const PackageInfo& installed, const PackageInfo& pkg) -> bool
+        {
+            if ((installed.name != pkg.name) || (installed.version != pkg.version)
+                || (installed.build_string != pkg.build_string))
+            {
+                return false;
+            }
+            // Hashes tell apart rebuilds with the same name, version and build string
+            if (!installed.sha256.empty() && !pkg.sha256.empty())
+            {
+                return installed.sha256 == pkg.sha256;
+            }
+            if (!installed.md5.empty() && !pkg.md5.empty())
+            {
+                return installed.md5 == pkg.md5;
+            }
+            return true;
+        }
+
+        /** The action replacing an installed record by another package of the same name. */
+        auto replace_action(PackageInfo installed, PackageInfo pkg) -> Solution::Action
+        {
+            try
+            {
+                const auto installed_version = specs::Version::parse(installed.version);
+                const auto version = specs::Version::parse(pkg.version);
+                if (installed_version < version)
                 {
-                    if (pkg.name == "python")
+                    return Solution::Upgrade{ std::move(installed), std::move(pkg) };
+                }
+                if (version < installed_version)
+                {
+                    return Solution::Downgrade{ std::move(installed), std::move(pkg) };
+                }
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Could not compare versions of " << pkg.name << ": " << e.what();
+            }
+            return Solution::Change{ std::move(installed), std::move(pkg) };
+        }
+
+        /**
+         * The actions installing already solved packages in a prefix, dependencies first.
+         *
+         * Packages installed identically are left out, and installed packages absent from the
+         * list are kept, so only the changed packages are touched.
+         */
+        auto lockfile_to_solution(
+            const PrefixData& prefix,
+            const std::vector<PackageInfo>& packages,
+            ChannelContext& channel_context
+        ) -> Solution
+        {
+            auto dep_graph = util::DiGraph<const PackageInfo*>();
+            using node_id = typename decltype(dep_graph)::node_id;
+
+            auto name_to_node_id = std::unordered_map<std::string_view, node_id>();
+            for (const auto& pkg : packages)
+            {
+                name_to_node_id[pkg.name] = dep_graph.add_node(&pkg);
+            }
+            // As in PrefixData::sorted_records, there is only one package with a given name
+            for (const auto& [to_id, pkg] : dep_graph.nodes())
+            {
+                for (const auto& dep : pkg->depends)
+                {
+                    const auto ms = MatchSpec{ dep, channel_context };
+                    const auto from_iter = name_to_node_id.find(ms.name);
+                    if ((from_iter != name_to_node_id.cend()) && (from_iter->second != to_id))
                     {
-                        new_py_ver = pkg.version;
-                        LOG_INFO << "Found python version in packages to be installed " << new_py_ver;
-                        // Could break but not supported with for_each API
+                        dep_graph.add_edge(from_iter->second, to_id);
+                    }
+                }
+            }
+
+            auto out = Solution::action_list();
+            out.reserve(packages.size());
+            util::topological_sort_for_each_node_id(
+                dep_graph,
+                [&](node_id id)
+                {
+                    const auto& pkg = *dep_graph.node(id);
+                    const auto installed = prefix.records().find(pkg.name);
+                    if (installed == prefix.records().cend())
+                    {
+                        LOG_DEBUG << "Solution: Install " << pkg.str();
+                        out.push_back(Solution::Install{ pkg });
+                    }
+                    else if (is_same_package(installed->second, pkg))
+                    {
+                        LOG_DEBUG << "Already installed " << pkg.str();
+                    }
+                    else
+                    {
+                        LOG_DEBUG << "Solution: Replace " << installed->second.str() << " -> "
+                                  << pkg.str();
+                        out.push_back(replace_action(installed->second, pkg));
                     }
                 }
             );
+            return { std::move(out) };
+        }
 
-            return { std::move(new_py_ver), std::move(installed_py_ver) };
+        /** Wall time, bytes and throughput of the main phases of an install. */
+        auto phases_summary(const Tracer& tracer) -> nlohmann::json
+        {
+            // Phase name, span name prefix and enclosing span
+            static constexpr std::array<std::array<std::string_view, 3>, 9> phases = { {
+                { "fetch_repodata", "load_channels", "" },
+                { "solve", "solve", "" },
+                { "download", "download ", "fetch_extract" },
+                { "verify", "validate ", "" },
+                { "extract", "extract ", "" },
+                { "unlink", "unlink ", "" },
+                { "link", "link ", "" },
+                { "pyc_compile", "compile pyc", "" },
+                { "post_link", "post-link ", "" },
+            } };
+
+            auto out = nlohmann::json::object();
+            for (const auto& [name, prefix, within] : phases)
+            {
+                const auto phase = tracer.phase(prefix, within);
+                const auto wall_time = std::chrono::duration<double>(phase.wall_time).count();
+                auto j = nlohmann::json{
+                    { "count", phase.count },
+                    { "wall_time_ms", wall_time * 1000 },
+                    { "bytes", phase.bytes },
+                };
+                if ((phase.bytes > 0) && (wall_time > 0))
+                {
+                    j["bytes_per_second"] = static_cast<double>(phase.bytes) / wall_time;
+                }
+                out[std::string(name)] = std::move(j);
+            }
+            return out;
         }
     }
 
@@ -362,6 +566,7 @@ namespace mamba
         : m_pool(p_pool)
         , m_multi_cache(caches)
     {
+        auto trace = Tracer::instance().scope("transaction");
         if (!solver.is_solved())
         {
             throw std::runtime_error("Cannot create transaction without calling solver.solve() first."
@@ -369,7 +574,11 @@ namespace mamba
         }
         auto& pool = m_pool.pool();
 
-        auto trans = solv::ObjTransaction::from_solver(pool, solver.solver());
+        // The solver has not run when its decisions were loaded from the solver cache
+        const auto* const cached_decision = solver.cached_decision();
+        auto trans = (cached_decision != nullptr)
+                         ? solv::ObjTransaction::from_solvables(pool, *cached_decision)
+                         : solv::ObjTransaction::from_solver(pool, solver.solver());
         trans.order(pool);
 
         const auto& flags = solver.flags();
@@ -426,7 +635,14 @@ namespace mamba
         {
             // TODO could we use the solution instead?
             solv::ObjQueue decision = {};
-            solver_get_decisionqueue(solver.solver().raw(), decision.raw());
+            if (cached_decision != nullptr)
+            {
+                decision = *cached_decision;
+            }
+            else
+            {
+                solver_get_decisionqueue(solver.solver().raw(), decision.raw());
+            }
 
             pool.for_each_installed_solvable(
                 [&](solv::ObjSolvableViewConst s)
@@ -446,15 +662,12 @@ namespace mamba
                             // Remove old linked package
                             decision.erase(id_iter);
 
-                            const auto pkg_info = mk_pkginfo(m_pool, s);
+                            // Only the spec is needed, not an owning PackageInfo
+                            const auto pkg_view = m_pool.id2pkgview(s.id());
+                            assert(pkg_view.has_value());
                             solv::ObjQueue const job = {
                                 SOLVER_SOLVABLE_PROVIDES,
-                                pool.add_conda_dependency(fmt::format(
-                                    "{} {} {}",
-                                    pkg_info.name,
-                                    pkg_info.version,
-                                    pkg_info.build_string
-                                )),
+                                pool.add_conda_dependency(pkg_view->spec()),
                             };
 
                             const auto matches = pool.select_solvables(job);
@@ -472,12 +685,10 @@ namespace mamba
                                 // TODO we should also search the local package cache to make
                                 // offline installs work
                                 LOG_WARNING << fmt::format(
-                                    "To upgrade python we need to reinstall noarch",
-                                    " package {} {} {} but we could not find it in",
+                                    "To upgrade python we need to reinstall noarch"
+                                    " package {} but we could not find it in"
                                     " any of the loaded channels.",
-                                    pkg_info.name,
-                                    pkg_info.version,
-                                    pkg_info.build_string
+                                    pkg_view->spec()
                                 );
                             }
                             else
@@ -528,6 +739,7 @@ namespace mamba
 
     MTransaction::MTransaction(
         MPool& pool,
+        const PrefixData& prefix,
         const std::vector<PackageInfo>& packages,
         MultiPackageCache& caches
     )
@@ -535,20 +747,10 @@ namespace mamba
         , m_multi_cache(caches)
     {
         LOG_INFO << "MTransaction::MTransaction - packages already resolved (lockfile)";
-        MRepo mrepo = MRepo(m_pool, "__explicit_specs__", packages);
-        m_pool.create_whatprovides();
-
-        solv::ObjQueue decision = {};
-        // find repo __explicit_specs__ and install all packages from it
-        auto repo = solv::ObjRepoView(*mrepo.repo());
-        repo.for_each_solvable_id([&](solv::SolvableId id) { decision.push_back(id); });
-
-        auto trans = solv::ObjTransaction::from_solvables(m_pool.pool(), decision);
-        trans.order(m_pool.pool());
-
-        m_solution = transaction_to_solution(m_pool, trans);
+        m_solution = lockfile_to_solution(prefix, packages, m_pool.channel_context());
 
         std::vector<MatchSpec> specs_to_install;
+        specs_to_install.reserve(packages.size());
         for (const auto& pkginfo : packages)
         {
             specs_to_install.push_back(MatchSpec(
@@ -560,7 +762,7 @@ namespace mamba
         m_transaction_context = TransactionContext(
             Context::instance().prefix_params.target_prefix,
             Context::instance().prefix_params.relocate_prefix,
-            find_python_version(m_solution, m_pool.pool()),
+            find_python_version(m_solution, prefix),
             specs_to_install
         );
     }
@@ -570,17 +772,312 @@ namespace mamba
         return find_python_version(m_solution, m_pool.pool());
     }
 
+    namespace
+    {
+        using action_graph = util::DiGraph<std::size_t>;
+
+        std::size_t link_package_threads(std::size_t n_actions)
+        {
+            return std::min(
+                clamp_worker_threads(Context::instance().threads_params.link_threads),
+                std::max<std::size_t>(n_actions, 1)
+            );
+        }
+
+        /**
+         * The same path for all the packages, whatever the separator and case they recorded.
+         *
+         * Paths differing only by case are the same file on case-insensitive file systems,
+         * the default on Windows and macOS, and ordering them elsewhere only costs some
+         * concurrency.
+         */
+        auto path_key(std::string path) -> std::string
+        {
+            std::replace(path.begin(), path.end(), '\\', '/');
+            return to_lower(std::move(path));
+        }
+
+        /** The link plan of an extracted package, whose ``noarch`` is read from its index. */
+        auto read_link_plan(const fs::u8path& pkg_dir, const TransactionContext& context)
+            -> LinkPlan
+        {
+            auto index_file = open_ifstream(pkg_dir / "info" / "index.json");
+            const auto index_json = nlohmann::json::parse(index_file);
+            const auto noarch = index_json.find("noarch");
+            const bool noarch_python = (noarch != index_json.end()) && noarch->is_string()
+                                       && (noarch->get<std::string>() == "python");
+            return make_link_plan(pkg_dir, context, noarch_python);
+        }
+
+        /**
+         * The paths, relative to the prefix, of the files linked from an extracted package.
+         *
+         * The files of noarch python packages are moved to the site-packages and bin
+         * directories, where they also get entry points.
+         */
+        auto linked_paths(const LinkPlan& plan) -> std::vector<std::string>
+        {
+            auto out = std::vector<std::string>();
+            out.reserve(plan.targets.size());
+            for (const auto& target : plan.targets)
+            {
+                out.push_back(path_key(target));
+            }
+
+            const auto link_json_file = plan.source / "info" / "link.json";
+            if (plan.noarch_python && fs::exists(link_json_file))
+            {
+                auto link_file = open_ifstream(link_json_file);
+                const auto link_json = nlohmann::json::parse(link_file);
+                const auto noarch = link_json.find("noarch");
+                if ((noarch != link_json.end()) && noarch->contains("entry_points"))
+                {
+                    for (const auto& ep : noarch->at("entry_points"))
+                    {
+                        const auto command = parse_entry_point(ep.get<std::string>()).command;
+                        auto script = get_bin_directory_short_path() / command;
+                        out.push_back(path_key(script.string()));
+                        // Windows script and launcher
+                        out.push_back(path_key(script.string() + "-script.py"));
+                        out.push_back(path_key(script.replace_extension("exe").string()));
+                    }
+                }
+            }
+            return out;
+        }
+
+        /**
+         * Order constraints between the actions of a solution, by index.
+         *
+         * An action comes after the earlier actions removing or installing one of its files or
+         * a package of the same name, so that executing the graph gives the same prefix as
+         * executing the actions in order, and so that removals and installations of unrelated
+         * packages overlap.
+         * An action installing a package also comes after the earlier actions installing one
+         * of its dependencies.
+         * All packages come after python, since noarch python packages need it to compile pyc
+         * files, and the dependencies of explicit installs are not known.
+         *
+         * @param removed_paths The recorded paths of the package removed by each action.
+         * @param installed_paths The linked paths of the package installed by each action.
+         */
+        auto make_action_graph(
+            const Solution::action_list& actions,
+            const std::vector<std::optional<std::vector<std::string>>>& removed_paths,
+            const std::vector<std::vector<std::string>>& installed_paths,
+            ChannelContext& channel_context
+        ) -> action_graph
+        {
+            auto graph = action_graph();
+            for (std::size_t i = 0; i < actions.size(); ++i)
+            {
+                graph.add_node(i);
+            }
+
+            // Single index of the paths of the prefix touched by the transaction
+            std::unordered_map<std::string, std::size_t> path_actions = {};
+            std::unordered_map<std::string, std::size_t> name_actions = {};
+            std::unordered_map<std::string, std::size_t> name_installers = {};
+            auto after_last = [&](auto& last_actions, const std::string& key, std::size_t i)
+            {
+                auto [it, inserted] = last_actions.emplace(key, i);
+                // An action removing and installing the same path is already ordered
+                if (!inserted && (it->second != i))
+                {
+                    graph.add_edge(it->second, i);
+                    it->second = i;
+                }
+            };
+
+            for (std::size_t i = 0; i < actions.size(); ++i)
+            {
+                std::visit(
+                    [&](const auto& act)
+                    {
+                        using Action = std::decay_t<decltype(act)>;
+                        if constexpr (std::is_same_v<Action, Solution::Reinstall>)
+                        {
+                            after_last(name_actions, act.what.name, i);
+                        }
+                        if constexpr (Solution::has_remove_v<Action>)
+                        {
+                            after_last(name_actions, act.remove.name, i);
+                        }
+                        if constexpr (Solution::has_install_v<Action>)
+                        {
+                            after_last(name_actions, act.install.name, i);
+                        }
+                    },
+                    actions[i]
+                );
+
+                if (removed_paths[i].has_value())
+                {
+                    for (const auto& path : removed_paths[i].value())
+                    {
+                        after_last(path_actions, path_key(path), i);
+                    }
+                }
+                for (const auto& path : installed_paths[i])
+                {
+                    after_last(path_actions, path, i);
+                }
+
+                const PackageInfo* pkg = std::visit(
+                    [](const auto& act) -> const PackageInfo*
+                    {
+                        using Action = std::decay_t<decltype(act)>;
+                        if constexpr (Solution::has_install_v<Action>)
+                        {
+                            return &act.install;
+                        }
+                        else if constexpr (std::is_same_v<Action, Solution::Reinstall>)
+                        {
+                            return &act.what;
+                        }
+                        return nullptr;
+                    },
+                    actions[i]
+                );
+                if (pkg == nullptr)
+                {
+                    continue;
+                }
+
+                if (auto it = name_installers.find("python"); it != name_installers.end())
+                {
+                    graph.add_edge(it->second, i);
+                }
+                for (const auto& dep : pkg->depends)
+                {
+                    const auto name = MatchSpec(dep, channel_context).name;
+                    if (auto it = name_installers.find(name); it != name_installers.end())
+                    {
+                        graph.add_edge(it->second, i);
+                    }
+                }
+                name_installers[pkg->name] = i;
+            }
+            return graph;
+        }
+
+        /**
+         * Call ``func`` on all the nodes of ``graph`` from ``n_threads`` threads.
+         *
+         * A node is started once all its predecessors are done, lowest index first, so that a
+         * single thread follows the original order. Once a call throws, or a signal interrupts
+         * the process, no more nodes are started and the first exception is rethrown after the
+         * running ones are done.
+         */
+        template <typename Func>
+        void
+        execute_action_graph(const action_graph& graph, std::size_t n_threads, const Func& func)
+        {
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::vector<std::size_t> remaining(graph.number_of_nodes());
+            std::set<std::size_t> ready = {};
+            graph.for_each_node_id(
+                [&](auto id)
+                {
+                    remaining[id] = graph.in_degree(id);
+                    if (remaining[id] == 0)
+                    {
+                        ready.insert(id);
+                    }
+                }
+            );
+            std::size_t running = 0;
+            bool stopped = false;
+            std::exception_ptr error;
+
+            auto work = [&]()
+            {
+                auto lock = std::unique_lock<std::mutex>(mutex);
+                while (true)
+                {
+                    cv.wait(lock, [&] { return stopped || !ready.empty() || running == 0; });
+                    if (stopped || is_sig_interrupted() || ready.empty())
+                    {
+                        stopped = true;
+                        cv.notify_all();
+                        return;
+                    }
+
+                    const auto id = *ready.begin();
+                    ready.erase(ready.begin());
+                    ++running;
+                    lock.unlock();
+                    std::exception_ptr func_error;
+                    try
+                    {
+                        func(graph.node(id));
+                    }
+                    catch (...)
+                    {
+                        func_error = std::current_exception();
+                    }
+                    lock.lock();
+                    --running;
+
+                    if (func_error)
+                    {
+                        if (!error)
+                        {
+                            error = func_error;
+                        }
+                        stopped = true;
+                    }
+                    else
+                    {
+                        for (auto succ : graph.successors(id))
+                        {
+                            if (--remaining[succ] == 0)
+                            {
+                                ready.insert(succ);
+                            }
+                        }
+                    }
+                    cv.notify_all();
+                }
+            };
+
+            std::vector<std::thread> workers;
+            workers.reserve(n_threads - 1);
+            for (std::size_t t = 1; t < n_threads; ++t)
+            {
+                workers.emplace_back(work);
+            }
+            work();
+            for (auto& w : workers)
+            {
+                w.join();
+            }
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    /**
+     * Journal of the executed actions, undone in the reverse order of their completion.
+     *
+     * Actions may complete on different threads.
+     */
     class TransactionRollback
     {
     public:
 
         void record(const UnlinkPackage& unlink)
         {
+            std::lock_guard<std::mutex> lock(m_mutex);
             m_unlink_stack.push(unlink);
         }
 
         void record(const LinkPackage& link)
         {
+            std::lock_guard<std::mutex> lock(m_mutex);
             m_link_stack.push(link);
         }
 
@@ -603,10 +1100,17 @@ namespace mamba
 
         std::stack<UnlinkPackage> m_unlink_stack;
         std::stack<LinkPackage> m_link_stack;
+        std::mutex m_mutex;
     };
 
     bool MTransaction::execute(PrefixData& prefix)
     {
+        return execute(prefix, linked_callback_type());
+    }
+
+    bool MTransaction::execute(PrefixData& prefix, const linked_callback_type& on_linked)
+    {
+        auto trace = Tracer::instance().scope("execute");
         auto& ctx = Context::instance();
 
         // JSON output
@@ -632,8 +1136,113 @@ namespace mamba
         auto lf = LockFile(ctx.prefix_params.target_prefix / "conda-meta");
         clean_trash_files(ctx.prefix_params.target_prefix, false);
 
+        const auto& actions = m_solution.actions;
+        const std::size_t n_threads = link_package_threads(actions.size());
+        const bool pipelined = ctx.link_while_downloading && !ctx.download_only;
+        // Files of the installed packages, planned while the next packages are extracted
+        std::vector<std::optional<LinkPlan>> link_plans(actions.size());
+        // When pipelined, the packages extracted so far and whether fetching is over
+        std::vector<fs::u8path> extracted_dirs(actions.size());
+        bool fetch_done = false;
+        std::exception_ptr fetch_error;
+        std::mutex fetch_mutex;
+        std::condition_variable fetch_cv;
+        auto on_extracted = extracted_callback_type();
+        auto install_actions = std::unordered_map<std::string, std::size_t>();
+        if (((n_threads > 1) || pipelined) && !ctx.download_only)
+        {
+            for (std::size_t i = 0; i < actions.size(); ++i)
+            {
+                if (const auto* pkg = detail::to_install_ptr(actions[i]))
+                {
+                    install_actions.emplace(pkg->str(), i);
+                }
+            }
+            on_extracted = [&](const PackageInfo& pkg, const fs::u8path& pkg_dir)
+            {
+                const auto it = install_actions.find(pkg.str());
+                if (it == install_actions.end())
+                {
+                    return;
+                }
+                if (pipelined)
+                {
+                    std::lock_guard<std::mutex> lock(fetch_mutex);
+                    extracted_dirs[it->second] = pkg_dir;
+                    fetch_cv.notify_all();
+                    return;
+                }
+                try
+                {
+                    link_plans[it->second] = read_link_plan(pkg_dir, m_transaction_context);
+                }
+                catch (const std::exception& e)
+                {
+                    // Planned again once all packages are extracted
+                    LOG_DEBUG << "Could not plan '" << pkg_dir.string() << "': " << e.what();
+                }
+            };
+        }
+
+        // When pipelined, the caches are only queried before fetching starts
+        std::vector<fs::u8path> unlink_cache_paths(actions.size());
+        if (pipelined)
+        {
+            for (std::size_t i = 0; i < actions.size(); ++i)
+            {
+                if (const auto* pkg = detail::to_remove_ptr(actions[i]))
+                {
+                    unlink_cache_paths[i] = m_multi_cache.get_extracted_dir_path(*pkg);
+                }
+            }
+        }
+
         Console::stream() << "\nTransaction starting";
-        fetch_extract_packages();
+        auto fetcher = std::thread();
+        if (pipelined)
+        {
+            fetcher = std::thread(
+                [&]()
+                {
+                    try
+                    {
+                        fetch_extract_packages(on_extracted);
+                    }
+                    catch (...)
+                    {
+                        fetch_error = std::current_exception();
+                    }
+                    std::lock_guard<std::mutex> lock(fetch_mutex);
+                    fetch_done = true;
+                    fetch_cv.notify_all();
+                }
+            );
+        }
+        else
+        {
+            fetch_extract_packages(on_extracted);
+        }
+        // Also when linking failed, as the fetching thread uses the state above
+        const auto join_fetcher = on_scope_exit(
+            [&]
+            {
+                if (fetcher.joinable())
+                {
+                    fetcher.join();
+                }
+            }
+        );
+        // The directory of the cache where the package of an action is extracted
+        const auto wait_extracted = [&](std::size_t i, const PackageInfo& pkg) -> fs::u8path
+        {
+            std::unique_lock<std::mutex> lock(fetch_mutex);
+            fetch_cv.wait(lock, [&]() { return !extracted_dirs[i].empty() || fetch_done; });
+            if (extracted_dirs[i].empty())
+            {
+                throw std::runtime_error("Could not download or extract " + pkg.str());
+            }
+            return extracted_dirs[i].parent_path();
+        };
 
         if (ctx.download_only)
         {
@@ -643,26 +1252,78 @@ namespace mamba
         }
 
         TransactionRollback rollback;
+        // conda-meta is updated at once, also with what was done or undone on failure
+        m_transaction_context.start_records_batch();
+        const auto commit_records = on_scope_exit([&] { m_transaction_context.commit_records(); });
+        // Protects the package caches and the history entry from concurrent actions
+        std::mutex execute_mutex;
+
+        // Paths removed by each action when actions run concurrently, read once for ordering
+        std::vector<std::optional<std::vector<std::string>>> removed_paths(actions.size());
+        std::vector<fs::u8path> unlinked_directories = {};
 
-        const auto execute_action = [&](const auto& act)
+        const auto execute_action = [&](const auto& act, std::size_t i)
         {
             using Action = std::decay_t<decltype(act)>;
 
             auto const link = [&](PackageInfo const& pkg)
             {
-                const fs::u8path cache_path(m_multi_cache.get_extracted_dir_path(pkg, false));
-                LinkPackage lp(pkg, cache_path, &m_transaction_context);
+                std::unique_lock<std::mutex> lock(execute_mutex, std::defer_lock);
+                fs::u8path cache_path;
+                if (pipelined)
+                {
+                    // Not holding the lock, as the package may still be downloading
+                    cache_path = wait_extracted(i, pkg);
+                }
+                else
+                {
+                    lock.lock();
+                    cache_path = m_multi_cache.get_extracted_dir_path(pkg, false);
+                    lock.unlock();
+                }
+                // Planned by this action only, or once all packages were extracted
+                auto plan = std::exchange(link_plans[i], std::nullopt);
+                if (plan.has_value() && (plan->source != cache_path / pkg.str()))
+                {
+                    plan.reset();
+                }
+                LinkPackage lp(
+                    pkg,
+                    cache_path,
+                    &m_transaction_context,
+                    take_extracted_record(pkg),
+                    std::move(plan)
+                );
                 lp.execute();
                 rollback.record(lp);
+                lock.lock();
                 m_history_entry.link_dists.push_back(pkg.long_str());
+                lock.unlock();
+                if (on_linked)
+                {
+                    on_linked(pkg);
+                }
             };
             auto const unlink = [&](PackageInfo const& pkg)
             {
-                const fs::u8path cache_path(m_multi_cache.get_extracted_dir_path(pkg));
-                UnlinkPackage up(pkg, cache_path, &m_transaction_context);
+                std::unique_lock<std::mutex> lock(execute_mutex);
+                const fs::u8path cache_path(
+                    pipelined ? unlink_cache_paths[i] : m_multi_cache.get_extracted_dir_path(pkg)
+                );
+                lock.unlock();
+                auto* context = &m_transaction_context;
+                auto up = removed_paths[i].has_value()
+                              ? UnlinkPackage(pkg, cache_path, context, *removed_paths[i])
+                              : UnlinkPackage(pkg, cache_path, context);
                 up.execute();
                 rollback.record(up);
+                lock.lock();
                 m_history_entry.unlink_dists.push_back(pkg.long_str());
+                unlinked_directories.insert(
+                    unlinked_directories.end(),
+                    up.unlinked_directories().cbegin(),
+                    up.unlinked_directories().cend()
+                );
             };
 
             if constexpr (std::is_same_v<Action, Solution::Reinstall>)
@@ -689,14 +1350,145 @@ namespace mamba
             }
         };
 
-        for (const auto& action : m_solution.actions)
+        auto graph = action_graph();
+        if (n_threads > 1)
         {
-            if (is_sig_interrupted())
+            // Independent packages are unlinked and linked concurrently
+            auto trace_index = Tracer::instance().scope("index transaction paths");
+            std::vector<std::vector<std::string>> installed_paths(actions.size());
+            parallel_for(
+                actions.size(),
+                n_threads,
+                [&](std::size_t i)
+                {
+                    std::visit(
+                        [&](const auto& act)
+                        {
+                            using Action = std::decay_t<decltype(act)>;
+                            const PackageInfo* removed = nullptr;
+                            const PackageInfo* installed = nullptr;
+                            if constexpr (std::is_same_v<Action, Solution::Reinstall>)
+                            {
+                                removed = &act.what;
+                                installed = &act.what;
+                            }
+                            if constexpr (Solution::has_remove_v<Action>)
+                            {
+                                removed = &act.remove;
+                            }
+                            if constexpr (Solution::has_install_v<Action>)
+                            {
+                                installed = &act.install;
+                            }
+                            if (removed != nullptr)
+                            {
+                                // Without reading the record of the package
+                                removed_paths[i] = m_transaction_context.file_index().files(
+                                    removed->str()
+                                );
+                            }
+                            if ((installed != nullptr) && !link_plans[i].has_value()
+                                && !pipelined)
+                            {
+                                std::unique_lock<std::mutex> lock(execute_mutex);
+                                const auto pkg_dir = m_multi_cache.get_extracted_dir_path(
+                                                         *installed,
+                                                         false
+                                                     )
+                                                     / installed->str();
+                                lock.unlock();
+                                link_plans[i] = read_link_plan(pkg_dir, m_transaction_context);
+                            }
+                            if ((installed != nullptr) && link_plans[i].has_value())
+                            {
+                                installed_paths[i] = linked_paths(*link_plans[i]);
+                            }
+                        },
+                        actions[i]
+                    );
+                }
+            );
+            graph = make_action_graph(
+                actions,
+                removed_paths,
+                installed_paths,
+                m_pool.channel_context()
+            );
+            if (pipelined)
             {
-                break;
+                // The files of a package are only known once extracted, which is too late
+                // to order it after the packages installing the same files
+                std::optional<std::size_t> last_install = {};
+                for (std::size_t i = 0; i < actions.size(); ++i)
+                {
+                    if (detail::to_install_ptr(actions[i]) != nullptr)
+                    {
+                        if (last_install.has_value())
+                        {
+                            graph.add_edge(*last_install, i);
+                        }
+                        last_install = i;
+                    }
+                }
             }
-            std::visit(execute_action, action);
+            LOG_INFO << "Executing " << actions.size() << " actions with "
+                     << graph.number_of_edges() << " ordering constraints on " << n_threads
+                     << " threads";
         }
+        else
+        {
+            for (std::size_t i = 0; i < actions.size(); ++i)
+            {
+                graph.add_node(i);
+            }
+        }
+        const auto execute_actions = [&]()
+        {
+            execute_action_graph(
+                graph,
+                n_threads,
+                [&](std::size_t i)
+                { std::visit([&](const auto& act) { execute_action(act, i); }, actions[i]); }
+            );
+        };
+        if (pipelined)
+        {
+            std::exception_ptr error;
+            try
+            {
+                execute_actions();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            fetcher.join();
+            if (fetch_error)
+            {
+                // Rather than the packages it left missing
+                error = fetch_error;
+            }
+            if (error && !is_sig_interrupted())
+            {
+                // Packages can fail to download after others are linked
+                Console::stream() << "Transaction failed, rollbacking";
+                rollback.rollback();
+                std::rethrow_exception(error);
+            }
+        }
+        else
+        {
+            try
+            {
+                execute_actions();
+            }
+            catch (const thread_interrupted&)
+            {
+                // Rollbacked below, with the other interrupted actions
+            }
+        }
+        // Not removed while packages were being linked in them
+        remove_empty_directories(std::move(unlinked_directories), ctx.prefix_params.target_prefix);
 
         if (is_sig_interrupted())
         {
@@ -704,8 +1496,33 @@ namespace mamba
             rollback.rollback();
             return false;
         }
+        // Shortcuts are not needed by the other packages, created while compilation ends
+        m_transaction_context.start_menu_creation();
         LOG_INFO << "Waiting for pyc compilation to finish";
-        m_transaction_context.wait_for_pyc_compilation();
+        {
+            auto pyc_trace = Tracer::instance().scope("compile pyc (wait)");
+            m_transaction_context.wait_for_pyc_compilation();
+        }
+
+        for (const auto& [pkgs_dir, cloned] : m_transaction_context.clone_support())
+        {
+            Console::stream() << "Files copied from " << pkgs_dir
+                              << (cloned ? " were cloned (copy-on-write)"
+                                         : " could not be cloned (copy-on-write)");
+        }
+
+        // Printed by package name, whatever the order the scripts ran in
+        for (const auto& [name, messages] : m_transaction_context.script_messages())
+        {
+            if (ctx.output_params.json)
+            {
+                std::cerr << messages;
+            }
+            else
+            {
+                Console::instance().print(messages);
+            }
+        }
 
         // Get the name of the executable used directly from the command.
         const auto executable = ctx.command_params.is_micromamba ? "micromamba" : "mamba";
@@ -727,10 +1544,34 @@ namespace mamba
                           << (environment == ctx.prefix_params.target_prefix ? "-p " : "-n ")
                           << environment << " mycommand\n";
 
+        m_transaction_context.wait_for_menu_creation();
+        m_transaction_context.commit_records();
         prefix.history().add_entry(m_history_entry);
+        if (ctx.container_build)
+        {
+            remove_fetched_packages();
+        }
+        // After the history, which can also change conda-meta
+        PackageCacheUsage(m_multi_cache.first_writable_path())
+            .record(ctx.prefix_params.target_prefix);
+        record_package_accesses(m_solution, m_multi_cache);
+        if (ctx.output_params.json)
+        {
+            Console::instance().json_write({ { "peak_rss", peak_resident_memory() } });
+            if (Tracer::instance().enabled())
+            {
+                const auto phases = phases_summary(Tracer::instance());
+                Console::instance().json_write({ { "phases", phases } });
+            }
+        }
         return true;
     }
 
+    const Solution& MTransaction::solution() const
+    {
+        return m_solution;
+    }
+
     auto MTransaction::to_conda() -> to_conda_type
     {
         to_remove_type to_remove_structured = {};
@@ -760,21 +1601,49 @@ namespace mamba
         return std::make_tuple(specs, to_install_structured, to_remove_structured);
     }
 
+    auto MTransaction::cached_actions() -> const std::vector<CachedAction>&
+    {
+        if (m_cached_actions.has_value())
+        {
+            return *m_cached_actions;
+        }
+        validate_caches(m_solution, m_multi_cache);
+        const auto& actions = m_solution.actions;
+        auto out = std::vector<CachedAction>(actions.size());
+        for (std::size_t i = 0; i < actions.size(); ++i)
+        {
+            if (const auto* pkg = detail::to_install_ptr(actions[i]))
+            {
+                out[i].extracted = !m_multi_cache.get_extracted_dir_path(*pkg).empty();
+                out[i].install_cached = out[i].extracted
+                                        || !m_multi_cache.get_tarball_path(*pkg).empty();
+            }
+            if (const auto* pkg = detail::to_remove_ptr(actions[i]))
+            {
+                out[i].remove_cached = !m_multi_cache.get_extracted_dir_path(*pkg).empty()
+                                       || !m_multi_cache.get_tarball_path(*pkg).empty();
+            }
+        }
+        m_cached_actions = std::move(out);
+        return *m_cached_actions;
+    }
+
     void MTransaction::log_json()
     {
         std::vector<nlohmann::json> to_fetch, to_link, to_unlink;
+        const auto& cached = cached_actions();
 
-        for_each_to_install(
-            m_solution.actions,
-            [&](const auto& pkg)
+        for (std::size_t i = 0; i < m_solution.actions.size(); ++i)
+        {
+            if (const auto* pkg = detail::to_install_ptr(m_solution.actions[i]))
             {
-                if (need_pkg_download(pkg, m_multi_cache))
+                if (!cached[i].install_cached)
                 {
-                    to_fetch.push_back(pkg.json_record());
+                    to_fetch.push_back(pkg->json_record());
                 }
-                to_link.push_back(pkg.json_record());
+                to_link.push_back(pkg->json_record());
             }
-        );
+        }
 
         for_each_to_remove(
             m_solution.actions,
@@ -802,8 +1671,78 @@ namespace mamba
         add_json(to_unlink, "UNLINK");
     }
 
+    auto MTransaction::take_extracted_record(const PackageInfo& pkg) -> nlohmann::json
+    {
+        std::lock_guard<std::mutex> lock(m_extracted_records_mutex);
+        const auto it = m_extracted_records.find(pkg.str());
+        if (it == m_extracted_records.end())
+        {
+            return nullptr;
+        }
+        auto out = std::move(it->second);
+        m_extracted_records.erase(it);
+        return out;
+    }
+
+    void MTransaction::remove_fetched_packages()
+    {
+        auto trace = Tracer::instance().scope("remove fetched packages");
+        for (const auto& fetched : std::exchange(m_fetched_packages, {}))
+        {
+            const auto pkgs_dir = fetched.extracted_dir.parent_path();
+            const auto entry_lock = lock_package_entry(
+                pkgs_dir,
+                fetched.filename,
+                LockMode::exclusive
+            );
+            std::error_code ec;
+            fs::remove_all(fetched.extracted_dir, ec);
+            // Tarballs found in the cache, such as one shared between builds, are kept there
+            if (!ec && fetched.downloaded)
+            {
+                fs::remove(pkgs_dir / fetched.filename, ec);
+            }
+            if (ec)
+            {
+                LOG_WARNING << "Could not remove '" << fetched.filename << "' from '"
+                            << pkgs_dir.string() << "': " << ec.message();
+            }
+        }
+    }
+
     bool MTransaction::fetch_extract_packages()
     {
+        return fetch_extract_packages({});
+    }
+
+    bool MTransaction::fetch_extract_packages(const extracted_callback_type& on_extracted)
+    {
+        auto trace = Tracer::instance().scope("fetch_extract");
+        // Counts the targets as they finish, notified by the threads extracting them
+        std::mutex finished_mutex;
+        std::condition_variable finished_cv;
+        std::size_t n_finished = 0;
+        const auto on_finished = [&](PackageDownloadExtractTarget& target)
+        {
+            using VALIDATION_RESULT = PackageDownloadExtractTarget::VALIDATION_RESULT;
+            const auto result = target.validation_result();
+            const bool usable = (result == VALIDATION_RESULT::VALID)
+                                || (result == VALIDATION_RESULT::UNDEFINED);
+            if (auto record = target.take_repodata_record(); usable && !record.is_null())
+            {
+                // Linked without reading it back from the cache
+                std::lock_guard<std::mutex> lock(m_extracted_records_mutex);
+                m_extracted_records[target.package_info().str()] = std::move(record);
+            }
+            if (on_extracted && usable)
+            {
+                on_extracted(target.package_info(), target.extract_path());
+            }
+            std::lock_guard<std::mutex> lock(finished_mutex);
+            ++n_finished;
+            // Under the lock, as the waiting thread can return as soon as it is released
+            finished_cv.notify_all();
+        };
         std::vector<std::unique_ptr<PackageDownloadExtractTarget>> targets;
         MultiDownloadTarget multi_dl;
 
@@ -813,39 +1752,79 @@ namespace mamba
 
         auto& ctx = Context::instance();
         DownloadExtractSemaphore::set_max(ctx.threads_params.extract_threads);
+        MemoryBudget::instance().set_limit(ctx.memory_budget);
+        // Queried before the targets, which can start extracting cached tarballs
+        const auto cached = cached_actions();
+        // Packages are added to the caches from now on
+        m_cached_actions.reset();
+
+        // Package cache usage, reported in the json output
+        std::size_t extracted_hits = 0;
+        std::size_t tarball_hits = 0;
+        std::size_t downloads = 0;
 
         if (ctx.experimental && ctx.verify_artifacts)
         {
             LOG_INFO << "Content trust is enabled, package(s) signatures will be verified";
-        }
 
-        for_each_to_install(
-            m_solution.actions,
-            [&](const auto& pkg)
-            {
-                if (ctx.experimental && ctx.verify_artifacts)
+            // Grouped by channel, to be verified concurrently before any download starts
+            auto signed_pkgs = std::map<
+                const validation::RepoChecker*,
+                std::vector<validation::SignedPackage>>();
+            for_each_to_install(
+                m_solution.actions,
+                [&](const auto& pkg)
                 {
                     const auto& repo_checker = m_pool.channel_context()
                                                    .make_channel(pkg.channel)
                                                    .repo_checker(m_multi_cache);
-                    repo_checker.verify_package(
-                        pkg.json_signable(),
-                        nlohmann::json::parse(pkg.signatures)
-                    );
-
-                    LOG_DEBUG << "'" << pkg.name << "' trusted from '" << pkg.channel << "'";
+                    signed_pkgs[&repo_checker].push_back({ pkg.json_signable(), pkg.signatures });
                 }
+            );
+            const auto n_threads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+            for (const auto& [repo_checker, pkgs] : signed_pkgs)
+            {
+                repo_checker->verify_packages(pkgs, n_threads);
+            }
+            for_each_to_install(
+                m_solution.actions,
+                [&](const auto& pkg)
+                { LOG_DEBUG << "'" << pkg.name << "' trusted from '" << pkg.channel << "'"; }
+            );
+        }
 
-                targets.emplace_back(
-                    std::make_unique<PackageDownloadExtractTarget>(pkg, m_pool.channel_context())
+        for (std::size_t i = 0; i < m_solution.actions.size(); ++i)
+        {
+            const auto* pkg = detail::to_install_ptr(m_solution.actions[i]);
+            if (pkg == nullptr)
+            {
+                continue;
+            }
+            targets.emplace_back(
+                std::make_unique<PackageDownloadExtractTarget>(*pkg, m_pool.channel_context())
+            );
+            targets.back()->set_finished_callback(on_finished);
+            DownloadTarget* download_target = targets.back()->target(m_multi_cache);
+            if (ctx.container_build && !cached[i].extracted)
+            {
+                m_fetched_packages.push_back(
+                    { targets.back()->extract_path(), pkg->fn, download_target != nullptr }
                 );
-                DownloadTarget* download_target = targets.back()->target(m_multi_cache);
-                if (download_target != nullptr)
-                {
-                    multi_dl.add(download_target);
-                }
             }
-        );
+            if (download_target != nullptr)
+            {
+                multi_dl.add(download_target);
+                downloads++;
+            }
+            else if (cached[i].extracted)
+            {
+                extracted_hits++;
+            }
+            else
+            {
+                tarball_hits++;
+            }
+        }
 
         if (ctx.experimental && ctx.verify_artifacts)
         {
@@ -955,31 +1934,55 @@ namespace mamba
             pbar_manager.watch_print();
         }
 
-        bool downloaded = multi_dl.download(MAMBA_DOWNLOAD_FAILFAST | MAMBA_DOWNLOAD_SORT);
+        // In the order of the actions when linked while downloading, so that the first
+        // packages to link are the first ones available
+        bool downloaded = multi_dl.download(
+            ctx.link_while_downloading ? MAMBA_DOWNLOAD_FAILFAST
+                                       : (MAMBA_DOWNLOAD_FAILFAST | MAMBA_DOWNLOAD_SORT)
+        );
         bool all_valid = true;
+        nlohmann::json download_time = { { "actual", multi_dl.elapsed_time() } };
+        if (const auto estimated = multi_dl.estimated_time())
+        {
+            download_time["estimated"] = *estimated;
+        }
+        const auto n_packages = extracted_hits + tarball_hits + downloads;
+        static auto& cache_hits = Metrics::instance().counter(
+            "mamba_package_cache_hits_total",
+            "Packages installed from an extracted directory or a tarball of the package caches"
+        );
+        static auto& cache_misses = Metrics::instance().counter(
+            "mamba_package_cache_misses_total",
+            "Packages downloaded to be installed"
+        );
+        cache_hits.add(static_cast<double>(extracted_hits + tarball_hits));
+        cache_misses.add(static_cast<double>(downloads));
+        nlohmann::json cache = {
+            { "packages", n_packages },
+            { "extracted_hits", extracted_hits },
+            { "tarball_hits", tarball_hits },
+        };
+        if (n_packages > 0)
+        {
+            cache["hit_rate"] = static_cast<double>(extracted_hits + tarball_hits)
+                                / static_cast<double>(n_packages);
+        }
+        Console::instance().json_write({
+            { "download_concurrency", multi_dl.concurrency() },
+            { "download_time", download_time },
+            { "download_retried_bytes", multi_dl.retried_bytes() },
+            { "package_cache", cache },
+        });
 
         if (!downloaded)
         {
             LOG_ERROR << "Download didn't finish!";
             return false;
         }
-        // make sure that all targets have finished extracting
-        while (!is_sig_interrupted())
+        // Targets also finish when interrupted, as extraction stops at interruption points
         {
-            bool all_finished = true;
-            for (const auto& t : targets)
-            {
-                if (!t->finished())
-                {
-                    all_finished = false;
-                    break;
-                }
-            }
-            if (all_finished)
-            {
-                break;
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            std::unique_lock<std::mutex> lock(finished_mutex);
+            finished_cv.wait(lock, [&]() { return n_finished == targets.size(); });
         }
 
         if (!(ctx.graphics_params.no_progress_bars || ctx.output_params.json
@@ -1103,8 +2106,15 @@ namespace mamba
             ignore,
             remove
         };
-        auto format_row =
-            [this, &ctx, &total_size](rows& r, const PackageInfo& s, Status status, std::string diff)
+        // Many packages come from the same few channels
+        auto channel_names = std::unordered_map<std::string, std::string>();
+        auto format_row = [this, &ctx, &total_size, &channel_names](
+                              rows& r,
+                              const PackageInfo& s,
+                              Status status,
+                              std::string diff,
+                              bool cached
+                          )
         {
             const std::size_t dlsize = s.size;
             printers::FormattedString dlsize_s;
@@ -1116,7 +2126,7 @@ namespace mamba
                 }
                 else
                 {
-                    if (!need_pkg_download(s, m_multi_cache))
+                    if (cached)
                     {
                         dlsize_s.s = "Cached";
                         dlsize_s.style = ctx.graphics_params.palette.addition;
@@ -1154,66 +2164,75 @@ namespace mamba
             {
                 if (str == "explicit_specs")
                 {
-                    chan_name = s.fn;
+                    chan_name = cut_repo_name(s.fn);
                 }
                 else
                 {
-                    const Channel& chan = m_pool.channel_context().make_channel(std::string(str));
-                    chan_name = chan.canonical_name();
+                    auto [it, inserted] = channel_names.try_emplace(str);
+                    if (inserted)
+                    {
+                        const Channel& chan = m_pool.channel_context().make_channel(str);
+                        it->second = cut_repo_name(chan.canonical_name());
+                    }
+                    chan_name = it->second;
                 }
             }
             else
             {
                 // note this can and should be <unknown> when e.g. installing from a tarball
-                chan_name = s.channel;
+                chan_name = cut_repo_name(s.channel);
                 assert(chan_name != "__explicit_specs__");
             }
 
             r.push_back({ name,
                           printers::FormattedString(s.version),
                           printers::FormattedString(s.build_string),
-                          printers::FormattedString(cut_repo_name(chan_name)),
+                          printers::FormattedString(std::move(chan_name)),
                           dlsize_s });
         };
 
-        auto format_action = [&](const auto& act)
+        auto format_action = [&](const auto& act, const CachedAction& cached)
         {
             using Action = std::decay_t<decltype(act)>;
             if constexpr (std::is_same_v<Action, Solution::Omit>)
             {
-                format_row(ignored, act.what, Status::ignore, "=");
+                format_row(ignored, act.what, Status::ignore, "=", false);
             }
             else if constexpr (std::is_same_v<Action, Solution::Upgrade>)
             {
-                format_row(upgraded, act.remove, Status::remove, "-");
-                format_row(upgraded, act.install, Status::install, "+");
+                format_row(upgraded, act.remove, Status::remove, "-", cached.remove_cached);
+                format_row(upgraded, act.install, Status::install, "+", cached.install_cached);
             }
             else if constexpr (std::is_same_v<Action, Solution::Downgrade>)
             {
-                format_row(downgraded, act.remove, Status::remove, "-");
-                format_row(downgraded, act.install, Status::install, "+");
+                format_row(downgraded, act.remove, Status::remove, "-", cached.remove_cached);
+                format_row(downgraded, act.install, Status::install, "+", cached.install_cached);
             }
             else if constexpr (std::is_same_v<Action, Solution::Change>)
             {
-                format_row(changed, act.remove, Status::remove, "-");
-                format_row(changed, act.install, Status::install, "+");
+                format_row(changed, act.remove, Status::remove, "-", cached.remove_cached);
+                format_row(changed, act.install, Status::install, "+", cached.install_cached);
             }
             else if constexpr (std::is_same_v<Action, Solution::Reinstall>)
             {
-                format_row(reinstalled, act.what, Status::install, "o");
+                format_row(reinstalled, act.what, Status::install, "o", cached.install_cached);
             }
             else if constexpr (std::is_same_v<Action, Solution::Remove>)
             {
-                format_row(erased, act.remove, Status::remove, "-");
+                format_row(erased, act.remove, Status::remove, "-", cached.remove_cached);
             }
             else if constexpr (std::is_same_v<Action, Solution::Install>)
             {
-                format_row(installed, act.install, Status::install, "+");
+                format_row(installed, act.install, Status::install, "+", cached.install_cached);
             }
         };
-        for (const auto& pkg : m_solution.actions)
+        const auto& cached = cached_actions();
+        for (std::size_t i = 0; i < m_solution.actions.size(); ++i)
         {
-            std::visit(format_action, pkg);
+            std::visit(
+                [&](const auto& act) { format_action(act, cached[i]); },
+                m_solution.actions[i]
+            );
         }
 
         std::stringstream summary;
@@ -1297,13 +2316,20 @@ namespace mamba
 
     MTransaction create_explicit_transaction_from_lockfile(
         MPool& pool,
+        const PrefixData& prefix,
         const fs::u8path& env_lockfile_path,
         const std::vector<std::string>& categories,
         MultiPackageCache& package_caches,
         std::vector<detail::other_pkg_mgr_spec>& other_specs
     )
     {
-        const auto maybe_lockfile = read_environment_lockfile(pool.channel_context(), env_lockfile_path);
+        // Only the packages of the selected categories for the current platform are needed
+        const auto maybe_lockfile = read_environment_lockfile(
+            pool.channel_context(),
+            env_lockfile_path,
+            { Context::instance().platform, categories },
+            env_lockfile_cache_dir()
+        );
         if (!maybe_lockfile)
         {
             throw maybe_lockfile.error();  // NOTE: we cannot return an `un/expected` because
@@ -1361,7 +2387,7 @@ namespace mamba
             );
         }
 
-        return MTransaction{ pool, conda_packages, package_caches };
+        return MTransaction{ pool, prefix, conda_packages, package_caches };
     }
 
 }  // namespace mamba
@@ -3,17 +3,31 @@
 // Distributed under the terms of the BSD 3-Clause License.
 //
 // The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
 #ifndef _WIN32
 #include <csignal>
+
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #include <reproc++/drain.hpp>
 
 #include "mamba/core/environment.hpp"
+#include "mamba/core/fsutil.hpp"
+#include "mamba/core/menuinst.hpp"
 #include "mamba/core/output.hpp"
+#include "mamba/core/thread_utils.hpp"
 #include "mamba/core/transaction_context.hpp"
+#include "mamba/core/util_scope.hpp"
 #include "mamba/core/util_string.hpp"
 
+#include "parallel.hpp"
+
 extern const char data_compile_pyc_py[];
 
 namespace mamba
@@ -89,6 +103,83 @@ namespace mamba
         }
     }
 
+    namespace
+    {
+        /** The directory @p dir with the separator used to join a file to it. */
+        std::string dir_prefix(const fs::u8path& dir)
+        {
+            auto joined = (dir / "x").string();
+            joined.pop_back();
+            return joined;
+        }
+
+        constexpr std::string_view site_packages_dir = "site-packages/";
+        constexpr std::string_view python_scripts_dir = "python-scripts/";
+
+        /** As fs::path::stem, where a leading dot does not start an extension. */
+        std::string_view stem(std::string_view filename)
+        {
+            if (const auto dot = filename.rfind('.'); (dot != std::string_view::npos) && (dot > 0))
+            {
+                return filename.substr(0, dot);
+            }
+            return filename;
+        }
+    }
+
+    NoarchPythonPaths::NoarchPythonPaths(
+        const fs::u8path& target_site_packages_short_path,
+        const std::string& short_python_version
+    )
+        : m_site_packages_dir(dir_prefix(target_site_packages_short_path))
+        , m_bin_dir(dir_prefix(get_bin_directory_short_path()))
+        , m_pycache_dir(dir_prefix("__pycache__"))
+        , m_python2(starts_with(short_python_version, "2"))
+    {
+        std::string py_ver_nodot = short_python_version;
+        replace_all(py_ver_nodot, ".", "");
+        m_pyc_suffix = concat(".cpython-", py_ver_nodot, ".pyc");
+    }
+
+    std::string NoarchPythonPaths::target_path(std::string_view source_short_path) const
+    {
+        if (starts_with(source_short_path, site_packages_dir))
+        {
+            return concat(m_site_packages_dir, source_short_path.substr(site_packages_dir.size()));
+        }
+        else if (starts_with(source_short_path, python_scripts_dir))
+        {
+            return concat(m_bin_dir, source_short_path.substr(python_scripts_dir.size()));
+        }
+        return std::string(source_short_path);
+    }
+
+    std::string NoarchPythonPaths::pyc_path(std::string_view py_path) const
+    {
+        if (m_python2)
+        {
+            // make `.pyc` file in same directory
+            return concat(py_path, "c");
+        }
+#ifdef _WIN32
+        const auto sep = py_path.find_last_of("/\\");
+#else
+        const auto sep = py_path.rfind('/');
+#endif
+        if (sep == std::string_view::npos)
+        {
+            return concat(m_pycache_dir, stem(py_path), m_pyc_suffix);
+        }
+        // Joined with the preferred separator, as with fs::path::parent_path
+        return concat(
+            py_path.substr(0, sep),
+            m_pycache_dir.back(),
+            m_pycache_dir,
+            stem(py_path.substr(sep + 1)),
+            m_pyc_suffix
+        );
+    }
+
     TransactionContext::TransactionContext()
     {
         compile_pyc = Context::instance().compile_pyc;
@@ -111,6 +202,10 @@ namespace mamba
         allow_softlinks = ctx.allow_softlinks;
         always_copy = ctx.always_copy;
         always_softlink = ctx.always_softlink;
+        allow_reflinks = ctx.allow_reflinks;
+        relocation_cache = ctx.relocation_cache && !ctx.container_build;
+        exclude_files = ctx.exclude_files;
+        container_build = ctx.container_build;
 
         std::string old_short_python_version;
         if (python_version.size() == 0)
@@ -122,6 +217,7 @@ namespace mamba
             short_python_version = compute_short_python_version(python_version);
             python_path = get_python_short_path(short_python_version);
             site_packages_path = get_python_site_packages_short_path(short_python_version);
+            noarch_python_paths = NoarchPythonPaths(site_packages_path, short_python_version);
         }
         if (old_python_version.size())
         {
@@ -167,10 +263,19 @@ namespace mamba
             allow_softlinks = other.allow_softlinks;
             always_copy = other.always_copy;
             always_softlink = other.always_softlink;
+            allow_reflinks = other.allow_reflinks;
+            relocation_cache = other.relocation_cache;
+            exclude_files = other.exclude_files;
+            container_build = other.container_build;
             short_python_version = other.short_python_version;
             python_path = other.python_path;
             site_packages_path = other.site_packages_path;
+            noarch_python_paths = other.noarch_python_paths;
             relink_noarch = other.relink_noarch;
+
+            std::lock_guard<std::mutex> lock(m_file_index_mutex);
+            // Loaded again for the new prefix
+            m_file_index.reset();
         }
         return *this;
     }
@@ -178,11 +283,205 @@ namespace mamba
     TransactionContext::~TransactionContext()
     {
         wait_for_pyc_compilation();
+        wait_for_menu_creation();
+        for (const auto& [filename, staged] : m_staged_records)
+        {
+            if (staged.has_value())
+            {
+                std::error_code ec;
+                fs::remove(staged.value(), ec);
+            }
+        }
+    }
+
+    bool TransactionContext::try_clone(
+        const fs::u8path& pkgs_dir,
+        const fs::u8path& src,
+        const fs::u8path& dst
+    )
+    {
+        if (!allow_reflinks)
+        {
+            return false;
+        }
+        const std::string key = pkgs_dir.string();
+        {
+            std::lock_guard<std::mutex> lock(m_clone_mutex);
+            if (auto it = m_clone_support.find(key); it != m_clone_support.end() && !it->second)
+            {
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        mamba_fs::clone_file(src, dst, ec);
+        // Other errors, such as a full disk, are left to the copy
+        const bool unsupported = ec
+                                 && ((ec == std::errc::operation_not_supported)
+                                     || (ec == std::errc::not_supported)
+                                     || (ec == std::errc::function_not_supported)
+                                     || (ec == std::errc::cross_device_link)
+                                     || (ec == std::errc::invalid_argument)
+                                     || (ec == std::errc::inappropriate_io_control_operation));
+        if (!ec || unsupported)
+        {
+            std::lock_guard<std::mutex> lock(m_clone_mutex);
+            if (m_clone_support.emplace(key, !ec).second)
+            {
+                LOG_INFO << "Cloning files from " << pkgs_dir << " to " << target_prefix
+                         << (ec ? " is not supported: " + ec.message() : " is supported");
+            }
+        }
+        return !ec;
+    }
+
+    std::map<std::string, bool> TransactionContext::clone_support() const
+    {
+        std::lock_guard<std::mutex> lock(m_clone_mutex);
+        return m_clone_support;
+    }
+
+    void TransactionContext::start_records_batch()
+    {
+        std::lock_guard<std::mutex> lock(m_records_mutex);
+        m_batch_records = true;
+    }
+
+    void TransactionContext::write_record(const std::string& filename, const std::string& content)
+    {
+        const auto meta_dir = target_prefix / "conda-meta";
+        if (!fs::exists(meta_dir))
+        {
+            fs::create_directories(meta_dir);
+        }
+
+        std::lock_guard<std::mutex> lock(m_records_mutex);
+        // Not ending with .json, so that a staged record is never read as installed
+        const auto path = m_batch_records ? meta_dir / (filename + ".staged") : meta_dir / filename;
+        LOG_TRACE << "Adding package to prefix metadata at '" << path.string() << "'";
+        {
+            std::ofstream out_file = open_ofstream(path);
+            out_file << content;
+        }
+        if (m_batch_records)
+        {
+            m_staged_records[filename] = path;
+        }
+    }
+
+    void TransactionContext::remove_record(const std::string& filename)
+    {
+        const auto meta_dir = target_prefix / "conda-meta";
+
+        std::lock_guard<std::mutex> lock(m_records_mutex);
+        if (!m_batch_records)
+        {
+            fs::remove(meta_dir / filename);
+            return;
+        }
+        auto& staged = m_staged_records[filename];
+        if (staged.has_value())
+        {
+            fs::remove(staged.value());
+        }
+        staged = std::nullopt;
+    }
+
+    fs::u8path TransactionContext::record_path(const std::string& filename) const
+    {
+        const auto meta_dir = target_prefix / "conda-meta";
+
+        std::lock_guard<std::mutex> lock(m_records_mutex);
+        if (m_staged_records.count(filename) > 0)
+        {
+            // Missing if the record was removed
+            return meta_dir / (filename + ".staged");
+        }
+        return meta_dir / filename;
+    }
+
+    bool TransactionContext::commit_records()
+    {
+        const auto meta_dir = target_prefix / "conda-meta";
+
+        std::lock_guard<std::mutex> lock(m_records_mutex);
+        // Once the records it was built from are in place
+        const auto write_index = on_scope_exit([&] { write_file_index(); });
+        if (!m_batch_records)
+        {
+            return true;
+        }
+        m_batch_records = false;
+
+        bool ok = true;
+        for (const auto& [filename, staged] : m_staged_records)
+        {
+            std::error_code ec;
+            if (staged.has_value())
+            {
+                fs::rename(staged.value(), meta_dir / filename, ec);
+            }
+            else
+            {
+                fs::remove(meta_dir / filename, ec);
+            }
+            if (ec)
+            {
+                LOG_ERROR << "Could not update prefix metadata '" << filename
+                          << "': " << ec.message();
+                ok = false;
+            }
+        }
+        LOG_DEBUG << m_staged_records.size() << " prefix metadata records updated";
+        m_staged_records.clear();
+
+#ifndef _WIN32
+        // A single sync of the directory for all the renames
+        const int fd = ::open(meta_dir.string().c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd >= 0)
+        {
+            ok = (::fsync(fd) == 0) && ok;
+            ::close(fd);
+        }
+#endif
+        return ok;
+    }
+
+    PrefixFileIndex& TransactionContext::file_index()
+    {
+        std::lock_guard<std::mutex> lock(m_file_index_mutex);
+        if (m_file_index == nullptr)
+        {
+            m_file_index = std::make_unique<PrefixFileIndex>(target_prefix);
+        }
+        return *m_file_index;
+    }
+
+    void TransactionContext::write_file_index()
+    {
+        std::lock_guard<std::mutex> lock(m_file_index_mutex);
+        if (m_file_index != nullptr)
+        {
+            m_file_index->write();
+        }
+    }
+
+    namespace
+    {
+        std::size_t compile_pyc_threads()
+        {
+            return clamp_worker_threads(Context::instance().threads_params.compile_pyc_threads);
+        }
     }
 
     bool TransactionContext::start_pyc_compilation_process()
     {
-        if (m_pyc_process)
+        // A new process is worth starting for this many files
+        constexpr std::size_t files_per_process = 32;
+
+        if (!m_pyc_processes.empty()
+            && ((m_pyc_processes.size() >= compile_pyc_threads())
+                || (m_pyc_files_count < m_pyc_processes.size() * files_per_process)))
         {
             return true;
         }
@@ -201,10 +500,13 @@ namespace mamba
         {
             if (std::stoull(py_ver_split[0]) >= 3 && std::stoull(py_ver_split[1]) > 5)
             {
-                m_pyc_compileall = std::make_unique<TemporaryFile>();
-                std::ofstream compileall_f = open_ofstream(m_pyc_compileall->path());
-                compile_python_sources(compileall_f);
-                compileall_f.close();
+                if (!m_pyc_compileall)
+                {
+                    m_pyc_compileall = std::make_unique<TemporaryFile>();
+                    std::ofstream compileall_f = open_ofstream(m_pyc_compileall->path());
+                    compile_python_sources(compileall_f);
+                    compileall_f.close();
+                }
 
                 command = { complete_python_path.string(),
                             "-Wi",
@@ -218,15 +520,15 @@ namespace mamba
             return false;
         }
 
-        m_pyc_process = std::make_unique<reproc::process>();
+        auto process = std::make_unique<reproc::process>();
 
         reproc::options options;
 #ifndef _WIN32
         options.env.behavior = reproc::env::empty;
 #endif
         std::map<std::string, std::string> envmap;
-        auto& ctx = Context::instance();
-        envmap["MAMBA_EXTRACT_THREADS"] = std::to_string(ctx.threads_params.extract_threads);
+        // The processes are the workers, they compile their files sequentially
+        envmap["MAMBA_COMPILE_PYC_THREADS"] = "1";
         auto qemu_ld_prefix = env::get("QEMU_LD_PREFIX");
         if (qemu_ld_prefix)
         {
@@ -247,19 +549,20 @@ namespace mamba
         options.working_directory = cwd.c_str();
 
         auto [wrapped_command, script_file] = prepare_wrapped_call(target_prefix, command);
-        m_pyc_script_file = std::move(script_file);
 
         LOG_INFO << "Running wrapped python compilation command " << join(" ", command);
-        std::error_code ec = m_pyc_process->start(wrapped_command, options);
+        std::error_code ec = process->start(wrapped_command, options);
 
         if (ec == std::errc::no_such_file_or_directory)
         {
             LOG_ERROR << "Program not found. Make sure it's available from the PATH. "
                       << ec.message();
-            m_pyc_process = nullptr;
-            return false;
+            // Compile with the processes already started, if any
+            return !m_pyc_processes.empty();
         }
 
+        m_pyc_processes.push_back(std::move(process));
+        m_pyc_script_files.push_back(std::move(script_file));
         return true;
     }
 
@@ -274,53 +577,62 @@ namespace mamba
             return false;
         }
 
-        if (start_pyc_compilation_process() && !m_pyc_process)
-        {
-            return false;
-        }
-
         LOG_INFO << "Compiling " << py_files.size() << " files to pyc";
         for (auto& f : py_files)
         {
+            if (!start_pyc_compilation_process())
+            {
+                return false;
+            }
+
             auto fs = f.string() + "\n";
 
-            auto [nbytes, ec] = m_pyc_process->write(
-                reinterpret_cast<const uint8_t*>(&fs[0]),
-                fs.size()
-            );
+            auto& process = *m_pyc_processes[m_pyc_files_count % m_pyc_processes.size()];
+            auto [nbytes, ec] = process.write(reinterpret_cast<const uint8_t*>(&fs[0]), fs.size());
             if (ec)
             {
                 LOG_INFO << "writing to stdin failed " << ec.message();
                 return false;
             }
+            ++m_pyc_files_count;
         }
 
         return true;
     }
 
+    void
+    TransactionContext::cache_compiled_pyc(const fs::u8path& pyc, const fs::u8path& cached_pyc)
+    {
+        std::lock_guard<std::mutex> lock(m_pyc_to_cache_mutex);
+        m_pyc_to_cache.emplace_back(pyc, cached_pyc);
+    }
+
     void TransactionContext::wait_for_pyc_compilation()
     {
-        if (m_pyc_process)
+        // Let all the processes finish their files before waiting for the first one
+        for (auto& process : m_pyc_processes)
         {
-            std::error_code ec;
-            ec = m_pyc_process->close(reproc::stream::in);
+            std::error_code ec = process->close(reproc::stream::in);
             if (ec)
             {
                 LOG_WARNING << "closing stdin failed " << ec.message();
             }
+        }
 
+        for (auto& process : m_pyc_processes)
+        {
             std::string output;
             std::string err;
             reproc::sink::string output_sink(output);
             reproc::sink::string err_sink(err);
-            ec = reproc::drain(*m_pyc_process, output_sink, err_sink);
+            std::error_code ec = reproc::drain(*process, output_sink, err_sink);
             if (ec)
             {
                 LOG_WARNING << "draining failed " << ec.message();
             }
 
             int status = 0;
-            std::tie(status, ec) = m_pyc_process->stop({
+            std::tie(status, ec) = process->stop({
                 { reproc::stop::wait, reproc::milliseconds(100000) },
                 { reproc::stop::terminate, reproc::milliseconds(5000) },
                 { reproc::stop::kill, reproc::milliseconds(2000) },
@@ -335,7 +647,143 @@ namespace mamba
                 LOG_INFO << "stdout:" << output;
                 LOG_INFO << "stdout:" << err;
             }
-            m_pyc_process = nullptr;
         }
+        m_pyc_processes.clear();
+        m_pyc_script_files.clear();
+        m_pyc_files_count = 0;
+
+        // The package cache may not be writable, the files are then compiled again next time
+        std::lock_guard<std::mutex> lock(m_pyc_to_cache_mutex);
+        for (const auto& [pyc, cached_pyc] : m_pyc_to_cache)
+        {
+            std::error_code ec;
+            if (!fs::exists(target_prefix / pyc, ec))
+            {
+                continue;
+            }
+            fs::create_directories(cached_pyc.parent_path(), ec);
+            fs::remove(cached_pyc, ec);
+            fs::create_hard_link(target_prefix / pyc, cached_pyc, ec);
+            if (ec)
+            {
+                ec.clear();
+                fs::copy_file(target_prefix / pyc, cached_pyc, ec);
+            }
+            if (ec)
+            {
+                LOG_DEBUG << "Could not cache " << pyc << " as " << cached_pyc << ": "
+                          << ec.message();
+            }
+        }
+        m_pyc_to_cache.clear();
+    }
+
+    void TransactionContext::defer_menu_creation(const fs::u8path& json_file)
+    {
+        std::lock_guard<std::mutex> lock(m_deferred_menus_mutex);
+        m_deferred_menus.push_back(json_file);
+    }
+
+    void TransactionContext::start_menu_creation()
+    {
+        std::vector<fs::u8path> menus;
+        {
+            std::lock_guard<std::mutex> lock(m_deferred_menus_mutex);
+            menus = std::exchange(m_deferred_menus, {});
+        }
+        if (menus.empty() || m_menu_thread.joinable())
+        {
+            return;
+        }
+
+        LOG_INFO << "Creating " << menus.size() << " menu shortcuts";
+        m_menu_thread = std::thread(
+            [this, menus = std::move(menus)]()
+            {
+                const std::size_t n_threads = std::min<std::size_t>(
+                    menus.size(),
+                    std::max(1u, std::thread::hardware_concurrency())
+                );
+                parallel_for(
+                    menus.size(),
+                    n_threads,
+                    [&](std::size_t i)
+                    {
+                        // The package may have been unlinked again since
+                        if (fs::exists(menus[i]))
+                        {
+                            create_menu_from_json(menus[i], this);
+                        }
+                    }
+                );
+            }
+        );
+    }
+
+    void TransactionContext::wait_for_menu_creation()
+    {
+        if (m_menu_thread.joinable())
+        {
+            m_menu_thread.join();
+        }
+    }
+
+    void TransactionContext::run_package_script(const std::function<void()>& run, bool exclusive)
+    {
+        const auto max_scripts = clamp_worker_threads(
+            Context::instance().threads_params.script_threads
+        );
+        // An exclusive script takes all the slots
+        const auto slots = exclusive ? max_scripts : std::size_t(1);
+
+        {
+            auto lock = std::unique_lock<std::mutex>(m_scripts_mutex);
+            if (exclusive)
+            {
+                // Other scripts do not start meanwhile, so that it is not delayed indefinitely
+                ++m_waiting_exclusive_scripts;
+                m_scripts_cv.wait(lock, [&] { return m_running_scripts == 0; });
+                --m_waiting_exclusive_scripts;
+            }
+            else
+            {
+                m_scripts_cv.wait(
+                    lock,
+                    [&]
+                    {
+                        return (m_waiting_exclusive_scripts == 0)
+                               && (m_running_scripts < max_scripts);
+                    }
+                );
+            }
+            m_running_scripts += slots;
+        }
+        auto release = on_scope_exit(
+            [&]
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_scripts_mutex);
+                    m_running_scripts -= slots;
+                }
+                m_scripts_cv.notify_all();
+            }
+        );
+        run();
+    }
+
+    void TransactionContext::add_script_messages(const std::string& pkg_name, std::string messages)
+    {
+        if (messages.empty())
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_scripts_mutex);
+        m_script_messages[pkg_name] += messages;
+    }
+
+    std::map<std::string, std::string> TransactionContext::script_messages() const
+    {
+        std::lock_guard<std::mutex> lock(m_scripts_mutex);
+        return m_script_messages;
     }
 }
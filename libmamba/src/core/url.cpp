@@ -4,7 +4,8 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
-#include <regex>
+#include <algorithm>
+#include <string_view>
 
 #include <openssl/evp.h>
 
@@ -13,6 +14,8 @@
 #include "mamba/core/util.hpp"
 #include "mamba/core/util_string.hpp"
 
+#include "curl.hpp"
+
 namespace mamba
 {
     /*********************
@@ -104,23 +107,113 @@ namespace mamba
         cleaned_url = rstrip(cleaned_url, "/");
     }
 
+    // The functions below are called for every package url, so the matching of
+    // ``Context::scheme_regex`` and ``Context::token_regex`` is written by hand.
+    namespace
+    {
+        auto is_lower_alpha(char c) -> bool
+        {
+            return (c >= 'a') && (c <= 'z');
+        }
+
+        auto is_scheme_char(char c) -> bool
+        {
+            return is_lower_alpha(c) || is_digit(c);
+        }
+
+        auto is_token_char(char c) -> bool
+        {
+            return is_alphanum(c) || (c == '-');
+        }
+
+        /** The length of the scheme starting at the beginning of @p str, as a scheme regex. */
+        auto scheme_size(std::string_view str) -> std::size_t
+        {
+            const auto pos = str.find("://");
+            if ((pos == std::string_view::npos) || (pos == 0) || (pos > 12)
+                || !is_lower_alpha(str.front()))
+            {
+                return 0;
+            }
+            const auto scheme = str.substr(0, pos);
+            return std::all_of(scheme.cbegin(), scheme.cend(), is_scheme_char) ? pos : 0;
+        }
+    }
+
     bool has_scheme(const std::string& url)
     {
-        return std::regex_search(url, Context::instance().scheme_regex);
+        // Same as searching ``[a-z][a-z0-9]{0,11}://`` anywhere in the url
+        for (auto pos = url.find("://"); pos != std::string::npos; pos = url.find("://", pos + 1))
+        {
+            for (std::size_t i = 1; (i <= 12) && (i <= pos) && is_scheme_char(url[pos - i]); ++i)
+            {
+                if (is_lower_alpha(url[pos - i]))
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    std::optional<SimpleURLParts> split_simple_url(std::string_view url)
+    {
+        const auto n_scheme = scheme_size(url);
+        if ((n_scheme == 0) || (url.substr(0, n_scheme) == "file"))
+        {
+            return std::nullopt;
+        }
+        const auto rest = url.substr(n_scheme + 3);
+        const auto host_end = rest.find('/');
+        if ((host_end == std::string_view::npos) || (host_end == 0))
+        {
+            return std::nullopt;
+        }
+
+        const auto host = rest.substr(0, host_end);
+        const auto is_host_char = [](char c)
+        { return is_lower_alpha(c) || is_digit(c) || (c == '.') || (c == '-'); };
+        // Numeric hosts are left to curl, which normalizes the many forms of IPv4 addresses
+        const auto tld_start = host.rfind('.') + 1;
+        if (!std::all_of(host.cbegin(), host.cend(), is_host_char) || contains(host, "..")
+            || (host.front() == '.') || (tld_start == host.size())
+            || !is_lower_alpha(host[tld_start]))
+        {
+            return std::nullopt;
+        }
+
+        const auto path = rest.substr(host_end);
+        const auto is_path_char = [](char c)
+        {
+            return is_alphanum(c) || (c == '/') || (c == '.') || (c == '-') || (c == '_')
+                   || (c == '~') || (c == '+') || (c == '=') || (c == ',') || (c == '!');
+        };
+        if (!std::all_of(path.cbegin(), path.cend(), is_path_char)
+            || contains(path, "/./") || contains(path, "/../") || ends_with(path, "/.")
+            || ends_with(path, "/.."))
+        {
+            return std::nullopt;
+        }
+        return { { url.substr(0, n_scheme), host, path } };
     }
 
     void split_anaconda_token(const std::string& url, std::string& cleaned_url, std::string& token)
     {
-        auto token_begin = std::sregex_iterator(url.begin(), url.end(), Context::instance().token_regex);
-        if (token_begin != std::sregex_iterator())
+        // Same as the first match of ``/t/([a-zA-Z0-9-_]{0,2}[a-zA-Z0-9-]*)``
+        if (const auto start = url.find("/t/"); start != std::string::npos)
         {
-            token = token_begin->str().substr(3u);
-            cleaned_url = std::regex_replace(
-                url,
-                Context::instance().token_regex,
-                "",
-                std::regex_constants::format_first_only
-            );
+            auto end = start + 3;
+            for (; (end < url.size()) && (end < start + 5)
+                   && (is_token_char(url[end]) || (url[end] == '_'));
+                 ++end)
+            {
+            }
+            while ((end < url.size()) && is_token_char(url[end]))
+            {
+                ++end;
+            }
+            token = url.substr(start + 3, end - start - 3);
+            cleaned_url = url.substr(0, start) + url.substr(end);
         }
         else
         {
@@ -140,6 +233,13 @@ namespace mamba
     {
         std::string cleaned_url;
         split_anaconda_token(url, cleaned_url, token);
+        if (const auto parts = split_simple_url(cleaned_url))
+        {
+            scheme = parts->scheme;
+            auth = "";
+            remaining_url = rstrip(cleaned_url.substr(scheme.size() + 3), "/");
+            return;
+        }
         URLHandler handler(cleaned_url);
         scheme = handler.scheme();
         auth = handler.auth();
@@ -160,10 +260,13 @@ namespace mamba
 
     bool is_path(const std::string& input)
     {
-        static const std::regex re(R"(\./|\.\.|~|/|[a-zA-Z]:[/\\]|\\\\|//)");
-        std::smatch sm;
-        std::regex_search(input, sm, re);
-        return !sm.empty() && sm.position(0) == 0 && input.find("://") == std::string::npos;
+        // Starts with one of ``./``, ``..``, ``~``, ``/``, ``\\`` or a Windows drive
+        const bool is_drive = (input.size() >= 3) && is_alpha(input[0]) && (input[1] == ':')
+                              && ((input[2] == '/') || (input[2] == '\\'));
+        const bool has_path_start = is_drive || starts_with(input, "./") || starts_with(input, "..")
+                                    || starts_with(input, "~") || starts_with(input, "/")
+                                    || starts_with(input, R"(\\)");
+        return has_path_start && input.find("://") == std::string::npos;
     }
 
     std::string path_to_url(const std::string& path)
@@ -186,6 +289,32 @@ namespace mamba
         return file_scheme + abs_path;
     }
 
+    std::string local_path_from_url(const std::string& url)
+    {
+        static constexpr std::string_view file_scheme = "file://";
+        if (!starts_with(url, file_scheme))
+        {
+            return "";
+        }
+        auto location = std::string_view(url).substr(file_scheme.size());
+        if (starts_with(location, "localhost/"))
+        {
+            location.remove_prefix(std::string_view("localhost").size());
+        }
+        // Windows drive, such as in ``file:///C:/channel``
+        if ((location.size() > 2) && (location[0] == '/') && (location[2] == ':'))
+        {
+            location.remove_prefix(1);
+        }
+        // Paths on other hosts are not local, unlike Windows drives as made by ``path_to_url``
+        const bool is_drive = (location.size() > 1) && (location[1] == ':');
+        if (!is_drive && !starts_with(location, "/"))
+        {
+            return "";
+        }
+        return decode_url(std::string(location));
+    }
+
     std::string unc_url(const std::string& url)
     {
         // Replicate UNC behaviour of url_to_path from conda.common.path
@@ -193,21 +322,30 @@ namespace mamba
         // a url of type file://hostname/path
         // Colon character is excluded to make sure we do not match file URLs with absoulute
         // paths to a windows drive.
-        static const std::regex file_host(R"(file://([^:/]*)(/.*)?)");
-        std::smatch match;
-        if (std::regex_match(url, match, file_host))
+        // Same as matching ``file://([^:/]*)(/.*)?``
+        static constexpr std::string_view file_scheme = "file://";
+        if (!starts_with(url, file_scheme))
         {
-            if (match[1] != "" && match[1] != "localhost" && match[1] != "127.0.0.1"
-                && match[1] != "::1" && !starts_with(match[1].str(), R"(\\))"))
-            {
-                return "file:////" + std::string(match[1].first, url.cend());
-            }
+            return url;
+        }
+        const auto location = std::string_view(url).substr(file_scheme.size());
+        const auto host = location.substr(0, location.find_first_of(":/"));
+        const auto path = location.substr(host.size());
+        if ((!path.empty() && (path.front() != '/')) || (path.find_first_of("\r\n") != path.npos))
+        {
+            return url;
+        }
+        if (host != "" && host != "localhost" && host != "127.0.0.1" && host != "::1"
+            && !starts_with(host, R"(\\)"))
+        {
+            return concat("file:////", location);
         }
         return url;
     }
 
     std::string encode_url(const std::string& url)
     {
+        curl::global_init();
         CURL* curl = curl_easy_init();
         if (curl)
         {
@@ -225,6 +363,7 @@ namespace mamba
 
     std::string decode_url(const std::string& url)
     {
+        curl::global_init();
         CURL* curl = curl_easy_init();
         if (curl)
         {
@@ -46,6 +46,7 @@ extern "C"
 #include "mamba/core/execution.hpp"
 #include "mamba/core/fsutil.hpp"
 #include "mamba/core/invoke.hpp"
+#include "mamba/core/metrics.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/shell_init.hpp"
 #include "mamba/core/thread_utils.hpp"
@@ -246,6 +247,22 @@ namespace mamba
         }
     }
 
+    void write_contents(const fs::u8path& file_path, std::string_view contents)
+    {
+        std::ofstream out;
+        // Unbuffered, the contents are given to the system at once
+        out.rdbuf()->pubsetbuf(nullptr, 0);
+        out.open(file_path.std_path(), std::ios::out | std::ios::binary);
+        if (!out || !out.write(contents.data(), static_cast<std::streamsize>(contents.size())))
+        {
+            throw std::system_error(
+                errno,
+                std::system_category(),
+                "failed to write " + file_path.string()
+            );
+        }
+    }
+
     std::vector<std::string> read_lines(const fs::u8path& file_path)
     {
         std::fstream file_stream(file_path.std_path(), std::ios_base::in | std::ios_base::binary);
@@ -640,7 +657,11 @@ namespace mamba
     {
     public:
 
-        explicit LockFileOwner(const fs::u8path& file_path, const std::chrono::seconds timeout);
+        explicit LockFileOwner(
+            const fs::u8path& file_path,
+            const std::chrono::seconds timeout,
+            LockMode mode
+        );
         ~LockFileOwner();
 
         LockFileOwner(const LockFileOwner&) = delete;
@@ -652,6 +673,8 @@ namespace mamba
         bool lock_non_blocking();
         bool lock_blocking();
         bool lock(bool blocking) const;
+        // Turn a shared lock into an exclusive one, waiting for the other shared locks
+        void upgrade();
 
         void remove_lockfile() noexcept;
         int close_fd();
@@ -672,11 +695,17 @@ namespace mamba
             return m_lockfile_path;
         }
 
+        LockMode mode() const
+        {
+            return m_mode;
+        }
+
     private:
 
         fs::u8path m_path;
         fs::u8path m_lockfile_path;
         std::chrono::seconds m_timeout;
+        LockMode m_mode;
         int m_fd = -1;
         bool m_locked;
         bool m_lockfile_existed;
@@ -696,9 +725,14 @@ namespace mamba
         }
     };
 
-    LockFileOwner::LockFileOwner(const fs::u8path& path, const std::chrono::seconds timeout)
+    LockFileOwner::LockFileOwner(
+        const fs::u8path& path,
+        const std::chrono::seconds timeout,
+        LockMode mode
+    )
         : m_path(path)
         , m_timeout(timeout)
+        , m_mode(mode)
         , m_locked(false)
     {
         std::error_code ec;
@@ -718,7 +752,9 @@ namespace mamba
             m_lockfile_path = m_path.string() + ".lock";
         }
 
-        m_lockfile_existed = fs::exists(m_lockfile_path, ec);
+        // Other processes may be waiting for a shared lock on the same lock-file, which
+        // is therefore never removed
+        m_lockfile_existed = (m_mode == LockMode::shared) || fs::exists(m_lockfile_path, ec);
 #ifdef _WIN32
         m_fd = _wopen(m_lockfile_path.wstring().c_str(), O_RDWR | O_CREAT, 0666);
 #else
@@ -894,7 +930,7 @@ namespace mamba
         }
 #else
         struct flock lock;
-        lock.l_type = F_WRLCK;
+        lock.l_type = (m_mode == LockMode::shared) ? F_RDLCK : F_WRLCK;
         lock.l_whence = SEEK_SET;
         lock.l_start = MAMBA_LOCK_POS;
         lock.l_len = 1;
@@ -920,7 +956,17 @@ namespace mamba
 
     bool LockFileOwner::lock(bool blocking) const
     {
-        if (!set_fd_lock(blocking))
+        static auto& lock_wait_seconds = Metrics::instance().histogram(
+            "mamba_lock_wait_seconds",
+            "Time waiting for file locks held by other processes"
+        );
+        const auto start = MetricHistogram::clock::now();
+        const bool locked = set_fd_lock(blocking);
+        if (blocking)
+        {
+            lock_wait_seconds.observe_since(start);
+        }
+        if (!locked)
         {
             LOG_ERROR << "Could not set lock (" << strerror(errno) << ")";
             return false;
@@ -933,6 +979,24 @@ namespace mamba
         return lock(true);
     }
 
+    void LockFileOwner::upgrade()
+    {
+        if (m_mode == LockMode::exclusive)
+        {
+            return;
+        }
+        LOG_DEBUG << "Upgrading shared lock on '" << m_path.string() << "'";
+        m_mode = LockMode::exclusive;
+#ifndef _WIN32
+        // Converting the lock of the same file descriptor, it is never released meanwhile
+        if (!set_fd_lock(false) && !lock_blocking())
+        {
+            m_mode = LockMode::shared;
+            throw_lock_error(fmt::format("Could not upgrade lock on '{}'", m_path.string()));
+        }
+#endif
+    }
+
     namespace
     {
 
@@ -972,7 +1036,11 @@ namespace mamba
             }
 
             tl::expected<std::shared_ptr<LockFileOwner>, mamba_error>
-            acquire_lock(const fs::u8path& file_path, const std::chrono::seconds timeout)
+            acquire_lock(
+                const fs::u8path& file_path,
+                const std::chrono::seconds timeout,
+                LockMode mode
+            )
             {
                 if (!m_is_file_locking_allowed)
                 {
@@ -981,23 +1049,55 @@ namespace mamba
                 }
 
                 const auto absolute_file_path = fs::absolute(file_path);
-                std::scoped_lock lock{ mutex };
 
-                const auto it = locked_files.find(absolute_file_path);
-                if (it != locked_files.end())
+                // Waiting for another process only blocks the threads locking the same path
+                auto path_mutex = std::shared_ptr<std::mutex>();
                 {
-                    if (auto lockedfile = it->second.lock())
+                    std::scoped_lock lock{ mutex };
+                    auto& slot = path_mutexes[absolute_file_path];
+                    if (slot == nullptr)
                     {
-                        log_duplicate_lockfile_in_process(absolute_file_path);
-                        return lockedfile;
+                        slot = std::make_shared<std::mutex>();
                     }
+                    path_mutex = slot;
+                }
+                std::scoped_lock path_lock{ *path_mutex };
+
+                auto alive_lockedfile = std::shared_ptr<LockFileOwner>();
+                {
+                    std::scoped_lock lock{ mutex };
+                    if (const auto it = locked_files.find(absolute_file_path);
+                        it != locked_files.end())
+                    {
+                        alive_lockedfile = it->second.lock();
+                    }
+                }
+                if (auto lockedfile = std::move(alive_lockedfile))
+                {
+                    log_duplicate_lockfile_in_process(absolute_file_path);
+                    if (mode == LockMode::exclusive)
+                    {
+                        return safe_invoke(
+                            [&]
+                            {
+                                lockedfile->upgrade();
+                                return lockedfile;
+                            }
+                        );
+                    }
+                    return lockedfile;
                 }
 
                 // At this point, we didn't find a lockfile alive, so we create one.
                 return safe_invoke(
                     [&]
                     {
-                        auto lockedfile = std::make_shared<LockFileOwner>(absolute_file_path, timeout);
+                        auto lockedfile = std::make_shared<LockFileOwner>(
+                            absolute_file_path,
+                            timeout,
+                            mode
+                        );
+                        std::scoped_lock lock{ mutex };
                         auto tracker = std::weak_ptr{ lockedfile };
                         locked_files.insert_or_assign(absolute_file_path, std::move(tracker));
                         fd_to_locked_path.insert_or_assign(lockedfile->fd(), absolute_file_path);
@@ -1056,6 +1156,9 @@ namespace mamba
                                                                                         // whole
                                                                                         // container
 
+            // Serialize the locking of each path, without holding `mutex` while waiting
+            std::unordered_map<fs::u8path, std::shared_ptr<std::mutex>> path_mutexes;
+
             std::unordered_map<int, fs::u8path> fd_to_locked_path;  // this is a workaround the
                                                                     // usage of file descriptors on
                                                                     // linux instead of paths
@@ -1090,13 +1193,17 @@ namespace mamba
     LockFile::LockFile(LockFile&&) = default;
     LockFile& LockFile::operator=(LockFile&&) = default;
 
-    LockFile::LockFile(const fs::u8path& path, const std::chrono::seconds& timeout)
-        : impl{ files_locked_by_this_process.acquire_lock(path, timeout) }
+    LockFile::LockFile(
+        const fs::u8path& path,
+        const std::chrono::seconds& timeout,
+        LockMode mode
+    )
+        : impl{ files_locked_by_this_process.acquire_lock(path, timeout, mode) }
     {
     }
 
-    LockFile::LockFile(const fs::u8path& path)
-        : LockFile(path, std::chrono::seconds(Context::instance().lock_timeout))
+    LockFile::LockFile(const fs::u8path& path, LockMode mode)
+        : LockFile(path, std::chrono::seconds(Context::instance().lock_timeout), mode)
     {
     }
 
@@ -1115,6 +1222,11 @@ namespace mamba
         return impl.value()->lockfile_path();
     }
 
+    LockMode LockFile::mode() const
+    {
+        return impl.value()->mode();
+    }
+
 #ifdef _WIN32
     bool LockFile::is_locked(const fs::u8path& path)
     {
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <iostream>
 #include <regex>
 
@@ -5,6 +6,7 @@
 #include <clocale>
 
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <sys/utsname.h>
 #include <unistd.h>
 #if defined(__APPLE__)
@@ -13,12 +15,15 @@
 #endif
 #include <inttypes.h>
 #include <limits.h>
+#include <signal.h>
 #else
 #include <atomic>
 
 #include <intrin.h>
 #include <io.h>
 #include <windows.h>
+// After windows.h
+#include <psapi.h>
 // Incomplete header included last
 #include <tlhelp32.h>
 #include <WinReg.hpp>
@@ -649,12 +654,60 @@ namespace mamba
         return features;
     }
 
+#ifndef _WIN32
+    namespace
+    {
+        struct ConsoleSize
+        {
+            std::atomic<int> width{ -1 };
+            std::atomic<int> height{ -1 };
+            // Set by SIGWINCH, so that the terminal is only queried again once resized
+            std::atomic<bool> outdated{ true };
+            struct sigaction previous_action = {};
+        };
+
+        ConsoleSize console_size;
+
+        extern "C" void on_console_resized(int signum)
+        {
+            console_size.outdated.store(true);
+            // Chained to the handler of the application, if any
+            const auto& previous = console_size.previous_action;
+            if (((previous.sa_flags & SA_SIGINFO) == 0) && (previous.sa_handler != SIG_DFL)
+                && (previous.sa_handler != SIG_IGN) && (previous.sa_handler != nullptr))
+            {
+                previous.sa_handler(signum);
+            }
+        }
+
+        void update_console_size()
+        {
+            static const bool handler_installed = []
+            {
+                struct sigaction action = {};
+                action.sa_handler = &on_console_resized;
+                sigemptyset(&action.sa_mask);
+                action.sa_flags = SA_RESTART;
+                return sigaction(SIGWINCH, &action, &console_size.previous_action) == 0;
+            }();
+            // Without the handler, the size is queried every time
+            if (!console_size.outdated.exchange(!handler_installed))
+            {
+                return;
+            }
+            struct winsize w;
+            const bool ok = (ioctl(0, TIOCGWINSZ, &w) == 0);
+            console_size.width = ok ? w.ws_col : -1;
+            console_size.height = ok ? w.ws_row : -1;
+        }
+    }
+#endif
+
     int get_console_width()
     {
 #ifndef _WIN32
-        struct winsize w;
-        ioctl(0, TIOCGWINSZ, &w);
-        return w.ws_col;
+        update_console_size();
+        return console_size.width;
 #else
 
         CONSOLE_SCREEN_BUFFER_INFO coninfo;
@@ -666,9 +719,8 @@ namespace mamba
     int get_console_height()
     {
 #ifndef _WIN32
-        struct winsize w;
-        ioctl(0, TIOCGWINSZ, &w);
-        return w.ws_row;
+        update_console_size();
+        return console_size.height;
 #else
 
         CONSOLE_SCREEN_BUFFER_INFO coninfo;
@@ -713,6 +765,30 @@ namespace mamba
         }
 #else
         return path;
+#endif
+    }
+
+    std::size_t peak_resident_memory()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return 0;
+        }
+        return counters.PeakWorkingSetSize;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+        {
+            return 0;
+        }
+#if defined(__APPLE__)
+        return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+        // In kilobytes rather than bytes
+        return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
 #endif
     }
 }
@@ -226,6 +226,52 @@ namespace mamba
         return str.find(sub_str) != std::string::npos;
     }
 
+    bool glob_match(std::string_view pattern, std::string_view path)
+    {
+        while (!pattern.empty())
+        {
+            if (starts_with(pattern, "**"))
+            {
+                pattern.remove_prefix(2);
+                if (starts_with(pattern, "/") && glob_match(pattern.substr(1), path))
+                {
+                    return true;
+                }
+                for (std::size_t i = 0; i <= path.size(); ++i)
+                {
+                    if (glob_match(pattern, path.substr(i)))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            if (pattern.front() == '*')
+            {
+                pattern.remove_prefix(1);
+                for (std::size_t i = 0;; ++i)
+                {
+                    if (glob_match(pattern, path.substr(i)))
+                    {
+                        return true;
+                    }
+                    if ((i == path.size()) || (path[i] == '/'))
+                    {
+                        return false;
+                    }
+                }
+            }
+            if (path.empty() || (path.front() == '/' && pattern.front() == '?')
+                || (pattern.front() != '?' && pattern.front() != path.front()))
+            {
+                return false;
+            }
+            pattern.remove_prefix(1);
+            path.remove_prefix(1);
+        }
+        return path.empty();
+    }
+
     // TODO(C++20) This is a method of string_view
     bool ends_with(std::string_view str, std::string_view suffix)
     {
@@ -581,6 +627,50 @@ namespace mamba
         return rsplit<decltype(input)::value_type>(input, sep, max_split);
     }
 
+    auto split_once(std::string_view str, char sep)
+        -> std::tuple<std::string_view, std::optional<std::string_view>>
+    {
+        const auto pos = str.find(sep);
+        if (pos == std::string_view::npos)
+        {
+            return { str, std::nullopt };
+        }
+        return { str.substr(0, pos), str.substr(pos + 1) };
+    }
+
+    auto split_once(std::string_view str, std::string_view sep)
+        -> std::tuple<std::string_view, std::optional<std::string_view>>
+    {
+        const auto pos = str.find(sep);
+        if (pos == std::string_view::npos)
+        {
+            return { str, std::nullopt };
+        }
+        return { str.substr(0, pos), str.substr(pos + sep.size()) };
+    }
+
+    auto rsplit_once(std::string_view str, char sep)
+        -> std::tuple<std::optional<std::string_view>, std::string_view>
+    {
+        const auto pos = str.rfind(sep);
+        if (pos == std::string_view::npos)
+        {
+            return { std::nullopt, str };
+        }
+        return { str.substr(0, pos), str.substr(pos + 1) };
+    }
+
+    auto rsplit_once(std::string_view str, std::string_view sep)
+        -> std::tuple<std::optional<std::string_view>, std::string_view>
+    {
+        const auto pos = str.rfind(sep);
+        if (pos == std::string_view::npos)
+        {
+            return { std::nullopt, str };
+        }
+        return { str.substr(0, pos), str.substr(pos + sep.size()) };
+    }
+
     /*****************************************
      *  Implementation of replace functions  *
      *****************************************/
@@ -594,16 +684,56 @@ namespace mamba
             std::basic_string_view<Char> replace
         )
         {
+            using Traits = typename std::basic_string<Char>::traits_type;
+            constexpr auto npos = std::basic_string<Char>::npos;
+
             if (search.empty())
             {
                 return;
             }
             std::size_t pos = data.find(search);
-            while (pos != std::string::npos)
+            if (pos == npos)
+            {
+                return;
+            }
+
+            if (replace.size() <= search.size())
+            {
+                // Compacting in place in a single pass, rather than moving the end of the
+                // string for every occurrence.
+                std::size_t read = 0;
+                std::size_t write = 0;
+                while (pos != npos)
+                {
+                    Traits::move(data.data() + write, data.data() + read, pos - read);
+                    write += pos - read;
+                    Traits::copy(data.data() + write, replace.data(), replace.size());
+                    write += replace.size();
+                    read = pos + search.size();
+                    pos = data.find(search, read);
+                }
+                Traits::move(data.data() + write, data.data() + read, data.size() - read);
+                data.resize(write + data.size() - read);
+                return;
+            }
+
+            auto out = std::basic_string<Char>();
+            std::size_t count = 0;
+            for (auto p = pos; p != npos; p = data.find(search, p + search.size()))
+            {
+                ++count;
+            }
+            out.reserve(data.size() + count * (replace.size() - search.size()));
+            std::size_t read = 0;
+            while (pos != npos)
             {
-                data.replace(pos, search.size(), replace);
-                pos = data.find(search, pos + replace.size());
+                out.append(data, read, pos - read);
+                out.append(replace);
+                read = pos + search.size();
+                pos = data.find(search, read);
             }
+            out.append(data, read);
+            data = std::move(out);
         }
     }
 
@@ -4,15 +4,18 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
 #include <iostream>
 #include <regex>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <openssl/evp.h>
 
+#include "mamba/core/context.hpp"
 #include "mamba/core/fetch.hpp"
 #include "mamba/core/fsutil.hpp"
 #include "mamba/core/output.hpp"
@@ -20,6 +23,8 @@
 #include "mamba/core/util_string.hpp"
 #include "mamba/core/validate.hpp"
 
+#include "parallel.hpp"
+
 namespace mamba
 {
     template <class B>
@@ -140,61 +145,95 @@ namespace mamba::validation
     {
     }
 
-    std::string sha256sum(const fs::u8path& path)
+    HashStream::HashStream(const evp_md_st* type, std::size_t digest_size)
+        : m_type(type)
+        , m_ctx(EVP_MD_CTX_create())
+        , m_digest_size(digest_size)
     {
-        unsigned char hash[MAMBA_SHA256_SIZE_BYTES];
-        EVP_MD_CTX* mdctx = EVP_MD_CTX_create();
-        EVP_DigestInit_ex(mdctx, EVP_sha256(), nullptr);
+        reset();
+    }
+
+    HashStream HashStream::sha256()
+    {
+        return HashStream(EVP_sha256(), MAMBA_SHA256_SIZE_BYTES);
+    }
+
+    HashStream HashStream::md5()
+    {
+        return HashStream(EVP_md5(), MAMBA_MD5_SIZE_BYTES);
+    }
 
-        std::ifstream infile = mamba::open_ifstream(path);
+    HashStream::HashStream(HashStream&& other) noexcept
+        : m_type(other.m_type)
+        , m_ctx(std::exchange(other.m_ctx, nullptr))
+        , m_digest_size(other.m_digest_size)
+    {
+    }
 
-        static constexpr std::size_t BUFSIZE = 32768;
-        std::vector<char> buffer(BUFSIZE);
+    HashStream& HashStream::operator=(HashStream&& other) noexcept
+    {
+        std::swap(m_type, other.m_type);
+        std::swap(m_ctx, other.m_ctx);
+        std::swap(m_digest_size, other.m_digest_size);
+        return *this;
+    }
 
-        while (infile)
+    HashStream::~HashStream()
+    {
+        if (m_ctx != nullptr)
         {
-            infile.read(buffer.data(), BUFSIZE);
-            auto count = static_cast<std::size_t>(infile.gcount());
-            if (!count)
-            {
-                break;
-            }
-            EVP_DigestUpdate(mdctx, buffer.data(), count);
+            EVP_MD_CTX_destroy(m_ctx);
         }
+    }
 
-        EVP_DigestFinal_ex(mdctx, hash, nullptr);
-        EVP_MD_CTX_destroy(mdctx);
-
-        return ::mamba::hex_string(hash, MAMBA_SHA256_SIZE_BYTES);
+    void HashStream::update(const char* data, std::size_t size)
+    {
+        EVP_DigestUpdate(m_ctx, data, size);
     }
 
-    std::string md5sum(const fs::u8path& path)
+    std::string HashStream::hex_digest()
     {
-        unsigned char hash[MAMBA_MD5_SIZE_BYTES];
+        std::vector<unsigned char> hash(m_digest_size);
+        EVP_DigestFinal_ex(m_ctx, hash.data(), nullptr);
+        return ::mamba::hex_string(hash);
+    }
 
-        EVP_MD_CTX* mdctx = EVP_MD_CTX_create();
-        EVP_DigestInit_ex(mdctx, EVP_md5(), nullptr);
+    void HashStream::reset()
+    {
+        EVP_DigestInit_ex(m_ctx, m_type, nullptr);
+    }
 
-        std::ifstream infile = mamba::open_ifstream(path);
+    namespace
+    {
+        std::string file_digest(const fs::u8path& path, HashStream hash)
+        {
+            std::ifstream infile = mamba::open_ifstream(path);
 
-        constexpr std::size_t BUFSIZE = 32768;
-        std::vector<char> buffer(BUFSIZE);
+            static constexpr std::size_t BUFSIZE = 32768;
+            std::vector<char> buffer(BUFSIZE);
 
-        while (infile)
-        {
-            infile.read(buffer.data(), BUFSIZE);
-            auto count = static_cast<std::size_t>(infile.gcount());
-            if (!count)
+            while (infile)
             {
-                break;
+                infile.read(buffer.data(), BUFSIZE);
+                auto count = static_cast<std::size_t>(infile.gcount());
+                if (!count)
+                {
+                    break;
+                }
+                hash.update(buffer.data(), count);
             }
-            EVP_DigestUpdate(mdctx, buffer.data(), count);
+            return hash.hex_digest();
         }
+    }
 
-        EVP_DigestFinal_ex(mdctx, hash, nullptr);
-        EVP_MD_CTX_destroy(mdctx);
+    std::string sha256sum(const fs::u8path& path)
+    {
+        return file_digest(path, HashStream::sha256());
+    }
 
-        return ::mamba::hex_string(hash, MAMBA_MD5_SIZE_BYTES);
+    std::string md5sum(const fs::u8path& path)
+    {
+        return file_digest(path, HashStream::md5());
     }
 
     bool sha256(const fs::u8path& path, const std::string& validation)
@@ -375,31 +414,30 @@ namespace mamba::validation
             pk,
             MAMBA_ED25519_KEYSIZE_BYTES
         );
-        EVP_MD_CTX* md_ctx = EVP_MD_CTX_new();
-
         if (ed_key == nullptr)
         {
             LOG_DEBUG << "Failed to read public key raw buffer during verification step";
             return 0;
         }
+        EVP_MD_CTX* md_ctx = EVP_MD_CTX_new();
 
-        int init_status, verif_status;
-        init_status = EVP_DigestVerifyInit(md_ctx, NULL, NULL, NULL, ed_key);
-        if (init_status != 1)
+        int status = EVP_DigestVerifyInit(md_ctx, NULL, NULL, NULL, ed_key);
+        if (status != 1)
         {
             LOG_DEBUG << "Failed to init verification step";
-            return init_status;
         }
-
-        verif_status = EVP_DigestVerify(md_ctx, signature, sig_len, data, data_len);
-        if (verif_status != 1)
+        else
         {
-            LOG_DEBUG << "Failed to verify the data signature";
-            return verif_status;
+            status = EVP_DigestVerify(md_ctx, signature, sig_len, data, data_len);
+            if (status != 1)
+            {
+                LOG_DEBUG << "Failed to verify the data signature";
+            }
         }
 
         EVP_MD_CTX_free(md_ctx);
-        return 1;
+        EVP_PKEY_free(ed_key);
+        return status;
     }
 
     int verify(const std::string& data, const unsigned char* pk, const unsigned char* signature)
@@ -1111,6 +1149,147 @@ namespace mamba::validation
         return root_update;
     }
 
+    namespace
+    {
+        /**
+         * HTTP cache headers of a cached trust metadata file, and when it was last checked
+         * against the server, stored next to it.
+         */
+        struct RoleFileState
+        {
+            std::string etag;
+            std::string mod;
+            std::string cache_control;
+            std::time_t checked = 0;
+        };
+
+        fs::u8path role_state_path(const fs::u8path& metadata_path)
+        {
+            auto state_path = metadata_path;
+            state_path.replace_extension(".state.json");
+            return state_path;
+        }
+
+        RoleFileState read_role_state(const fs::u8path& metadata_path)
+        {
+            const auto state_path = role_state_path(metadata_path);
+            if (metadata_path.empty() || !fs::exists(metadata_path) || !fs::exists(state_path))
+            {
+                return {};
+            }
+
+            try
+            {
+                auto infile = open_ifstream(state_path);
+                const auto j = json::parse(infile);
+                return { j.at("etag").get<std::string>(),
+                         j.at("mod").get<std::string>(),
+                         j.at("cache_control").get<std::string>(),
+                         parse_utc_timestamp(j.at("checked").get<std::string>()) };
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Could not read trust metadata state '" << state_path.string()
+                          << "': " << e.what();
+                return {};
+            }
+        }
+
+        void write_role_state(const fs::u8path& metadata_path, const RoleFileState& state)
+        {
+            const json j = { { "etag", state.etag },
+                             { "mod", state.mod },
+                             { "cache_control", state.cache_control },
+                             { "checked", timestamp(state.checked) } };
+            try
+            {
+                auto outfile = open_ofstream(role_state_path(metadata_path));
+                outfile << j.dump(4);
+            }
+            catch (const std::exception& e)
+            {
+                // Only checked against the server again next time
+                LOG_DEBUG << "Could not write trust metadata state for '" << metadata_path.string()
+                          << "': " << e.what();
+            }
+        }
+
+        /**
+         * Whether the cached file was checked recently enough to be used without any request,
+         * following ``local_repodata_ttl`` as for the repodata.
+         */
+        bool is_fresh(const RoleFileState& state)
+        {
+            const auto ttl = Context::instance().local_repodata_ttl;
+            std::size_t max_age = 0;
+            if (ttl > 1)
+            {
+                max_age = ttl;
+            }
+            else if (ttl == 1)
+            {
+                const auto& cc = state.cache_control;
+                const auto pos = cc.find("max-age=");
+                if (pos != std::string::npos)
+                {
+                    for (auto i = pos + 8; (i < cc.size()) && is_digit(cc[i]); ++i)
+                    {
+                        max_age = max_age * 10 + static_cast<std::size_t>(cc[i] - '0');
+                    }
+                }
+            }
+            return (state.checked > 0)
+                   && (std::difftime(std::time(nullptr), state.checked)
+                       < static_cast<double>(max_age));
+        }
+
+        enum class FetchStatus
+        {
+            updated,
+            unchanged,
+            failed,
+        };
+
+        /**
+         * Download a trust metadata file, conditionally on the cache headers of its cached copy.
+         *
+         * The state is updated with the response. It is recorded right away when the cached copy
+         * is unchanged, and must be recorded by the caller once an updated file is persisted.
+         */
+        FetchStatus fetch_role_file(
+            const std::string& name,
+            const std::string& url,
+            const fs::u8path& tmp_path,
+            const fs::u8path& metadata_path,
+            RoleFileState& state
+        )
+        {
+            auto dl_target = std::make_unique<mamba::DownloadTarget>(name, url, tmp_path.string());
+            dl_target->set_ignore_failure(true);
+            // Only known for a cached copy
+            if (state.checked > 0)
+            {
+                dl_target->set_mod_etag_headers(state.mod, state.etag);
+            }
+            if (!dl_target->perform())
+            {
+                return FetchStatus::failed;
+            }
+
+            state.checked = std::time(nullptr);
+            state.cache_control = dl_target->get_cache_control();
+            if (dl_target->get_http_status() == 304)
+            {
+                LOG_DEBUG << "'" << name << "' metadata did not change";
+                write_role_state(metadata_path, state);
+                return FetchStatus::unchanged;
+            }
+            state.etag = dl_target->get_etag();
+            state.mod = dl_target->get_mod();
+            return FetchStatus::updated;
+        }
+    }
+
     namespace v1
     {
         SpecImpl::SpecImpl(const std::string& sv)
@@ -1437,46 +1616,58 @@ namespace mamba::validation
         ) const
         {
             fs::u8path metadata_path = cache_path / "key_mgr.json";
+            auto state = read_role_state(metadata_path);
+
+            // Recently checked metadata are used without any request, unless expired
+            if (is_fresh(state))
+            {
+                KeyMgrRole key_mgr = create_key_mgr(metadata_path);
+                if (!key_mgr.expired(time_reference))
+                {
+                    LOG_DEBUG << "Using recently checked 'key_mgr' metadata";
+                    return key_mgr.build_index_checker(time_reference, base_url, cache_path);
+                }
+            }
 
             auto tmp_dir = std::make_unique<mamba::TemporaryDirectory>();
             auto tmp_metadata_path = tmp_dir->path() / "key_mgr.json";
 
             mamba::URLHandler url(base_url + "/key_mgr.json");
 
-            auto dl_target = std::make_unique<mamba::DownloadTarget>(
+            const auto status = fetch_role_file(
                 "key_mgr.json",
                 url.url(),
-                tmp_metadata_path.string()
+                tmp_metadata_path,
+                metadata_path,
+                state
             );
-
-            if (dl_target->resource_exists())
+            if (status != FetchStatus::failed)
             {
-                if (dl_target->perform())
-                {
-                    KeyMgrRole key_mgr = create_key_mgr(tmp_metadata_path);
+                const bool updated = status == FetchStatus::updated;
+                KeyMgrRole key_mgr = create_key_mgr(updated ? tmp_metadata_path : metadata_path);
 
-                    // TUF spec 5.6.5 - Check for a freeze attack
-                    // 'key_mgr' (equivalent of 'targets') role should not be expired
-                    // https://theupdateframework.github.io/specification/latest/#update-targets
-                    if (key_mgr.expired(time_reference))
-                    {
-                        LOG_ERROR << "Possible freeze attack of 'key_mgr' metadata.\nExpired: "
-                                  << key_mgr.expires();
-                        throw freeze_error();
-                    }
+                // TUF spec 5.6.5 - Check for a freeze attack
+                // 'key_mgr' (equivalent of 'targets') role should not be expired
+                // https://theupdateframework.github.io/specification/latest/#update-targets
+                if (key_mgr.expired(time_reference))
+                {
+                    LOG_ERROR << "Possible freeze attack of 'key_mgr' metadata.\nExpired: "
+                              << key_mgr.expires();
+                    throw freeze_error();
+                }
 
-                    // TUF spec 5.6.6 - Persist targets metadata
-                    if (!cache_path.empty())
+                // TUF spec 5.6.6 - Persist targets metadata
+                if (updated && !cache_path.empty())
+                {
+                    if (fs::exists(metadata_path))
                     {
-                        if (fs::exists(metadata_path))
-                        {
-                            fs::remove(metadata_path);
-                        }
-                        fs::copy(tmp_metadata_path, metadata_path);
+                        fs::remove(metadata_path);
                     }
-
-                    return key_mgr.build_index_checker(time_reference, base_url, cache_path);
+                    fs::copy(tmp_metadata_path, metadata_path);
+                    write_role_state(metadata_path, state);
                 }
+
+                return key_mgr.build_index_checker(time_reference, base_url, cache_path);
             }
 
             // Fallback to local cached-copy if existing
@@ -1600,46 +1791,58 @@ namespace mamba::validation
         ) const
         {
             fs::u8path metadata_path = cache_path / "pkg_mgr.json";
+            auto state = read_role_state(metadata_path);
+
+            // Recently checked metadata are used without any request, unless expired
+            if (is_fresh(state))
+            {
+                auto pkg_mgr = std::make_unique<PkgMgrRole>(create_pkg_mgr(metadata_path));
+                if (!pkg_mgr->expired(time_reference))
+                {
+                    LOG_DEBUG << "Using recently checked 'pkg_mgr' metadata";
+                    return pkg_mgr;
+                }
+            }
 
             auto tmp_dir = std::make_unique<mamba::TemporaryDirectory>();
             auto tmp_metadata_path = tmp_dir->path() / "pkg_mgr.json";
 
             mamba::URLHandler url(base_url + "/pkg_mgr.json");
 
-            auto dl_target = std::make_unique<mamba::DownloadTarget>(
+            const auto status = fetch_role_file(
                 "pkg_mgr.json",
                 url.url(),
-                tmp_metadata_path.string()
+                tmp_metadata_path,
+                metadata_path,
+                state
             );
-
-            if (dl_target->resource_exists())
+            if (status != FetchStatus::failed)
             {
-                if (dl_target->perform())
-                {
-                    PkgMgrRole pkg_mgr = create_pkg_mgr(tmp_metadata_path);
+                const bool updated = status == FetchStatus::updated;
+                PkgMgrRole pkg_mgr = create_pkg_mgr(updated ? tmp_metadata_path : metadata_path);
 
-                    // TUF spec 5.6.5 - Check for a freeze attack
-                    // 'pkg_mgr' (equivalent of delegated 'targets') role should not be expired
-                    // https://theupdateframework.github.io/specification/latest/#update-targets
-                    if (pkg_mgr.expired(time_reference))
-                    {
-                        LOG_ERROR << "Possible freeze attack of 'pkg_mgr' metadata.\nExpired: "
-                                  << pkg_mgr.expires();
-                        throw freeze_error();
-                    }
+                // TUF spec 5.6.5 - Check for a freeze attack
+                // 'pkg_mgr' (equivalent of delegated 'targets') role should not be expired
+                // https://theupdateframework.github.io/specification/latest/#update-targets
+                if (pkg_mgr.expired(time_reference))
+                {
+                    LOG_ERROR << "Possible freeze attack of 'pkg_mgr' metadata.\nExpired: "
+                              << pkg_mgr.expires();
+                    throw freeze_error();
+                }
 
-                    // TUF spec 5.6.6 - Persist targets metadata
-                    if (!cache_path.empty())
+                // TUF spec 5.6.6 - Persist targets metadata
+                if (updated && !cache_path.empty())
+                {
+                    if (fs::exists(metadata_path))
                     {
-                        if (fs::exists(metadata_path))
-                        {
-                            fs::remove(metadata_path);
-                        }
-                        fs::copy(tmp_metadata_path, metadata_path);
+                        fs::remove(metadata_path);
                     }
-
-                    return std::make_unique<PkgMgrRole>(pkg_mgr);
+                    fs::copy(tmp_metadata_path, metadata_path);
+                    write_role_state(metadata_path, state);
                 }
+
+                return std::make_unique<PkgMgrRole>(pkg_mgr);
             }
 
             // Fallback to local cached-copy if existing
@@ -1850,12 +2053,20 @@ namespace mamba::validation
         }
 
         void PkgMgrRole::check_pkg_signatures(const json& metadata, const json& signatures) const
+        {
+            check_pkg_signatures(metadata, signatures, self_keys());
+        }
+
+        void PkgMgrRole::check_pkg_signatures(
+            const json& metadata,
+            const json& signatures,
+            const RoleFullKeys& keys
+        ) const
         {
             std::string signed_data = canonicalize(metadata);
             auto sigs = pkg_signatures(signatures);
-            auto k = self_keys();
 
-            check_signatures(signed_data, sigs, k);
+            check_signatures(signed_data, sigs, keys);
         }
 
         void PkgMgrRole::verify_index(const json& j) const
@@ -1926,6 +2137,39 @@ namespace mamba::validation
                 throw package_error();
             }
         }
+
+        void PkgMgrRole::verify_packages(
+            const std::vector<SignedPackage>& packages,
+            std::size_t n_threads
+        ) const
+        {
+            // Shared by all the checks, rather than copied for each package
+            const auto keys = self_keys();
+            parallel_for(
+                packages.size(),
+                std::clamp<std::size_t>(n_threads, 1, std::max<std::size_t>(packages.size(), 1)),
+                [&](std::size_t i)
+                {
+                    const auto& pkg = packages[i];
+                    try
+                    {
+                        check_pkg_signatures(pkg.signed_data, json::parse(pkg.signatures), keys);
+                    }
+                    catch (const threshold_error& e)
+                    {
+                        LOG_ERROR << "Validation failed on package: '" << pkg.signed_data.at("name")
+                                  << "' : " << e.what();
+                        throw package_error();
+                    }
+                    catch (const json::exception& e)
+                    {
+                        LOG_ERROR << "Invalid signatures of package: '"
+                                  << pkg.signed_data.at("name") << "' : " << e.what();
+                        throw package_error();
+                    }
+                }
+            );
+        }
     }  // namespace v06
 
     void to_json(json& j, const Key& key)
@@ -2003,6 +2247,15 @@ namespace mamba::validation
         role->set_expiration(j.at(role->spec_version().expiration_json_key()));
     }
 
+    void
+    RepoIndexChecker::verify_packages(const std::vector<SignedPackage>& packages, std::size_t) const
+    {
+        for (const auto& pkg : packages)
+        {
+            verify_package(pkg.signed_data, json::parse(pkg.signatures));
+        }
+    }
+
     RepoChecker::RepoChecker(
         const std::string& base_url,
         const fs::u8path& ref_path,
@@ -2049,7 +2302,15 @@ namespace mamba::validation
         p_index_checker->verify_package(signed_data, signatures);
     }
 
-    std::size_t RepoChecker::root_version()
+    void RepoChecker::verify_packages(
+        const std::vector<SignedPackage>& packages,
+        std::size_t n_threads
+    ) const
+    {
+        p_index_checker->verify_packages(packages, n_threads);
+    }
+
+    std::size_t RepoChecker::root_version() const
     {
         return m_root_version;
     }
@@ -2133,6 +2394,16 @@ namespace mamba::validation
             persist_file(trusted_root);
         }
 
+        // Recently checked roots are not looked for updates, unless expired
+        auto root_state = read_role_state(cached_root());
+        if ((trusted_root == cached_root()) && is_fresh(root_state)
+            && !updated_root->expired(time_reference))
+        {
+            m_root_version = updated_root->version();
+            LOG_DEBUG << "Using recently checked 'root' metadata with version " << m_root_version;
+            return updated_root;
+        }
+
         auto update_files = updated_root->possible_update_files();
         auto tmp_dir = std::make_unique<mamba::TemporaryDirectory>();
         auto tmp_dir_path = tmp_dir->path();
@@ -2183,6 +2454,14 @@ namespace mamba::validation
 
         m_root_version = updated_root->version();
         LOG_DEBUG << "Latest 'root' metadata has version " << m_root_version;
+        if (!cached_root().empty())
+        {
+            // Update files are only probed, so the cache headers of the last 'key_mgr'
+            // response from the same server are used
+            root_state.checked = std::time(nullptr);
+            root_state.cache_control = read_role_state(cache_path() / "key_mgr.json").cache_control;
+            write_role_state(cached_root(), root_state);
+        }
 
         // TUF spec 5.3.10 - Check for a freeze attack
         // Updated 'root' role should not be expired
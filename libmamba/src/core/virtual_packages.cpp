@@ -15,16 +15,209 @@
 #ifdef _WIN32
 #include <windows.h>
 #else
+#include <dlfcn.h>
 #include <unistd.h>
 #endif
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
 
 #include <regex>
+#include <stdexcept>
 #include <vector>
 
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
 #include <reproc++/run.hpp>
 
 namespace mamba
 {
+    namespace
+    {
+        /**
+         * An identifier of the current boot of the host.
+         *
+         * Drivers and the operating system can only be updated across reboots, or by reloading
+         * kernel modules, which is also part of the key where it matters.
+         */
+        std::string boot_id()
+        {
+#if defined(__linux__)
+            try
+            {
+                return std::string(strip(read_contents("/proc/sys/kernel/random/boot_id")));
+            }
+            catch (const std::exception&)
+            {
+                return "";
+            }
+#elif defined(__APPLE__)
+            char uuid[64] = {};
+            std::size_t size = sizeof(uuid);
+            if (sysctlbyname("kern.bootsessionuuid", uuid, &size, nullptr, 0) != 0)
+            {
+                return "";
+            }
+            return std::string(uuid);
+#else
+            return "";
+#endif
+        }
+
+        /** The version of the loaded NVIDIA kernel module, if any. */
+        std::string nvidia_driver_id()
+        {
+#ifdef __linux__
+            const fs::u8path version_file = "/proc/driver/nvidia/version";
+            std::error_code ec;
+            if (fs::exists(version_file, ec))
+            {
+                try
+                {
+                    auto in = open_ifstream(version_file);
+                    std::string line;
+                    std::getline(in, line);
+                    return line;
+                }
+                catch (const std::exception&)
+                {
+                }
+            }
+#endif
+            return "none";
+        }
+
+        fs::u8path virtual_packages_cache_path()
+        {
+            return env::user_cache_dir() / "mamba" / "virtual_packages.json";
+        }
+
+        /**
+         * A detected value of this host, cached across runs while @p key is unchanged.
+         *
+         * Nothing is cached if the key is empty, as when the boot cannot be identified.
+         */
+        template <typename Func>
+        std::string
+        cached_host_value(const std::string& name, const std::string& key, Func&& detect)
+        {
+            if (key.empty() || !Context::instance().virtual_packages_cache)
+            {
+                return detect();
+            }
+
+            const auto cache_path = virtual_packages_cache_path();
+            nlohmann::json cache = nlohmann::json::object();
+            try
+            {
+                if (fs::exists(cache_path))
+                {
+                    auto in = open_ifstream(cache_path);
+                    cache = nlohmann::json::parse(in);
+                    const auto& entry = cache.at(name);
+                    if (entry.at("key") == key)
+                    {
+                        LOG_DEBUG << "Using " << name << " version cached in " << cache_path;
+                        return entry.at("value").get<std::string>();
+                    }
+                }
+            }
+            catch (const std::exception&)
+            {
+                // Missing entry or invalid file, detected again
+                if (!cache.is_object())
+                {
+                    cache = nlohmann::json::object();
+                }
+            }
+
+            std::string value = detect();
+            try
+            {
+                cache[name] = { { "key", key }, { "value", value } };
+                fs::create_directories(cache_path.parent_path());
+                // Replaced at once, so that concurrent runs read a complete file
+                auto tmp_file = TemporaryFile(
+                    "mambaf",
+                    ".virtual_packages",
+                    cache_path.parent_path()
+                );
+                {
+                    auto out = open_ofstream(tmp_file.path());
+                    out << cache.dump();
+                    if (!out.flush())
+                    {
+                        throw std::runtime_error("could not write " + tmp_file.path().string());
+                    }
+                }
+                fs::rename(tmp_file.path(), cache_path);
+            }
+            catch (const std::exception& e)
+            {
+                LOG_DEBUG << "Could not write virtual packages cache " << cache_path << ": "
+                          << e.what();
+            }
+            return value;
+        }
+
+        /**
+         * The CUDA version of the driver, queried from the driver library.
+         *
+         * This is the same check as conda, and avoids starting nvidia-smi.
+         * Empty if the library is not found or no device can be initialized.
+         */
+        std::string cuda_driver_version()
+        {
+            using cu_init_t = int (*)(unsigned int);
+            using cu_driver_get_version_t = int (*)(int*);
+#if defined(_WIN32)
+            HMODULE lib = LoadLibraryA("nvcuda.dll");
+            if (lib == nullptr)
+            {
+                return "";
+            }
+            auto cu_init = reinterpret_cast<cu_init_t>(GetProcAddress(lib, "cuInit"));
+            auto cu_driver_get_version = reinterpret_cast<cu_driver_get_version_t>(
+                GetProcAddress(lib, "cuDriverGetVersion")
+            );
+#elif defined(__APPLE__)
+            // No CUDA driver on recent macOS
+            return "";
+#else
+            void* lib = dlopen("libcuda.so.1", RTLD_LAZY | RTLD_LOCAL);
+            if (lib == nullptr)
+            {
+                lib = dlopen("libcuda.so", RTLD_LAZY | RTLD_LOCAL);
+            }
+            if (lib == nullptr)
+            {
+                return "";
+            }
+            auto cu_init = reinterpret_cast<cu_init_t>(dlsym(lib, "cuInit"));
+            auto cu_driver_get_version = reinterpret_cast<cu_driver_get_version_t>(
+                dlsym(lib, "cuDriverGetVersion")
+            );
+#endif
+
+#if !defined(__APPLE__)
+            std::string version;
+            int driver_version = 0;
+            // CUDA_SUCCESS is 0
+            if ((cu_init != nullptr) && (cu_driver_get_version != nullptr) && (cu_init(0) == 0)
+                && (cu_driver_get_version(&driver_version) == 0) && (driver_version > 0))
+            {
+                version = fmt::format("{}.{}", driver_version / 1000, (driver_version % 1000) / 10);
+            }
+#if defined(_WIN32)
+            FreeLibrary(lib);
+#else
+            dlclose(lib);
+#endif
+            return version;
+#endif
+        }
+    }
+
     namespace detail
     {
         std::string glibc_version()
@@ -65,6 +258,23 @@ namespace mamba
                 return override_version.value();
             }
 
+            return cached_host_value(
+                "cuda",
+                boot_id().empty() ? "" : boot_id() + " " + nvidia_driver_id(),
+                []
+                {
+                    if (auto version = cuda_driver_version(); !version.empty())
+                    {
+                        LOG_DEBUG << "CUDA driver version found: " << version;
+                        return version;
+                    }
+                    return cuda_smi_version();
+                }
+            );
+        }
+
+        std::string cuda_smi_version()
+        {
             std::string out, err;
             std::vector<std::string> args = { "nvidia-smi", "--query", "-u", "-x" };
             auto [status, ec] = reproc::run(
@@ -210,7 +420,9 @@ namespace mamba
             {
                 res.push_back(make_virtual_package("__unix"));
 
-                std::string osx_ver = macos_version();
+                std::string osx_ver = env::get("CONDA_OVERRIDE_OSX").has_value() || !on_mac
+                                          ? macos_version()
+                                          : cached_host_value("osx", boot_id(), macos_version);
                 if (!osx_ver.empty())
                 {
                     res.push_back(make_virtual_package("__osx", osx_ver));
@@ -9,6 +9,7 @@
 #include <sstream>
 #include <stdexcept>
 
+#include <solv/bitmap.h>
 #include <solv/pool.h>
 #include <solv/poolid.h>
 #include <solv/pooltypes.h>
@@ -28,6 +29,12 @@ namespace mamba::solv
         ::pool_free(ptr);
     }
 
+    void ObjPool::MapDeleter::operator()(::Map* ptr)
+    {
+        ::map_free(ptr);
+        delete ptr;
+    }
+
     ObjPool::ObjPool()
         : m_user_debug_callback(nullptr, [](void* /*ptr*/) {})
         , m_pool(::pool_create())
@@ -181,9 +188,56 @@ namespace mamba::solv
 
     void ObjPool::create_whatprovides()
     {
+        if (auto* const considered = m_considered.get(); considered != nullptr)
+        {
+            // libsolv does not check the map bounds
+            const SolvableId end = raw()->nsolvables;
+            if (end > m_considered_end)
+            {
+                ::map_grow(considered, end);
+                for (SolvableId id = m_considered_end; id < end; ++id)
+                {
+                    MAPSET(considered, id);
+                }
+                m_considered_end = end;
+            }
+        }
         ::pool_createwhatprovides(raw());
     }
 
+    void ObjPool::set_considered_solvables(const ObjQueue& solvables)
+    {
+        auto considered = std::unique_ptr<::Map, ObjPool::MapDeleter>(new ::Map());
+        const SolvableId end = raw()->nsolvables;
+        ::map_init(considered.get(), end);
+        // Used internally by the solver
+        MAPSET(considered.get(), SYSTEMSOLVABLE);
+        for (const SolvableId id : solvables)
+        {
+            assert(0 < id && id < end);
+            MAPSET(considered.get(), id);
+        }
+        raw()->considered = considered.get();
+        m_considered = std::move(considered);
+        m_considered_end = end;
+    }
+
+    void ObjPool::reset_considered_solvables()
+    {
+        raw()->considered = nullptr;
+        m_considered = nullptr;
+        m_considered_end = 0;
+    }
+
+    auto ObjPool::is_considered_solvable(SolvableId id) const -> bool
+    {
+        if ((m_considered == nullptr) || (id >= m_considered_end))
+        {
+            return true;
+        }
+        return MAPTST(m_considered.get(), id) != 0;
+    }
+
     auto ObjPool::add_repo(std::string_view name) -> std::pair<RepoId, ObjRepoView>
     {
         auto* repo_ptr = ::repo_create(
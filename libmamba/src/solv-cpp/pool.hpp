@@ -21,6 +21,7 @@
 extern "C"
 {
     using Pool = struct s_Pool;
+    using Map = struct s_Map;
 }
 
 namespace mamba::solv
@@ -127,6 +128,23 @@ namespace mamba::solv
          * all packages that provide that name (without restriction on version).
          */
         void create_whatprovides();
+
+        /**
+         * Restrict the solvables taken into account to the given ones.
+         *
+         * Solvables that are not considered are ignored by the whatprovides index and by the
+         * solver, as if they were not in the pool.
+         * Solvables added afterwards are considered.
+         * The whatprovides index must be created again for the change to take effect.
+         */
+        void set_considered_solvables(const ObjQueue& solvables);
+
+        /** Consider all solvables again. */
+        void reset_considered_solvables();
+
+        /** Check if a solvable is taken into account by the whatprovides index and the solver. */
+        auto is_considered_solvable(SolvableId id) const -> bool;
+
         template <typename UnaryFunc>
 
         /**
@@ -265,9 +283,18 @@ namespace mamba::solv
             void operator()(::Pool* ptr);
         };
 
+        struct MapDeleter
+        {
+            void operator()(::Map* ptr);
+        };
+
         std::unique_ptr<void, void (*)(void*)> m_user_debug_callback;
         // Must be deleted before the debug callback
         std::unique_ptr<::Pool, ObjPool::PoolDeleter> m_pool = nullptr;
+        // Not owned by the pool, only referenced from it
+        std::unique_ptr<::Map, ObjPool::MapDeleter> m_considered = nullptr;
+        // Solvables with a greater id were added after the considered map was set
+        SolvableId m_considered_end = 0;
     };
 }
 
@@ -351,7 +378,7 @@ namespace mamba::solv
         // Safe optional unchecked because we iterate over available values
         return for_each_whatprovides_id(
             dep,
-            [this, func](SolvableId id) { func(get_solvable(id)).value(); }
+            [this, func](SolvableId id) { func(get_solvable(id).value()); }
         );
     }
 
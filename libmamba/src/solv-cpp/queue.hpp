@@ -7,6 +7,9 @@
 #ifndef MAMBA_SOLV_QUEUE_HPP
 #define MAMBA_SOLV_QUEUE_HPP
 
+#include <array>
+#include <cstddef>
+#include <initializer_list>
 #include <iterator>
 #include <utility>
 
@@ -110,6 +113,59 @@ namespace mamba::solv
     auto operator==(const ObjQueue& a, const ObjQueue& b) -> bool;
     auto operator!=(const ObjQueue& a, const ObjQueue& b) -> bool;
 
+    /**
+     * A libsolv ``Queue`` storing its first @p N elements inline.
+     *
+     * Libsolv only moves the elements to the heap when the queue grows past the inline
+     * buffer, so that short lived queues, such as selection jobs or the solvables of a
+     * dependency, are used without allocating.
+     * The queue can be neither copied nor moved, since libsolv points to its buffer.
+     */
+    template <std::size_t N>
+    class ObjSmallQueue
+    {
+    public:
+
+        using value_type = ::Id;
+        using size_type = std::size_t;
+        using iterator = ::Id*;
+        using const_iterator = const ::Id*;
+
+        ObjSmallQueue();
+        ObjSmallQueue(std::initializer_list<value_type> elems);
+        ObjSmallQueue(const ObjSmallQueue&) = delete;
+        ObjSmallQueue(ObjSmallQueue&&) = delete;
+
+        ~ObjSmallQueue();
+
+        auto operator=(const ObjSmallQueue&) -> ObjSmallQueue& = delete;
+        auto operator=(ObjSmallQueue&&) -> ObjSmallQueue& = delete;
+
+        [[nodiscard]] auto size() const -> size_type;
+        [[nodiscard]] auto empty() const -> bool;
+        /** Whether the elements are still in the inline buffer. */
+        [[nodiscard]] auto is_inline() const -> bool;
+
+        void push_back(value_type id);
+        void push_back(value_type id1, value_type id2);
+        void clear();
+
+        [[nodiscard]] auto front() const -> value_type;
+        [[nodiscard]] auto operator[](size_type pos) const -> value_type;
+        [[nodiscard]] auto begin() -> iterator;
+        [[nodiscard]] auto begin() const -> const_iterator;
+        [[nodiscard]] auto end() -> iterator;
+        [[nodiscard]] auto end() const -> const_iterator;
+
+        [[nodiscard]] auto raw() -> ::Queue*;
+        [[nodiscard]] auto raw() const -> const ::Queue*;
+
+    private:
+
+        std::array<::Id, N> m_buffer = {};
+        ::Queue m_queue = {};
+    };
+
     /********************************
      *  Implementation of ObjQueue  *
      ********************************/
@@ -148,6 +204,117 @@ namespace mamba::solv
         return C<value_type>(begin(), end());
     }
 
+    /*************************************
+     *  Implementation of ObjSmallQueue  *
+     *************************************/
+
+    template <std::size_t N>
+    ObjSmallQueue<N>::ObjSmallQueue()
+    {
+        ::queue_init_buffer(&m_queue, m_buffer.data(), static_cast<int>(N));
+    }
+
+    template <std::size_t N>
+    ObjSmallQueue<N>::ObjSmallQueue(std::initializer_list<value_type> elems)
+        : ObjSmallQueue()
+    {
+        for (const auto id : elems)
+        {
+            push_back(id);
+        }
+    }
+
+    template <std::size_t N>
+    ObjSmallQueue<N>::~ObjSmallQueue()
+    {
+        // Only frees the elements moved to the heap
+        ::queue_free(&m_queue);
+    }
+
+    template <std::size_t N>
+    auto ObjSmallQueue<N>::size() const -> size_type
+    {
+        return static_cast<size_type>(m_queue.count);
+    }
+
+    template <std::size_t N>
+    auto ObjSmallQueue<N>::empty() const -> bool
+    {
+        return m_queue.count == 0;
+    }
+
+    template <std::size_t N>
+    auto ObjSmallQueue<N>::is_inline() const -> bool
+    {
+        return m_queue.alloc == nullptr;
+    }
+
+    template <std::size_t N>
+    void ObjSmallQueue<N>::push_back(value_type id)
+    {
+        ::queue_push(&m_queue, id);
+    }
+
+    template <std::size_t N>
+    void ObjSmallQueue<N>::push_back(value_type id1, value_type id2)
+    {
+        ::queue_push2(&m_queue, id1, id2);
+    }
+
+    template <std::size_t N>
+    void ObjSmallQueue<N>::clear()
+    {
+        ::queue_empty(&m_queue);
+    }
+
+    template <std::size_t N>
+    auto ObjSmallQueue<N>::front() const -> value_type
+    {
+        return *begin();
+    }
+
+    template <std::size_t N>
+    auto ObjSmallQueue<N>::operator[](size_type pos) const -> value_type
+    {
+        return m_queue.elements[pos];
+    }
+
+    template <std::size_t N>
+    auto ObjSmallQueue<N>::begin() -> iterator
+    {
+        return m_queue.elements;
+    }
+
+    template <std::size_t N>
+    auto ObjSmallQueue<N>::begin() const -> const_iterator
+    {
+        return m_queue.elements;
+    }
+
+    template <std::size_t N>
+    auto ObjSmallQueue<N>::end() -> iterator
+    {
+        return begin() + size();
+    }
+
+    template <std::size_t N>
+    auto ObjSmallQueue<N>::end() const -> const_iterator
+    {
+        return begin() + size();
+    }
+
+    template <std::size_t N>
+    auto ObjSmallQueue<N>::raw() -> ::Queue*
+    {
+        return &m_queue;
+    }
+
+    template <std::size_t N>
+    auto ObjSmallQueue<N>::raw() const -> const ::Queue*
+    {
+        return &m_queue;
+    }
+
 }  // namespace mamba
 
 #endif
@@ -7,6 +7,7 @@
 #include <cassert>
 #include <cerrno>
 #include <cstdio>
+#include <cstdlib>
 #include <exception>
 #include <iostream>
 #include <sstream>
@@ -24,6 +25,7 @@ extern "C"  // Incomplete header in libsolv 0.7.23
 {
 #include <solv/conda.h>
 #include <solv/repo_conda.h>
+#include <solv/solv_xfopen.h>
 }
 
 #include "mamba/core/mamba_fs.hpp"
@@ -112,6 +114,13 @@ namespace mamba::solv
              */
             static auto open(const fs::u8path& path, const char* mode) -> CFile;
 
+            /**
+             * Open a read-only file over a memory buffer.
+             *
+             * The buffer must outlive the file.
+             */
+            static auto open_buffer(std::string_view buffer, std::string name) -> CFile;
+
             /**
              * The destructor will flush and close the file descriptor.
              *
@@ -175,6 +184,16 @@ namespace mamba::solv
 #endif
         }
 
+        auto CFile::open_buffer(std::string_view buffer, std::string name) -> CFile
+        {
+            std::FILE* ptr = ::solv_fmemopen(buffer.data(), buffer.size(), "r");
+            if (ptr == nullptr)
+            {
+                throw std::system_error(errno, std::generic_category());
+            }
+            return { ptr, std::move(name) };
+        }
+
         void CFile::close()
         {
             const auto close_res = std::fclose(m_ptr);  // This flush too
@@ -206,6 +225,58 @@ namespace mamba::solv
         }
     }
 
+    auto ObjRepoViewConst::write_buffer() const -> std::string
+    {
+        const auto fail = [&]()
+        {
+            // TODO(C++20) fmt::format
+            auto ss = std::stringstream();
+            ss << "Unable to write repo '" << name() << "' to memory";
+            return std::runtime_error(ss.str());
+        };
+
+#ifdef _WIN32
+        // No memory stream available, using an anonymous temporary file
+        std::FILE* file = std::tmpfile();
+        if (file == nullptr)
+        {
+            throw std::system_error(errno, std::generic_category());
+        }
+        if (::repo_write(const_cast<::Repo*>(raw()), file) != 0)
+        {
+            std::fclose(file);
+            throw fail();
+        }
+        auto out = std::string(static_cast<std::size_t>(std::ftell(file)), '\0');
+        std::rewind(file);
+        const auto read_size = std::fread(out.data(), 1, out.size(), file);
+        std::fclose(file);
+        if (read_size != out.size())
+        {
+            throw fail();
+        }
+        return out;
+#else
+        // Not using solv_xfopen_buf, whose write mode overwrites the buffer (libsolv 0.7.30)
+        char* buffer = nullptr;
+        std::size_t size = 0;
+        std::FILE* file = ::open_memstream(&buffer, &size);
+        if (file == nullptr)
+        {
+            throw std::system_error(errno, std::generic_category());
+        }
+        const auto write_res = ::repo_write(const_cast<::Repo*>(raw()), file);
+        const auto close_res = std::fclose(file);  // This flush too
+        auto out = (buffer != nullptr) ? std::string(buffer, size) : std::string();
+        std::free(buffer);
+        if ((write_res != 0) || (close_res != 0))
+        {
+            throw fail();
+        }
+        return out;
+#endif
+    }
+
     /***********************************
      *  Implementation of ObjRepoView  *
      ***********************************/
@@ -243,6 +314,23 @@ namespace mamba::solv
         }
     }
 
+    void ObjRepoView::read_buffer(std::string_view solv_data) const
+    {
+        auto file = CFile::open_buffer(solv_data, std::string(name()));
+        const auto read_res = ::repo_add_solv(raw(), file.raw(), 0);
+        if (read_res != 0)
+        {
+            // TODO(C++20) fmt::format
+            auto ss = std::stringstream();
+            ss << "Unable to read repo solv data '" << name() << '\'';
+            if (const char* str = ::pool_errstr(raw()->pool))
+            {
+                ss << ", error was: " << str;
+            }
+            throw std::runtime_error(ss.str());
+        }
+    }
+
     void ObjRepoView::legacy_read_conda_repodata(const fs::u8path& repodata_file, int flags) const
     {
         auto file = CFile::open(repodata_file, "rb");
@@ -269,6 +357,11 @@ namespace mamba::solv
         };
     }
 
+    auto ObjRepoView::add_solvables(std::size_t count) const -> SolvableId
+    {
+        return ::repo_add_solvable_block(raw(), static_cast<int>(count));
+    }
+
     auto ObjRepoView::get_solvable(SolvableId id) const -> std::optional<ObjSolvableView>
     {
         if (::Solvable* s = get_solvable_ptr(raw(), id))
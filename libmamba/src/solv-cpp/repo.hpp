@@ -8,6 +8,7 @@
 #define MAMBA_SOLV_REPO_HPP
 
 #include <optional>
+#include <string>
 #include <string_view>
 #include <utility>
 
@@ -118,6 +119,13 @@ namespace mamba::solv
          */
         void write(const fs::u8path& solv_file) const;
 
+        /**
+         * Write repository information to memory, in the same format as @ref write.
+         *
+         * Useful to defer writing the data to a file to another thread.
+         */
+        auto write_buffer() const -> std::string;
+
     private:
 
         const ::Repo* m_repo = nullptr;
@@ -228,6 +236,16 @@ namespace mamba::solv
          */
         void read(const fs::u8path& solv_file) const;
 
+        /**
+         * Read repository information from the content of a solv file.
+         *
+         * Useful to read from a memory-mapped file without copying it beforehand.
+         *
+         * @param solv_data The full content of a solv file.
+         * @see ObjRepoViewConst::write
+         */
+        void read_buffer(std::string_view solv_data) const;
+
         /**
          * Read repository information from a conda repodata.json.
          *
@@ -241,6 +259,14 @@ namespace mamba::solv
         /** Add an empty solvable to the repository. */
         auto add_solvable() const -> std::pair<SolvableId, ObjSolvableView>;
 
+        /**
+         * Add @p count empty solvables with consecutive ids to the repository.
+         *
+         * Cheaper than adding them one by one, since the pool grows only once.
+         * @return The id of the first solvable added.
+         */
+        auto add_solvables(std::size_t count) const -> SolvableId;
+
         /** Get the current solvable, if it exists and is in this repository. */
         auto get_solvable(SolvableId id) const -> std::optional<ObjSolvableView>;
 
@@ -193,6 +193,39 @@ namespace mamba::solv
         return ::solver_problem_count(const_cast<::Solver*>(raw()));
     }
 
+    auto ObjSolver::package_rule_count() const -> std::size_t
+    {
+        // Package rules are the first rules, starting at 1, but their end is not public.
+        // It is searched for with the rule class, first by doubling, then by bisection.
+        auto* const solver = const_cast<::Solver*>(raw());
+        const auto is_pkg_rule = [&](RuleId id)
+        { return ::solver_ruleclass(solver, id) == SOLVER_RULE_PKG; };
+        if (!is_pkg_rule(1))
+        {
+            return 0;
+        }
+        RuleId low = 1;  // A package rule
+        RuleId high = 2;  // Possibly a package rule
+        while (is_pkg_rule(high))
+        {
+            low = high;
+            high *= 2;
+        }
+        while (high - low > 1)
+        {
+            const RuleId mid = low + (high - low) / 2;
+            (is_pkg_rule(mid) ? low : high) = mid;
+        }
+        return static_cast<std::size_t>(low);
+    }
+
+    auto ObjSolver::decision_count() const -> std::size_t
+    {
+        auto decisions = ObjQueue();
+        ::solver_get_decisionqueue(const_cast<::Solver*>(raw()), decisions.raw());
+        return decisions.size();
+    }
+
     auto ObjSolver::problem_to_string(const ObjPool& /* pool */, ProblemId id) const -> std::string
     {
         // pool is captured inside solver so we take it as a parameter to be explicit.
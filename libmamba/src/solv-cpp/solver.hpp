@@ -62,6 +62,10 @@ namespace mamba::solv
         [[nodiscard]] auto solve(const ObjPool& pool, const ObjQueue& jobs) -> bool;
 
         [[nodiscard]] auto problem_count() const -> std::size_t;
+        /** The number of rules created from the dependencies of packages by the last solve. */
+        [[nodiscard]] auto package_rule_count() const -> std::size_t;
+        /** The number of decisions taken by the last solve, including the system solvable. */
+        [[nodiscard]] auto decision_count() const -> std::size_t;
         [[nodiscard]] auto problem_to_string(const ObjPool& pool, ProblemId id) const -> std::string;
         template <typename UnaryFunc>
         void for_each_problem_id(UnaryFunc&& func) const;
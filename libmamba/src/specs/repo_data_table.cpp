@@ -0,0 +1,645 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+#include <nlohmann/json.hpp>
+
+#include "mamba/specs/repo_data_table.hpp"
+
+namespace mamba::specs
+{
+    /*******************************************
+     *  Implementation of StringRange          *
+     *******************************************/
+
+    RepoDataTable::StringRange::StringRange(
+        const RepoDataTable* table,
+        const string_id* first,
+        const string_id* last
+    )
+        : m_table(table)
+        , m_first(first)
+        , m_last(last)
+    {
+    }
+
+    auto RepoDataTable::StringRange::size() const -> size_type
+    {
+        return static_cast<size_type>(m_last - m_first);
+    }
+
+    auto RepoDataTable::StringRange::empty() const -> bool
+    {
+        return m_first == m_last;
+    }
+
+    auto RepoDataTable::StringRange::operator[](size_type pos) const -> std::string_view
+    {
+        return m_table->string(m_first[pos]);
+    }
+
+    auto RepoDataTable::StringRange::begin() const -> const_iterator
+    {
+        return { this, 0 };
+    }
+
+    auto RepoDataTable::StringRange::end() const -> const_iterator
+    {
+        return { this, size() };
+    }
+
+    auto RepoDataTable::StringRange::to_vector() const -> std::vector<std::string>
+    {
+        auto out = std::vector<std::string>();
+        out.reserve(size());
+        for (const string_id* id = m_first; id != m_last; ++id)
+        {
+            out.emplace_back(m_table->string(*id));
+        }
+        return out;
+    }
+
+    /*******************************************
+     *  Implementation of PackageView          *
+     *******************************************/
+
+    namespace
+    {
+        constexpr std::uint64_t missing_number = ~std::uint64_t(0);
+
+        auto optional_number(std::uint64_t n) -> std::optional<std::size_t>
+        {
+            if (n == missing_number)
+            {
+                return std::nullopt;
+            }
+            return n;
+        }
+
+        template <typename T>
+        auto to_optional_string(const std::optional<T>& str) -> std::optional<std::string>
+        {
+            if (str.has_value())
+            {
+                return { std::string(str.value()) };
+            }
+            return std::nullopt;
+        }
+    }
+
+    RepoDataTable::PackageView::PackageView(const RepoDataTable* table, size_type row)
+        : m_table(table)
+        , m_row(row)
+    {
+    }
+
+    auto RepoDataTable::PackageView::filename() const -> std::string_view
+    {
+        return m_table->string(m_table->m_filename[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::name() const -> std::string_view
+    {
+        return m_table->string(m_table->m_name[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::version() const -> Version
+    {
+        return Version::parse(version_str());
+    }
+
+    auto RepoDataTable::PackageView::version_str() const -> std::string_view
+    {
+        return m_table->string(m_table->m_version_str[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::build_string() const -> std::string_view
+    {
+        return m_table->string(m_table->m_build_string[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::build_number() const -> std::size_t
+    {
+        return static_cast<std::size_t>(m_table->m_build_number[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::subdir() const -> std::string_view
+    {
+        return m_table->string(m_table->m_subdir[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::md5() const -> std::optional<std::string_view>
+    {
+        return m_table->optional_string(m_table->m_md5[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::sha256() const -> std::optional<std::string_view>
+    {
+        return m_table->optional_string(m_table->m_sha256[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::legacy_bz2_md5() const -> std::optional<std::string_view>
+    {
+        return m_table->optional_string(m_table->m_legacy_bz2_md5[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::legacy_bz2_size() const -> std::optional<std::size_t>
+    {
+        return optional_number(m_table->m_legacy_bz2_size[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::size() const -> std::optional<std::size_t>
+    {
+        return optional_number(m_table->m_size[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::arch() const -> std::optional<std::string_view>
+    {
+        return m_table->optional_string(m_table->m_arch[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::platform() const -> std::optional<std::string_view>
+    {
+        return m_table->optional_string(m_table->m_platform[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::depends() const -> StringRange
+    {
+        return m_table->list(m_table->m_depends, m_row);
+    }
+
+    auto RepoDataTable::PackageView::constrains() const -> StringRange
+    {
+        return m_table->list(m_table->m_constrains, m_row);
+    }
+
+    auto RepoDataTable::PackageView::track_features() const -> StringRange
+    {
+        return m_table->list(m_table->m_track_features, m_row);
+    }
+
+    auto RepoDataTable::PackageView::features() const -> std::optional<std::string_view>
+    {
+        return m_table->optional_string(m_table->m_features[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::noarch() const -> std::optional<NoArchType>
+    {
+        if (const auto noarch = m_table->m_noarch[m_row]; noarch > 0)
+        {
+            return { static_cast<NoArchType>(noarch - 1) };
+        }
+        return std::nullopt;
+    }
+
+    auto RepoDataTable::PackageView::license() const -> std::optional<std::string_view>
+    {
+        return m_table->optional_string(m_table->m_license[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::license_family() const -> std::optional<std::string_view>
+    {
+        return m_table->optional_string(m_table->m_license_family[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::timestamp() const -> std::optional<std::size_t>
+    {
+        return optional_number(m_table->m_timestamp[m_row]);
+    }
+
+    auto RepoDataTable::PackageView::to_package() const -> RepoDataPackage
+    {
+        auto out = RepoDataPackage();
+        out.name = name();
+        out.version = version();
+        out.build_string = build_string();
+        out.build_number = build_number();
+        out.subdir = subdir();
+        out.md5 = to_optional_string(md5());
+        out.sha256 = to_optional_string(sha256());
+        out.legacy_bz2_md5 = to_optional_string(legacy_bz2_md5());
+        out.legacy_bz2_size = legacy_bz2_size();
+        out.size = size();
+        out.arch = to_optional_string(arch());
+        out.platform = to_optional_string(platform());
+        out.depends = depends().to_vector();
+        out.constrains = constrains().to_vector();
+        out.track_features = track_features().to_vector();
+        out.features = to_optional_string(features());
+        out.noarch = noarch();
+        out.license = to_optional_string(license());
+        out.license_family = to_optional_string(license_family());
+        out.timestamp = timestamp();
+        return out;
+    }
+
+    /*******************************************
+     *  Implementation of PackageRange         *
+     *******************************************/
+
+    RepoDataTable::PackageRange::PackageRange(
+        const RepoDataTable* table,
+        size_type first,
+        size_type last
+    )
+        : m_table(table)
+        , m_first(first)
+        , m_last(last)
+    {
+    }
+
+    auto RepoDataTable::PackageRange::size() const -> size_type
+    {
+        return m_last - m_first;
+    }
+
+    auto RepoDataTable::PackageRange::empty() const -> bool
+    {
+        return m_first == m_last;
+    }
+
+    auto RepoDataTable::PackageRange::operator[](size_type pos) const -> PackageView
+    {
+        return { m_table, m_first + pos };
+    }
+
+    auto RepoDataTable::PackageRange::begin() const -> const_iterator
+    {
+        return { this, 0 };
+    }
+
+    auto RepoDataTable::PackageRange::end() const -> const_iterator
+    {
+        return { this, size() };
+    }
+
+    auto RepoDataTable::PackageRange::find(std::string_view filename) const
+        -> std::optional<PackageView>
+    {
+        // Packages are sorted by filename, as the keys of json objects
+        auto low = m_first;
+        auto high = m_last;
+        while (low < high)
+        {
+            const auto mid = low + (high - low) / 2;
+            if (m_table->string(m_table->m_filename[mid]) < filename)
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        if ((low < m_last) && (m_table->string(m_table->m_filename[low]) == filename))
+        {
+            return { PackageView(m_table, low) };
+        }
+        return std::nullopt;
+    }
+
+    /*******************************************
+     *  Implementation of RepoDataTable        *
+     *******************************************/
+
+    /** Add the packages of json objects to the columns of a table. */
+    class RepoDataTable::Builder
+    {
+    public:
+
+        explicit Builder(RepoDataTable& table)
+            : m_table(table)
+        {
+        }
+
+        /** Add the packages under @p key, returning how many were added. */
+        auto add_section(const nlohmann::json& repodata, const char* key) -> size_type
+        {
+            const auto section = repodata.find(key);
+            if ((section == repodata.end()) || section->is_null())
+            {
+                return 0;
+            }
+            for (auto it = section->begin(); it != section->end(); ++it)
+            {
+                add_package(it.key(), it.value());
+            }
+            return section->size();
+        }
+
+        /** Release the memory reserved by the columns while they grew. */
+        void finish()
+        {
+            auto& t = m_table;
+            t.m_strings.chars.shrink_to_fit();
+            t.m_strings.offsets.shrink_to_fit();
+            for (auto* col :
+                 { &t.m_filename,
+                   &t.m_name,
+                   &t.m_version_str,
+                   &t.m_build_string,
+                   &t.m_subdir,
+                   &t.m_md5,
+                   &t.m_sha256,
+                   &t.m_legacy_bz2_md5,
+                   &t.m_arch,
+                   &t.m_platform,
+                   &t.m_features,
+                   &t.m_license,
+                   &t.m_license_family })
+            {
+                col->shrink_to_fit();
+            }
+            for (auto* col : { &t.m_build_number, &t.m_legacy_bz2_size, &t.m_size, &t.m_timestamp })
+            {
+                col->shrink_to_fit();
+            }
+            for (auto* col : { &t.m_depends, &t.m_constrains, &t.m_track_features })
+            {
+                col->items.shrink_to_fit();
+                col->offsets.shrink_to_fit();
+            }
+            t.m_noarch.shrink_to_fit();
+        }
+
+    private:
+
+        RepoDataTable& m_table;
+        // Keys are views of the strings of the json, which outlives the builder
+        std::unordered_map<std::string_view, string_id> m_ids = {};
+
+        /** Add a string to the pool, without looking for an equal one. */
+        auto append(std::string_view str) -> string_id
+        {
+            auto& pool = m_table.m_strings;
+            if ((pool.chars.size() + str.size() > std::numeric_limits<std::uint32_t>::max())
+                || (pool.offsets.size() > std::numeric_limits<string_id>::max()))
+            {
+                throw std::length_error("Too many strings in repodata table");
+            }
+            pool.chars += str;
+            pool.offsets.push_back(static_cast<std::uint32_t>(pool.chars.size()));
+            return static_cast<string_id>(pool.offsets.size() - 2);
+        }
+
+        auto intern(std::string_view str) -> string_id
+        {
+            if (const auto it = m_ids.find(str); it != m_ids.end())
+            {
+                return it->second;
+            }
+            const auto id = append(str);
+            m_ids.emplace(str, id);
+            return id;
+        }
+
+        auto intern(const nlohmann::json& j) -> string_id
+        {
+            return intern(std::string_view(j.get_ref<const std::string&>()));
+        }
+
+        /** The id of an optional string, only interned if @p shared as most are not unique. */
+        auto maybe_missing(const nlohmann::json& pkg, const char* key, bool shared = true)
+            -> string_id
+        {
+            const auto it = pkg.find(key);
+            if ((it == pkg.end()) || it->is_null())
+            {
+                return 0;
+            }
+            if (shared)
+            {
+                return intern(*it);
+            }
+            return append(it->get_ref<const std::string&>());
+        }
+
+        static auto number_maybe_missing(const nlohmann::json& pkg, const char* key)
+            -> std::uint64_t
+        {
+            const auto it = pkg.find(key);
+            if ((it == pkg.end()) || it->is_null())
+            {
+                return missing_number;
+            }
+            return it->get<std::uint64_t>();
+        }
+
+        /** Add a list of strings, also accepting a single string when @p allow_str is set. */
+        void add_list(ListColumn& col, const nlohmann::json& pkg, const char* key, bool allow_str)
+        {
+            if (const auto it = pkg.find(key); it != pkg.end())
+            {
+                if (allow_str && it->is_string())
+                {
+                    col.items.push_back(intern(*it));
+                }
+                else if (!allow_str || it->is_array())
+                {
+                    for (const auto& item : it->get_ref<const nlohmann::json::array_t&>())
+                    {
+                        col.items.push_back(intern(item));
+                    }
+                }
+            }
+            if (col.items.size() > std::numeric_limits<std::uint32_t>::max())
+            {
+                throw std::length_error("Too many list items in repodata table");
+            }
+            col.offsets.push_back(static_cast<std::uint32_t>(col.items.size()));
+        }
+
+        static auto noarch_of(const nlohmann::json& pkg) -> std::uint8_t
+        {
+            const auto it = pkg.find("noarch");
+            if ((it == pkg.end()) || it->is_null())
+            {
+                return 0;
+            }
+            auto noarch = NoArchType::Generic;
+            // Old behaviour
+            if (it->is_boolean())
+            {
+                if (!it->get<bool>())
+                {
+                    return 0;
+                }
+            }
+            // Unknown values are generic, as in the enum deserialization
+            else if (it->get_ref<const std::string&>() == "python")
+            {
+                noarch = NoArchType::Python;
+            }
+            return static_cast<std::uint8_t>(static_cast<std::uint8_t>(noarch) + 1);
+        }
+
+        void add_package(const std::string& filename, const nlohmann::json& pkg)
+        {
+            auto& t = m_table;
+            t.m_filename.push_back(append(filename));
+            t.m_name.push_back(intern(pkg.at("name")));
+            t.m_version_str.push_back(intern(pkg.at("version")));
+            t.m_build_string.push_back(intern(pkg.at("build")));
+            t.m_build_number.push_back(pkg.at("build_number").get<std::uint64_t>());
+            t.m_subdir.push_back(intern(pkg.at("subdir")));
+            t.m_md5.push_back(maybe_missing(pkg, "md5", false));
+            t.m_sha256.push_back(maybe_missing(pkg, "sha256", false));
+            t.m_legacy_bz2_md5.push_back(maybe_missing(pkg, "legacy_bz2_md5", false));
+            t.m_legacy_bz2_size.push_back(number_maybe_missing(pkg, "legacy_bz2_size"));
+            t.m_size.push_back(number_maybe_missing(pkg, "size"));
+            t.m_arch.push_back(maybe_missing(pkg, "arch"));
+            t.m_platform.push_back(maybe_missing(pkg, "platform"));
+            add_list(t.m_depends, pkg, "depends", false);
+            add_list(t.m_constrains, pkg, "constrains", false);
+            add_list(t.m_track_features, pkg, "track_features", true);
+            t.m_features.push_back(maybe_missing(pkg, "features"));
+            t.m_noarch.push_back(noarch_of(pkg));
+            t.m_license.push_back(maybe_missing(pkg, "license"));
+            t.m_license_family.push_back(maybe_missing(pkg, "license_family"));
+            t.m_timestamp.push_back(number_maybe_missing(pkg, "timestamp"));
+        }
+    };
+
+    auto RepoDataTable::from_json(const nlohmann::json& j) -> RepoDataTable
+    {
+        auto out = RepoDataTable();
+        if (const auto it = j.find("version"); (it != j.end()) && !it->is_null())
+        {
+            out.m_version = it->get<std::size_t>();
+        }
+        if (const auto it = j.find("info"); (it != j.end()) && !it->is_null())
+        {
+            out.m_info = it->get<ChannelInfo>();
+        }
+        if (const auto it = j.find("removed"); it != j.end())
+        {
+            out.m_removed = it->get<std::vector<std::string>>();
+        }
+
+        auto builder = Builder(out);
+        out.m_n_packages = builder.add_section(j, "packages");
+        // The key of ``RepoData``, or else the one of the ``repodata.json`` of channels
+        if (builder.add_section(j, "conda_packages") == 0)
+        {
+            builder.add_section(j, "packages.conda");
+        }
+        builder.finish();
+        return out;
+    }
+
+    auto RepoDataTable::version() const -> const std::optional<std::size_t>&
+    {
+        return m_version;
+    }
+
+    auto RepoDataTable::info() const -> const std::optional<ChannelInfo>&
+    {
+        return m_info;
+    }
+
+    auto RepoDataTable::removed() const -> const std::vector<std::string>&
+    {
+        return m_removed;
+    }
+
+    auto RepoDataTable::packages() const -> PackageRange
+    {
+        return { this, 0, m_n_packages };
+    }
+
+    auto RepoDataTable::conda_packages() const -> PackageRange
+    {
+        return { this, m_n_packages, n_rows() };
+    }
+
+    auto RepoDataTable::to_repo_data() const -> RepoData
+    {
+        auto out = RepoData();
+        out.version = m_version;
+        out.info = m_info;
+        out.removed = m_removed;
+        for (const auto& pkg : packages())
+        {
+            out.packages.emplace_hint(out.packages.end(), pkg.filename(), pkg.to_package());
+        }
+        for (const auto& pkg : conda_packages())
+        {
+            out.conda_packages
+                .emplace_hint(out.conda_packages.end(), pkg.filename(), pkg.to_package());
+        }
+        return out;
+    }
+
+    auto RepoDataTable::memory_usage() const -> std::size_t
+    {
+        const auto bytes = [](const auto& vec)
+        { return vec.capacity() * sizeof(typename std::decay_t<decltype(vec)>::value_type); };
+
+        auto out = sizeof(RepoDataTable) + m_strings.chars.capacity() + bytes(m_strings.offsets);
+        for (const auto* col :
+             { &m_filename,
+               &m_name,
+               &m_version_str,
+               &m_build_string,
+               &m_subdir,
+               &m_md5,
+               &m_sha256,
+               &m_legacy_bz2_md5,
+               &m_arch,
+               &m_platform,
+               &m_features,
+               &m_license,
+               &m_license_family })
+        {
+            out += bytes(*col);
+        }
+        for (const auto* col : { &m_build_number, &m_legacy_bz2_size, &m_size, &m_timestamp })
+        {
+            out += bytes(*col);
+        }
+        for (const auto* col : { &m_depends, &m_constrains, &m_track_features })
+        {
+            out += bytes(col->items) + bytes(col->offsets);
+        }
+        out += bytes(m_noarch);
+        for (const auto& str : m_removed)
+        {
+            out += str.capacity();
+        }
+        return out + bytes(m_removed);
+    }
+
+    auto RepoDataTable::string(string_id id) const -> std::string_view
+    {
+        const auto first = m_strings.offsets[id];
+        return std::string_view(m_strings.chars).substr(first, m_strings.offsets[id + 1] - first);
+    }
+
+    auto RepoDataTable::optional_string(string_id id) const -> std::optional<std::string_view>
+    {
+        if (id == 0)
+        {
+            return std::nullopt;
+        }
+        return { string(id) };
+    }
+
+    auto RepoDataTable::list(const ListColumn& col, size_type row) const -> StringRange
+    {
+        const auto* items = col.items.data();
+        return { this, items + col.offsets[row], items + col.offsets[row + 1] };
+    }
+
+    auto RepoDataTable::n_rows() const -> size_type
+    {
+        return m_filename.size();
+    }
+}
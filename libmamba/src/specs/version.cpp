@@ -14,6 +14,7 @@
 #include "mamba/core/error_handling.hpp"
 #include "mamba/core/util_string.hpp"
 #include "mamba/specs/version.hpp"
+#include "mamba/util/bounded_cache.hpp"
 #include "mamba/util/cast.hpp"
 
 namespace mamba::specs
@@ -53,6 +54,33 @@ namespace mamba::specs
      *  Implementation of VersionPartAtom  *
      ***************************************/
 
+    namespace
+    {
+        // Literals with a special meaning in comparisons, by rank, 0 meaning a regular literal
+        constexpr auto special_literals = std::array<std::pair<std::string_view, std::int8_t>, 5>{ {
+            { "*", -3 },
+            { "dev", -2 },
+            { "_", -1 },
+            { "", 1 },
+            { "post", 2 },
+        } };
+
+        constexpr auto literal_rank_of(std::string_view literal) -> std::int8_t
+        {
+            for (const auto& [special, rank] : special_literals)
+            {
+                if (literal == special)
+                {
+                    return rank;
+                }
+            }
+            return 0;
+        }
+
+        static_assert(literal_rank_of("dev") < literal_rank_of("alpha"));
+        static_assert(literal_rank_of("alpha") < literal_rank_of(""));
+    }
+
     VersionPartAtom::VersionPartAtom(std::size_t numeral) noexcept
         : m_numeral{ numeral }
     {
@@ -61,6 +89,7 @@ namespace mamba::specs
     VersionPartAtom::VersionPartAtom(std::size_t numeral, std::string_view literal)
         : m_literal{ to_lower(literal) }
         , m_numeral{ numeral }
+        , m_literal_rank{ literal_rank_of(m_literal) }
     {
     }
 
@@ -68,6 +97,7 @@ namespace mamba::specs
     VersionPartAtom::VersionPartAtom(std::size_t numeral, std::basic_string<Char>&& literal)
         : m_literal{ to_lower(std::move(literal)) }
         , m_numeral{ numeral }
+        , m_literal_rank{ literal_rank_of(m_literal) }
     {
     }
 
@@ -88,6 +118,11 @@ namespace mamba::specs
         return std::move(m_literal);
     }
 
+    auto VersionPartAtom::literal_rank() const noexcept -> int
+    {
+        return m_literal_rank;
+    }
+
     auto VersionPartAtom::str() const -> std::string
     {
         return fmt::format("{}", *this);
@@ -104,34 +139,8 @@ namespace mamba::specs
                 return num_ord;
             }
 
-            // Certain literals have sepcial meaning we map then to a priority
-            // 0 meaning regular string
-            auto lit_priority = [](const auto& l) -> int
-            {
-                if (l == "*")
-                {
-                    return -3;
-                }
-                if (l == "dev")
-                {
-                    return -2;
-                }
-                if (l == "_")
-                {
-                    return -1;
-                }
-                if (l == "")
-                {
-                    return 1;
-                }
-                if (l == "post")
-                {
-                    return 2;
-                }
-                return 0;
-            };
-            const auto a_lit_val = lit_priority(a.literal());
-            const auto b_lit_val = lit_priority(b.literal());
+            const auto a_lit_val = a.literal_rank();
+            const auto b_lit_val = b.literal_rank();
             // If two regular string, we need to use string comparison
             if ((a_lit_val == 0) && (b_lit_val == 0))
             {
@@ -184,7 +193,47 @@ namespace mamba::specs
         : m_version{ std::move(version) }
         , m_local{ std::move(local) }
         , m_epoch{ epoch }
+        , m_packed{ pack(m_epoch, m_version, m_local) }
+    {
+    }
+
+    auto Version::pack(std::size_t epoch, const CommonVersion& version, const CommonVersion& local)
+        -> packed_type
+    {
+        if ((epoch != 0) || !local.empty() || (version.size() > packed_parts))
+        {
+            return not_packed;
+        }
+        // Parts are zero padded, as missing parts compare equal to zero.
+        // The largest numeral is excluded so that no version is packed as ``not_packed``.
+        static constexpr std::size_t max_numeral = (std::size_t(1) << packed_part_bits) - 2;
+        packed_type packed = 0;
+        for (std::size_t i = 0; i < packed_parts; ++i)
+        {
+            packed <<= packed_part_bits;
+            if (i >= version.size() || version[i].empty())
+            {
+                continue;
+            }
+            const auto& part = version[i];
+            // Trailing atoms must be empty, as they compare equal to none
+            const auto is_numeric = [](const VersionPartAtom& atom)
+            { return atom.literal().empty(); };
+            const auto is_empty = [](const VersionPartAtom& atom)
+            { return (atom.numeral() == 0) && atom.literal().empty(); };
+            if (!is_numeric(part.front()) || (part.front().numeral() > max_numeral)
+                || !std::all_of(std::next(part.cbegin()), part.cend(), is_empty))
+            {
+                return not_packed;
+            }
+            packed |= part.front().numeral();
+        }
+        return packed;
+    }
+
+    auto Version::both_packed(const Version& other) const noexcept -> bool
     {
+        return (m_packed != not_packed) && (other.m_packed != not_packed);
     }
 
     auto Version::epoch() const noexcept -> std::size_t
@@ -338,6 +387,10 @@ namespace mamba::specs
     // TODO(C++20) use operator<=> to simplify code and improve operator<=
     auto Version::operator==(const Version& other) const -> bool
     {
+        if (both_packed(other))
+        {
+            return m_packed == other.m_packed;
+        }
         return compare_three_way(*this, other) == strong_ordering::equal;
     }
 
@@ -348,21 +401,37 @@ namespace mamba::specs
 
     auto Version::operator<(const Version& other) const -> bool
     {
+        if (both_packed(other))
+        {
+            return m_packed < other.m_packed;
+        }
         return compare_three_way(*this, other) == strong_ordering::less;
     }
 
     auto Version::operator<=(const Version& other) const -> bool
     {
+        if (both_packed(other))
+        {
+            return m_packed <= other.m_packed;
+        }
         return compare_three_way(*this, other) != strong_ordering::greater;
     }
 
     auto Version::operator>(const Version& other) const -> bool
     {
+        if (both_packed(other))
+        {
+            return m_packed > other.m_packed;
+        }
         return compare_three_way(*this, other) == strong_ordering::greater;
     }
 
     auto Version::operator>=(const Version& other) const -> bool
     {
+        if (both_packed(other))
+        {
+            return m_packed >= other.m_packed;
+        }
         return compare_three_way(*this, other) != strong_ordering::less;
     }
 
@@ -619,6 +688,12 @@ namespace mamba::specs
             static constexpr auto delims = std::string_view{ delims_buf.data(), delims_buf.size() };
 
             CommonVersion parts = {};
+            // Avoid growing the parts, as most versions are short
+            parts.reserve(static_cast<std::size_t>(std::count_if(
+                str.cbegin(),
+                str.cend(),
+                [](char c) { return delims.find(c) != std::string_view::npos; }
+            )) + 1);
             auto tail = str;
             std::size_t tail_delim_pos = 0;
             while (true)
@@ -676,23 +751,34 @@ namespace mamba::specs
         }
     }
 
-    auto Version::parse(std::string_view str) -> Version
+    namespace
     {
-        str = strip(str);
-        try
-        {
-            auto [epoch, version_and_local_str] = parse_leading_epoch<std::size_t>(str);
-            auto [version_str, local] = parse_trailing_local_version(version_and_local_str);
-            auto version = parse_version(version_str);
-            return {
-                /* .epoch= */ epoch,
-                /* .version= */ std::move(version),
-                /* .local= */ std::move(local),
-            };
-        }
-        catch (const std::invalid_argument& ia)
+        auto parse_uncached(std::string_view str) -> Version
         {
-            throw std::invalid_argument(fmt::format("Error parsing version '{}'. {}", str, ia.what()));
+            try
+            {
+                auto [epoch, version_and_local_str] = parse_leading_epoch<std::size_t>(str);
+                auto [version_str, local] = parse_trailing_local_version(version_and_local_str);
+                auto version = parse_version(version_str);
+                return {
+                    /* .epoch= */ epoch,
+                    /* .version= */ std::move(version),
+                    /* .local= */ std::move(local),
+                };
+            }
+            catch (const std::invalid_argument& ia)
+            {
+                throw std::invalid_argument(
+                    fmt::format("Error parsing version '{}'. {}", str, ia.what())
+                );
+            }
         }
     }
+
+    auto Version::parse(std::string_view str) -> Version
+    {
+        // The versions of packages are parsed again for each of their builds
+        static auto cache = util::BoundedCache<Version>(8192);
+        return cache.get_or_make(strip(str), &parse_uncached);
+    }
 }
@@ -32,17 +32,22 @@ main(int argc, char** argv)
     CLI::App app{};
     fs::u8path path;
     int timeout = 1;
+    bool shared = false;
 
     CLI::App* lock_com = app.add_subcommand("lock", "Lock a path");
     lock_com->add_option("path", path, "Path to lock");
     lock_com->add_option("-t,--timeout", timeout, "Timeout in seconds");
+    lock_com->add_flag("--shared", shared, "Only exclude exclusive locks");
     lock_com->callback(
         [&]()
         {
             mamba::Context::instance().lock_timeout = timeout;
             try
             {
-                auto lock = mamba::LockFile(path);
+                auto lock = mamba::LockFile(
+                    path,
+                    shared ? mamba::LockMode::shared : mamba::LockMode::exclusive
+                );
                 if (lock)
                 {
                     std::cout << 1;
@@ -1,6 +1,11 @@
+#include <chrono>
+
 #include <doctest/doctest.h>
 
 #include "mamba/core/activation.hpp"
+#include "mamba/core/environment.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/util_string.hpp"
 
 namespace mamba
 {
@@ -13,5 +18,100 @@ namespace mamba
             // std::endl; std::cout << a.activate("/home/wolfv/miniconda3/", false) <<
             // std::endl;
         }
+
+        TEST_CASE("activation_cache")
+        {
+            auto tmp_dir = TemporaryDirectory();
+            const auto prefix = tmp_dir.path() / "env";
+            const auto env_vars_dir = prefix / "etc" / "conda" / "env_vars.d";
+            const auto activate_dir = prefix / "etc" / "conda" / "activate.d";
+            fs::create_directories(env_vars_dir);
+            fs::create_directories(activate_dir);
+            const auto env_vars_file = env_vars_dir / "pkg.json";
+            open_ofstream(env_vars_file) << R"({"foo": "bar"})";
+            open_ofstream(activate_dir / "pkg.sh") << "";
+            open_ofstream(activate_dir / "pkg.fish") << "";
+
+            const auto old_cache_home = env::get("XDG_CACHE_HOME");
+            env::set("XDG_CACHE_HOME", (tmp_dir.path() / "cache").string());
+            using Vars = std::vector<std::pair<std::string, std::string>>;
+
+            {
+                PosixActivator a;
+                CHECK_EQ(a.get_environment_vars(prefix), Vars{ { "FOO", "bar" } });
+                CHECK_EQ(a.get_activate_scripts(prefix).size(), 1);
+            }
+            const auto cache_dir = tmp_dir.path() / "cache" / "mamba" / "activation";
+            CHECK_EQ(filter_dir(cache_dir, ".json").size(), 1);
+
+            {
+                // Read from the cache, with the scripts of another shell
+                FishActivator a;
+                CHECK_EQ(a.get_environment_vars(prefix), Vars{ { "FOO", "bar" } });
+                const auto scripts = a.get_activate_scripts(prefix);
+                REQUIRE_EQ(scripts.size(), 1);
+                CHECK_EQ(scripts.front().filename(), "pkg.fish");
+            }
+
+            {
+                // Files of env_vars.d edited in place
+                open_ofstream(env_vars_file) << R"({"foo": "baz"})";
+                fs::last_write_time(
+                    env_vars_file,
+                    fs::last_write_time(env_vars_file) + std::chrono::seconds(1)
+                );
+                PosixActivator a;
+                CHECK_EQ(a.get_environment_vars(prefix), Vars{ { "FOO", "baz" } });
+            }
+
+            {
+                // New scripts
+                open_ofstream(activate_dir / "other.sh") << "";
+                fs::last_write_time(
+                    activate_dir,
+                    fs::last_write_time(activate_dir) + std::chrono::seconds(1)
+                );
+                PosixActivator a;
+                CHECK_EQ(a.get_activate_scripts(prefix).size(), 2);
+            }
+
+            if (old_cache_home.has_value())
+            {
+                env::set("XDG_CACHE_HOME", old_cache_home.value());
+            }
+            else
+            {
+                env::unset("XDG_CACHE_HOME");
+            }
+        }
+
+        TEST_CASE("activated_environment")
+        {
+            auto tmp_dir = TemporaryDirectory();
+            const auto prefix = tmp_dir.path() / "env";
+            const auto env_vars_dir = prefix / "etc" / "conda" / "env_vars.d";
+            fs::create_directories(env_vars_dir);
+            open_ofstream(env_vars_dir / "pkg.json") << R"({"foo": "bar"})";
+
+            {
+                PosixActivator a;
+                const auto env = a.activated_environment(prefix);
+                REQUIRE(env.has_value());
+                CHECK_EQ(env->at("FOO"), "bar");
+                CHECK_EQ(env->at("CONDA_PREFIX"), prefix.string());
+#ifndef _WIN32
+                CHECK(starts_with(env->at("PATH"), (prefix / "bin").string()));
+#endif
+            }
+
+            {
+                // Scripts need a shell
+                const auto activate_dir = prefix / "etc" / "conda" / "activate.d";
+                fs::create_directories(activate_dir);
+                open_ofstream(activate_dir / "pkg.sh") << "";
+                PosixActivator a;
+                CHECK_FALSE(a.activated_environment(prefix).has_value());
+            }
+        }
     }
 }  // namespace mamba
@@ -466,6 +466,32 @@ namespace mamba
             CHECK_EQ(c7.platforms(), std::vector<std::string>({ "noarch", "arbitrary" }));
         }
 
+        TEST_CASE("make_channel_from_package_url")
+        {
+            ChannelContext channel_context;
+            const std::string url = "https://conda.anaconda.org/conda-forge/linux-64/"
+                                    "xtensor-0.24.0-h1234_0.tar.bz2";
+            const Channel& c = channel_context.make_channel(url);
+            CHECK_EQ(c.scheme(), "https");
+            CHECK_EQ(c.location(), "conda.anaconda.org");
+            CHECK_EQ(c.name(), "conda-forge");
+            CHECK_EQ(c.canonical_name(), "conda-forge");
+            CHECK_EQ(c.platforms(), std::vector<std::string>({ "linux-64" }));
+            CHECK_EQ(c.package_filename(), "xtensor-0.24.0-h1234_0.tar.bz2");
+            CHECK_EQ(&channel_context.make_channel(url), &c);
+            CHECK_EQ(c, channel_context.make_channel("conda-forge"));
+
+            const Channel& c2 = channel_context.make_channel(
+                "https://repo.mamba.pm/conda-forge/noarch/xtensor-0.24.0-h1234_0.conda"
+            );
+            CHECK_EQ(c2.location(), "repo.mamba.pm");
+            CHECK_EQ(c2.name(), "conda-forge");
+            CHECK_EQ(c2.canonical_name(), "https://repo.mamba.pm/conda-forge");
+            CHECK_EQ(c2.platforms(), std::vector<std::string>({ "noarch" }));
+            CHECK_EQ(c2.package_filename(), "xtensor-0.24.0-h1234_0.conda");
+            CHECK_NE(c2, c);
+        }
+
         TEST_CASE("urls")
         {
             std::string value = "https://conda.anaconda.org/conda-forge[noarch,win-64,arbitrary]";
@@ -0,0 +1,85 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/completion_index.hpp"
+#include "mamba/core/package_info.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/util.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto mkpkg(std::string name, std::string version) -> PackageInfo
+    {
+        auto pkg = PackageInfo(std::move(name));
+        pkg.version = std::move(version);
+        return pkg;
+    }
+}
+
+TEST_SUITE("completion_index")
+{
+    TEST_CASE("Package names")
+    {
+        ChannelContext channel_context = {};
+        auto index = CompletionIndex();
+
+        {
+            auto pool = MPool{ channel_context };
+            MRepo(
+                pool,
+                "a",
+                { mkpkg("numpy", "1.0"), mkpkg("numpy", "2.0"), mkpkg("zlib", "1.0") }
+            );
+            CHECK(index.add_package_names(pool));
+            CHECK_FALSE(index.add_package_names(pool));
+        }
+        {
+            auto pool = MPool{ channel_context };
+            MRepo(pool, "b", { mkpkg("numba", "1.0") });
+            CHECK(index.add_package_names(pool));
+        }
+        const auto expected = std::vector<std::string>{ "numba", "numpy", "zlib" };
+        CHECK_EQ(index.package_names(), expected);
+    }
+
+    TEST_CASE("Environment names")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto envs_dir = tmp_dir.path() / "envs";
+        path::touch(envs_dir / "env1" / "conda-meta" / "history", true);
+        path::touch(envs_dir / "env2" / "conda-meta" / "history", true);
+        fs::create_directories(envs_dir / "not-an-env");
+
+        auto index = CompletionIndex();
+        CHECK(index.set_envs_dirs({ envs_dir, tmp_dir.path() / "missing" }));
+        CHECK_FALSE(index.set_envs_dirs({ envs_dir, tmp_dir.path() / "missing" }));
+        const auto expected = std::vector<std::string>{ "env1", "env2" };
+        CHECK_EQ(index.env_names(), expected);
+
+        SUBCASE("Read back")
+        {
+            const auto path = tmp_dir.path() / "completion.json";
+            CHECK_FALSE(CompletionIndex::read(path).has_value());
+            index.write(path);
+            const auto read = CompletionIndex::read(path);
+            REQUIRE(read.has_value());
+            CHECK_EQ(read->envs_dirs(), index.envs_dirs());
+            CHECK_EQ(read->env_names(), expected);
+
+            open_ofstream(path) << "{";
+            CHECK_FALSE(CompletionIndex::read(path).has_value());
+        }
+    }
+}
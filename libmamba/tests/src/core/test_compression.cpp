@@ -0,0 +1,119 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "core/compression.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        /** Repetitive JSON-like content, compressing well as repodata does. */
+        auto make_data(std::size_t size) -> std::string
+        {
+            std::string data;
+            for (std::size_t i = 0; data.size() < size; ++i)
+            {
+                data += "{\"name\": \"pkg-" + std::to_string(i % 97) + "\", \"build_number\": "
+                        + std::to_string(i) + "},\n";
+            }
+            return data;
+        }
+
+        auto zstd_compress(const std::string& data) -> std::string
+        {
+            std::string out(ZSTD_compressBound(data.size()), '\0');
+            const auto size = ZSTD_compress(out.data(), out.size(), data.data(), data.size(), 3);
+            REQUIRE_FALSE(ZSTD_isError(size));
+            out.resize(size);
+            return out;
+        }
+
+        auto bzip2_compress(std::string data) -> std::string
+        {
+            auto size = static_cast<unsigned int>(data.size() + data.size() / 100 + 600);
+            std::string out(size, '\0');
+            const auto res = BZ2_bzBuffToBuffCompress(
+                out.data(),
+                &size,
+                data.data(),
+                static_cast<unsigned int>(data.size()),
+                9,
+                0,
+                0
+            );
+            REQUIRE_EQ(res, BZ_OK);
+            out.resize(size);
+            return out;
+        }
+
+        /** Write the compressed data in pieces of ``piece_size``, as received by curl. */
+        template <class Stream>
+        void write_pieces(Stream& stream, std::string compressed, std::size_t piece_size)
+        {
+            for (std::size_t pos = 0; pos < compressed.size(); pos += piece_size)
+            {
+                const auto size = std::min(piece_size, compressed.size() - pos);
+                REQUIRE_EQ(stream.write(compressed.data() + pos, size), size);
+            }
+            REQUIRE(stream.flush());
+        }
+    }
+
+    TEST_SUITE("compression")
+    {
+        TEST_CASE("ZstdStream")
+        {
+            const auto data = make_data(10 * ZstdStream::buffer_size());
+            std::string out;
+            std::size_t n_writes = 0;
+            auto stream = ZstdStream(
+                [&](const char* ptr, std::size_t size)
+                {
+                    out.append(ptr, size);
+                    ++n_writes;
+                    return true;
+                }
+            );
+
+            write_pieces(stream, zstd_compress(data), 1000);
+            CHECK_EQ(out, data);
+            // Only full buffers are handed to the sink, as well as the remainder
+            CHECK_EQ(n_writes, 11);
+
+            SUBCASE("Aborted by the sink")
+            {
+                auto failing = ZstdStream([](const char*, std::size_t) { return false; });
+                auto compressed = zstd_compress(data);
+                CHECK_NE(failing.write(compressed.data(), compressed.size()), compressed.size());
+            }
+        }
+
+        TEST_CASE("Bzip2Stream")
+        {
+            const auto data = make_data(3 * Bzip2Stream::BUFFER_SIZE);
+            std::string out;
+            std::size_t n_writes = 0;
+            auto stream = Bzip2Stream(
+                [&](const char* ptr, std::size_t size)
+                {
+                    out.append(ptr, size);
+                    ++n_writes;
+                    return true;
+                }
+            );
+
+            write_pieces(stream, bzip2_compress(data), 1000);
+            CHECK_EQ(out, data);
+            CHECK_EQ(n_writes, 4);
+        }
+    }
+}
@@ -157,6 +157,32 @@ namespace mamba
                 CHECK_EQ(config.dump(MAMBA_SHOW_CONFIG_VALUES | MAMBA_SHOW_CONFIG_SRCS), "");
             }
 
+            TEST_CASE_FIXTURE(Configuration, "load_subset")
+            {
+                std::string rc = unindent(R"(
+                    changeps1: false
+                    channels:
+                        - test1)");
+                {
+                    std::ofstream out_file(tempfile_ptr->path().std_path());
+                    out_file << rc;
+                }
+                config.reset_configurables();
+                ctx.channels = {};
+                config.at("rc_files").set_value<std::vector<fs::u8path>>({ tempfile_ptr->path() });
+
+                config.load({ "changeps1" });
+                CHECK_FALSE(ctx.change_ps1);
+                CHECK(ctx.channels.empty());
+
+                config.load();
+                CHECK_FALSE(ctx.change_ps1);
+                CHECK_EQ(ctx.channels, std::vector<std::string>({ "test1" }));
+
+                CHECK_THROWS(config.load({ "not_a_configurable" }));
+                ctx.change_ps1 = true;
+            }
+
             TEST_CASE_FIXTURE(Configuration, "load_rc_files")
             {
                 std::string rc1 = unindent(R"(
@@ -18,6 +18,7 @@
 #include "mamba/core/match_spec.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/subdirdata.hpp"
+#include "mamba/core/util.hpp"
 
 #include "test_data.hpp"
 
@@ -234,6 +235,23 @@ namespace mamba
                 MatchSpec ms("numpy=1.20", channel_context);
                 CHECK_EQ(ms.str(), "numpy=1.20");
             }
+            {
+                MatchSpec ms("foo[a=\"b c\", d='e', f=g h=i,k=l]", channel_context);
+                CHECK_EQ(ms.name, "foo");
+                CHECK_EQ(ms.brackets["a"], "b c");
+                CHECK_EQ(ms.brackets["d"], "e");
+                CHECK_EQ(ms.brackets["f"], "g");
+                CHECK_EQ(ms.brackets["h"], "i");
+                CHECK_EQ(ms.brackets["k"], "l");
+            }
+            {
+                MatchSpec ms("foo >=1.0 (optional)", channel_context);
+                CHECK_EQ(ms.name, "foo");
+                CHECK_EQ(ms.version, ">=1.0");
+                CHECK(ms.optional);
+            }
+            CHECK_THROWS_AS(MatchSpec("foo[a=]", channel_context), std::runtime_error);
+            CHECK_THROWS_AS(MatchSpec(">=1.0", channel_context), std::runtime_error);
         }
 
         TEST_CASE("is_simple")
@@ -485,6 +503,35 @@ namespace mamba
             CHECK_EQ(s[2].str(), "/simple/shebang/escaped\\ space");
             CHECK_EQ(s[3].str(), " --and --flags -x");
         }
+
+        TEST_CASE("make_link_plan")
+        {
+            const auto tmp_dir = TemporaryDirectory();
+            const auto pkg_dir = tmp_dir.path() / "pkg-1.0-0";
+            fs::create_directories(pkg_dir / "info");
+            open_ofstream(pkg_dir / "info" / "paths.json")
+                << R"({"paths_version": 1, "paths": [)"
+                << R"({"_path": "site-packages/a.py", "size_in_bytes": 1},)"
+                << R"({"_path": "python-scripts/cli", "size_in_bytes": 1},)"
+                << R"({"_path": "share/a.txt", "size_in_bytes": 1}]})";
+
+            auto context = TransactionContext(tmp_dir.path() / "prefix", { "3.11.0", "" }, {});
+            context.exclude_files = { "share/*" };
+
+            const auto plan = make_link_plan(pkg_dir, context, true);
+            CHECK_EQ(plan.source, pkg_dir);
+            REQUIRE_EQ(plan.files.size(), 2);
+            CHECK_EQ(plan.files[0].path, "site-packages/a.py");
+            const auto targets = std::vector<std::string>{
+                (get_python_site_packages_short_path("3.11") / "a.py").string(),
+                (get_bin_directory_short_path() / "cli").string(),
+            };
+            CHECK_EQ(plan.targets, targets);
+            CHECK_EQ(plan.excluded_files, std::vector<std::string>{ "share/a.txt" });
+
+            const auto not_noarch = make_link_plan(pkg_dir, context, false);
+            CHECK_EQ(not_noarch.targets[0], "site-packages/a.py");
+        }
     }
 
     TEST_SUITE("utils")
@@ -657,5 +704,57 @@ namespace mamba
             CHECK_EQ(j.has_zst.value().value, true);
             CHECK_EQ(j.has_zst.value().last_checked, parse_utc_timestamp("2023-01-06T16:33:06Z"));
         }
+
+        TEST_CASE("parse_mod_etag_state_round_trip")
+        {
+            const auto tmp_dir = TemporaryDirectory();
+            const auto file = tmp_dir.path() / "test_4.json";
+            fs::copy(test_data_dir / "repodata_json_cache" / "test_4.json", file);
+            const auto state_file = tmp_dir.path() / "test_4.state.json";
+
+            auto from_header = detail::read_metadata(file).value();
+            CHECK_FALSE(fs::exists(state_file));
+            from_header.store_file_metadata(file);
+            {
+                auto out = open_ofstream(state_file);
+                from_header.serialize_to_stream(out);
+            }
+
+            // Read from the state file, validated against the cache file
+            auto from_state = detail::read_metadata(file).value();
+            CHECK_EQ(from_state.url, from_header.url);
+            CHECK_EQ(from_state.etag, from_header.etag);
+            CHECK_EQ(from_state.mod, from_header.mod);
+            CHECK_EQ(from_state.cache_control, from_header.cache_control);
+            CHECK(from_state.check_valid_metadata(file));
+
+            open_ofstream(file, std::ios::app) << " ";
+            CHECK_FALSE(detail::read_metadata(file).has_value());
+        }
+
+        TEST_CASE("index_verified")
+        {
+            subdir_metadata m;
+            m.url = "https://conda.anaconda.org/conda-forge/noarch/repodata.json";
+            m.stored_file_size = 42;
+            CHECK_FALSE(m.is_index_verified(1));
+
+            // Not identified by the size only
+            m.set_index_verified(1);
+            CHECK_FALSE(m.is_index_verified(1));
+
+            m.etag = "\"abc\"";
+            m.set_index_verified(1);
+            CHECK(m.is_index_verified(1));
+            CHECK_FALSE(m.is_index_verified(2));
+
+            std::stringstream ss;
+            m.serialize_to_stream(ss);
+            auto read = subdir_metadata::from_stream(ss).value();
+            CHECK(read.is_index_verified(1));
+
+            read.etag = "\"def\"";
+            CHECK_FALSE(read.is_index_verified(1));
+        }
     }
 }  // namespace mamba
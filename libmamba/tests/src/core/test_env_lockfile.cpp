@@ -4,13 +4,17 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+
 #include <doctest/doctest.h>
 #include <yaml-cpp/exceptions.h>
 
 #include "mamba/core/channel.hpp"
 #include "mamba/core/env_lockfile.hpp"
 #include "mamba/core/fsutil.hpp"
+#include "mamba/core/prefix_data.hpp"
 #include "mamba/core/transaction.hpp"
+#include "mamba/core/util.hpp"
 
 #include "test_data.hpp"
 
@@ -132,6 +136,74 @@ namespace mamba
             }
         }
 
+        TEST_CASE("filtered_and_cached_packages")
+        {
+            ChannelContext channel_context;
+            const fs::u8path lockfile_path{ test_data_dir
+                                            / "env_lockfile/good_multiple_categories-lock.yaml" };
+            const auto cache_dir = TemporaryDirectory();
+            const auto filter = EnvLockFileFilter{ "linux-64", { "main" } };
+            auto count_cached = [&]()
+            {
+                std::size_t n = 0;
+                for (const auto& entry : fs::directory_iterator(cache_dir.path()))
+                {
+                    n += (entry.path().extension() == ".bin") ? 1 : 0;
+                }
+                return n;
+            };
+
+            const auto maybe_parsed = read_environment_lockfile(
+                channel_context,
+                lockfile_path,
+                filter,
+                cache_dir.path()
+            );
+            REQUIRE_MESSAGE(maybe_parsed, maybe_parsed.error().what());
+            const auto& parsed = maybe_parsed.value();
+            for (const auto& package : parsed.get_all_packages())
+            {
+                CHECK_EQ(package.platform, "linux-64");
+                CHECK_EQ(package.category, "main");
+            }
+            CHECK_EQ(parsed.get_packages_for("main", "linux-64", "conda").size(), 3);
+            CHECK(parsed.get_packages_for("dev", "linux-64", "conda").empty());
+            CHECK_EQ(count_cached(), 1);
+
+            const auto maybe_cached = read_environment_lockfile(
+                channel_context,
+                lockfile_path,
+                filter,
+                cache_dir.path()
+            );
+            REQUIRE_MESSAGE(maybe_cached, maybe_cached.error().what());
+            const auto& cached = maybe_cached.value();
+            REQUIRE_EQ(cached.get_all_packages().size(), parsed.get_all_packages().size());
+            for (std::size_t i = 0; i < cached.get_all_packages().size(); ++i)
+            {
+                const auto& expected = parsed.get_all_packages()[i];
+                const auto& actual = cached.get_all_packages()[i];
+                CHECK_EQ(actual.info, expected.info);
+                CHECK_EQ(actual.info.channel, expected.info.channel);
+                CHECK_EQ(actual.info.depends, expected.info.depends);
+                CHECK_EQ(actual.category, expected.category);
+                CHECK_EQ(actual.manager, expected.manager);
+            }
+            CHECK_EQ(cached.get_metadata().platforms, parsed.get_metadata().platforms);
+
+            // Another selection is cached separately
+            const auto maybe_other = read_environment_lockfile(
+                channel_context,
+                lockfile_path,
+                EnvLockFileFilter{ "linux-64", { "dev" } },
+                cache_dir.path()
+            );
+            REQUIRE_MESSAGE(maybe_other, maybe_other.error().what());
+            const auto& other = maybe_other.value();
+            CHECK(other.get_packages_for("main", "linux-64", "conda").empty());
+            CHECK_EQ(count_cached(), 2);
+        }
+
         TEST_CASE("create_transaction_with_categories")
         {
             const fs::u8path lockfile_path{ test_data_dir
@@ -139,6 +211,8 @@ namespace mamba
             ChannelContext channel_context;
             MPool pool{ channel_context };
             mamba::MultiPackageCache pkg_cache({ "/tmp/" });
+            const auto tmp_dir = TemporaryDirectory();
+            const auto prefix = PrefixData::create(tmp_dir.path(), channel_context).value();
 
             auto& ctx = Context::instance();
 
@@ -150,6 +224,7 @@ namespace mamba
                 std::vector<detail::other_pkg_mgr_spec> other_specs;
                 auto transaction = create_explicit_transaction_from_lockfile(
                     pool,
+                    prefix,
                     lockfile_path,
                     categories,
                     pkg_cache,
@@ -175,6 +250,62 @@ namespace mamba
 
             ctx.platform = ctx.host_platform;
         }
+
+        TEST_CASE("create_transaction_with_installed_packages")
+        {
+            const fs::u8path lockfile_path{ test_data_dir
+                                            / "env_lockfile/good_multiple_categories-lock.yaml" };
+            ChannelContext channel_context;
+            MPool pool{ channel_context };
+            mamba::MultiPackageCache pkg_cache({ "/tmp/" });
+            const auto tmp_dir = TemporaryDirectory();
+            auto prefix = PrefixData::create(tmp_dir.path(), channel_context).value();
+
+            auto& ctx = Context::instance();
+            ctx.platform = "linux-64";
+
+            const auto lockfile = read_environment_lockfile(channel_context, lockfile_path).value();
+            auto packages = lockfile.get_packages_for("main", "linux-64", "conda");
+            REQUIRE_EQ(packages.size(), 3);
+            std::sort(
+                packages.begin(),
+                packages.end(),
+                [](const auto& a, const auto& b) { return a.name < b.name; }
+            );
+            // pip installed identically, wheel installed at another version
+            auto installed_wheel = packages.at(2);
+            REQUIRE_EQ(installed_wheel.name, "wheel");
+            installed_wheel.version = "0.37.0";
+            installed_wheel.fn = "wheel-0.37.0-pyhd8ed1ab_0.tar.bz2";
+            installed_wheel.sha256 = "";
+            prefix.add_packages({ packages.at(0), installed_wheel });
+
+            std::vector<detail::other_pkg_mgr_spec> other_specs;
+            auto transaction = create_explicit_transaction_from_lockfile(
+                pool,
+                prefix,
+                lockfile_path,
+                { "main" },
+                pkg_cache,
+                other_specs
+            );
+            const auto& [specs, to_install, to_remove] = transaction.to_conda();
+            auto installed_fns = std::vector<std::string>();
+            for (const auto& [channel, fn, json] : to_install)
+            {
+                installed_fns.push_back(fn);
+            }
+            std::sort(installed_fns.begin(), installed_fns.end());
+            const auto expected_fns = std::vector<std::string>{
+                "setuptools-65.3.0-pyhd8ed1ab_1.tar.bz2",
+                "wheel-0.37.1-pyhd8ed1ab_0.tar.bz2",
+            };
+            CHECK_EQ(installed_fns, expected_fns);
+            REQUIRE_EQ(to_remove.size(), 1);
+            CHECK_EQ(std::get<1>(to_remove.at(0)), "wheel-0.37.0-pyhd8ed1ab_0.tar.bz2");
+
+            ctx.platform = ctx.host_platform;
+        }
     }
 
     TEST_SUITE("is_env_lockfile_name")
@@ -4,11 +4,14 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <set>
+
 #include <doctest/doctest.h>
 
 #include "mamba/core/environment.hpp"
 #include "mamba/core/environments_manager.hpp"
 #include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/util.hpp"
 
 namespace mamba
 {
@@ -55,5 +58,33 @@ namespace mamba
             // Remove test directory
             fs::remove_all(env::expand_user("~/some_test_folder"));
         }
+
+        TEST_CASE("envs_dir_prefixes")
+        {
+            const auto envs_dir = TemporaryDirectory();
+            for (const auto* name : { "env1", "env2", "env3" })
+            {
+                path::touch(envs_dir.path() / name / "conda-meta" / "history", true);
+            }
+            fs::create_directories(envs_dir.path() / "not_an_env");
+            const auto expected = std::set<fs::u8path>{
+                envs_dir.path() / "env1",
+                envs_dir.path() / "env2",
+                envs_dir.path() / "env3",
+            };
+
+            EnvironmentsManager e;
+            CHECK_EQ(e.list_envs_dir_prefixes(envs_dir.path()), expected);
+
+            // Such as an environment populated by another tool
+            path::touch(envs_dir.path() / "not_an_env" / "conda-meta" / "history", true);
+            fs::remove_all(envs_dir.path() / "env3");
+            auto changed = expected;
+            changed.erase(envs_dir.path() / "env3");
+            changed.insert(envs_dir.path() / "not_an_env");
+            CHECK_EQ(e.list_envs_dir_prefixes(envs_dir.path()), changed);
+
+            CHECK(e.list_envs_dir_prefixes(envs_dir.path() / "missing").empty());
+        }
     }
 }  // namespace mamba
@@ -0,0 +1,150 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/package_paths.hpp"
+#include "mamba/core/util.hpp"
+
+#include "core/fast_json.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto write_file(const fs::u8path& path, std::string_view content) -> fs::u8path
+    {
+        fs::create_directories(path.parent_path());
+        open_ofstream(path) << content;
+        return path;
+    }
+}
+
+TEST_SUITE("fast_json")
+{
+    TEST_CASE("read_object")
+    {
+        const auto tmp = TemporaryDirectory();
+        const auto file = write_file(
+            tmp.path() / "record.json",
+            R"({"name": "pkg", "build_number": 3, "size": -1, "files": ["a", "b"],)"
+            R"( "depends": ["python >=3.8"], "noarch": null, "timestamp": 1.5,)"
+            R"( "name": "duplicated"})"
+        );
+        const auto keep = [](std::string_view key) { return key != "files"; };
+
+        const auto record = fast_json::read_object(file, keep);
+        if (!fast_json::enabled())
+        {
+            CHECK_FALSE(record.has_value());
+            return;
+        }
+        REQUIRE(record.has_value());
+        const auto expected = nlohmann::json{
+            { "name", "duplicated" }, { "build_number", 3 },     { "size", -1 },
+            { "depends", { "python >=3.8" } }, { "noarch", nullptr }, { "timestamp", 1.5 },
+        };
+        CHECK_EQ(record.value(), expected);
+        CHECK(record->at("build_number").is_number_unsigned());
+
+        SUBCASE("Invalid files are left to nlohmann::json")
+        {
+            const auto invalid = write_file(tmp.path() / "invalid.json", R"({"name": "pkg",)");
+            CHECK_FALSE(fast_json::read_object(invalid, keep).has_value());
+            const auto array = write_file(tmp.path() / "array.json", "[]");
+            CHECK_FALSE(fast_json::read_object(array, keep).has_value());
+            CHECK_FALSE(fast_json::read_object(tmp.path() / "missing.json", keep).has_value());
+        }
+    }
+
+    TEST_CASE("read_paths_json")
+    {
+        const auto tmp = TemporaryDirectory();
+        const auto file = write_file(
+            tmp.path() / "pkg" / "info" / "paths.json",
+            R"({"paths_version": 1, "paths": [)"
+            R"({"_path": "lib/a.so", "path_type": "hardlink", "sha256": "abc",)"
+            R"( "size_in_bytes": 10, "file_mode": "binary", "prefix_placeholder": "/opt"},)"
+            R"({"_path": "lib/b.so", "path_type": "softlink", "sha256": "def",)"
+            R"( "size_in_bytes": 0, "no_link": true}]})"
+        );
+
+        const auto paths = fast_json::read_paths_json(file);
+        if (!fast_json::enabled())
+        {
+            CHECK_FALSE(paths.has_value());
+            return;
+        }
+        REQUIRE(paths.has_value());
+        REQUIRE_EQ(paths->size(), 2);
+        // Same as the paths read with nlohmann::json
+        const auto expected = read_paths(tmp.path() / "pkg");
+        for (std::size_t i = 0; i < expected.size(); ++i)
+        {
+            CHECK_EQ(paths->at(i).path, expected.at(i).path);
+            CHECK_EQ(paths->at(i).path_type, expected.at(i).path_type);
+            CHECK_EQ(paths->at(i).sha256, expected.at(i).sha256);
+            CHECK_EQ(paths->at(i).size_in_bytes, expected.at(i).size_in_bytes);
+            CHECK_EQ(paths->at(i).prefix_placeholder, expected.at(i).prefix_placeholder);
+            CHECK_EQ(paths->at(i).file_mode, expected.at(i).file_mode);
+            CHECK_EQ(paths->at(i).no_link, expected.at(i).no_link);
+        }
+        CHECK_EQ(paths->at(0).file_mode, FileMode::BINARY);
+        CHECK_EQ(paths->at(1).file_mode, FileMode::UNDEFINED);
+        CHECK(paths->at(1).sha256.empty());
+
+        SUBCASE("Errors are reported by nlohmann::json")
+        {
+            write_file(tmp.path() / "new" / "info" / "paths.json", R"({"paths_version": 2})");
+            CHECK_FALSE(fast_json::read_paths_json(tmp.path() / "new" / "info" / "paths.json"));
+            CHECK_THROWS_AS(read_paths(tmp.path() / "new"), std::runtime_error);
+
+            write_file(
+                tmp.path() / "bad" / "info" / "paths.json",
+                R"({"paths_version": 1, "paths": [{"_path": null, "size_in_bytes": 1}]})"
+            );
+            CHECK_FALSE(fast_json::read_paths_json(tmp.path() / "bad" / "info" / "paths.json"));
+            CHECK_THROWS_AS(read_paths(tmp.path() / "bad"), nlohmann::json::type_error);
+        }
+    }
+
+    TEST_CASE("for_each_repodata_record")
+    {
+        const auto tmp = TemporaryDirectory();
+        const auto file = write_file(
+            tmp.path() / "repodata.json",
+            R"({"info": {"subdir": "linux-64"}, "packages": {"a-1.0-0.tar.bz2": {"name": "a"}},)"
+            R"( "removed": {"c-1.0-0.tar.bz2": {"name": "c"}},)"
+            R"( "packages.conda": {"b-1.0-0.conda": {"name": "b"}, "bad.conda": 3}})"
+        );
+
+        auto records = std::vector<std::string>();
+        const bool read = fast_json::for_each_repodata_record(
+            file,
+            [&](std::string_view fn, nlohmann::json&& record)
+            { records.push_back(std::string(fn) + ":" + record.at("name").get<std::string>()); }
+        );
+        CHECK_EQ(read, fast_json::enabled());
+        if (read)
+        {
+            const auto expected = std::vector<std::string>{ "a-1.0-0.tar.bz2:a", "b-1.0-0.conda:b" };
+            CHECK_EQ(records, expected);
+        }
+
+        const auto invalid = write_file(tmp.path() / "invalid.json", R"({"packages": {"a": )");
+        records.clear();
+        CHECK_FALSE(fast_json::for_each_repodata_record(
+            invalid,
+            [&](std::string_view fn, nlohmann::json&&) { records.emplace_back(fn); }
+        ));
+        CHECK(records.empty());
+    }
+}
@@ -18,6 +18,7 @@
 
 #include "mamba/core/channel.hpp"
 #include "mamba/core/history.hpp"
+#include "mamba/core/util.hpp"
 
 #include "test_data.hpp"
 
@@ -33,6 +34,9 @@ namespace mamba
             static const auto aux_file_path = fs::absolute(
                 test_data_dir / "history/parse/conda-meta/aux_file"
             );
+            static const auto index_file_path = fs::absolute(
+                test_data_dir / "history/parse/conda-meta/history.mamba-index"
+            );
 
             // Backup history file and restore it at the end of the test, whatever the output.
             struct ScopedHistoryFileBackup
@@ -46,6 +50,7 @@ namespace mamba
                 {
                     fs::remove(history_file_path);
                     fs::copy(aux_file_path, history_file_path);
+                    fs::remove(index_file_path);
                 }
             } scoped_history_file_backup;
 
@@ -89,6 +94,90 @@ namespace mamba
             REQUIRE_EQ(updated_history_buffer.str(), check_buffer.str());
         }
 
+        TEST_CASE("index")
+        {
+            const auto prefix = TemporaryDirectory();
+            const auto history_file = prefix.path() / "conda-meta" / "history";
+            const auto index_file = prefix.path() / "conda-meta" / "history.mamba-index";
+            fs::create_directories(history_file.parent_path());
+            fs::copy(test_data_dir / "history/parse/conda-meta/history", history_file);
+
+            ChannelContext channel_context;
+            History history_instance(prefix.path(), channel_context);
+
+            // The requests as parsed from the text only
+            auto parsed_requests = [&]()
+            {
+                fs::remove(index_file);
+                auto requests = history_instance.get_user_requests();
+                fs::remove(index_file);
+                return requests;
+            };
+            auto check_equal = [](const auto& lhs, const auto& rhs)
+            {
+                REQUIRE_EQ(lhs.size(), rhs.size());
+                for (std::size_t i = 0; i < lhs.size(); ++i)
+                {
+                    CHECK_EQ(lhs[i].date, rhs[i].date);
+                    CHECK_EQ(lhs[i].cmd, rhs[i].cmd);
+                    CHECK_EQ(lhs[i].conda_version, rhs[i].conda_version);
+                    CHECK_EQ(lhs[i].unlink_dists, rhs[i].unlink_dists);
+                    CHECK_EQ(lhs[i].link_dists, rhs[i].link_dists);
+                    CHECK_EQ(lhs[i].update, rhs[i].update);
+                    CHECK_EQ(lhs[i].remove, rhs[i].remove);
+                    CHECK_EQ(lhs[i].neutered, rhs[i].neutered);
+                }
+            };
+
+            const auto requests = history_instance.get_user_requests();
+            REQUIRE(fs::exists(index_file));
+            check_equal(history_instance.get_user_requests(), requests);
+
+            SUBCASE("Added entries are indexed")
+            {
+                auto request = History::UserRequest::prefilled();
+                request.link_dists = { "conda-forge/linux-64::foo-1.0-h0_0" };
+                request.update = { "foo" };
+                history_instance.add_entry(request);
+
+                const auto indexed = history_instance.get_user_requests();
+                REQUIRE_EQ(indexed.size(), requests.size() + 1);
+                CHECK_EQ(indexed.back().update, std::vector<std::string>{ "foo" });
+                check_equal(indexed, parsed_requests());
+            }
+
+            SUBCASE("Entries written by other tools are parsed")
+            {
+                open_ofstream(history_file, std::ios::app) << "==> 2023-01-01 00:00:00 <==\n"
+                                                           << "# cmd: conda install bar\n"
+                                                           << "+conda-forge/noarch::bar-1.0-0\n"
+                                                           << "# update specs: [\"bar\"]\n";
+                const auto indexed = history_instance.get_user_requests();
+                REQUIRE_EQ(indexed.size(), requests.size() + 1);
+                CHECK_EQ(indexed.back().update, std::vector<std::string>{ "bar" });
+                check_equal(history_instance.get_user_requests(), indexed);
+            }
+
+            SUBCASE("Rewritten histories are parsed again")
+            {
+                open_ofstream(history_file) << "==> 2023-01-01 00:00:00 <==\n"
+                                            << "# update specs: [\"bar\"]\n";
+                const auto indexed = history_instance.get_user_requests();
+                REQUIRE_EQ(indexed.size(), 1);
+                CHECK_EQ(indexed.back().update, std::vector<std::string>{ "bar" });
+            }
+
+            SUBCASE("Invalid indexes are ignored")
+            {
+                open_ofstream(index_file, std::ios::app) << "garbage";
+                check_equal(history_instance.get_user_requests(), requests);
+                check_equal(history_instance.get_user_requests(), requests);
+
+                open_ofstream(index_file) << "not an index";
+                check_equal(history_instance.get_user_requests(), requests);
+            }
+        }
+
 #ifndef _WIN32
         TEST_CASE("parse_segfault")
         {
@@ -0,0 +1,80 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/api/index.hpp"
+#include "mamba/core/channel.hpp"
+#include "mamba/core/package_handling.hpp"
+#include "mamba/core/util.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    void make_package(const fs::u8path& out_file, const std::string& name)
+    {
+        const auto tmp_dir = TemporaryDirectory();
+        fs::create_directories(tmp_dir.path() / "info");
+        open_ofstream(tmp_dir.path() / "info" / "index.json")
+            << nlohmann::json{ { "name", name },
+                               { "version", "1.0" },
+                               { "build", "h0_0" },
+                               { "build_number", 0 },
+                               { "depends", nlohmann::json::array() } };
+        open_ofstream(tmp_dir.path() / "file.txt") << name;
+        create_package(tmp_dir.path(), out_file, 1, 1);
+    }
+}
+
+TEST_SUITE("index")
+{
+    TEST_CASE("index_channel")
+    {
+        const auto channel = TemporaryDirectory();
+        const auto subdir = channel.path() / "linux-64";
+        fs::create_directories(subdir);
+        make_package(subdir / "a-1.0-h0_0.tar.bz2", "a");
+        make_package(subdir / "b-1.0-h0_0.conda", "b");
+        open_ofstream(subdir / "broken-1.0-h0_0.conda") << "not a package";
+
+        auto channel_context = ChannelContext();
+        auto stats = index_channel(channel_context, channel.path(), 2);
+        REQUIRE_EQ(stats.size(), 2);
+        CHECK_EQ(stats["noarch"].n_packages, 0);
+        CHECK_EQ(stats["linux-64"].n_packages, 2);
+        CHECK_EQ(stats["linux-64"].n_indexed, 2);
+        CHECK_EQ(stats["linux-64"].errors.size(), 1);
+
+        const auto repodata = nlohmann::json::parse(open_ifstream(subdir / "repodata.json"));
+        CHECK_EQ(repodata["info"]["subdir"], "linux-64");
+        const auto& a = repodata["packages"]["a-1.0-h0_0.tar.bz2"];
+        CHECK_EQ(a["name"], "a");
+        CHECK_EQ(a["size"], fs::file_size(subdir / "a-1.0-h0_0.tar.bz2"));
+        CHECK_EQ(a["sha256"].get<std::string>().size(), 64);
+        CHECK_EQ(repodata["packages.conda"]["b-1.0-h0_0.conda"]["name"], "b");
+        CHECK(fs::exists(subdir / "repodata.json.zst"));
+        CHECK(fs::exists(subdir / "repodata.solv"));
+        CHECK(fs::exists(channel.path() / "noarch" / "repodata.json"));
+
+        SUBCASE("Only new packages are read again")
+        {
+            make_package(subdir / "c-1.0-h0_0.conda", "c");
+            fs::remove(subdir / "a-1.0-h0_0.tar.bz2");
+            const auto update = index_subdir(channel_context, subdir);
+            CHECK_EQ(update.n_packages, 2);
+            // The broken package is tried again
+            CHECK_EQ(update.n_indexed, 1);
+            CHECK_EQ(update.errors.size(), 1);
+            const auto updated = nlohmann::json::parse(open_ifstream(subdir / "repodata.json"));
+            CHECK(updated["packages"].empty());
+            CHECK(updated["packages.conda"].contains("c-1.0-h0_0.conda"));
+        }
+    }
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "mamba/api/install.hpp"
+#include "mamba/core/channel.hpp"
+#include "mamba/core/prefix_data.hpp"
+#include "mamba/core/util.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto make_package(const std::string& name, const std::string& version) -> PackageInfo
+    {
+        auto pkg = PackageInfo(name);
+        pkg.version = version;
+        pkg.build_string = "h0_0";
+        return pkg;
+    }
+}
+
+TEST_SUITE("install")
+{
+    TEST_CASE("specs_already_installed")
+    {
+        const auto prefix = TemporaryDirectory();
+        fs::create_directories(prefix.path() / "conda-meta");
+        {
+            auto out = open_ofstream(prefix.path() / "conda-meta" / "history");
+            out << "==> 2023-05-04 08:59:15 <==\n"
+                << "# cmd: micromamba install foo>=1.0\n"
+                << "+conda-forge/linux-64::foo-1.2-h0_0\n"
+                << "# update specs: [\"foo>=1.0\"]\n";
+        }
+
+        auto channel_context = ChannelContext();
+        auto prefix_data = PrefixData::create(prefix.path(), channel_context).value();
+        CHECK_FALSE(detail::specs_already_installed(prefix_data, { "foo" }));
+
+        prefix_data.add_packages({ make_package("foo", "1.2"), make_package("bar", "2.0") });
+
+        CHECK(detail::specs_already_installed(prefix_data, { "foo" }));
+        CHECK(detail::specs_already_installed(prefix_data, { "foo >=1.0" }));
+        CHECK(detail::specs_already_installed(prefix_data, { "foo 1.2 h0_0" }));
+        CHECK_FALSE(detail::specs_already_installed(prefix_data, {}));
+        // Needs another version
+        CHECK_FALSE(detail::specs_already_installed(prefix_data, { "foo >=2" }));
+        // Installed but not requested yet
+        CHECK_FALSE(detail::specs_already_installed(prefix_data, { "foo", "bar" }));
+        // Not installed
+        CHECK_FALSE(detail::specs_already_installed(prefix_data, { "baz" }));
+        // Needs the repodata
+        CHECK_FALSE(detail::specs_already_installed(prefix_data, { "conda-forge::foo" }));
+    }
+}
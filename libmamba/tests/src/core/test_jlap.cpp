@@ -0,0 +1,156 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/util_string.hpp"
+
+#include "core/jlap.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto to_string_view(const jlap::digest& d) -> std::string_view
+    {
+        return { reinterpret_cast<const char*>(d.data()), d.size() };
+    }
+
+    /** Build a jlap file from its patch lines. */
+    auto make_jlap(const std::vector<std::string>& patches, const std::string& latest)
+        -> std::string
+    {
+        auto iv = jlap::digest{};
+        auto lines = std::vector<std::string>{ hex_string(iv) };
+        lines.insert(lines.end(), patches.cbegin(), patches.cend());
+        lines.push_back(nlohmann::json{ { "url", "repodata.json" }, { "latest", latest } }.dump());
+        for (std::size_t i = 1; i < lines.size(); ++i)
+        {
+            iv = jlap::blake2b_256(lines[i], to_string_view(iv));
+        }
+        lines.push_back(hex_string(iv));
+        return join("\n", lines) + "\n";
+    }
+
+    auto make_patch(const std::string& from, const std::string& to, const std::string& pkg)
+        -> std::string
+    {
+        return nlohmann::json{
+            { "from", from },
+            { "to", to },
+            { "patch", { { { "op", "add" }, { "path", "/packages/" + pkg }, { "value", 0 } } } },
+        }
+            .dump();
+    }
+}
+
+TEST_SUITE("jlap")
+{
+    TEST_CASE("blake2b_256")
+    {
+        // Reference values from Python hashlib.blake2b(..., digest_size=32)
+        CHECK_EQ(
+            hex_string(jlap::blake2b_256("abc")),
+            "bddd813c634239723171ef3fee98579b94964e3bb1cb3e427262c8c068d52319"
+        );
+        CHECK_EQ(
+            hex_string(jlap::blake2b_256("", "key")),
+            "e65edfce5a36261cd824cb0f0da736b1109dcf20d2b831d598f337bb3552a3e4"
+        );
+        CHECK_EQ(
+            hex_string(jlap::blake2b_256(std::string(1000, 'x'), "k")),
+            "6af58244e327389c0f3f46068256d65c24b9cd4f8ba30c71694c9404ce4ace4f"
+        );
+        CHECK_EQ(
+            hex_string(jlap::blake2b_256(std::string(128, 'y'))),
+            "344a3b5dec41f412c454eb8e0a96c5ff9d31c94fed2bd73d4eea9bc92524993d"
+        );
+    }
+
+    TEST_CASE("parse")
+    {
+        const auto content = make_jlap(
+            { make_patch("h0", "h1", "a"), make_patch("h1", "h2", "b") },
+            "h2"
+        );
+
+        SUBCASE("Full file")
+        {
+            const auto patches = jlap::parse(content, {});
+            REQUIRE(patches.has_value());
+            CHECK_EQ(patches->patches.size(), 2);
+            CHECK_EQ(patches->latest, "h2");
+            CHECK_EQ(content.substr(patches->next.offset, 6), R"({"late)");
+
+            SUBCASE("Tail of the file")
+            {
+                const auto tail = jlap::parse(content.substr(patches->next.offset), patches->next);
+                REQUIRE(tail.has_value());
+                CHECK(tail->patches.empty());
+                CHECK_EQ(tail->latest, "h2");
+                CHECK_EQ(tail->next.offset, patches->next.offset);
+                CHECK_EQ(tail->next.iv, patches->next.iv);
+            }
+
+            SUBCASE("Tail with wrong hash")
+            {
+                auto wrong = patches->next;
+                wrong.iv = hex_string(jlap::digest{});
+                CHECK_FALSE(jlap::parse(content.substr(patches->next.offset), wrong).has_value());
+            }
+        }
+
+        SUBCASE("Corrupted file")
+        {
+            auto corrupted = content;
+            corrupted.replace(corrupted.find("h1"), 2, "h9");
+            CHECK_FALSE(jlap::parse(corrupted, {}).has_value());
+        }
+
+        SUBCASE("Truncated file")
+        {
+            CHECK_FALSE(jlap::parse(content.substr(0, 64), {}).has_value());
+        }
+    }
+
+    TEST_CASE("patch_to_latest")
+    {
+        const auto content = make_jlap(
+            {
+                make_patch("h0", "h1", "a"),
+                make_patch("h1", "h2", "b"),
+                make_patch("h2", "h3", "c"),
+            },
+            "h3"
+        );
+        const auto patches = jlap::parse(content, {}).value();
+
+        SUBCASE("From older version")
+        {
+            const auto patch = jlap::patch_to_latest(patches, "h1");
+            REQUIRE(patch.has_value());
+            REQUIRE_EQ(patch->size(), 2);
+            CHECK_EQ((*patch)[0]["path"], "/packages/b");
+            CHECK_EQ((*patch)[1]["path"], "/packages/c");
+        }
+
+        SUBCASE("From latest")
+        {
+            const auto patch = jlap::patch_to_latest(patches, "h3");
+            REQUIRE(patch.has_value());
+            CHECK(patch->empty());
+        }
+
+        SUBCASE("From unknown version")
+        {
+            CHECK_FALSE(jlap::patch_to_latest(patches, "other").has_value());
+        }
+    }
+}
@@ -321,6 +321,54 @@ namespace mamba
                 }
                 CHECK_FALSE(is_locked);
             }
+
+            TEST_CASE_FIXTURE(LockFileTest, "shared")
+            {
+#ifndef _WIN32
+                const std::string lock_exe = testing_libmamba_lock_exe.string();
+                auto lock_from_other_process = [&](bool shared)
+                {
+                    auto args = std::vector<std::string>{ lock_exe, "lock", "--timeout=1" };
+                    if (shared)
+                    {
+                        args.push_back("--shared");
+                    }
+                    args.push_back(tempfile_path.string());
+                    std::string out, err;
+                    reproc::run(
+                        args,
+                        reproc::options{},
+                        reproc::sink::string(out),
+                        reproc::sink::string(err)
+                    );
+                    return out == "1";
+                };
+
+                {
+                    auto lock = LockFile(tempfile_path, LockMode::shared);
+                    CHECK(lock.is_locked());
+                    CHECK_EQ(lock.mode(), LockMode::shared);
+
+                    // Other readers are not excluded, writers are
+                    CHECK(lock_from_other_process(true));
+                    CHECK_FALSE(lock_from_other_process(false));
+
+                    {
+                        // Upgraded until released
+                        auto write_lock = LockFile(tempfile_path);
+                        CHECK_EQ(write_lock.count_lock_owners(), 2);
+                        CHECK_EQ(lock.mode(), LockMode::exclusive);
+                    }
+                    CHECK_EQ(lock.mode(), LockMode::exclusive);
+                    CHECK_FALSE(lock_from_other_process(true));
+                }
+
+                // Other readers may still wait on the lock-file
+                const fs::u8path lock_path = tempfile_path.string() + ".lock";
+                CHECK(fs::exists(lock_path));
+                fs::remove(lock_path);
+#endif
+            }
         }
     }
 }
@@ -0,0 +1,71 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <doctest/doctest.h>
+
+#include "mamba/core/memory_budget.hpp"
+
+using namespace mamba;
+
+TEST_SUITE("memory_budget")
+{
+    TEST_CASE("Reservations fit in the limit")
+    {
+        auto budget = MemoryBudget(100);
+        {
+            auto first = budget.try_reserve(60);
+            REQUIRE(first.has_value());
+            CHECK_EQ(budget.reserved(), 60);
+            CHECK_FALSE(budget.try_reserve(50).has_value());
+            {
+                auto second = budget.try_reserve(40);
+                CHECK(second.has_value());
+                CHECK_EQ(budget.reserved(), 100);
+            }
+            CHECK_EQ(budget.reserved(), 60);
+
+            auto moved = std::move(first).value();
+            CHECK_EQ(moved.size(), 60);
+            moved.release();
+            CHECK_EQ(budget.reserved(), 0);
+        }
+        CHECK_EQ(budget.reserved(), 0);
+
+        // Too large to ever fit, but granted alone when waiting
+        CHECK_FALSE(budget.try_reserve(200).has_value());
+        {
+            auto large = budget.reserve(200);
+            CHECK_EQ(budget.reserved(), 200);
+        }
+
+        budget.set_limit(0);
+        CHECK(budget.try_reserve(1000).has_value());
+    }
+
+    TEST_CASE("Waiting reservations are granted once released")
+    {
+        auto budget = MemoryBudget(100);
+        auto first = budget.reserve(80);
+        std::atomic<bool> granted = false;
+        auto waiting = std::thread(
+            [&]()
+            {
+                auto second = budget.reserve(50);
+                granted = true;
+            }
+        );
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK_FALSE(granted);
+        first.release();
+        waiting.join();
+        CHECK(granted);
+        CHECK_EQ(budget.reserved(), 0);
+    }
+}
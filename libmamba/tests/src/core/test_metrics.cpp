@@ -0,0 +1,82 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "mamba/core/metrics.hpp"
+
+using namespace mamba;
+
+TEST_SUITE("metrics")
+{
+    TEST_CASE("MetricCounter")
+    {
+        auto counter = MetricCounter();
+        auto threads = std::vector<std::thread>();
+        for (int i = 0; i < 4; ++i)
+        {
+            threads.emplace_back(
+                [&counter]()
+                {
+                    for (int j = 0; j < 1000; ++j)
+                    {
+                        counter.add();
+                    }
+                }
+            );
+        }
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        counter.add(0.5);
+        CHECK_EQ(counter.value(), 4000.5);
+    }
+
+    TEST_CASE("MetricHistogram")
+    {
+        auto histogram = MetricHistogram({ 1, 0.1, 10 });
+        histogram.observe(0.05);
+        histogram.observe(0.1);
+        histogram.observe(5);
+        histogram.observe(100);
+
+        const auto snapshot = histogram.snapshot();
+        CHECK(snapshot.bounds == std::vector<double>{ 0.1, 1, 10 });
+        CHECK(snapshot.cumulative_counts == std::vector<std::size_t>{ 2, 2, 3 });
+        CHECK_EQ(snapshot.count, 4);
+        CHECK_EQ(snapshot.sum, doctest::Approx(105.15));
+    }
+
+    TEST_CASE("Metrics")
+    {
+        auto metrics = Metrics();
+        auto& downloads = metrics.counter("mamba_downloads_total", "Downloads");
+        downloads.add(2);
+        CHECK_EQ(&metrics.counter("mamba_downloads_total", "Other help"), &downloads);
+        metrics.histogram("mamba_solve_seconds", "Solve time", { 0.5, 1 }).observe(0.75);
+
+        CHECK_THROWS_AS(metrics.histogram("mamba_downloads_total", ""), std::invalid_argument);
+        CHECK_THROWS_AS(metrics.counter("mamba_solve_seconds", ""), std::invalid_argument);
+
+        const std::string expected = "# HELP mamba_downloads_total Downloads\n"
+                                     "# TYPE mamba_downloads_total counter\n"
+                                     "mamba_downloads_total 2\n"
+                                     "# HELP mamba_solve_seconds Solve time\n"
+                                     "# TYPE mamba_solve_seconds histogram\n"
+                                     "mamba_solve_seconds_bucket{le=\"0.5\"} 0\n"
+                                     "mamba_solve_seconds_bucket{le=\"1\"} 1\n"
+                                     "mamba_solve_seconds_bucket{le=\"+Inf\"} 1\n"
+                                     "mamba_solve_seconds_sum 0.75\n"
+                                     "mamba_solve_seconds_count 1\n";
+        CHECK_EQ(metrics.to_prometheus(), expected);
+    }
+}
@@ -4,10 +4,15 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <sstream>
+#include <vector>
+
 #include <doctest/doctest.h>
+#include <spdlog/spdlog.h>
 
 #include "mamba/core/context.hpp"
 #include "mamba/core/output.hpp"
+#include "mamba/core/util.hpp"
 
 namespace mamba
 {
@@ -25,5 +30,93 @@ namespace mamba
             CHECK(proxy.defined());
             CHECK(proxy);
         }
+
+        TEST_CASE("disabled_log_level")
+        {
+            auto& ctx = Context::instance();
+            const auto level = ctx.output_params.logging_level;
+            ctx.set_log_level(log_level::err);
+            spdlog::disable_backtrace();
+
+            int evaluated = 0;
+            auto arg = [&evaluated] { return ++evaluated; };
+            CHECK_FALSE(MessageLogger::enabled(log_level::debug));
+            LOG_DEBUG << "not formatted " << arg();
+            CHECK_EQ(evaluated, 0);
+
+            CHECK(MessageLogger::enabled(log_level::critical));
+            ctx.set_log_level(log_level::off);
+            CHECK_FALSE(MessageLogger::enabled(log_level::critical));
+
+            // Messages below the level are kept in the backtrace
+            ctx.set_log_level(log_level::err);
+            spdlog::enable_backtrace(1);
+            CHECK(MessageLogger::enabled(log_level::warn));
+            spdlog::disable_backtrace();
+            ctx.set_log_level(level);
+        }
+
+        TEST_CASE("JsonArrayWriter")
+        {
+            const auto elements = std::vector<nlohmann::json>{
+                { { "name", "a" }, { "depends", { "b", "c >=1" } } },
+                "line\nbreak",
+                42,
+                nlohmann::json::object(),
+            };
+
+            for (const std::size_t buffer_size : { 1, 16, 4096 })
+            {
+                CAPTURE(buffer_size);
+                auto out = std::ostringstream();
+                {
+                    auto writer = JsonArrayWriter(out, 0, buffer_size);
+                    for (const auto& element : elements)
+                    {
+                        writer.append(element);
+                    }
+                    writer.finish();
+                }
+                CHECK_EQ(out.str(), nlohmann::json(elements).dump(4));
+            }
+
+            // Nested in a document, with the indentation of its level
+            auto out = std::ostringstream();
+            out << "{\n    \"pkgs\": ";
+            auto writer = JsonArrayWriter(out, 1);
+            writer.append({ { "name", "a" } });
+            writer.finish();
+            out << "\n}";
+            const auto document = nlohmann::json{ { "pkgs", { { { "name", "a" } } } } };
+            CHECK_EQ(out.str(), document.dump(4));
+
+            auto empty = std::ostringstream();
+            JsonArrayWriter(empty).finish();
+            CHECK_EQ(empty.str(), "[]");
+        }
+
+        TEST_CASE("progress_events")
+        {
+            auto& ctx = Context::instance();
+            auto tmp_dir = TemporaryDirectory();
+            const auto events = tmp_dir.path() / "events.jsonl";
+
+            // Nothing is written without a sink
+            Console::instance().progress_event({ { "event", "ignored" } });
+
+            ctx.output_params.progress_events = events.string();
+            Console::instance().progress_event({ { "event", "downloaded" }, { "size", 10 } });
+            Console::instance().progress_event({ { "event", "extracted" } });
+            ctx.output_params.progress_events.clear();
+
+            auto in = open_ifstream(events);
+            std::string line;
+            REQUIRE(std::getline(in, line));
+            CHECK_EQ(nlohmann::json::parse(line)["event"], "downloaded");
+            CHECK_EQ(nlohmann::json::parse(line)["size"], 10);
+            REQUIRE(std::getline(in, line));
+            CHECK_EQ(nlohmann::json::parse(line)["event"], "extracted");
+            CHECK_FALSE(std::getline(in, line));
+        }
     }
 }  // namespace mamba
@@ -0,0 +1,109 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/package_cache.hpp"
+#include "mamba/core/package_info.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/validate.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto md5_of(const std::string& content) -> std::string
+    {
+        auto hash = validation::HashStream::md5();
+        hash.update(content.data(), content.size());
+        return hash.hex_digest();
+    }
+
+    auto mkpkg(const std::string& name) -> PackageInfo
+    {
+        auto pkg = PackageInfo(std::string(name));
+        pkg.fn = name + "-1.0-h0_0.tar.bz2";
+        pkg.url = "https://conda.anaconda.org/conda-forge/linux-64/" + pkg.fn;
+        pkg.md5 = md5_of(name);
+        pkg.size = name.size();
+        return pkg;
+    }
+
+    void add_tarball(const fs::u8path& cache, const PackageInfo& pkg)
+    {
+        open_ofstream(cache / pkg.fn) << pkg.name;
+    }
+
+    void add_extracted_dir(const fs::u8path& cache, const PackageInfo& pkg)
+    {
+        const auto info = cache / strip_package_extension(pkg.fn) / "info";
+        fs::create_directories(info);
+        open_ofstream(info / "paths.json") << R"({"paths": [], "paths_version": 1})";
+        const auto record = nlohmann::json{
+            { "md5", pkg.md5 },
+            { "size", pkg.size },
+            { "url", pkg.url },
+        };
+        open_ofstream(info / "repodata_record.json") << record.dump();
+    }
+}
+
+TEST_SUITE("package_cache")
+{
+    TEST_CASE("MultiPackageCache::validate")
+    {
+        const auto first = TemporaryDirectory();
+        const auto second = TemporaryDirectory();
+        const auto extracted = mkpkg("extracted");
+        const auto tarball = mkpkg("tarball");
+        const auto both = mkpkg("both");
+        const auto missing = mkpkg("missing");
+        add_extracted_dir(second.path(), extracted);
+        add_tarball(first.path(), tarball);
+        add_tarball(first.path(), both);
+        add_extracted_dir(second.path(), both);
+
+        auto caches = MultiPackageCache({ first.path(), second.path() });
+        caches.validate({ extracted, tarball, both, missing }, 4);
+
+        // Results are reused, even though the caches changed since
+        fs::remove_all(first.path() / tarball.fn);
+        fs::remove_all(second.path() / strip_package_extension(extracted.fn));
+        add_tarball(first.path(), missing);
+
+        CHECK_EQ(caches.get_extracted_dir_path(extracted), second.path());
+        CHECK_EQ(caches.get_extracted_dir_path(tarball), fs::u8path());
+        CHECK_EQ(caches.get_tarball_path(tarball), first.path());
+        CHECK_EQ(caches.get_extracted_dir_path(both), second.path());
+        CHECK_EQ(caches.get_tarball_path(missing), fs::u8path());
+
+        caches.clear_query_cache(missing);
+        CHECK_EQ(caches.get_tarball_path(missing), first.path());
+    }
+
+    TEST_CASE("lock_package_entry")
+    {
+        const auto cache = TemporaryDirectory();
+        const auto pkg = mkpkg("locked");
+        {
+            const auto shared = lock_package_entry(cache.path(), pkg.fn, LockMode::shared);
+            REQUIRE(shared.has_value());
+            CHECK_EQ(shared->mode(), LockMode::shared);
+            CHECK(fs::exists(cache.path() / ".locks" / strip_package_extension(pkg.fn)));
+
+            // Writers of the same process upgrade the lock of the readers
+            const auto exclusive = lock_package_entry(cache.path(), pkg.fn, LockMode::exclusive);
+            REQUIRE(exclusive.has_value());
+            CHECK_EQ(exclusive->mode(), LockMode::exclusive);
+        }
+        // No extracted directory is created for the lock
+        CHECK_FALSE(fs::exists(cache.path() / strip_package_extension(pkg.fn)));
+    }
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "mamba/core/fsutil.hpp"
+#include "mamba/core/util.hpp"
+
+#include "core/package_cache_eviction.hpp"
+#include "core/package_cache_ledger.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    void write_file(const fs::u8path& path, std::size_t size)
+    {
+        fs::create_directories(path.parent_path());
+        auto out = open_ofstream(path);
+        out << std::string(size, 'x');
+    }
+
+    /** A package with a tarball and an extracted directory, using ``size`` bytes. */
+    void add_package(const fs::u8path& pkgs_dir, const std::string& name, std::size_t size)
+    {
+        write_file(pkgs_dir / (name + ".tar.bz2"), size / 2);
+        write_file(pkgs_dir / name / "info" / "index.json", size - size / 2);
+    }
+
+    auto names(const std::vector<CachedPackage>& packages) -> std::vector<std::string>
+    {
+        auto out = std::vector<std::string>();
+        for (const auto& pkg : packages)
+        {
+            out.push_back(pkg.name);
+        }
+        return out;
+    }
+}
+
+TEST_SUITE("package_cache_eviction")
+{
+    TEST_CASE("Least recently used packages are evicted")
+    {
+        const auto dir = TemporaryDirectory();
+        add_package(dir.path(), "foo-1.0-h0_0", 100);
+        add_package(dir.path(), "bar-1.0-h0_0", 200);
+        add_package(dir.path(), "baz-1.0-h0_0", 300);
+        write_file(dir.path() / "cache" / "repodata.json", 1000);
+
+        auto ledger = PackageCacheLedger(dir.path());
+        ledger.record_access({ "bar-1.0-h0_0" });
+
+        // Packages never used default to when they were written, before the recorded access
+        auto set_write_time = [&](const std::string& name, std::chrono::hours age)
+        {
+            const auto time = fs::file_time_type::clock::now() - age;
+            fs::last_write_time(dir.path() / name, time);
+            fs::last_write_time(dir.path() / (name + ".tar.bz2"), time);
+        };
+        set_write_time("foo-1.0-h0_0", std::chrono::hours(1));
+        set_write_time("baz-1.0-h0_0", std::chrono::hours(2));
+
+        const auto packages = list_cached_packages(dir.path());
+        CHECK_EQ(
+            names(packages),
+            std::vector<std::string>{ "baz-1.0-h0_0", "foo-1.0-h0_0", "bar-1.0-h0_0" }
+        );
+        CHECK_EQ(packages[0].size, 300);
+        CHECK_EQ(packages[0].paths.size(), 2);
+
+        const auto no_usage = std::map<std::string, std::set<fs::u8path>>();
+        CHECK(select_evicted_packages(packages, 600, no_usage).empty());
+        CHECK_EQ(
+            names(select_evicted_packages(packages, 500, no_usage)),
+            std::vector<std::string>{ "baz-1.0-h0_0" }
+        );
+        CHECK_EQ(
+            names(select_evicted_packages(packages, 200, no_usage)),
+            std::vector<std::string>{ "baz-1.0-h0_0", "foo-1.0-h0_0" }
+        );
+
+        // Installed packages are kept, even if the cache stays too large
+        const auto usage = std::map<std::string, std::set<fs::u8path>>{
+            { "baz-1.0-h0_0", { dir.path() / "env" } },
+        };
+        CHECK_EQ(
+            names(select_evicted_packages(packages, 0, usage)),
+            std::vector<std::string>{ "foo-1.0-h0_0", "bar-1.0-h0_0" }
+        );
+    }
+}
@@ -0,0 +1,162 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+
+#include <doctest/doctest.h>
+
+#include "mamba/core/context.hpp"
+#include "mamba/core/package_cache.hpp"
+#include "mamba/core/package_info.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/validate.hpp"
+
+#include "core/package_cache_ledger.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    void write_file(const fs::u8path& path, const std::string& content)
+    {
+        auto out = open_ofstream(path);
+        out << content;
+    }
+
+    auto count_lines(const fs::u8path& path) -> std::size_t
+    {
+        auto in = open_ifstream(path);
+        std::size_t n = 0;
+        for (std::string line; std::getline(in, line);)
+        {
+            ++n;
+        }
+        return n;
+    }
+}
+
+TEST_SUITE("package_cache_ledger")
+{
+    TEST_CASE("record and find")
+    {
+        const auto dir = TemporaryDirectory();
+        const auto tarball = dir.path() / "foo-1.0-h0_0.tar.bz2";
+        write_file(tarball, "foo");
+
+        auto ledger = PackageCacheLedger(dir.path());
+        CHECK_FALSE(ledger.find("foo-1.0-h0_0.tar.bz2").has_value());
+        ledger.record("foo-1.0-h0_0.tar.bz2", "md5", "");
+        ledger.record("missing-1.0-h0_0.tar.bz2", "md5", "");
+        CHECK_FALSE(ledger.find("missing-1.0-h0_0.tar.bz2").has_value());
+
+        SUBCASE("Entries are read by other ledgers")
+        {
+            auto other = PackageCacheLedger(dir.path());
+            const auto entry = other.find("foo-1.0-h0_0.tar.bz2");
+            REQUIRE(entry.has_value());
+            CHECK_EQ(entry->md5, "md5");
+            CHECK_EQ(entry->sha256, "");
+            CHECK_EQ(entry->size, 3);
+        }
+
+        SUBCASE("Checksums are completed")
+        {
+            ledger.record("foo-1.0-h0_0.tar.bz2", "", "sha256");
+            auto other = PackageCacheLedger(dir.path());
+            const auto entry = other.find("foo-1.0-h0_0.tar.bz2");
+            REQUIRE(entry.has_value());
+            CHECK_EQ(entry->md5, "md5");
+            CHECK_EQ(entry->sha256, "sha256");
+        }
+
+        SUBCASE("Changed tarballs are not trusted")
+        {
+            write_file(tarball, "foobar");
+            CHECK_FALSE(ledger.find("foo-1.0-h0_0.tar.bz2").has_value());
+            CHECK_FALSE(PackageCacheLedger(dir.path()).find("foo-1.0-h0_0.tar.bz2").has_value());
+        }
+
+        SUBCASE("Invalid lines are skipped")
+        {
+            open_ofstream(dir.path() / PACKAGE_CACHE_LEDGER_FILE, std::ios::app) << "{\"fn\": ";
+            auto other = PackageCacheLedger(dir.path());
+            const auto entry = other.find("foo-1.0-h0_0.tar.bz2");
+            REQUIRE(entry.has_value());
+            CHECK_EQ(entry->md5, "md5");
+        }
+    }
+
+    TEST_CASE("Stale entries are compacted")
+    {
+        const auto dir = TemporaryDirectory();
+        const auto tarball = dir.path() / "foo-1.0-h0_0.tar.bz2";
+        write_file(tarball, "foo");
+
+        auto ledger = PackageCacheLedger(dir.path());
+        for (int i = 0; i < 100; ++i)
+        {
+            ledger.record("foo-1.0-h0_0.tar.bz2", std::to_string(i), "");
+        }
+        const auto ledger_file = dir.path() / PACKAGE_CACHE_LEDGER_FILE;
+        CHECK_EQ(count_lines(ledger_file), 100);
+
+        auto other = PackageCacheLedger(dir.path());
+        const auto entry = other.find("foo-1.0-h0_0.tar.bz2");
+        REQUIRE(entry.has_value());
+        CHECK_EQ(entry->md5, "99");
+        CHECK_EQ(count_lines(ledger_file), 1);
+    }
+
+    TEST_CASE("Package accesses")
+    {
+        const auto dir = TemporaryDirectory();
+        write_file(dir.path() / "foo-1.0-h0_0.tar.bz2", "foo");
+        write_file(dir.path() / "bar-1.0-h0_0.conda", "bar");
+        const auto ledger_file = dir.path() / PACKAGE_CACHE_LEDGER_FILE;
+
+        auto ledger = PackageCacheLedger(dir.path());
+        CHECK_FALSE(ledger.last_access("foo-1.0-h0_0").has_value());
+        for (int i = 0; i < 100; ++i)
+        {
+            ledger.record_access({ "foo-1.0-h0_0", "bar-1.0-h0_0", "removed-1.0-h0_0" });
+        }
+        const auto accessed = ledger.last_access("foo-1.0-h0_0");
+        REQUIRE(accessed.has_value());
+        CHECK_EQ(count_lines(ledger_file), 300);
+
+        // Accesses are compacted with the checksums, keeping the packages still in the cache
+        auto other = PackageCacheLedger(dir.path());
+        CHECK_EQ(other.last_access("foo-1.0-h0_0"), accessed);
+        CHECK(other.last_access("bar-1.0-h0_0").has_value());
+        CHECK_FALSE(other.last_access("removed-1.0-h0_0").has_value());
+        CHECK_EQ(count_lines(ledger_file), 2);
+    }
+
+    TEST_CASE("PackageCacheData uses the ledger")
+    {
+        auto& ctx = Context::instance();
+        const auto dir = TemporaryDirectory();
+        auto pkg = PackageInfo(std::string("foo"));
+        pkg.fn = "foo-1.0-h0_0.tar.bz2";
+        write_file(dir.path() / pkg.fn, "foo");
+        pkg.md5 = validation::md5sum(dir.path() / pkg.fn);
+
+        CHECK(PackageCacheData(dir.path()).has_valid_tarball(pkg));
+        auto ledger = PackageCacheLedger(dir.path());
+        const auto entry = ledger.find(pkg.fn);
+        REQUIRE(entry.has_value());
+        CHECK_EQ(entry->md5, pkg.md5);
+
+        // A tarball that did not change is trusted without computing its checksum
+        ledger.record(pkg.fn, "forged", "");
+        CHECK_FALSE(PackageCacheData(dir.path()).has_valid_tarball(pkg));
+
+        ctx.verify_package_cache = true;
+        CHECK(PackageCacheData(dir.path()).has_valid_tarball(pkg));
+        ctx.verify_package_cache = false;
+        CHECK(PackageCacheData(dir.path()).has_valid_tarball(pkg));
+    }
+}
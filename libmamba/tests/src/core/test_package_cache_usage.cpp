@@ -0,0 +1,97 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <chrono>
+#include <set>
+#include <string>
+
+#include <doctest/doctest.h>
+
+#include "mamba/core/fsutil.hpp"
+#include "mamba/core/util.hpp"
+
+#include "core/package_cache_usage.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    void install(const fs::u8path& prefix, const std::string& pkg)
+    {
+        path::touch(prefix / "conda-meta" / (pkg + ".json"), true);
+    }
+
+    const auto old_time = fs::file_time_type::clock::now() - std::chrono::hours(1);
+
+    /** Set an old modification time, so that the environment can be trusted from the index. */
+    void set_old_mtime(const fs::u8path& prefix)
+    {
+        fs::last_write_time(prefix / "conda-meta", old_time);
+    }
+}
+
+TEST_SUITE("package_cache_usage")
+{
+    TEST_CASE("Environments using packages")
+    {
+        const auto tmp_dir = TemporaryDirectory();
+        const auto pkgs_dir = tmp_dir.path() / "pkgs";
+        const auto env1 = tmp_dir.path() / "env1";
+        const auto env2 = tmp_dir.path() / "env2";
+        fs::create_directories(pkgs_dir);
+        install(env1, "foo-1.0-h0_0");
+        install(env1, "bar-2.0-h0_0");
+        install(env2, "foo-1.0-h0_0");
+        set_old_mtime(env1);
+        set_old_mtime(env2);
+
+        auto usage = PackageCacheUsage(pkgs_dir);
+        const auto envs = std::vector<fs::u8path>{ env1, env2, tmp_dir.path() / "not_an_env" };
+        const auto expected = std::map<std::string, std::set<fs::u8path>>{
+            { "bar-2.0-h0_0", { env1 } },
+            { "foo-1.0-h0_0", { env1, env2 } },
+        };
+        CHECK_EQ(usage.usage(envs), expected);
+        CHECK(fs::exists(pkgs_dir / PACKAGE_CACHE_USAGE_FILE));
+
+        SUBCASE("Unchanged environments are read from the index")
+        {
+            // Not visible in conda-meta modification time
+            fs::remove(env2 / "conda-meta" / "foo-1.0-h0_0.json");
+            set_old_mtime(env2);
+            CHECK_EQ(PackageCacheUsage(pkgs_dir).usage(envs), expected);
+        }
+
+        SUBCASE("Changed environments are listed again")
+        {
+            install(env2, "baz-3.0-h0_0");
+            auto changed = PackageCacheUsage(pkgs_dir).usage(envs);
+            CHECK_EQ(changed["baz-3.0-h0_0"], std::set<fs::u8path>{ env2 });
+        }
+
+        SUBCASE("Recorded environments are read from the index")
+        {
+            install(env2, "baz-3.0-h0_0");
+            set_old_mtime(env2);
+            usage.record(env2);
+            fs::remove(env2 / "conda-meta" / "baz-3.0-h0_0.json");
+            set_old_mtime(env2);
+            auto recorded = PackageCacheUsage(pkgs_dir).usage(envs);
+            CHECK_EQ(recorded["baz-3.0-h0_0"], std::set<fs::u8path>{ env2 });
+        }
+
+        SUBCASE("Invalid indexes are ignored")
+        {
+            open_ofstream(pkgs_dir / PACKAGE_CACHE_USAGE_FILE) << "not json";
+            CHECK_EQ(PackageCacheUsage(pkgs_dir).usage(envs), expected);
+        }
+
+        SUBCASE("Without a package cache environments are listed")
+        {
+            CHECK_EQ(PackageCacheUsage(fs::u8path()).usage(envs), expected);
+        }
+    }
+}
@@ -0,0 +1,342 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/context.hpp"
+#include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/package_handling.hpp"
+#include "mamba/core/package_paths.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/util_scope.hpp"
+#include "mamba/core/validate.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto read_file(const fs::u8path& path) -> std::string
+    {
+        auto in = open_ifstream(path);
+        return { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+    }
+}
+
+TEST_SUITE("package_handling")
+{
+    TEST_CASE("extract")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto pkg_dir = tmp_dir.path() / "pkg";
+        fs::create_directories(pkg_dir / "info");
+        fs::create_directories(pkg_dir / "lib");
+        open_ofstream(pkg_dir / "info" / "index.json") << R"({"name": "a"})";
+        open_ofstream(pkg_dir / "lib" / "a.txt") << "content";
+        // Large enough for the .conda inner archive to be decompressed on its own thread
+        auto random = std::string(3 << 20, '\0');
+        auto engine = std::minstd_rand();
+        std::generate(random.begin(), random.end(), [&engine]() { return char(engine()); });
+        open_ofstream(pkg_dir / "lib" / "random.bin") << random;
+#ifndef _WIN32
+        fs::create_symlink("a.txt", pkg_dir / "lib" / "link.txt");
+#endif
+
+        for (const std::string ext : { ".tar.bz2", ".conda" })
+        {
+            CAPTURE(ext);
+            const auto pkg_file = tmp_dir.path() / ("a-1.0-0" + ext);
+            create_package(pkg_dir, pkg_file, 1, 1);
+            REQUIRE(fs::exists(pkg_file));
+
+            const auto cwd = fs::current_path();
+            auto workers = std::vector<std::thread>();
+            auto dests = std::vector<fs::u8path>();
+            for (std::size_t i = 0; i < 4; ++i)
+            {
+                dests.push_back(tmp_dir.path() / ("out" + std::to_string(i) + ext));
+            }
+            for (const auto& dest : dests)
+            {
+                workers.emplace_back([&pkg_file, dest]() { extract(pkg_file, dest); });
+            }
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+            CHECK_EQ(fs::current_path(), cwd);
+
+            for (const auto& dest : dests)
+            {
+                CHECK_EQ(read_file(dest / "lib" / "a.txt"), "content");
+                CHECK(read_file(dest / "lib" / "random.bin") == random);
+                CHECK(fs::exists(dest / "info" / "index.json"));
+#ifndef _WIN32
+                CHECK(fs::is_symlink(dest / "lib" / "link.txt"));
+#endif
+            }
+        }
+    }
+
+    TEST_CASE("extract_all")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto pkg_dir = tmp_dir.path() / "pkg";
+        fs::create_directories(pkg_dir / "info");
+        open_ofstream(pkg_dir / "info" / "index.json") << R"({"name": "a"})";
+
+        auto files = std::vector<fs::u8path>();
+        for (const std::string name : { "a-1.0-0.tar.bz2", "b-1.0-0.conda", "c-1.0-0.tar.bz2" })
+        {
+            files.push_back(tmp_dir.path() / name);
+            create_package(pkg_dir, files.back(), 1, 1);
+        }
+
+        auto extracted = std::vector<std::size_t>();
+        const auto dirs = extract_all(files, 2, [&](std::size_t i) { extracted.push_back(i); });
+        std::sort(extracted.begin(), extracted.end());
+        const auto all = std::vector<std::size_t>{ 0, 1, 2 };
+        CHECK_EQ(extracted, all);
+        REQUIRE_EQ(dirs.size(), 3);
+        CHECK_EQ(dirs[0], tmp_dir.path() / "a-1.0-0");
+        CHECK_EQ(dirs[1], tmp_dir.path() / "b-1.0-0");
+        for (const auto& dir : dirs)
+        {
+            CHECK(fs::exists(dir / "info" / "index.json"));
+        }
+
+        files.push_back(tmp_dir.path() / "missing-1.0-0.conda");
+        CHECK_THROWS(extract_all(files, 2));
+    }
+
+    TEST_CASE("extract_exclude")
+    {
+        CHECK(is_excluded_path({ "include/**" }, "include/a/b.h"));
+        CHECK(is_excluded_path({ "lib/*.so", "**/*.a" }, "lib/sub/a.a"));
+        CHECK_FALSE(is_excluded_path({ "lib/*.so" }, "lib/sub/a.so"));
+        CHECK_FALSE(is_excluded_path({ "**" }, "info/index.json"));
+        CHECK_FALSE(is_excluded_path({}, "lib/a.a"));
+
+        auto tmp_dir = TemporaryDirectory();
+        const auto pkg_dir = tmp_dir.path() / "pkg";
+        fs::create_directories(pkg_dir / "info");
+        fs::create_directories(pkg_dir / "include");
+        fs::create_directories(pkg_dir / "lib");
+        open_ofstream(pkg_dir / "info" / "index.json") << R"({"name": "a"})";
+        open_ofstream(pkg_dir / "include" / "a.h") << "header";
+        open_ofstream(pkg_dir / "lib" / "a.a") << "static";
+        open_ofstream(pkg_dir / "lib" / "a.so") << "shared";
+
+        const auto exclude = std::vector<std::string>{ "include/**", "**/*.a" };
+        for (const std::string ext : { ".tar.bz2", ".conda" })
+        {
+            CAPTURE(ext);
+            const auto pkg_file = tmp_dir.path() / ("a-1.0-0" + ext);
+            create_package(pkg_dir, pkg_file, 1, 1);
+            const auto dest = tmp_dir.path() / ("out" + ext);
+            extract(pkg_file, dest, exclude);
+
+            CHECK(fs::exists(dest / "info" / "index.json"));
+            CHECK(fs::exists(dest / "lib" / "a.so"));
+            CHECK_FALSE(fs::exists(dest / "lib" / "a.a"));
+            CHECK_FALSE(fs::exists(dest / "include" / "a.h"));
+            const auto excluded = std::set<std::string>{ "include/a.h", "lib/a.a" };
+            CHECK_EQ(read_excluded_paths(dest), excluded);
+
+            const auto full_dest = tmp_dir.path() / ("full" + ext);
+            extract(pkg_file, full_dest);
+            CHECK(fs::exists(full_dest / "lib" / "a.a"));
+            CHECK(read_excluded_paths(full_dest).empty());
+        }
+    }
+
+    TEST_CASE("transmute")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto pkg_dir = tmp_dir.path() / "pkg";
+        fs::create_directories(pkg_dir / "info");
+        fs::create_directories(pkg_dir / "lib");
+        open_ofstream(pkg_dir / "info" / "index.json") << R"({"name": "a"})";
+        open_ofstream(pkg_dir / "lib" / "a.txt") << "content";
+#ifndef _WIN32
+        fs::create_symlink("a.txt", pkg_dir / "lib" / "link.txt");
+#endif
+        const auto bz2_file = tmp_dir.path() / "a-1.0-0.tar.bz2";
+        create_package(pkg_dir, bz2_file, 1, 1);
+
+        auto packages = std::vector<std::pair<fs::u8path, fs::u8path>>{
+            { bz2_file, tmp_dir.path() / "a-1.0-0.conda" },
+            { tmp_dir.path() / "missing-1.0-0.tar.bz2", tmp_dir.path() / "missing-1.0-0.conda" },
+        };
+        const auto errors = transmute_packages(packages, -1, 0, 2);
+        REQUIRE_EQ(errors.size(), 1);
+        CHECK_NE(errors.front().find("missing-1.0-0.tar.bz2"), std::string::npos);
+
+        const auto back_file = tmp_dir.path() / "b-1.0-0.tar.bz2";
+        CHECK(transmute(tmp_dir.path() / "a-1.0-0.conda", back_file, -1, 0));
+
+        for (const auto& file : { tmp_dir.path() / "a-1.0-0.conda", back_file })
+        {
+            CAPTURE(file.string());
+            const auto dest = tmp_dir.path() / ("out-" + file.filename().string());
+            extract(file, dest);
+            CHECK_EQ(read_file(dest / "lib" / "a.txt"), "content");
+            CHECK(fs::exists(dest / "info" / "index.json"));
+#ifndef _WIN32
+            CHECK(fs::is_symlink(dest / "lib" / "link.txt"));
+#endif
+        }
+    }
+
+    TEST_CASE("CondaStreamExtractor")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto pkg_dir = tmp_dir.path() / "pkg";
+        fs::create_directories(pkg_dir / "info");
+        open_ofstream(pkg_dir / "info" / "index.json") << R"({"name": "a"})";
+        open_ofstream(pkg_dir / "a.txt") << std::string(100000, 'a');
+        const auto pkg_file = tmp_dir.path() / "a-1.0-0.conda";
+        create_package(pkg_dir, pkg_file, 1, 1);
+        const auto content = read_file(pkg_file);
+        const auto dest = tmp_dir.path() / "out";
+
+        SUBCASE("Extract while writing")
+        {
+            auto extractor = CondaStreamExtractor();
+            auto worker = std::thread([&]() { CHECK_NOTHROW(extractor.extract(dest)); });
+            for (std::size_t pos = 0; pos < content.size(); pos += 1000)
+            {
+                const auto size = std::min<std::size_t>(1000, content.size() - pos);
+                extractor.write(content.data() + pos, size);
+            }
+            extractor.close();
+            worker.join();
+            CHECK_EQ(read_file(dest / "a.txt"), std::string(100000, 'a'));
+            CHECK(fs::exists(dest / "info" / "index.json"));
+        }
+
+        SUBCASE("Aborted")
+        {
+            auto extractor = CondaStreamExtractor();
+            extractor.write(content.data(), content.size() / 2);
+            extractor.abort();
+            CHECK_FALSE(extractor.write(content.data(), 1));
+            CHECK_THROWS(extractor.extract(dest));
+        }
+
+        SUBCASE("Too much buffered")
+        {
+            auto extractor = CondaStreamExtractor(content.size() / 2);
+            CHECK(extractor.write(content.data(), content.size() / 2));
+            extractor.write(content.data() + content.size() / 2, content.size() / 2 + 1);
+            CHECK_FALSE(extractor.write(content.data(), 1));
+        }
+    }
+
+    TEST_CASE("validate")
+    {
+        auto& ctx = Context::instance();
+        const auto safety_checks = ctx.safety_checks;
+        const auto extra_safety_checks = ctx.extra_safety_checks;
+        const auto restore = on_scope_exit(
+            [&]
+            {
+                ctx.safety_checks = safety_checks;
+                ctx.extra_safety_checks = extra_safety_checks;
+            }
+        );
+        ctx.safety_checks = VerificationLevel::kEnabled;
+        ctx.extra_safety_checks = true;
+
+        auto tmp_dir = TemporaryDirectory();
+        const auto pkg_dir = tmp_dir.path() / "pkg";
+        fs::create_directories(pkg_dir / "info");
+        auto paths = nlohmann::json::array();
+        for (std::size_t i = 0; i < 64; ++i)
+        {
+            const auto name = "file_" + std::to_string(i) + ".txt";
+            const auto content = std::string(i + 1, 'a');
+            open_ofstream(pkg_dir / name) << content;
+            paths.push_back({
+                { "_path", name },
+                { "path_type", "hardlink" },
+                { "sha256", validation::sha256sum(pkg_dir / name) },
+                { "size_in_bytes", content.size() },
+            });
+        }
+        const auto paths_json = nlohmann::json{ { "paths", paths }, { "paths_version", 1 } };
+        open_ofstream(pkg_dir / "info" / "paths.json") << paths_json.dump();
+        CHECK(validate(pkg_dir));
+
+        // Same size, different content
+        open_ofstream(pkg_dir / "file_42.txt") << std::string(43, 'b');
+        CHECK_FALSE(validate(pkg_dir));
+        ctx.safety_checks = VerificationLevel::kWarn;
+        CHECK(validate(pkg_dir));
+
+        fs::remove(pkg_dir / "file_7.txt");
+        CHECK_FALSE(validate(pkg_dir));
+    }
+
+    TEST_CASE("extract_checks_hashes")
+    {
+        auto& ctx = Context::instance();
+        const auto safety_checks = ctx.safety_checks;
+        const auto extra_safety_checks = ctx.extra_safety_checks;
+        const auto restore = on_scope_exit(
+            [&]
+            {
+                ctx.safety_checks = safety_checks;
+                ctx.extra_safety_checks = extra_safety_checks;
+            }
+        );
+        ctx.safety_checks = VerificationLevel::kEnabled;
+        ctx.extra_safety_checks = true;
+
+        auto tmp_dir = TemporaryDirectory();
+        const auto pkg_dir = tmp_dir.path() / "pkg";
+        fs::create_directories(pkg_dir / "info");
+        fs::create_directories(pkg_dir / "lib");
+        open_ofstream(pkg_dir / "info" / "index.json") << R"({"name": "a"})";
+        open_ofstream(pkg_dir / "lib" / "a.txt") << "content";
+        auto paths = nlohmann::json::array();
+        paths.push_back({
+            { "_path", "lib/a.txt" },
+            { "path_type", "hardlink" },
+            { "sha256", validation::sha256sum(pkg_dir / "lib" / "a.txt") },
+            { "size_in_bytes", 7 },
+        });
+        auto paths_json = nlohmann::json{ { "paths", paths }, { "paths_version", 1 } };
+
+        for (const std::string ext : { ".tar.bz2", ".conda" })
+        {
+            CAPTURE(ext);
+            paths_json["paths"][0]["sha256"] = validation::sha256sum(pkg_dir / "lib" / "a.txt");
+            open_ofstream(pkg_dir / "info" / "paths.json") << paths_json.dump();
+            const auto good_file = tmp_dir.path() / ("good-1.0-0" + ext);
+            create_package(pkg_dir, good_file, 1, 1);
+            CHECK_NOTHROW(extract(good_file, tmp_dir.path() / ("good" + ext)));
+
+            paths_json["paths"][0]["sha256"] = std::string(64, '0');
+            open_ofstream(pkg_dir / "info" / "paths.json") << paths_json.dump();
+            const auto bad_file = tmp_dir.path() / ("bad-1.0-0" + ext);
+            create_package(pkg_dir, bad_file, 1, 1);
+            CHECK_THROWS_AS(extract(bad_file, tmp_dir.path() / ("bad" + ext)), std::runtime_error);
+
+            ctx.safety_checks = VerificationLevel::kWarn;
+            CHECK_NOTHROW(extract(bad_file, tmp_dir.path() / ("bad_warn" + ext)));
+            ctx.safety_checks = VerificationLevel::kEnabled;
+        }
+    }
+}
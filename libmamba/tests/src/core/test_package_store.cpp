@@ -0,0 +1,88 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/util.hpp"
+#include "mamba/core/validate.hpp"
+
+#include "core/package_store.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    /** Write an extracted package with files given as path and content. */
+    void write_package(
+        const fs::u8path& extracted_dir,
+        const std::vector<std::pair<std::string, std::string>>& files
+    )
+    {
+        auto paths = nlohmann::json::array();
+        for (const auto& [path, content] : files)
+        {
+            const auto file = extracted_dir / path;
+            fs::create_directories(file.parent_path());
+            open_ofstream(file) << content;
+            paths.push_back({
+                { "_path", path },
+                { "path_type", "hardlink" },
+                { "sha256", validation::sha256sum(file) },
+                { "size_in_bytes", content.size() },
+            });
+        }
+        fs::create_directories(extracted_dir / "info");
+        open_ofstream(extracted_dir / "info" / "paths.json")
+            << nlohmann::json{ { "paths", paths }, { "paths_version", 1 } }.dump();
+    }
+}
+
+TEST_SUITE("package_store")
+{
+    TEST_CASE("Identical files are shared")
+    {
+        const auto pkgs_dir = TemporaryDirectory();
+        const auto foo = pkgs_dir.path() / "foo-1.0-h0_0";
+        const auto bar = pkgs_dir.path() / "bar-1.0-h0_0";
+        const auto license = std::string("Permission is hereby granted...");
+        write_package(foo, { { "LICENSE", license }, { "lib/foo.py", "foo" } });
+        write_package(bar, { { "LICENSE", license }, { "lib/bar.py", "bar" } });
+
+        auto store = PackageStore(pkgs_dir.path());
+        CHECK_EQ(store.deduplicate(foo), 0);
+        CHECK_EQ(store.deduplicate(bar), license.size());
+        CHECK_EQ(fs::hard_link_count(foo / "LICENSE"), 3);
+        CHECK_EQ(fs::hard_link_count(bar / "LICENSE"), 3);
+        CHECK_EQ(fs::hard_link_count(bar / "lib/bar.py"), 2);
+
+        // Deduplicating again does nothing
+        CHECK_EQ(store.deduplicate(bar), 0);
+
+        SUBCASE("Files not matching paths.json are not stored")
+        {
+            const auto baz = pkgs_dir.path() / "baz-1.0-h0_0";
+            write_package(baz, { { "LICENSE", license } });
+            open_ofstream(baz / "LICENSE") << "Modified";
+            CHECK_EQ(store.deduplicate(baz), 0);
+            CHECK_EQ(fs::hard_link_count(baz / "LICENSE"), 1);
+        }
+
+        SUBCASE("Unused files are pruned")
+        {
+            CHECK_EQ(store.prune(), 0);
+            fs::remove_all(bar);
+            CHECK_EQ(store.prune(), 3);
+            CHECK_EQ(fs::hard_link_count(foo / "LICENSE"), 2);
+            fs::remove_all(foo);
+            CHECK_EQ(store.prune(), license.size() + 3);
+        }
+    }
+}
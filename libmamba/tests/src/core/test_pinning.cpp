@@ -92,6 +92,26 @@ namespace mamba
                 CHECK_EQ(pin, "");
             }
 
+            TEST_CASE("python_pin from summaries")
+            {
+                ChannelContext channel_context;
+                auto summaries = std::vector<PrefixData::RecordSummary>(2);
+                summaries[0].name = "numpy";
+                summaries[0].version = "1.25.0";
+                CHECK_EQ(python_pin(summaries, { "numpy" }, channel_context), "");
+
+                summaries[1].name = "python";
+                summaries[1].version = "3.7.10";
+                CHECK_EQ(python_pin(summaries, { "numpy" }, channel_context), "python 3.7.*");
+                CHECK_EQ(python_pin(summaries, { "python-test" }, channel_context), "python 3.7.*");
+                CHECK_EQ(python_pin(summaries, { "python=3.8" }, channel_context), "");
+                CHECK_EQ(python_pin(summaries, { "numpy", "python" }, channel_context), "");
+
+                // Not a version that can be pinned
+                summaries[1].version = "3";
+                CHECK_EQ(python_pin(summaries, { "numpy" }, channel_context), "");
+            }
+
             TEST_CASE("file_pins")
             {
                 std::vector<std::string> pins;
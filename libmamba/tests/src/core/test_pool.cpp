@@ -0,0 +1,243 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <solv/solver.h>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/match_spec.hpp"
+#include "mamba/core/package_info.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/solver.hpp"
+#include "solv-cpp/pool.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto mkpkg(std::string name, std::vector<std::string> dependencies = {}) -> PackageInfo
+    {
+        auto pkg = PackageInfo(std::move(name));
+        pkg.version = "1.0";
+        pkg.build_string = "bld";
+        pkg.depends = std::move(dependencies);
+        return pkg;
+    }
+
+    auto count_solvables(MPool& pool, const std::string& spec) -> std::size_t
+    {
+        const auto ms = MatchSpec{ spec, pool.channel_context() };
+        return pool.select_solvables(pool.matchspec2id(ms)).size();
+    }
+}
+
+TEST_SUITE("pool")
+{
+    TEST_CASE("prune")
+    {
+        ChannelContext channel_context = {};
+        auto pool = MPool{ channel_context };
+        MRepo(
+            pool,
+            "some-name",
+            {
+                mkpkg("foo", { "bar >=1.0" }),
+                mkpkg("bar", { "baz" }),
+                mkpkg("baz"),
+                mkpkg("lib"),
+                mkpkg("unrelated", { "foo" }),
+            }
+        );
+        auto installed = MRepo(pool, "installed", { mkpkg("inst", { "lib" }) });
+        installed.set_installed();
+
+        pool.prune({ "foo" });
+        pool.create_whatprovides();
+
+        CHECK_EQ(count_solvables(pool, "foo"), 1);
+        CHECK_EQ(count_solvables(pool, "bar"), 1);
+        CHECK_EQ(count_solvables(pool, "baz"), 1);
+        CHECK_EQ(count_solvables(pool, "inst"), 1);
+        CHECK_EQ(count_solvables(pool, "lib"), 1);
+        // Depending on a requested package is not enough
+        CHECK_EQ(count_solvables(pool, "unrelated"), 0);
+
+        auto solver = MSolver(pool, {});
+        solver.add_jobs({ "foo" }, SOLVER_INSTALL);
+        CHECK(solver.try_solve());
+
+        SUBCASE("Prune again")
+        {
+            pool.prune({ "unrelated" });
+            pool.create_whatprovides();
+            CHECK_EQ(count_solvables(pool, "unrelated"), 1);
+            CHECK_EQ(count_solvables(pool, "baz"), 1);
+        }
+    }
+
+    TEST_CASE("id2pkgview")
+    {
+        ChannelContext channel_context = {};
+        auto pool = MPool{ channel_context };
+        auto pkg = mkpkg("foo", { "bar" });
+        pkg.build_number = 3;
+        pkg.subdir = "linux-64";
+        MRepo(pool, "some-name", { pkg });
+        pool.create_whatprovides();
+
+        const auto ids = pool.select_solvables(
+            pool.matchspec2id(MatchSpec{ "foo", pool.channel_context() })
+        );
+        REQUIRE_EQ(ids.size(), 1);
+
+        const auto view = pool.id2pkgview(ids.front());
+        REQUIRE(view.has_value());
+        CHECK_EQ(view->id, ids.front());
+        CHECK_EQ(view->name, "foo");
+        CHECK_EQ(view->version, "1.0");
+        CHECK_EQ(view->build_string, "bld");
+        CHECK_EQ(view->build_number, 3);
+        CHECK_EQ(view->subdir, "linux-64");
+        CHECK_EQ(view->spec(), "foo 1.0 bld");
+
+        const auto info = pool.id2pkginfo(ids.front());
+        REQUIRE(info.has_value());
+        CHECK_EQ(view->name, info->name);
+        CHECK_EQ(view->url, info->url);
+        CHECK_EQ(view->fn, info->fn);
+
+        CHECK_FALSE(pool.id2pkgview(0).has_value());
+    }
+
+    TEST_CASE("conda_dependency_id")
+    {
+        ChannelContext channel_context = {};
+        auto pool = MPool{ channel_context };
+        const auto id = pool.conda_dependency_id("python >=3.8");
+        CHECK_NE(id, 0);
+        CHECK_EQ(pool.conda_dependency_id("python >=3.8"), id);
+        CHECK_EQ(pool.dep2str(id), "python >=3.8");
+        CHECK_EQ(pool.matchspec2id(MatchSpec{ "python >=3.8", pool.channel_context() }), id);
+
+        // Dependencies of the packages added from records share the ids
+        MRepo(pool, "some-name", { mkpkg("foo", { "python >=3.8" }), mkpkg("bar", { "python" }) });
+        pool.create_whatprovides();
+        CHECK_EQ(count_solvables(pool, "foo"), 1);
+        CHECK_EQ(count_solvables(pool, "bar"), 1);
+        const auto ids = pool.select_solvables(pool.conda_dependency_id("foo"));
+        REQUIRE_EQ(ids.size(), 1);
+        const auto deps = pool.id2pkginfo(ids.front())->depends;
+        const auto expected = std::vector<std::string>{ "python >=3.8" };
+        CHECK_EQ(deps, expected);
+    }
+
+    TEST_CASE("solvable_columns")
+    {
+        ChannelContext channel_context = {};
+        auto pool = MPool{ channel_context };
+        auto foo = mkpkg("foo", { "bar >=1.0", "baz" });
+        foo.build_number = 3;
+        MRepo(pool, "some-name", { foo, mkpkg("bar") });
+
+        const auto columns = pool.solvable_columns();
+        REQUIRE_EQ(columns.ids.size(), 2);
+        REQUIRE_EQ(columns.depends_offsets.size(), 3);
+        CHECK_EQ(columns.depends.size(), 2);
+        for (std::size_t i = 0; i < columns.ids.size(); ++i)
+        {
+            const auto view = pool.id2pkgview(columns.ids[i]);
+            REQUIRE(view.has_value());
+            CHECK_EQ(pool.dep2str(columns.names[i]), std::string(view->name));
+            CHECK_EQ(pool.dep2str(columns.versions[i]), std::string(view->version));
+            CHECK_EQ(pool.dep2str(columns.build_strings[i]), std::string(view->build_string));
+            CHECK_EQ(static_cast<std::size_t>(columns.build_numbers[i]), view->build_number);
+            const auto n_deps = columns.depends_offsets[i + 1] - columns.depends_offsets[i];
+            CHECK_EQ(n_deps, (view->name == "foo") ? 2 : 0);
+        }
+        CHECK_EQ(pool.dep2str(columns.depends[0]), "bar >=1.0");
+        CHECK_EQ(pool.dep2str(columns.depends[1]), "baz");
+
+        // Invalid ids are skipped
+        const auto selected = pool.solvable_columns({ columns.ids[1], 0 });
+        REQUIRE_EQ(selected.ids.size(), 1);
+        CHECK_EQ(selected.ids[0], columns.ids[1]);
+        CHECK_EQ(selected.depends_offsets.size(), 2);
+    }
+
+    TEST_CASE("snapshot_restore_fork")
+    {
+        ChannelContext channel_context = {};
+        auto pool = MPool{ channel_context };
+        MRepo(pool, "channel", { mkpkg("foo", { "bar" }), mkpkg("bar") });
+        pool.create_whatprovides();
+        const auto snapshot = pool.snapshot();
+
+        {
+            auto installed = MRepo(pool, "installed", { mkpkg("baz") });
+            installed.set_installed();
+            pool.create_whatprovides();
+            CHECK_EQ(count_solvables(pool, "baz"), 1);
+        }
+
+        pool.restore(snapshot);
+        CHECK_EQ(count_solvables(pool, "baz"), 0);
+        CHECK_EQ(count_solvables(pool, "foo"), 1);
+        auto solver = MSolver(pool, {});
+        solver.add_jobs({ "foo" }, SOLVER_INSTALL);
+        CHECK(solver.try_solve());
+
+        auto forked = pool.fork();
+        // Not shared with the forked pool
+        MRepo(pool, "other", { mkpkg("other") });
+        pool.create_whatprovides();
+        CHECK_EQ(count_solvables(pool, "other"), 1);
+        CHECK_EQ(count_solvables(forked, "other"), 0);
+        CHECK_EQ(count_solvables(forked, "foo"), 1);
+        CHECK_EQ(count_solvables(forked, "bar"), 1);
+        auto forked_solver = MSolver(forked, {});
+        forked_solver.add_jobs({ "foo" }, SOLVER_INSTALL);
+        CHECK(forked_solver.try_solve());
+    }
+
+    TEST_CASE("match_names")
+    {
+        ChannelContext channel_context = {};
+        auto pool = MPool{ channel_context };
+        MRepo(
+            pool,
+            "channel",
+            { mkpkg("python"), mkpkg("pytest"), mkpkg("numpy"), mkpkg("pytest"), mkpkg("py") }
+        );
+        pool.create_whatprovides();
+
+        using StrVec = std::vector<std::string>;
+        const auto names = [&](std::string_view pattern)
+        {
+            auto out = StrVec();
+            for (const Id id : pool.match_names(pattern))
+            {
+                out.emplace_back(pool.pool().get_string(id));
+            }
+            return out;
+        };
+        CHECK(names("py*") == StrVec{ "py", "pytest", "python" });
+        CHECK(names("py") == StrVec{ "py" });
+        CHECK(names("*t*") == StrVec{ "pytest", "python" });
+        CHECK(names("*y") == StrVec{ "numpy", "py" });
+        CHECK(names("*") == StrVec{ "numpy", "py", "pytest", "python" });
+        CHECK(names("pz*").empty());
+
+        // Names added since are found
+        MRepo(pool, "other", { mkpkg("pyyaml") });
+        pool.create_whatprovides();
+        CHECK(names("pyy*") == StrVec{ "pyyaml" });
+    }
+}
@@ -0,0 +1,261 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/prefix_data.hpp"
+#include "mamba/core/util.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    void write_record(const fs::u8path& prefix, const std::string& name, const std::string& version)
+    {
+        const auto record = nlohmann::json{
+            { "name", name },
+            { "version", version },
+            { "build", "h0_0" },
+            { "build_number", 0 },
+            { "channel", "https://conda.anaconda.org/conda-forge/linux-64" },
+            { "depends", { "python >=3.8" } },
+            { "noarch", "python" },
+            { "files", { "lib/" + name + ".py" } },
+            { "paths_data", { { "paths", nlohmann::json::array() } } },
+        };
+        fs::create_directories(prefix / "conda-meta");
+        auto out = open_ofstream(prefix / "conda-meta" / (name + "-" + version + "-h0_0.json"));
+        out << record.dump();
+    }
+
+    auto load(const fs::u8path& prefix) -> std::vector<PackageInfo>
+    {
+        auto channel_context = ChannelContext();
+        auto prefix_data = PrefixData::create(prefix, channel_context).value();
+        auto out = std::vector<PackageInfo>();
+        for (const auto& [name, record] : prefix_data.records())
+        {
+            out.push_back(record);
+        }
+        return out;
+    }
+}
+
+TEST_SUITE("prefix_data")
+{
+    TEST_CASE("Records are indexed")
+    {
+        const auto prefix = TemporaryDirectory();
+        write_record(prefix.path(), "foo", "1.0");
+        write_record(prefix.path(), "bar", "2.0");
+        const auto index_file = prefix.path() / "conda-meta" / "mamba-index.msgpack";
+
+        const auto records = load(prefix.path());
+        REQUIRE_EQ(records.size(), 2);
+        CHECK_EQ(records[0].name, "bar");
+        CHECK_EQ(records[1].name, "foo");
+        CHECK_EQ(records[1].depends, std::vector<std::string>{ "python >=3.8" });
+        CHECK_EQ(records[1].noarch, "python");
+        CHECK(fs::exists(index_file));
+
+        SUBCASE("Indexed records are the same as parsed ones")
+        {
+            CHECK_EQ(load(prefix.path()), records);
+        }
+
+        SUBCASE("Records changed since are parsed")
+        {
+            auto out = open_ofstream(prefix.path() / "conda-meta" / "foo-1.0-h0_0.json");
+            out << nlohmann::json{ { "name", "foo" }, { "version", "1.1" } }.dump();
+            out.close();
+            fs::remove(prefix.path() / "conda-meta" / "bar-2.0-h0_0.json");
+            write_record(prefix.path(), "baz", "3.0");
+
+            const auto changed = load(prefix.path());
+            REQUIRE_EQ(changed.size(), 2);
+            CHECK_EQ(changed[0].name, "baz");
+            CHECK_EQ(changed[1].version, "1.1");
+            CHECK_EQ(load(prefix.path()), changed);
+        }
+
+        SUBCASE("Single records are read without their files")
+        {
+            const auto file = prefix.path() / "conda-meta" / "foo-1.0-h0_0.json";
+            auto in = open_ifstream(file);
+            const auto expected = PackageInfo(nlohmann::json::parse(in));
+
+            auto channel_context = ChannelContext();
+            auto prefix_data = PrefixData::create(prefix.path() / "other", channel_context).value();
+            prefix_data.load_single_record(file);
+            CHECK_EQ(prefix_data.records().at("foo"), expected);
+        }
+
+        SUBCASE("Invalid indexes are ignored")
+        {
+            open_ofstream(index_file) << "not msgpack";
+            CHECK_EQ(load(prefix.path()), records);
+        }
+    }
+
+    TEST_CASE("Summaries of the records")
+    {
+        const auto prefix = TemporaryDirectory();
+        CHECK(PrefixData::load_summaries(prefix.path()).empty());
+
+        write_record(prefix.path(), "foo", "1.0");
+        write_record(prefix.path(), "bar", "2.0");
+        const auto records = load(prefix.path());
+
+        // Read from the index written when loading, and from the files otherwise
+        for (bool indexed : { true, false })
+        {
+            CAPTURE(indexed);
+            if (!indexed)
+            {
+                fs::remove(prefix.path() / "conda-meta" / "mamba-index.msgpack");
+            }
+            const auto summaries = PrefixData::load_summaries(prefix.path());
+            REQUIRE_EQ(summaries.size(), records.size());
+            for (std::size_t i = 0; i < summaries.size(); ++i)
+            {
+                CHECK_EQ(summaries[i].name, records[i].name);
+                CHECK_EQ(summaries[i].version, records[i].version);
+                CHECK_EQ(summaries[i].build_string, records[i].build_string);
+                CHECK_EQ(summaries[i].build_number, records[i].build_number);
+                CHECK_EQ(summaries[i].channel, records[i].channel);
+            }
+        }
+    }
+
+    TEST_CASE("Records sorted by dependencies")
+    {
+        const auto prefix = TemporaryDirectory();
+        auto channel_context = ChannelContext();
+        auto prefix_data = PrefixData::create(prefix.path(), channel_context).value();
+
+        auto mkpkg = [](std::string name, std::vector<std::string> depends)
+        {
+            auto pkg = PackageInfo(std::move(name));
+            pkg.depends = std::move(depends);
+            return pkg;
+        };
+        prefix_data.add_packages({
+            mkpkg("numpy", { "python >=3.8,<3.12", "conda-forge::libblas[version='>=3.9']" }),
+            mkpkg("libblas", {}),
+            mkpkg("pip", { "python>=3.7" }),
+            mkpkg("python", { "pip" }),
+            mkpkg("tool", { "numpy", "missing 1.0" }),
+        });
+
+        auto names = std::vector<std::string>();
+        for (const auto& pkg : prefix_data.sorted_records())
+        {
+            names.push_back(pkg.name);
+        }
+        const auto position = [&](std::string_view name)
+        { return std::find(names.cbegin(), names.cend(), name) - names.cbegin(); };
+        REQUIRE_EQ(names.size(), 5);
+        CHECK_LT(position("python"), position("numpy"));
+        CHECK_LT(position("libblas"), position("numpy"));
+        CHECK_LT(position("numpy"), position("tool"));
+        // Cycle broken by installing python first
+        CHECK_LT(position("python"), position("pip"));
+    }
+
+    TEST_CASE("Many records are loaded concurrently")
+    {
+        const auto prefix = TemporaryDirectory();
+        for (int i = 0; i < 200; ++i)
+        {
+            write_record(prefix.path(), "pkg" + std::to_string(1000 + i), "1.0");
+        }
+
+        const auto records = load(prefix.path());
+        REQUIRE_EQ(records.size(), 200);
+        for (std::size_t i = 0; i < records.size(); ++i)
+        {
+            CHECK_EQ(records[i].name, "pkg" + std::to_string(1000 + i));
+        }
+        CHECK_EQ(load(prefix.path()), records);
+
+        SUBCASE("Invalid records fail the loading")
+        {
+            open_ofstream(prefix.path() / "conda-meta" / "pkg1100-1.0-h0_0.json") << "{";
+            auto channel_context = ChannelContext();
+            CHECK_FALSE(PrefixData::create(prefix.path(), channel_context).has_value());
+        }
+    }
+
+    TEST_CASE("Records of files are loaded concurrently")
+    {
+        const auto prefix = TemporaryDirectory();
+        auto paths = std::vector<fs::u8path>();
+        for (int i = 0; i < 50; ++i)
+        {
+            const auto name = "pkg" + std::to_string(1000 + i);
+            write_record(prefix.path(), name, "1.0");
+            paths.push_back(prefix.path() / "conda-meta" / (name + "-1.0-h0_0.json"));
+        }
+        // The first record of a name is kept
+        write_record(prefix.path(), "pkg1000", "2.0");
+        paths.push_back(prefix.path() / "conda-meta" / "pkg1000-2.0-h0_0.json");
+
+        const auto empty = TemporaryDirectory();
+        auto channel_context = ChannelContext();
+        auto prefix_data = PrefixData::create(empty.path(), channel_context).value();
+        prefix_data.load_records(paths);
+        REQUIRE_EQ(prefix_data.records().size(), 50);
+        CHECK_EQ(prefix_data.records().at("pkg1000").version, "1.0");
+        CHECK_EQ(prefix_data.records().at("pkg1049").version, "1.0");
+    }
+
+    TEST_CASE("Stamp of the records")
+    {
+        const auto prefix = TemporaryDirectory();
+        write_record(prefix.path(), "foo", "1.0");
+        write_record(prefix.path(), "bar", "2.0");
+
+        auto stamp = [&]()
+        {
+            auto channel_context = ChannelContext();
+            return PrefixData::create(prefix.path(), channel_context).value().records_stamp();
+        };
+        const auto first = stamp();
+        CHECK_FALSE(first.empty());
+        // Records read from the index have the same stamp
+        CHECK_EQ(stamp(), first);
+
+        SUBCASE("Changed by the records")
+        {
+            fs::remove(prefix.path() / "conda-meta" / "bar-2.0-h0_0.json");
+            CHECK_NE(stamp(), first);
+        }
+
+        SUBCASE("Changed by added packages")
+        {
+            auto channel_context = ChannelContext();
+            auto prefix_data = PrefixData::create(prefix.path(), channel_context).value();
+            prefix_data.add_packages({ PackageInfo("__glibc", "2.17", "0", 0) });
+            CHECK_FALSE(prefix_data.records_stamp().empty());
+            CHECK_NE(prefix_data.records_stamp(), first);
+        }
+
+        SUBCASE("Empty for the records of other files")
+        {
+            auto channel_context = ChannelContext();
+            auto prefix_data = PrefixData::create(prefix.path(), channel_context).value();
+            prefix_data.load_single_record(prefix.path() / "conda-meta" / "foo-1.0-h0_0.json");
+            CHECK(prefix_data.records_stamp().empty());
+        }
+    }
+}
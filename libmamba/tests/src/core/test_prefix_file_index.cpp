@@ -0,0 +1,91 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/prefix_file_index.hpp"
+#include "mamba/core/util.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto paths_data(const std::vector<std::string>& paths) -> nlohmann::json
+    {
+        auto out = nlohmann::json{ { "paths", nlohmann::json::array() } };
+        for (const auto& path : paths)
+        {
+            out["paths"].push_back({ { "_path", path }, { "sha256_in_prefix", "sha-" + path } });
+        }
+        return out;
+    }
+
+    void write_record(
+        const fs::u8path& prefix,
+        const std::string& package,
+        const std::vector<std::string>& paths
+    )
+    {
+        const auto record = nlohmann::json{ { "paths_data", paths_data(paths) } };
+        fs::create_directories(prefix / "conda-meta");
+        auto out = open_ofstream(prefix / "conda-meta" / (package + ".json"));
+        out << record.dump();
+    }
+}
+
+TEST_SUITE("prefix_file_index")
+{
+    TEST_CASE("Files are indexed from the records")
+    {
+        const auto prefix = TemporaryDirectory();
+        write_record(prefix.path(), "foo-1.0-h0_0", { "bin/foo", "lib/libfoo.so" });
+        write_record(prefix.path(), "bar-2.0-h0_0", { "bin/bar" });
+
+        {
+            auto index = PrefixFileIndex(prefix.path());
+            REQUIRE(index.find("bin/foo").has_value());
+            CHECK_EQ(index.find("bin/foo")->package, "foo-1.0-h0_0");
+            CHECK_EQ(index.find("bin/foo")->sha256, "sha-bin/foo");
+            CHECK_EQ(index.find("bin/bar")->package, "bar-2.0-h0_0");
+            CHECK_FALSE(index.find("bin/baz").has_value());
+            const auto foo_files = std::vector<std::string>{ "bin/foo", "lib/libfoo.so" };
+            CHECK_EQ(index.files("foo-1.0-h0_0"), foo_files);
+            CHECK_FALSE(index.files("baz-1.0-h0_0").has_value());
+            index.write();
+        }
+        CHECK(fs::exists(prefix.path() / "conda-meta" / "mamba-files.msgpack"));
+
+        // Changed by another tool since indexed
+        fs::remove(prefix.path() / "conda-meta" / "bar-2.0-h0_0.json");
+        write_record(prefix.path(), "baz-1.0-h0_0", { "bin/baz" });
+
+        auto index = PrefixFileIndex(prefix.path());
+        CHECK_EQ(index.find("bin/foo")->package, "foo-1.0-h0_0");
+        CHECK_FALSE(index.find("bin/bar").has_value());
+        CHECK_EQ(index.find("bin/baz")->package, "baz-1.0-h0_0");
+    }
+
+    TEST_CASE("Linked and unlinked packages are indexed")
+    {
+        const auto prefix = TemporaryDirectory();
+        write_record(prefix.path(), "foo-1.0-h0_0", { "bin/foo", "share/common" });
+
+        auto index = PrefixFileIndex(prefix.path());
+        index.add("bar-2.0-h0_0", paths_data({ "bin/bar", "share/common" }));
+        // The last linked package owns the clobbered file
+        CHECK_EQ(index.find("share/common")->package, "bar-2.0-h0_0");
+        CHECK_EQ(index.find("bin/foo")->package, "foo-1.0-h0_0");
+
+        index.remove("foo-1.0-h0_0");
+        CHECK_FALSE(index.files("foo-1.0-h0_0").has_value());
+        CHECK_FALSE(index.find("bin/foo").has_value());
+        CHECK_EQ(index.find("share/common")->package, "bar-2.0-h0_0");
+    }
+}
@@ -0,0 +1,127 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <sstream>
+#include <string>
+
+#include <doctest/doctest.h>
+
+#include "core/prefix_replacement.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto replace_text(
+        std::string_view data,
+        std::string_view placeholder,
+        std::string_view prefix
+    ) -> std::string
+    {
+        auto out = std::ostringstream();
+        PrefixReplacer(placeholder, prefix).write_text(data, out);
+        return out.str();
+    }
+
+    auto replace_binary(
+        std::string_view data,
+        std::string_view placeholder,
+        std::string_view prefix
+    ) -> std::string
+    {
+        auto out = std::ostringstream();
+        PrefixReplacer(placeholder, prefix).write_binary(data, out);
+        return out.str();
+    }
+
+    using namespace std::string_literals;
+}
+
+TEST_SUITE("prefix_replacement")
+{
+    TEST_CASE("write_text")
+    {
+        CHECK_EQ(replace_text("", "/opt/placeholder", "/env"), "");
+        CHECK_EQ(replace_text("no placeholder", "/opt/placeholder", "/env"), "no placeholder");
+        CHECK_EQ(
+            replace_text("/opt/placeholder/bin:/opt/placeholder/lib", "/opt/placeholder", "/env"),
+            "/env/bin:/env/lib"
+        );
+        CHECK_EQ(
+            replace_text("a=/opt/placeholder\n", "/opt/placeholder", "/a/much/longer/env"),
+            "a=/a/much/longer/env\n"
+        );
+        CHECK_EQ(replace_text("/opt/placeholde", "/opt/placeholder", "/env"), "/opt/placeholde");
+
+        auto out = std::ostringstream();
+        const auto replacer = PrefixReplacer("/opt/placeholder", "/env");
+        CHECK_EQ(replacer.write_text("/opt/placeholder /opt/placeholder", out), 2);
+    }
+
+    TEST_CASE("write_binary")
+    {
+        SUBCASE("Shorter prefix is padded")
+        {
+            const auto data = "\x7f" "ELF\0/opt/placeholder/lib\0rest"s;
+            const auto expected = "\x7f" "ELF\0/env/lib\0\0\0\0\0\0\0\0\0\0\0\0\0rest"s;
+            CHECK_EQ(replace_binary(data, "/opt/placeholder", "/env"), expected);
+        }
+
+        SUBCASE("Padding accumulates in the string")
+        {
+            const auto data = "x\0/opt/placeholder/a:/opt/placeholder/b\0y"s;
+            const auto padding = std::string(2 * 12, '\0');
+            const auto expected = "x\0/env/a:/env/b"s + padding + "\0y"s;
+            CHECK_EQ(replace_binary(data, "/opt/placeholder", "/env"), expected);
+        }
+
+        SUBCASE("Longer prefix shifts the rest")
+        {
+            const auto data = "/opt/placeholder/lib\0rest"s;
+            const auto expected = "/a/much/longer/env/lib\0rest"s;
+            CHECK_EQ(replace_binary(data, "/opt/placeholder", "/a/much/longer/env"), expected);
+        }
+
+        SUBCASE("Unterminated string")
+        {
+            const auto data = "\0/opt/placeholder/lib"s;
+            const auto expected = "\0/env/lib"s + std::string(12, '\0');
+            CHECK_EQ(replace_binary(data, "/opt/placeholder", "/env"), expected);
+        }
+
+        SUBCASE("Strings are padded separately")
+        {
+            const auto data = "/opt/placeholder\0/opt/placeholder\0"s;
+            const auto padding = std::string(12, '\0');
+            const auto expected = "/env"s + padding + "\0/env"s + padding + "\0"s;
+            CHECK_EQ(replace_binary(data, "/opt/placeholder", "/env"), expected);
+        }
+
+        SUBCASE("Size is kept")
+        {
+            auto data = std::string(100'000, 'a');
+            data.replace(5'000, 17, "/opt/placeholder\0"s);
+            data.replace(70'000, 16, "/opt/placeholder");
+            const auto out = replace_binary(data, "/opt/placeholder", "/env");
+            CHECK_EQ(out.size(), data.size());
+            CHECK_EQ(out.substr(5'000, 17), "/env"s + std::string(13, '\0'));
+            CHECK_EQ(out.substr(70'000, 5), "/enva");
+        }
+    }
+
+    TEST_CASE("Appending to a string")
+    {
+        const auto replacer = PrefixReplacer("/opt/placeholder", "/env");
+        auto out = std::string("head:");
+        CHECK_EQ(replacer.write_text("/opt/placeholder/bin", out), 1);
+        CHECK_EQ(out, "head:/env/bin");
+
+        const auto data = "/opt/placeholder\0rest"s;
+        const auto expected = "head:/env/bin/env"s + std::string(12, '\0') + "\0rest"s;
+        CHECK_EQ(replacer.write_binary(data, out), 1);
+        CHECK_EQ(out, expected);
+    }
+}
@@ -390,5 +390,62 @@ namespace mamba
             CHECK_EQ(ostream.str(), "conda-forge        0%");
             ostream.str("");
         }
+
+        TEST_CASE_FIXTURE(progress_bar, "post_progress")
+        {
+            proxy.post_progress(50, 200, 10);
+            CHECK(proxy.started());
+            CHECK_EQ(proxy.current(), 50);
+            CHECK_EQ(proxy.total(), 200);
+            CHECK_EQ(proxy.speed(), 10);
+            // The progress is computed when the bar is sampled for rendering
+            CHECK_EQ(proxy.progress(), 0.);
+            proxy.update_repr(false);
+            CHECK_EQ(proxy.progress(), 25.);
+
+            // An unknown size turns the bar in a spinner
+            proxy.post_progress(100, 0, 10);
+            proxy.update_repr(false);
+            CHECK(proxy.repr().progress_bar().is_spinner());
+
+            // A direct update supersedes the posted progress
+            proxy.post_progress(150, 200, 10);
+            proxy.set_full();
+            proxy.update_repr(false);
+            CHECK_EQ(proxy.current(), 200);
+            CHECK_EQ(proxy.progress(), 100.);
+        }
+
+        TEST_CASE("write_lines_update")
+        {
+            using Lines = std::vector<std::string>;
+            std::ostringstream ostream;
+
+            // First frame
+            write_lines_update(ostream, {}, Lines{ "[+] 0.1s", "a 1%" });
+            CHECK_EQ(ostream.str(), "\x1b[2K\x1b[0G[+] 0.1s\na 1%");
+
+            // Unchanged frame
+            ostream.str("");
+            write_lines_update(ostream, Lines{ "[+] 0.1s", "a 1%" }, Lines{ "[+] 0.1s", "a 1%" });
+            CHECK(ostream.str().empty());
+
+            // Only the changed lines, from the last line
+            ostream.str("");
+            write_lines_update(
+                ostream,
+                Lines{ "[+] 0.1s", "a 1%", "b 1%" },
+                Lines{ "[+] 0.2s", "a 1%", "b 2%" }
+            );
+            CHECK_EQ(
+                ostream.str(),
+                "\x1b[2A\x1b[0G\x1b[2K[+] 0.2s\x1b[1E\x1b[1E\x1b[0G\x1b[2Kb 2%"
+            );
+
+            // Messages and resized frames are written again in full
+            ostream.str("");
+            write_lines_update(ostream, Lines{ "[+] 0.2s", "a 1%" }, Lines{ "[+] 0.3s" }, "msg\n");
+            CHECK_EQ(ostream.str(), "\x1b[2K\x1b[1A\x1b[2K\x1b[0Gmsg\n[+] 0.3s");
+        }
     }
 }  // namespace mamba
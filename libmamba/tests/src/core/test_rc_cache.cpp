@@ -0,0 +1,107 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <yaml-cpp/yaml.h>
+
+#include "mamba/core/environment.hpp"
+#include "mamba/core/util.hpp"
+
+#include "core/rc_cache.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    void write_file(const fs::u8path& path, const std::string& content)
+    {
+        auto out = open_ofstream(path);
+        out << content;
+    }
+
+    auto parse_and_store(const RCFileCache& cache, const std::vector<fs::u8path>& paths)
+        -> std::vector<YAML::Node>
+    {
+        auto sources = std::vector<RCFileCache::Source>();
+        auto nodes = std::vector<YAML::Node>();
+        for (const auto& path : paths)
+        {
+            sources.push_back(RCFileCache::Source::from_file(path).value());
+            nodes.push_back(YAML::LoadFile(path.string()));
+        }
+        cache.store(sources, nodes);
+        return nodes;
+    }
+}
+
+TEST_SUITE("rc_cache")
+{
+    TEST_CASE("load_stored")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto rc = tmp_dir.path() / "condarc";
+        const auto other_rc = tmp_dir.path() / "mambarc";
+        write_file(rc, "channels:\n  - conda-forge\n  - defaults\nchangeps1: false\n");
+        write_file(other_rc, "custom_channels: {foo: https://foo.org}\n");
+        const auto cache = RCFileCache(tmp_dir.path() / "cache" / "rc_cache.bin");
+
+        CHECK_FALSE(cache.load({ rc }).has_value());
+        const auto nodes = parse_and_store(cache, { rc, other_rc });
+        CHECK_FALSE(cache.load({ rc }).has_value());
+
+        const auto cached = cache.load({ rc, other_rc });
+        REQUIRE(cached.has_value());
+        REQUIRE_EQ(cached->size(), 2);
+        CHECK_EQ(YAML::Dump(cached->at(0)), YAML::Dump(nodes[0]));
+        CHECK_EQ(YAML::Dump(cached->at(1)), YAML::Dump(nodes[1]));
+        CHECK_EQ(cached->at(0)["channels"].as<std::vector<std::string>>().size(), 2);
+        CHECK_FALSE(cached->at(0)["changeps1"].as<bool>());
+        CHECK_EQ(cached->at(1)["custom_channels"]["foo"].as<std::string>(), "https://foo.org");
+
+        // Another list of files is kept alongside
+        parse_and_store(cache, { rc });
+        CHECK(cache.load({ rc }).has_value());
+        CHECK(cache.load({ rc, other_rc }).has_value());
+    }
+
+    TEST_CASE("invalidated_by_changes")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto rc = tmp_dir.path() / "condarc";
+        const auto cache = RCFileCache(tmp_dir.path() / "rc_cache.bin");
+
+        SUBCASE("File content")
+        {
+            write_file(rc, "changeps1: false\n");
+            parse_and_store(cache, { rc });
+            REQUIRE(cache.load({ rc }).has_value());
+
+            write_file(rc, "changeps1: true\n");
+            fs::last_write_time(rc, fs::last_write_time(rc) + std::chrono::seconds(1));
+            CHECK_FALSE(cache.load({ rc }).has_value());
+        }
+
+        SUBCASE("Environment variable")
+        {
+            const std::string var = "MAMBA_TEST_RC_CACHE_PREFIX";
+            env::set(var, "foo");
+            write_file(rc, "envs_dirs:\n  - ${" + var + "}/envs\n");
+            parse_and_store(cache, { rc });
+            REQUIRE(cache.load({ rc }).has_value());
+
+            env::set(var, "bar");
+            CHECK_FALSE(cache.load({ rc }).has_value());
+            env::set(var, "foo");
+            CHECK(cache.load({ rc }).has_value());
+            env::unset(var);
+            CHECK_FALSE(cache.load({ rc }).has_value());
+        }
+    }
+}
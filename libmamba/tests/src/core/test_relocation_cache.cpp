@@ -0,0 +1,54 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+
+#include <doctest/doctest.h>
+
+#include "mamba/core/util.hpp"
+
+#include "core/relocation_cache.hpp"
+
+using namespace mamba;
+
+TEST_SUITE("relocation_cache")
+{
+    TEST_CASE("key")
+    {
+        const auto key = RelocationCache::key("abc", "/opt/placeholder", "/env", FileMode::TEXT);
+        CHECK_EQ(key, RelocationCache::key("abc", "/opt/placeholder", "/env", FileMode::TEXT));
+        CHECK_NE(key, RelocationCache::key("abc", "/opt/placeholder", "/env2", FileMode::TEXT));
+        CHECK_NE(key, RelocationCache::key("abc", "/opt/placeholder", "/env", FileMode::BINARY));
+        CHECK_NE(key, RelocationCache::key("abd", "/opt/placeholder", "/env", FileMode::TEXT));
+    }
+
+    TEST_CASE("store_and_link")
+    {
+        const auto pkgs_dir = TemporaryDirectory();
+        const auto prefix = TemporaryDirectory();
+        const auto cache = RelocationCache(pkgs_dir.path());
+        const auto key = RelocationCache::key("abc", "/opt/placeholder", "/env", FileMode::TEXT);
+
+        CHECK_FALSE(cache.link(key, prefix.path() / "missing", false).has_value());
+        CHECK_FALSE(fs::exists(prefix.path() / "missing"));
+
+        const auto relocated = prefix.path() / "relocated";
+        {
+            auto out = open_ofstream(relocated);
+            out << "#!/env/bin/python";
+        }
+        cache.store(key, relocated, "sha");
+
+        for (const bool copy : { false, true })
+        {
+            const auto dst = prefix.path() / (copy ? "copied" : "linked");
+            const auto sha256 = cache.link(key, dst, copy);
+            REQUIRE(sha256.has_value());
+            CHECK_EQ(*sha256, "sha");
+            CHECK_EQ(read_contents(dst), "#!/env/bin/python");
+        }
+    }
+}
@@ -0,0 +1,497 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/context.hpp"
+#include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/prefix_data.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/util_string.hpp"
+
+#include "solv-cpp/repo.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto make_record(const std::string& name, const std::string& version) -> nlohmann::json
+    {
+        return {
+            { "name", name },
+            { "version", version },
+            { "build", "h0_0" },
+            { "build_number", 0 },
+            { "subdir", "linux-64" },
+            { "depends", nlohmann::json::array() },
+        };
+    }
+
+    auto make_repodata() -> nlohmann::json
+    {
+        return {
+            { "info", { { "subdir", "linux-64" } } },
+            { "packages",
+              {
+                  { "a-1.0-h0_0.tar.bz2", make_record("a", "1.0") },
+                  { "b-1.0-h0_0.tar.bz2", make_record("b", "1.0") },
+              } },
+            { "packages.conda",
+              {
+                  { "b-1.0-h0_0.conda", make_record("b", "1.0") },
+                  { "c-1.0-h0_0.conda", make_record("c", "1.0") },
+              } },
+        };
+    }
+
+    auto file_names(const MRepo& repo) -> std::set<std::string>
+    {
+        auto out = std::set<std::string>();
+        solv::ObjRepoViewConst{ *repo.repo() }.for_each_solvable(
+            [&](solv::ObjSolvableViewConst s) { out.emplace(s.file_name()); }
+        );
+        return out;
+    }
+}
+
+TEST_SUITE("repo")
+{
+    TEST_CASE("RepoDataRecordsUpdate")
+    {
+        auto repodata = make_repodata();
+
+        SUBCASE("Record changes")
+        {
+            const auto patch = nlohmann::json::array({
+                { { "op", "add" },
+                  { "path", "/packages/d-1.0-h0_0.tar.bz2" },
+                  { "value", make_record("d", "1.0") } },
+                { { "op", "remove" }, { "path", "/packages.conda/b-1.0-h0_0.conda" } },
+                { { "op", "replace" }, { "path", "/packages/a-1.0-h0_0.tar.bz2/version" } },
+                { { "op", "replace" }, { "path", "/info/subdir" } },
+            });
+            repodata = repodata.patch(nlohmann::json::array({ patch[0], patch[1] }));
+
+            const auto update = RepoDataRecordsUpdate::from_patch("r.json", repodata, patch, false);
+            REQUIRE(update.has_value());
+            const auto stems = std::vector<std::string>{ "a-1.0-h0_0", "b-1.0-h0_0", "d-1.0-h0_0" };
+            CHECK_EQ(update->stems, stems);
+            REQUIRE_EQ(update->records.records.size(), 3);
+            // The .tar.bz2 is used again when the .conda is removed
+            CHECK_EQ(update->records.records[1].filename, "b-1.0-h0_0.tar.bz2");
+            CHECK_EQ(update->records.records[2].package.name, "d");
+        }
+
+        SUBCASE("Conda artifacts are preferred")
+        {
+            const auto patch = nlohmann::json::array({
+                { { "op", "remove" }, { "path", "/packages/b-1.0-h0_0.tar.bz2" } },
+                { { "op", "remove" }, { "path", "/packages.conda/c-1.0-h0_0.conda" } },
+            });
+            repodata = repodata.patch(patch);
+
+            const auto update = RepoDataRecordsUpdate::from_patch("r.json", repodata, patch, false);
+            REQUIRE(update.has_value());
+            REQUIRE_EQ(update->records.records.size(), 1);
+            CHECK_EQ(update->records.records[0].filename, "b-1.0-h0_0.conda");
+
+            const auto only_tar_bz2 = RepoDataRecordsUpdate::from_patch(
+                "r.json",
+                repodata,
+                patch,
+                true
+            );
+            REQUIRE(only_tar_bz2.has_value());
+            CHECK(only_tar_bz2->records.records.empty());
+        }
+
+        SUBCASE("Section changes")
+        {
+            const auto patch = nlohmann::json::array({
+                { { "op", "replace" },
+                  { "path", "/packages" },
+                  { "value", nlohmann::json::object() } },
+            });
+            const auto update = RepoDataRecordsUpdate::from_patch("r.json", repodata, patch, false);
+            CHECK_FALSE(update.has_value());
+        }
+    }
+
+    TEST_CASE("MRepo from RepoDataRecordsUpdate")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto json_file = tmp_dir.path() / "repodata.json";
+        auto solv_file = json_file;
+        solv_file.replace_extension("solv");
+        const auto metadata = RepoMetadata{ /* .url= */ "https://repo.test/linux-64" };
+        auto channel_context = ChannelContext();
+
+        auto repodata = make_repodata();
+        open_ofstream(json_file) << repodata;
+        {
+            auto pool = MPool{ channel_context };
+            auto repo = MRepo(pool, "repo", json_file, metadata);
+            const auto expected = std::set<std::string>{
+                "a-1.0-h0_0.tar.bz2",
+                "b-1.0-h0_0.conda",
+                "c-1.0-h0_0.conda",
+            };
+            CHECK_EQ(file_names(repo), expected);
+
+            // Composed from the repo url rather than stored for each record
+            auto ids = std::vector<solv::SolvableId>();
+            solv::ObjRepoViewConst{ *repo.repo() }.for_each_solvable_id(
+                [&](solv::SolvableId id) { ids.push_back(id); }
+            );
+            REQUIRE_FALSE(ids.empty());
+            const auto info = pool.id2pkginfo(ids.front());
+            REQUIRE(info.has_value());
+            CHECK_EQ(info->channel, metadata.url);
+            CHECK_EQ(info->url, metadata.url + "/" + info->fn);
+        }
+        REQUIRE(fs::exists(solv_file));
+
+        const auto patch = nlohmann::json::array({
+            { { "op", "add" },
+              { "path", "/packages.conda/d-1.0-h0_0.conda" },
+              { "value", make_record("d", "1.0") } },
+            { { "op", "remove" }, { "path", "/packages/a-1.0-h0_0.tar.bz2" } },
+        });
+        repodata = repodata.patch(patch);
+
+        SUBCASE("Valid solv cache")
+        {
+            // The json file is left outdated since only the solv file should be read
+            auto update = RepoDataRecordsUpdate::from_patch(json_file, repodata, patch, false);
+            REQUIRE(update.has_value());
+            const auto expected = std::set<std::string>{
+                "b-1.0-h0_0.conda",
+                "c-1.0-h0_0.conda",
+                "d-1.0-h0_0.conda",
+            };
+            {
+                auto pool = MPool{ channel_context };
+                auto repo = MRepo(pool, "repo", std::move(update).value(), metadata);
+                CHECK_EQ(file_names(repo), expected);
+            }
+            // The solv cache was rewritten with the update
+            auto pool = MPool{ channel_context };
+            auto repo = MRepo(pool, "repo", solv_file, metadata);
+            CHECK_EQ(file_names(repo), expected);
+        }
+
+        SUBCASE("Invalid solv cache")
+        {
+            open_ofstream(json_file) << repodata;
+            auto update = RepoDataRecordsUpdate::from_patch(json_file, repodata, patch, false);
+            REQUIRE(update.has_value());
+            auto pool = MPool{ channel_context };
+            const auto other_metadata = RepoMetadata{ /* .url= */ "https://other.test/linux-64" };
+            auto repo = MRepo(pool, "repo", std::move(update).value(), other_metadata);
+            CHECK_EQ(file_names(repo).size(), 3);
+        }
+    }
+
+    TEST_CASE("MRepo with excluded records")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto json_file = tmp_dir.path() / "repodata.json";
+        auto solv_file = json_file;
+        solv_file.replace_extension("solv");
+        const auto metadata = RepoMetadata{ /* .url= */ "https://repo.test/linux-64" };
+        auto channel_context = ChannelContext();
+
+        auto repodata = make_repodata();
+        auto& packages = repodata["packages"];
+        packages["a-2.0-h0_0.tar.bz2"] = make_record("a", "2.0");
+        packages["d-1.0-h0_0.tar.bz2"] = make_record("d", "1.0");
+        packages["d-1.0-h0_0.tar.bz2"]["license"] = "GPL-3.0";
+        packages["e-1.0-h0_0.tar.bz2"] = make_record("e", "1.0");
+        packages["e-1.0-h0_0.tar.bz2"]["track_features"] = "mkl";
+        packages["f-1.0-h0_0.tar.bz2"] = make_record("f", "1.0");
+        packages["f-1.0-h0_0.tar.bz2"]["timestamp"] = 1700000000000;
+        packages["f-2.0-h0_0.tar.bz2"] = make_record("f", "2.0");
+        packages["f-2.0-h0_0.tar.bz2"]["timestamp"] = 1800000000000;
+        open_ofstream(json_file) << repodata;
+
+        auto& ctx = Context::instance();
+        const auto saved_ctx = std::make_tuple(
+            ctx.repodata_exclude,
+            ctx.repodata_as_of,
+            ctx.repodata_exclude_licenses,
+            ctx.repodata_exclude_track_features
+        );
+        ctx.repodata_exclude = { "a >=2", "c", "unknown" };
+        ctx.repodata_as_of = "2025-01-01T00:00:00Z";
+        ctx.repodata_exclude_licenses = { "GPL-3.0" };
+        ctx.repodata_exclude_track_features = { "mkl" };
+        {
+            auto pool = MPool{ channel_context };
+            auto repo = MRepo(pool, "repo", json_file, metadata);
+            const auto expected = std::set<std::string>{
+                "a-1.0-h0_0.tar.bz2",
+                "b-1.0-h0_0.conda",
+                "f-1.0-h0_0.tar.bz2",
+            };
+            CHECK_EQ(file_names(repo), expected);
+        }
+        std::tie(
+            ctx.repodata_exclude,
+            ctx.repodata_as_of,
+            ctx.repodata_exclude_licenses,
+            ctx.repodata_exclude_track_features
+        ) = saved_ctx;
+
+        // The solv cache keeps all the records
+        REQUIRE(fs::exists(solv_file));
+        auto pool = MPool{ channel_context };
+        auto repo = MRepo(pool, "repo", solv_file, metadata);
+        CHECK_EQ(file_names(repo).size(), 8);
+    }
+
+    TEST_CASE("MRepo as of a date")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto json_file = tmp_dir.path() / "repodata.json";
+        const auto metadata = RepoMetadata{ /* .url= */ "https://repo.test/linux-64" };
+        auto channel_context = ChannelContext();
+
+        auto repodata = make_repodata();
+        repodata["packages"]["a-1.0-h0_0.tar.bz2"]["timestamp"] = 1700000000000;
+        repodata["packages"]["a-2.0-h0_0.tar.bz2"] = make_record("a", "2.0");
+        repodata["packages"]["a-2.0-h0_0.tar.bz2"]["timestamp"] = 1800000000000;
+        open_ofstream(json_file) << repodata;
+
+        auto& ctx = Context::instance();
+        const auto saved_as_of = ctx.repodata_as_of;
+        ctx.repodata_as_of = "2025-01-01T00:00:00Z";
+        const auto expected = std::set<std::string>{
+            "a-1.0-h0_0.tar.bz2",
+            "b-1.0-h0_0.conda",
+            "c-1.0-h0_0.conda",
+        };
+        {
+            auto pool = MPool{ channel_context };
+            auto repo = MRepo(pool, "repo", json_file, metadata);
+            CHECK_EQ(file_names(repo), expected);
+        }
+        auto snapshots = std::vector<fs::u8path>();
+        for (const auto& entry : fs::directory_iterator(tmp_dir.path()))
+        {
+            if (starts_with(entry.path().filename().string(), "repodata.asof-"))
+            {
+                snapshots.push_back(entry.path());
+            }
+        }
+        CHECK_EQ(snapshots.size(), 1);
+
+        SUBCASE("The snapshot is read instead of the repodata")
+        {
+            open_ofstream(json_file) << nlohmann::json{ { "packages", nlohmann::json::object() } };
+            auto pool = MPool{ channel_context };
+            auto repo = MRepo(pool, "repo", json_file, metadata);
+            CHECK_EQ(file_names(repo), expected);
+        }
+
+        SUBCASE("Outdated snapshots are not read")
+        {
+            auto pool = MPool{ channel_context };
+            const auto other_metadata = RepoMetadata{ /* .url= */ "https://other.test/linux-64" };
+            auto repo = MRepo(pool, "repo", json_file, other_metadata);
+            CHECK_EQ(file_names(repo), expected);
+        }
+
+        SUBCASE("Other dates use other snapshots")
+        {
+            ctx.repodata_as_of = "2030-01-01T00:00:00Z";
+            auto pool = MPool{ channel_context };
+            auto repo = MRepo(pool, "repo", json_file, metadata);
+            CHECK_EQ(file_names(repo).size(), 4);
+        }
+
+        ctx.repodata_as_of = saved_as_of;
+    }
+
+    TEST_CASE("MRepo with streamed repodata parsing")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto json_file = tmp_dir.path() / "repodata.json";
+        auto solv_file = json_file;
+        solv_file.replace_extension("solv");
+        const auto metadata = RepoMetadata{ /* .url= */ "https://repo.test/linux-64" };
+        auto channel_context = ChannelContext();
+
+        auto repodata = make_repodata();
+        auto& a = repodata["packages"]["a-1.0-h0_0.tar.bz2"];
+        a["depends"] = { "python >=3.8", "b" };
+        a["constrains"] = { "c <2" };
+        a["license"] = "BSD-3-Clause";
+        a["size"] = 1234;
+        a["timestamp"] = 1700000000000;
+        a["md5"] = "0123456789abcdef0123456789abcdef";
+        a["sha256"] = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+        a["track_features"] = "mkl,debug";
+        repodata["packages"]["d-1.0-h0_0.tar.bz2"] = make_record("d", "1.0");
+        open_ofstream(json_file) << repodata;
+
+        auto& ctx = Context::instance();
+        const auto saved_ctx = std::make_tuple(
+            ctx.experimental_repodata_parsing,
+            ctx.use_only_tar_bz2
+        );
+
+        // The records read by libsolv or streamed, never from the solv cache
+        auto read_records = [&](bool streamed)
+        {
+            fs::remove(solv_file);
+            ctx.experimental_repodata_parsing = streamed;
+            auto pool = MPool{ channel_context };
+            const auto repo = MRepo(pool, "repo", json_file, metadata);
+            auto out = std::set<std::string>();
+            solv::ObjRepoViewConst{ *repo.repo() }.for_each_solvable_id(
+                [&](auto id) { out.insert(pool.id2pkginfo(id).value().json_record().dump()); }
+            );
+            return out;
+        };
+        auto file_names_of = [](const std::set<std::string>& records)
+        {
+            auto out = std::set<std::string>();
+            for (const auto& record : records)
+            {
+                out.insert(nlohmann::json::parse(record).at("fn").get<std::string>());
+            }
+            return out;
+        };
+
+        SUBCASE("Same solvables as libsolv")
+        {
+            const auto streamed = read_records(true);
+            CHECK_EQ(streamed, read_records(false));
+            const auto expected = std::set<std::string>{
+                "a-1.0-h0_0.tar.bz2",
+                "b-1.0-h0_0.conda",
+                "c-1.0-h0_0.conda",
+                "d-1.0-h0_0.tar.bz2",
+            };
+            CHECK_EQ(file_names_of(streamed), expected);
+        }
+
+        SUBCASE("Conda artifacts are preferred whichever section comes first")
+        {
+            const auto b = make_record("b", "1.0").dump();
+            open_ofstream(json_file) << R"({"packages.conda": {"b-1.0-h0_0.conda": )" << b
+                                     << R"(}, "packages": {"b-1.0-h0_0.tar.bz2": )" << b
+                                     << "}}";
+            const auto streamed = read_records(true);
+            CHECK_EQ(streamed, read_records(false));
+            CHECK_EQ(file_names_of(streamed), std::set<std::string>{ "b-1.0-h0_0.conda" });
+        }
+
+        SUBCASE("Only tar.bz2 artifacts")
+        {
+            ctx.use_only_tar_bz2 = true;
+            const auto streamed = read_records(true);
+            CHECK_EQ(streamed, read_records(false));
+            const auto expected = std::set<std::string>{
+                "a-1.0-h0_0.tar.bz2",
+                "b-1.0-h0_0.tar.bz2",
+                "d-1.0-h0_0.tar.bz2",
+            };
+            CHECK_EQ(file_names_of(streamed), expected);
+        }
+
+        SUBCASE("Invalid records are skipped")
+        {
+            repodata["packages"]["d-1.0-h0_0.tar.bz2"].erase("version");
+            repodata["packages"]["e-1.0-h0_0.tar.bz2"] = make_record("e", "1.0");
+            repodata["packages"]["e-1.0-h0_0.tar.bz2"]["build_number"] = "not a number";
+            open_ofstream(json_file) << repodata;
+            const auto expected = std::set<std::string>{
+                "a-1.0-h0_0.tar.bz2",
+                "b-1.0-h0_0.conda",
+                "c-1.0-h0_0.conda",
+            };
+            CHECK_EQ(file_names_of(read_records(true)), expected);
+        }
+
+        SUBCASE("Truncated files are errors")
+        {
+            const auto dumped = repodata.dump();
+            open_ofstream(json_file) << dumped.substr(0, dumped.size() / 2);
+            CHECK_THROWS_AS(read_records(true), std::runtime_error);
+
+            open_ofstream(json_file) << R"({"packages": {"a-1.0-h0_0.tar.bz2": [}})";
+            CHECK_THROWS_AS(read_records(true), std::runtime_error);
+        }
+
+        std::tie(ctx.experimental_repodata_parsing, ctx.use_only_tar_bz2) = saved_ctx;
+    }
+
+    TEST_CASE("Installed MRepo is cached")
+    {
+        auto prefix = TemporaryDirectory();
+        const auto conda_meta = prefix.path() / "conda-meta";
+        const auto solv_file = conda_meta / "mamba-installed.solv";
+        fs::create_directories(conda_meta);
+        auto write_record = [&](const std::string& name, const std::string& version)
+        {
+            auto record = make_record(name, version);
+            record["depends"] = { "python >=3.8" };
+            record["channel"] = "https://conda.anaconda.org/conda-forge/linux-64";
+            open_ofstream(conda_meta / (name + "-" + version + "-h0_0.json")) << record;
+        };
+        write_record("a", "1.0");
+        write_record("b", "1.0");
+
+        auto channel_context = ChannelContext();
+        auto installed = [&]()
+        {
+            auto prefix_data = PrefixData::create(prefix.path(), channel_context).value();
+            prefix_data.add_packages({ PackageInfo("__glibc", "2.17", "0", 0) });
+            auto pool = MPool{ channel_context };
+            const auto repo = MRepo(pool, prefix_data);
+            auto out = std::set<std::string>();
+            solv::ObjRepoViewConst{ *repo.repo() }.for_each_solvable_id(
+                [&](auto id) { out.insert(pool.id2pkginfo(id).value().json_record().dump()); }
+            );
+            return out;
+        };
+
+        const auto records = installed();
+        CHECK_EQ(records.size(), 3);
+        REQUIRE(fs::exists(solv_file));
+        const auto solv_time = fs::last_write_time(solv_file);
+
+        SUBCASE("Read from the cache")
+        {
+            CHECK_EQ(installed(), records);
+            CHECK_EQ(fs::last_write_time(solv_file), solv_time);
+        }
+
+        SUBCASE("Invalidated by the records")
+        {
+            write_record("c", "1.0");
+            CHECK_EQ(installed().size(), 4);
+        }
+
+        SUBCASE("Invalid caches are ignored")
+        {
+            open_ofstream(solv_file) << "not solv";
+            CHECK_EQ(installed(), records);
+        }
+    }
+}
+
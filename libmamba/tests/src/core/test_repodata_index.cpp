@@ -0,0 +1,131 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/util.hpp"
+
+#include "core/repodata_index.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto make_repodata() -> nlohmann::json
+    {
+        const auto record = nlohmann::json{
+            { "name", "foo" },
+            { "version", "1.2" },
+            { "build", "h0_1" },
+            { "build_number", 1 },
+            { "subdir", "linux-64" },
+            { "md5", "0123456789abcdef0123456789abcdef" },
+            { "size", 1234 },
+            { "timestamp", 1700000000000 },
+            { "license", "BSD-3-Clause" },
+            { "depends", { "python >=3.8", "bar" } },
+            { "constrains", { "baz <2" } },
+        };
+        auto bar = record;
+        bar["name"] = "bar";
+        bar["depends"] = nlohmann::json::array();
+        bar["constrains"] = nlohmann::json::array();
+        bar["noarch"] = "python";
+        return {
+            { "info", { { "subdir", "linux-64" } } },
+            { "packages",
+              { { "foo-1.2-h0_1.tar.bz2", record }, { "bar-1.2-h0_1.tar.bz2", bar } } },
+            { "packages.conda", { { "foo-1.2-h0_1.conda", record } } },
+        };
+    }
+
+    auto filenames(const RepoDataRecords& records) -> std::vector<std::string>
+    {
+        auto out = std::vector<std::string>();
+        for (const auto& r : records.records)
+        {
+            out.push_back(r.filename);
+        }
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+
+    auto find(const RepoDataRecords& records, const std::string& filename)
+        -> const RepoDataRecords::Record&
+    {
+        return *std::find_if(
+            records.records.cbegin(),
+            records.records.cend(),
+            [&](const auto& r) { return r.filename == filename; }
+        );
+    }
+}
+
+TEST_SUITE("repodata_index")
+{
+    TEST_CASE("round_trip")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto json_file = tmp_dir.path() / "repodata.json";
+        {
+            auto out = open_ofstream(json_file);
+            out << make_repodata().dump();
+        }
+        const auto index_file = tmp_dir.path() / RepoDataIndex::filename;
+        RepoDataIndex::write(RepoDataRecords::read_all(json_file), index_file);
+
+        CHECK(RepoDataIndex::is_index_file(index_file));
+        CHECK_FALSE(RepoDataIndex::is_index_file(json_file));
+
+        const auto index = RepoDataIndex::open(index_file);
+        REQUIRE(index.has_value());
+        CHECK_EQ(index->size(), 3);
+
+        const auto expected = RepoDataRecords::read(json_file, false);
+        const auto records = index->read_records(false);
+        const auto preferred = std::vector<std::string>{ "bar-1.2-h0_1.tar.bz2",
+                                                         "foo-1.2-h0_1.conda" };
+        CHECK_EQ(filenames(records), preferred);
+        CHECK_EQ(filenames(records), filenames(expected));
+        for (const auto& r : records.records)
+        {
+            const auto& e = find(expected, r.filename);
+            CHECK_EQ(r.version, e.version);
+            CHECK_EQ(r.package.name, e.package.name);
+            CHECK_EQ(r.package.build_string, e.package.build_string);
+            CHECK_EQ(r.package.build_number, e.package.build_number);
+            CHECK_EQ(r.package.md5, e.package.md5);
+            CHECK_EQ(r.package.size, e.package.size);
+            CHECK_EQ(r.package.timestamp, e.package.timestamp);
+            CHECK_EQ(r.package.license, e.package.license);
+            CHECK_EQ(r.package.depends, e.package.depends);
+            CHECK_EQ(r.package.constrains, e.package.constrains);
+            CHECK_EQ(r.package.noarch, e.package.noarch);
+        }
+
+        const auto tar_bz2 = std::vector<std::string>{ "bar-1.2-h0_1.tar.bz2",
+                                                       "foo-1.2-h0_1.tar.bz2" };
+        CHECK_EQ(filenames(index->read_records(true)), tar_bz2);
+    }
+
+    TEST_CASE("invalid")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto file = tmp_dir.path() / RepoDataIndex::filename;
+        {
+            auto out = open_ofstream(file);
+            out << "MAMBARDX but far too short";
+        }
+        CHECK(RepoDataIndex::is_index_file(file));
+        CHECK_FALSE(RepoDataIndex::open(file).has_value());
+        CHECK_FALSE(RepoDataIndex::open(tmp_dir.path() / "missing.bin").has_value());
+    }
+}
@@ -0,0 +1,165 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/url.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/validate.hpp"
+
+#include "core/repodata_shards.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto make_shard(const std::string& name, const std::vector<std::string>& depends)
+        -> nlohmann::json
+    {
+        const auto filename = name + "-1.0-h0_0.conda";
+        return {
+            { "packages", nlohmann::json::object() },
+            { "packages.conda",
+              { { filename,
+                  {
+                      { "name", name },
+                      { "version", "1.0" },
+                      { "build", "h0_0" },
+                      { "build_number", 0 },
+                      { "subdir", "linux-64" },
+                      { "depends", depends },
+                  } } } },
+        };
+    }
+
+    /** A sharded subdir on the filesystem, with one package per name. */
+    struct sharded_subdir
+    {
+        TemporaryDirectory dir = {};
+        nlohmann::json index = { { "info", { { "subdir", "linux-64" } } }, { "shards", {} } };
+
+        void add(const std::string& name, const std::vector<std::string>& depends = {})
+        {
+            fs::create_directories(dir.path() / "shards");
+            auto tmp = dir.path() / "shards" / "tmp.json";
+            {
+                auto out = open_ofstream(tmp);
+                out << make_shard(name, depends).dump();
+            }
+            const auto hash = validation::sha256sum(tmp);
+            fs::rename(tmp, dir.path() / "shards" / (hash + ".json"));
+            index["shards"][name] = hash;
+        }
+
+        auto url() const -> std::string
+        {
+            return path_to_url(dir.path().string());
+        }
+
+        auto read() const -> RepoDataShards
+        {
+            const auto index_file = dir.path() / "repodata_shards.json";
+            {
+                auto out = open_ofstream(index_file);
+                out << index.dump();
+            }
+            return RepoDataShards::read(index_file, url()).value();
+        }
+    };
+
+    auto record_names(const RepoDataRecords& records) -> std::vector<std::string>
+    {
+        auto out = std::vector<std::string>();
+        for (const auto& rec : records.records)
+        {
+            out.push_back(rec.package.name);
+        }
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+}
+
+TEST_SUITE("repodata_shards")
+{
+    TEST_CASE("read")
+    {
+        auto subdir = sharded_subdir();
+        subdir.add("foo");
+        const auto shards = subdir.read();
+
+        const auto* hash = shards.shard_hash("foo");
+        REQUIRE(hash != nullptr);
+        CHECK_EQ(shards.shard_url(*hash), subdir.url() + "/shards/" + *hash + ".json");
+        CHECK_EQ(shards.shard_hash("bar"), nullptr);
+
+        subdir.index["info"]["shards_base_url"] = "https://shards.example.com/linux-64";
+        CHECK_EQ(subdir.read().shard_url("h"), "https://shards.example.com/linux-64/h.json");
+
+        const auto tmp_dir = TemporaryDirectory();
+        const auto invalid = tmp_dir.path() / "repodata_shards.json";
+        open_ofstream(invalid) << "{}";
+        CHECK_FALSE(RepoDataShards::read(invalid, subdir.url()).has_value());
+
+        // Hashes are used as filenames
+        subdir.index["shards"]["evil"] = "../../evil";
+        CHECK_THROWS(subdir.read());
+    }
+
+    TEST_CASE("fetch_records")
+    {
+        auto subdir = sharded_subdir();
+        subdir.add("foo", { "bar >=1.0" });
+        subdir.add("bar", { "baz", "missing" });
+        subdir.add("baz");
+        subdir.add("unrelated", { "foo" });
+        subdir.add("python");
+        subdir.add("pip");
+        const auto shards = subdir.read();
+        const auto cache = TemporaryDirectory();
+
+        const auto records = shards.fetch_records({ "foo" }, cache.path(), false, false);
+        REQUIRE(records.has_value());
+        CHECK_EQ(record_names(records.value()), std::vector<std::string>{ "bar", "baz", "foo" });
+
+        SUBCASE("Shards are cached")
+        {
+            fs::remove_all(subdir.dir.path() / "shards");
+            const auto cached = shards.fetch_records({ "foo" }, cache.path(), false, false);
+            REQUIRE(cached.has_value());
+            CHECK_EQ(cached.value().records.size(), 3);
+            CHECK_FALSE(shards.fetch_records({ "python" }, cache.path(), false, false).has_value());
+        }
+
+        SUBCASE("Shards must match their hash")
+        {
+            const auto hash = *shards.shard_hash("python");
+            open_ofstream(subdir.dir.path() / "shards" / (hash + ".json")) << "{}";
+            CHECK_FALSE(shards.fetch_records({ "python" }, cache.path(), false, false).has_value());
+            CHECK_FALSE(fs::exists(cache.path() / (hash + ".json")));
+        }
+
+        SUBCASE("Corrupted cached shards are downloaded again")
+        {
+            const auto hash = *shards.shard_hash("foo");
+            open_ofstream(cache.path() / (hash + ".json")) << "{}";
+            const auto fetched = shards.fetch_records({ "foo" }, cache.path(), false, false);
+            REQUIRE(fetched.has_value());
+            CHECK_EQ(fetched.value().records.size(), 3);
+        }
+
+        SUBCASE("pip is added to python")
+        {
+            const auto python = shards.fetch_records({ "python" }, cache.path(), false, true);
+            REQUIRE(python.has_value());
+            CHECK_EQ(record_names(python.value()), std::vector<std::string>{ "pip", "python" });
+        }
+    }
+}
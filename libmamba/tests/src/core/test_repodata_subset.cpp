@@ -0,0 +1,116 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/util.hpp"
+#include "solv-cpp/pool.hpp"
+#include "solv-cpp/repo.hpp"
+
+#include "core/repodata_subset.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    /** Packages with their dependencies, as in a ``repodata.json``. */
+    auto make_repodata(const std::vector<std::pair<std::string, std::vector<std::string>>>& pkgs)
+        -> nlohmann::json
+    {
+        auto packages = nlohmann::json::object();
+        for (const auto& [name, depends] : pkgs)
+        {
+            packages[name + "-1.0-h0_0.tar.bz2"] = {
+                { "name", name },       { "version", "1.0" },   { "build", "h0_0" },
+                { "build_number", 0 },  { "subdir", "noarch" }, { "depends", depends },
+            };
+        }
+        return { { "info", { { "subdir", "noarch" } } }, { "packages", packages } };
+    }
+
+    auto load_repo(
+        MPool& pool,
+        const fs::u8path& dir,
+        const std::string& name,
+        const nlohmann::json& repodata,
+        const RepoMetadata& meta
+    ) -> MRepo
+    {
+        const auto file = dir / (name + ".json");
+        open_ofstream(file) << repodata.dump();
+        return MRepo(pool, name, RepoDataRecords::read(file, false), meta);
+    }
+
+    auto solvable_count(const MPool& pool, const MRepo& repo) -> std::size_t
+    {
+        return pool.pool().get_repo(repo.id()).value().solvable_count();
+    }
+}
+
+TEST_SUITE("repodata_subset")
+{
+    TEST_CASE("reachable_names")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        auto channel_context = ChannelContext();
+        auto pool = MPool(channel_context);
+        const auto repodata = make_repodata(
+            { { "a", { "b >=1" } }, { "b", { "c" } }, { "c", {} }, { "d", { "a" } } }
+        );
+        load_repo(pool, tmp_dir.path(), "channel", repodata, {});
+
+        const auto from_a = std::unordered_set<std::string>{ "a", "b", "c" };
+        CHECK_EQ(reachable_names(pool, { "a" }), from_a);
+        // Names without packages are kept
+        const auto from_c_e = std::unordered_set<std::string>{ "c", "e" };
+        CHECK_EQ(reachable_names(pool, { "c", "e" }), from_c_e);
+    }
+
+    TEST_CASE("store_load")
+    {
+        auto tmp_dir = TemporaryDirectory();
+        const auto cache_dir = tmp_dir.path() / "subsets";
+        const auto meta = RepoMetadata{ "https://conda.anaconda.org/c/noarch", "\"e\"", "", false };
+        const auto repodata = make_repodata({ { "a", { "b" } }, { "b", {} }, { "c", {} } });
+
+        auto subsets = RepoDataSubsets(cache_dir, { "a" }, { { "channel", meta } });
+        {
+            auto channel_context = ChannelContext();
+            auto pool = MPool(channel_context);
+            CHECK_FALSE(subsets.load(pool).has_value());
+
+            auto repos = std::vector<MRepo>();
+            repos.push_back(load_repo(pool, tmp_dir.path(), "channel", repodata, meta));
+            subsets.store(pool, repos);
+            CHECK_EQ(solvable_count(pool, repos.front()), 2);
+        }
+        {
+            auto channel_context = ChannelContext();
+            auto pool = MPool(channel_context);
+            const auto repos = subsets.load(pool);
+            REQUIRE(repos.has_value());
+            REQUIRE_EQ(repos->size(), 1);
+            CHECK_EQ(solvable_count(pool, repos->front()), 2);
+        }
+
+        // Other names, or another version of the repodata, use other subsets
+        const auto key = [&](std::vector<std::string> names, const RepoMetadata& m)
+        { return RepoDataSubsets(cache_dir, std::move(names), { { "channel", m } }).key(); };
+        auto new_meta = meta;
+        new_meta.etag = "\"new\"";
+        CHECK_NE(key({ "c" }, meta), subsets.key());
+        CHECK_NE(key({ "a" }, new_meta), subsets.key());
+        CHECK_EQ(key({ "a", "a" }, meta), subsets.key());
+    }
+}
@@ -15,6 +15,7 @@
 #include <solv/solver.h>
 
 #include "mamba/core/channel.hpp"
+#include "mamba/core/context.hpp"
 #include "mamba/core/mamba_fs.hpp"
 #include "mamba/core/package_info.hpp"
 #include "mamba/core/pool.hpp"
@@ -445,6 +446,31 @@ namespace
     };
 }
 
+TEST_CASE("Explanation budget")
+{
+    auto& ctx = Context::instance();
+    const auto prev_max_nodes = ctx.explain_problems_max_nodes;
+    auto solver = create_pubgrub();
+    REQUIRE_FALSE(solver.try_solve());
+
+    SUBCASE("Within budget")
+    {
+        const auto message = solver.explain_problems();
+        CHECK(contains(message, "menu"));
+        CHECK_FALSE(contains(message, "too large"));
+    }
+
+    SUBCASE("Exceeded")
+    {
+        ctx.explain_problems_max_nodes = 1;
+        const auto message = solver.explain_problems();
+        CHECK(contains(message, "too large to be explained (solver problems"));
+        CHECK(contains(message, solver.problems_to_str()));
+    }
+
+    ctx.explain_problems_max_nodes = prev_max_nodes;
+}
+
 TEST_CASE("NamedList")
 {
     auto l = CompressedProblemsGraph::PackageListNode();
@@ -477,6 +503,42 @@ TEST_CASE("NamedList")
     }
 }
 
+TEST_CASE("Compress problem graph with a cycle")
+{
+    using PbGr = ProblemsGraph;
+    using CpPbGr = CompressedProblemsGraph;
+
+    auto channel_context = ChannelContext();
+    const auto edge = MatchSpec("dep", channel_context);
+    auto graph = PbGr::graph_t();
+    const auto root = graph.add_node(PbGr::RootNode());
+    const auto a1 = graph.add_node(PbGr::PackageNode{ mkpkg("a", "1.0") });
+    const auto a2 = graph.add_node(PbGr::PackageNode{ mkpkg("a", "2.0") });
+    const auto b = graph.add_node(PbGr::PackageNode{ mkpkg("b", "1.0") });
+    const auto c1 = graph.add_node(PbGr::ConstraintNode{ { "c==1.0", channel_context } });
+    const auto c2 = graph.add_node(PbGr::ConstraintNode{ { "c==2.0", channel_context } });
+    graph.add_edge(root, a1, edge);
+    graph.add_edge(root, a2, edge);
+    graph.add_edge(root, c2, edge);
+    graph.add_edge(a1, b, edge);
+    graph.add_edge(a2, b, edge);
+    graph.add_edge(b, c1, edge);
+    // A cyclic dependency
+    graph.add_edge(b, a1, edge);
+    const auto pbs = PbGr(std::move(graph), { { c1, c2 } }, root);
+
+    const auto pbs_comp = CpPbGr::from_problems_graph(pbs);
+    const auto& graph_comp = pbs_comp.graph();
+    // Both ``a`` lead to the same leaves and are merged
+    CHECK_EQ(graph_comp.number_of_nodes(), 5);
+    CHECK_EQ(graph_comp.successors(pbs_comp.root_node()).size(), 2);
+    CHECK_EQ(pbs_comp.conflicts().size(), 2);
+
+    // Moving the nodes out of the graph gives the same result
+    const auto pbs_comp_moved = CpPbGr::from_problems_graph(PbGr(pbs));
+    CHECK_EQ(problem_tree_msg(pbs_comp_moved), problem_tree_msg(pbs_comp));
+}
+
 TEST_CASE("Create problem graph")
 {
     using PbGr = ProblemsGraph;
@@ -554,6 +616,12 @@ TEST_CASE("Create problem graph")
             REQUIRE_GE(graph_simplified.number_of_nodes(), 1);
             REQUIRE_LE(graph_simplified.number_of_nodes(), pbs_init.graph().number_of_nodes());
 
+            // Simplifying in place gives the same graph
+            const auto pbs_moved = simplify_conflicts(PbGr(pbs_init));
+            CHECK_EQ(pbs_moved.graph().number_of_nodes(), graph_simplified.number_of_nodes());
+            CHECK_EQ(pbs_moved.graph().number_of_edges(), graph_simplified.number_of_edges());
+            CHECK_EQ(pbs_moved.conflicts().size(), pbs_simplified.conflicts().size());
+
             for (const auto& [id, _] : pbs_simplified.conflicts())
             {
                 const auto& node = graph_simplified.node(id);
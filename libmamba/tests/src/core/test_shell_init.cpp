@@ -9,6 +9,7 @@
 #include <doctest/doctest.h>
 
 #include "mamba/core/environment.hpp"
+#include "mamba/core/shell_init.hpp"
 #include "mamba/core/util.hpp"
 #include "mamba/core/util_string.hpp"
 
@@ -27,6 +28,24 @@ namespace mamba
             // "/home/wolfv/superconda/", "bash");
         }
 
+        TEST_CASE("replace_init_blocks")
+        {
+            const std::string begin = "# >>> mamba initialize >>>";
+            const std::string end = "# <<< mamba initialize <<<";
+            const std::string block = "\n" + begin + "\nold content\n" + end + "\n";
+
+            CHECK_EQ(replace_init_blocks("a\nb\n", begin, end, "new"), "a\nb\n");
+            CHECK_EQ(replace_init_blocks("a" + block + "b\n", begin, end, "new"), "anewb\n");
+            CHECK_EQ(replace_init_blocks("a" + block + block, begin, end, ""), "a");
+            CHECK_EQ(
+                replace_init_blocks(begin + "\r\nold\r\n" + end + "\r\nb", begin, end, "new"),
+                "newb"
+            );
+            // Unterminated blocks are kept
+            const std::string unterminated = "a\n" + begin + "\nold";
+            CHECK_EQ(replace_init_blocks(unterminated, begin, end, "new"), unterminated);
+        }
+
         TEST_CASE("expand_user")
         {
             auto expanded = env::expand_user("~/this/is/a/test");
@@ -0,0 +1,251 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <solv/pool.h>
+#include <solv/solver.h>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/package_info.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/solver.hpp"
+
+#include "solv-cpp/pool.hpp"
+#include "solv-cpp/queue.hpp"
+#include "solv-cpp/solver.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto mkpkg(std::string name, std::string version, std::vector<std::string> dependencies = {})
+        -> PackageInfo
+    {
+        auto pkg = PackageInfo(std::move(name));
+        pkg.version = std::move(version);
+        pkg.depends = std::move(dependencies);
+        pkg.build_string = "bld";
+        return pkg;
+    }
+
+    auto make_solver(ChannelContext& channel_context, bool minimal_change) -> MSolver
+    {
+        auto pool = MPool{ channel_context };
+        MRepo(
+            pool,
+            "installed",
+            {
+                mkpkg("app", "1.0", { "lib <2" }),
+                mkpkg("lib", "1.0"),
+                mkpkg("tool", "1.0"),
+            }
+        )
+            .set_installed();
+        MRepo(
+            pool,
+            "channel",
+            {
+                mkpkg("app", "1.0", { "lib <2" }),
+                mkpkg("app", "2.0", { "lib" }),
+                mkpkg("lib", "1.0"),
+                mkpkg("lib", "2.0"),
+                mkpkg("tool", "1.0"),
+                mkpkg("tool", "2.0"),
+                mkpkg("plugin", "1.0", { "lib" }),
+                mkpkg("new-plugin", "1.0", { "lib >=2" }),
+            }
+        );
+        auto solver = MSolver(std::move(pool));
+        auto flags = solver.flags();
+        flags.minimal_change = minimal_change;
+        solver.set_flags(flags);
+        return solver;
+    }
+
+    /** The packages of the solution. */
+    auto solution(const MSolver& solver) -> std::vector<std::string>
+    {
+        auto decisions = solv::ObjQueue();
+        solver_get_decisionqueue(const_cast<::Solver*>(solver.solver().raw()), decisions.raw());
+        auto out = std::vector<std::string>();
+        for (auto id : decisions)
+        {
+            if ((id <= 0) || (id == SYSTEMSOLVABLE))
+            {
+                continue;
+            }
+            if (auto pkg = solver.pool().id2pkginfo(id); pkg.has_value())
+            {
+                out.push_back(pkg->str());
+            }
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+        return out;
+    }
+}
+
+TEST_SUITE("solver")
+{
+    TEST_CASE("minimal_change")
+    {
+        ChannelContext channel_context = {};
+
+        SUBCASE("Unrelated packages are kept")
+        {
+            for (const bool minimal_change : { false, true })
+            {
+                CAPTURE(minimal_change);
+                auto solver = make_solver(channel_context, minimal_change);
+                solver.add_jobs({ "plugin" }, SOLVER_INSTALL);
+                REQUIRE(solver.try_solve());
+                const auto expected = std::vector<std::string>{
+                    "app-1.0-bld",
+                    "lib-1.0-bld",
+                    "plugin-1.0-bld",
+                    "tool-1.0-bld",
+                };
+                CHECK_EQ(solution(solver), expected);
+            }
+        }
+
+        SUBCASE("Packages requiring the specs can change")
+        {
+            auto solver = make_solver(channel_context, true);
+            solver.add_jobs({ "lib >=2" }, SOLVER_INSTALL);
+            REQUIRE(solver.try_solve());
+            const auto expected = std::vector<std::string>{
+                "app-2.0-bld",
+                "lib-2.0-bld",
+                "tool-1.0-bld",
+            };
+            CHECK_EQ(solution(solver), expected);
+        }
+
+        SUBCASE("Solved again without the locks")
+        {
+            // The locked app requires the old lib
+            auto solver = make_solver(channel_context, true);
+            solver.add_jobs({ "new-plugin" }, SOLVER_INSTALL);
+            REQUIRE(solver.try_solve());
+            const auto expected = std::vector<std::string>{
+                "app-2.0-bld",
+                "lib-2.0-bld",
+                "new-plugin-1.0-bld",
+                "tool-1.0-bld",
+            };
+            CHECK_EQ(solution(solver), expected);
+        }
+    }
+
+    TEST_CASE("portfolio")
+    {
+        ChannelContext channel_context = {};
+        auto pool = MPool{ channel_context };
+        MRepo(pool, "preferred", { mkpkg("foo", "1.0") }).set_priority(1, 0);
+        MRepo(pool, "other", { mkpkg("foo", "2.0") }).set_priority(0, 0);
+
+        const auto strategies = SolverPortfolio::default_strategies({
+            { SOLVER_FLAG_STRICT_REPO_PRIORITY, 1 },
+        });
+        REQUIRE_EQ(strategies.size(), 3);
+        for (const auto& flags : strategies)
+        {
+            // Only the heuristics differ
+            CHECK_EQ(flags.front().first, SOLVER_FLAG_STRICT_REPO_PRIORITY);
+            CHECK_EQ(flags.front().second, 1);
+        }
+
+        SUBCASE("Solutions honor the configured flags")
+        {
+            auto portfolio = SolverPortfolio(
+                pool,
+                strategies,
+                [](MSolver& solver) { solver.add_jobs({ "foo" }, SOLVER_INSTALL); }
+            );
+            CHECK_EQ(portfolio.strategy(), 0);
+            REQUIRE(portfolio.try_solve());
+            CHECK(portfolio.solver().is_solved());
+            CHECK_EQ(solution(portfolio.solver()), std::vector<std::string>{ "foo-1.0-bld" });
+        }
+
+        SUBCASE("No other strategy drops the channel priority")
+        {
+            // Only found without the strict channel priority
+            auto portfolio = SolverPortfolio(
+                pool,
+                strategies,
+                [](MSolver& solver) { solver.add_jobs({ "foo >=2" }, SOLVER_INSTALL); }
+            );
+            CHECK_FALSE(portfolio.try_solve());
+            CHECK_EQ(portfolio.strategy(), 0);
+        }
+
+        SUBCASE("The problems of the first strategy are kept")
+        {
+            auto portfolio = SolverPortfolio(
+                pool,
+                strategies,
+                [](MSolver& solver) { solver.add_jobs({ "foo >=3" }, SOLVER_INSTALL); }
+            );
+            CHECK_FALSE(portfolio.try_solve());
+            CHECK_EQ(portfolio.strategy(), 0);
+            CHECK_FALSE(portfolio.solver().all_problems().empty());
+        }
+
+        SUBCASE("Losers are waited for when the portfolio is destroyed")
+        {
+            // The other strategies are held in the libsolv log of their solve until released
+            auto release = std::promise<void>();
+            const auto released = release.get_future().share();
+            const auto setup_thread = std::this_thread::get_id();
+            std::size_t n_setup = 0;
+            auto portfolio = std::make_unique<SolverPortfolio>(
+                pool,
+                strategies,
+                [&](MSolver& solver)
+                {
+                    solver.add_jobs({ "foo" }, SOLVER_INSTALL);
+                    if (n_setup++ == 0)
+                    {
+                        return;
+                    }
+                    pool_setdebuglevel(solver.pool().pool().raw(), 1);
+                    solver.pool().pool().set_debug_callback(
+                        [released, setup_thread](::Pool*, int, std::string_view) noexcept
+                        {
+                            if (std::this_thread::get_id() != setup_thread)
+                            {
+                                released.wait();
+                            }
+                        }
+                    );
+                }
+            );
+            REQUIRE(portfolio->try_solve());
+            CHECK_EQ(portfolio->strategy(), 0);
+
+            auto destroyed = std::async(std::launch::async, [&]() { portfolio.reset(); });
+            CHECK_EQ(
+                destroyed.wait_for(std::chrono::milliseconds(100)),
+                std::future_status::timeout
+            );
+            release.set_value();
+            destroyed.get();
+            CHECK_EQ(portfolio, nullptr);
+        }
+    }
+}
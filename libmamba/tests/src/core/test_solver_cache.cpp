@@ -0,0 +1,180 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <solv/solver.h>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/context.hpp"
+#include "mamba/core/package_info.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/solver.hpp"
+#include "mamba/core/util.hpp"
+
+#include "core/solver_cache.hpp"
+#include "solv-cpp/pool.hpp"
+#include "solv-cpp/queue.hpp"
+
+using namespace mamba;
+
+namespace
+{
+    auto mkpkg(std::string name, std::string version, std::vector<std::string> dependencies = {})
+        -> PackageInfo
+    {
+        auto pkg = PackageInfo(std::move(name));
+        pkg.version = std::move(version);
+        pkg.depends = std::move(dependencies);
+        pkg.build_string = "bld";
+        return pkg;
+    }
+
+    auto packages() -> std::vector<PackageInfo>
+    {
+        return {
+            mkpkg("foo", "1.0", { "bar" }),
+            mkpkg("foo", "2.0", { "bar>=2" }),
+            mkpkg("bar", "1.0"),
+            mkpkg("bar", "2.0"),
+        };
+    }
+
+    auto make_solver(ChannelContext& channel_context, const std::vector<PackageInfo>& pkgs)
+        -> MSolver
+    {
+        auto pool = MPool{ channel_context };
+        MRepo(pool, "some-name", pkgs);
+        auto solver = MSolver(std::move(pool), { { SOLVER_FLAG_ALLOW_DOWNGRADE, 1 } });
+        solver.add_jobs({ "foo" }, SOLVER_INSTALL);
+        return solver;
+    }
+
+    /** Enable the solver cache in a temporary package cache. */
+    struct solver_cache_guard
+    {
+        TemporaryDirectory pkgs_dir = {};
+        std::vector<fs::u8path> old_pkgs_dirs = Context::instance().pkgs_dirs;
+        bool old_solver_cache = Context::instance().solver_cache;
+
+        solver_cache_guard()
+        {
+            Context::instance().pkgs_dirs = { pkgs_dir.path() };
+            Context::instance().solver_cache = true;
+        }
+
+        ~solver_cache_guard()
+        {
+            Context::instance().pkgs_dirs = old_pkgs_dirs;
+            Context::instance().solver_cache = old_solver_cache;
+        }
+    };
+}
+
+TEST_SUITE("solver_cache")
+{
+    TEST_CASE("make_key")
+    {
+        ChannelContext channel_context = {};
+        auto pool = MPool{ channel_context };
+        MRepo(pool, "some-name", packages());
+        pool.create_whatprovides();
+        auto& opool = pool.pool();
+
+        const auto jobs = solv::ObjQueue{
+            SOLVER_INSTALL | SOLVER_SOLVABLE_PROVIDES,
+            opool.add_conda_dependency("foo"),
+        };
+        const auto key = SolverCache::make_key(opool, jobs, {}, { "foo" });
+        CHECK_EQ(key, SolverCache::make_key(opool, jobs, {}, { "foo" }));
+
+        const auto other_jobs = solv::ObjQueue{
+            SOLVER_INSTALL | SOLVER_SOLVABLE_PROVIDES,
+            opool.add_conda_dependency("bar"),
+        };
+        CHECK_NE(key, SolverCache::make_key(opool, other_jobs, {}, { "foo" }));
+        const auto flags = std::vector{ std::pair{ SOLVER_FLAG_ALLOW_DOWNGRADE, 1 } };
+        CHECK_NE(key, SolverCache::make_key(opool, jobs, flags, { "foo" }));
+        CHECK_NE(key, SolverCache::make_key(opool, jobs, {}, { "foo>1" }));
+
+        // Repos without metadata are identified by their content
+        auto other_pkgs = packages();
+        other_pkgs.back().depends.push_back("baz");
+        auto other_pool = MPool{ channel_context };
+        MRepo(other_pool, "some-name", other_pkgs);
+        other_pool.create_whatprovides();
+        const auto other_pool_jobs = solv::ObjQueue{
+            SOLVER_INSTALL | SOLVER_SOLVABLE_PROVIDES,
+            other_pool.pool().add_conda_dependency("foo"),
+        };
+        CHECK_NE(key, SolverCache::make_key(other_pool.pool(), other_pool_jobs, {}, { "foo" }));
+    }
+
+    TEST_CASE("store_load")
+    {
+        ChannelContext channel_context = {};
+        auto pool = MPool{ channel_context };
+        MRepo(pool, "some-name", packages());
+        const auto tmp_dir = TemporaryDirectory();
+        const auto cache = SolverCache(tmp_dir.path() / "solver");
+
+        CHECK_FALSE(cache.load("key", pool.pool()).has_value());
+
+        const auto decision = solv::ObjQueue{ 2, -3 };
+        cache.store("key", pool.pool(), decision);
+        const auto loaded = cache.load("key", pool.pool());
+        REQUIRE(loaded.has_value());
+        CHECK_EQ(loaded.value(), decision);
+
+        // Solvables with other ids do not match
+        auto other_pkgs = packages();
+        std::swap(other_pkgs.front(), other_pkgs.back());
+        auto other_pool = MPool{ channel_context };
+        MRepo(other_pool, "some-name", other_pkgs);
+        CHECK_FALSE(cache.load("key", other_pool.pool()).has_value());
+    }
+
+    TEST_CASE("solver")
+    {
+        auto guard = solver_cache_guard();
+        ChannelContext channel_context = {};
+
+        auto solver = make_solver(channel_context, packages());
+        REQUIRE(solver.try_solve());
+        CHECK_EQ(solver.cached_decision(), nullptr);
+
+        auto cached_solver = make_solver(channel_context, packages());
+        REQUIRE(cached_solver.try_solve());
+        REQUIRE_NE(cached_solver.cached_decision(), nullptr);
+        CHECK(cached_solver.is_solved());
+
+        auto installed = std::vector<std::string>();
+        for (auto id : *cached_solver.cached_decision())
+        {
+            if (id > 0)
+            {
+                auto pkg = cached_solver.pool().id2pkginfo(id);
+                REQUIRE(pkg.has_value());
+                installed.push_back(pkg->str());
+            }
+        }
+        std::sort(installed.begin(), installed.end());
+        const auto expected = std::vector<std::string>{ "bar-2.0-bld", "foo-2.0-bld" };
+        CHECK_EQ(installed, expected);
+
+        // Other packages are solved again
+        auto other_pkgs = packages();
+        other_pkgs.pop_back();
+        auto other_solver = make_solver(channel_context, other_pkgs);
+        REQUIRE(other_solver.try_solve());
+        CHECK_EQ(other_solver.cached_decision(), nullptr);
+    }
+}
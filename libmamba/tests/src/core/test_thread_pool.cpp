@@ -0,0 +1,153 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "core/parallel.hpp"
+#include "core/thread_pool.hpp"
+
+using namespace mamba;
+
+TEST_SUITE("thread_pool")
+{
+    TEST_CASE("Submitted tasks are executed")
+    {
+        auto pool = ThreadPool(4);
+        CHECK_EQ(pool.size(), 4);
+        std::atomic<std::size_t> count = 0;
+        for (std::size_t i = 0; i < 100; ++i)
+        {
+            pool.submit([&count]() { ++count; });
+        }
+        // Tasks submitted from a worker and throwing tasks
+        pool.submit([&]() { pool.submit([&count]() { ++count; }); });
+        pool.submit([]() { throw std::runtime_error("failed"); });
+        pool.wait_idle();
+        CHECK_EQ(count, 101);
+
+        const auto stats = pool.stats();
+        CHECK_EQ(stats.submitted, 103);
+        CHECK_EQ(stats.executed, 103);
+        CHECK_EQ(stats.cancelled, 0);
+        CHECK_EQ(stats.rejected, 0);
+
+        pool.close();
+        CHECK_FALSE(pool.try_submit([&count]() { ++count; }));
+        // Run by the caller instead
+        pool.submit([&count]() { ++count; });
+        CHECK_EQ(count, 102);
+        CHECK_EQ(pool.stats().rejected, 2);
+    }
+
+    TEST_CASE("Higher priority tasks are started first")
+    {
+        auto pool = ThreadPool(1);
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool started = false;
+        bool blocked = true;
+        // Keep the only worker busy while queueing
+        pool.submit(
+            [&]()
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                started = true;
+                cv.notify_all();
+                cv.wait(lock, [&]() { return !blocked; });
+            }
+        );
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return started; });
+        }
+
+        auto order = std::vector<TaskPriority>();
+        for (const auto priority : { TaskPriority::low, TaskPriority::normal, TaskPriority::high })
+        {
+            pool.submit([&order, priority]() { order.push_back(priority); }, priority);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            blocked = false;
+        }
+        cv.notify_all();
+        pool.wait_idle();
+
+        const auto expected = std::vector<TaskPriority>{
+            TaskPriority::high,
+            TaskPriority::normal,
+            TaskPriority::low,
+        };
+        CHECK_EQ(order, expected);
+    }
+
+    TEST_CASE("Full queues refuse tasks")
+    {
+        auto pool = ThreadPool(1, 1);
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool started = false;
+        bool blocked = true;
+        pool.submit(
+            [&]()
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                started = true;
+                cv.notify_all();
+                cv.wait(lock, [&]() { return !blocked; });
+            }
+        );
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return started; });
+        }
+
+        CHECK(pool.try_submit([]() {}));
+        CHECK_FALSE(pool.try_submit([]() {}));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            blocked = false;
+        }
+        cv.notify_all();
+        pool.wait_idle();
+        CHECK_EQ(pool.stats().executed, 2);
+        CHECK_EQ(pool.stats().rejected, 1);
+    }
+
+    TEST_CASE("parallel_for")
+    {
+        auto done = std::vector<std::atomic<int>>(1000);
+        parallel_for(done.size(), 8, [&done](std::size_t i) { ++done[i]; });
+        for (const auto& d : done)
+        {
+            CHECK_EQ(d, 1);
+        }
+
+        // Nested loops from the workers of the pool
+        std::atomic<std::size_t> count = 0;
+        parallel_for(
+            10,
+            4,
+            [&count](std::size_t) { parallel_for(10, 4, [&count](std::size_t) { ++count; }); }
+        );
+        CHECK_EQ(count, 100);
+
+        const auto throwing = [](std::size_t i)
+        {
+            if (i == 50)
+            {
+                throw std::runtime_error("failed");
+            }
+        };
+        CHECK_THROWS_AS(parallel_for(100, 4, throwing), std::runtime_error);
+    }
+}
@@ -4,6 +4,7 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <chrono>
 #include <iostream>
 
 #include <doctest/doctest.h>
@@ -94,4 +95,22 @@ namespace mamba
         }
     }
 #endif
+
+    TEST_SUITE("thread_utils")
+    {
+        TEST_CASE("interruption_deadline")
+        {
+            REQUIRE_FALSE(is_sig_interrupted());
+            set_interruption_deadline(std::chrono::steady_clock::now() + std::chrono::hours(1));
+            CHECK_FALSE(is_sig_interrupted());
+            CHECK_NOTHROW(interruption_point());
+
+            set_interruption_deadline(std::chrono::steady_clock::now());
+            CHECK(is_sig_interrupted());
+            CHECK_THROWS_AS(interruption_point(), thread_interrupted);
+
+            clear_interruption_deadline();
+            CHECK_FALSE(is_sig_interrupted());
+        }
+    }
 }  // namespace mamba
@@ -0,0 +1,114 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/core/tracing.hpp"
+#include "mamba/core/util.hpp"
+
+using namespace mamba;
+
+TEST_SUITE("tracing")
+{
+    TEST_CASE("Tracer")
+    {
+        auto tracer = Tracer();
+
+        SUBCASE("Disabled")
+        {
+            {
+                auto scope = tracer.scope("solve");
+                scope.add_counter("rules", 3);
+            }
+            CHECK(tracer.spans().empty());
+        }
+
+        SUBCASE("Enabled")
+        {
+            tracer.set_enabled(true);
+            {
+                auto outer = tracer.scope("outer");
+                {
+                    auto inner = tracer.scope("inner");
+                    inner.add_counter("rules", 3);
+                }
+            }
+
+            const auto spans = tracer.spans();
+            REQUIRE_EQ(spans.size(), 2);
+            CHECK_EQ(spans[0].name, "inner");
+            CHECK_EQ(spans[1].name, "outer");
+            CHECK_LE(spans[1].start, spans[0].start);
+            CHECK_GE(spans[1].duration, spans[0].duration);
+            REQUIRE_EQ(spans[0].counters.size(), 1);
+            CHECK_EQ(spans[0].counters[0].first, "rules");
+            CHECK_EQ(spans[0].counters[0].second, 3);
+
+            const auto j = tracer.to_json();
+            REQUIRE_EQ(j.size(), 2);
+            CHECK_EQ(j[0]["name"], "inner");
+            CHECK_EQ(j[0]["rules"], 3);
+            CHECK(j[1]["duration_ms"].is_number());
+
+            auto tmp = TemporaryFile();
+            tracer.write_chrome_trace(tmp.path());
+            auto in = open_ifstream(tmp.path());
+            const auto trace = nlohmann::json::parse(in);
+            const auto& events = trace.at("traceEvents");
+            REQUIRE_EQ(events.size(), 2);
+            CHECK_EQ(events[0]["ph"], "X");
+            CHECK_EQ(events[0]["args"]["rules"], 3);
+            CHECK_EQ(events[1]["dur"], spans[1].duration.count());
+
+            tracer.clear();
+            CHECK(tracer.spans().empty());
+        }
+
+        SUBCASE("Span without scope")
+        {
+            const auto end = Tracer::clock::now();
+            tracer.add_span("download", end - std::chrono::milliseconds(5), end);
+            CHECK(tracer.spans().empty());
+
+            tracer.set_enabled(true);
+            tracer.add_span("download", end - std::chrono::milliseconds(5), end, { { "bytes", 42 } });
+            const auto spans = tracer.spans();
+            REQUIRE_EQ(spans.size(), 1);
+            CHECK_EQ(spans[0].name, "download");
+            CHECK_EQ(spans[0].duration, std::chrono::milliseconds(5));
+            REQUIRE_EQ(spans[0].counters.size(), 1);
+            CHECK_EQ(spans[0].counters[0].second, 42);
+        }
+
+        SUBCASE("Phase")
+        {
+            tracer.set_enabled(true);
+            const auto start = Tracer::clock::now();
+            const auto ms = [&](int n) { return start + std::chrono::milliseconds(n); };
+            tracer.add_span("download a", ms(0), ms(10), { { "bytes", 100 } });
+            tracer.add_span("fetch", ms(20), ms(60));
+            // Overlapping transfers
+            tracer.add_span("download b", ms(25), ms(40), { { "bytes", 10 } });
+            tracer.add_span("download c", ms(30), ms(45), { { "bytes", 20 } });
+            tracer.add_span("download d", ms(50), ms(55));
+            tracer.add_span("extract b", ms(40), ms(50));
+
+            const auto all = tracer.phase("download ");
+            CHECK_EQ(all.count, 4);
+            CHECK_EQ(all.bytes, 130);
+            CHECK_EQ(all.wall_time, std::chrono::milliseconds(35));
+
+            const auto fetched = tracer.phase("download ", "fetch");
+            CHECK_EQ(fetched.count, 3);
+            CHECK_EQ(fetched.bytes, 30);
+            CHECK_EQ(fetched.wall_time, std::chrono::milliseconds(25));
+
+            CHECK_EQ(tracer.phase("link ").count, 0);
+            CHECK_EQ(tracer.phase("download ", "solve").count, 0);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+
+#include <doctest/doctest.h>
+
+#include "mamba/core/transaction_context.hpp"
+
+using namespace mamba;
+
+TEST_SUITE("transaction_context")
+{
+    TEST_CASE("noarch_python_paths")
+    {
+        const auto site_packages = get_python_site_packages_short_path("3.11");
+        const auto paths = NoarchPythonPaths(site_packages, "3.11");
+
+        SUBCASE("Same target paths as get_python_noarch_target_path")
+        {
+            for (const std::string source : {
+                     "site-packages/pkg/__init__.py",
+                     "site-packages/pkg-1.0.dist-info/METADATA",
+                     "python-scripts/tool",
+                     "info/index.json",
+                     "site-packages",
+                 })
+            {
+                CAPTURE(source);
+                CHECK_EQ(
+                    paths.target_path(source),
+                    get_python_noarch_target_path(source, site_packages).string()
+                );
+            }
+        }
+
+        SUBCASE("Compiled files")
+        {
+            const auto py_file = (site_packages / "pkg" / "mod.py").string();
+            CHECK_EQ(
+                paths.pyc_path(py_file),
+                (site_packages / "pkg" / "__pycache__" / "mod.cpython-311.pyc").string()
+            );
+            CHECK_EQ(
+                paths.pyc_path("mod.py"),
+                (fs::u8path("__pycache__") / "mod.cpython-311.pyc").string()
+            );
+            CHECK_EQ(
+                NoarchPythonPaths(get_python_site_packages_short_path("2.7"), "2.7")
+                    .pyc_path("lib/mod.py"),
+                "lib/mod.pyc"
+            );
+        }
+    }
+}
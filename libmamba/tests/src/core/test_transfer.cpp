@@ -5,15 +5,51 @@
 // The full license is in the file LICENSE, distributed with this software.
 
 #include <array>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <doctest/doctest.h>
+#include <zstd.h>
 
+#include "mamba/core/context.hpp"
+#include "mamba/core/fetch.hpp"
 #include "mamba/core/subdirdata.hpp"
 
+#include "core/curl.hpp"
+
 namespace mamba
 {
     TEST_SUITE("transfer")
     {
+        TEST_CASE("CURLHandlePool")
+        {
+            auto pool = CURLHandlePool(1);
+            auto first = pool.acquire();
+            auto second = pool.acquire();
+            const auto* first_ptr = first.get();
+            first->add_header("X-Test: 1").set_opt_header();
+            pool.release(std::move(first));
+            pool.release(std::move(second));
+            // Handles above the maximum size are dropped
+            CHECK_EQ(pool.size(), 1);
+
+            auto reused = pool.acquire();
+            CHECK_EQ(reused.get(), first_ptr);
+            CHECK_EQ(pool.size(), 0);
+            CHECK_EQ(std::string(reused->get_error_buffer()), "");
+
+            // Handles are not reused while in a multi handle
+            auto multi = CURLMultiHandle(1);
+            multi.add_handle(*reused);
+            multi.remove_handle(*reused);
+            auto in_multi = pool.acquire();
+            multi.add_handle(*in_multi);
+            pool.release(std::move(reused));
+            pool.release(std::move(in_multi));
+            CHECK_EQ(pool.size(), 1);
+        }
+
         TEST_CASE("file_not_exist")
         {
 #ifdef __linux__
@@ -60,5 +96,274 @@ namespace mamba
             Context::instance().output_params.quiet = false;
 #endif
         }
+
+        TEST_CASE("DownloadConcurrency")
+        {
+            auto concurrency = DownloadConcurrency(4, 8);
+            CHECK_EQ(concurrency.limit(), 4);
+
+            SUBCASE("Grows with the throughput")
+            {
+                concurrency.update(1000);
+                CHECK_EQ(concurrency.limit(), 5);
+                concurrency.update(2000);
+                CHECK_EQ(concurrency.limit(), 6);
+                // Not enough of an improvement
+                concurrency.update(2100);
+                CHECK_EQ(concurrency.limit(), 6);
+                for (std::size_t throughput : { 3000, 4000, 5000, 6000 })
+                {
+                    concurrency.update(throughput);
+                }
+                CHECK_EQ(concurrency.limit(), 8);
+            }
+
+            SUBCASE("Backs off on stalls")
+            {
+                // No data yet while connecting
+                concurrency.update(0);
+                CHECK_EQ(concurrency.limit(), 4);
+                concurrency.update(1000);
+                concurrency.update(0);
+                CHECK_EQ(concurrency.limit(), 2);
+            }
+
+            SUBCASE("Backs off once per period")
+            {
+                concurrency.back_off();
+                concurrency.back_off();
+                CHECK_EQ(concurrency.limit(), 2);
+                concurrency.update(500);
+                concurrency.back_off();
+                concurrency.back_off();
+                CHECK_EQ(concurrency.limit(), 1);
+                concurrency.update(500);
+                concurrency.back_off();
+                CHECK_EQ(concurrency.limit(), 1);
+            }
+        }
+
+        TEST_CASE("schedule_downloads")
+        {
+            std::vector<std::unique_ptr<DownloadTarget>> storage;
+            std::vector<DownloadTarget*> targets;
+            for (std::size_t size : { 3, 50, 1, 4, 200, 2, 100 })
+            {
+                storage.push_back(std::make_unique<DownloadTarget>(
+                    std::to_string(size),
+                    "file:///nonexistent/" + std::to_string(size),
+                    "/tmp/nonexistent"
+                ));
+                storage.back()->set_expected_size(size);
+                targets.push_back(storage.back().get());
+            }
+            auto sizes = [&]()
+            {
+                std::vector<std::size_t> out;
+                for (const auto* t : targets)
+                {
+                    out.push_back(t->get_expected_size());
+                }
+                return out;
+            };
+
+            SUBCASE("Largest first on all slots")
+            {
+                schedule_downloads(targets, 2);
+                const auto expected = std::vector<std::size_t>{ 200, 100, 1, 50, 2, 4, 3 };
+                CHECK_EQ(sizes(), expected);
+            }
+
+            SUBCASE("More slots than targets")
+            {
+                schedule_downloads(targets, 10);
+                const auto expected = std::vector<std::size_t>{ 200, 100, 50, 4, 3, 2, 1 };
+                CHECK_EQ(sizes(), expected);
+            }
+        }
+
+        TEST_CASE("hash_on_write")
+        {
+            auto tmp_dir = TemporaryDirectory();
+            const auto source = tmp_dir.path() / "source.txt";
+            open_ofstream(source) << "test";
+
+            auto target = DownloadTarget(
+                "source",
+                "file://" + source.string(),
+                (tmp_dir.path() / "dest.txt").string()
+            );
+            target.set_hash(validation::HashStream::sha256());
+            CHECK_FALSE(target.get_hex_digest().has_value());
+
+            auto multi_dl = MultiDownloadTarget();
+            multi_dl.add(&target);
+            REQUIRE(multi_dl.download(MAMBA_DOWNLOAD_FAILFAST));
+            REQUIRE(target.get_hex_digest().has_value());
+            CHECK_EQ(
+                target.get_hex_digest().value(),
+                "9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08"
+            );
+        }
+
+        TEST_CASE("decompress_on_write")
+        {
+            auto tmp_dir = TemporaryDirectory();
+            const auto data = std::string(R"({"info": {"subdir": "linux-64"}, "packages": {}})");
+            std::string compressed(ZSTD_compressBound(data.size()), '\0');
+            compressed.resize(
+                ZSTD_compress(compressed.data(), compressed.size(), data.data(), data.size(), 3)
+            );
+            const auto source = tmp_dir.path() / "repodata.json.zst";
+            open_ofstream(source) << compressed;
+
+            const auto dest = tmp_dir.path() / "repodata.json";
+            auto target = DownloadTarget("source", "file://" + source.string(), dest.string());
+            auto multi_dl = MultiDownloadTarget();
+            multi_dl.add(&target);
+            REQUIRE(multi_dl.download(MAMBA_DOWNLOAD_FAILFAST));
+
+            // Buffered until the end of the transfer
+            auto in = open_ifstream(dest);
+            const auto written = std::string(std::istreambuf_iterator<char>(in), {});
+            CHECK_EQ(written, data);
+        }
+
+        TEST_CASE("direct_write")
+        {
+            auto& ctx = Context::instance();
+            const auto direct_write = ctx.remote_fetch_params.download_direct_write;
+            ctx.remote_fetch_params.download_direct_write = true;
+
+            auto tmp_dir = TemporaryDirectory();
+            // Larger than the buffer, and not a multiple of its size
+            auto data = std::string((3 << 20) + 7, '\0');
+            for (std::size_t i = 0; i < data.size(); ++i)
+            {
+                data[i] = static_cast<char>('a' + (i % 26));
+            }
+            const auto source = tmp_dir.path() / "source.txt";
+            open_ofstream(source) << data;
+
+            const auto dest = tmp_dir.path() / "dest.txt";
+            auto target = DownloadTarget("source", "file://" + source.string(), dest.string());
+            target.set_expected_size(data.size());
+            auto multi_dl = MultiDownloadTarget();
+            multi_dl.add(&target);
+            REQUIRE(multi_dl.download(MAMBA_DOWNLOAD_FAILFAST));
+            ctx.remote_fetch_params.download_direct_write = direct_write;
+
+            CHECK_EQ(fs::file_size(dest), data.size());
+            auto in = open_ifstream(dest);
+            const auto written = std::string(std::istreambuf_iterator<char>(in), {});
+            CHECK(written == data);
+        }
+
+        TEST_CASE("resumable")
+        {
+            auto tmp_dir = TemporaryDirectory();
+            const auto source = tmp_dir.path() / "source.txt";
+            open_ofstream(source) << "test";
+            const auto dest = tmp_dir.path() / "dest.txt";
+            const auto url = "file://" + source.string();
+
+            auto target = DownloadTarget("source", url, dest.string());
+            target.set_hash(validation::HashStream::sha256());
+
+            SUBCASE("Complete download")
+            {
+                target.set_resumable(true);
+            }
+
+            SUBCASE("Partial data is not resumed without ranges")
+            {
+                open_ofstream(dest.string() + DOWNLOAD_PARTIAL_EXTENSION) << "te";
+                open_ofstream(dest.string() + DOWNLOAD_PARTIAL_EXTENSION ".json")
+                    << R"({"url": ")" << url << R"(", "validator": "\"etag\""})";
+                target.set_resumable(true);
+            }
+
+            auto multi_dl = MultiDownloadTarget();
+            multi_dl.add(&target);
+            REQUIRE(multi_dl.download(MAMBA_DOWNLOAD_FAILFAST));
+            CHECK_EQ(target.get_downloaded_size(), 4);
+            CHECK_EQ(
+                target.get_hex_digest().value(),
+                "9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08"
+            );
+            CHECK_EQ(validation::sha256sum(dest), target.get_hex_digest().value());
+            CHECK_FALSE(fs::exists(dest.string() + DOWNLOAD_PARTIAL_EXTENSION));
+            CHECK_FALSE(fs::exists(dest.string() + DOWNLOAD_PARTIAL_EXTENSION ".json"));
+        }
+
+        TEST_CASE("split")
+        {
+            auto tmp_dir = TemporaryDirectory();
+            const auto dest = (tmp_dir.path() / "dest.txt").string();
+
+            SUBCASE("Over HTTP")
+            {
+                auto target = DownloadTarget("source", "https://example.com/source.txt", dest);
+                target.set_expected_size(10);
+                CHECK(target.split(1).empty());
+
+                const auto& chunks = target.split(3);
+                REQUIRE_EQ(chunks.size(), 3);
+                CHECK_EQ(target.get_chunks().size(), 3);
+                CHECK_EQ(chunks[0]->get_expected_size(), 3);
+                CHECK_EQ(chunks[1]->get_expected_size(), 3);
+                CHECK_EQ(chunks[2]->get_expected_size(), 4);
+                // Preallocated for the chunks to be written at their offset
+                CHECK_EQ(fs::file_size(dest), 10);
+
+                target.merge_chunks();
+                CHECK(target.get_chunks().empty());
+                CHECK_FALSE(fs::exists(dest));
+            }
+
+            SUBCASE("Without ranges")
+            {
+                auto target = DownloadTarget("source", "file:///nonexistent/source.txt", dest);
+                target.set_expected_size(10);
+                CHECK(target.split(3).empty());
+                CHECK_FALSE(fs::exists(dest));
+            }
+        }
+
+        TEST_CASE("mirrors")
+        {
+            auto& ctx = Context::instance();
+            ctx.channel_mirrors = {
+                { "https://conda.anaconda.org/conda-forge/",
+                  { "https://eu.example.com/conda-forge", "https://us.example.com/cf/" } },
+            };
+
+            SUBCASE("Files of a mirrored channel")
+            {
+                auto target = DownloadTarget(
+                    "pkg",
+                    "https://conda.anaconda.org/conda-forge/linux-64/pkg-1.0-0.tar.bz2",
+                    "/tmp/nonexistent"
+                );
+                const auto expected = std::vector<std::string>{
+                    "https://conda.anaconda.org/conda-forge/linux-64/pkg-1.0-0.tar.bz2",
+                    "https://eu.example.com/conda-forge/linux-64/pkg-1.0-0.tar.bz2",
+                    "https://us.example.com/cf/linux-64/pkg-1.0-0.tar.bz2",
+                };
+                CHECK_EQ(target.get_mirror_urls(), expected);
+                CHECK_EQ(target.get_url(), expected[0]);
+                target.set_mirror(2);
+                CHECK_EQ(target.get_url(), expected[2]);
+            }
+
+            SUBCASE("Files of another channel")
+            {
+                const auto url = std::string("https://conda.anaconda.org/conda-forge-dev/pkg.conda");
+                auto target = DownloadTarget("pkg", url, "/tmp/nonexistent");
+                CHECK_EQ(target.get_mirror_urls(), std::vector<std::string>{ url });
+            }
+
+            ctx.channel_mirrors.clear();
+        }
     }
 }  // namespace mamba
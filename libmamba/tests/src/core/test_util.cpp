@@ -169,6 +169,68 @@ namespace mamba
                 CHECK(path::is_writable(existing_file_path));
             }
         }
+
+        TEST_CASE("clone_file")
+        {
+            const auto test_dir_path = fs::temp_directory_path() / "libmamba" / "clone_tests";
+            fs::create_directories(test_dir_path);
+            on_scope_exit _{ [&] { fs::remove_all(test_dir_path); } };
+
+            const auto from = test_dir_path / "from.txt";
+            const auto to = test_dir_path / "to.txt";
+            open_ofstream(from) << "clone me";
+            fs::permissions(from, fs::perms::owner_read | fs::perms::owner_exec);
+
+            // Whether it is supported depends on the file system
+            std::error_code ec;
+            mamba_fs::clone_file(from, to, ec);
+            if (ec)
+            {
+                CHECK_FALSE(fs::exists(to));
+            }
+            else
+            {
+                CHECK_EQ(read_contents(to), "clone me");
+                CHECK_EQ(fs::status(to).permissions(), fs::status(from).permissions());
+
+                // The destination is never overwritten
+                mamba_fs::clone_file(from, to, ec);
+                CHECK(ec);
+            }
+        }
+
+        TEST_CASE("filesystem_info")
+        {
+            const auto tmp_dir = TemporaryDirectory();
+            std::error_code ec;
+            const auto info = mamba_fs::filesystem_info(tmp_dir.path(), ec);
+            if (ec != std::errc::operation_not_supported)
+            {
+                CHECK_FALSE(ec);
+                CHECK_FALSE(info.type.empty());
+            }
+
+            mamba_fs::filesystem_info(tmp_dir.path() / "missing", ec);
+            CHECK(ec);
+        }
+
+        TEST_CASE("write_contents")
+        {
+            const auto tmp_dir = TemporaryDirectory();
+            const auto file = tmp_dir.path() / "file.bin";
+            const auto contents = std::string("a\0b", 3);
+            write_contents(file, contents);
+            CHECK_EQ(read_contents(file), contents);
+
+            // Existing files are truncated
+            write_contents(file, "c");
+            CHECK_EQ(read_contents(file), "c");
+
+            CHECK_THROWS_AS(
+                write_contents(tmp_dir.path() / "missing" / "file", "c"),
+                std::system_error
+            );
+        }
     }
 
     TEST_SUITE("utils")
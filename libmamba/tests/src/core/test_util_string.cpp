@@ -5,8 +5,11 @@
 // The full license is in the file LICENSE, distributed with this software.
 
 #include <cstddef>
+#include <optional>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <vector>
 
 #include <doctest/doctest.h>
@@ -64,6 +67,26 @@ namespace mamba
             CHECK(contains("", ""));  // same as Python ``"" in ""``
         }
 
+        TEST_CASE("glob_match")
+        {
+            CHECK(glob_match("lib/libfoo.a", "lib/libfoo.a"));
+            CHECK_FALSE(glob_match("lib/libfoo.a", "lib/libfoo.so"));
+            CHECK(glob_match("lib/*.a", "lib/libfoo.a"));
+            CHECK_FALSE(glob_match("lib/*.a", "lib/sub/libfoo.a"));
+            CHECK_FALSE(glob_match("*.a", "lib/libfoo.a"));
+            CHECK(glob_match("lib/lib?oo.a", "lib/libfoo.a"));
+            CHECK_FALSE(glob_match("lib?libfoo.a", "lib/libfoo.a"));
+            CHECK(glob_match("include/**", "include/foo/bar.h"));
+            CHECK_FALSE(glob_match("include/**", "lib/include/bar.h"));
+            CHECK(glob_match("**/*.a", "lib/sub/libfoo.a"));
+            CHECK(glob_match("**/*.a", "libfoo.a"));
+            CHECK(glob_match("share/**/man/*", "share/man/foo.1"));
+            CHECK(glob_match("share/**/man/*", "share/a/b/man/foo.1"));
+            CHECK_FALSE(glob_match("share/**/man/*", "share/a/b/man/sub/foo.1"));
+            CHECK(glob_match("", ""));
+            CHECK_FALSE(glob_match("", "a"));
+        }
+
         TEST_CASE("any_starts_with")
         {
             using StrVec = std::vector<std::string_view>;
@@ -319,6 +342,49 @@ namespace mamba
             CHECK_EQ(rsplit("conda-forge/linux64::xtensor==0.12.3", ":", 1), v21);
         }
 
+        TEST_CASE("split_once")
+        {
+            using Out = std::tuple<std::string_view, std::optional<std::string_view>>;
+
+            CHECK_EQ(split_once("", '/'), Out{ "", std::nullopt });
+            CHECK_EQ(split_once("/", '/'), Out{ "", "" });
+            CHECK_EQ(split_once("hello/world", '/'), Out{ "hello", "world" });
+            CHECK_EQ(split_once("hello/my/world", '/'), Out{ "hello", "my/world" });
+            CHECK_EQ(split_once("hello::my::world", "::"), Out{ "hello", "my::world" });
+            CHECK_EQ(split_once("hello", "::"), Out{ "hello", std::nullopt });
+        }
+
+        TEST_CASE("rsplit_once")
+        {
+            using Out = std::tuple<std::optional<std::string_view>, std::string_view>;
+
+            CHECK_EQ(rsplit_once("", '/'), Out{ std::nullopt, "" });
+            CHECK_EQ(rsplit_once("/", '/'), Out{ "", "" });
+            CHECK_EQ(rsplit_once("hello/world", '/'), Out{ "hello", "world" });
+            CHECK_EQ(rsplit_once("hello/my/world", '/'), Out{ "hello/my", "world" });
+            CHECK_EQ(rsplit_once("hello::my::world", "::"), Out{ "hello::my", "world" });
+            CHECK_EQ(rsplit_once("hello", "::"), Out{ std::nullopt, "hello" });
+        }
+
+        TEST_CASE("split_for_each")
+        {
+            auto parts = std::vector<std::string_view>();
+            auto push_part = [&](std::string_view part) { parts.push_back(part); };
+
+            split_for_each("hello.again.it's.me", ".", push_part);
+            CHECK_EQ(parts, std::vector<std::string_view>{ "hello", "again", "it's", "me" });
+
+            parts.clear();
+            split_for_each("...", ".", push_part);
+            CHECK_EQ(parts, std::vector<std::string_view>{ "", "", "", "" });
+
+            parts.clear();
+            split_for_each("conda-forge::xtensor", "::", push_part);
+            CHECK_EQ(parts, std::vector<std::string_view>{ "conda-forge", "xtensor" });
+
+            CHECK_THROWS_AS(split_for_each("hello", "", push_part), std::invalid_argument);
+        }
+
         TEST_CASE("join")
         {
             {
@@ -368,6 +434,12 @@ namespace mamba
             replace_all(prefix, "/I/am/a/PREFIX", "/Yes/Thats/great/");
             CHECK(starts_with(prefix, "/Yes/Thats/great/\n"));
 
+            std::string overlapping = "aaaaa";
+            replace_all(overlapping, "aa", "b");
+            CHECK_EQ(overlapping, "bba");
+            replace_all(overlapping, "b", "aa");
+            CHECK_EQ(overlapping, "aaaaa");
+
             std::string testbuf2 = "this is another test wow";
             replace_all(testbuf2, "", "somereplacement");
             CHECK_EQ(testbuf2, "this is another test wow");
@@ -11,6 +11,7 @@
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 
+#include "mamba/core/context.hpp"
 #include "mamba/core/environment.hpp"
 #include "mamba/core/fsutil.hpp"
 #include "mamba/core/util_string.hpp"
@@ -38,6 +39,24 @@ namespace mamba::validation
                 CHECK_EQ(md5, "098f6bcd4621d373cade4e832627b4f6");
             }
 
+            TEST_CASE("HashStream")
+            {
+                auto sha256 = HashStream::sha256();
+                sha256.update("te", 2);
+                sha256.update("st", 2);
+                CHECK_EQ(
+                    sha256.hex_digest(),
+                    "9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08"
+                );
+
+                auto md5 = HashStream::md5();
+                md5.update("test", 4);
+                CHECK_EQ(md5.hex_digest(), "098f6bcd4621d373cade4e832627b4f6");
+                md5.reset();
+                md5.update("test", 4);
+                CHECK_EQ(md5.hex_digest(), "098f6bcd4621d373cade4e832627b4f6");
+            }
+
             TEST_CASE("ed25519_key_hex_to_bytes")
             {
                 std::array<unsigned char, MAMBA_ED25519_KEYSIZE_BYTES> pk, sk;
@@ -1364,6 +1383,26 @@ namespace mamba::validation
                     pkg_mgr.verify_index(signed_repodata_json);
                 }
 
+                TEST_CASE_FIXTURE(PkgMgrT_v06, "verify_packages")
+                {
+                    auto key_mgr = root->create_key_mgr(key_mgr_json);
+                    auto pkg_mgr = key_mgr.create_pkg_mgr(pkg_mgr_json);
+
+                    auto packages = std::vector<SignedPackage>();
+                    const auto& sigs = signed_repodata_json.at("signatures");
+                    for (const auto& it : signed_repodata_json.at("packages").items())
+                    {
+                        packages.push_back({ it.value(), sigs.at(it.key()).dump() });
+                    }
+                    pkg_mgr.verify_packages(packages, 2);
+
+                    packages.front().signed_data["version"] = "0.1.1";
+                    CHECK_THROWS_AS(pkg_mgr.verify_packages(packages, 2), package_error);
+
+                    packages.front().signatures = "{";
+                    CHECK_THROWS_AS(pkg_mgr.verify_packages(packages, 2), package_error);
+                }
+
                 TEST_CASE_FIXTURE(PkgMgrT_v06, "corrupted_repodata")
                 {
                     auto key_mgr = root->create_key_mgr(key_mgr_json);
@@ -1489,6 +1528,34 @@ namespace mamba::validation
                     CHECK_THROWS_AS(checker.generate_index_checker(), fetching_error);
                 }
 
+                TEST_CASE_FIXTURE(RepoCheckerT, "recently_checked_metadata")
+                {
+                    auto cache_dir = TemporaryDirectory();
+                    auto& ctx = Context::instance();
+                    const auto ttl = ctx.local_repodata_ttl;
+                    ctx.local_repodata_ttl = 3600;
+
+                    RepoChecker checker(m_repo_base_url, m_ref_path, cache_dir.path());
+                    checker.generate_index_checker();
+                    CHECK_EQ(checker.root_version(), 2);
+
+                    // Not requested again within the time-to-live
+                    fs::remove(channel_dir->path() / "2.root.json");
+                    fs::remove(channel_dir->path() / "key_mgr.json");
+                    fs::remove(channel_dir->path() / "pkg_mgr.json");
+                    RepoChecker cached_checker(m_repo_base_url, m_ref_path, cache_dir.path());
+                    cached_checker.generate_index_checker();
+                    CHECK_EQ(cached_checker.root_version(), 2);
+                    cached_checker.verify_index(signed_repodata_json);
+
+                    ctx.local_repodata_ttl = 0;
+                    RepoChecker refreshed_checker(m_repo_base_url, m_ref_path, cache_dir.path());
+                    refreshed_checker.generate_index_checker();
+                    CHECK_EQ(refreshed_checker.root_version(), 2);
+
+                    ctx.local_repodata_ttl = ttl;
+                }
+
                 TEST_CASE_FIXTURE(RepoCheckerT, "corrupted_repodata")
                 {
                     RepoChecker checker(m_repo_base_url, m_ref_path);
@@ -249,6 +249,43 @@ TEST_SUITE("ObjPool")
                         CHECK_EQ(whatprovides_ids, std::vector{ id1 });
                     }
                 }
+
+                SUBCASE("Restrict considered solvables")
+                {
+                    pool.set_considered_solvables({ id2 });
+                    CHECK_FALSE(pool.is_considered_solvable(id1));
+                    CHECK(pool.is_considered_solvable(id2));
+
+                    const auto whatprovides_name = [&]()
+                    {
+                        pool.create_whatprovides();
+                        auto ids = std::vector<SolvableId>();
+                        pool.for_each_whatprovides_id(
+                            pkg_name_id,
+                            [&](auto id) { ids.push_back(id); }
+                        );
+                        std::sort(ids.begin(), ids.end());  // Ease comparison
+                        return ids;
+                    };
+                    CHECK_EQ(whatprovides_name(), std::vector{ id2 });
+
+                    SUBCASE("Solvables added afterwards are considered")
+                    {
+                        auto [id3, s3] = repo1.add_solvable();
+                        s3.set_name(pkg_name_id);
+                        s3.set_version("3.0.0");
+                        s3.add_self_provide();
+                        CHECK(pool.is_considered_solvable(id3));
+                        CHECK_EQ(whatprovides_name(), std::vector{ id2, id3 });
+                    }
+
+                    SUBCASE("Consider all solvables again")
+                    {
+                        pool.reset_considered_solvables();
+                        CHECK(pool.is_considered_solvable(id1));
+                        CHECK_EQ(whatprovides_name(), std::vector{ id1, id2 });
+                    }
+                }
             }
         }
 
@@ -212,4 +212,28 @@ TEST_SUITE("ObjQueue")
         CHECK(q.contains(3));
         CHECK_FALSE(q.contains(0));
     }
+
+    TEST_CASE("ObjSmallQueue")
+    {
+        auto q = ObjSmallQueue<4>{ 1, 2 };
+        CHECK_EQ(q.size(), 2);
+        CHECK_EQ(q.front(), 1);
+        CHECK(q.is_inline());
+
+        q.push_back(3, 4);
+        CHECK(q.is_inline());
+        // Moved to the heap once the buffer is full
+        q.push_back(5);
+        CHECK_FALSE(q.is_inline());
+        const auto elems = std::vector<ObjQueue::value_type>(q.begin(), q.end());
+        const auto expected = std::vector<ObjQueue::value_type>{ 1, 2, 3, 4, 5 };
+        CHECK_EQ(elems, expected);
+        CHECK_EQ(q[4], 5);
+
+        q.clear();
+        CHECK(q.empty());
+        q.push_back(6);
+        CHECK_EQ(q.size(), 1);
+        CHECK_EQ(q.raw()->count, 1);
+    }
 }
@@ -6,6 +6,8 @@
 
 #include <algorithm>
 #include <array>
+#include <iterator>
+#include <string>
 
 #include <doctest/doctest.h>
 
@@ -87,6 +89,16 @@ TEST_SUITE("ObjRepo")
             CHECK_EQ(repo.solvable_count(), 2);
             CHECK(repo.has_solvable(id2));
 
+            SUBCASE("Add solvables at once")
+            {
+                const auto first_id = repo.add_solvables(3);
+                CHECK_EQ(repo.solvable_count(), 5);
+                for (SolvableId id = first_id; id < first_id + 3; ++id)
+                {
+                    CHECK(repo.has_solvable(id));
+                }
+            }
+
             SUBCASE("Retrieve repo from solvable")
             {
                 CHECK_EQ(ObjRepoViewConst::of_solvable(s1).raw(), repo.raw());
@@ -154,6 +166,27 @@ TEST_SUITE("ObjRepo")
                 CHECK_FALSE(repo.get_solvable(id1).has_value());
             }
 
+            SUBCASE("Write repo to buffer")
+            {
+                const auto data = repo.write_buffer();
+                CHECK_EQ(data.substr(0, 4), "SOLV");
+
+                SUBCASE("Read repo from buffer")
+                {
+                    // Delete repo
+                    const auto n_solvables = repo.solvable_count();
+                    pool.remove_repo(repo_id, true);
+
+                    // Create new repo from buffer
+                    auto [repo_id2, repo2] = pool.add_repo("test-forge");
+                    repo2.read_buffer(data);
+
+                    CHECK_EQ(repo2.solvable_count(), n_solvables);
+                    CHECK(repo2.has_solvable(id1));
+                    CHECK(repo2.has_solvable(id2));
+                }
+            }
+
             SUBCASE("Write repo to file")
             {
                 auto dir = mamba::TemporaryDirectory();
@@ -175,6 +208,24 @@ TEST_SUITE("ObjRepo")
                     CHECK(repo2.has_solvable(id1));
                     CHECK(repo2.has_solvable(id2));
                 }
+
+                SUBCASE("Read repo from buffer")
+                {
+                    auto in = mamba::open_ifstream(solv_file, std::ios::in | std::ios::binary);
+                    const auto data = std::string(std::istreambuf_iterator<char>(in), {});
+
+                    // Delete repo
+                    const auto n_solvables = repo.solvable_count();
+                    pool.remove_repo(repo_id, true);
+
+                    // Create new repo from buffer
+                    auto [repo_id2, repo2] = pool.add_repo("test-forge");
+                    repo2.read_buffer(data);
+
+                    CHECK_EQ(repo2.solvable_count(), n_solvables);
+                    CHECK(repo2.has_solvable(id1));
+                    CHECK(repo2.has_solvable(id2));
+                }
             }
         }
     }
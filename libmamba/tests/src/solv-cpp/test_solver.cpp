@@ -56,6 +56,9 @@ TEST_SUITE("ObjSolver")
                 };
                 CHECK(solver.solve(pool, jobs));
                 CHECK_EQ(solver.problem_count(), 0);
+                CHECK_GT(solver.package_rule_count(), 0);
+                // At least the system solvable, menu, and icons
+                CHECK_GE(solver.decision_count(), 3);
             }
 
             SUBCASE("Solve unsuccessfully")
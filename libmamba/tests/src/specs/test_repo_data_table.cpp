@@ -0,0 +1,131 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include "mamba/specs/repo_data_table.hpp"
+
+using namespace mamba::specs;
+namespace nl = nlohmann;
+
+namespace
+{
+    auto make_package_json(std::string name, std::string version) -> nl::json
+    {
+        auto j = nl::json::object();
+        j["name"] = std::move(name);
+        j["version"] = std::move(version);
+        j["build"] = "h12345_0";
+        j["build_number"] = 0;
+        j["subdir"] = "linux-64";
+        j["depends"] = nl::json::array({ "python >=3.8", "libsolv>=1.0" });
+        return j;
+    }
+
+    auto make_repodata_json() -> nl::json
+    {
+        auto j = nl::json::object();
+        j["version"] = 1;
+        j["info"]["subdir"] = "linux-64";
+        j["packages"]["mamba-1.0-h12345_0.tar.bz2"] = make_package_json("mamba", "1.0");
+        j["packages"]["conda-2.0-h12345_0.tar.bz2"] = make_package_json("conda", "2.0");
+        j["conda_packages"]["mamba-1.1-h12345_0.conda"] = make_package_json("mamba", "1.1");
+        j["removed"][0] = "bad-package.tar.bz2";
+
+        auto& mamba = j["conda_packages"]["mamba-1.1-h12345_0.conda"];
+        mamba["md5"] = "ffsd";
+        mamba["platform"] = nullptr;
+        mamba["size"] = 1234;
+        mamba["constrains"] = nl::json::array({ "conda >=2" });
+        mamba["track_features"] = "feat";
+        mamba["noarch"] = "python";
+        mamba["license"] = "BSD-3-Clause";
+        return j;
+    }
+}
+
+TEST_SUITE("repo_data_table")
+{
+    TEST_CASE("RepoDataTable_from_json")
+    {
+        const auto j = make_repodata_json();
+        const auto table = RepoDataTable::from_json(j);
+
+        CHECK_EQ(table.version(), std::optional<std::size_t>(1));
+        REQUIRE(table.info().has_value());
+        CHECK_EQ(table.info()->subdir, "linux-64");
+        CHECK_EQ(table.removed(), std::vector<std::string>{ "bad-package.tar.bz2" });
+
+        SUBCASE("Packages are sorted by filename")
+        {
+            const auto packages = table.packages();
+            REQUIRE_EQ(packages.size(), 2);
+            CHECK_EQ(packages[0].filename(), "conda-2.0-h12345_0.tar.bz2");
+            CHECK_EQ(packages[1].filename(), "mamba-1.0-h12345_0.tar.bz2");
+            CHECK_EQ(table.conda_packages().size(), 1);
+        }
+
+        SUBCASE("Fields")
+        {
+            const auto pkg = table.conda_packages().find("mamba-1.1-h12345_0.conda");
+            REQUIRE(pkg.has_value());
+            CHECK_EQ(pkg->name(), "mamba");
+            CHECK_EQ(pkg->version_str(), "1.1");
+            CHECK_EQ(pkg->version(), Version::parse("1.1"));
+            CHECK_EQ(pkg->build_string(), "h12345_0");
+            CHECK_EQ(pkg->build_number(), 0);
+            CHECK_EQ(pkg->subdir(), "linux-64");
+            CHECK_EQ(pkg->md5(), std::optional<std::string_view>("ffsd"));
+            CHECK_FALSE(pkg->sha256().has_value());
+            CHECK_FALSE(pkg->platform().has_value());
+            CHECK_EQ(pkg->size(), std::optional<std::size_t>(1234));
+            CHECK_FALSE(pkg->timestamp().has_value());
+            const auto depends = std::vector<std::string>{ "python >=3.8", "libsolv>=1.0" };
+            CHECK_EQ(pkg->depends().to_vector(), depends);
+            CHECK_EQ(pkg->constrains().to_vector(), std::vector<std::string>{ "conda >=2" });
+            CHECK_EQ(pkg->track_features().to_vector(), std::vector<std::string>{ "feat" });
+            CHECK_EQ(pkg->noarch(), NoArchType::Python);
+            CHECK_EQ(pkg->license(), std::optional<std::string_view>("BSD-3-Clause"));
+
+            CHECK_FALSE(table.conda_packages().find("mamba-1.0-h12345_0.tar.bz2").has_value());
+            CHECK_FALSE(table.packages().find("zzz").has_value());
+        }
+
+        SUBCASE("Same as the struct representation")
+        {
+            const nl::json from_table = table.to_repo_data();
+            const nl::json from_struct = j.get<RepoData>();
+            CHECK_EQ(from_table, from_struct);
+        }
+    }
+
+    TEST_CASE("RepoDataTable_old_noarch")
+    {
+        auto j = nl::json::object();
+        j["packages"]["a.tar.bz2"] = make_package_json("a", "1.0");
+        j["packages"]["a.tar.bz2"]["noarch"] = true;
+        j["packages"]["b.tar.bz2"] = make_package_json("b", "1.0");
+        j["packages"]["b.tar.bz2"]["noarch"] = false;
+
+        const auto table = RepoDataTable::from_json(j);
+        CHECK_FALSE(table.version().has_value());
+        CHECK(table.conda_packages().empty());
+        CHECK_EQ(table.packages()[0].noarch(), NoArchType::Generic);
+        CHECK_FALSE(table.packages()[1].noarch().has_value());
+    }
+
+    TEST_CASE("RepoDataTable_missing_field")
+    {
+        auto j = nl::json::object();
+        j["packages"]["a.tar.bz2"] = make_package_json("a", "1.0");
+        j["packages"]["a.tar.bz2"].erase("build");
+        CHECK_THROWS_AS(RepoDataTable::from_json(j), nl::json::exception);
+    }
+}
@@ -24,6 +24,11 @@ TEST_SUITE("version")
         CHECK_EQ(VersionPartAtom(1), VersionPartAtom(1, ""));
         // lowercase
         CHECK_EQ(VersionPartAtom(1, "dev"), VersionPartAtom(1, "DEV"));
+        CHECK_EQ(
+            VersionPartAtom(1, "DEV").literal_rank(),
+            VersionPartAtom(1, "dev").literal_rank()
+        );
+        CHECK_EQ(VersionPartAtom(1).literal_rank(), VersionPartAtom(1, "").literal_rank());
         // All operator comparison for mumerals
         CHECK_NE(VersionPartAtom(1), VersionPartAtom(2, "dev"));
         CHECK_LT(VersionPartAtom(1), VersionPartAtom(2, "dev"));
@@ -98,6 +103,38 @@ TEST_SUITE("version")
         CHECK_GE(Version(0, { { { 11 }, { 0 }, { 0, "post" } } }), Version(0, { { { 2 }, { 0 } } }));
     }
 
+    TEST_CASE("version_comparison_numeric")
+    {
+        // Numeric versions with few small parts are compared as integers, check the
+        // boundaries with the other versions.
+        CHECK_EQ(Version::parse("1.2"), Version::parse("1.2.0.0"));
+        CHECK_EQ(Version::parse("1.2"), Version::parse("1.2.0.0.0"));
+        CHECK_LT(Version::parse("1.2.0.0.0"), Version::parse("1.2.0.0.1"));
+        CHECK_LT(Version::parse("1.2.3"), Version::parse("1.2.3.0.1"));
+        CHECK_EQ(Version(0, { { { 1 }, {} } }), Version::parse("1"));
+        CHECK_LT(Version::parse("1.65534"), Version::parse("1.65535"));
+        CHECK_LT(Version::parse("1.65535"), Version::parse("1.65536"));
+        CHECK_LT(Version::parse("1.65536"), Version::parse("2"));
+        CHECK_GT(Version::parse("1.2.3"), Version::parse("1.2.3rc1"));
+        CHECK_LT(Version::parse("1.2.3"), Version::parse("1.2.3post1"));
+        CHECK_LT(Version::parse("1.2.3"), Version::parse("1.2.3+1"));
+        CHECK_GT(Version::parse("1!1.0"), Version::parse("2.0"));
+        CHECK_EQ(Version(), Version::parse("0"));
+        CHECK_LE(Version::parse("3.10"), Version::parse("3.10.0"));
+        CHECK_GE(Version::parse("3.10"), Version::parse("3.9.18"));
+
+        auto versions = std::vector{
+            Version::parse("1.0.0.0.1"), Version::parse("1.1"),      Version::parse("1.0.1"),
+            Version::parse("1.0dev"),    Version::parse("70000.1"), Version::parse("1.0"),
+        };
+        std::sort(versions.begin(), versions.end());
+        const auto sorted = std::vector{
+            Version::parse("1.0dev"), Version::parse("1.0"), Version::parse("1.0.0.0.1"),
+            Version::parse("1.0.1"),  Version::parse("1.1"), Version::parse("70000.1"),
+        };
+        CHECK_EQ(versions, sorted);
+    }
+
     TEST_CASE("starts_with")
     {
         SUBCASE("positive")
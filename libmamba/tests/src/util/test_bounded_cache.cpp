@@ -0,0 +1,72 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <doctest/doctest.h>
+
+#include "mamba/util/bounded_cache.hpp"
+
+using namespace mamba::util;
+
+TEST_SUITE("util::bounded_cache")
+{
+    TEST_CASE("get_or_make")
+    {
+        auto cache = BoundedCache<std::string>(1000);
+        int n_made = 0;
+        const auto make = [&](std::string_view key)
+        {
+            ++n_made;
+            return std::string(key) + "!";
+        };
+
+        CHECK_EQ(cache.get_or_make("a", make), "a!");
+        CHECK_EQ(cache.get_or_make("b", make), "b!");
+        CHECK_EQ(cache.get_or_make("a", make), "a!");
+        CHECK_EQ(n_made, 2);
+
+        cache.clear();
+        CHECK_EQ(cache.get_or_make("a", make), "a!");
+        CHECK_EQ(n_made, 3);
+    }
+
+    TEST_CASE("bounded")
+    {
+        auto cache = BoundedCache<int>(32);
+        int n_made = 0;
+        const auto make = [&](std::string_view key)
+        {
+            ++n_made;
+            return static_cast<int>(key.size());
+        };
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            cache.get_or_make(std::to_string(i), make);
+        }
+        CHECK_EQ(n_made, 1000);
+        // Only the last values are kept
+        cache.get_or_make("0", make);
+        CHECK_EQ(n_made, 1001);
+    }
+
+    TEST_CASE("failures_are_not_cached")
+    {
+        auto cache = BoundedCache<int>(1000);
+        int n_tries = 0;
+        const auto make = [&](std::string_view) -> int
+        {
+            ++n_tries;
+            throw std::invalid_argument("invalid");
+        };
+        CHECK_THROWS_AS(cache.get_or_make("a", make), std::invalid_argument);
+        CHECK_THROWS_AS(cache.get_or_make("a", make), std::invalid_argument);
+        CHECK_EQ(n_tries, 2);
+    }
+}
@@ -5,6 +5,8 @@
 // The full license is in the file LICENSE, distributed with this software.
 
 #include <array>
+#include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -98,6 +100,30 @@ TEST_SUITE("flat_set")
         CHECK_FALSE(s.contains(6));
     }
 
+    TEST_CASE("insert range")
+    {
+        auto s = flat_set<int>{ 1, 4, 6 };
+        const auto v = std::vector<int>{ 7, 4, 0, 2, 2 };
+        s.insert(v.cbegin(), v.cend());
+        CHECK_EQ(s, flat_set<int>({ 0, 1, 2, 4, 6, 7 }));
+        s.insert(v.cend(), v.cend());
+        CHECK_EQ(s.size(), 6);
+    }
+
+    TEST_CASE("heterogeneous lookup")
+    {
+        using namespace std::literals::string_view_literals;
+
+        auto s = flat_set<std::string, std::less<>>{ "hello", "world" };
+        CHECK(s.contains("hello"sv));
+        CHECK_FALSE(s.contains("foo"sv));
+        CHECK_EQ(s.find("world"sv), s.begin() + 1);
+        CHECK_EQ(s.find("foo"sv), s.end());
+        CHECK_EQ(s.erase("foo"sv), 0);
+        CHECK_EQ(s.erase("hello"sv), 1);
+        CHECK_EQ(s, flat_set<std::string, std::less<>>{ "world" });
+    }
+
     TEST_CASE("key_compare")
     {
         auto s = flat_set({ 1, 3, 4, 5 }, std::greater{});
@@ -105,5 +131,7 @@ TEST_SUITE("flat_set")
         CHECK_EQ(s.back(), 1);
         s.insert(6);
         CHECK_EQ(s.front(), 6);
+        CHECK(s.contains(4));
+        CHECK_FALSE(s.contains(2));
     }
 }
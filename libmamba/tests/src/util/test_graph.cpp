@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <set>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -517,4 +518,63 @@ TEST_SUITE("graph")
         CHECK(is_reachable(graph, 0, 6));
         CHECK_FALSE(is_reachable(graph, 6, 0));
     }
+
+    TEST_CASE("CompressedDiGraph")
+    {
+        const auto g = build_graph();
+        const auto cg = CompressedDiGraph<double>(g);
+        using node_id = decltype(cg)::node_id;
+
+        CHECK_EQ(cg.number_of_nodes(), g.number_of_nodes());
+        CHECK_EQ(cg.number_of_edges(), g.number_of_edges());
+        g.for_each_node_id(
+            [&](node_id n)
+            {
+                CHECK_EQ(cg.node(n), g.node(n));
+                CHECK_EQ(cg.in_degree(n), g.in_degree(n));
+                CHECK_EQ(cg.out_degree(n), g.out_degree(n));
+            }
+        );
+        g.for_each_edge_id([&](node_id from, node_id to) { CHECK(cg.has_edge(from, to)); });
+        CHECK_FALSE(cg.has_edge(1, 0));
+        CHECK_FALSE(cg.has_node(7));
+
+        SUBCASE("Same traversals")
+        {
+            auto expected = std::vector<node_id>();
+            auto sorted = std::vector<node_id>();
+            topological_sort_for_each_node_id(g, [&](node_id n) { expected.push_back(n); });
+            topological_sort_for_each_node_id(cg, [&](node_id n) { sorted.push_back(n); });
+            CHECK_EQ(sorted, expected);
+
+            expected.clear();
+            sorted.clear();
+            dfs_preorder_nodes_for_each_id(g, [&](node_id n) { expected.push_back(n); }, 2);
+            dfs_preorder_nodes_for_each_id(cg, [&](node_id n) { sorted.push_back(n); }, 2);
+            CHECK_EQ(sorted, expected);
+
+            CHECK(is_reachable(cg, 0, 6));
+            CHECK_FALSE(is_reachable(cg, 6, 0));
+        }
+
+        SUBCASE("Removed nodes are skipped")
+        {
+            auto g2 = g;
+            g2.remove_node(1);
+            const auto cg2 = CompressedDiGraph<double>(g2);
+            REQUIRE_EQ(cg2.number_of_nodes(), 6);
+            CHECK_EQ(cg2.number_of_edges(), 4);
+            // Node 2 of the source graph is the second one
+            CHECK_EQ(cg2.node(1), 2.5);
+            CHECK(cg2.has_edge(1, 2));
+        }
+
+        SUBCASE("Edge data")
+        {
+            const auto cge = CompressedDiGraph<double, const char*>(build_edge_data_graph());
+            CHECK_EQ(std::string(cge.edge(0, 1)), "n0->n1");
+            CHECK_EQ(std::string(cge.edge(1, 2)), "n1->n2");
+            CHECK_THROWS_AS(cge.edge(0, 2), std::out_of_range);
+        }
+    }
 }
@@ -1582,6 +1582,9 @@ def cancel_json_output() -> None:
 def clean(arg0: int) -> None:
     pass
 
+def clear_interruption_deadline() -> None:
+    pass
+
 def create_cache_dir(arg0: Path) -> str:
     pass
 
@@ -1597,6 +1600,9 @@ def get_virtual_packages() -> typing.List[PackageInfo]:
 def init_console() -> None:
     pass
 
+def set_interruption_deadline(seconds: float) -> None:
+    pass
+
 def sign(data: str, secret_key: str) -> str:
     pass
 
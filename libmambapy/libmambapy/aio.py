@@ -0,0 +1,87 @@
+"""Awaitable variants of the long running calls of libmambapy.
+
+The calls run on a pool of native worker threads shared by all the event loops, bounded
+by the host concurrency, so that many environments can be built concurrently without a
+thread per build.
+Their inputs must not be used by other calls until they are done, as for the blocking
+calls (see the documentation of the Python API).
+"""
+
+import asyncio
+import threading
+
+from libmambapy import bindings
+
+
+class _ProgressBatcher:
+    """Deliver progress from native threads to a callback on the event loop.
+
+    Reports received before the loop runs the callback are coalesced into the last one.
+    """
+
+    def __init__(self, loop, callback):
+        self._loop = loop
+        self._callback = callback
+        self._lock = threading.Lock()
+        self._pending = None
+
+    def __call__(self, *args):
+        with self._lock:
+            scheduled = self._pending is not None
+            self._pending = args
+        if not scheduled:
+            try:
+                self._loop.call_soon_threadsafe(self._flush)
+            except RuntimeError:
+                # The loop is closed
+                pass
+
+    def _flush(self):
+        with self._lock:
+            pending, self._pending = self._pending, None
+        if pending is not None:
+            self._callback(*pending)
+
+
+def _resolve(future, result, error):
+    if future.cancelled():
+        return
+    if error is not None:
+        future.set_exception(RuntimeError(error))
+    else:
+        future.set_result(result)
+
+
+def _submit(submit, *args):
+    loop = asyncio.get_running_loop()
+    future = loop.create_future()
+
+    def done(result, error):
+        try:
+            loop.call_soon_threadsafe(_resolve, future, result, error)
+        except RuntimeError:
+            # The loop is closed
+            pass
+
+    submit(*args, done)
+    return future
+
+
+async def download(targets, options=0, progress=None):
+    """Download the targets of a ``DownloadTargetList``.
+
+    ``progress(finished, total)`` is called on the event loop as targets finish.
+    """
+    if progress is not None:
+        progress = _ProgressBatcher(asyncio.get_running_loop(), progress)
+    return await _submit(bindings._submit_download, targets, options, progress)
+
+
+async def solve(solver):
+    """Solve with a ``Solver``, returning whether a solution was found."""
+    return await _submit(bindings._submit_solve, solver)
+
+
+async def execute(transaction, prefix_data):
+    """Execute a ``Transaction`` in the prefix of ``prefix_data``."""
+    return await _submit(bindings._submit_execute, transaction, prefix_data)
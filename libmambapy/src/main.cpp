@@ -4,7 +4,15 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 #include <fmt/format.h>
 #include <nlohmann/json.hpp>
@@ -28,6 +36,7 @@
 #include "mamba/core/satisfiability_error.hpp"
 #include "mamba/core/solver.hpp"
 #include "mamba/core/subdirdata.hpp"
+#include "mamba/core/thread_utils.hpp"
 #include "mamba/core/transaction.hpp"
 #include "mamba/core/url.hpp"
 #include "mamba/core/util_os.hpp"
@@ -126,17 +135,198 @@ namespace mambapy
         static Singletons singletons;
         return singletons;
     }
+
+    /**
+     * Native worker threads running the awaitable calls of ``libmambapy.aio``.
+     *
+     * Their number is bounded by the host concurrency, whatever the number of calls
+     * submitted, the extra ones waiting for a free worker.
+     */
+    class TaskPool
+    {
+    public:
+
+        ~TaskPool()
+        {
+            close();
+        }
+
+        void submit(std::function<void()> task)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closed)
+            {
+                throw std::runtime_error("libmambapy tasks are closed");
+            }
+            m_tasks.push_back(std::move(task));
+            const std::size_t max_workers = std::max(1u, std::thread::hardware_concurrency());
+            if (m_workers.size() < std::min(max_workers, m_tasks.size() + m_busy))
+            {
+                m_workers.emplace_back([this] { work(); });
+            }
+            m_cv.notify_one();
+        }
+
+        /** Stop accepting tasks and wait for the submitted ones. */
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_closed = true;
+            }
+            m_cv.notify_all();
+            for (auto& worker : m_workers)
+            {
+                if (worker.joinable())
+                {
+                    worker.join();
+                }
+            }
+        }
+
+    private:
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::deque<std::function<void()>> m_tasks;
+        std::vector<std::thread> m_workers;
+        std::size_t m_busy = 0;
+        bool m_closed = false;
+
+        void work()
+        {
+            auto lock = std::unique_lock<std::mutex>(m_mutex);
+            while (true)
+            {
+                m_cv.wait(lock, [&] { return m_closed || !m_tasks.empty(); });
+                if (m_tasks.empty())
+                {
+                    return;
+                }
+                auto task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+                ++m_busy;
+                lock.unlock();
+                task();
+                lock.lock();
+                --m_busy;
+            }
+        }
+    };
+
+    /** A column of ``SolvableColumns``, exposed with the buffer protocol without copy. */
+    template <typename T>
+    struct SolvableColumn
+    {
+        std::shared_ptr<const mamba::SolvableColumns> owner;
+        const std::vector<T>* data;
+    };
+
+    template <typename T>
+    void bind_SolvableColumn(py::module_& m, const char* name)
+    {
+        py::class_<SolvableColumn<T>>(m, name, py::buffer_protocol())
+            .def_buffer(
+                [](const SolvableColumn<T>& self) -> py::buffer_info
+                {
+                    return py::buffer_info(
+                        const_cast<T*>(self.data->data()),
+                        static_cast<py::ssize_t>(sizeof(T)),
+                        py::format_descriptor<T>::format(),
+                        1,
+                        { static_cast<py::ssize_t>(self.data->size()) },
+                        { static_cast<py::ssize_t>(sizeof(T)) },
+                        /* readonly= */ true
+                    );
+                }
+            )
+            .def("__len__", [](const SolvableColumn<T>& self) { return self.data->size(); });
+    }
+
+    TaskPool& tasks()
+    {
+        static TaskPool pool;
+        return pool;
+    }
+
+    /**
+     * Run @p func on a native worker, then call ``done(result, error)`` with its result or
+     * the message of the exception it threw.
+     *
+     * The Python objects of @p keep_alive are referenced until then, so that the objects used
+     * by @p func are not destroyed if the caller stops waiting.
+     * Called with the GIL held.
+     */
+    template <typename Func>
+    void submit_task(py::tuple keep_alive, Func func, py::function done)
+    {
+        // Python references are only copied and released with the GIL held
+        auto refs = std::make_shared<std::pair<py::tuple, py::function>>(
+            std::move(keep_alive),
+            std::move(done)
+        );
+        tasks().submit(
+            [refs, func = std::move(func)]()
+            {
+                std::string error;
+                bool failed = false;
+                bool value = false;
+                try
+                {
+                    value = func();
+                }
+                catch (const std::exception& e)
+                {
+                    failed = true;
+                    error = e.what();
+                }
+                catch (...)
+                {
+                    failed = true;
+                    error = "Unknown error";
+                }
+
+                py::gil_scoped_acquire acquire;
+                try
+                {
+                    if (failed)
+                    {
+                        refs->second(py::none(), error);
+                    }
+                    else
+                    {
+                        refs->second(py::bool_(value), py::none());
+                    }
+                }
+                catch (py::error_already_set& e)
+                {
+                    e.discard_as_unraisable(__func__);
+                }
+                refs->first = py::tuple();
+                refs->second = py::function();
+            }
+        );
+    }
 }
 
 PYBIND11_MODULE(bindings, m)
 {
     using namespace mamba;
 
+    // For the long native calls, not touching Python objects, so that other Python threads
+    // run meanwhile. The objects given to such a call must not be used by other threads
+    // until it returns.
+    const auto release_gil = py::call_guard<py::gil_scoped_release>();
+
     // declare earlier to avoid C++ types in docstrings
     auto pyChannel = py::class_<Channel, std::unique_ptr<Channel, py::nodelete>>(m, "Channel");
     auto pyPackageInfo = py::class_<PackageInfo>(m, "PackageInfo");
     auto pyPrefixData = py::class_<PrefixData>(m, "PrefixData");
     auto pySolver = py::class_<MSolver>(m, "Solver");
+    auto pySolvableColumns = py::class_<SolvableColumns, std::shared_ptr<SolvableColumns>>(
+        m,
+        "SolvableColumns"
+    );
     auto pyMultiDownloadTarget = py::class_<MultiDownloadTarget>(m, "DownloadTargetList");
     // only used in a return type; does it belong in the module?
     auto pyRootRole = py::class_<validation::RootRole>(m, "RootRole");
@@ -166,10 +356,12 @@ PYBIND11_MODULE(bindings, m)
         ))
         .def("conda_build_form", &MatchSpec::conda_build_form);
 
+    py::class_<MPool::Snapshot>(m, "PoolSnapshot");
+
     py::class_<MPool>(m, "Pool")
         .def(py::init<>([] { return MPool{ mambapy::singletons().channel_context }; }))
         .def("set_debuglevel", &MPool::set_debuglevel)
-        .def("create_whatprovides", &MPool::create_whatprovides)
+        .def("create_whatprovides", &MPool::create_whatprovides, release_gil)
         .def("select_solvables", &MPool::select_solvables, py::arg("id"), py::arg("sorted") = false)
         .def("matchspec2id", &MPool::matchspec2id, py::arg("ms"))
         .def(
@@ -179,7 +371,58 @@ PYBIND11_MODULE(bindings, m)
             },
             py::arg("ms")
         )
-        .def("id2pkginfo", &MPool::id2pkginfo, py::arg("id"));
+        .def("id2pkginfo", &MPool::id2pkginfo, py::arg("id"))
+        .def("snapshot", &MPool::snapshot)
+        .def("restore", &MPool::restore, py::arg("snapshot"), release_gil)
+        .def("fork", &MPool::fork, release_gil)
+        .def(
+            "solvable_columns",
+            [](const MPool& self, std::optional<std::vector<Id>> ids)
+            {
+                return std::make_shared<SolvableColumns>(
+                    ids.has_value() ? self.solvable_columns(ids.value()) : self.solvable_columns()
+                );
+            },
+            py::arg("ids") = py::none(),
+            release_gil
+        )
+        .def(
+            "id2str",
+            [](const MPool& self, const std::vector<Id>& ids)
+            {
+                auto strings = std::vector<std::string>();
+                strings.reserve(ids.size());
+                for (const Id id : ids)
+                {
+                    strings.push_back(self.dep2str(id).value_or(""));
+                }
+                return strings;
+            },
+            py::arg("ids")
+        );
+
+    mambapy::bind_SolvableColumn<Id>(m, "SolvableIdColumn");
+    mambapy::bind_SolvableColumn<std::int64_t>(m, "SolvableIntColumn");
+
+    using SolvableColumnsPtr = std::shared_ptr<SolvableColumns>;
+    const auto id_column = [](const std::vector<Id> SolvableColumns::*column)
+    {
+        return [column](const SolvableColumnsPtr& self)
+        { return mambapy::SolvableColumn<Id>{ self, &((*self).*column) }; };
+    };
+    const auto int_column = [](const std::vector<std::int64_t> SolvableColumns::*column)
+    {
+        return [column](const SolvableColumnsPtr& self)
+        { return mambapy::SolvableColumn<std::int64_t>{ self, &((*self).*column) }; };
+    };
+    pySolvableColumns.def("__len__", [](const SolvableColumns& self) { return self.ids.size(); })
+        .def_property_readonly("ids", id_column(&SolvableColumns::ids))
+        .def_property_readonly("names", id_column(&SolvableColumns::names))
+        .def_property_readonly("versions", id_column(&SolvableColumns::versions))
+        .def_property_readonly("build_strings", id_column(&SolvableColumns::build_strings))
+        .def_property_readonly("build_numbers", int_column(&SolvableColumns::build_numbers))
+        .def_property_readonly("depends_offsets", int_column(&SolvableColumns::depends_offsets))
+        .def_property_readonly("depends", id_column(&SolvableColumns::depends));
 
     py::class_<MultiPackageCache>(m, "MultiPackageCache")
         .def(py::init<std::vector<fs::u8path>>())
@@ -192,11 +435,17 @@ PYBIND11_MODULE(bindings, m)
         .def_readwrite("repo_url", &MRepo::PyExtraPkgInfo::repo_url);
 
     py::class_<MRepo>(m, "Repo")
-        .def(py::init(
-            [](MPool& pool, const std::string& name, const std::string& filename, const std::string& url
-            ) { return MRepo(pool, name, filename, RepoMetadata{ /* .url=*/url }); }
-        ))
-        .def(py::init<MPool&, const PrefixData&>())
+        .def(
+            py::init(
+                [](MPool& pool,
+                   const std::string& name,
+                   const std::string& filename,
+                   const std::string& url)
+                { return MRepo(pool, name, filename, RepoMetadata{ /* .url=*/url }); }
+            ),
+            release_gil
+        )
+        .def(py::init<MPool&, const PrefixData&>(), release_gil)
         .def("add_extra_pkg_info", &MRepo::py_add_extra_pkg_info)
         .def("set_installed", &MRepo::set_installed)
         .def("set_priority", &MRepo::set_priority)
@@ -213,14 +462,18 @@ PYBIND11_MODULE(bindings, m)
                 return std::make_unique<MTransaction>(solver.pool(), solver, mpc);
             }
         ))
-        .def(py::init<MPool&, MSolver&, MultiPackageCache&>())
+        .def(py::init<MPool&, MSolver&, MultiPackageCache&>(), release_gil)
         .def("to_conda", &MTransaction::to_conda)
         .def("log_json", &MTransaction::log_json)
         .def("print", &MTransaction::print)
-        .def("fetch_extract_packages", &MTransaction::fetch_extract_packages)
+        .def(
+            "fetch_extract_packages",
+            py::overload_cast<>(&MTransaction::fetch_extract_packages),
+            release_gil
+        )
         .def("prompt", &MTransaction::prompt)
         .def("find_python_version", &MTransaction::py_find_python_version)
-        .def("execute", &MTransaction::execute);
+        .def("execute", py::overload_cast<PrefixData&>(&MTransaction::execute), release_gil);
 
     pySolver.def(py::init<MPool&, std::vector<std::pair<int, int>>>(), py::keep_alive<1, 2>())
         .def("add_jobs", &MSolver::add_jobs)
@@ -240,10 +493,11 @@ PYBIND11_MODULE(bindings, m)
             {
                 // TODO figure out a better interface
                 return self.try_solve();
-            }
+            },
+            release_gil
         )
-        .def("try_solve", &MSolver::try_solve)
-        .def("must_solve", &MSolver::must_solve);
+        .def("try_solve", &MSolver::try_solve, release_gil)
+        .def("must_solve", &MSolver::must_solve, release_gil);
 
     py::class_<MSolverProblem>(m, "SolverProblem")
         .def_readwrite("type", &MSolverProblem::type)
@@ -301,7 +555,7 @@ PYBIND11_MODULE(bindings, m)
             }
         );
 
-    m.def("simplify_conflicts", &simplify_conflicts);
+    m.def("simplify_conflicts", py::overload_cast<const PbGraph&>(&simplify_conflicts));
 
     using CpPbGraph = CompressedProblemsGraph;
     auto pyCpPbGraph = py::class_<CpPbGraph>(m, "CompressedProblemsGraph");
@@ -321,7 +575,13 @@ PYBIND11_MODULE(bindings, m)
         [](py::handle) { return py::type::of<PbGraph::conflicts_t>(); }
     );
 
-    pyCpPbGraph.def_static("from_problems_graph", &CpPbGraph::from_problems_graph)
+    pyCpPbGraph
+        .def_static(
+            "from_problems_graph",
+            py::overload_cast<const PbGraph&, const CpPbGraph::merge_criteria_t&>(
+                &CpPbGraph::from_problems_graph
+            )
+        )
         .def_static(
             "from_problems_graph",
             [](const PbGraph& pbs) { return CpPbGraph::from_problems_graph(pbs); }
@@ -388,7 +648,8 @@ PYBIND11_MODULE(bindings, m)
                                << " may not be installed. Try specifying a channel with '-c,--channel' option\n";
                 }
                 return res_stream.str();
-            }
+            },
+            release_gil
         )
         .def(
             "whoneeds",
@@ -419,7 +680,8 @@ PYBIND11_MODULE(bindings, m)
                                << " may not be installed. Try giving a channel with '-c,--channel' option for remote repoquery\n";
                 }
                 return res_stream.str();
-            }
+            },
+            release_gil
         )
         .def(
             "depends",
@@ -451,32 +713,37 @@ PYBIND11_MODULE(bindings, m)
                                << " may not be installed. Try giving a channel with '-c,--channel' option for remote repoquery\n";
                 }
                 return res_stream.str();
-            }
+            },
+            release_gil
         );
 
     py::class_<MSubdirData>(m, "SubdirData")
-        .def(py::init(
-            [](const Channel& channel,
-               const std::string& platform,
-               const std::string& url,
-               MultiPackageCache& caches,
-               const std::string& repodata_fn) -> MSubdirData
-            {
-                auto sres = MSubdirData::create(
-                    mambapy::singletons().channel_context,
-                    channel,
-                    platform,
-                    url,
-                    caches,
-                    repodata_fn
-                );
-                return extract(std::move(sres));
-            }
-        ))
+        .def(
+            py::init(
+                [](const Channel& channel,
+                   const std::string& platform,
+                   const std::string& url,
+                   MultiPackageCache& caches,
+                   const std::string& repodata_fn) -> MSubdirData
+                {
+                    auto sres = MSubdirData::create(
+                        mambapy::singletons().channel_context,
+                        channel,
+                        platform,
+                        url,
+                        caches,
+                        repodata_fn
+                    );
+                    return extract(std::move(sres));
+                }
+            ),
+            release_gil
+        )
         .def(
             "create_repo",
             [](MSubdirData& subdir, MPool& pool) -> MRepo
-            { return extract(subdir.create_repo(pool)); }
+            { return extract(subdir.create_repo(pool)); },
+            release_gil
         )
         .def("loaded", &MSubdirData::loaded)
         .def(
@@ -493,7 +760,8 @@ PYBIND11_MODULE(bindings, m)
                 }
                 multi_download.download(MAMBA_NO_CLEAR_PROGRESS_BARS);
                 return self.check_targets().size();
-            }
+            },
+            release_gil
         )
         .def("finalize_checks", &MSubdirData::finalize_checks);
 
@@ -505,7 +773,86 @@ PYBIND11_MODULE(bindings, m)
             "add",
             [](MultiDownloadTarget& self, MSubdirData& sub) -> void { self.add(sub.target()); }
         )
-        .def("download", &MultiDownloadTarget::download);
+        .def("download", &MultiDownloadTarget::download, release_gil);
+
+    // Native side of libmambapy.aio, calling ``done`` from a worker thread when finished
+    m.def(
+        "_submit_download",
+        [](py::object targets, int options, py::object progress, py::function done)
+        {
+            auto* multi = targets.cast<MultiDownloadTarget*>();
+            // Referenced by the keep alive tuple until done
+            const auto progress_handle = py::handle(progress);
+            mambapy::submit_task(
+                py::make_tuple(targets, progress),
+                [multi, options, progress_handle]()
+                {
+                    if (!progress_handle.is_none())
+                    {
+                        multi->set_progress_callback(
+                            [progress_handle](std::size_t finished, std::size_t total)
+                            {
+                                py::gil_scoped_acquire acquire;
+                                try
+                                {
+                                    progress_handle(finished, total);
+                                }
+                                catch (py::error_already_set& e)
+                                {
+                                    e.discard_as_unraisable("download progress");
+                                }
+                            }
+                        );
+                    }
+                    try
+                    {
+                        const bool downloaded = multi->download(options);
+                        multi->set_progress_callback({});
+                        return downloaded;
+                    }
+                    catch (...)
+                    {
+                        multi->set_progress_callback({});
+                        throw;
+                    }
+                },
+                std::move(done)
+            );
+        }
+    );
+    m.def(
+        "_submit_solve",
+        [](py::object solver, py::function done)
+        {
+            auto* self = solver.cast<MSolver*>();
+            mambapy::submit_task(
+                py::make_tuple(solver),
+                [self]() { return self->try_solve(); },
+                std::move(done)
+            );
+        }
+    );
+    m.def(
+        "_submit_execute",
+        [](py::object transaction, py::object prefix_data, py::function done)
+        {
+            auto* self = transaction.cast<MTransaction*>();
+            auto* prefix = prefix_data.cast<PrefixData*>();
+            mambapy::submit_task(
+                py::make_tuple(transaction, prefix_data),
+                [self, prefix]() { return self->execute(*prefix); },
+                std::move(done)
+            );
+        }
+    );
+    // The tasks call back into Python, so they are waited for before it is finalized
+    py::module_::import("atexit").attr("register")(py::cpp_function(
+        []
+        {
+            py::gil_scoped_release release;
+            mambapy::tasks().close();
+        }
+    ));
 
     py::enum_<ChannelPriority>(m, "ChannelPriority")
         .value("kFlexible", ChannelPriority::kFlexible)
@@ -1025,6 +1372,20 @@ PYBIND11_MODULE(bindings, m)
 
     m.def("cancel_json_output", [] { Console::instance().cancel_json_print(); });
 
+    m.def(
+        "set_interruption_deadline",
+        [](double seconds)
+        {
+            const auto timeout = std::chrono::duration<double>(seconds);
+            set_interruption_deadline(
+                std::chrono::steady_clock::now()
+                + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout)
+            );
+        },
+        py::arg("seconds")
+    );
+    m.def("clear_interruption_deadline", &clear_interruption_deadline);
+
     m.attr("SOLVER_SOLVABLE") = SOLVER_SOLVABLE;
     m.attr("SOLVER_SOLVABLE_NAME") = SOLVER_SOLVABLE_NAME;
     m.attr("SOLVER_SOLVABLE_PROVIDES") = SOLVER_SOLVABLE_PROVIDES;
@@ -0,0 +1,268 @@
+"""Replay environment specs against frozen repodata and report the time of each phase.
+
+The repodata of channels is first recorded in a snapshot directory, laid out as a channel
+server (``<channel>/<subdir>/repodata.json``). Runs serve the snapshot on a local HTTP server,
+so that they do not depend on the network or on changes to the channels, and create the
+environments of a scenario file with micromamba, measuring for each run:
+
+- the wall time and the resource usage of the micromamba process,
+- the time of each phase, from the trace written with ``--trace-file``.
+
+Results are written as json, to compare builds or machines.
+"""
+
+import argparse
+import contextlib
+import functools
+import json
+import os
+import platform
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import urllib.request
+from http.server import SimpleHTTPRequestHandler, ThreadingHTTPServer
+from pathlib import Path
+from typing import Any, Dict, Iterator, List, Tuple
+
+
+def record(args: argparse.Namespace) -> None:
+    """Download the repodata of channels in the snapshot directory."""
+    for channel in args.channel:
+        for subdir in (args.platform, "noarch"):
+            url = f"{args.channel_alias.rstrip('/')}/{channel}/{subdir}/repodata.json"
+            out = args.snapshot / channel / subdir / "repodata.json"
+            out.parent.mkdir(parents=True, exist_ok=True)
+            print(f"Recording {url}", file=sys.stderr)
+            with urllib.request.urlopen(url) as response, open(out, "wb") as f:
+                shutil.copyfileobj(response, f)
+
+
+class QuietHandler(SimpleHTTPRequestHandler):
+    def log_message(self, format: str, *args: Any) -> None:
+        pass
+
+
+@contextlib.contextmanager
+def serve(directory: Path) -> Iterator[str]:
+    """Serve a directory on a free local port, yielding its url."""
+    handler = functools.partial(QuietHandler, directory=str(directory))
+    server = ThreadingHTTPServer(("127.0.0.1", 0), handler)
+    thread = threading.Thread(target=server.serve_forever, daemon=True)
+    thread.start()
+    try:
+        yield f"http://127.0.0.1:{server.server_address[1]}"
+    finally:
+        server.shutdown()
+        server.server_close()
+
+
+def phase_name(span_name: str) -> str:
+    """The phase of a span, such as ``link`` for ``link python``."""
+    return span_name.split(" ", 1)[0]
+
+
+def phases(trace_file: Path) -> Dict[str, Dict[str, float]]:
+    """The count, summed time and wall time of the spans of each phase of a Chrome trace."""
+    if not trace_file.exists():
+        return {}
+    events = json.loads(trace_file.read_text())["traceEvents"]
+    intervals: Dict[str, List[Tuple[float, float]]] = {}
+    for event in events:
+        start = event["ts"] / 1000
+        intervals.setdefault(phase_name(event["name"]), []).append(
+            (start, start + event["dur"] / 1000)
+        )
+
+    out = {}
+    for name, spans in intervals.items():
+        # Concurrent spans, such as parallel downloads, are only counted once in the wall time
+        wall_ms = 0.0
+        end = float("-inf")
+        for span_start, span_end in sorted(spans):
+            from_ = max(span_start, end)
+            if span_end > from_:
+                wall_ms += span_end - from_
+                end = span_end
+        out[name] = {
+            "count": len(spans),
+            "total_ms": sum(e - s for s, e in spans),
+            "wall_ms": wall_ms,
+        }
+    return out
+
+
+def run_case(
+    args: argparse.Namespace,
+    case: Dict[str, Any],
+    scenario: Dict[str, Any],
+    url: str,
+    root_prefix: Path,
+) -> Dict[str, Any]:
+    """Create the environment of a case once, measuring the micromamba process."""
+    prefix = root_prefix / "envs" / case["name"]
+    trace_file = root_prefix / "trace.json"
+    with contextlib.suppress(FileNotFoundError):
+        trace_file.unlink()
+    shutil.rmtree(prefix, ignore_errors=True)
+    root_prefix.mkdir(parents=True, exist_ok=True)
+
+    cmd = [str(args.micromamba), "create", "--yes", "--json", "--no-rc", "--no-env"]
+    cmd += ["--prefix", str(prefix), "--trace-file", str(trace_file), "--override-channels"]
+    cmd += ["--platform", scenario.get("platform", args.platform)]
+    for channel in case.get("channels", scenario.get("channels", [])):
+        cmd += ["--channel", f"{url}/{channel}"]
+    if not args.install:
+        cmd.append("--dry-run")
+    cmd += case["specs"]
+
+    env = dict(os.environ, MAMBA_ROOT_PREFIX=str(root_prefix))
+    env.update(scenario.get("env", {}))
+    env.update(case.get("env", {}))
+
+    with tempfile.TemporaryFile("w+") as out, tempfile.TemporaryFile("w+") as err:
+        start = time.perf_counter()
+        process = subprocess.Popen(cmd, env=env, stdout=out, stderr=err, text=True)
+        # Waiting for the process directly gives the resources used by this process only
+        _, status, usage = os.wait4(process.pid, 0)
+        wall_ms = (time.perf_counter() - start) * 1000
+        process.returncode = os.waitstatus_to_exitcode(status)
+        out.seek(0)
+        err.seek(0)
+        stdout, stderr = out.read(), err.read()
+
+    result: Dict[str, Any] = {
+        "case": case["name"],
+        "returncode": process.returncode,
+        "wall_ms": wall_ms,
+        "user_ms": usage.ru_utime * 1000,
+        "system_ms": usage.ru_stime * 1000,
+        # Kilobytes on Linux, bytes on macOS
+        "max_rss": usage.ru_maxrss,
+        "phases": phases(trace_file),
+    }
+    if process.returncode != 0:
+        result["stderr"] = stderr[-4000:]
+    else:
+        with contextlib.suppress(json.JSONDecodeError):
+            output = json.loads(stdout)
+            result["n_packages"] = len(output.get("actions", {}).get("LINK", []))
+    return result
+
+
+def summarize(results: List[Dict[str, Any]]) -> Dict[str, Dict[str, Any]]:
+    """The medians of the wall time, and of the wall time of each phase, of each case."""
+    by_case: Dict[str, List[Dict[str, Any]]] = {}
+    for result in results:
+        if result["returncode"] == 0:
+            by_case.setdefault(result["case"], []).append(result)
+
+    out = {}
+    for case, runs in by_case.items():
+        phase_names = sorted({name for run in runs for name in run["phases"]})
+        out[case] = {
+            "runs": len(runs),
+            "wall_ms": statistics.median(run["wall_ms"] for run in runs),
+            "phases_wall_ms": {
+                name: statistics.median(
+                    run["phases"].get(name, {}).get("wall_ms", 0.0) for run in runs
+                )
+                for name in phase_names
+            },
+        }
+    return out
+
+
+def run(args: argparse.Namespace) -> None:
+    """Replay the cases of the scenario file and write the results."""
+    scenario = json.loads(args.scenarios.read_text())
+    cases = [c for c in scenario["cases"] if not args.case or c["name"] in args.case]
+    version = subprocess.run(
+        [str(args.micromamba), "--version"], capture_output=True, text=True, check=True
+    ).stdout.strip()
+
+    results = []
+    with serve(args.snapshot) as url, tempfile.TemporaryDirectory() as tmp:
+        for case in cases:
+            # Warm runs share the package and repodata caches of their first, unmeasured, run
+            root_prefix = Path(tmp) / case["name"]
+            if args.warm:
+                run_case(args, case, scenario, url, root_prefix)
+            for i in range(args.repeat):
+                if not args.warm:
+                    shutil.rmtree(root_prefix, ignore_errors=True)
+                result = run_case(args, case, scenario, url, root_prefix)
+                result["run"] = i
+                print(
+                    f"{case['name']} #{i}: {result['wall_ms']:.0f} ms"
+                    + ("" if result["returncode"] == 0 else " (failed)"),
+                    file=sys.stderr,
+                )
+                results.append(result)
+
+    report = {
+        "micromamba": version,
+        "host": {
+            "system": platform.system(),
+            "release": platform.release(),
+            "machine": platform.machine(),
+            "cpu_count": os.cpu_count(),
+        },
+        "options": {"warm": args.warm, "install": args.install, "repeat": args.repeat},
+        "summary": summarize(results),
+        "results": results,
+    }
+    if args.output is None:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+    else:
+        args.output.write_text(json.dumps(report, indent=2))
+    if any(r["returncode"] != 0 for r in results):
+        sys.exit(1)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    record_parser = commands.add_parser("record", help="Record the repodata of channels.")
+    record_parser.add_argument("snapshot", type=Path, help="Snapshot directory.")
+    record_parser.add_argument(
+        "-c", "--channel", action="append", required=True, help="Channel to record."
+    )
+    record_parser.add_argument("--platform", default="linux-64", help="Subdir to record.")
+    record_parser.add_argument(
+        "--channel-alias", default="https://conda.anaconda.org", help="Server of the channels."
+    )
+    record_parser.set_defaults(func=record)
+
+    run_parser = commands.add_parser("run", help="Replay the cases of a scenario file.")
+    run_parser.add_argument("snapshot", type=Path, help="Snapshot directory.")
+    run_parser.add_argument("scenarios", type=Path, help="Scenario file.")
+    run_parser.add_argument(
+        "--micromamba", type=Path, default=shutil.which("micromamba"), help="Executable to run."
+    )
+    run_parser.add_argument("--platform", default="linux-64", help="Default platform.")
+    run_parser.add_argument("--repeat", type=int, default=3, help="Runs of each case.")
+    run_parser.add_argument("--case", action="append", help="Only run the cases of this name.")
+    run_parser.add_argument(
+        "--warm", action="store_true", help="Keep the caches between the runs of a case."
+    )
+    run_parser.add_argument(
+        "--install",
+        action="store_true",
+        help="Install the packages, which must be in the snapshot, instead of a dry run.",
+    )
+    run_parser.add_argument("-o", "--output", type=Path, help="Results file, stdout if not set.")
+    run_parser.set_defaults(func=run)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
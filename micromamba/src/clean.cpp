@@ -42,6 +42,14 @@ init_clean_parser(CLI::App* subcom, Configuration& config)
             .description("Remove *.mamba_trash files from all environments")
     );
 
+    auto& clean_lru = config.insert(
+        Configurable("clean_lru", false)
+            .group("cli")
+            .description(
+                "Remove the least recently used unused packages until the caches fit in pkgs_dirs_max_size"
+            )
+    );
+
     auto& clean_force_pkgs_dirs = config.insert(
         Configurable("clean_force_pkgs_dirs", false)
             .group("cli")
@@ -60,6 +68,13 @@ init_clean_parser(CLI::App* subcom, Configuration& config)
     );
     subcom->add_flag("-l,--locks", clean_locks.get_cli_config<bool>(), clean_locks.description());
     subcom->add_flag("--trash", clean_trash.get_cli_config<bool>(), clean_trash.description());
+    subcom->add_flag("--lru", clean_lru.get_cli_config<bool>(), clean_lru.description());
+    auto& pkgs_dirs_max_size = config.at("pkgs_dirs_max_size");
+    subcom->add_option(
+        "--max-size",
+        pkgs_dirs_max_size.get_cli_config<std::size_t>(),
+        "Maximum size in bytes of the packages of each package cache, implies --lru"
+    );
     subcom->add_flag(
         "-f,--force-pkgs-dirs",
         clean_force_pkgs_dirs.get_cli_config<bool>(),
@@ -101,6 +116,11 @@ set_clean_command(CLI::App* subcom, Configuration& config)
             {
                 options = options | MAMBA_CLEAN_TRASH;
             }
+            if (config.at("clean_lru").compute().value<bool>()
+                || config.at("pkgs_dirs_max_size").cli_configured())
+            {
+                options = options | MAMBA_CLEAN_LRU;
+            }
             if (config.at("clean_force_pkgs_dirs").compute().value<bool>())
             {
                 if (config.at("always_yes").compute().value<bool>()
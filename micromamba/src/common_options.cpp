@@ -72,6 +72,24 @@ init_general_options(CLI::App* subcom, Configuration& config)
     auto& json = config.at("json");
     subcom->add_flag("--json", json.get_cli_config<bool>(), json.description())->group(cli_group);
 
+    auto& trace_file = config.at("trace_file");
+    subcom
+        ->add_option(
+            "--trace-file",
+            trace_file.get_cli_config<fs::u8path>(),
+            trace_file.description()
+        )
+        ->group(cli_group);
+
+    auto& progress_events = config.at("progress_events");
+    subcom
+        ->add_option(
+            "--progress-events",
+            progress_events.get_cli_config<std::string>(),
+            progress_events.description()
+        )
+        ->group(cli_group);
+
     auto& offline = config.at("offline");
     subcom->add_flag("--offline", offline.get_cli_config<bool>(), offline.description())->group(cli_group);
 
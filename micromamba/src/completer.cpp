@@ -5,15 +5,38 @@
 // The full license is in the file LICENSE, distributed with this software.
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <CLI/CLI.hpp>
 
 #include "mamba/api/configuration.hpp"
+#include "mamba/core/completion_index.hpp"
+#include "mamba/core/context.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/run.hpp"
 #include "mamba/core/util_string.hpp"
 
+/**
+ * The names to complete.
+ *
+ * The configuration is only loaded when there is no index yet, as on the first completion.
+ */
+mamba::CompletionIndex
+completion_index(mamba::Configuration& config)
+{
+    const auto path = mamba::CompletionIndex::default_path();
+    if (auto index = mamba::CompletionIndex::read(path))
+    {
+        return std::move(index).value();
+    }
+
+    config.load();
+    auto index = mamba::CompletionIndex();
+    index.set_envs_dirs(mamba::Context::instance().envs_dirs);
+    index.write(path);
+    return index;
+}
 
 void
 complete_options(
@@ -33,23 +56,12 @@ complete_options(
 
     if (last_args[0] == "-n" && last_args.size() == 2)
     {
-        config.load();
-
-        auto root_prefix = config.at("root_prefix").value<fs::u8path>();
         auto& name_start = last_args.back();
-
-        if (fs::exists(root_prefix / "envs"))
+        for (auto& name : completion_index(config).env_names())
         {
-            for (const auto& p : fs::directory_iterator(root_prefix / "envs"))
+            if (mamba::starts_with(name, name_start))
             {
-                if (p.is_directory() && fs::exists(p.path() / "conda-meta"))
-                {
-                    auto name = p.path().filename().string();
-                    if (mamba::starts_with(name, name_start))
-                    {
-                        options.push_back(name);
-                    }
-                }
+                options.push_back(std::move(name));
             }
         }
     }
@@ -98,6 +110,20 @@ complete_options(
                 options.push_back(n);
             }
         }
+
+        // Package names, not listing all of them for an empty argument
+        const auto& cmd = app->get_name();
+        if (options.empty() && !last_args.back().empty()
+            && ((cmd == "install") || (cmd == "create") || (cmd == "update")))
+        {
+            for (const auto& name : completion_index(config).package_names())
+            {
+                if (mamba::starts_with(name, last_args.back()))
+                {
+                    options.push_back(name);
+                }
+            }
+        }
     }
 
     std::cout << mamba::printers::table_like(options, 90).str() << std::endl;
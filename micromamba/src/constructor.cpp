@@ -8,6 +8,7 @@
 #include "mamba/api/configuration.hpp"
 #include "mamba/api/install.hpp"
 #include "mamba/core/channel.hpp"
+#include "mamba/core/package_download.hpp"
 #include "mamba/core/package_handling.hpp"
 #include "mamba/core/package_info.hpp"
 #include "mamba/core/url.hpp"
@@ -110,16 +111,32 @@ construct(Configuration& config, const fs::u8path& prefix, bool extract_conda_pk
             channel_context
         );
 
+        auto files = std::vector<fs::u8path>();
+        files.reserve(package_details.size());
         for (const auto& pkg_info : package_details)
         {
-            fs::u8path entry = pkgs_dir / pkg_info.fn;
-            LOG_TRACE << "Extracting " << pkg_info.fn << std::endl;
-            std::cout << "Extracting " << pkg_info.fn << std::endl;
+            files.push_back(pkgs_dir / pkg_info.fn);
+        }
 
-            fs::u8path base_path = extract(entry);
+        // Extraction is the bulk of the work, the records are written once it is done
+        const auto n_threads = std::max<std::ptrdiff_t>(DownloadExtractSemaphore::get_max(), 1);
+        const auto base_paths = extract_all(
+            files,
+            static_cast<std::size_t>(n_threads),
+            [&](std::size_t i)
+            {
+                LOG_TRACE << "Extracting " << package_details[i].fn << std::endl;
+                std::cout << "Extracting " << package_details[i].fn << std::endl;
+            }
+        );
 
-            fs::u8path repodata_record_path = base_path / "info" / "repodata_record.json";
-            fs::u8path index_path = base_path / "info" / "index.json";
+        auto repodata_records = std::vector<nlohmann::json>();
+        repodata_records.reserve(package_details.size());
+        for (std::size_t i = 0; i < package_details.size(); ++i)
+        {
+            const auto& pkg_info = package_details[i];
+            const fs::u8path& entry = files[i];
+            fs::u8path index_path = base_paths[i] / "info" / "index.json";
 
             std::string channel_url;
             if (pkg_info.url.size() > pkg_info.fn.size())
@@ -177,10 +194,15 @@ construct(Configuration& config, const fs::u8path& prefix, bool extract_conda_pk
             {
                 repodata_record["size"] = fs::file_size(entry);
             }
+            repodata_records.push_back(std::move(repodata_record));
+        }
 
+        for (std::size_t i = 0; i < repodata_records.size(); ++i)
+        {
+            fs::u8path repodata_record_path = base_paths[i] / "info" / "repodata_record.json";
             LOG_TRACE << "Writing " << repodata_record_path;
             std::ofstream repodata_record_of{ repodata_record_path.std_path() };
-            repodata_record_of << repodata_record.dump(4);
+            repodata_record_of << repodata_records[i].dump(4);
         }
     }
 
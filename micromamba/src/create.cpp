@@ -16,5 +16,15 @@ set_create_command(CLI::App* subcom, Configuration& config)
 {
     init_install_options(subcom, config);
 
+    auto& clone = config.at("clone");
+    subcom->add_option("--clone", clone.get_cli_config<std::string>(), clone.description());
+
+    auto& batch_files = config.at("batch_files");
+    subcom->add_option(
+        "--batch-file",
+        batch_files.get_cli_config<std::vector<std::string>>(),
+        batch_files.description()
+    );
+
     subcom->callback([&] { return mamba::create(config); });
 }
@@ -4,7 +4,9 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <set>
 #include <string>
+#include <unordered_map>
 
 #include "mamba/api/configuration.hpp"
 #include "mamba/api/create.hpp"
@@ -86,67 +88,85 @@ set_env_command(CLI::App* com, Configuration& config)
                 // TODO: handle error
                 auto pd = PrefixData::create(ctx.prefix_params.target_prefix, channel_context).value();
                 auto records = pd.sorted_records();
-                std::cout << "# This file may be used to create an environment using:\n"
-                          << "# $ conda create --name <env> --file <this file>\n"
-                          << "# platform: " << Context::instance().platform << "\n"
-                          << "@EXPLICIT\n";
+                auto out = concat(
+                    "# This file may be used to create an environment using:\n",
+                    "# $ conda create --name <env> --file <this file>\n",
+                    "# platform: ",
+                    Context::instance().platform,
+                    "\n@EXPLICIT\n"
+                );
 
+                std::string clean_url, token;
                 for (const auto& record : records)
                 {
-                    std::string clean_url, token;
                     split_anaconda_token(record.url, clean_url, token);
-                    std::cout << clean_url;
+                    out += clean_url;
                     if (!no_md5)
                     {
-                        std::cout << "#" << record.md5;
+                        out += concat("#", record.md5);
                     }
-                    std::cout << "\n";
+                    out += "\n";
                 }
+                // Written at once
+                std::cout << out << std::flush;
             }
             else
             {
-                auto pd = PrefixData::create(ctx.prefix_params.target_prefix, channel_context).value();
-                History& hist = pd.history();
-
-                const auto& versions_map = pd.records();
+                // Only the exported fields are read, from the index of the installed records
+                const auto& prefix = ctx.prefix_params.target_prefix;
+                const auto summaries = PrefixData::load_summaries(prefix);
 
-                std::cout << "name: " << get_env_name(ctx.prefix_params.target_prefix) << "\n";
-                std::cout << "channels:\n";
+                auto requested_specs_map = std::unordered_map<std::string, MatchSpec>();
+                if (from_history)
+                {
+                    auto history = History(prefix, channel_context);
+                    requested_specs_map = history.get_requested_specs_map();
+                }
 
-                auto requested_specs_map = hist.get_requested_specs_map();
-                std::stringstream dependencies;
+                // The packages of a channel subdir share the directory of their URL
+                std::unordered_map<std::string, std::string> channel_names;
+                std::string dependencies;
                 std::set<std::string> channels;
-                for (const auto& [k, v] : versions_map)
+                for (const auto& pkg : summaries)
                 {
-                    if (from_history && requested_specs_map.find(k) == requested_specs_map.end())
+                    const auto spec = requested_specs_map.find(pkg.name);
+                    if (from_history && (spec == requested_specs_map.end()))
                     {
                         continue;
                     }
 
                     if (from_history)
                     {
-                        dependencies << "- " << requested_specs_map[k].str() << "\n";
+                        dependencies += concat("- ", spec->second.str(), "\n");
                     }
                     else
                     {
-                        dependencies << "- " << v.name << "=" << v.version;
+                        dependencies += concat("- ", pkg.name, "=", pkg.version);
                         if (!no_build)
                         {
-                            dependencies << "=" << v.build_string;
+                            dependencies += concat("=", pkg.build_string);
                         }
-                        dependencies << "\n";
+                        dependencies += "\n";
                     }
 
-                    const Channel& channel = channel_context.make_channel(v.url);
-                    channels.insert(channel.name());
+                    auto [channel_name, inserted] = channel_names.try_emplace(
+                        pkg.url.substr(0, pkg.url.rfind('/'))
+                    );
+                    if (inserted)
+                    {
+                        channel_name->second = channel_context.make_channel(pkg.url).name();
+                    }
+                    channels.insert(channel_name->second);
                 }
 
+                // Written at once
+                auto out = concat("name: ", get_env_name(prefix), "\nchannels:\n");
                 for (const auto& c : channels)
                 {
-                    std::cout << "- " << c << "\n";
+                    out += concat("- ", c, "\n");
                 }
-                std::cout << "dependencies:\n" << dependencies.str() << std::endl;
-                std::cout.flush();
+                out += concat("dependencies:\n", dependencies, "\n");
+                std::cout << out << std::flush;
             }
         }
     );
@@ -201,7 +221,7 @@ set_env_command(CLI::App* com, Configuration& config)
         [&config]
         {
             // Remove specs if exist
-            remove(config, MAMBA_REMOVE_ALL);
+            remove(config, MAMBA_REMOVE_ALL | MAMBA_REMOVE_ENV);
 
             const auto& ctx = Context::instance();
             if (!ctx.dry_run)
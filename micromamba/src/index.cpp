@@ -0,0 +1,68 @@
+// Copyright (c) 2023, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include "mamba/api/configuration.hpp"
+#include "mamba/api/index.hpp"
+#include "mamba/core/channel.hpp"
+#include "mamba/core/output.hpp"
+
+#include "common_options.hpp"
+
+using namespace mamba;  // NOLINT(build/namespaces)
+
+void
+set_index_command(CLI::App* subcom, Configuration& config)
+{
+    static std::string channel_dir;
+    static std::size_t index_threads = 0;
+    static int zstd_level = 16;
+
+    init_general_options(subcom, config);
+    subcom->add_option("channel", channel_dir, "Directory of the local channel to index")
+        ->required();
+    subcom->add_option(
+        "-j,--jobs",
+        index_threads,
+        "Number of packages read at once (default is 0 for the number of cores)"
+    );
+    subcom->add_option(
+        "--zstd-level",
+        zstd_level,
+        "Compression level of repodata.json.zst from 1-22 (default is 16)"
+    );
+
+    subcom->callback(
+        [&]
+        {
+            // load verbose and other options to context
+            config.load();
+
+            ChannelContext channel_context;
+            const auto stats = index_channel(
+                channel_context,
+                fs::absolute(channel_dir),
+                index_threads,
+                zstd_level
+            );
+
+            bool failed = false;
+            for (const auto& [subdir, subdir_stats] : stats)
+            {
+                Console::stream() << subdir << ": " << subdir_stats.n_packages << " packages, "
+                                  << subdir_stats.n_indexed << " newly indexed";
+                for (const auto& error : subdir_stats.errors)
+                {
+                    LOG_ERROR << "Could not index " << error;
+                    failed = true;
+                }
+            }
+            if (failed)
+            {
+                throw std::runtime_error("Some packages could not be indexed");
+            }
+        }
+    );
+}
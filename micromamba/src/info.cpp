@@ -21,8 +21,15 @@ set_info_command(CLI::App* subcom, mamba::Configuration& config)
 {
     init_info_parser(subcom, config);
     static bool print_licenses;
+    static bool print_perf;
 
     subcom->add_flag("--licenses", print_licenses, "Print licenses");
+    subcom->add_flag(
+        "--perf",
+        print_perf,
+        "Probe what can slow down installs: file systems, hardlink and reflink support between "
+        "the package caches and the prefix, open files limit and latency to the channels"
+    );
 
     subcom->callback(
         [&config]
@@ -68,6 +75,10 @@ set_info_command(CLI::App* subcom, mamba::Configuration& config)
                               << text << "\n\n";
                 }
             }
+            else if (print_perf)
+            {
+                perf_info(config);
+            }
             else
             {
                 info(config);
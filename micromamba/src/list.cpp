@@ -22,6 +22,15 @@ init_list_parser(CLI::App* subcom, Configuration& config)
                                     .group("cli")
                                     .description("List only packages matching a regular expression"));
     subcom->add_option("regex", regex.get_cli_config<std::string>(), regex.description());
+
+    auto& which = config.insert(Configurable("list_which", std::vector<std::string>({}))
+                                    .group("cli")
+                                    .description("List the packages owning these files instead"));
+    subcom->add_option(
+        "--which",
+        which.get_cli_config<std::vector<std::string>>(),
+        which.description()
+    );
 }
 
 void
@@ -32,6 +41,12 @@ set_list_command(CLI::App* subcom, Configuration& config)
     subcom->callback(
         [&config]
         {
+            auto& which = config.at("list_which").compute().value<std::vector<std::string>>();
+            if (!which.empty())
+            {
+                list_file_owners(config, which);
+                return;
+            }
             auto& regex = config.at("list_regex").compute().value<std::string>();
             list(config, regex);
         }
@@ -14,12 +14,15 @@
 #endif
 
 #include <CLI/CLI.hpp>
+#include <fmt/format.h>
 
 #include "mamba/api/configuration.hpp"
 #include "mamba/core/context.hpp"
+#include "mamba/core/environment.hpp"
 #include "mamba/core/execution.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/thread_utils.hpp"
+#include "mamba/core/tracing.hpp"
 #include "mamba/core/util_os.hpp"
 #include "mamba/core/util_scope.hpp"
 #include "mamba/version.hpp"
@@ -29,10 +32,62 @@
 
 using namespace mamba;  // NOLINT(build/namespaces)
 
+namespace
+{
+    /**
+     * Report the time spent in each startup stage if ``MAMBA_STARTUP_TRACE`` is set.
+     *
+     * The variable is read before anything else, since the configuration is loaded late.
+     * If it is set to a path, a Chrome trace is written there, otherwise the stages are
+     * printed on the standard error.
+     */
+    void report_startup_trace()
+    {
+        const auto trace_file = env::get("MAMBA_STARTUP_TRACE");
+        if (!trace_file.has_value())
+        {
+            return;
+        }
+        const auto& tracer = Tracer::instance();
+        if (!trace_file->empty() && (*trace_file != "1"))
+        {
+            tracer.write_chrome_trace(*trace_file);
+            return;
+        }
+        for (const auto& span : tracer.spans())
+        {
+            std::cerr << fmt::format(
+                "{:<32} {:>10.3f} ms\n",
+                span.name,
+                std::chrono::duration<double, std::milli>(span.duration).count()
+            );
+        }
+    }
+}
 
 int
 main(int argc, char** argv)
 {
+    auto& tracer = Tracer::instance();
+    tracer.set_enabled(env::get("MAMBA_STARTUP_TRACE").has_value());
+    const auto startup_begin = Tracer::clock::now();
+    auto stage_begin = startup_begin;
+    auto end_stage = [&](std::string name)
+    {
+        const auto now = Tracer::clock::now();
+        tracer.add_span(std::move(name), stage_begin, now);
+        stage_begin = now;
+    };
+    // Also reported when the parser exits early, such as for the help
+    auto report_trace = on_scope_exit(
+        [&]
+        {
+            end_stage("parse and run");
+            tracer.add_span("total", startup_begin, stage_begin);
+            report_startup_trace();
+        }
+    );
+
     mamba::MainExecutor scoped_threads;
     mamba::Configuration config;
 
@@ -40,9 +95,13 @@ main(int argc, char** argv)
     auto& ctx = Context::instance();
 
     ctx.command_params.is_micromamba = true;
+    end_stage("context and configuration");
 
+    // Only the completer needs the options of all the subcommands
+    const bool is_completer = (argc >= 2) && (strcmp(argv[1], "completer") == 0);
     CLI::App app{ "Version: " + version() + "\n" };
-    set_umamba_command(&app, config);
+    set_umamba_command(&app, config, /* lazy= */ !is_completer);
+    end_stage("cli setup");
 
     char** utf8argv;
 
@@ -65,7 +124,7 @@ main(int argc, char** argv)
     utf8argv = argv;
 #endif
 
-    if (argc >= 2 && strcmp(argv[1], "completer") == 0)
+    if (is_completer)
     {
         get_completions(&app, config, argc, utf8argv);
         reset_console();
@@ -12,10 +12,16 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. original
 // source: https://github.com/konteck/wpp
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <thread>
 #include <vector>
 
 #include <arpa/inet.h>
@@ -30,6 +36,7 @@
 #include "mamba/core/output.hpp"
 #include "mamba/core/thread_utils.hpp"
 #include "mamba/core/util.hpp"
+#include "mamba/core/util_scope.hpp"
 #include "mamba/core/util_string.hpp"
 
 #include "fmt/format.h"
@@ -38,6 +45,11 @@
 #include "version.hpp"
 
 #define BUFSIZE 8096
+// Limits on what is buffered for a single request
+#define MAX_HEADERS_SIZE 65536
+#define MAX_HEADERS 100
+// Time after which idle kept-alive connections are closed
+#define KEEP_ALIVE_TIMEOUT_MS 5000
 
 #define SERVER_NAME "micromamba"
 #define SERVER_VERSION UMAMBA_VERSION_STRING
@@ -48,6 +60,7 @@ namespace microserver
     {
         std::string method;
         std::string path;
+        std::string version;
         std::string params;
         std::string body;
         std::map<std::string, std::string> headers;
@@ -79,6 +92,10 @@ namespace microserver
         std::string type;
         std::string date;
         std::stringstream body;
+        /** A file sent as the body in place of ``body``, when not empty. */
+        std::string file;
+        /** Headers sent in addition to those of every response. */
+        std::map<std::string, std::string> headers;
 
         void send(std::string_view str)
         {
@@ -99,30 +116,50 @@ namespace microserver
         std::string method;
         callback_function_t callback;
         std::string params;
+        /** Whether the callback can run alongside others, or must run alone. */
+        bool concurrent = false;
     };
 
     class Server
     {
     public:
 
-        Server(const spdlog::logger& logger)
+        /**
+         * Connections are handled by @p n_workers threads, so that slow clients and long
+         * requests do not block the others.
+         * Callbacks only run concurrently if registered as such, since they usually share
+         * the global context.
+         */
+        Server(const spdlog::logger& logger, std::size_t n_workers = 4)
             : m_logger(logger)
+            , m_n_workers(std::max<std::size_t>(n_workers, 1))
         {
         }
-        void get(std::string, callback_function_t);
-        void post(std::string, callback_function_t);
-        void all(std::string, callback_function_t);
+        void get(std::string, callback_function_t, bool concurrent = false);
+        void post(std::string, callback_function_t, bool concurrent = false);
+        void all(std::string, callback_function_t, bool concurrent = false);
 
-        bool start(int port = 80);
+        bool start(int port = 80, const std::string& host = "0.0.0.0");
 
     private:
 
-        void main_loop(int port);
+        void main_loop(int port, const std::string& host);
+        void worker_loop();
+        void handle_connection(int fd, const sockaddr_in& cli_addr);
+        bool read_request(int fd, std::string& buffer, Request&, Response&);
         std::pair<std::string, std::string> parse_header(std::string_view);
         void parse_headers(const std::string&, Request&, Response&);
         bool match_route(Request&, Response&);
         std::vector<Route> m_routes;
         spdlog::logger m_logger;
+        std::size_t m_n_workers;
+
+        std::mutex m_connections_mutex;
+        std::condition_variable m_connections_cv;
+        std::deque<std::pair<int, sockaddr_in>> m_connections;
+        bool m_stopping = false;
+        std::mutex m_callback_mutex;
+        std::mutex m_logger_mutex;
     };
 
     std::pair<std::string, std::string> Server::parse_header(std::string_view header)
@@ -160,7 +197,7 @@ namespace microserver
         std::size_t delim_pos = headers.find_first_of("\n");
         std::string line = headers.substr(0, delim_pos + 1);
 
-        while (line.size() > 2 && i < 10)
+        while (line.size() > 2 && i < MAX_HEADERS)
         {
             if (i++ == 0)
             {
@@ -173,6 +210,7 @@ namespace microserver
 
                 req.method = R[0];
                 req.path = R[1];
+                req.version = std::string(mamba::strip(R[2]));
 
                 size_t pos = req.path.find('?');
 
@@ -205,21 +243,21 @@ namespace microserver
         }
     }
 
-    void Server::get(std::string path, callback_function_t callback)
+    void Server::get(std::string path, callback_function_t callback, bool concurrent)
     {
-        Route r = { path, "GET", callback, "" };
+        Route r = { path, "GET", callback, "", concurrent };
         m_routes.push_back(r);
     }
 
-    void Server::post(std::string path, callback_function_t callback)
+    void Server::post(std::string path, callback_function_t callback, bool concurrent)
     {
-        Route r = { path, "POST", callback, "" };
+        Route r = { path, "POST", callback, "", concurrent };
         m_routes.push_back(r);
     }
 
-    void Server::all(std::string path, callback_function_t callback)
+    void Server::all(std::string path, callback_function_t callback, bool concurrent)
     {
-        Route r = { path, "ALL", callback, "" };
+        Route r = { path, "ALL", callback, "", concurrent };
         m_routes.push_back(r);
     }
 
@@ -227,17 +265,35 @@ namespace microserver
     {
         for (std::vector<Route>::size_type i = 0; i < m_routes.size(); i++)
         {
-            if (m_routes[i].path == req.path
-                && (m_routes[i].method == req.method || m_routes[i].method == "ALL"))
+            // Routes ending with a star match all the paths they are a prefix of
+            const std::string& route = m_routes[i].path;
+            const bool path_matches = (route == req.path)
+                                      || (mamba::ends_with(route, "*")
+                                          && mamba::starts_with(
+                                              req.path,
+                                              std::string_view(route).substr(0, route.size() - 1)
+                                          ));
+            if (path_matches
+                && (m_routes[i].method == req.method || m_routes[i].method == "ALL"
+                    || (m_routes[i].method == "GET" && req.method == "HEAD")))
             {
                 req.params = m_routes[i].params;
 
                 try
                 {
-                    m_routes[i].callback(req, res);
+                    if (m_routes[i].concurrent)
+                    {
+                        m_routes[i].callback(req, res);
+                    }
+                    else
+                    {
+                        std::lock_guard<std::mutex> lock(m_callback_mutex);
+                        m_routes[i].callback(req, res);
+                    }
                 }
                 catch (const std::exception& e)
                 {
+                    std::lock_guard<std::mutex> lock(m_logger_mutex);
                     m_logger.error("Error in callback: {}", e.what());
                     res.code = 500;
                     res.body << fmt::format("Internal server error. {}", e.what());
@@ -250,7 +306,7 @@ namespace microserver
         return false;
     }
 
-    bool wait_for_socket(int fd)
+    bool wait_for_socket(int fd, int timeout_ms = 500)
     {
         struct pollfd fds[1];
         int ret;
@@ -258,7 +314,7 @@ namespace microserver
         fds[0].fd = fd;
         fds[0].events = POLLIN;
 
-        ret = poll(fds, 1, 500);
+        ret = poll(fds, 1, timeout_ms);
 
         if (ret == -1)
         {
@@ -269,85 +325,136 @@ namespace microserver
         return fds[0].revents & POLLIN;
     }
 
-    void Server::main_loop(int port)
+    bool write_all(int fd, std::string_view data)
     {
-        int newsc;
-
-        int sc = socket(AF_INET, SOCK_STREAM, 0);
-
-        if (sc < 0)
+        while (!data.empty())
         {
-            throw microserver::server_exception("ERROR opening socket");
+            auto written = write(fd, data.data(), data.size());
+            if (written <= 0)
+            {
+                return false;
+            }
+            data.remove_prefix(static_cast<std::size_t>(written));
         }
+        return true;
+    }
 
-        struct sockaddr_in serv_addr, cli_addr;
-        serv_addr.sin_family = AF_INET;
-        serv_addr.sin_addr.s_addr = INADDR_ANY;
-        serv_addr.sin_port = htons(port);
-
-        // allow faster reuse of the address
-        int optval = 1;
-        setsockopt(sc, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+    bool write_file(int fd, const std::string& path, std::size_t offset)
+    {
+        std::ifstream in(path, std::ios::binary);
+        in.seekg(static_cast<std::streamoff>(offset));
+        char buf[BUFSIZE];
+        while (in)
+        {
+            in.read(buf, sizeof(buf));
+            if (!write_all(fd, std::string_view(buf, static_cast<std::size_t>(in.gcount()))))
+            {
+                return false;
+            }
+        }
+        return in.eof();
+    }
 
-        if (::bind(sc, reinterpret_cast<struct sockaddr*>(&serv_addr), sizeof(serv_addr)) != 0)
+    /** The start of a ``Range: bytes=<start>-`` header, the only range served. */
+    std::optional<std::size_t> range_start(const Request& req)
+    {
+        auto it = req.headers.find("range");
+        if (it == req.headers.end() || !mamba::starts_with(it->second, "bytes=")
+            || !mamba::ends_with(it->second, "-"))
         {
-            throw microserver::server_exception("ERROR on binding");
+            return std::nullopt;
+        }
+        const std::string start = it->second.substr(6, it->second.size() - 7);
+        if (start.empty() || !std::all_of(start.begin(), start.end(), ::isdigit))
+        {
+            return std::nullopt;
         }
+        return std::stoull(start);
+    }
 
-        listen(sc, 5);
+    bool wants_keep_alive(const Request& req)
+    {
+        auto it = req.headers.find("connection");
+        const std::string connection = it != req.headers.end() ? mamba::to_lower(it->second)
+                                                                : "";
+        if (req.version == "HTTP/1.1")
+        {
+            return connection != "close";
+        }
+        return connection == "keep-alive";
+    }
 
-        socklen_t clilen;
-        clilen = sizeof(cli_addr);
+    bool Server::read_request(int fd, std::string& buffer, Request& req, Response& res)
+    {
+        char buf[BUFSIZE];
 
-        while (!mamba::is_sig_interrupted())
+        std::size_t header_end = buffer.find("\r\n\r\n");
+        while (header_end == std::string::npos)
         {
-            bool have_data = wait_for_socket(sc);
-
-            if (have_data)
+            if (buffer.size() > MAX_HEADERS_SIZE)
             {
-                std::chrono::time_point request_start = std::chrono::high_resolution_clock::now();
-                newsc = accept(sc, reinterpret_cast<struct sockaddr*>(&cli_addr), &clilen);
-
-                if (newsc < 0)
+                throw microserver::server_exception("ERROR headers too large");
+            }
+            auto ret = read(fd, buf, BUFSIZE);
+            if (ret <= 0)
+            {
+                if (buffer.empty())
                 {
-                    throw microserver::server_exception("ERROR on accept");
+                    // Closed by the client between requests
+                    return false;
                 }
+                throw microserver::server_exception("ERROR on parsing headers");
+            }
+            buffer.append(buf, static_cast<std::size_t>(ret));
+            header_end = buffer.find("\r\n\r\n");
+        }
 
-                // handle new connection
-                Request req;
-                Response res;
+        parse_headers(buffer.substr(0, header_end + 4), req, res);
 
-                static char buf[BUFSIZE + 1];
-                std::string content;
-                std::streamsize ret = read(newsc, buf, BUFSIZE);
-                assert(ret >= 0);
-                content = std::string(buf, static_cast<std::size_t>(ret));
+        std::size_t content_length = 0;
+        if (auto it = req.headers.find("content-length"); it != req.headers.end())
+        {
+            content_length = std::stoull(it->second);
+        }
+        const std::size_t body_start = header_end + 4;
+        while (buffer.size() - body_start < content_length)
+        {
+            auto ret = read(fd, buf, BUFSIZE);
+            if (ret <= 0)
+            {
+                throw microserver::server_exception("ERROR on reading body");
+            }
+            buffer.append(buf, static_cast<std::size_t>(ret));
+        }
+        req.body = buffer.substr(body_start, content_length);
+        // Keep what the client already sent of the next request
+        buffer.erase(0, body_start + content_length);
+        return true;
+    }
+
+    void Server::handle_connection(int fd, const sockaddr_in& cli_addr)
+    {
+        char addrbuf[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &cli_addr.sin_addr, addrbuf, sizeof(addrbuf));
+        uint16_t used_port = htons(cli_addr.sin_port);
 
-                std::size_t header_end = content.find("\r\n\r\n");
-                if (header_end == std::string::npos)
+        std::string buffer;
+        bool keep_alive = true;
+        try
+        {
+            while (keep_alive && !mamba::is_sig_interrupted())
+            {
+                if (buffer.empty() && !wait_for_socket(fd, KEEP_ALIVE_TIMEOUT_MS))
                 {
-                    throw microserver::server_exception("ERROR on parsing headers");
+                    break;
                 }
 
-                parse_headers(content, req, res);
-
-                if (req.method == "POST")
+                std::chrono::time_point request_start = std::chrono::high_resolution_clock::now();
+                Request req;
+                Response res;
+                if (!read_request(fd, buffer, req, res))
                 {
-                    std::string body = content.substr(header_end + 4, BUFSIZE - header_end - 4);
-                    std::streamsize content_length = stoll(req.headers["content-length"]);
-                    if (content_length - static_cast<std::streamsize>(body.size()) > 0)
-                    {
-                        // read the rest of the data and add to body
-                        std::streamsize remainder = content_length
-                                                    - static_cast<std::streamsize>(body.size());
-                        while (ret && remainder > 0)
-                        {
-                            std::streamsize read_ret = read(newsc, buf, BUFSIZE);
-                            body += std::string(buf, static_cast<std::size_t>(read_ret));
-                            remainder -= read_ret;
-                        }
-                    }
-                    req.body = body;
+                    break;
                 }
 
                 if (!match_route(req, res))
@@ -357,59 +464,209 @@ namespace microserver
                     res.type = "text/plain";
                     res.send("Not found");
                 }
+                keep_alive = wants_keep_alive(req);
 
-                std::stringstream buffer;
+                std::stringstream buffer_out;
                 std::string body = res.body.str();
                 std::size_t body_len = body.size();
+                std::size_t file_offset = 0;
+                if (!res.file.empty())
+                {
+                    struct stat st;
+                    if (stat(res.file.c_str(), &st) != 0)
+                    {
+                        throw server_exception("Could not stat " + res.file);
+                    }
+                    body.clear();
+                    const auto file_size = static_cast<std::size_t>(st.st_size);
+                    body_len = file_size;
+                    res.headers["Accept-Ranges"] = "bytes";
+                    const auto start = range_start(req);
+                    if (start && (res.code == 200) && (*start < file_size))
+                    {
+                        res.code = 206;
+                        res.phrase = "Partial Content";
+                        res.headers["Content-Range"] = fmt::format(
+                            "bytes {}-{}/{}",
+                            *start,
+                            file_size - 1,
+                            file_size
+                        );
+                        file_offset = *start;
+                        body_len = file_size - *start;
+                    }
+                    else if (start && (res.code == 200))
+                    {
+                        res.code = 416;
+                        res.phrase = "Range Not Satisfiable";
+                        res.headers["Content-Range"] = fmt::format("bytes */{}", file_size);
+                        res.file.clear();
+                        body_len = 0;
+                    }
+                }
 
                 // build http response
-                buffer << fmt::format("HTTP/1.0 {} {}\r\n", res.code, res.phrase)
-                       << fmt::format("Server: {} {}\r\n", SERVER_NAME, SERVER_VERSION)
-                       << fmt::format("Date: {}\r\n", res.date)
-                       << fmt::format("Content-Type: {}\r\n", res.type)
-                       << fmt::format("Content-Length: {}\r\n", body_len)
-                       // append extra crlf to indicate start of body
-                       << "\r\n";
-
-                char addrbuf[INET_ADDRSTRLEN];
-                inet_ntop(AF_INET, &cli_addr.sin_addr, addrbuf, sizeof(addrbuf));
-                uint16_t used_port = htons(cli_addr.sin_port);
+                buffer_out << fmt::format("HTTP/1.1 {} {}\r\n", res.code, res.phrase)
+                           << fmt::format("Server: {} {}\r\n", SERVER_NAME, SERVER_VERSION)
+                           << fmt::format("Date: {}\r\n", res.date)
+                           << fmt::format("Content-Type: {}\r\n", res.type)
+                           << fmt::format("Content-Length: {}\r\n", body_len)
+                           << fmt::format(
+                                  "Connection: {}\r\n",
+                                  keep_alive ? "keep-alive" : "close"
+                              );
+                for (const auto& [key, value] : res.headers)
+                {
+                    buffer_out << fmt::format("{}: {}\r\n", key, value);
+                }
+                // append extra crlf to indicate start of body
+                buffer_out << "\r\n";
+
                 std::chrono::time_point request_end = std::chrono::high_resolution_clock::now();
+                {
+                    std::lock_guard<std::mutex> lock(m_logger_mutex);
+                    m_logger.info(
+                        "{}:{} - {} {} {} (took {} ms)",
+                        addrbuf,
+                        used_port,
+                        req.method,
+                        req.path,
+                        fmt::styled(
+                            res.code,
+                            fmt::fg(
+                                res.code < 300 ? fmt::terminal_color::green
+                                               : fmt::terminal_color::red
+                            )
+                        ),
+                        std::chrono::duration_cast<std::chrono::milliseconds>(
+                            request_end - request_start
+                        )
+                            .count()
+                    );
+                }
 
-                m_logger.info(
-                    "{}:{} - {} {} {} (took {} ms)",
-                    addrbuf,
-                    used_port,
-                    req.method,
-                    req.path,
-                    fmt::styled(
-                        res.code,
-                        fmt::fg(res.code < 300 ? fmt::terminal_color::green : fmt::terminal_color::red)
-                    ),
-                    std::chrono::duration_cast<std::chrono::milliseconds>(request_end - request_start)
-                        .count()
+                // Responses to HEAD requests have the headers of the GET response only
+                bool written = write_all(fd, buffer_out.str());
+                if (written && (req.method != "HEAD"))
+                {
+                    written = res.file.empty() ? write_all(fd, body)
+                                               : write_file(fd, res.file, file_offset);
+                }
+                if (!written)
+                {
+                    LOG_ERROR << "Could not write to socket " << strerror(errno);
+                    break;
+                }
+            }
+        }
+        catch (const std::exception& e)
+        {
+            LOG_ERROR << "Error handling connection from " << addrbuf << ":" << used_port << ": "
+                      << e.what();
+        }
+        close(fd);
+    }
+
+    void Server::worker_loop()
+    {
+        while (true)
+        {
+            std::pair<int, sockaddr_in> connection;
+            {
+                std::unique_lock<std::mutex> lock(m_connections_mutex);
+                m_connections_cv.wait(
+                    lock,
+                    [this] { return m_stopping || !m_connections.empty(); }
                 );
+                if (m_connections.empty())
+                {
+                    return;
+                }
+                connection = m_connections.front();
+                m_connections.pop_front();
+            }
+            handle_connection(connection.first, connection.second);
+        }
+    }
+
+    void Server::main_loop(int port, const std::string& host)
+    {
+        int newsc;
+
+        int sc = socket(AF_INET, SOCK_STREAM, 0);
+
+        if (sc < 0)
+        {
+            throw microserver::server_exception("ERROR opening socket");
+        }
 
-                std::string header_buffer = buffer.str();
-                auto written = write(newsc, header_buffer.c_str(), header_buffer.size());
-                if (written != static_cast<std::streamsize>(header_buffer.size()))
+        struct sockaddr_in serv_addr, cli_addr;
+        serv_addr.sin_family = AF_INET;
+        serv_addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, host.c_str(), &serv_addr.sin_addr) != 1)
+        {
+            throw microserver::server_exception("ERROR invalid host " + host);
+        }
+
+        // allow faster reuse of the address
+        int optval = 1;
+        setsockopt(sc, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+
+        if (::bind(sc, reinterpret_cast<struct sockaddr*>(&serv_addr), sizeof(serv_addr)) != 0)
+        {
+            throw microserver::server_exception("ERROR on binding");
+        }
+
+        listen(sc, SOMAXCONN);
+
+        std::vector<std::thread> workers;
+        for (std::size_t i = 0; i < m_n_workers; ++i)
+        {
+            workers.emplace_back([this] { worker_loop(); });
+        }
+        auto stop_workers = [&]
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_connections_mutex);
+                m_stopping = true;
+            }
+            m_connections_cv.notify_all();
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+            close(sc);
+        };
+        mamba::on_scope_exit _{ std::move(stop_workers) };
+
+        socklen_t clilen;
+
+        while (!mamba::is_sig_interrupted())
+        {
+            bool have_data = wait_for_socket(sc);
+
+            if (have_data)
+            {
+                clilen = sizeof(cli_addr);
+                newsc = accept(sc, reinterpret_cast<struct sockaddr*>(&cli_addr), &clilen);
+
+                if (newsc < 0)
                 {
-                    LOG_ERROR << "Could not write to socket " << strerror(errno);
-                    continue;
+                    throw microserver::server_exception("ERROR on accept");
                 }
-                written = write(newsc, body.c_str(), body_len);
-                if (written != static_cast<std::streamsize>(body_len))
+
                 {
-                    LOG_ERROR << "Could not write to socket " << strerror(errno);
-                    continue;
+                    std::lock_guard<std::mutex> lock(m_connections_mutex);
+                    m_connections.emplace_back(newsc, cli_addr);
                 }
+                m_connections_cv.notify_one();
             }
         }
     }
 
-    bool Server::start(int port)
+    bool Server::start(int port, const std::string& host)
     {
-        this->main_loop(port);
+        this->main_loop(port, host);
         return true;
     }
 }
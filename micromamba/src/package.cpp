@@ -78,9 +78,13 @@ set_package_command(CLI::App* subcom, Configuration& config)
         }
     );
 
+    static std::vector<std::string> transmute_files;
+    static int transmute_threads = 0;
+    static std::size_t transmute_jobs = 0;
+
     auto transmute_subcom = subcom->add_subcommand("transmute");
     init_general_options(transmute_subcom, config);
-    transmute_subcom->add_option("infile", infile, "Folder to compress");
+    transmute_subcom->add_option("infiles", transmute_files, "Packages to transmute");
     transmute_subcom->add_option(
         "-c,--compression-level",
         compression_level,
@@ -88,8 +92,14 @@ set_package_command(CLI::App* subcom, Configuration& config)
     );
     transmute_subcom->add_option(
         "--compression-threads",
-        compression_threads,
-        "Compression threads (only relevant for .conda packages, default is 1)"
+        transmute_threads,
+        "Compression threads per package (only relevant for .conda packages, default is 0 to "
+        "share all the cores between the packages)"
+    );
+    transmute_subcom->add_option(
+        "-j,--jobs",
+        transmute_jobs,
+        "Number of packages transmuted at once (default is 0 for the number of cores)"
     );
     transmute_subcom->callback(
         [&]()
@@ -97,25 +107,37 @@ set_package_command(CLI::App* subcom, Configuration& config)
             // load verbose and other options to context
             config.load();
 
-            if (ends_with(infile, ".tar.bz2"))
+            std::vector<std::pair<fs::u8path, fs::u8path>> packages;
+            for (const auto& file : transmute_files)
             {
-                if (compression_level == -1)
+                std::string target;
+                if (ends_with(file, ".tar.bz2"))
                 {
-                    compression_level = 15;
+                    target = file.substr(0, file.size() - 8) + ".conda";
                 }
-                dest = infile.substr(0, infile.size() - 8) + ".conda";
-            }
-            else
-            {
-                if (compression_level == -1)
+                else
                 {
-                    compression_level = 9;
+                    target = file.substr(0, file.size() - 6) + ".tar.bz2";
                 }
-                dest = infile.substr(0, infile.size() - 8) + ".tar.bz2";
+                Console::stream() << "Transmuting " << fs::absolute(file) << " to " << target
+                                  << std::endl;
+                packages.push_back({ fs::absolute(file), fs::absolute(target) });
+            }
+
+            const auto errors = transmute_packages(
+                packages,
+                compression_level,
+                transmute_threads,
+                transmute_jobs
+            );
+            for (const auto& error : errors)
+            {
+                LOG_ERROR << "Could not transmute " << error;
+            }
+            if (!errors.empty())
+            {
+                throw std::runtime_error("Some packages could not be transmuted");
             }
-            Console::stream() << "Transmuting " << fs::absolute(infile) << " to " << dest
-                              << std::endl;
-            transmute(fs::absolute(infile), fs::absolute(dest), compression_level, compression_threads);
         }
     );
 }
@@ -8,7 +8,11 @@
 #include <unistd.h>
 #define PORT 8080
 
+#include <algorithm>
+#include <chrono>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <unordered_map>
 
 #include <CLI/CLI.hpp>
@@ -18,8 +22,16 @@
 #include "mamba/api/configuration.hpp"
 #include "mamba/core/channel.hpp"
 #include "mamba/core/context.hpp"
+#include "mamba/core/execution.hpp"
+#include "mamba/core/fetch.hpp"
+#include "mamba/core/fsutil.hpp"
+#include "mamba/core/metrics.hpp"
+#include "mamba/core/query.hpp"
 #include "mamba/core/solver.hpp"
+#include "mamba/core/subdirdata.hpp"
 #include "mamba/core/transaction.hpp"
+#include "mamba/core/url.hpp"
+#include "mamba/core/validate.hpp"
 #include "mamba/core/virtual_packages.hpp"
 
 #include "common_options.hpp"
@@ -48,68 +60,584 @@ load_pool(
     return pool;
 }
 
-void
-handle_solve_request(
-    const microserver::Request& req,
-    microserver::Response& res,
-    mamba::ChannelContext& channel_context
-)
+namespace
 {
-    auto& ctx = Context::instance();
-
-    struct cache
+    struct PoolCacheEntry
     {
         std::optional<mamba::MPool> pool;
         std::chrono::time_point<std::chrono::system_clock> last_update;
+        fs::file_time_type repodata_mtime;
     };
 
-    static std::unordered_map<std::string, cache> cache_map;
+    /** The latest change of the repodata caches, which other commands update as well. */
+    fs::file_time_type repodata_cache_mtime()
+    {
+        auto latest = fs::file_time_type::min();
+        for (const auto& pkgs_dir : Context::instance().pkgs_dirs)
+        {
+            std::error_code ec;
+            for (const auto& entry : fs::directory_iterator(pkgs_dir / "cache", ec))
+            {
+                const auto mtime = entry.last_write_time(ec);
+                if (!ec)
+                {
+                    latest = std::max(latest, mtime);
+                }
+            }
+        }
+        return latest;
+    }
 
-    auto j = nlohmann::json::parse(req.body);
-    std::vector<std::string> specs = j["specs"].get<std::vector<std::string>>();
-    std::vector<std::string> channels = j["channels"].get<std::vector<std::string>>();
-    std::vector<std::string> virtual_packages = j["virtual_packages"].get<std::vector<std::string>>();
-    std::string platform = j["platform"];
+    /** The time to live of repodata, where 1 means the one of the server, not known here. */
+    std::chrono::seconds repodata_ttl()
+    {
+        const auto& ctx = Context::instance();
+        return ctx.local_repodata_ttl != 1 ? std::chrono::seconds(ctx.local_repodata_ttl)
+                                           : std::chrono::seconds(std::chrono::minutes(30));
+    }
 
-    ctx.platform = platform;
+    /**
+     * The pool of the given channels, kept loaded between requests.
+     *
+     * It is reloaded when the repodata cache changed on disk, or when it is older than the
+     * repodata time to live, so that upstream updates are fetched.
+     */
+    MPool& get_pool(
+        const std::vector<std::string>& channels,
+        const std::string& platform,
+        MultiPackageCache& package_caches,
+        mamba::ChannelContext& channel_context
+    )
+    {
+        static std::unordered_map<std::string, PoolCacheEntry> cache_map;
+
+        const auto ttl = repodata_ttl();
+        const std::string cache_key = mamba::join(", ", channels) + fmt::format(", {}", platform);
+        const auto repodata_mtime = repodata_cache_mtime();
+
+        auto entry_it = cache_map.find(cache_key);
+        if ((entry_it == cache_map.end())
+            || (std::chrono::system_clock::now() - entry_it->second.last_update > ttl)
+            || (entry_it->second.repodata_mtime != repodata_mtime))
+        {
+            auto pool = load_pool(channels, package_caches, channel_context);
+            // Loading may refresh the repodata cache
+            entry_it = cache_map
+                           .insert_or_assign(
+                               cache_key,
+                               PoolCacheEntry{ std::move(pool),
+                                               std::chrono::system_clock::now(),
+                                               repodata_cache_mtime() }
+                           )
+                           .first;
+        }
+        return *entry_it->second.pool;
+    }
+
+    /** Package caches are kept as well, to avoid scanning the package directories again. */
+    MultiPackageCache& get_package_caches()
+    {
+        static std::optional<MultiPackageCache> package_caches;
+        static std::vector<fs::u8path> pkgs_dirs;
+        const auto& ctx = Context::instance();
+        if (!package_caches || (pkgs_dirs != ctx.pkgs_dirs))
+        {
+            pkgs_dirs = ctx.pkgs_dirs;
+            package_caches.emplace(pkgs_dirs);
+        }
+        return *package_caches;
+    }
+
+    std::vector<std::string> request_channels(
+        const nlohmann::json& j,
+        const std::vector<std::string>& specs,
+        mamba::ChannelContext& channel_context
+    )
+    {
+        std::vector<std::string> channels = j["channels"].get<std::vector<std::string>>();
+        for (const auto& s : specs)
+        {
+            if (auto m = MatchSpec{ s, channel_context }; !m.channel.empty())
+            {
+                channels.push_back(m.channel);
+            }
+        }
+        return channels;
+    }
+
+    /** Whether @p fn can be a package of the package caches, and nothing else. */
+    bool is_package_filename(const std::string& fn)
+    {
+        return (fn.find('/') == std::string::npos) && (fn.find("..") == std::string::npos)
+               && (ends_with(fn, ".conda") || ends_with(fn, ".tar.bz2"));
+    }
+
+    /** The tarball @p fn in the package caches, empty if missing. */
+    fs::u8path find_tarball(const std::string& fn)
+    {
+        for (const auto& pkgs_dir : Context::instance().pkgs_dirs)
+        {
+            std::error_code ec;
+            if (fs::is_regular_file(pkgs_dir / fn, ec))
+            {
+                return pkgs_dir / fn;
+            }
+        }
+        return {};
+    }
+
+    /** A mutex per downloaded file, so that concurrent requests wait for the first download. */
+    std::mutex& download_mutex(const std::string& key)
+    {
+        static std::mutex mutex;
+        static std::unordered_map<std::string, std::mutex> download_mutexes;
+        std::lock_guard<std::mutex> lock(mutex);
+        return download_mutexes[key];
+    }
+
+    fs::u8path first_writable_pkgs_dir()
+    {
+        for (const auto& pkgs_dir : Context::instance().pkgs_dirs)
+        {
+            if (path::is_writable(pkgs_dir))
+            {
+                return pkgs_dir;
+            }
+        }
+        return {};
+    }
+
+    /** The channel index files served by the proxy, other than the package tarballs. */
+    bool is_index_filename(const std::string& fn)
+    {
+        return (fn == "repodata.json") || (fn == "current_repodata.json")
+               || (fn == "repodata.jlap");
+    }
+
+    /** The metadata of a proxied index file, such as its upstream validators. */
+    fs::u8path state_path(const fs::u8path& file)
+    {
+        return file.string() + ".state.json";
+    }
+
+    nlohmann::json read_index_state(const fs::u8path& file)
+    {
+        std::error_code ec;
+        if (!fs::is_regular_file(file, ec) || !fs::is_regular_file(state_path(file), ec))
+        {
+            return nlohmann::json::object();
+        }
+        try
+        {
+            return nlohmann::json::parse(open_ifstream(state_path(file)));
+        }
+        catch (const std::exception&)
+        {
+            return nlohmann::json::object();
+        }
+    }
+
+    /** Whether @p file was checked against its upstream within the repodata time to live. */
+    bool is_index_fresh(const fs::u8path& file)
+    {
+        std::error_code ec;
+        const auto checked = fs::last_write_time(state_path(file), ec);
+        return !ec && (fs::file_time_type::clock::now() - checked < repodata_ttl());
+    }
+
+    /**
+     * Download the index file @p file from @p url, or revalidate it with the stored validators.
+     *
+     * Json indices are fetched compressed when the upstream publishes them so, but kept
+     * decompressed, since DownloadTarget decompresses them.
+     */
+    bool refresh_index(const std::string& url, const fs::u8path& file)
+    {
+        std::lock_guard<std::mutex> download_lock(download_mutex(file.string()));
+        if (is_index_fresh(file))
+        {
+            return true;
+        }
+        auto state = read_index_state(file);
+        const bool compressible = ends_with(url, ".json");
+        const std::string from = state.value("url", compressible ? url + ".zst" : url);
+        const auto partial = file.string() + ".part";
+
+        DownloadTarget target(url, from, partial);
+        if (compressible && (from != url))
+        {
+            target.set_fallback_url(url, true);
+        }
+        if (!state.empty())
+        {
+            target.set_mod_etag_headers(state.value("mod", ""), state.value("etag", ""));
+        }
+        target.perform();
+        const int status = target.get_http_status();
+        std::error_code ec;
+        if (status == 304)
+        {
+            LOG_INFO << "Proxied '" << url << "' not modified";
+        }
+        else if ((status == 200) && fs::is_regular_file(partial, ec))
+        {
+            LOG_INFO << "Proxied '" << url << "' updated";
+            fs::rename(partial, file);
+            state = { { "url", target.get_url() },
+                      { "etag", target.get_etag() },
+                      { "mod", target.get_mod() },
+                      { "cache_control", target.get_cache_control() } };
+        }
+        else
+        {
+            LOG_WARNING << "Could not refresh proxied '" << url << "' (response: " << status
+                        << ")";
+            fs::remove(partial, ec);
+            return false;
+        }
+        // Written on not modified responses as well, the time of the last check
+        open_ofstream(state_path(file)) << state.dump();
+        return true;
+    }
+
+    /** The size and sha256 of a package, as recorded in the repodata of its channel. */
+    struct PackageChecksum
+    {
+        std::size_t size = 0;
+        std::string sha256;
+    };
 
-    for (const auto& s : specs)
+    /**
+     * The checksum of the package @p fn in the repodata index @p file, if it has one.
+     *
+     * The records of each index are parsed once per version of the file.
+     */
+    std::optional<PackageChecksum> package_checksum(const fs::u8path& file, const std::string& fn)
     {
-        if (auto m = MatchSpec{ s, channel_context }; !m.channel.empty())
+        using checksum_map = std::unordered_map<std::string, PackageChecksum>;
+        static std::mutex mutex;
+        static std::unordered_map<std::string, std::pair<fs::file_time_type, checksum_map>> cache;
+
+        std::error_code ec;
+        const auto mtime = fs::last_write_time(file, ec);
+        if (ec)
+        {
+            return std::nullopt;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& [cached_mtime, checksums] = cache[file.string()];
+        if (checksums.empty() || (cached_mtime != mtime))
         {
-            channels.push_back(m.channel);
+            checksums.clear();
+            try
+            {
+                const auto j = nlohmann::json::parse(open_ifstream(file));
+                for (const auto* key : { "packages", "packages.conda" })
+                {
+                    const auto records = j.value(key, nlohmann::json::object());
+                    for (const auto& [filename, record] : records.items())
+                    {
+                        checksums[filename] = { record.value("size", std::size_t(0)),
+                                                record.value("sha256", "") };
+                    }
+                }
+            }
+            catch (const std::exception& e)
+            {
+                LOG_WARNING << "Could not read the records of " << file << ": " << e.what();
+                checksums.clear();
+            }
+            cached_mtime = mtime;
         }
+        const auto it = checksums.find(fn);
+        if ((it == checksums.end()) || it->second.sha256.empty())
+        {
+            return std::nullopt;
+        }
+        return it->second;
     }
 
-    std::string cache_key = mamba::join(", ", channels) + fmt::format(", {}", platform);
-    MultiPackageCache package_caches(ctx.pkgs_dirs);
+    /**
+     * Download the tarball @p fn from @p url into the first writable package cache.
+     *
+     * The tarball is only published in the cache once its size and sha256 match the record
+     * of the repodata of its channel, refreshed first if expired.
+     * Concurrent requests of the same package wait for the first download.
+     */
+    fs::u8path pull_tarball(const std::string& fn, const std::string& url)
+    {
+        std::lock_guard<std::mutex> download_lock(download_mutex(fn));
+        if (auto path = find_tarball(fn); !path.empty())
+        {
+            return path;
+        }
+        const auto target_dir = first_writable_pkgs_dir();
+        if (target_dir.empty())
+        {
+            return {};
+        }
+
+        const auto repodata_url = concat(url.substr(0, url.size() - fn.size()), "repodata.json");
+        const auto index_file = target_dir / "proxy" / cache_fn_url(repodata_url);
+        fs::create_directories(index_file.parent_path());
+        if (!refresh_index(repodata_url, index_file))
+        {
+            return {};
+        }
+        const auto checksum = package_checksum(index_file, fn);
+        if (!checksum.has_value())
+        {
+            LOG_WARNING << "No sha256 for '" << fn << "' in '" << repodata_url << "'";
+            return {};
+        }
+
+        const auto path = target_dir / fn;
+        const auto partial = fs::u8path(path.string() + ".part");
+        DownloadTarget target(fn, url, partial.string());
+        target.set_resumable(true);
+        target.set_expected_size(checksum->size);
+        target.set_hash(validation::HashStream::sha256());
+        std::error_code ec;
+        if (!target.perform() || (target.get_http_status() >= 400))
+        {
+            fs::remove(partial, ec);
+            return {};
+        }
+        if ((target.get_downloaded_size() != checksum->size)
+            || (target.get_hex_digest().value_or("") != checksum->sha256))
+        {
+            LOG_WARNING << "Downloaded '" << url << "' does not match its repodata record";
+            fs::remove(partial, ec);
+            return {};
+        }
+        fs::rename(partial, path);
+        return path;
+    }
 
-    if (cache_map.find(cache_key) == cache_map.end())
+    /** Refresh @p file in the background, once at a time. */
+    void schedule_index_refresh(const std::string& url, const fs::u8path& file)
     {
-        cache_map.insert_or_assign(
-            cache_key,
-            cache{ load_pool(channels, package_caches, channel_context),
-                   std::chrono::system_clock::now() }
+        static std::mutex mutex;
+        static std::set<std::string> refreshing;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!refreshing.insert(file.string()).second)
+            {
+                return;
+            }
+        }
+        MainExecutor::instance().schedule(
+            [url, file]()
+            {
+                try
+                {
+                    refresh_index(url, file);
+                }
+                catch (const std::exception& e)
+                {
+                    LOG_WARNING << "Could not refresh proxied '" << url << "': " << e.what();
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                refreshing.erase(file.string());
+            }
         );
     }
-    else
+
+    /**
+     * The urls of the channels packages are downloaded from for peers, each ending with a
+     * slash: the channel alias and the configured channels.
+     */
+    std::vector<std::string> package_upstreams(mamba::ChannelContext& channel_context)
+    {
+        const auto& ctx = Context::instance();
+        auto names = ctx.channels;
+        for (const auto& [name, url] : ctx.custom_channels)
+        {
+            names.push_back(name);
+        }
+        auto upstreams = std::vector<std::string>{ concat(rstrip(ctx.channel_alias, '/'), "/") };
+        for (const auto* channel : channel_context.get_channels(names))
+        {
+            upstreams.push_back(concat(rstrip(channel->base_url(), '/'), "/"));
+        }
+        return upstreams;
+    }
+
+    void send_not_found(microserver::Response& res)
+    {
+        res.code = 404;
+        res.phrase = "Not Found";
+        res.type = "text/plain";
+        res.send("Not found");
+    }
+
+    void send_bad_gateway(microserver::Response& res, const std::string& url)
+    {
+        res.code = 502;
+        res.phrase = "Bad Gateway";
+        res.type = "text/plain";
+        res.send("Could not download " + url);
+    }
+}
+
+/**
+ * Serve a package tarball of the package caches, to clients with this server in their
+ * ``package_cache_peers``.
+ *
+ * Missing packages are downloaded first from the ``url`` of the query, if it is in one of
+ * the @p upstreams channels, so that the other clients of the network get them from this
+ * cache.
+ */
+void
+handle_package_request(
+    const microserver::Request& req,
+    microserver::Response& res,
+    const std::vector<std::string>& upstreams
+)
+{
+    const std::string fn = req.path.substr(std::string("/pkgs/").size());
+    if (!is_package_filename(fn))
+    {
+        res.code = 400;
+        res.phrase = "Bad Request";
+        res.type = "text/plain";
+        res.send("Not a package filename");
+        return;
+    }
+    auto path = find_tarball(fn);
+    if (auto it = req.query.find("url"); path.empty() && (it != req.query.end()))
+    {
+        const std::string url = decode_url(it->second);
+        const bool from_upstream = std::any_of(
+            upstreams.cbegin(),
+            upstreams.cend(),
+            [&url](const std::string& upstream) { return starts_with(url, upstream); }
+        );
+        if (from_upstream && (url.find("..") == std::string::npos) && ends_with(url, "/" + fn))
+        {
+            path = pull_tarball(fn, url);
+            if (path.empty())
+            {
+                return send_bad_gateway(res, url);
+            }
+        }
+    }
+    if (path.empty())
+    {
+        return send_not_found(res);
+    }
+    res.type = "application/octet-stream";
+    res.file = path.string();
+}
+
+/**
+ * Serve the channels of the ``channel_alias`` of this server, as a caching proxy.
+ *
+ * The path of the request is the one below the channel alias, such as
+ * ``/conda-forge/linux-64/repodata.json``. Package tarballs are served from the package
+ * caches, and downloaded on a miss. Index files are kept in a ``proxy`` directory of the
+ * package cache and revalidated upstream with their ``ETag`` once older than the repodata
+ * time to live, in the background while the expired copy is served.
+ */
+void
+handle_proxy_request(const microserver::Request& req, microserver::Response& res)
+{
+    const auto parts = split(std::string_view(req.path).substr(1), "/");
+    const std::string fn = parts.back();
+    const bool invalid_path = (parts.size() < 3) || (req.path.find("..") != std::string::npos)
+                              || std::any_of(
+                                  parts.begin(),
+                                  parts.end(),
+                                  [](const std::string& p) { return p.empty(); }
+                              );
+    if (invalid_path || !(is_package_filename(fn) || is_index_filename(fn)))
+    {
+        return send_not_found(res);
+    }
+    const std::string url = concat(rstrip(Context::instance().channel_alias, '/'), req.path);
+
+    if (is_package_filename(fn))
+    {
+        auto path = find_tarball(fn);
+        if (path.empty() && (path = pull_tarball(fn, url)).empty())
+        {
+            return send_bad_gateway(res, url);
+        }
+        res.type = "application/octet-stream";
+        res.file = path.string();
+        return;
+    }
+
+    const auto cache_dir = first_writable_pkgs_dir();
+    if (cache_dir.empty())
+    {
+        return send_bad_gateway(res, url);
+    }
+    const auto file = cache_dir / "proxy" / cache_fn_url(url);
+    std::error_code ec;
+    if (!fs::is_regular_file(file, ec))
     {
-        cache& c = cache_map[cache_key];
-        if (std::chrono::system_clock::now() - c.last_update > std::chrono::minutes(30))
+        fs::create_directories(file.parent_path());
+        if (!refresh_index(url, file))
         {
-            cache_map.insert_or_assign(
-                cache_key,
-                cache{ load_pool(channels, package_caches, channel_context),
-                       std::chrono::system_clock::now() }
-            );
+            return send_bad_gateway(res, url);
         }
     }
-    auto entry_it = cache_map.find(cache_key);
-    if (entry_it == cache_map.end())
+    else if (!is_index_fresh(file))
+    {
+        schedule_index_refresh(url, file);
+    }
+
+    const auto state = read_index_state(file);
+    const std::string etag = state.value("etag", "");
+    const std::string mod = state.value("mod", "");
+    const auto header = [&req](const std::string& key) -> std::string
+    {
+        auto it = req.headers.find(key);
+        return it != req.headers.end() ? it->second : "";
+    };
+    if (!etag.empty())
+    {
+        res.headers["ETag"] = etag;
+    }
+    if (!mod.empty())
+    {
+        res.headers["Last-Modified"] = mod;
+    }
+    if (const std::string cache_control = state.value("cache_control", ""); !cache_control.empty())
     {
-        throw std::runtime_error("invalid cache state");
+        res.headers["Cache-Control"] = cache_control;
     }
-    cache cache_entry = entry_it->second;
+    if ((!etag.empty() && (header("if-none-match") == etag))
+        || (etag.empty() && !mod.empty() && (header("if-modified-since") == mod)))
+    {
+        res.code = 304;
+        res.phrase = "Not Modified";
+        return;
+    }
+    res.type = ends_with(fn, ".json") ? "application/json" : "text/plain";
+    res.file = file.string();
+}
+
+void
+handle_solve_request(
+    const microserver::Request& req,
+    microserver::Response& res,
+    mamba::ChannelContext& channel_context
+)
+{
+    auto& ctx = Context::instance();
+
+    auto j = nlohmann::json::parse(req.body);
+    std::vector<std::string> specs = j["specs"].get<std::vector<std::string>>();
+    std::vector<std::string> virtual_packages = j["virtual_packages"].get<std::vector<std::string>>();
+    std::string platform = j["platform"];
+
+    ctx.platform = platform;
+
+    const auto channels = request_channels(j, specs, channel_context);
+    MultiPackageCache& package_caches = get_package_caches();
+    MPool& pool = get_pool(channels, platform, package_caches, channel_context);
 
     TemporaryDirectory tmp_dir;
     auto exp_prefix_data = PrefixData::create(tmp_dir.path(), channel_context);
@@ -130,10 +658,10 @@ handle_solve_request(
     }
     prefix_data.add_packages(vpacks);
 
-    auto installed_repo = MRepo(*cache_entry.pool, prefix_data);
+    auto installed_repo = MRepo(pool, prefix_data);
 
     MSolver solver(
-        *cache_entry.pool,
+        pool,
         { { SOLVER_FLAG_ALLOW_UNINSTALL, ctx.allow_uninstall },
           { SOLVER_FLAG_ALLOW_DOWNGRADE, ctx.allow_downgrade },
           { SOLVER_FLAG_STRICT_REPO_PRIORITY, ctx.channel_priority == ChannelPriority::kStrict } }
@@ -151,7 +679,7 @@ handle_solve_request(
     }
     else
     {
-        MTransaction trans{ *cache_entry.pool, solver, package_caches };
+        MTransaction trans{ pool, solver, package_caches };
         auto to_install = std::get<1>(trans.to_conda());
         std::vector<nlohmann::json> packages;
         for (auto& p : to_install)
@@ -163,13 +691,71 @@ handle_solve_request(
         res.send(jout.dump());
     }
 
-    cache_entry.pool->remove_repo(installed_repo.id(), /* reuse_ids= */ true);
-    pool_set_installed(*cache_entry.pool, nullptr);
+    pool.remove_repo(installed_repo.id(), /* reuse_ids= */ true);
+    pool_set_installed(pool, nullptr);
+}
+
+void
+handle_query_request(
+    const microserver::Request& req,
+    microserver::Response& res,
+    mamba::ChannelContext& channel_context
+)
+{
+    auto& ctx = Context::instance();
+
+    auto j = nlohmann::json::parse(req.body);
+    const std::string type = j.value("type", "search");
+    const std::string spec = j["spec"];
+    const bool tree = j.value("tree", false);
+    std::string platform = j["platform"];
+
+    ctx.platform = platform;
+
+    const auto channels = request_channels(j, { spec }, channel_context);
+    MPool& pool = get_pool(channels, platform, get_package_caches(), channel_context);
+
+    Query q(pool);
+    if (type == "search")
+    {
+        res.send(q.find(spec).json(channel_context).dump());
+    }
+    else if (type == "depends")
+    {
+        res.send(q.depends(spec, tree).json(channel_context).dump());
+    }
+    else if (type == "whoneeds")
+    {
+        res.send(q.whoneeds(spec, tree).json(channel_context).dump());
+    }
+    else if (type == "names")
+    {
+        // Completion of a name prefix, unless a pattern is given
+        const auto pattern = (spec.find('*') == std::string::npos) ? spec + "*" : spec;
+        auto names = nlohmann::json::array();
+        for (const Id name : pool.match_names(pattern))
+        {
+            names.push_back(pool_id2str(pool, name));
+        }
+        res.send(nlohmann::json{ { "names", std::move(names) } }.dump());
+    }
+    else
+    {
+        res.code = 400;
+        res.phrase = "Bad Request";
+        res.send(nlohmann::json{ { "error_msg", "Unknown query type " + type } }.dump());
+    }
 }
 
 
 int
-run_server(int port, mamba::ChannelContext& channel_context, Configuration& config)
+run_server(
+    int port,
+    const std::string& host,
+    std::size_t n_workers,
+    mamba::ChannelContext& channel_context,
+    Configuration& config
+)
 {
     config.load();
     std::signal(SIGPIPE, SIG_IGN);
@@ -179,10 +765,11 @@ run_server(int port, mamba::ChannelContext& channel_context, Configuration& conf
 
     spdlog::logger logger("server", { server_sink });
 
-    microserver::Server xserver(logger);
+    microserver::Server xserver(logger, n_workers);
     xserver.get(
         "/hello",
-        [](const microserver::Request&, microserver::Response& res) { res.send("Hello World!"); }
+        [](const microserver::Request&, microserver::Response& res) { res.send("Hello World!"); },
+        /* concurrent= */ true
     );
     xserver.get(
         "/",
@@ -192,17 +779,42 @@ run_server(int port, mamba::ChannelContext& channel_context, Configuration& conf
             std::stringstream ss;
             ss << "Micromamba version " << UMAMBA_VERSION_STRING << "\n";
             res.send(ss.str());
-        }
+        },
+        /* concurrent= */ true
+    );
+    xserver.get(
+        "/metrics",
+        [](const microserver::Request&, microserver::Response& res)
+        {
+            res.type = "text/plain; version=0.0.4";
+            res.send(Metrics::instance().to_prometheus());
+        },
+        /* concurrent= */ true
+    );
+    xserver.get(
+        "/pkgs/*",
+        [upstreams = package_upstreams(channel_context)](
+            const microserver::Request& req,
+            microserver::Response& res
+        ) { handle_package_request(req, res, upstreams); },
+        /* concurrent= */ true
     );
+    // Last, as it matches any path
+    xserver.get("/*", handle_proxy_request, /* concurrent= */ true);
     xserver.post(
         "/solve",
         [&](const microserver::Request& req, microserver::Response& res)
         { return handle_solve_request(req, res, channel_context); }
     );
+    xserver.post(
+        "/query",
+        [&](const microserver::Request& req, microserver::Response& res)
+        { return handle_query_request(req, res, channel_context); }
+    );
 
-    Console::stream() << "Starting server on port http://localhost:" << port << std::endl;
+    Console::stream() << "Starting server on http://" << host << ":" << port << std::endl;
 
-    xserver.start(port);
+    xserver.start(port, host);
     return 0;
 }
 
@@ -213,12 +825,16 @@ set_server_command(CLI::App* subcom, mamba::Configuration& config)
 
     static int port = 1234;
     subcom->add_option("--port,-p", port, "The port to use for the server");
+    static std::string host = "127.0.0.1";
+    subcom->add_option("--host", host, "The address to listen on, only local clients by default");
+    static std::size_t n_workers = 4;
+    subcom->add_option("--workers", n_workers, "The number of threads handling connections");
 
     subcom->callback(
         [&config]
         {
             mamba::ChannelContext channel_context;
-            return run_server(port, channel_context, config);
+            return run_server(port, host, n_workers, channel_context, config);
         }
     );
 }
@@ -107,6 +107,14 @@ namespace
         config.at("target_prefix_checks").set_value(MAMBA_NO_PREFIX_CHECK);
     }
 
+    /** Configurables used by the activation, loaded alone since shells run it frequently. */
+    auto activation_configurables() -> std::vector<std::string>
+    {
+        return {
+            "changeps1", "env_prompt", "shell_completion", "auto_activate_base", "activation_cache"
+        };
+    }
+
     auto consolidate_shell(std::string_view shell_type) -> std::string
     {
         if (!shell_type.empty())
@@ -162,6 +170,12 @@ namespace
         init_general_options(subsubcmd, config);
         init_shell_option(subsubcmd, config);
         init_root_prefix_option(subsubcmd, config);
+        auto& static_hook = config.at("static_shell_hook");
+        subsubcmd->add_flag(
+            "--static",
+            static_hook.get_cli_config<bool>(),
+            static_hook.description()
+        );
         subsubcmd->callback(
             [&config]()
             {
@@ -219,7 +233,7 @@ namespace
             [&config]()
             {
                 set_default_config_options(config);
-                config.load();
+                config.load(activation_configurables());
                 shell_hook(consolidate_shell(config.at("shell_type").compute().value<std::string>()));
                 config.operation_teardown();
             }
@@ -238,7 +252,9 @@ namespace
             {
                 set_default_config_options(config);
                 consolidate_prefix_options(config);
-                config.load();
+                auto names = activation_configurables();
+                names.push_back("target_prefix");
+                config.load(std::move(names));
                 shell_activate(
                     Context::instance().prefix_params.target_prefix,
                     consolidate_shell(config.at("shell_type").compute().value<std::string>()),
@@ -257,7 +273,7 @@ namespace
             [&config]()
             {
                 set_default_config_options(config);
-                config.load();
+                config.load(activation_configurables());
                 shell_reactivate(
                     consolidate_shell(config.at("shell_type").compute().value<std::string>())
                 );
@@ -274,7 +290,7 @@ namespace
             [&config]()
             {
                 set_default_config_options(config);
-                config.load();
+                config.load(activation_configurables());
                 shell_deactivate(config.at("shell_type").compute().value<std::string>());
                 config.operation_teardown();
             }
@@ -15,6 +15,33 @@
 
 using namespace mamba;  // NOLINT(build/namespaces)
 
+namespace
+{
+    using set_command_t = void (*)(CLI::App*, Configuration&);
+
+    /**
+     * Define the options of a subcommand, only when it is parsed if @p lazy.
+     *
+     * Defining the options of all the subcommands is a large part of the startup time,
+     * while at most one of them is used.
+     * The help of the main command only needs the names and descriptions of the subcommands.
+     */
+    void
+    define_options(CLI::App* subcom, Configuration& config, set_command_t set_command, bool lazy)
+    {
+        if (lazy)
+        {
+            subcom->preparse_callback(
+                [subcom, &config, set_command](std::size_t) { set_command(subcom, config); }
+            );
+        }
+        else
+        {
+            set_command(subcom, config);
+        }
+    }
+}
+
 void
 init_umamba_options(CLI::App* subcom, Configuration& config)
 {
@@ -23,7 +50,7 @@ init_umamba_options(CLI::App* subcom, Configuration& config)
 }
 
 void
-set_umamba_command(CLI::App* com, mamba::Configuration& config)
+set_umamba_command(CLI::App* com, mamba::Configuration& config, bool lazy)
 {
     init_umamba_options(com, config);
 
@@ -38,77 +65,98 @@ set_umamba_command(CLI::App* com, mamba::Configuration& config)
     com->add_flag_function("--version", print_version);
 
     CLI::App* shell_subcom = com->add_subcommand("shell", "Generate shell init scripts");
-    set_shell_command(shell_subcom, config);
+    define_options(shell_subcom, config, set_shell_command, lazy);
 
     CLI::App* create_subcom = com->add_subcommand("create", "Create new environment");
-    set_create_command(create_subcom, config);
+    define_options(create_subcom, config, set_create_command, lazy);
 
     CLI::App* install_subcom = com->add_subcommand("install", "Install packages in active environment");
-    set_install_command(install_subcom, config);
+    define_options(install_subcom, config, set_install_command, lazy);
 
     CLI::App* update_subcom = com->add_subcommand("update", "Update packages in active environment");
-    set_update_command(update_subcom, config);
+    define_options(update_subcom, config, set_update_command, lazy);
 
     CLI::App* self_update_subcom = com->add_subcommand("self-update", "Update micromamba");
-    set_self_update_command(self_update_subcom, config);
+    define_options(self_update_subcom, config, set_self_update_command, lazy);
 
     CLI::App* repoquery_subcom = com->add_subcommand(
         "repoquery",
         "Find and analyze packages in active environment or channels"
     );
-    set_repoquery_command(repoquery_subcom, config);
+    define_options(repoquery_subcom, config, set_repoquery_command, lazy);
 
     CLI::App* remove_subcom = com->add_subcommand("remove", "Remove packages from active environment");
-    set_remove_command(remove_subcom, config);
+    define_options(remove_subcom, config, set_remove_command, lazy);
 
     CLI::App* list_subcom = com->add_subcommand("list", "List packages in active environment");
-    set_list_command(list_subcom, config);
+    define_options(list_subcom, config, set_list_command, lazy);
 
     CLI::App* package_subcom = com->add_subcommand(
         "package",
         "Extract a package or bundle files into an archive"
     );
-    set_package_command(package_subcom, config);
+    define_options(package_subcom, config, set_package_command, lazy);
+
+    CLI::App* index_subcom = com->add_subcommand(
+        "index",
+        "Write the repodata of the packages of a local channel"
+    );
+    define_options(index_subcom, config, set_index_command, lazy);
 
     CLI::App* clean_subcom = com->add_subcommand("clean", "Clean package cache");
-    set_clean_command(clean_subcom, config);
+    define_options(clean_subcom, config, set_clean_command, lazy);
 
     CLI::App* config_subcom = com->add_subcommand("config", "Configuration of micromamba");
-    set_config_command(config_subcom, config);
+    define_options(config_subcom, config, set_config_command, lazy);
 
     CLI::App* info_subcom = com->add_subcommand("info", "Information about micromamba");
-    set_info_command(info_subcom, config);
+    define_options(info_subcom, config, set_info_command, lazy);
 
     CLI::App* constructor_subcom = com->add_subcommand(
         "constructor",
         "Commands to support using micromamba in constructor"
     );
-    set_constructor_command(constructor_subcom, config);
+    define_options(constructor_subcom, config, set_constructor_command, lazy);
 
     CLI::App* env_subcom = com->add_subcommand("env", "List environments");
-    set_env_command(env_subcom, config);
+    define_options(env_subcom, config, set_env_command, lazy);
 
     CLI::App* activate_subcom = com->add_subcommand("activate", "Activate an environment");
-    set_activate_command(activate_subcom);
+    define_options(
+        activate_subcom,
+        config,
+        [](CLI::App* subcom, Configuration&) { set_activate_command(subcom); },
+        lazy
+    );
 
     CLI::App* run_subcom = com->add_subcommand("run", "Run an executable in an environment");
-    set_run_command(run_subcom, config);
+    define_options(run_subcom, config, set_run_command, lazy);
 
     CLI::App* ps_subcom = com->add_subcommand("ps", "Show, inspect or kill running processes");
-    set_ps_command(ps_subcom);
+    define_options(
+        ps_subcom,
+        config,
+        [](CLI::App* subcom, Configuration&) { set_ps_command(subcom); },
+        lazy
+    );
 
     CLI::App* auth_subcom = com->add_subcommand("auth", "Login or logout of a given host");
-    set_auth_command(auth_subcom);
+    define_options(
+        auth_subcom,
+        config,
+        [](CLI::App* subcom, Configuration&) { set_auth_command(subcom); },
+        lazy
+    );
 
     CLI::App* search_subcom = com->add_subcommand(
         "search",
         "Find packages in active environment or channels"
     );
-    set_search_command(search_subcom, config);
+    define_options(search_subcom, config, set_search_command, lazy);
 
 #if !defined(_WIN32) && defined(MICROMAMBA_SERVER)
     CLI::App* server_subcom = com->add_subcommand("server", "Run micromamba server");
-    set_server_command(server_subcom, config);
+    define_options(server_subcom, config, set_server_command, lazy);
 #endif
 
     com->require_subcommand(/* min */ 0, /* max */ 1);
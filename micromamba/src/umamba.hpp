@@ -25,6 +25,9 @@ set_create_command(CLI::App* subcom, mamba::Configuration& config);
 void
 set_info_command(CLI::App* subcom, mamba::Configuration& config);
 
+void
+set_index_command(CLI::App* subcom, mamba::Configuration& config);
+
 void
 set_install_command(CLI::App* subcom, mamba::Configuration& config);
 
@@ -40,8 +43,14 @@ set_shell_command(CLI::App* subcom, mamba::Configuration& config);
 void
 set_package_command(CLI::App* subcom, mamba::Configuration& config);
 
+/**
+ * Define the micromamba command.
+ *
+ * If @p lazy, the options of a subcommand are only defined when it is parsed.
+ * The completer needs all of them.
+ */
 void
-set_umamba_command(CLI::App* com, mamba::Configuration& config);
+set_umamba_command(CLI::App* com, mamba::Configuration& config, bool lazy);
 
 void
 set_update_command(CLI::App* subcom, mamba::Configuration& config);
@@ -876,3 +876,53 @@ def test_pre_commit_compat(tmp_home, tmp_root_prefix, tmp_path):
         if pre_commit_log.exists():
             print(pre_commit_log.read_text())
         raise
+
+
+@pytest.mark.skipif(
+    helpers.dry_run_tests is helpers.DryRun.ULTRA_DRY,
+    reason="Running only ultra-dry tests",
+)
+@pytest.mark.parametrize("shared_pkgs_dirs", [True], indirect=True)
+def test_create_clone(tmp_home, tmp_root_prefix, tmp_path):
+    source_prefix = tmp_path / "source"
+    helpers.create("-p", source_prefix, "python=3.11", "--json", no_dry_run=True)
+
+    clone_prefix = tmp_path / "clone-with-a-longer-name"
+    res = helpers.create("-p", clone_prefix, "--clone", source_prefix, "--json", no_dry_run=True)
+    assert res["success"]
+
+    def package_names(prefix):
+        return {pkg["name"] for pkg in helpers.umamba_list("-p", prefix, "--json")}
+
+    assert package_names(clone_prefix) == package_names(source_prefix)
+    assert (clone_prefix / "conda-meta" / "history").exists()
+    if platform.system() != "Windows":
+        with open(clone_prefix / "bin" / "2to3") as f:
+            assert f.readline() == f"#!{clone_prefix}/bin/python3.11\n"
+
+    with pytest.raises(subprocess.CalledProcessError):
+        helpers.create("-p", tmp_path / "other", "--clone", source_prefix, "xtensor")
+
+
+@pytest.mark.skipif(
+    helpers.dry_run_tests is helpers.DryRun.ULTRA_DRY,
+    reason="Running only ultra-dry tests",
+)
+@pytest.mark.parametrize("shared_pkgs_dirs", [True], indirect=True)
+def test_create_batch_files(tmp_home, tmp_root_prefix, tmp_path):
+    files = []
+    for name, specs in [("batch-a", ["xtensor"]), ("batch-b", ["xtensor", "xsimd"])]:
+        file = tmp_path / f"{name}.yaml"
+        file.write_text(yaml.dump({"name": name, "dependencies": specs}))
+        files += ["--batch-file", file]
+
+    helpers.create(*files, no_dry_run=True)
+
+    def package_names(name):
+        return {pkg["name"] for pkg in helpers.umamba_list("-n", name, "--json")}
+
+    assert "xtensor" in package_names("batch-a")
+    assert {"xtensor", "xsimd"} <= package_names("batch-b")
+
+    with pytest.raises(subprocess.CalledProcessError):
+        helpers.create(*files, "xtensor")
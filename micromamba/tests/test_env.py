@@ -1,4 +1,5 @@
 import os
+import platform
 import shutil
 from pathlib import Path
 
@@ -103,6 +104,21 @@ def test_env_remove(tmp_home, tmp_root_prefix):
         assert str(env_fp) not in lines
 
 
+def test_env_remove_pre_unlink_script(tmp_home, tmp_root_prefix):
+    """Packages with pre-unlink scripts are unlinked rather than deleted with the prefix."""
+    env_name = "env-remove-pre-unlink"
+    env_fp = tmp_root_prefix / "envs" / env_name
+    helpers.create("xtensor", "-n", env_name, "--json", no_dry_run=True)
+    script_dir = env_fp / ("Scripts" if platform.system() == "Windows" else "bin")
+    script_dir.mkdir(parents=True, exist_ok=True)
+    suffix = ".bat" if platform.system() == "Windows" else ".sh"
+    (script_dir / f".xtensor-pre-unlink{suffix}").write_text("")
+
+    res = helpers.run_env("remove", "-n", env_name, "-y", "--json")
+    assert res["success"]
+    assert not env_fp.exists()
+
+
 @pytest.mark.parametrize("shared_pkgs_dirs", [True], indirect=True)
 def test_explicit_export_topologically_sorted(tmp_home, tmp_prefix):
     """Explicit export must have dependencies before dependent packages."""
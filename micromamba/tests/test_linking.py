@@ -1,3 +1,5 @@
+import hashlib
+import io
 import json
 import os
 import platform
@@ -5,6 +7,7 @@ import random
 import shutil
 import string
 import subprocess
+import tarfile
 from pathlib import Path
 
 import pytest
@@ -130,3 +133,235 @@ class TestLinking:
 
         os.remove(linked_file)
         remove("xtensor", "-n", TestLinking.env_name)
+
+
+def write_channel(channel: Path, packages, subdir="linux-64", noarch=None):
+    """A local channel of ``(name, version, depends, files)`` packages of ``subdir``.
+
+    The packages are ``noarch`` packages of the given type instead, if any.
+    """
+    subdir_name = "noarch" if noarch else subdir
+    pkgs_subdir = channel / subdir_name
+    pkgs_subdir.mkdir(parents=True)
+    records = {}
+    for name, version, depends, files in packages:
+        fn = f"{name}-{version}-0.tar.bz2"
+        index = {
+            "name": name,
+            "version": version,
+            "build": "0",
+            "build_number": 0,
+            "depends": depends,
+            "subdir": subdir_name,
+        }
+        if noarch:
+            index["noarch"] = noarch
+        paths = [
+            {
+                "_path": path,
+                "path_type": "hardlink",
+                "sha256": hashlib.sha256(data.encode()).hexdigest(),
+                "size_in_bytes": len(data.encode()),
+            }
+            for path, data in files.items()
+        ]
+        content = {
+            "info/index.json": json.dumps(index),
+            "info/paths.json": json.dumps({"paths": paths, "paths_version": 1}),
+            "info/files": "\n".join(files),
+            **files,
+        }
+        with tarfile.open(pkgs_subdir / fn, mode="w:bz2") as tar:
+            for path, data in content.items():
+                info = tarfile.TarInfo(path)
+                info.size = len(data.encode())
+                tar.addfile(info, io.BytesIO(data.encode()))
+        data = (pkgs_subdir / fn).read_bytes()
+        records[fn] = {
+            **index,
+            "size": len(data),
+            "sha256": hashlib.sha256(data).hexdigest(),
+        }
+    for name in [subdir, "noarch"]:
+        packages = records if name == subdir_name else {}
+        (channel / name).mkdir(exist_ok=True)
+        (channel / name / "repodata.json").write_text(
+            json.dumps({"info": {"subdir": name}, "packages": packages})
+        )
+
+
+def prefix_files(prefix: Path):
+    """The content of the files of a prefix, outside of conda-meta."""
+    return {
+        str(p.relative_to(prefix)): p.read_text()
+        for p in prefix.rglob("*")
+        if p.is_file() and "conda-meta" not in p.relative_to(prefix).parts
+    }
+
+
+n_others = 8
+
+
+@pytest.fixture
+def shared_file_channel(tmp_path):
+    """``a`` moves ``share/shared.txt`` to its new dependency ``b``."""
+    channel = tmp_path / "channel"
+    others = [
+        (f"other{i}", "1.0", [], {f"share/other{i}.txt": str(i)})
+        for i in range(n_others)
+    ]
+    write_channel(
+        channel,
+        [
+            ("a", "1.0", [], {"share/shared.txt": "a-1.0", "share/a.txt": "a-1.0"}),
+            ("a", "2.0", ["b"], {"share/a.txt": "a-2.0"}),
+            ("b", "1.0", [], {"share/shared.txt": "b-1.0"}),
+            *others,
+        ],
+    )
+    return channel
+
+
+def channel_install(create_cmd, prefix, channel, *specs):
+    """Install ``specs`` from ``channel`` alone, along with the other packages."""
+    others = [f"other{i}" for i in range(n_others)]
+    create_cmd(
+        "-p",
+        prefix,
+        *specs,
+        *others,
+        "-c",
+        channel,
+        "--override-channels",
+        "--platform",
+        "linux-64",
+        default_channel=False,
+        no_dry_run=True,
+    )
+
+
+def test_transaction_shared_file(tmp_home, tmp_root_prefix, shared_file_channel):
+    def update_a(link_threads):
+        os.environ["MAMBA_LINK_THREADS"] = str(link_threads)
+        prefix = tmp_root_prefix / "envs" / f"shared-{link_threads}"
+        channel_install(create, prefix, shared_file_channel, "a=1.0")
+        assert (prefix / "share" / "shared.txt").read_text() == "a-1.0"
+        # a-1.0 is removed and b installed in the same transaction, along with
+        # reinstalls of unrelated packages
+        channel_install(
+            install, prefix, shared_file_channel, "a=2.0", "--force-reinstall"
+        )
+        return prefix_files(prefix)
+
+    files = update_a(link_threads=4)
+    # The same prefix as when executing the actions in order
+    assert files == update_a(link_threads=1)
+    assert files[str(Path("share") / "a.txt")] == "a-2.0"
+    for i in range(n_others):
+        assert files[str(Path("share") / f"other{i}.txt")] == str(i)
+
+
+@pytest.mark.parametrize("link_threads", [1, 4])
+def test_transaction_reinstall(
+    tmp_home, tmp_root_prefix, shared_file_channel, link_threads
+):
+    os.environ["MAMBA_LINK_THREADS"] = str(link_threads)
+    prefix = tmp_root_prefix / "envs" / "reinstall"
+    channel_install(create, prefix, shared_file_channel, "a=2.0")
+    expected = prefix_files(prefix)
+
+    (prefix / "share" / "shared.txt").unlink()
+    (prefix / "share" / "other0.txt").write_text("changed")
+    channel_install(install, prefix, shared_file_channel, "a", "b", "--force-reinstall")
+    assert prefix_files(prefix) == expected
+
+
+pyc_python_version = "3.10"
+pyc_cache_tag = "cpython-310"
+
+
+def write_python_channel(channel: Path, modules):
+    """A channel of a noarch python package of ``modules``, returning its name.
+
+    The name is random, so that the package is not in the shared package cache already.
+    """
+    name = f"pure-{random_string().lower()}"
+    files = {f"site-packages/pure/{mod}.py": source for mod, source in modules.items()}
+    subdir = info("--json")["platform"]
+    write_channel(
+        channel, [(name, "1.0", ["python"], files)], subdir=subdir, noarch="python"
+    )
+    return name
+
+
+def pyc_file(mod: str):
+    """The compiled file of the module ``mod`` of the package, in the prefix."""
+    site_packages = Path("lib") / f"python{pyc_python_version}" / "site-packages"
+    return site_packages / "pure" / "__pycache__" / f"{mod}.{pyc_cache_tag}.pyc"
+
+
+def pyc_create(prefix: Path, channel: Path, name: str):
+    """Create ``prefix`` with Python and the package ``name`` of ``channel``."""
+    create(
+        "-p",
+        prefix,
+        f"python={pyc_python_version}",
+        name,
+        "-c",
+        channel,
+        no_dry_run=True,
+    )
+
+
+@pytest.mark.skipif(
+    platform.system() == "Windows", reason="Compiled files are not cached on Windows"
+)
+@pytest.mark.parametrize("shared_pkgs_dirs", [True], indirect=True)
+def test_cached_pyc(tmp_home, tmp_root_prefix, tmp_path):
+    channel = tmp_path / "channel"
+    name = write_python_channel(channel, {"mod": "x = 1\n", "broken": "def (\n"})
+    pkg_dir = Path(os.environ["CONDA_PKGS_DIRS"]) / f"{name}-1.0-0"
+    pyc_cache_dir = pkg_dir / "info" / "pyc_cache" / pyc_python_version
+    envs_dir = tmp_root_prefix / "envs"
+
+    pyc_create(envs_dir / "first", channel, name)
+    compiled = (envs_dir / "first" / pyc_file("mod")).read_bytes()
+    assert (pyc_cache_dir / pyc_file("mod")).read_bytes() == compiled
+    # Not cached when the compilation fails
+    assert not (envs_dir / "first" / pyc_file("broken")).exists()
+    assert not (pyc_cache_dir / pyc_file("broken")).exists()
+
+    # Reused for the same source, with a marker appended to tell it apart
+    with open(pyc_cache_dir / pyc_file("mod"), "ab") as f:
+        f.write(b"cached")
+    pyc_create(envs_dir / "second", channel, name)
+    assert (envs_dir / "second" / pyc_file("mod")).read_bytes() == compiled + b"cached"
+
+    # Compiled again after the source changes, such as when extracted again
+    mtime = 1_000_000_000
+    os.utime(pkg_dir / "site-packages" / "pure" / "mod.py", (mtime, mtime))
+    pyc_create(envs_dir / "third", channel, name)
+    third = envs_dir / "third"
+    compiled = (third / pyc_file("mod")).read_bytes()
+    assert not compiled.endswith(b"cached")
+    source = third / pyc_file("mod").parent.parent / "mod.py"
+    assert int.from_bytes(compiled[8:12], "little") == int(source.stat().st_mtime)
+    assert (pyc_cache_dir / pyc_file("mod")).read_bytes() == compiled
+
+
+@pytest.mark.skipif(
+    platform.system() == "Windows", reason="Python paths differ on Windows"
+)
+@pytest.mark.parametrize("shared_pkgs_dirs", [True], indirect=True)
+def test_pyc_compilation_shards(tmp_home, tmp_root_prefix, tmp_path):
+    # More files than a compilation process is started for
+    n_modules = 100
+    os.environ["MAMBA_COMPILE_PYC_THREADS"] = "4"
+    channel = tmp_path / "channel"
+    name = write_python_channel(
+        channel, {f"mod{i}": f"x = {i}\n" for i in range(n_modules)}
+    )
+    prefix = tmp_root_prefix / "envs" / "shards"
+    pyc_create(prefix, channel, name)
+    for i in range(n_modules):
+        assert (prefix / pyc_file(f"mod{i}")).exists()
@@ -1,4 +1,6 @@
+import json
 import os
+import platform
 import shutil
 import subprocess
 from pathlib import Path
@@ -527,3 +529,55 @@ class TestMultiplePkgCaches:
         # check linked files
         assert linked_file.stat().st_dev == non_writable_cache_file.stat().st_dev
         assert linked_file.stat().st_ino == non_writable_cache_file.stat().st_ino
+
+
+@pytest.mark.skipif(
+    helpers.dry_run_tests is helpers.DryRun.ULTRA_DRY,
+    reason="Running only ultra-dry tests",
+)
+def test_container_build(tmp_home, tmp_root_prefix, tmp_path):
+    cache = tmp_root_prefix / "pkgs"
+    # Already in the cache before the container build
+    res = helpers.create("-n", "cached", "xtl", "--json", no_dry_run=True)
+    xtl = next(pkg for pkg in res["actions"]["LINK"] if pkg["name"] == "xtl")
+    xtl_spec = f"xtl={xtl['version']}={xtl['build_string']}"
+    xtl_bld = find_pkg_build(cache, "xtl")
+
+    os.environ["MAMBA_CONTAINER_BUILD"] = "true"
+    prefix = tmp_path / "prefix"
+    res = helpers.create(
+        "-p", prefix, "xtensor", xtl_spec, "python=3.11", "--json", no_dry_run=True
+    )
+    linked = {
+        f"{pkg['name']}-{pkg['version']}-{pkg['build_string']}"
+        for pkg in res["actions"]["LINK"]
+    }
+    assert xtl_bld in linked
+
+    # Only the packages of the transaction are removed
+    for bld in linked - {xtl_bld}:
+        assert not (cache / bld).exists()
+        assert find_cache_archive(cache, bld) is None
+    assert (cache / xtl_bld).exists()
+    assert find_cache_archive(cache, xtl_bld) is not None
+    assert (prefix / helpers.xtensor_hpp).exists()
+
+    # The records do not point at the removed packages
+    for bld in linked:
+        record = json.loads((prefix / "conda-meta" / f"{bld}.json").read_text())
+        assert "extracted_package_dir" not in record
+        assert "package_tarball_full_path" not in record
+        assert "link" not in record
+
+    # Relocated from the prefix alone
+    clone = tmp_path / "clone-with-a-longer-name"
+    res = helpers.create("-p", clone, "--clone", prefix, "--json", no_dry_run=True)
+    assert res["success"]
+    assert (clone / helpers.xtensor_hpp).exists()
+    if platform.system() != "Windows":
+        with open(clone / "bin" / "2to3") as f:
+            assert f.readline() == f"#!{clone}/bin/python3.11\n"
+
+    helpers.remove("-p", prefix, "xtensor", no_dry_run=True)
+    assert not (prefix / helpers.xtensor_hpp).exists()
+    assert not any((prefix / "conda-meta").glob("xtensor-*.json"))
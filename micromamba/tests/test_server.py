@@ -0,0 +1,218 @@
+import functools
+import hashlib
+import http.server
+import io
+import json
+import os
+import subprocess
+import tarfile
+import threading
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+import pytest
+
+from . import helpers
+
+
+def make_package(name: str) -> bytes:
+    """A ``.tar.bz2`` package without any file."""
+    index = {
+        "name": name,
+        "version": "1.0",
+        "build": "0",
+        "build_number": 0,
+        "depends": [],
+        "subdir": "linux-64",
+    }
+    content = {
+        "info/index.json": json.dumps(index),
+        "info/paths.json": json.dumps({"paths": [], "paths_version": 1}),
+    }
+    buffer = io.BytesIO()
+    with tarfile.open(fileobj=buffer, mode="w:bz2") as tar:
+        for path, data in content.items():
+            info = tarfile.TarInfo(path)
+            info.size = len(data.encode())
+            tar.addfile(info, io.BytesIO(data.encode()))
+    return buffer.getvalue()
+
+
+def tampered(data: bytes) -> bytes:
+    """Other bytes of the same size."""
+    return data[:-1] + bytes([data[-1] ^ 0xFF])
+
+
+class HTTPServer:
+    """Serve the files of a directory, or a fixed response to every request."""
+
+    def __init__(self, directory=None, status=200, body=b""):
+        class Handler(http.server.SimpleHTTPRequestHandler):
+            def do_GET(self):
+                if directory is not None:
+                    return super().do_GET()
+                self.send_response(status)
+                self.send_header("Content-Length", str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+
+            def log_message(self, *args):
+                pass
+
+        self.directory = directory
+        handler = functools.partial(Handler, directory=str(directory or "."))
+        self.httpd = http.server.ThreadingHTTPServer(("127.0.0.1", 0), handler)
+        self.url = f"http://127.0.0.1:{self.httpd.server_address[1]}"
+        self.thread = threading.Thread(target=self.httpd.serve_forever, daemon=True)
+        self.thread.start()
+
+    def stop(self):
+        self.httpd.shutdown()
+        self.thread.join()
+
+
+@pytest.fixture
+def upstream(tmp_path):
+    """A channel of ``good`` and ``bad``, whose tarball differs from its record."""
+    subdir = tmp_path / "upstream" / "channel" / "linux-64"
+    subdir.mkdir(parents=True)
+    records = {}
+    for name in ["good", "bad"]:
+        data = make_package(name)
+        fn = f"{name}-1.0-0.tar.bz2"
+        (subdir / fn).write_bytes(tampered(data) if name == "bad" else data)
+        records[fn] = {
+            "name": name,
+            "version": "1.0",
+            "build": "0",
+            "build_number": 0,
+            "depends": [],
+            "subdir": "linux-64",
+            "size": len(data),
+            "sha256": hashlib.sha256(data).hexdigest(),
+        }
+    repodata = {"info": {"subdir": "linux-64"}, "packages": records}
+    (subdir / "repodata.json").write_text(json.dumps(repodata))
+    (subdir.parent / "noarch").mkdir()
+    (subdir.parent / "noarch" / "repodata.json").write_text(
+        json.dumps({"info": {"subdir": "noarch"}, "packages": {}})
+    )
+
+    server = HTTPServer(directory=tmp_path / "upstream")
+    yield server
+    server.stop()
+
+
+@pytest.fixture
+def peer_pkgs_dir(tmp_path):
+    pkgs_dir = tmp_path / "peer_pkgs"
+    pkgs_dir.mkdir()
+    return pkgs_dir
+
+
+@pytest.fixture
+def peer(tmp_home, tmp_root_prefix, unused_tcp_port, upstream, peer_pkgs_dir):
+    """A micromamba server with the upstream channel under its channel alias."""
+    env = dict(os.environ)
+    env["MAMBA_CHANNEL_ALIAS"] = upstream.url
+    env["CONDA_PKGS_DIRS"] = str(peer_pkgs_dir)
+    process = subprocess.Popen(
+        [helpers.get_umamba(), "server", "--port", str(unused_tcp_port)], env=env
+    )
+    url = f"http://127.0.0.1:{unused_tcp_port}"
+    for _ in range(100):
+        try:
+            urllib.request.urlopen(f"{url}/hello")
+            break
+        except urllib.error.URLError:
+            time.sleep(0.1)
+    yield url
+    process.terminate()
+    process.wait()
+
+
+def get_package(peer: str, fn: str, url: str):
+    """The status and body of the request of ``fn`` to ``peer``."""
+    query = urllib.parse.urlencode({"url": url})
+    try:
+        with urllib.request.urlopen(f"{peer}/pkgs/{fn}?{query}") as res:
+            return res.status, res.read()
+    except urllib.error.HTTPError as e:
+        return e.code, e.read()
+
+
+def test_server_pulls_upstream_tarball(peer, upstream, peer_pkgs_dir):
+    fn = "good-1.0-0.tar.bz2"
+    url = f"{upstream.url}/channel/linux-64/{fn}"
+    assert get_package(peer, fn, url) == (200, make_package("good"))
+    assert (peer_pkgs_dir / fn).read_bytes() == make_package("good")
+    assert not (peer_pkgs_dir / f"{fn}.part").exists()
+
+    # Served from the cache once pulled
+    assert get_package(peer, fn, "")[0] == 200
+
+
+def test_server_rejects_mismatched_tarball(peer, upstream, peer_pkgs_dir):
+    fn = "bad-1.0-0.tar.bz2"
+    url = f"{upstream.url}/channel/linux-64/{fn}"
+    assert get_package(peer, fn, url)[0] == 502
+    assert not (peer_pkgs_dir / fn).exists()
+    assert not (peer_pkgs_dir / f"{fn}.part").exists()
+
+
+def test_server_only_pulls_from_upstreams(peer, upstream, peer_pkgs_dir):
+    fn = "good-1.0-0.tar.bz2"
+    # Not under the channel alias of the server
+    other = HTTPServer(directory=upstream.directory)
+    try:
+        assert get_package(peer, fn, f"{other.url}/channel/linux-64/{fn}")[0] == 404
+    finally:
+        other.stop()
+    # Not the requested filename, or escaping the channel
+    url = f"{upstream.url}/channel/linux-64/{fn}"
+    assert get_package(peer, "bad-1.0-0.tar.bz2", url)[0] == 404
+    escaping = f"{upstream.url}/channel/../channel/linux-64/{fn}"
+    assert get_package(peer, fn, escaping)[0] == 404
+    assert not (peer_pkgs_dir / fn).exists()
+
+    # Not package filenames
+    assert get_package(peer, "..good-1.0-0.tar.bz2", url)[0] == 400
+    assert get_package(peer, "repodata.json", url)[0] == 400
+
+
+def create_with_peer(upstream, peer):
+    """Create an environment of ``good`` with ``peer`` as package cache peer."""
+    os.environ["MAMBA_PACKAGE_CACHE_PEERS"] = peer.url
+    try:
+        helpers.create(
+            "-n",
+            "peers",
+            "good",
+            "-c",
+            f"{upstream.url}/channel",
+            "--override-channels",
+            "--platform",
+            "linux-64",
+            default_channel=False,
+            no_dry_run=True,
+        )
+    finally:
+        peer.stop()
+
+
+@pytest.mark.parametrize("status", [404, 502])
+def test_client_falls_back_to_channel(tmp_home, tmp_root_prefix, upstream, status):
+    create_with_peer(upstream, HTTPServer(status=status))
+    conda_meta = tmp_root_prefix / "envs" / "peers" / "conda-meta"
+    assert (conda_meta / "good-1.0-0.json").exists()
+
+
+def test_client_downloads_again_bad_peer_tarball(tmp_home, tmp_root_prefix, upstream):
+    # Same size as the package, so that only its validation fails
+    create_with_peer(upstream, HTTPServer(body=tampered(make_package("good"))))
+    pkgs_dir = tmp_root_prefix / "pkgs"
+    assert (pkgs_dir / "good-1.0-0.tar.bz2").read_bytes() == make_package("good")
+    conda_meta = tmp_root_prefix / "envs" / "peers" / "conda-meta"
+    assert (conda_meta / "good-1.0-0.json").exists()